@@ -3,13 +3,15 @@
  * @brief Active Object + HSM (层次状态机) 模式示例
  *
  * 演示内容:
- * 1. 基于 eventpp EventQueue 的 Active Object 模式
+ * 1. 基于 eventpp::ActiveObject (utilities/activeobject.h) 的 Active Object 模式
  * 2. 生产者-消费者 pipeline (Sensor → Processor → Logger)
  * 3. 层次状态机 (HSM) 控制处理器行为:
  *    - 复合状态: Running 包含 Normal / Degraded 两个子状态
  *    - Entry/Exit 动作: 状态进入/退出时执行副作用
  *    - Guard 条件: Error 恢复有重试次数限制 (最多 3 次)
  * 4. 零拷贝数据传递 (shared_ptr 引用计数)
+ * 5. 延时事件: PostAfter 由 EventQueue 的时间轮 (Timer = TimerWheel) 投递,
+ *    Run 循环的 waitFor 在截止时间唤醒, 不需要额外的定时器线程
  *
  * HSM 状态图:
  *
@@ -35,9 +37,11 @@
  */
 
 #include <eventpp/eventqueue.h>
+#include <eventpp/utilities/activeobject.h>
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
 #include <functional>
@@ -84,16 +88,24 @@ struct EventPayload {
 };
 
 // =============================================================================
-// Minimal Active Object (eventpp-based)
+// Active Object (eventpp::ActiveObject)
 // =============================================================================
 
+struct ActiveObjectPolicy : eventpp::HighPerfPolicy {
+    // waitFor sleeps on the condition variable, which needs _any with SpinLock.
+    using Threading = eventpp::GeneralThreading<eventpp::SpinLock, std::atomic, std::condition_variable_any>;
+    using Timer = eventpp::TimerWheel;
+};
+
+// eventpp::ActiveObject owns the worker thread, it sleeps until an event
+// arrives or a delayed event is due, and drains the queue on Stop().
 class ActiveObject {
 public:
     using Queue = eventpp::EventQueue<uint32_t, void(const EventPayload&),
-                                      eventpp::HighPerfPolicy>;
+                                      ActiveObjectPolicy>;
     using Callback = std::function<void(const EventPayload&)>;
 
-    explicit ActiveObject(const char* name) : name_(name), running_(false) {}
+    explicit ActiveObject(const char* name) : name_(name), object_() {}
 
     virtual ~ActiveObject() { Stop(); }
 
@@ -101,47 +113,34 @@ public:
     ActiveObject& operator=(const ActiveObject&) = delete;
 
     void Subscribe(uint32_t event_id, Callback cb) {
-        queue_.appendListener(event_id, std::move(cb));
+        object_.getQueue().appendListener(event_id, std::move(cb));
     }
 
     void Post(const EventPayload& event) {
-        queue_.enqueue(event.event_id, event);
+        object_.getQueue().enqueue(event.event_id, event);
     }
 
     void Post(uint32_t event_id) {
-        queue_.enqueue(event_id, EventPayload(event_id));
+        object_.getQueue().enqueue(event_id, EventPayload(event_id));
     }
 
-    void Start() {
-        running_.store(true, std::memory_order_release);
-        thread_ = std::thread(&ActiveObject::Run, this);
+    // The event is processed by the AO thread once the delay expires.
+    template <typename Rep, typename Period>
+    void PostAfter(std::chrono::duration<Rep, Period> delay, uint32_t event_id) {
+        object_.getQueue().enqueueAfter(delay, event_id, EventPayload(event_id));
     }
 
-    void Stop() {
-        running_.store(false, std::memory_order_release);
-        if (thread_.joinable()) {
-            thread_.join();
-        }
-    }
+    void Start() { object_.start(); }
+
+    void Stop() { object_.stop(); }
 
-    bool IsRunning() const { return running_.load(std::memory_order_acquire); }
+    bool IsRunning() const { return object_.isRunning(); }
     const char* GetName() const { return name_; }
+    eventpp::ActiveObjectStats GetStats() const { return object_.getStats(); }
 
 private:
-    void Run() {
-        while (running_.load(std::memory_order_acquire)) {
-            if (!queue_.processOne()) {
-                // No events, yield to avoid busy-wait
-                std::this_thread::sleep_for(std::chrono::microseconds(100));
-            }
-        }
-        queue_.process(); // drain remaining
-    }
-
     const char* name_;
-    Queue queue_;
-    std::thread thread_;
-    std::atomic<bool> running_;
+    eventpp::ActiveObject<Queue> object_;
 };
 
 // =============================================================================
@@ -612,7 +611,8 @@ int main() {
     // =========================================================================
     printf("\n[Phase 6] Stop — cleanup\n");
     processor.SendCommand(EventID::kStop);
-    sensor.Post(EventID::kStop);
+    // Delayed event, handled by the sensor AO thread after 100 ms.
+    sensor.PostAfter(std::chrono::milliseconds(100), EventID::kStop);
     sleep_ms(200);
 
     sensor.Stop();
@@ -630,6 +630,14 @@ int main() {
     printf("  Logger degraded entries:  %u\n", logger.DegradedCount());
     printf("  Processor retry count:    %u\n", processor.RetryCount());
     printf("  Processor final state:    %s\n", processor.StateName());
+    for (const ActiveObject* ao : {static_cast<const ActiveObject*>(&sensor),
+            static_cast<const ActiveObject*>(&processor),
+            static_cast<const ActiveObject*>(&logger)}) {
+        const eventpp::ActiveObjectStats stats = ao->GetStats();
+        printf("  %-9s events / batches: %llu / %llu\n", ao->GetName(),
+               static_cast<unsigned long long>(stats.eventCount),
+               static_cast<unsigned long long>(stats.batchCount));
+    }
     printf("\nDone.\n");
 
     return 0;
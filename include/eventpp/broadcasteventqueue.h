@@ -0,0 +1,503 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BROADCASTEVENTQUEUE_H_EVENTPP
+#define BROADCASTEVENTQUEUE_H_EVENTPP
+
+#include "eventdispatcher.h"
+#include "internal/eventqueue_i.h"
+#include "internal/spinwait_i.h"
+#include "internal/broadcastring_i.h"
+
+#include <tuple>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <initializer_list>
+#include <type_traits>
+
+namespace eventpp {
+
+namespace internal_ {
+
+template <
+	typename EventType_,
+	typename Prototype_,
+	typename Policies_
+>
+class BroadcastEventQueueBase;
+
+// OPT-52: EventQueue in which every consumer gets every event.
+// Fanning out to N EventQueues copies, locks and allocates each event N
+// times. Here the event is put once in a pre-allocated ring, and each
+// Consumer reads it in place with its own cursor. A consumer can depend on
+// other consumers, it never passes them, so the consumers can be chained.
+template <
+	typename EventType_,
+	typename Policies_,
+	typename ReturnType, typename ...Args
+>
+class BroadcastEventQueueBase <
+		EventType_,
+		ReturnType (Args...),
+		Policies_
+	> : public EventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		BroadcastEventQueueBase <
+			EventType_,
+			ReturnType (Args...),
+			Policies_
+		>
+	>
+{
+private:
+	using super = EventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		BroadcastEventQueueBase <
+			EventType_,
+			ReturnType (Args...),
+			Policies_
+		>
+	>;
+
+	using Policies = typename super::Policies;
+	using Threading = typename super::Threading;
+	using DispatchCache = typename super::DispatchCache;
+	using ConditionVariable = typename Threading::ConditionVariable;
+
+	using QueuedEventArgumentsType = std::tuple<typename std::decay<Args>::type...>;
+
+	struct QueuedEvent_
+	{
+		typename std::decay<typename super::Event>::type event;
+		QueuedEventArgumentsType arguments;
+
+		typename super::Event getEvent() const {
+			return event;
+		}
+
+		template <std::size_t N>
+		auto getArgument() const
+			-> typename std::tuple_element<N, std::tuple<Args...> >::type {
+			return std::get<N>(arguments);
+		}
+	};
+
+public:
+	using RingOverflow = typename SelectRingOverflow<Policies_, HasTypeRingOverflow<Policies_>::value>::Type;
+	using RingProducer = typename SelectRingProducer<Policies_, HasTypeRingProducer<Policies_>::value>::Type;
+	using RingCapacity = typename SelectRingCapacity<Policies_, HasTypeRingCapacity<Policies_>::value>::Type;
+
+	static_assert(! std::is_same<RingOverflow, RingOverflowDropOldest>::value,
+		"BroadcastEventQueue can't drop an event which a consumer may be reading, RingOverflowDropOldest is not supported.");
+
+private:
+	using Ring = BroadcastRing<QueuedEvent_, RingProducer>;
+
+	static constexpr bool blockOnOverflow = std::is_same<RingOverflow, RingOverflowBlock>::value;
+
+public:
+	using QueuedEvent = QueuedEvent_;
+	using Event = typename super::Event;
+	using Handle = typename super::Handle;
+	using Callback = typename super::Callback;
+	using Mutex = typename super::Mutex;
+
+	// A light handle of a consumer, copying it doesn't add a consumer.
+	// Only one thread may process with a consumer at the same time.
+	class Consumer
+	{
+	public:
+		Consumer() : queue(nullptr), cursor(nullptr)
+		{
+		}
+
+		explicit operator bool () const {
+			return cursor != nullptr;
+		}
+
+		// Dispatches the events the consumer has not seen to the listeners of
+		// the queue. Only the events in the queue when process is called are
+		// dispatched.
+		bool process()
+		{
+			// OPT-25: Consecutive events of the same type share one lookup.
+			DispatchCache cache;
+			return queue->doConsume(*cursor, queue->ring.getPendingCount(*cursor), [this, &cache](const QueuedEvent & item) {
+				queue->doDispatchQueuedEventCached(
+					cache,
+					item,
+					typename MakeIndexSequence<sizeof...(Args)>::Type()
+				);
+			});
+		}
+
+		bool processOne()
+		{
+			return queue->doConsume(*cursor, 1, [this](const QueuedEvent & item) {
+				queue->doDispatchQueuedEvent(
+					item,
+					typename MakeIndexSequence<sizeof...(Args)>::Type()
+				);
+			});
+		}
+
+		// OPT-15: Zero-overhead visitor dispatch, see EventQueue::processQueueWith.
+		// Visitor protocol: visitor(event, args...), the arguments are const
+		// because the other consumers read the same event.
+		template <typename Visitor>
+		bool processQueueWith(Visitor && visitor)
+		{
+			return queue->doConsume(*cursor, queue->ring.getPendingCount(*cursor), [&visitor](const QueuedEvent & item) {
+				doVisitQueuedEvent(
+					visitor,
+					item,
+					typename MakeIndexSequence<sizeof...(Args)>::Type()
+				);
+			});
+		}
+
+		// OPT-15: Single-event variant of processQueueWith.
+		template <typename Visitor>
+		bool processOneWith(Visitor && visitor)
+		{
+			return queue->doConsume(*cursor, 1, [&visitor](const QueuedEvent & item) {
+				doVisitQueuedEvent(
+					visitor,
+					item,
+					typename MakeIndexSequence<sizeof...(Args)>::Type()
+				);
+			});
+		}
+
+		// True if the consumer has no event it can process now, because it has
+		// seen all the events, or the consumers it depends on have not.
+		bool emptyQueue() const
+		{
+			return ! queue->ring.canConsume(*cursor);
+		}
+
+		void wait() const
+		{
+			while(! waitFor(std::chrono::hours(1))) {
+			}
+		}
+
+		template <class Rep, class Period>
+		bool waitFor(const std::chrono::duration<Rep, Period> & duration) const
+		{
+			return queue->doWaitFor(*cursor, duration);
+		}
+
+	private:
+		Consumer(BroadcastEventQueueBase * queue, BroadcastCursor * cursor)
+			: queue(queue), cursor(cursor)
+		{
+		}
+
+		BroadcastEventQueueBase * queue;
+		BroadcastCursor * cursor;
+
+		friend class BroadcastEventQueueBase;
+	};
+
+public:
+	BroadcastEventQueueBase()
+		:
+			super(),
+			ring(RingCapacity::value),
+			waitingConsumerCount(0),
+			waitingProducerCount(0),
+			droppedEventCount(0),
+			queueListConditionVariable(),
+			queueNotFullConditionVariable(),
+			queueListMutex()
+	{
+	}
+
+	// Same as EventQueue, only the listeners are copied or moved, the queued
+	// events and the consumers are not.
+	BroadcastEventQueueBase(const BroadcastEventQueueBase & other)
+		: BroadcastEventQueueBase()
+	{
+		super::operator = (other);
+	}
+
+	BroadcastEventQueueBase(BroadcastEventQueueBase && other) noexcept
+		: BroadcastEventQueueBase()
+	{
+		super::operator = (std::move(other));
+	}
+
+	BroadcastEventQueueBase & operator = (const BroadcastEventQueueBase & other)
+	{
+		super::operator = (other);
+		return *this;
+	}
+
+	BroadcastEventQueueBase & operator = (BroadcastEventQueueBase && other) noexcept
+	{
+		super::operator = (std::move(other));
+		return *this;
+	}
+
+	// The consumers must be added before any event is enqueued, and they live
+	// as long as the queue. A consumer only gets the events after the ones
+	// all its dependencies have processed.
+	Consumer addConsumer()
+	{
+		return Consumer(this, ring.addCursor(std::vector<const BroadcastCursor *>()));
+	}
+
+	Consumer addConsumer(std::initializer_list<Consumer> dependencies)
+	{
+		std::vector<const BroadcastCursor *> dependencyList;
+		for(const Consumer & consumer : dependencies) {
+			assert(consumer.queue == this);
+			dependencyList.push_back(consumer.cursor);
+		}
+		return Consumer(this, ring.addCursor(std::move(dependencyList)));
+	}
+
+	// Returns true if the event is put in the queue.
+	template <typename ...A>
+	auto enqueue(A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), bool>::type
+	{
+		static_assert(super::ArgumentPassingMode::canIncludeEventType, "Enqueuing arguments count doesn't match required (Event type should be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, A...>::value>::Type;
+
+		return doEnqueue(QueuedEvent{
+			GetEvent::getEvent(args...),
+			QueuedEventArgumentsType(std::forward<A>(args)...)
+		});
+	}
+
+	template <typename T, typename ...A>
+	auto enqueue(T && first, A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), bool>::type
+	{
+		static_assert(super::ArgumentPassingMode::canExcludeEventType, "Enqueuing arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, T &&, A...>::value>::Type;
+
+		return doEnqueue(QueuedEvent{
+			GetEvent::getEvent(std::forward<T>(first), args...),
+			QueuedEventArgumentsType(std::forward<A>(args)...)
+		});
+	}
+
+	std::size_t getQueueCapacity() const
+	{
+		return ring.capacity();
+	}
+
+	// Events discarded by RingOverflowDropNewest.
+	std::size_t getDroppedEventCount() const
+	{
+		return droppedEventCount.load(std::memory_order_relaxed);
+	}
+
+	using super::dispatch;
+
+	template <typename U>
+	auto dispatch(const U & queuedEvent)
+		-> typename std::enable_if<std::is_same<U, QueuedEvent>::value, void>::type
+	{
+		doDispatchQueuedEvent(
+			queuedEvent,
+			typename MakeIndexSequence<sizeof...(Args)>::Type()
+		);
+	}
+
+protected:
+	template <typename F>
+	bool doConsume(BroadcastCursor & cursor, const std::size_t maxCount, F && func)
+	{
+		if(ring.consume(cursor, maxCount, std::forward<F>(func)) == 0) {
+			return false;
+		}
+
+		// The freed slots may unblock a producer, and the moved cursor may
+		// unblock the consumers which depend on it.
+		doNotifyQueueNotFull();
+		doNotifyQueueAvailable();
+		return true;
+	}
+
+	template <class Rep, class Period>
+	bool doWaitFor(const BroadcastCursor & cursor, const std::chrono::duration<Rep, Period> & duration) const
+	{
+		// OPT-8: Spin -> Yield -> Sleep, same as EventQueue::waitFor.
+		if(ring.canConsume(cursor)) {
+			return true;
+		}
+
+		if(internal_::spinThenYield([this, &cursor]() -> bool {
+			return ring.canConsume(cursor);
+		})) {
+			return true;
+		}
+
+		// Producers and consumers only take queueListMutex to notify when
+		// waitingConsumerCount is not zero. The fence pairs with the one in
+		// doNotifyQueueAvailable.
+		waitingConsumerCount.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		bool result;
+		{
+			std::unique_lock<Mutex> queueListLock(queueListMutex);
+			result = queueListConditionVariable.wait_for(queueListLock, duration, [this, &cursor]() -> bool {
+				return ring.canConsume(cursor);
+			});
+		}
+		waitingConsumerCount.fetch_sub(1, std::memory_order_relaxed);
+		return result;
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEvent(T && item, IndexSequence<Indexes...>)
+	{
+		this->directDispatch(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEventCached(DispatchCache & cache, T && item, IndexSequence<Indexes...>)
+	{
+		this->doDirectDispatchCached(cache, item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename V, typename T, size_t ...Indexes>
+	static void doVisitQueuedEvent(V && visitor, T && item, IndexSequence<Indexes...>)
+	{
+		visitor(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	bool doEnqueue(QueuedEvent && item)
+	{
+		const bool queued = doPush(std::move(item), RingOverflow());
+		if(queued) {
+			doNotifyQueueAvailable();
+		}
+		return queued;
+	}
+
+	bool doPush(QueuedEvent && item, RingOverflowReturnFalse)
+	{
+		return ring.tryPush(std::move(item));
+	}
+
+	bool doPush(QueuedEvent && item, RingOverflowDropNewest)
+	{
+		if(ring.tryPush(std::move(item))) {
+			return true;
+		}
+		droppedEventCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	bool doPush(QueuedEvent && item, RingOverflowBlock)
+	{
+		if(ring.tryPush(std::move(item))) {
+			return true;
+		}
+
+		if(internal_::spinThenYield([this, &item]() -> bool {
+			return ring.tryPush(std::move(item));
+		})) {
+			return true;
+		}
+
+		for(;;) {
+			if(ring.tryPush(std::move(item))) {
+				return true;
+			}
+
+			waitingProducerCount.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			{
+				// The short timeout bounds the cost of a missed wakeup, as in
+				// RingEventQueue.
+				std::unique_lock<Mutex> queueListLock(queueListMutex);
+				queueNotFullConditionVariable.wait_for(queueListLock, std::chrono::milliseconds(1), [this]() -> bool {
+					return ! ring.full();
+				});
+			}
+			waitingProducerCount.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+	// All the waiting consumers are woken up, each one may be waiting for
+	// the event, or for a consumer it depends on.
+	void doNotifyQueueAvailable()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(waitingConsumerCount.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			queueListConditionVariable.notify_all();
+		}
+	}
+
+	void doNotifyQueueNotFull()
+	{
+		if(! blockOnOverflow) {
+			return;
+		}
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(waitingProducerCount.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			queueNotFullConditionVariable.notify_all();
+		}
+	}
+
+private:
+	Ring ring;
+	EVENTPP_ALIGN_CACHELINE mutable typename Threading::template Atomic<int> waitingConsumerCount;
+	typename Threading::template Atomic<int> waitingProducerCount;
+	typename Threading::template Atomic<std::size_t> droppedEventCount;
+	EVENTPP_ALIGN_CACHELINE mutable ConditionVariable queueListConditionVariable;
+	ConditionVariable queueNotFullConditionVariable;
+	mutable Mutex queueListMutex;
+};
+
+} //namespace internal_
+
+template <
+	typename Event_,
+	typename Prototype_,
+	typename Policies_ = DefaultPolicies
+>
+class BroadcastEventQueue : public internal_::InheritMixins<
+		internal_::BroadcastEventQueueBase<Event_, Prototype_, Policies_>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type, public TagEventDispatcher, public TagEventQueue
+{
+private:
+	using super = typename internal_::InheritMixins<
+		internal_::BroadcastEventQueueBase<Event_, Prototype_, Policies_>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type;
+
+public:
+	using super::super;
+};
+
+
+} //namespace eventpp
+
+
+#endif
@@ -15,8 +15,18 @@
 #define CALLBACKLIST_H_588722158669
 
 #include "eventpolicies.h"
-
+#include "internal/callbacklistsnapshot_i.h"
+#include "internal/callbacklistslotmap_i.h"
+#include "internal/epochreclaimer_i.h"
+#include "internal/fanoutcallback_i.h"
+#include "internal/listenergroup_i.h"
+#include "internal/listenerprofiler_i.h"
+#include "internal/parallelinvoke_i.h"
+
+#include <atomic>
 #include <functional>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include <cassert>
@@ -48,30 +58,83 @@ private:
 	using Callback_ = typename SelectCallback<
 		Policies,
 		HasTypeCallback<Policies>::value,
-		std::function<ReturnType (Args...)>
+		typename SelectDefaultCallback<Policies, ReturnType (Args...)>::Type
 	>::Type;
 
+	// OPT-86: A Callback policy other than FanOutCallback can only be copied.
+	using ArgumentFanOut = typename std::conditional<
+		std::is_same<Callback_, FanOutCallback<ReturnType (Args...)> >::value,
+		typename SelectArgumentFanOut<Policies, HasTypeArgumentFanOut<Policies>::value>::Type,
+		ArgumentFanOutCopy
+	>::type;
+	using SharedFanOut = typename std::conditional<
+		std::is_same<ArgumentFanOut, ArgumentFanOutCopy>::value,
+		ArgumentFanOutCopy,
+		ArgumentFanOutShared
+	>::type;
+
 	using CanContinueInvoking = typename SelectCanContinueInvoking<
 		Policies, HasFunctionCanContinueInvoking<Policies, Args...>::value
 	>::Type;
 
+	// OPT-69: Only ReentrancyFull compares the counters, the other modes
+	// don't add listeners while invoking, so the counter only marks the
+	// removed nodes. ReentrancyNone calls the nodes by raw pointers.
+	using Reentrancy = typename SelectReentrancy<
+		Policies, HasTypeReentrancy<Policies>::value
+	>::Type;
+	using HasCounterCheck = std::integral_constant<bool, std::is_same<Reentrancy, ReentrancyFull>::value>;
+	using InvokesRawNodes = std::integral_constant<bool, std::is_same<Reentrancy, ReentrancyNone>::value>;
+
+	// OPT-75: With ProfilerNone the nodes and the calls are not changed.
+	using Profiler = typename SelectProfiler<
+		Policies, HasTypeProfiler<Policies>::value
+	>::Type;
+	using Invoker = ProfileInvoker<Profiler>;
+
+	// OPT-47: With ListenerGroupsNone the group of a node is empty.
+	using ListenerGroup_ = typename SelectListenerGroup<Policies>::Group;
+	using GroupReference = typename SelectListenerGroup<Policies>::Reference;
+
 	struct Node;
 	using NodePtr = std::shared_ptr<Node>;
+	using NodeAllocator = typename SelectNodeAllocator<
+		Node, Policies, HasTemplateNodeAllocator<Policies>::value
+	>::Type;
 
-	struct Node
+	struct Node : public ProfiledNode<Profiler, Node>
 	{
 		using Counter = unsigned int;
 
-		Node(const Callback_ & callback, const Counter counter)
-			: callback(callback), counter(counter)
+		Node(const Callback_ & callback, const Counter counter, GroupReference group)
+			: ProfiledNode<Profiler, Node>(), callback(callback), counter(counter), published(false), group(std::move(group))
 		{
 		}
 
 		NodePtr previous;
 		NodePtr next;
 		Callback_ callback;
-		Counter counter;
+		// OPT-69: Read without the lock by the walks, so it's atomic, relaxed
+		// is enough since the node itself is published under the lock.
+		std::atomic<Counter> counter;
+		// Has been singleNode, a reader may still use it without a reference.
+		bool published;
+		// OPT-76: Added with a priority, and in priorityIndex. Only touched
+		// under the lock.
+		bool prioritized = false;
+		// The empty group of ListenerGroupsNone fits in the padding here.
+		GroupReference group;
+		int priority = 0;
+	};
+
+	// OPT-76: The first and the last node of each priority. The index is
+	// ordered ascending, the list is descending.
+	struct PriorityRange
+	{
+		Node * first;
+		Node * last;
 	};
+	using PriorityIndex = std::map<int, PriorityRange>;
 
 	class Handle_ : public std::weak_ptr<Node>
 	{
@@ -102,7 +165,9 @@ public:
 			head(),
 			tail(),
 			mutex(),
-			currentCounter(0)
+			currentCounter(0),
+			singleNode(nullptr),
+			priorityIndex()
 	{
 	}
 
@@ -123,18 +188,14 @@ public:
 	CallbackListBase & operator = (const CallbackListBase & other) {
 		if(this != &other) {
 			CallbackListBase copied(other);
-			swap(copied);
+			doMoveFrom(copied);
 		}
 		return *this;
 	}
 
 	CallbackListBase & operator = (CallbackListBase && other) noexcept {
 		if(this != &other) {
-			doFreeAllNodes();
-
-			head = std::move(other.head);
-			tail = std::move(other.tail);
-			currentCounter = other.currentCounter.load();
+			doMoveFrom(other);
 		}
 		return *this;
 	}
@@ -142,7 +203,8 @@ public:
 	~CallbackListBase()	{
 		// Don't lock mutex here since it may throw exception
 
-		doFreeAllNodes();
+		// No reader can be in a list which is destroyed.
+		doFreeAllNodes(false);
 	}
 	
 	void swap(CallbackListBase & other) noexcept {
@@ -150,10 +212,15 @@ public:
 		
 		swap(head, other.head);
 		swap(tail, other.tail);
+		swap(priorityIndex, other.priorityIndex);
 
 		const auto value = currentCounter.load();
 		currentCounter.exchange(other.currentCounter.load());
 		other.currentCounter.exchange(value);
+
+		Node * const node = singleNode.load(std::memory_order_relaxed);
+		singleNode.store(other.singleNode.load(std::memory_order_relaxed), std::memory_order_release);
+		other.singleNode.store(node, std::memory_order_release);
 	}
 
 	bool empty() const {
@@ -169,61 +236,121 @@ public:
 		return ! empty();
 	}
 
+	// OPT-68: Allocate count nodes from NodeAllocator and free them, so a pool
+	// such as PoolAllocator grows before the listeners are added.
+	void reserveNodes(const size_t count)
+	{
+		std::vector<NodePtr> nodeList;
+		nodeList.reserve(count);
+		for(size_t i = 0; i < count; ++i) {
+			nodeList.push_back(std::allocate_shared<Node>(NodeAllocator(), Callback(), removedCounter, GroupReference()));
+		}
+	}
+
 	Handle append(const Callback & callback)
 	{
-		NodePtr node(doAllocateNode(callback));
+		return doAppend(doAllocateNode(callback, GroupReference()));
+	}
 
-		std::lock_guard<Mutex> lockGuard(mutex);
+	// OPT-47: The functions taking a group only exist with the
+	// ListenerGroupsEnabled policy.
+	Handle append(const Callback & callback, ListenerGroup_ & group)
+	{
+		return doAppend(doAllocateNode(callback, group.doGetReference()));
+	}
 
-		if(head) {
-			node->previous = tail;
-			tail->next = node;
-			tail = node;
-		}
-		else {
-			head = node;
-			tail = node;
-		}
+	// OPT-76: The listeners added with a priority are called in the order of
+	// the priority, the greater first, and in the order they are added for
+	// the same priority. An index of the priorities finds the place in
+	// O(log n) instead of walking the list. The listeners added without a
+	// priority are not in the index, and stay where they are put.
+	Handle append(const Callback & callback, const int priority)
+	{
+		return doAppendWithPriority(doAllocateNode(callback, GroupReference()), priority);
+	}
 
-		return Handle(node);
+	Handle append(const Callback & callback, const int priority, ListenerGroup_ & group)
+	{
+		return doAppendWithPriority(doAllocateNode(callback, group.doGetReference()), priority);
 	}
 
-	Handle prepend(const Callback & callback)
+	// OPT-87: Same as append for each callback of [first, last), in order,
+	// but the nodes take one counter, they are linked to each other before
+	// the list is locked, and the chain is linked to the list under one lock.
+	template <typename Iterator>
+	void appendBulk(Iterator first, Iterator last)
 	{
-		NodePtr node(doAllocateNode(callback));
+		doAppendBulk(first, last, BulkItemSelf(), DiscardIterator());
+	}
+
+	// The handles are written to handles in order, returns the end of them.
+	template <typename Iterator, typename OutputIterator>
+	OutputIterator appendBulk(Iterator first, Iterator last, OutputIterator handles)
+	{
+		return doAppendBulk(first, last, BulkItemSelf(), handles);
+	}
+
+	// Used by EventDispatcher::appendListeners, getCallback(*iterator) is
+	// the callback.
+	template <typename Iterator, typename GetCallback, typename OutputIterator>
+	OutputIterator doAppendBulk(Iterator first, Iterator last, GetCallback && getCallback, OutputIterator handles)
+	{
+		if(first == last) {
+			return handles;
+		}
+
+		const Counter counter = getNextCounter();
+		NodePtr chainHead;
+		NodePtr chainTail;
+		for(; first != last; ++first) {
+			const auto & item = *first;
+			NodePtr node(std::allocate_shared<Node>(NodeAllocator(), getCallback(item), counter, GroupReference()));
+			node->initProfile(node, nullptr);
+			*handles = Handle(node);
+			++handles;
+			if(chainTail) {
+				node->previous = chainTail;
+				chainTail->next = node;
+			}
+			else {
+				chainHead = node;
+			}
+			chainTail = std::move(node);
+		}
 
 		std::lock_guard<Mutex> lockGuard(mutex);
 
 		if(head) {
-			node->next = head;
-			head->previous = node;
-			head = node;
+			chainHead->previous = tail;
+			tail->next = chainHead;
 		}
 		else {
-			head = node;
-			tail = node;
+			head = chainHead;
 		}
+		tail = chainTail;
+		doUpdateSingleNode();
 
-		return Handle(node);
+		return handles;
 	}
 
-	Handle insert(const Callback & callback, const Handle & before)
+	Handle prepend(const Callback & callback)
 	{
-		// Disable this assertion because it's too slow in debug mode.
-		//assert(before.expired() || ownsHandle(before));
-
-		NodePtr beforeNode = before.lock();
-		if(beforeNode) {
-			NodePtr node(doAllocateNode(callback));
-
-			std::lock_guard<Mutex> lockGuard(mutex);
+		return doPrepend(doAllocateNode(callback, GroupReference()));
+	}
 
-			doInsert(node, beforeNode);
+	Handle prepend(const Callback & callback, ListenerGroup_ & group)
+	{
+		return doPrepend(doAllocateNode(callback, group.doGetReference()));
+	}
 
-			return Handle(node);
-		}
+	Handle insert(const Callback & callback, const Handle & before)
+	{
+		return doInsertBefore(callback, before, GroupReference());
+	}
 
-		return append(callback);
+	Handle insert(const Callback & callback, const Handle & before, ListenerGroup_ & group)
+	{
+		return doInsertBefore(callback, before, group.doGetReference());
 	}
 
 	bool remove(const Handle & handle)
@@ -231,17 +358,31 @@ public:
 		// Disable this assertion because it's too slow in debug mode.
 		//assert(handle.expired() || ownsHandle(handle));
 
-		// It looks like the lock can be put inside the `if` below,
-		// but that doesn't work in multi-threading and cause related unit tests fail.
-		std::lock_guard<Mutex> lockGuard(mutex);
+		NodePtr retiredNode;
+		{
+			// It looks like the lock can be put inside the `if` below,
+			// but that doesn't work in multi-threading and cause related unit tests fail.
+			std::lock_guard<Mutex> lockGuard(mutex);
 
-		auto node = handle.lock();
-		if(node) {
+			auto node = handle.lock();
+			// A node of a removed group may be unlinked by a traversal
+			// while the handle still holds it.
+			if(! node || ! doIsLinked(node)) {
+				return false;
+			}
 			doFreeNode(node);
-			return true;
+			doUpdateSingleNode();
+			if(doIsHeldByReader(node.get())) {
+				retiredNode = node;
+			}
 		}
 
-		return false;
+		// OPT-39: A reader of the fast path may still be calling it.
+		if(retiredNode) {
+			EpochReclaimer::retire(std::move(retiredNode));
+		}
+
+		return true;
 	}
 
 	bool ownsHandle(const Handle & handle) const
@@ -259,10 +400,25 @@ public:
 		return false;
 	}
 
+	// OPT-75: The profiler reports the listener with the tag, which must
+	// live as long as the listener, such as a string literal.
+	static bool setProfileTag(const Handle & handle, const char * tag)
+	{
+		static_assert(! std::is_same<Profiler, ProfilerNone>::value,
+			"CallbackList: setProfileTag needs a Profiler in the policies.");
+
+		const NodePtr node = handle.lock();
+		if(! node) {
+			return false;
+		}
+		node->setProfileTag(tag);
+		return true;
+	}
+
 	template <typename Func>
 	void forEach(Func && func) const
 	{
-		doForEachIf([&func, this](NodePtr & node) -> bool {
+		doForEachIf([&func, this](const NodePtr & node) -> bool {
 			doForEachInvoke<void>(func, node);
 			return true;
 		});
@@ -271,7 +427,7 @@ public:
 	template <typename Func>
 	bool forEachIf(Func && func) const
 	{
-		return doForEachIf([&func, this](NodePtr & node) -> bool {
+		return doForEachIf([&func, this](const NodePtr & node) -> bool {
 			return doForEachInvoke<bool>(func, node);
 		});
 	}
@@ -279,15 +435,20 @@ public:
 #if !defined(__GNUC__) || __GNUC__ >= 5
 	void operator() (Args ...args) const
 	{
-		forEachIf([&args...](Callback & callback) -> bool {
-			// We can't use std::forward here, because if we use std::forward,
-			// for arg that is passed by value, and the callback prototype accepts it by value,
-			// std::forward will move it and may cause the original value invalid.
-			// That happens on any value-to-value passing, no matter the callback moves it or not.
+		ProfileDispatchScope<Profiler> profileScope(this);
 
-			callback(args...);
-			return CanContinueInvoking::canContinueInvoking(args...);
-		});
+		doInvokeListeners(ArgumentFanOut(), args...);
+	}
+
+	// OPT-86: Same as operator(), but the arguments passed by value are
+	// given by reference, so they are not copied to make the call, and they
+	// are never moved to a listener. With an ArgumentFanOut policy, the
+	// listeners which take them by const reference get these ones.
+	void invokeShared(typename FanOutPass<Args>::Argument ...args) const
+	{
+		ProfileDispatchScope<Profiler> profileScope(this);
+
+		doInvokeListeners(SharedFanOut(), args...);
 	}
 #else
 	// This is a patch version for GCC 4. It inlines the unrolled doForEachIf.
@@ -297,7 +458,8 @@ public:
 	// We don't use the patch as main code because the patch generates longer code, and duplicated with doForEachIf.
 	void operator() (Args ...args) const
 	{
-		const Counter counter = currentCounter.load(std::memory_order_acquire);
+		ProfileDispatchScope<Profiler> profileScope(this);
+		const Counter counter = doLoadCounter();
 
 		// OPT-2: Batched prefetch traversal — same as doForEachIf.
 		static constexpr size_t kBatchSize = 8;
@@ -322,8 +484,9 @@ public:
 
 			bool shouldBreak = false;
 			for(size_t i = 0; i < count; ++i) {
-				if(batch[i]->counter != removedCounter && counter >= batch[i]->counter) {
-					batch[i]->callback(args...);
+				if(doCanInvokeNode(counter, batch[i].get())
+					&& ! batch[i]->group.isRemoved()) {
+					Invoker::invoke(this, batch[i].get(), args...);
 					if(! CanContinueInvoking::canContinueInvoking(args...)) {
 						shouldBreak = true;
 						break;
@@ -348,14 +511,330 @@ public:
 			}
 		}
 	}
+
+	void invokeShared(typename FanOutPass<Args>::Argument ...args) const
+	{
+		(*this)(args...);
+	}
 #endif
 
+	// OPT-64: Calls the listeners in parallel, on the calling thread and on
+	// the tasks posted by executor.post(task), and returns when all of them
+	// return. The listeners are the ones in the list when the call starts,
+	// a listener removed during the call may be not called, the order is not
+	// kept, and the listeners get the same arguments at the same time.
+	// If the policies have canContinueInvoking, it's same as operator().
+	template <typename Executor>
+	void invokeParallel(Executor & executor, Args ...args) const
+	{
+		doInvokeParallel(
+			executor,
+			std::integral_constant<bool, HasFunctionCanContinueInvoking<Policies, Args...>::value>(),
+			args...
+		);
+	}
+
 private:
+	template <typename ...A>
+	void doInvokeListeners(ArgumentFanOutCopy, A & ...args) const
+	{
+		if(doInvokeSingleNode(ArgumentFanOutCopy(), args...)) {
+			return;
+		}
+
+		doInvokeEachIf([this, &args...](const NodePtr & node) -> bool {
+			// We can't use std::forward here, because if we use std::forward,
+			// for arg that is passed by value, and the callback prototype accepts it by value,
+			// std::forward will move it and may cause the original value invalid.
+			// That happens on any value-to-value passing, no matter the callback moves it or not.
+
+			Invoker::invoke(this, node.get(), args...);
+			return CanContinueInvoking::canContinueInvoking(args...);
+		});
+	}
+
+	// OPT-86: A listener is called when the next one is found, so the last
+	// one is known, it gets the arguments moved with ArgumentFanOutMoveLast.
+	template <typename Mode, typename ...A>
+	void doInvokeListeners(Mode, A & ...args) const
+	{
+		if(doInvokeSingleNode(Mode(), args...)) {
+			return;
+		}
+
+		NodePtr pending;
+		doInvokeEachIf([this, &pending, &args...](const NodePtr & node) -> bool {
+			if(pending) {
+				doInvokeNode(ArgumentFanOutShared(), pending.get(), args...);
+				if(! CanContinueInvoking::canContinueInvoking(args...)) {
+					pending.reset();
+					return false;
+				}
+				// The listener may have removed the next one.
+				if(node->counter.load(std::memory_order_relaxed) == removedCounter || node->group.isRemoved()) {
+					pending.reset();
+					return true;
+				}
+			}
+			pending = node;
+			return true;
+		});
+		if(pending) {
+			doInvokeNode(Mode(), pending.get(), args...);
+		}
+	}
+
+	template <typename ...A>
+	void doInvokeNode(ArgumentFanOutCopy, Node * node, A & ...args) const
+	{
+		Invoker::invoke(this, node, args...);
+	}
+
+	template <typename ...A>
+	void doInvokeNode(ArgumentFanOutShared, Node * node, A & ...args) const
+	{
+		Invoker::invokeWith(this, node, [&args...](const Callback_ & callback) {
+			callback.callShared(args...);
+		});
+	}
+
+	template <typename ...A>
+	void doInvokeNode(ArgumentFanOutMoveLast, Node * node, A & ...args) const
+	{
+		Invoker::invokeWith(this, node, [&args...](const Callback_ & callback) {
+			callback.callMoving(args...);
+		});
+	}
+
+	template <typename Executor>
+	void doInvokeParallel(Executor & /*executor*/, std::true_type, Args ...args) const
+	{
+		(*this)(args...);
+	}
+
+	template <typename Executor>
+	void doInvokeParallel(Executor & executor, std::false_type, Args ...args) const
+	{
+		std::vector<NodePtr> nodeList;
+		doForEachIf([&nodeList](const NodePtr & node) -> bool {
+			nodeList.push_back(node);
+			return true;
+		});
+
+		internal_::parallelInvoke(executor, nodeList.size(), [this, &nodeList, &args...](const std::size_t index) {
+			const NodePtr & node = nodeList[index];
+			if(node->counter.load(std::memory_order_relaxed) != removedCounter && ! node->group.isRemoved()) {
+				// Don't std::forward, see operator().
+				Invoker::invoke(this, node.get(), args...);
+			}
+		});
+	}
+
+	// OPT-39: A list which has one node calls it with no lock and no
+	// reference count. singleNode is only checked before entering the read
+	// guard, so the lists which have more nodes don't pay for the guard.
+	// Returns false if the list doesn't have exactly one node.
+	template <typename Mode, typename ...A>
+	bool doInvokeSingleNode(Mode, A & ...args) const
+	{
+		if(singleNode.load(std::memory_order_relaxed) == nullptr) {
+			return false;
+		}
+
+		EpochReclaimer::ReadGuard readGuard;
+		Node * const node = singleNode.load(std::memory_order_acquire);
+		if(node == nullptr) {
+			return false;
+		}
+
+		// The general path unlinks the node of a removed group.
+		if(node->group.isRemoved()) {
+			return false;
+		}
+
+		const Counter counter = doLoadCounter();
+		if(doCanInvokeNode(counter, node)) {
+			doInvokeNode(Mode(), node, args...);
+
+			// The nodes appended by the callback are skipped by the counter,
+			// unless the counter overflowed and all nodes were renumbered.
+			// Go on as the general path does. With ArgumentFanOutMoveLast the
+			// arguments are moved, and the appended nodes are skipped.
+			if(! std::is_same<Mode, ArgumentFanOutMoveLast>::value
+				&& singleNode.load(std::memory_order_relaxed) != node
+				&& CanContinueInvoking::canContinueInvoking(args...)) {
+				NodePtr next;
+				{
+					std::lock_guard<Mutex> lockGuard(mutex);
+					next = node->next;
+				}
+				doForEachIfFrom(counter, next, [this, &args...](const NodePtr & n) -> bool {
+					doInvokeNode(Mode(), n.get(), args...);
+					return CanContinueInvoking::canContinueInvoking(args...);
+				});
+			}
+		}
+		return true;
+	}
+
+	// Must be called under the lock.
+	void doUpdateSingleNode() const
+	{
+		Node * node = nullptr;
+		if(head && ! head->next) {
+			node = head.get();
+			node->published = true;
+		}
+		singleNode.store(node, std::memory_order_release);
+	}
+
+	// The nodes are passed by owning references, f may keep them after
+	// the walk.
 	template <typename F>
 	bool doForEachIf(F && f) const
 	{
-		const Counter counter = currentCounter.load(std::memory_order_acquire);
+		const Counter counter = doLoadCounter();
+
+		NodePtr node;
+		{
+			std::lock_guard<Mutex> lockGuard(mutex);
+			node = head;
+		}
+
+		return doForEachIfFrom(counter, node, f);
+	}
+
+	// The walk of the invoking. f must not keep the nodes after it returns.
+	template <typename F>
+	bool doInvokeEachIf(F && f) const
+	{
+		return doInvokeEachIf(f, InvokesRawNodes());
+	}
+
+	template <typename F>
+	bool doInvokeEachIf(F && f, std::false_type) const
+	{
+		return doForEachIf(f);
+	}
+
+	// OPT-69: ReentrancyNone, the nodes are taken under one lock, as raw
+	// pointers, without touching any reference count, then the lock is
+	// released before they are called, so the listeners may change the
+	// list and the other threads may invoke it at the same time. The read
+	// guard keeps the nodes alive, a removed node is retired, not freed,
+	// and skipped. The nodes are given to f as non-owning NodePtr, which
+	// have no reference count either.
+	// The nodes of the removed groups are skipped, and unlinked after the walk.
+	template <typename F>
+	bool doInvokeEachIf(F && f, std::true_type) const
+	{
+		EpochReclaimer::ReadGuard readGuard;
+
+		// A nested invoking puts its nodes after the ones of the outer
+		// invoking, and drops them when it returns.
+		struct InvokeNodeRange
+		{
+			~InvokeNodeRange() {
+				nodeList.resize(begin);
+			}
+
+			std::vector<Node *> & nodeList;
+			size_t begin;
+		};
+		InvokeNodeRange range { doGetInvokeNodeList(), doGetInvokeNodeList().size() };
+
+		bool hasRemovedGroup = false;
+		{
+			std::lock_guard<Mutex> lockGuard(mutex);
+			for(Node * node = head.get(); node != nullptr; node = node->next.get()) {
+				if(node->group.isRemoved()) {
+					hasRemovedGroup = true;
+				}
+				else {
+					range.nodeList.push_back(node);
+				}
+			}
+		}
+
+		const Counter counter = doLoadCounter();
+		const size_t end = range.nodeList.size();
+		bool result = true;
+		for(size_t i = range.begin; i < end; ++i) {
+			// Not kept by reference, a nested invoking may grow the list.
+			Node * const node = range.nodeList[i];
+			if(doCanInvokeNode(counter, node) && ! node->group.isRemoved()) {
+				if(! f(NodePtr(NodePtr(), node))) {
+					result = false;
+					break;
+				}
+			}
+		}
+
+		if(hasRemovedGroup) {
+			std::vector<NodePtr> retiredList;
+			{
+				std::lock_guard<Mutex> lockGuard(mutex);
+				doUnlinkRemovedGroups(retiredList);
+			}
+			for(NodePtr & node : retiredList) {
+				EpochReclaimer::retire(std::move(node));
+			}
+		}
+
+		return result;
+	}
+
+	// The buffer of the nodes taken by the invokings on this thread, it's
+	// only allocated when it grows.
+	static std::vector<Node *> & doGetInvokeNodeList()
+	{
+		static thread_local std::vector<Node *> nodeList;
+		return nodeList;
+	}
 
+	// OPT-39, OPT-69: A reader may call a node without a reference if the
+	// node has been singleNode, or any node with ReentrancyNone. These nodes
+	// are retired when they are removed, not freed.
+	static bool doIsHeldByReader(const Node * node)
+	{
+		return InvokesRawNodes::value || node->published;
+	}
+
+	// Must be called under the lock. Unlinks the nodes of the removed groups,
+	// the ones a reader may hold are added to retiredList, to be retired after the
+	// lock is released.
+	void doUnlinkRemovedGroups(std::vector<NodePtr> & retiredList) const
+	{
+		NodePtr node = head;
+		while(node) {
+			NodePtr next = node->next;
+			if(node->group.isRemoved()) {
+				doUnlinkNode(node);
+				if(doIsHeldByReader(node.get())) {
+					retiredList.push_back(std::move(node));
+				}
+			}
+			node = std::move(next);
+		}
+		doUpdateSingleNode();
+	}
+
+	Counter doLoadCounter() const
+	{
+		return HasCounterCheck::value ? currentCounter.load(std::memory_order_acquire) : Counter(1);
+	}
+
+	// OPT-69: Without the counter check, a node is called unless it's removed.
+	bool doCanInvokeNode(const Counter counter, const Node * node) const
+	{
+		const Counter nodeCounter = node->counter.load(std::memory_order_relaxed);
+		return nodeCounter != removedCounter
+			&& (! HasCounterCheck::value || counter >= nodeCounter);
+	}
+
+	template <typename F>
+	bool doForEachIfFrom(const Counter counter, NodePtr & node, F && f) const
+	{
 		// OPT-2: Batched prefetch traversal.
 		// Original: locks/unlocks mutex for EACH node->next read (N lock pairs).
 		// Optimized: lock once to prefetch a batch of upcoming nodes, then iterate
@@ -364,28 +843,42 @@ private:
 		// visible in subsequent batches) while reducing lock operations by ~8x.
 		static constexpr size_t kBatchSize = 8;
 		NodePtr batch[kBatchSize];
-
-		NodePtr node;
-		{
-			std::lock_guard<Mutex> lockGuard(mutex);
-			node = head;
-		}
+		NodePtr retiredBatch[kBatchSize];
 
 		while(node) {
 			// Prefetch a batch of nodes under one lock
 			size_t count = 0;
+			size_t unlinkedCount = 0;
+			size_t retiredCount = 0;
 			{
 				std::lock_guard<Mutex> lockGuard(mutex);
 				NodePtr cur = node;
 				while(cur && count < kBatchSize) {
+					// OPT-47: The lock is held anyway, unlink the nodes of the
+					// removed groups. They stay in the batch, and are skipped.
+					if(cur->group.isRemoved() && doIsLinked(cur)) {
+						doUnlinkNode(cur);
+						++unlinkedCount;
+						if(doIsHeldByReader(cur.get())) {
+							retiredBatch[retiredCount++] = cur;
+						}
+					}
 					batch[count++] = cur;
 					cur = cur->next;
 				}
+				if(unlinkedCount > 0) {
+					doUpdateSingleNode();
+				}
+			}
+			// OPT-39: A reader of the fast path may still be calling them.
+			for(size_t i = 0; i < retiredCount; ++i) {
+				EpochReclaimer::retire(std::move(retiredBatch[i]));
 			}
 
 			// Iterate the batch without lock
 			for(size_t i = 0; i < count; ++i) {
-				if(batch[i]->counter != removedCounter && counter >= batch[i]->counter) {
+				if(doCanInvokeNode(counter, batch[i].get())
+					&& ! batch[i]->group.isRemoved()) {
 					if(! f(batch[i])) {
 						// Clear batch to release shared_ptr refs
 						for(size_t j = 0; j < count; ++j) {
@@ -412,19 +905,164 @@ private:
 	}
 
 	template <typename RT, typename Func>
-	auto doForEachInvoke(Func && func, NodePtr & node) const
+	auto doForEachInvoke(Func && func, const NodePtr & node) const
 		-> typename std::enable_if<CanInvoke<Func, Handle, Callback &>::value, RT>::type
 	{
 		return func(Handle(node), node->callback);
 	}
 
 	template <typename RT, typename Func>
-	auto doForEachInvoke(Func && func, NodePtr & node) const
+	auto doForEachInvoke(Func && func, const NodePtr & node) const
 		-> typename std::enable_if<CanInvoke<Func, Callback &>::value, RT>::type
 	{
 		return func(node->callback);
 	}
 
+	Handle doAppend(NodePtr node)
+	{
+		std::lock_guard<Mutex> lockGuard(mutex);
+
+		doLinkTail(node);
+		doUpdateSingleNode();
+
+		return Handle(node);
+	}
+
+	Handle doAppendWithPriority(NodePtr node, const int priority)
+	{
+		std::lock_guard<Mutex> lockGuard(mutex);
+
+		if(! priorityIndex) {
+			priorityIndex.reset(new PriorityIndex());
+		}
+
+		// After the last node of the smallest priority which is not less,
+		// else before the first node of the greatest priority.
+		auto it = priorityIndex->lower_bound(priority);
+		if(it != priorityIndex->end()) {
+			NodePtr afterNode(doGetNodePtr(it->second.last));
+			doInsertAfter(node, afterNode);
+		}
+		else if(! priorityIndex->empty()) {
+			NodePtr beforeNode(doGetNodePtr(priorityIndex->rbegin()->second.first));
+			doInsert(node, beforeNode);
+		}
+		else {
+			doLinkTail(node);
+		}
+		doUpdateSingleNode();
+
+		node->prioritized = true;
+		node->priority = priority;
+		if(it != priorityIndex->end() && it->first == priority) {
+			it->second.last = node.get();
+		}
+		else {
+			priorityIndex->emplace_hint(it, priority, PriorityRange { node.get(), node.get() });
+		}
+
+		return Handle(node);
+	}
+
+	// Must be called under the lock.
+	void doLinkTail(NodePtr & node)
+	{
+		if(head) {
+			node->previous = tail;
+			tail->next = node;
+			tail = node;
+		}
+		else {
+			head = node;
+			tail = node;
+		}
+	}
+
+	// Must be called under the lock.
+	void doInsertAfter(NodePtr & node, NodePtr & afterNode)
+	{
+		node->previous = afterNode;
+		node->next = afterNode->next;
+		if(afterNode->next) {
+			afterNode->next->previous = node;
+		}
+		afterNode->next = node;
+
+		if(afterNode == tail) {
+			tail = node;
+		}
+	}
+
+	// Must be called under the lock, node must be linked.
+	NodePtr doGetNodePtr(const Node * node) const
+	{
+		return node->previous ? node->previous->next : head;
+	}
+
+	// Must be called under the lock, before node is unlinked. The other
+	// nodes of the same priority are between first and last.
+	void doRemoveFromPriorityIndex(Node * node) const
+	{
+		node->prioritized = false;
+
+		auto it = priorityIndex->find(node->priority);
+		PriorityRange & range = it->second;
+		if(range.first == node && range.last == node) {
+			priorityIndex->erase(it);
+		}
+		else if(range.first == node) {
+			Node * next = node->next.get();
+			while(! next->prioritized || next->priority != node->priority) {
+				next = next->next.get();
+			}
+			range.first = next;
+		}
+		else if(range.last == node) {
+			Node * previous = node->previous.get();
+			while(! previous->prioritized || previous->priority != node->priority) {
+				previous = previous->previous.get();
+			}
+			range.last = previous;
+		}
+	}
+
+	Handle doPrepend(NodePtr node)
+	{
+		std::lock_guard<Mutex> lockGuard(mutex);
+
+		if(head) {
+			node->next = head;
+			head->previous = node;
+			head = node;
+		}
+		else {
+			head = node;
+			tail = node;
+		}
+		doUpdateSingleNode();
+
+		return Handle(node);
+	}
+
+	Handle doInsertBefore(const Callback & callback, const Handle & before, GroupReference group)
+	{
+		// Disable this assertion because it's too slow in debug mode.
+		//assert(before.expired() || ownsHandle(before));
+
+		NodePtr node(doAllocateNode(callback, std::move(group)));
+		NodePtr beforeNode = before.lock();
+		if(beforeNode) {
+			std::lock_guard<Mutex> lockGuard(mutex);
+
+			doInsert(node, beforeNode);
+			doUpdateSingleNode();
+
+			return Handle(node);
+		}
+
+		return doAppend(std::move(node));
+	}
+
 	void doInsert(NodePtr & node, NodePtr & beforeNode)
 	{
 		node->previous = beforeNode->previous;
@@ -439,13 +1077,33 @@ private:
 		}
 	}
 	
-	NodePtr doAllocateNode(const Callback & callback)
+	NodePtr doAllocateNode(const Callback & callback, GroupReference group)
 	{
-		return std::make_shared<Node>(callback, getNextCounter());
+		NodePtr node(std::allocate_shared<Node>(NodeAllocator(), callback, getNextCounter(), std::move(group)));
+		node->initProfile(node, nullptr);
+		return node;
 	}
 	
 	void doFreeNode(NodePtr & node)
 	{
+		// Mark it as deleted, this must be before unlinking,
+		// because node can be a reference to head or tail, and after the assignment, node
+		// can be null pointer.
+		node->counter.store(removedCounter, std::memory_order_relaxed);
+
+		doUnlinkNode(node);
+	}
+
+	// Must be called under the lock. It's const as the traversal unlinks the
+	// nodes of the removed groups. It doesn't touch the counter, which the
+	// readers read without the lock, they skip the nodes by the group.
+	// node is a copy, it can't be a reference to head or tail.
+	void doUnlinkNode(const NodePtr node) const
+	{
+		if(node->prioritized) {
+			doRemoveFromPriorityIndex(node.get());
+		}
+
 		if(node->next) {
 			node->next->previous = node->previous;
 		}
@@ -453,11 +1111,6 @@ private:
 			node->previous->next = node->next;
 		}
 
-		// Mark it as deleted, this must be before the assignment of head and tail below,
-		// because node can be a reference to head or tail, and after the assignment, node
-		// can be null pointer.
-		node->counter = removedCounter;
-
 		if(head == node) {
 			head = node->next;
 		}
@@ -469,13 +1122,43 @@ private:
 		// because node may be still used in a loop.
 	}
 
-	void doFreeAllNodes() {
+	// Must be called under the lock.
+	bool doIsLinked(const NodePtr & node) const
+	{
+		return node == head || (node->previous && node->previous->next == node);
+	}
+
+	// OPT-39: Under the lock, a reader of the fast path which is still in
+	// the old single node reads its next under the lock.
+	void doMoveFrom(CallbackListBase & other) noexcept
+	{
+		std::lock_guard<Mutex> lockGuard(mutex);
+		doFreeAllNodes(true);
+
+		head = std::move(other.head);
+		tail = std::move(other.tail);
+		currentCounter = other.currentCounter.load();
+		singleNode.store(other.singleNode.load(std::memory_order_relaxed), std::memory_order_release);
+		other.singleNode.store(nullptr, std::memory_order_release);
+		priorityIndex = std::move(other.priorityIndex);
+	}
+
+	// OPT-39: A reader of the fast path may still be calling a node which
+	// has been singleNode, by its raw pointer, while the list is assigned,
+	// so these nodes are retired instead of freed.
+	void doFreeAllNodes(const bool mayBeRead) {
+		singleNode.store(nullptr, std::memory_order_release);
+		priorityIndex.reset();
 		NodePtr node = head;
 		head.reset();
+		tail.reset();
 		while(node) {
 			NodePtr next = node->next;
 			node->previous.reset();
 			node->next.reset();
+			if(mayBeRead && doIsHeldByReader(node.get())) {
+				EpochReclaimer::retire(std::move(node));
+			}
 			node = next;
 		}
 		node.reset();
@@ -483,13 +1166,18 @@ private:
 
 	Counter getNextCounter()
 	{
+		// OPT-69: The counter is only compared with ReentrancyFull.
+		if(! HasCounterCheck::value) {
+			return 1;
+		}
+
 		Counter result = ++currentCounter;;
 		if(result == 0) { // overflow, let's reset all nodes' counters.
 			{
 				std::lock_guard<Mutex> lockGuard(mutex);
 				NodePtr node = head;
 				while(node) {
-					node->counter = 1;
+					node->counter.store(1, std::memory_order_relaxed);
 					node = node->next;
 				}
 			}
@@ -504,7 +1192,28 @@ private:
 		NodePtr node;
 		const Counter counter = getNextCounter();
 		while(fromNode) {
-			const NodePtr nextNode(std::make_shared<Node>(fromNode->callback, counter));
+			// The copy doesn't belong to the group, and the removed ones are not copied.
+			if(fromNode->group.isRemoved()) {
+				fromNode = fromNode->next;
+				continue;
+			}
+			const NodePtr nextNode(std::allocate_shared<Node>(NodeAllocator(), fromNode->callback, counter, GroupReference()));
+			nextNode->initProfile(nextNode, fromNode->getProfileTag());
+			// The nodes are copied in order, each one is the last of its priority.
+			if(fromNode->prioritized) {
+				if(! priorityIndex) {
+					priorityIndex.reset(new PriorityIndex());
+				}
+				nextNode->prioritized = true;
+				nextNode->priority = fromNode->priority;
+				auto it = priorityIndex->find(fromNode->priority);
+				if(it == priorityIndex->end()) {
+					priorityIndex->emplace(fromNode->priority, PriorityRange { nextNode.get(), nextNode.get() });
+				}
+				else {
+					it->second.last = nextNode.get();
+				}
+			}
 
 			nextNode->previous = node;
 
@@ -521,14 +1230,38 @@ private:
 		}
 
 		tail = node;
+		doUpdateSingleNode();
 	}
 
 private:
-	NodePtr head;
-	NodePtr tail;
+	// mutable as the traversal unlinks the nodes of the removed groups.
+	mutable NodePtr head;
+	mutable NodePtr tail;
 	mutable Mutex mutex;
 	typename Threading::template Atomic<Counter> currentCounter;
+	mutable typename Threading::template Atomic<Node *> singleNode;
+	// OPT-76: Allocated when the first listener with a priority is added.
+	mutable std::unique_ptr<PriorityIndex> priorityIndex;
+
+};
+
+
+template <typename Prototype, typename Policies>
+struct SelectCallbackListBase
+{
+	using ListenerStorage = typename SelectListenerStorage<
+		Policies, HasTypeListenerStorage<Policies>::value
+	>::Type;
 
+	using Type = typename std::conditional<
+		std::is_same<ListenerStorage, ListenerStorageSnapshot>::value,
+		CallbackListSnapshotBase<Prototype, Policies>,
+		typename std::conditional<
+			std::is_same<ListenerStorage, ListenerStorageSlotMap>::value,
+			CallbackListSlotMapBase<Prototype, Policies>,
+			CallbackListBase<Prototype, Policies>
+		>::type
+	>::type;
 };
 
 
@@ -539,10 +1272,10 @@ template <
 	typename Prototype_,
 	typename Policies_ = DefaultPolicies
 >
-class CallbackList : public internal_::CallbackListBase<Prototype_, Policies_>, public TagCallbackList
+class CallbackList : public internal_::SelectCallbackListBase<Prototype_, Policies_>::Type, public TagCallbackList
 {
 private:
-	using super = internal_::CallbackListBase<Prototype_, Policies_>;
+	using super = typename internal_::SelectCallbackListBase<Prototype_, Policies_>::Type;
 	
 public:
 	using super::super;
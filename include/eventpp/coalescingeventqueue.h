@@ -0,0 +1,568 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef COALESCINGEVENTQUEUE_H_EVENTPP
+#define COALESCINGEVENTQUEUE_H_EVENTPP
+
+#include "eventdispatcher.h"
+#include "internal/eventqueue_i.h"
+#include "internal/spinwait_i.h"
+
+#include <list>
+#include <tuple>
+#include <chrono>
+#include <thread>
+#include <type_traits>
+
+namespace eventpp {
+
+namespace internal_ {
+
+template <typename T, typename ...Args>
+struct HasFunctionCoalesceKey
+{
+	template <typename C> static std::true_type test(decltype(C::coalesceKey(std::declval<Args>()...)) *) ;
+	template <typename C> static std::false_type test(...);
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+
+// The key is the result of Policies::coalesceKey(event, args...) if it exists,
+// otherwise the event itself.
+template <typename Policies, typename Event, bool, typename ...Args>
+struct SelectCoalesceKey
+{
+	using Type = typename std::decay<decltype(Policies::coalesceKey(std::declval<const Event &>(), std::declval<const Args &>()...))>::type;
+
+	template <typename ...A>
+	static Type getKey(const Event & e, const A & ...args) {
+		return Policies::coalesceKey(e, args...);
+	}
+};
+
+template <typename Policies, typename Event, typename ...Args>
+struct SelectCoalesceKey <Policies, Event, false, Args...>
+{
+	using Type = Event;
+
+	template <typename ...A>
+	static Type getKey(const Event & e, const A & .../*args*/) {
+		return e;
+	}
+};
+
+template <
+	typename EventType_,
+	typename Prototype_,
+	typename Policies_
+>
+class CoalescingEventQueueBase;
+
+// OPT-28: Last-value-wins EventQueue.
+// An event whose key equals the key of an event still in the queue replaces
+// that event in place, so it keeps the position of the first one, and only
+// the latest value of each key is dispatched. The keys of the queued events
+// are indexed in a map, enqueue is one lookup under the queue lock.
+template <
+	typename EventType_,
+	typename Policies_,
+	typename ReturnType, typename ...Args
+>
+class CoalescingEventQueueBase <
+		EventType_,
+		ReturnType (Args...),
+		Policies_
+	> : public EventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		CoalescingEventQueueBase <
+			EventType_,
+			ReturnType (Args...),
+			Policies_
+		>
+	>
+{
+private:
+	using super = EventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		CoalescingEventQueueBase <
+			EventType_,
+			ReturnType (Args...),
+			Policies_
+		>
+	>;
+
+	using Policies = typename super::Policies;
+	using Threading = typename super::Threading;
+	using DispatchCache = typename super::DispatchCache;
+	using ConditionVariable = typename Threading::ConditionVariable;
+
+	using QueuedEventArgumentsType = std::tuple<typename std::decay<Args>::type...>;
+
+	struct QueuedEvent_
+	{
+		typename std::decay<typename super::Event>::type event;
+		QueuedEventArgumentsType arguments;
+
+		typename super::Event getEvent() const {
+			return event;
+		}
+
+		template <std::size_t N>
+		auto getArgument() const
+			-> typename std::tuple_element<N, std::tuple<Args...> >::type {
+			return std::get<N>(arguments);
+		}
+	};
+
+	using CoalesceKeySelector = SelectCoalesceKey<
+		Policies_,
+		typename std::decay<typename super::Event>::type,
+		HasFunctionCoalesceKey<
+			Policies_,
+			const typename std::decay<typename super::Event>::type &,
+			const typename std::decay<Args>::type & ...
+		>::value,
+		typename std::decay<Args>::type...
+	>;
+
+	// The index keeps iterators to the nodes, so the list must be a std::list,
+	// the QueueList policy is not used.
+	using BufferedItemList = std::list<BufferedItem<QueuedEvent_> >;
+
+public:
+	using QueuedEvent = QueuedEvent_;
+	using Event = typename super::Event;
+	using Handle = typename super::Handle;
+	using Callback = typename super::Callback;
+	using Mutex = typename super::Mutex;
+	using CoalesceKey = typename CoalesceKeySelector::Type;
+
+private:
+	using IndexMap = typename SelectMap<CoalesceKey, typename BufferedItemList::iterator, Policies_, false>::Type;
+
+public:
+	struct DisableQueueNotify
+	{
+		DisableQueueNotify(CoalescingEventQueueBase * queue)
+			: queue(queue)
+		{
+			++queue->queueNotifyCounter;
+		}
+
+		~DisableQueueNotify()
+		{
+			--queue->queueNotifyCounter;
+
+			if(queue->doCanNotifyQueueAvailable() && ! queue->emptyQueue()) {
+				queue->queueListConditionVariable.notify_one();
+			}
+		}
+
+		CoalescingEventQueueBase * queue;
+	};
+
+public:
+	CoalescingEventQueueBase()
+		:
+			super(),
+			queueListConditionVariable(),
+			queueEmptyCounter(0),
+			queueNotifyCounter(0),
+			coalescedEventCount(0),
+			queueListMutex(),
+			queueList(),
+			freeList(),
+			index()
+	{
+	}
+
+	// Same as EventQueue, only the listeners are copied or moved, the queued events are not.
+	CoalescingEventQueueBase(const CoalescingEventQueueBase & other)
+		: CoalescingEventQueueBase()
+	{
+		super::operator = (other);
+	}
+
+	CoalescingEventQueueBase(CoalescingEventQueueBase && other) noexcept
+		: CoalescingEventQueueBase()
+	{
+		super::operator = (std::move(other));
+	}
+
+	CoalescingEventQueueBase & operator = (const CoalescingEventQueueBase & other)
+	{
+		super::operator = (other);
+		return *this;
+	}
+
+	CoalescingEventQueueBase & operator = (CoalescingEventQueueBase && other) noexcept
+	{
+		super::operator = (std::move(other));
+		return *this;
+	}
+
+	// Returns true if the event is put at the back of the queue, false if it
+	// replaced a queued event with the same key.
+	template <typename ...A>
+	auto enqueue(A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), bool>::type
+	{
+		static_assert(super::ArgumentPassingMode::canIncludeEventType, "Enqueuing arguments count doesn't match required (Event type should be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, A...>::value>::Type;
+
+		return doEnqueue(QueuedEvent{
+			GetEvent::getEvent(args...),
+			QueuedEventArgumentsType(std::forward<A>(args)...)
+		});
+	}
+
+	template <typename T, typename ...A>
+	auto enqueue(T && first, A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), bool>::type
+	{
+		static_assert(super::ArgumentPassingMode::canExcludeEventType, "Enqueuing arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, T &&, A...>::value>::Type;
+
+		return doEnqueue(QueuedEvent{
+			GetEvent::getEvent(std::forward<T>(first), args...),
+			QueuedEventArgumentsType(std::forward<A>(args)...)
+		});
+	}
+
+	bool emptyQueue() const
+	{
+		return queueList.empty() && (queueEmptyCounter.load(std::memory_order_acquire) == 0);
+	}
+
+	// Events which replaced a queued event instead of being put in the queue.
+	std::size_t getCoalescedEventCount() const
+	{
+		return coalescedEventCount.load(std::memory_order_relaxed);
+	}
+
+	void clearEvents()
+	{
+		if(! queueList.empty()) {
+			BufferedItemList tempList;
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				std::swap(queueList, tempList);
+				index.clear();
+			}
+
+			for(auto & item : tempList) {
+				item.clear();
+			}
+			doRecycle(tempList);
+		}
+	}
+
+	// Only the events in the queue when process is called are dispatched.
+	// An event enqueued during processing is queued again even if an event
+	// with the same key is being dispatched.
+	bool process()
+	{
+		// OPT-25: Consecutive events of the same type share one lookup.
+		DispatchCache cache;
+		return doProcessBatch([this, &cache](QueuedEvent & item) {
+			doDispatchQueuedEventCached(
+				cache,
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	bool processOne()
+	{
+		return doProcessOne([this](QueuedEvent & item) {
+			doDispatchQueuedEvent(
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	// OPT-15: Zero-overhead visitor dispatch, see EventQueue::processQueueWith.
+	// Visitor protocol: visitor(event, args...)
+	template <typename Visitor>
+	bool processQueueWith(Visitor && visitor)
+	{
+		return doProcessBatch([this, &visitor](QueuedEvent & item) {
+			doVisitQueuedEvent(
+				visitor,
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	// OPT-15: Single-event variant of processQueueWith.
+	template <typename Visitor>
+	bool processOneWith(Visitor && visitor)
+	{
+		return doProcessOne([this, &visitor](QueuedEvent & item) {
+			doVisitQueuedEvent(
+				visitor,
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	void wait() const
+	{
+		std::unique_lock<Mutex> queueListLock(queueListMutex);
+		queueListConditionVariable.wait(queueListLock, [this]() -> bool {
+			return doCanProcess();
+		});
+	}
+
+	template <class Rep, class Period>
+	bool waitFor(const std::chrono::duration<Rep, Period> & duration) const
+	{
+		// OPT-8: Spin -> Yield -> Sleep, same as EventQueue::waitFor.
+		if(doCanProcess()) {
+			return true;
+		}
+
+		if(internal_::spinThenYield([this]() -> bool {
+			return doCanProcess();
+		})) {
+			return true;
+		}
+
+		std::unique_lock<Mutex> queueListLock(queueListMutex);
+		return queueListConditionVariable.wait_for(queueListLock, duration, [this]() -> bool {
+			return doCanProcess();
+		});
+	}
+
+	using super::dispatch;
+
+	template <typename U>
+	auto dispatch(const U & queuedEvent)
+		-> typename std::enable_if<std::is_same<U, QueuedEvent>::value, void>::type
+	{
+		doDispatchQueuedEvent(
+			queuedEvent,
+			typename MakeIndexSequence<sizeof...(Args)>::Type()
+		);
+	}
+
+	bool peekEvent(QueuedEvent * queuedEvent)
+	{
+		if(! queueList.empty()) {
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+
+			if(! queueList.empty()) {
+				*queuedEvent = queueList.front().get();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool takeEvent(QueuedEvent * queuedEvent)
+	{
+		return doProcessOne([queuedEvent](QueuedEvent & item) {
+			*queuedEvent = std::move(item);
+		});
+	}
+
+protected:
+	template <typename F>
+	bool doProcessBatch(F && func)
+	{
+		if(! queueList.empty()) {
+			BufferedItemList tempList;
+
+			// Use a counter to tell the queue list is not empty during processing
+			// even though queueList is swapped to empty.
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				std::swap(queueList, tempList);
+				index.clear();
+			}
+
+			if(! tempList.empty()) {
+				for(auto & item : tempList) {
+					func(item.get());
+					item.clear();
+				}
+
+				doRecycle(tempList);
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	template <typename F>
+	bool doProcessOne(F && func)
+	{
+		if(! queueList.empty()) {
+			BufferedItemList tempList;
+
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+
+				if(! queueList.empty()) {
+					index.erase(doGetCoalesceKey(
+						queueList.front().get(),
+						typename MakeIndexSequence<sizeof...(Args)>::Type()
+					));
+					tempList.splice(tempList.end(), queueList, queueList.begin());
+				}
+			}
+
+			if(! tempList.empty()) {
+				func(tempList.front().get());
+				tempList.front().clear();
+
+				doRecycle(tempList);
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool doCanProcess() const
+	{
+		return ! emptyQueue() && doCanNotifyQueueAvailable();
+	}
+
+	bool doCanNotifyQueueAvailable() const
+	{
+		return queueNotifyCounter.load(std::memory_order_acquire) == 0;
+	}
+
+	template <typename T, size_t ...Indexes>
+	static CoalesceKey doGetCoalesceKey(const T & item, IndexSequence<Indexes...>)
+	{
+		return CoalesceKeySelector::getKey(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEvent(T && item, IndexSequence<Indexes...>)
+	{
+		this->directDispatch(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEventCached(DispatchCache & cache, T && item, IndexSequence<Indexes...>)
+	{
+		this->doDirectDispatchCached(cache, item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename V, typename T, size_t ...Indexes>
+	void doVisitQueuedEvent(V && visitor, T && item, IndexSequence<Indexes...>)
+	{
+		visitor(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	bool doEnqueue(QueuedEvent && item)
+	{
+		// The key is computed before taking the lock.
+		CoalesceKey key = doGetCoalesceKey(item, typename MakeIndexSequence<sizeof...(Args)>::Type());
+
+		{
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+
+			auto found = index.find(key);
+			if(found != index.end()) {
+				auto & queuedItem = *found->second;
+				queuedItem.clear();
+				queuedItem.set(std::move(item));
+				coalescedEventCount.fetch_add(1, std::memory_order_relaxed);
+				// The queue was not empty, the consumer was already notified.
+				return false;
+			}
+
+			// The free list shares queueListMutex, the index is updated under
+			// this lock anyway, so a miss costs no extra lock.
+			if(freeList.empty()) {
+				freeList.emplace_back();
+			}
+			auto it = freeList.begin();
+			it->set(std::move(item));
+			queueList.splice(queueList.end(), freeList, it);
+			index.emplace(std::move(key), it);
+		}
+
+		if(doCanProcess()) {
+			queueListConditionVariable.notify_one();
+		}
+		return true;
+	}
+
+	void doRecycle(BufferedItemList & tempList)
+	{
+		if(! tempList.empty()) {
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			freeList.splice(freeList.end(), tempList);
+		}
+	}
+
+private:
+	EVENTPP_ALIGN_CACHELINE mutable ConditionVariable queueListConditionVariable;
+	typename Threading::template Atomic<int> queueEmptyCounter;
+	typename Threading::template Atomic<int> queueNotifyCounter;
+	typename Threading::template Atomic<std::size_t> coalescedEventCount;
+	EVENTPP_ALIGN_CACHELINE mutable Mutex queueListMutex;
+	BufferedItemList queueList;
+	BufferedItemList freeList;
+	IndexMap index;
+};
+
+} //namespace internal_
+
+template <
+	typename Event_,
+	typename Prototype_,
+	typename Policies_ = DefaultPolicies
+>
+class CoalescingEventQueue : public internal_::InheritMixins<
+		internal_::CoalescingEventQueueBase<Event_, Prototype_, Policies_>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type, public TagEventDispatcher, public TagEventQueue
+{
+private:
+	using super = typename internal_::InheritMixins<
+		internal_::CoalescingEventQueueBase<Event_, Prototype_, Policies_>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type;
+
+public:
+	using super::super;
+};
+
+
+} //namespace eventpp
+
+
+#endif
@@ -0,0 +1,567 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef COLUMNEVENTQUEUE_H_EVENTPP
+#define COLUMNEVENTQUEUE_H_EVENTPP
+
+#include "eventdispatcher.h"
+#include "internal/eventqueue_i.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <type_traits>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// chunkSize values of T. The values are constructed when they are written,
+// and never destroyed, so T must be trivially copyable.
+template <typename T, std::size_t chunkSize>
+struct ColumnStorage
+{
+	T * data() {
+		return reinterpret_cast<T *>(&buffer);
+	}
+
+	const T * data() const {
+		return reinterpret_cast<const T *>(&buffer);
+	}
+
+	typename std::aligned_storage<sizeof(T) * chunkSize, alignof(T)>::type buffer;
+};
+
+template <
+	typename EventType_,
+	typename Prototype_,
+	typename Policies_,
+	std::size_t chunkSize
+>
+class ColumnEventQueueBase;
+
+// OPT-66: EventQueue which stores the events in chunks of columns, the
+// events in one array and each argument in its own array, instead of one
+// list node for each event. There is no node pointer or destructor for each
+// event, clearEvents and the process functions give the chunks back without
+// touching the events, and processColumnsWith visits the arrays directly.
+// The event and the arguments must be trivially copyable.
+// The chunks which are given back are reused, they are freed when the queue
+// is destroyed.
+template <
+	typename EventType_,
+	typename Policies_,
+	std::size_t chunkSize,
+	typename ReturnType, typename ...Args
+>
+class ColumnEventQueueBase <
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		chunkSize
+	> : public EventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		ColumnEventQueueBase <
+			EventType_,
+			ReturnType (Args...),
+			Policies_,
+			chunkSize
+		>
+	>
+{
+private:
+	using super = EventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		ColumnEventQueueBase <
+			EventType_,
+			ReturnType (Args...),
+			Policies_,
+			chunkSize
+		>
+	>;
+
+	using Policies = typename super::Policies;
+	using Threading = typename super::Threading;
+	using DispatchCache = typename super::DispatchCache;
+	using ConditionVariable = typename Threading::ConditionVariable;
+
+	using EventValue = typename std::decay<typename super::Event>::type;
+	using ArgumentList = std::tuple<typename std::decay<Args>::type...>;
+	using IndexList = typename MakeIndexSequence<sizeof...(Args)>::Type;
+
+	template <std::size_t N>
+	using ArgumentType = typename std::tuple_element<N, ArgumentList>::type;
+
+	static_assert(chunkSize > 0, "ColumnEventQueue: chunkSize must not be 0.");
+	static_assert(AllTriviallyCopyable<EventValue, typename std::decay<Args>::type...>::value,
+		"ColumnEventQueue: the event and the arguments must be trivially copyable.");
+
+	struct Chunk
+	{
+		Chunk() : count(0), next(nullptr)
+		{
+		}
+
+		ColumnStorage<EventValue, chunkSize> eventColumn;
+		std::tuple<ColumnStorage<typename std::decay<Args>::type, chunkSize>...> argumentColumnList;
+		std::size_t count;
+		Chunk * next;
+	};
+
+public:
+	using Event = typename super::Event;
+	using Handle = typename super::Handle;
+	using Callback = typename super::Callback;
+	using Mutex = typename super::Mutex;
+
+public:
+	ColumnEventQueueBase()
+		:
+			super(),
+			queueListMutex(),
+			headChunk(nullptr),
+			tailChunk(nullptr),
+			freeListMutex(),
+			freeChunk(nullptr),
+			queuedEventCount(0),
+			queueEmptyCounter(0),
+			waitingConsumerCount(0),
+			queueListConditionVariable()
+	{
+	}
+
+	// Same as EventQueue, only the listeners are copied or moved, the queued events are not.
+	ColumnEventQueueBase(const ColumnEventQueueBase & other)
+		: ColumnEventQueueBase()
+	{
+		super::operator = (other);
+	}
+
+	ColumnEventQueueBase(ColumnEventQueueBase && other) noexcept
+		: ColumnEventQueueBase()
+	{
+		super::operator = (std::move(other));
+	}
+
+	ColumnEventQueueBase & operator = (const ColumnEventQueueBase & other)
+	{
+		super::operator = (other);
+		return *this;
+	}
+
+	ColumnEventQueueBase & operator = (ColumnEventQueueBase && other) noexcept
+	{
+		super::operator = (std::move(other));
+		return *this;
+	}
+
+	~ColumnEventQueueBase()
+	{
+		doFreeChunks(headChunk);
+		doFreeChunks(freeChunk);
+	}
+
+	template <typename ...A>
+	auto enqueue(A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), void>::type
+	{
+		static_assert(super::ArgumentPassingMode::canIncludeEventType, "Enqueuing arguments count doesn't match required (Event type should be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, A...>::value>::Type;
+
+		doEnqueue(GetEvent::getEvent(args...), IndexList(), std::forward<A>(args)...);
+	}
+
+	template <typename T, typename ...A>
+	auto enqueue(T && first, A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), void>::type
+	{
+		static_assert(super::ArgumentPassingMode::canExcludeEventType, "Enqueuing arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, T &&, A...>::value>::Type;
+
+		doEnqueue(GetEvent::getEvent(std::forward<T>(first), args...), IndexList(), std::forward<A>(args)...);
+	}
+
+	bool emptyQueue() const
+	{
+		return queuedEventCount.load(std::memory_order_acquire) == 0
+			&& queueEmptyCounter.load(std::memory_order_acquire) == 0;
+	}
+
+	std::size_t getQueuedEventCount() const
+	{
+		return queuedEventCount.load(std::memory_order_acquire);
+	}
+
+	// The events have no destructor, so only the chunks are given back.
+	void clearEvents()
+	{
+		doRecycleChunks(doTakeChunks());
+	}
+
+	bool process()
+	{
+		CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+		Chunk * const chunkList = doTakeChunks();
+		if(chunkList == nullptr) {
+			return false;
+		}
+
+		// OPT-25: Consecutive events of the same type share one lookup.
+		DispatchCache cache;
+		for(Chunk * chunk = chunkList; chunk != nullptr; chunk = chunk->next) {
+			EventValue * eventList = chunk->eventColumn.data();
+			for(std::size_t i = 0; i < chunk->count; ++i) {
+				doDispatchCached(cache, eventList[i], *chunk, i, IndexList());
+			}
+		}
+
+		doRecycleChunks(chunkList);
+		return true;
+	}
+
+	// Same as EventQueue::processIf. The events which are not processed are
+	// put back to the head of the queue in their original order.
+	template <typename Predictor>
+	bool processIf(Predictor && predictor)
+	{
+		CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+		Chunk * const chunkList = doTakeChunks();
+		if(chunkList == nullptr) {
+			return false;
+		}
+
+		bool processed = false;
+		ChunkChain keptChain;
+		for(Chunk * chunk = chunkList; chunk != nullptr; chunk = chunk->next) {
+			EventValue * eventList = chunk->eventColumn.data();
+			for(std::size_t i = 0; i < chunk->count; ++i) {
+				if(doInvokePredictor(predictor, *chunk, i, IndexList())) {
+					doDispatchEvent(eventList[i], *chunk, i, IndexList());
+					processed = true;
+				}
+				else {
+					doCopyEvent(keptChain, *chunk, i, IndexList());
+				}
+			}
+		}
+
+		doRecycleChunks(chunkList);
+		doPutBack(keptChain);
+		return processed;
+	}
+
+	// OPT-15: Zero-overhead visitor dispatch, see EventQueue::processQueueWith.
+	// Visitor protocol: visitor(event, args...)
+	template <typename Visitor>
+	bool processQueueWith(Visitor && visitor)
+	{
+		CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+		Chunk * const chunkList = doTakeChunks();
+		if(chunkList == nullptr) {
+			return false;
+		}
+
+		for(Chunk * chunk = chunkList; chunk != nullptr; chunk = chunk->next) {
+			EventValue * eventList = chunk->eventColumn.data();
+			for(std::size_t i = 0; i < chunk->count; ++i) {
+				doVisitEvent(visitor, eventList[i], *chunk, i, IndexList());
+			}
+		}
+
+		doRecycleChunks(chunkList);
+		return true;
+	}
+
+	// Visits each chunk of the queued events as arrays,
+	// visitor(const Event * events, const A * ...arguments, std::size_t count),
+	// A is the decayed type of each argument. The values of the events are
+	// side by side, so the visitor can scan them with SIMD.
+	template <typename Visitor>
+	bool processColumnsWith(Visitor && visitor)
+	{
+		CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+		Chunk * const chunkList = doTakeChunks();
+		if(chunkList == nullptr) {
+			return false;
+		}
+
+		for(Chunk * chunk = chunkList; chunk != nullptr; chunk = chunk->next) {
+			doVisitColumns(visitor, *chunk, IndexList());
+		}
+
+		doRecycleChunks(chunkList);
+		return true;
+	}
+
+	void wait() const
+	{
+		while(! waitFor(std::chrono::hours(1))) {
+		}
+	}
+
+	template <class Rep, class Period>
+	bool waitFor(const std::chrono::duration<Rep, Period> & duration) const
+	{
+		if(doCanProcess()) {
+			return true;
+		}
+
+		// Producers only notify when waitingConsumerCount is not zero. The
+		// fence pairs with the one in doEnqueue.
+		waitingConsumerCount.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		bool result;
+		{
+			std::unique_lock<Mutex> queueListLock(queueListMutex);
+			result = queueListConditionVariable.wait_for(queueListLock, duration, [this]() -> bool {
+				return doCanProcess();
+			});
+		}
+		waitingConsumerCount.fetch_sub(1, std::memory_order_relaxed);
+		return result;
+	}
+
+	static constexpr std::size_t getChunkSize() {
+		return chunkSize;
+	}
+
+private:
+	struct ChunkChain
+	{
+		Chunk * head = nullptr;
+		Chunk * tail = nullptr;
+		std::size_t count = 0;
+	};
+
+	// Must be called with queueListMutex, or on a chain owned by the caller.
+	template <typename Allocate>
+	Chunk * doGetWritableChunk(Chunk *& head, Chunk *& tail, Allocate && allocate)
+	{
+		if(tail == nullptr || tail->count == chunkSize) {
+			Chunk * chunk = allocate();
+			if(tail == nullptr) {
+				head = chunk;
+			}
+			else {
+				tail->next = chunk;
+			}
+			tail = chunk;
+		}
+		return tail;
+	}
+
+	template <size_t ...Indexes, typename ...A>
+	void doEnqueue(const EventValue & event, IndexSequence<Indexes...>, A && ...args)
+	{
+		{
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+
+			Chunk * chunk = doGetWritableChunk(headChunk, tailChunk, [this]() { return doAllocateChunk(); });
+			const std::size_t index = chunk->count;
+			new (chunk->eventColumn.data() + index) EventValue(event);
+			const int dummy[] = { 0, ((void)new (std::get<Indexes>(chunk->argumentColumnList).data() + index) ArgumentType<Indexes>(std::forward<A>(args)), 0)... };
+			(void)dummy;
+			++chunk->count;
+			queuedEventCount.fetch_add(1, std::memory_order_release);
+		}
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(waitingConsumerCount.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			queueListConditionVariable.notify_one();
+		}
+	}
+
+	template <size_t ...Indexes>
+	void doCopyEvent(ChunkChain & chain, const Chunk & from, const std::size_t fromIndex, IndexSequence<Indexes...>)
+	{
+		Chunk * chunk = doGetWritableChunk(chain.head, chain.tail, [this]() { return doAllocateChunk(); });
+		const std::size_t index = chunk->count;
+		new (chunk->eventColumn.data() + index) EventValue(from.eventColumn.data()[fromIndex]);
+		const int dummy[] = { 0, ((void)new (std::get<Indexes>(chunk->argumentColumnList).data() + index) ArgumentType<Indexes>(
+			std::get<Indexes>(from.argumentColumnList).data()[fromIndex]), 0)... };
+		(void)dummy;
+		++chunk->count;
+		++chain.count;
+	}
+
+	// The kept events go before the events enqueued during the call.
+	void doPutBack(ChunkChain & chain)
+	{
+		if(chain.head == nullptr) {
+			return;
+		}
+
+		std::lock_guard<Mutex> queueListLock(queueListMutex);
+		chain.tail->next = headChunk;
+		if(headChunk == nullptr) {
+			tailChunk = chain.tail;
+		}
+		headChunk = chain.head;
+		queuedEventCount.fetch_add(chain.count, std::memory_order_release);
+	}
+
+	template <size_t ...Indexes>
+	void doDispatchEvent(EventValue & event, Chunk & chunk, const std::size_t index, IndexSequence<Indexes...>)
+	{
+		this->directDispatch(event, std::get<Indexes>(chunk.argumentColumnList).data()[index]...);
+	}
+
+	template <typename Visitor, size_t ...Indexes>
+	static void doVisitEvent(Visitor & visitor, EventValue & event, Chunk & chunk, const std::size_t index, IndexSequence<Indexes...>)
+	{
+		visitor(event, std::get<Indexes>(chunk.argumentColumnList).data()[index]...);
+	}
+
+	template <typename F, size_t ...Indexes>
+	static bool doInvokePredictor(F & func, Chunk & chunk, const std::size_t index, IndexSequence<Indexes...>)
+	{
+		return doInvokePredictorHelper(func, std::get<Indexes>(chunk.argumentColumnList).data()[index]...);
+	}
+
+	template <typename F>
+	static auto doInvokePredictorHelper(F & func, typename std::decay<Args>::type & ...args)
+		-> typename std::enable_if<! CanInvoke<F>::value, bool>::type
+	{
+		return func(args...);
+	}
+
+	template <typename F>
+	static auto doInvokePredictorHelper(F & func, typename std::decay<Args>::type & .../*args*/)
+		-> typename std::enable_if<CanInvoke<F>::value, bool>::type
+	{
+		return func();
+	}
+
+	template <size_t ...Indexes>
+	void doDispatchCached(DispatchCache & cache, EventValue & event, Chunk & chunk, const std::size_t index, IndexSequence<Indexes...>)
+	{
+		this->doDirectDispatchCached(cache, event, std::get<Indexes>(chunk.argumentColumnList).data()[index]...);
+	}
+
+	template <typename Visitor, size_t ...Indexes>
+	static void doVisitColumns(Visitor & visitor, const Chunk & chunk, IndexSequence<Indexes...>)
+	{
+		visitor(chunk.eventColumn.data(), std::get<Indexes>(chunk.argumentColumnList).data()..., chunk.count);
+	}
+
+	bool doCanProcess() const
+	{
+		return queuedEventCount.load(std::memory_order_acquire) != 0;
+	}
+
+	Chunk * doTakeChunks()
+	{
+		if(queuedEventCount.load(std::memory_order_acquire) == 0) {
+			return nullptr;
+		}
+
+		std::lock_guard<Mutex> queueListLock(queueListMutex);
+		Chunk * chunk = headChunk;
+		headChunk = nullptr;
+		tailChunk = nullptr;
+		queuedEventCount.store(0, std::memory_order_release);
+		return chunk;
+	}
+
+	Chunk * doAllocateChunk()
+	{
+		{
+			std::lock_guard<Mutex> freeListLock(freeListMutex);
+			if(freeChunk != nullptr) {
+				Chunk * chunk = freeChunk;
+				freeChunk = chunk->next;
+				chunk->next = nullptr;
+				chunk->count = 0;
+				return chunk;
+			}
+		}
+		return new Chunk();
+	}
+
+	void doRecycleChunks(Chunk * chunkList)
+	{
+		if(chunkList == nullptr) {
+			return;
+		}
+
+		Chunk * last = chunkList;
+		while(last->next != nullptr) {
+			last = last->next;
+		}
+
+		std::lock_guard<Mutex> freeListLock(freeListMutex);
+		last->next = freeChunk;
+		freeChunk = chunkList;
+	}
+
+	static void doFreeChunks(Chunk * chunk)
+	{
+		while(chunk != nullptr) {
+			Chunk * next = chunk->next;
+			delete chunk;
+			chunk = next;
+		}
+	}
+
+private:
+	mutable Mutex queueListMutex;
+	Chunk * headChunk;
+	Chunk * tailChunk;
+	Mutex freeListMutex;
+	Chunk * freeChunk;
+	typename Threading::template Atomic<std::size_t> queuedEventCount;
+	typename Threading::template Atomic<int> queueEmptyCounter;
+	mutable typename Threading::template Atomic<int> waitingConsumerCount;
+	mutable ConditionVariable queueListConditionVariable;
+};
+
+} //namespace internal_
+
+template <
+	typename Event_,
+	typename Prototype_,
+	typename Policies_ = DefaultPolicies,
+	std::size_t chunkSize = 256
+>
+class ColumnEventQueue : public internal_::InheritMixins<
+		internal_::ColumnEventQueueBase<Event_, Prototype_, Policies_, chunkSize>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type, public TagEventDispatcher, public TagEventQueue
+{
+private:
+	using super = typename internal_::InheritMixins<
+		internal_::ColumnEventQueueBase<Event_, Prototype_, Policies_, chunkSize>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type;
+
+public:
+	using super::super;
+};
+
+
+} //namespace eventpp
+
+
+#endif
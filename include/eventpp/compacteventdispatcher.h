@@ -0,0 +1,360 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef COMPACTEVENTDISPATCHER_H_EVENTPP
+#define COMPACTEVENTDISPATCHER_H_EVENTPP
+
+#include "callbacklist.h"
+#include "utilities/stripedmutex.h"
+
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// The CallbackList of CompactEventDispatcher locks a stripe instead of its
+// own mutex, the rest of the policies are the same.
+template <typename Policies, std::size_t stripeCount>
+struct CompactCallbackListPolicies : public Policies
+{
+private:
+	using UserThreading = typename SelectThreading<Policies, HasTypeThreading<Policies>::value>::Type;
+
+public:
+	using Threading = GeneralThreading<
+		StripedMutex<stripeCount, typename UserThreading::Mutex>,
+		UserThreading::template Atomic,
+		typename UserThreading::ConditionVariable,
+		typename UserThreading::SharedMutex
+	>;
+};
+
+} //namespace internal_
+
+// OPT-62: EventDispatcher for a lot of events with few listeners each, such
+// as one event for each order ID.
+// The value in the map is a shared_ptr to the CallbackList of the event,
+// 16 bytes, and the list is allocated when the first listener is added.
+// The list has a StripedMutex, so it doesn't hold a mutex of its own.
+// When removeListener removes the last listener, the event is erased from
+// the map. compact() erases the other empty events, such as the ones whose
+// listeners were removed by a ListenerGroup.
+// dispatch copies the shared_ptr under the shared lock, so an event erased
+// while it's dispatched stays alive until the dispatch returns.
+// It has no mixins, and it's not the dispatcher of EventQueue. The Map
+// policy must support erase.
+template <
+	typename Event_,
+	typename Prototype_,
+	typename Policies_ = DefaultPolicies,
+	std::size_t stripeCount = 64
+>
+class CompactEventDispatcher;
+
+template <
+	typename Event_,
+	typename Policies_,
+	std::size_t stripeCount,
+	typename ReturnType, typename ...Args
+>
+class CompactEventDispatcher <
+	Event_,
+	ReturnType (Args...),
+	Policies_,
+	stripeCount
+> : public TagEventDispatcher
+{
+private:
+	using Policies = Policies_;
+
+	using Threading = typename internal_::SelectThreading<Policies, internal_::HasTypeThreading<Policies>::value>::Type;
+
+	using ArgumentPassingMode = typename internal_::SelectArgumentPassingMode<
+		Policies,
+		internal_::HasTypeArgumentPassingMode<Policies>::value,
+		ArgumentPassingAutoDetect
+	>::Type;
+
+	using CallbackList_ = CallbackList<
+		ReturnType (Args...),
+		internal_::CompactCallbackListPolicies<Policies, stripeCount>
+	>;
+	using CallbackListPtr = std::shared_ptr<CallbackList_>;
+	// OPT-47: NoListenerGroup with ListenerGroupsNone, see ListenerGroups.
+	using ListenerGroup_ = typename internal_::SelectListenerGroup<Policies>::Group;
+
+	using Map = typename internal_::SelectMap<
+		Event_,
+		CallbackListPtr,
+		Policies,
+		internal_::HasTemplateMap<Policies>::value
+	>::Type;
+
+public:
+	using Handle = typename CallbackList_::Handle;
+	using Callback = typename CallbackList_::Callback;
+	using Event = Event_;
+	using Mutex = typename Threading::Mutex;
+	using SharedMutex = typename Threading::SharedMutex;
+
+public:
+	CompactEventDispatcher()
+		: eventCallbackListMap(), listenerMutex()
+	{
+	}
+
+	CompactEventDispatcher(const CompactEventDispatcher & other)
+		: eventCallbackListMap(), listenerMutex()
+	{
+		doCopyFrom(other);
+	}
+
+	CompactEventDispatcher(CompactEventDispatcher && other) noexcept
+		: eventCallbackListMap(std::move(other.eventCallbackListMap)), listenerMutex()
+	{
+	}
+
+	CompactEventDispatcher & operator = (const CompactEventDispatcher & other)
+	{
+		if(this != &other) {
+			CompactEventDispatcher copied(other);
+			swap(copied);
+		}
+		return *this;
+	}
+
+	CompactEventDispatcher & operator = (CompactEventDispatcher && other) noexcept
+	{
+		eventCallbackListMap = std::move(other.eventCallbackListMap);
+		return *this;
+	}
+
+	void swap(CompactEventDispatcher & other) noexcept {
+		using std::swap;
+
+		swap(eventCallbackListMap, other.eventCallbackListMap);
+	}
+
+	friend void swap(CompactEventDispatcher & first, CompactEventDispatcher & second) noexcept {
+		first.swap(second);
+	}
+
+	Handle appendListener(const Event & event, const Callback & callback)
+	{
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+		return doGetOrCreateCallbackList(event).append(callback);
+	}
+
+	Handle prependListener(const Event & event, const Callback & callback)
+	{
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+		return doGetOrCreateCallbackList(event).prepend(callback);
+	}
+
+	Handle insertListener(const Event & event, const Callback & callback, const Handle & before)
+	{
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+		return doGetOrCreateCallbackList(event).insert(callback, before);
+	}
+
+	Handle appendListener(const Event & event, const Callback & callback, ListenerGroup_ & group)
+	{
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+		return doGetOrCreateCallbackList(event).append(callback, group);
+	}
+
+	Handle prependListener(const Event & event, const Callback & callback, ListenerGroup_ & group)
+	{
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+		return doGetOrCreateCallbackList(event).prepend(callback, group);
+	}
+
+	Handle insertListener(const Event & event, const Callback & callback, const Handle & before, ListenerGroup_ & group)
+	{
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+		return doGetOrCreateCallbackList(event).insert(callback, before, group);
+	}
+
+	bool removeListener(const Event & event, const Handle handle)
+	{
+		const CallbackListPtr callableList = doFindCallableList(event);
+		if(! callableList || ! callableList->remove(handle)) {
+			return false;
+		}
+
+		if(callableList->empty()) {
+			std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+			// A listener may be added after the remove, then it's not empty.
+			auto it = eventCallbackListMap.find(event);
+			if(it != eventCallbackListMap.end() && it->second == callableList && callableList->empty()) {
+				eventCallbackListMap.erase(it);
+			}
+		}
+
+		return true;
+	}
+
+	// Erases the events which have no listener. The lists are walked first,
+	// which unlinks the listeners of the removed ListenerGroups.
+	// Returns the count of the erased events.
+	std::size_t compact()
+	{
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+		std::size_t count = 0;
+		for(auto it = eventCallbackListMap.begin(); it != eventCallbackListMap.end(); ) {
+			it->second->forEach([](const Callback &) {});
+			if(it->second->empty()) {
+				it = eventCallbackListMap.erase(it);
+				++count;
+			}
+			else {
+				++it;
+			}
+		}
+		return count;
+	}
+
+	// The count of the events in the map, including the ones which are empty
+	// and not compacted yet.
+	std::size_t getEventCount() const
+	{
+		std::shared_lock<SharedMutex> lockGuard(listenerMutex);
+
+		return eventCallbackListMap.size();
+	}
+
+	bool hasAnyListener(const Event & event) const
+	{
+		const CallbackListPtr callableList = doFindCallableList(event);
+		if(callableList) {
+			return ! callableList->empty();
+		}
+
+		return false;
+	}
+
+	bool ownsHandle(const Event & event, const Handle & handle) const
+	{
+		const CallbackListPtr callableList = doFindCallableList(event);
+		if(callableList) {
+			return callableList->ownsHandle(handle);
+		}
+
+		return false;
+	}
+
+	template <typename Func>
+	void forEach(const Event & event, Func && func) const
+	{
+		const CallbackListPtr callableList = doFindCallableList(event);
+		if(callableList) {
+			callableList->forEach(std::forward<Func>(func));
+		}
+	}
+
+	template <typename Func>
+	bool forEachIf(const Event & event, Func && func) const
+	{
+		const CallbackListPtr callableList = doFindCallableList(event);
+		if(callableList) {
+			return callableList->forEachIf(std::forward<Func>(func));
+		}
+
+		return true;
+	}
+
+	void dispatch(Args ...args) const
+	{
+		static_assert(ArgumentPassingMode::canIncludeEventType, "Dispatching arguments count doesn't match required (Event type should be included).");
+
+		using GetEvent = typename internal_::SelectGetEvent<Policies, Event_, internal_::HasFunctionGetEvent<Policies, Args...>::value>::Type;
+
+		directDispatch(
+			GetEvent::getEvent(args...),
+			std::forward<Args>(args)...
+		);
+	}
+
+	template <typename T>
+	void dispatch(T && first, Args ...args) const
+	{
+		static_assert(ArgumentPassingMode::canExcludeEventType, "Dispatching arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename internal_::SelectGetEvent<Policies, Event_, internal_::HasFunctionGetEvent<Policies, T &&, Args...>::value>::Type;
+
+		directDispatch(
+			GetEvent::getEvent(std::forward<T>(first), args...),
+			std::forward<Args>(args)...
+		);
+	}
+
+	void directDispatch(const Event & e, Args ...args) const
+	{
+		const CallbackListPtr callableList = doFindCallableList(e);
+		if(callableList) {
+			(*callableList)(std::forward<Args>(args)...);
+		}
+	}
+
+private:
+	// Must be called with the unique lock.
+	CallbackList_ & doGetOrCreateCallbackList(const Event & event)
+	{
+		CallbackListPtr & callableList = eventCallbackListMap[event];
+		if(! callableList) {
+			callableList = std::make_shared<CallbackList_>();
+		}
+		return *callableList;
+	}
+
+	CallbackListPtr doFindCallableList(const Event & e) const
+	{
+		std::shared_lock<SharedMutex> lockGuard(listenerMutex);
+
+		auto it = eventCallbackListMap.find(e);
+		if(it != eventCallbackListMap.end()) {
+			return it->second;
+		}
+		return CallbackListPtr();
+	}
+
+	void doCopyFrom(const CompactEventDispatcher & other)
+	{
+		std::shared_lock<SharedMutex> lockGuard(other.listenerMutex);
+
+		for(const auto & item : other.eventCallbackListMap) {
+			eventCallbackListMap[item.first] = std::make_shared<CallbackList_>(*item.second);
+		}
+	}
+
+private:
+	Map eventCallbackListMap;
+	mutable SharedMutex listenerMutex;
+};
+
+
+} //namespace eventpp
+
+
+#endif
@@ -15,11 +15,75 @@
 #define EVENTDISPATCHER_H_319010983013
 
 #include "callbacklist.h"
+#include "internal/eventconstant_i.h"
 
 namespace eventpp {
 
 namespace internal_ {
 
+// Mixin related, used by EventDispatcher and ShardedEventDispatcher.
+// OPT-44: A mixin which has mixinBeforeDispatchEvent gets the event too,
+// then its mixinBeforeDispatch is not called.
+template <typename Event>
+struct DispatcherMixinBeforeDispatch
+{
+	template <typename T, typename Self, typename ...A>
+	static auto forEach(const Self * self, int & passedMixinCount, const Event & e, A && ...args)
+		-> typename std::enable_if<HasFunctionMixinBeforeDispatchEvent<T, const Event &, A...>::value, bool>::type {
+		if(! static_cast<const T *>(self)->mixinBeforeDispatchEvent(e, std::forward<A>(args)...)) {
+			return false;
+		}
+		++passedMixinCount;
+		return true;
+	}
+
+	template <typename T, typename Self, typename ...A>
+	static auto forEach(const Self * self, int & passedMixinCount, const Event & /*e*/, A && ...args)
+		-> typename std::enable_if<! HasFunctionMixinBeforeDispatchEvent<T, const Event &, A...>::value
+			&& HasFunctionMixinBeforeDispatch<T, A...>::value, bool>::type {
+		if(! static_cast<const T *>(self)->mixinBeforeDispatch(std::forward<A>(args)...)) {
+			return false;
+		}
+		++passedMixinCount;
+		return true;
+	}
+
+	template <typename T, typename Self, typename ...A>
+	static auto forEach(const Self * /*self*/, int & passedMixinCount, const Event & /*e*/, A && ... /*args*/)
+		-> typename std::enable_if<! HasFunctionMixinBeforeDispatchEvent<T, const Event &, A...>::value
+			&& ! HasFunctionMixinBeforeDispatch<T, A...>::value, bool>::type {
+		++passedMixinCount;
+		return true;
+	}
+};
+
+// Only the first passedMixinCount mixins are called, so a mixin which
+// stopped the dispatch, and the mixins after it, don't get the call.
+template <typename Event>
+struct DispatcherMixinAfterDispatch
+{
+	template <typename T, typename Self>
+	static auto forEach(const Self * self, int & passedMixinCount, const Event & e)
+		-> typename std::enable_if<HasFunctionMixinAfterDispatch<T, const Event &>::value, bool>::type {
+		if(passedMixinCount == 0) {
+			return false;
+		}
+		--passedMixinCount;
+		static_cast<const T *>(self)->mixinAfterDispatch(e);
+		return true;
+	}
+
+	template <typename T, typename Self>
+	static auto forEach(const Self * /*self*/, int & passedMixinCount, const Event & /*e*/)
+		-> typename std::enable_if<! HasFunctionMixinAfterDispatch<T, const Event &>::value, bool>::type {
+		if(passedMixinCount == 0) {
+			return false;
+		}
+		--passedMixinCount;
+		return true;
+	}
+};
+
 template <
 	typename EventType_,
 	typename Prototype_,
@@ -66,9 +130,13 @@ protected:
 	using Callback_ = typename SelectCallback<
 		Policies_,
 		HasTypeCallback<Policies_>::value,
-		std::function<ReturnType (Args...)>
+		typename SelectDefaultCallback<Policies_, ReturnType (Args...)>::Type
 	>::Type;
 	using CallbackList_ = CallbackList<ReturnType (Args...), Policies_>;
+	// OPT-47: NoListenerGroup with ListenerGroupsNone, see ListenerGroups.
+	using ListenerGroup_ = typename SelectListenerGroup<Policies_>::Group;
+	// OPT-86: The listeners share the arguments, see ArgumentFanOut.
+	using SharesArguments = std::is_same<Callback_, FanOutCallback<ReturnType (Args...)> >;
 
 	using Prototype = ReturnType (Args...);
 
@@ -78,12 +146,16 @@ protected:
 		Policies_,
 		HasTemplateMap<Policies_>::value
 	>::Type;
+	using HasConcurrentFind = std::integral_constant<bool, HasTypeConcurrentFind<Map>::value>;
 
 	using Mixins = typename internal_::SelectMixins<
 		Policies_,
 		internal_::HasTypeMixins<Policies_>::value
 	>::Type;
 
+	using DoMixinBeforeDispatch = DispatcherMixinBeforeDispatch<EventType_>;
+	using DoMixinAfterDispatch = DispatcherMixinAfterDispatch<EventType_>;
+
 public:
 	using Handle = typename CallbackList_::Handle;
 	using Callback = Callback_;
@@ -91,37 +163,88 @@ public:
 	using Mutex = typename Threading::Mutex;
 	using SharedMutex = typename Threading::SharedMutex;
 
+public:
+	// OPT-72: The CallbackList of one event, found once by getListenerRef.
+	// dispatch calls the mixins and the list, without looking up the map.
+	// The CallbackLists are never erased from the map, so a ListenerRef is
+	// valid until the dispatcher is destroyed, assigned, moved or swapped.
+	class ListenerRef
+	{
+	public:
+		ListenerRef()
+			: dispatcher(nullptr), event(nullptr), callbackList(nullptr)
+		{
+		}
+
+		explicit operator bool () const {
+			return callbackList != nullptr;
+		}
+
+		void dispatch(Args ...args) const
+		{
+			dispatcher->doDirectDispatchList(*event, callbackList, std::forward<Args>(args)...);
+		}
+
+		bool hasAnyListener() const
+		{
+			return callbackList != nullptr && ! callbackList->empty();
+		}
+
+	private:
+		ListenerRef(const EventDispatcherBase * dispatcher, const Event * event, const CallbackList_ * callbackList)
+			: dispatcher(dispatcher), event(event), callbackList(callbackList)
+		{
+		}
+
+	private:
+		const EventDispatcherBase * dispatcher;
+		const Event * event;  // The key in the map
+		const CallbackList_ * callbackList;
+
+		friend class EventDispatcherBase;
+	};
+
 public:
 	EventDispatcherBase()
 		:
 			eventCallbackListMap(),
-			listenerMutex()
+			listenerMutex(),
+			sealed(false),
+			dispatcherId(getNextDispatcherId())
 	{
 	}
 
 	EventDispatcherBase(const EventDispatcherBase & other)
 		:
 			eventCallbackListMap(other.eventCallbackListMap),
-			listenerMutex()
+			listenerMutex(),
+			sealed(false),
+			dispatcherId(getNextDispatcherId())
 	{
 	}
 
 	EventDispatcherBase(EventDispatcherBase && other) noexcept
 		:
 			eventCallbackListMap(std::move(other.eventCallbackListMap)),
-			listenerMutex()
+			listenerMutex(),
+			sealed(false),
+			dispatcherId(getNextDispatcherId())
 	{
+		other.dispatcherId = getNextDispatcherId();
 	}
 
 	EventDispatcherBase & operator = (const EventDispatcherBase & other)
 	{
 		eventCallbackListMap = other.eventCallbackListMap;
+		dispatcherId = getNextDispatcherId();
 		return *this;
 	}
 
 	EventDispatcherBase & operator = (EventDispatcherBase && other) noexcept
 	{
 		eventCallbackListMap = std::move(other.eventCallbackListMap);
+		dispatcherId = getNextDispatcherId();
+		other.dispatcherId = getNextDispatcherId();
 		return *this;
 	}
 
@@ -129,10 +252,17 @@ public:
 		using std::swap;
 		
 		swap(eventCallbackListMap, other.eventCallbackListMap);
+		dispatcherId = getNextDispatcherId();
+		other.dispatcherId = getNextDispatcherId();
 	}
 
 	Handle appendListener(const Event & event, const Callback & callback)
 	{
+		if(isSealed()) {
+			CallbackList_ * callableList = doFindCallableList(event);
+			return callableList ? callableList->append(callback) : Handle();
+		}
+
 		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
 
 		return eventCallbackListMap[event].append(callback);
@@ -140,6 +270,11 @@ public:
 
 	Handle prependListener(const Event & event, const Callback & callback)
 	{
+		if(isSealed()) {
+			CallbackList_ * callableList = doFindCallableList(event);
+			return callableList ? callableList->prepend(callback) : Handle();
+		}
+
 		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
 
 		return eventCallbackListMap[event].prepend(callback);
@@ -147,11 +282,154 @@ public:
 
 	Handle insertListener(const Event & event, const Callback & callback, const Handle & before)
 	{
+		if(isSealed()) {
+			CallbackList_ * callableList = doFindCallableList(event);
+			return callableList ? callableList->insert(callback, before) : Handle();
+		}
+
 		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
 
 		return eventCallbackListMap[event].insert(callback, before);
 	}
 
+	// OPT-47: The listeners added with a group are removed together by
+	// group.removeAll(), see ListenerGroup.
+	Handle appendListener(const Event & event, const Callback & callback, ListenerGroup_ & group)
+	{
+		if(isSealed()) {
+			CallbackList_ * callableList = doFindCallableList(event);
+			return callableList ? callableList->append(callback, group) : Handle();
+		}
+
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+		return eventCallbackListMap[event].append(callback, group);
+	}
+
+	Handle prependListener(const Event & event, const Callback & callback, ListenerGroup_ & group)
+	{
+		if(isSealed()) {
+			CallbackList_ * callableList = doFindCallableList(event);
+			return callableList ? callableList->prepend(callback, group) : Handle();
+		}
+
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+		return eventCallbackListMap[event].prepend(callback, group);
+	}
+
+	Handle insertListener(const Event & event, const Callback & callback, const Handle & before, ListenerGroup_ & group)
+	{
+		if(isSealed()) {
+			CallbackList_ * callableList = doFindCallableList(event);
+			return callableList ? callableList->insert(callback, before, group) : Handle();
+		}
+
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+		return eventCallbackListMap[event].insert(callback, before, group);
+	}
+
+	// OPT-76: See CallbackList::append(callback, priority).
+	Handle appendListener(const Event & event, const Callback & callback, const int priority)
+	{
+		if(isSealed()) {
+			CallbackList_ * callableList = doFindCallableList(event);
+			return callableList ? callableList->append(callback, priority) : Handle();
+		}
+
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+		return eventCallbackListMap[event].append(callback, priority);
+	}
+
+	Handle appendListener(const Event & event, const Callback & callback, const int priority, ListenerGroup_ & group)
+	{
+		if(isSealed()) {
+			CallbackList_ * callableList = doFindCallableList(event);
+			return callableList ? callableList->append(callback, priority, group) : Handle();
+		}
+
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+		return eventCallbackListMap[event].append(callback, priority, group);
+	}
+
+	// OPT-87: Same as appendListener for each item of [first, last), in
+	// order. An item is the event and the callback, a std::pair or a
+	// std::tuple, and the iterators must be forward iterators.
+	// listenerMutex is locked once, and each run of the items of one event
+	// is looked up once and appended with CallbackList::appendBulk.
+	template <typename Iterator>
+	void appendListeners(Iterator first, Iterator last)
+	{
+		doAppendListeners(first, last, DiscardIterator());
+	}
+
+	// The handles are written to handles in order, returns the end of them.
+	template <typename Iterator, typename OutputIterator>
+	OutputIterator appendListeners(Iterator first, Iterator last, OutputIterator handles)
+	{
+		return doAppendListeners(first, last, handles);
+	}
+
+	// OPT-19: Freeze the set of events in the map. After sealing, dispatch
+	// looks up the map without taking listenerMutex. Listeners can still be
+	// added to or removed from the events which are already in the map, but
+	// appendListener returns an empty handle for a new event.
+	// With FlatArrayMap every event in range is already in the map.
+	void seal()
+	{
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+		sealed.store(true, std::memory_order_release);
+	}
+
+	bool isSealed() const
+	{
+		return sealed.load(std::memory_order_acquire);
+	}
+
+	// OPT-68: Reserve the buckets of the map for eventCount events, so adding
+	// the first listeners of up to eventCount events doesn't rehash the map.
+	// It does nothing if the map has no reserve, such as std::map, or if the
+	// dispatcher is sealed, since dispatch looks up the map without the lock.
+	void reserveEvents(const size_t eventCount)
+	{
+		if(isSealed()) {
+			return;
+		}
+
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+		doReserveEvents(eventCount, std::integral_constant<bool, HasFunctionReserve<Map>::value>());
+	}
+
+	// OPT-72: The event is added to the map if it's not in it, unless the
+	// dispatcher is sealed, then the ListenerRef is empty.
+	ListenerRef getListenerRef(const Event & event)
+	{
+		if(isSealed()) {
+			auto it = eventCallbackListMap.find(event);
+			return it != eventCallbackListMap.end() ? ListenerRef(this, &it->first, &it->second) : ListenerRef();
+		}
+
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+		auto it = eventCallbackListMap.find(event);
+		if(it == eventCallbackListMap.end()) {
+			eventCallbackListMap[event];
+			it = eventCallbackListMap.find(event);
+		}
+		return ListenerRef(this, &it->first, &it->second);
+	}
+
+	// EventConstant::value is the event, such as std::integral_constant<int, 3>.
+	// OPT-79: With TypeId events, EventConstant is the type of the event.
+	template <typename EventConstant>
+	ListenerRef getListenerRef()
+	{
+		return getListenerRef(EventConstantValue<Event, EventConstant>::get());
+	}
+
 	bool removeListener(const Event & event, const Handle handle)
 	{
 		CallbackList_ * callableList = doFindCallableList(event);
@@ -182,6 +460,12 @@ public:
 		return false;
 	}
 
+	// OPT-75: See CallbackList::setProfileTag.
+	static bool setProfileTag(const Handle & handle, const char * tag)
+	{
+		return CallbackList_::setProfileTag(handle, tag);
+	}
+
 	template <typename Func>
 	void forEach(const Event & event, Func && func) const
 	{
@@ -233,18 +517,178 @@ public:
 	// Most used for internal purpose.
 	void directDispatch(const Event & e, Args ...args) const
 	{
-		if(! internal_::ForEachMixins<MixinRoot, Mixins, DoMixinBeforeDispatch>::forEach(
-			this, typename std::add_lvalue_reference<Args>::type(args)...)) {
-			return;
+		// The count of the mixins which let the dispatch go, they get mixinAfterDispatch.
+		int passedMixinCount = 0;
+		if(internal_::ForEachMixins<MixinRoot, Mixins, DoMixinBeforeDispatch>::forEach(
+			this, passedMixinCount, e, typename std::add_lvalue_reference<Args>::type(args)...)) {
+			const CallbackList_ * callableList = doFindCallableList(e);
+			if(callableList) {
+				(*callableList)(std::forward<Args>(args)...);
+			}
+		}
+		internal_::ForEachMixins<MixinRoot, Mixins, DoMixinAfterDispatch>::forEach(this, passedMixinCount, e);
+	}
+
+	// OPT-72: Same as dispatch, but the event is EventConstant::value, known
+	// at compile time. The CallbackList of the event is cached for the
+	// calling thread when it's found, so the later dispatches don't lock
+	// listenerMutex nor look up the map.
+	// OPT-79: With TypeId events, EventConstant is the type of the event.
+	template <typename EventConstant>
+	void dispatch(Args ...args) const
+	{
+		const Event & e = EventConstantValue<Event, EventConstant>::get();
+		doDirectDispatchList(e, doFindConstantCallableList<EventConstant>(e), std::forward<Args>(args)...);
+	}
+
+	// OPT-64: Same as dispatch, but the listeners of the event are called in
+	// parallel on the tasks posted by executor.post(task), see
+	// CallbackList::invokeParallel. The mixins are called on this thread.
+	template <typename Executor>
+	void dispatchParallel(Executor & executor, Args ...args) const
+	{
+		static_assert(ArgumentPassingMode::canIncludeEventType, "Dispatching arguments count doesn't match required (Event type should be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, Args...>::value>::Type;
+
+		directDispatchParallel(
+			executor,
+			GetEvent::getEvent(args...),
+			std::forward<Args>(args)...
+		);
+	}
+
+	template <typename Executor, typename T>
+	void dispatchParallel(Executor & executor, T && first, Args ...args) const
+	{
+		static_assert(ArgumentPassingMode::canExcludeEventType, "Dispatching arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, T &&, Args...>::value>::Type;
+
+		directDispatchParallel(
+			executor,
+			GetEvent::getEvent(std::forward<T>(first), args...),
+			std::forward<Args>(args)...
+		);
+	}
+
+	template <typename Executor>
+	void directDispatchParallel(Executor & executor, const Event & e, Args ...args) const
+	{
+		doDirectDispatchWith(
+			e,
+			[&executor](const CallbackList_ & callbackList, typename std::add_lvalue_reference<Args>::type ...a) {
+				callbackList.invokeParallel(executor, a...);
+			},
+			std::forward<Args>(args)...
+		);
+	}
+
+protected:
+	// OPT-49: Same as directDispatch, but the callback list of the event is
+	// given to invoke(callbackList, args...) instead of being called, so the
+	// caller can see the values returned by the listeners. invoke is not
+	// called if a mixin stops the dispatch or the event has no listener.
+	template <typename Invoke>
+	void doDirectDispatchWith(const Event & e, Invoke && invoke, Args ...args) const
+	{
+		int passedMixinCount = 0;
+		if(internal_::ForEachMixins<MixinRoot, Mixins, DoMixinBeforeDispatch>::forEach(
+			this, passedMixinCount, e, typename std::add_lvalue_reference<Args>::type(args)...)) {
+			const CallbackList_ * callableList = doFindCallableList(e);
+			if(callableList) {
+				invoke(*callableList, args...);
+			}
 		}
+		internal_::ForEachMixins<MixinRoot, Mixins, DoMixinAfterDispatch>::forEach(this, passedMixinCount, e);
+	}
 
+	void doDirectDispatchList(const Event & e, const CallbackList_ * callableList, Args ...args) const
+	{
+		int passedMixinCount = 0;
+		if(internal_::ForEachMixins<MixinRoot, Mixins, DoMixinBeforeDispatch>::forEach(
+			this, passedMixinCount, e, typename std::add_lvalue_reference<Args>::type(args)...)) {
+			if(callableList) {
+				(*callableList)(std::forward<Args>(args)...);
+			}
+		}
+		internal_::ForEachMixins<MixinRoot, Mixins, DoMixinAfterDispatch>::forEach(this, passedMixinCount, e);
+	}
+
+	// Only a found event is cached, so adding the first listener of the
+	// event is seen by the next dispatch.
+	template <typename EventConstant>
+	const CallbackList_ * doFindConstantCallableList(const Event & e) const
+	{
+		EventConstantCache<CallbackList_> & cache = getEventConstantCache<ThisType, EventConstant, CallbackList_>();
+		if(cache.dispatcherId == dispatcherId) {
+			return cache.callbackList;
+		}
 		const CallbackList_ * callableList = doFindCallableList(e);
-		if(callableList) {
-			(*callableList)(std::forward<Args>(args)...);
+		if(callableList != nullptr) {
+			cache.dispatcherId = dispatcherId;
+			cache.callbackList = callableList;
 		}
+		return callableList;
+	}
+
+	void doReserveEvents(const size_t eventCount, std::true_type)
+	{
+		eventCallbackListMap.reserve(eventCount);
+	}
+
+	void doReserveEvents(const size_t /*eventCount*/, std::false_type)
+	{
+	}
+
+	// OPT-25: The CallbackList of the last event dispatched with
+	// doDirectDispatchCached. The CallbackLists are never erased from the map,
+	// so the pointers stay valid while the dispatcher is alive. Only a found
+	// event is cached, so a listener which adds the first listener of an
+	// event is seen by the next event of the run, same as directDispatch.
+	struct DispatchCache
+	{
+		const Event * event = nullptr;  // The key in the map
+		const CallbackList_ * callbackList = nullptr;
+	};
+
+	// Same as directDispatch, but when e equals the cached event, the map is
+	// not looked up and listenerMutex is not locked. A queue which dispatches
+	// a batch keeps one cache for the batch, so a run of the same event costs
+	// one lookup.
+	void doDirectDispatchCached(DispatchCache & cache, const Event & e, Args ...args) const
+	{
+		int passedMixinCount = 0;
+		if(internal_::ForEachMixins<MixinRoot, Mixins, DoMixinBeforeDispatch>::forEach(
+			this, passedMixinCount, e, typename std::add_lvalue_reference<Args>::type(args)...)) {
+			if(! doIsCachedEvent(cache, e)) {
+				doFindDispatchCache(cache, e);
+			}
+			if(cache.callbackList != nullptr) {
+				(*cache.callbackList)(std::forward<Args>(args)...);
+			}
+		}
+		internal_::ForEachMixins<MixinRoot, Mixins, DoMixinAfterDispatch>::forEach(this, passedMixinCount, e);
+	}
+
+	// OPT-86: Same as doDirectDispatchCached, but the arguments are given by
+	// reference, to CallbackList::invokeShared, so a queue dispatches its
+	// queued arguments without copying them.
+	void doDirectDispatchSharedCached(DispatchCache & cache, const Event & e, typename FanOutPass<Args>::Argument ...args) const
+	{
+		int passedMixinCount = 0;
+		if(internal_::ForEachMixins<MixinRoot, Mixins, DoMixinBeforeDispatch>::forEach(
+			this, passedMixinCount, e, args...)) {
+			if(! doIsCachedEvent(cache, e)) {
+				doFindDispatchCache(cache, e);
+			}
+			if(cache.callbackList != nullptr) {
+				cache.callbackList->invokeShared(args...);
+			}
+		}
+		internal_::ForEachMixins<MixinRoot, Mixins, DoMixinAfterDispatch>::forEach(this, passedMixinCount, e);
 	}
 
-protected:
 	const CallbackList_ * doFindCallableList(const Event & e) const
 	{
 		return doFindCallableListHelper(this, e);
@@ -255,7 +699,82 @@ protected:
 		return doFindCallableListHelper(this, e);
 	}
 
+	void doFindDispatchCache(DispatchCache & cache, const Event & e) const
+	{
+		std::shared_lock<SharedMutex> lockGuard(listenerMutex, std::defer_lock);
+		if(! isSealed() && ! HasConcurrentFind::value) {
+			lockGuard.lock();
+		}
+
+		auto it = eventCallbackListMap.find(e);
+		if(it != eventCallbackListMap.end()) {
+			cache.event = &it->first;
+			cache.callbackList = &it->second;
+		}
+		else {
+			cache = DispatchCache();
+		}
+	}
+
 private:
+	template <typename E = Event>
+	static auto doIsCachedEvent(const DispatchCache & cache, const E & e)
+		-> typename std::enable_if<HasOperatorEqual<E>::value, bool>::type
+	{
+		return cache.event != nullptr && *cache.event == e;
+	}
+
+	// Events which can't be compared are looked up every time.
+	template <typename E = Event>
+	static auto doIsCachedEvent(const DispatchCache & /*cache*/, const E & /*e*/)
+		-> typename std::enable_if<! HasOperatorEqual<E>::value, bool>::type
+	{
+		return false;
+	}
+
+	template <typename Iterator, typename OutputIterator>
+	OutputIterator doAppendListeners(Iterator first, Iterator last, OutputIterator handles)
+	{
+		if(isSealed()) {
+			for(; first != last; ++first) {
+				const auto & item = *first;
+				*handles = appendListener(std::get<0>(item), std::get<1>(item));
+				++handles;
+			}
+			return handles;
+		}
+
+		std::unique_lock<SharedMutex> lockGuard(listenerMutex);
+
+		while(first != last) {
+			const auto & item = *first;
+			Iterator runEnd = first;
+			++runEnd;
+			while(runEnd != last && doIsSameEvent(std::get<0>(*runEnd), std::get<0>(item))) {
+				++runEnd;
+			}
+			handles = eventCallbackListMap[std::get<0>(item)].doAppendBulk(first, runEnd, BulkItemSecond(), handles);
+			first = runEnd;
+		}
+
+		return handles;
+	}
+
+	// The events which can't be compared are runs of one item.
+	template <typename E = Event>
+	static auto doIsSameEvent(const E & a, const E & b)
+		-> typename std::enable_if<HasOperatorEqual<E>::value, bool>::type
+	{
+		return a == b;
+	}
+
+	template <typename E = Event>
+	static auto doIsSameEvent(const E & /*a*/, const E & /*b*/)
+		-> typename std::enable_if<! HasOperatorEqual<E>::value, bool>::type
+	{
+		return false;
+	}
+
 	// template helper to avoid code duplication in doFindCallableList
 	template <typename T>
 	static auto doFindCallableListHelper(T * self, const Event & e)
@@ -265,6 +784,14 @@ private:
 		// dispatch() is the hot path (high frequency, read-only map access).
 		// appendListener() is the cold path (low frequency, map modification).
 		// shared_lock allows concurrent dispatches without blocking each other.
+		// OPT-19: A sealed map never changes its structure, no lock is needed.
+		// OPT-37: Neither is it for a map which can be found while it's
+		// inserted into, such as ConcurrentListenerMap.
+		if(HasConcurrentFind::value || self->isSealed()) {
+			auto it = self->eventCallbackListMap.find(e);
+			return it != self->eventCallbackListMap.end() ? &it->second : nullptr;
+		}
+
 		std::shared_lock<SharedMutex> lockGuard(self->listenerMutex);
 
 		auto it = self->eventCallbackListMap.find(e);
@@ -276,26 +803,11 @@ private:
 		}
 	}
 
-private:
-	// Mixin related
-	struct DoMixinBeforeDispatch
-	{
-		template <typename T, typename Self, typename ...A>
-		static auto forEach(const Self * self, A && ...args)
-			-> typename std::enable_if<HasFunctionMixinBeforeDispatch<T, A...>::value, bool>::type {
-			return static_cast<const T *>(self)->mixinBeforeDispatch(std::forward<A>(args)...);
-		}
-
-		template <typename T, typename Self, typename ...A>
-		static auto forEach(const Self * /*self*/, A && ... /*args*/)
-			-> typename std::enable_if<! HasFunctionMixinBeforeDispatch<T, A...>::value, bool>::type {
-			return true;
-		}
-	};
-
 private:
 	Map eventCallbackListMap;
 	mutable SharedMutex listenerMutex;
+	typename Threading::template Atomic<bool> sealed;
+	std::uint64_t dispatcherId;
 };
 
 
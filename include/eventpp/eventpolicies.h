@@ -15,12 +15,15 @@
 #define EVENTOPTIONS_H_730367862613
 
 #include "internal/typeutil_i.h"
+#include "internal/spinwait_i.h"
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <map>
 #include <unordered_map>
 #include <list>
+#include <memory>
 #include <shared_mutex>
 
 namespace eventpp {
@@ -64,11 +67,7 @@ public:
 		unsigned backoff = 1;
 		while(locked.test_and_set(std::memory_order_acquire)) {
 			for(unsigned i = 0; i < backoff; ++i) {
-#if defined(__aarch64__) || defined(__arm__)
-				__asm__ __volatile__("yield");
-#elif defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
-				__builtin_ia32_pause();
-#endif
+				internal_::cpuRelax();
 			}
 			if(backoff < kMaxBackoff) {
 				backoff <<= 1;
@@ -189,27 +188,55 @@ struct SingleThreading
 			return previous;
 		}
 
+		bool compare_exchange_weak(T & expected, T desired, std::memory_order /*order*/ = std::memory_order_seq_cst) noexcept
+		{
+			if(value == expected) {
+				value = desired;
+				return true;
+			}
+			expected = value;
+			return false;
+		}
+
 		T value;
 	};
 
+	// OPT-81: Nothing changes while a single thread waits, so the waits
+	// return at once with the predicate. The lock is any lock, as the queues
+	// lock the Mutex of the policy.
 	struct ConditionVariable
 	{
 		void notify_one() noexcept
 		{
 		}
+
+		void notify_all() noexcept
+		{
+		}
+
+		template <class Lock>
+		void wait(Lock & /*lock*/)
+		{
+		}
 		
-		template <class Predicate>
-		void wait(std::unique_lock<std::mutex> & /*lock*/, Predicate /*pred*/)
+		template <class Lock, class Predicate>
+		void wait(Lock & /*lock*/, Predicate /*pred*/)
 		{
 		}
 		
-		template <class Rep, class Period, class Predicate>
-		bool wait_for(std::unique_lock<std::mutex> & /*lock*/,
+		template <class Lock, class Rep, class Period, class Predicate>
+		bool wait_for(Lock & /*lock*/,
 				const std::chrono::duration<Rep, Period> & /*rel_time*/,
-				Predicate /*pred*/
+				Predicate pred
 			)
 		{
-			return true;
+			return pred();
+		}
+
+		template <class Lock, class Clock, class Duration>
+		std::cv_status wait_until(Lock & /*lock*/, const std::chrono::time_point<Clock, Duration> & /*abs_time*/)
+		{
+			return std::cv_status::timeout;
 		}
 	};
 };
@@ -238,6 +265,249 @@ struct ArgumentPassingExcludeEvent
 	};
 };
 
+// OPT-16: Listener storage of CallbackList.
+// ListenerStorageLinkedList is the default, a doubly linked list of nodes.
+// ListenerStorageSnapshot keeps the listeners in a contiguous copy-on-write
+// snapshot, which is best for listener sets that rarely change after startup.
+// OPT-61: ListenerStorageSlotMap keeps the nodes in a slot table, the Handle
+// is a 64-bit index and generation instead of a weak_ptr.
+struct ListenerStorageLinkedList {};
+struct ListenerStorageSnapshot {};
+struct ListenerStorageSlotMap {};
+
+// OPT-69: What the listeners may do to their own CallbackList while it's
+// invoked, used by ListenerStorageLinkedList.
+// ReentrancyFull is the default, listeners may add and remove listeners,
+// the ones added are not called in the same invoking.
+// ReentrancyAppendOnlyOutsideDispatch: no listener is added to the list
+// while it's invoked, removing is fine. The counter check is skipped.
+// ReentrancyNone: invoking takes the nodes under the lock once, then calls
+// them without the lock and without reference counts. Listeners may add and
+// remove listeners, the ones added are not called in the same invoking.
+// A removed node is retired to the epoch reclaimer, not freed.
+struct ReentrancyFull {};
+struct ReentrancyAppendOnlyOutsideDispatch {};
+struct ReentrancyNone {};
+
+// OPT-86: How CallbackList passes the arguments of a prototype which takes
+// them by value, such as void (std::string), to the listeners. Used by
+// ListenerStorageLinkedList with the default Callback.
+// ArgumentFanOutCopy is the default, each listener gets its own copy.
+// ArgumentFanOutShared: a listener which can take the arguments by const
+// reference gets the arguments of the invoking, not a copy. It's decided
+// for each listener when it's added. EventQueue gives the listeners the
+// arguments in the queue, by reference.
+// ArgumentFanOutMoveLast: same as ArgumentFanOutShared, and the arguments
+// are moved to the last listener which is called.
+struct ArgumentFanOutCopy {};
+struct ArgumentFanOutShared {};
+struct ArgumentFanOutMoveLast {};
+
+// OPT-47: Whether the listeners can be added with a ListenerGroup.
+// ListenerGroupsNone is the default, the nodes have no group, and the
+// functions taking a ListenerGroup don't exist. ScopedRemover, CounterRemover
+// and ConditionalRemover remove the listeners by their handles.
+// ListenerGroupsEnabled: each node keeps a reference to its group, and
+// ListenerGroup::removeAll, so ScopedRemover::reset, removes all listeners
+// of a group with one atomic store.
+struct ListenerGroupsNone {};
+struct ListenerGroupsEnabled {};
+
+// OPT-17: Policies of RingEventQueue.
+// RingOverflow decides what enqueue does when the ring is full.
+// RingProducer tells whether more than one thread may enqueue concurrently.
+struct RingOverflowBlock {};
+struct RingOverflowDropNewest {};
+struct RingOverflowDropOldest {};
+struct RingOverflowReturnFalse {};
+
+struct RingProducerMulti {};
+struct RingProducerSingle {};
+
+// OPT-26: Queue storage of HeterEventQueue.
+// QueueStorageList is the default, one list node per event, each node is
+// sized to the largest prototype. The list type is the QueueList policy.
+// QueueStoragePacked puts the events one after another in a contiguous
+// buffer, each event takes only the size of its own arguments.
+struct QueueStorageList {};
+struct QueueStoragePacked {};
+
+// OPT-29: Delayed events of EventQueue.
+// TimerNone is the default, enqueueAt and enqueueAfter are not available.
+// TimerWheel keeps the delayed events in a hierarchical timing wheel, the
+// due events are moved to the queue when the queue is processed.
+struct TimerNone {};
+struct TimerWheel {};
+
+// OPT-81: The Clock policy of EventQueue is the clock of the delayed events,
+// the deadlines, processFor and the timed waits. It's a type like
+// std::chrono::steady_clock, which is the default,
+//   using duration = ...;
+//   using time_point = ...;
+//   static time_point now();
+// A virtual clock also has
+//   static void advanceTo(const time_point & timePoint);
+// and the waits of the queue advance it instead of waiting, so a replay runs
+// at the speed of the CPU. See eventpp/utilities/virtualclock.h.
+
+// OPT-30: Pollable notifier of EventQueue.
+// QueueNotifierNone is the default, the queue can only be waited by wait and
+// waitFor. QueueNotifierFd adds a file descriptor which becomes readable when
+// the queue turns from empty to non-empty, so the queue can be polled with
+// epoll, poll or io_uring together with the sockets. It uses eventfd on Linux,
+// a pipe on the other POSIX systems.
+struct QueueNotifierNone {};
+struct QueueNotifierFd {};
+
+// OPT-31: How EventQueue::wait and waitFor wait for the events.
+// The waiting thread spins spinCount times with a CPU pause hint, then yields
+// yieldCount times, then parks on the condition variable if park is true.
+// If park is false, it keeps yielding, or spinning if yieldCount is 0, until
+// the timeout. If adaptive is true, the spin count is between minSpinCount
+// and spinCount, it grows when the events arrive while spinning, and shrinks
+// when the thread has to yield or park.
+template <unsigned spinCount_ = 128, unsigned yieldCount_ = 16>
+struct WaitSpinThenPark
+{
+	enum {
+		spinCount = spinCount_,
+		minSpinCount = spinCount_,
+		yieldCount = yieldCount_,
+		park = true,
+		adaptive = false
+	};
+};
+
+template <unsigned spinCount_ = 128, unsigned yieldCount_ = 16>
+struct WaitSpinThenYield
+{
+	enum {
+		spinCount = spinCount_,
+		minSpinCount = spinCount_,
+		yieldCount = (yieldCount_ == 0 ? 1 : yieldCount_),
+		park = false,
+		adaptive = false
+	};
+};
+
+struct WaitBusySpin
+{
+	enum {
+		spinCount = 0,
+		minSpinCount = 0,
+		yieldCount = 0,
+		park = false,
+		adaptive = false
+	};
+};
+
+// Parks at once. std::condition_variable is a futex wait on Linux.
+struct WaitBlocking
+{
+	enum {
+		spinCount = 0,
+		minSpinCount = 0,
+		yieldCount = 0,
+		park = true,
+		adaptive = false
+	};
+};
+
+template <unsigned minSpinCount_ = 16, unsigned maxSpinCount_ = 4096, unsigned yieldCount_ = 16>
+struct WaitAdaptive
+{
+	enum {
+		spinCount = maxSpinCount_,
+		minSpinCount = (minSpinCount_ == 0 ? 1 : minSpinCount_),
+		yieldCount = yieldCount_,
+		park = true,
+		adaptive = true
+	};
+};
+
+// OPT-60: Same as WaitSpinThenPark, but each of the monitorCount rounds of
+// the spin phase sleeps in a low power state until a producer publishes an
+// event, with WFE on AArch64 and UMWAIT on x86 with WAITPKG. A round ends
+// after about 30 to 100 us if nothing is published. On the other CPUs a
+// round spins with a pause hint.
+template <unsigned monitorCount_ = 32, unsigned yieldCount_ = 0>
+struct WaitMonitorThenPark
+{
+	enum {
+		spinCount = monitorCount_,
+		minSpinCount = monitorCount_,
+		yieldCount = yieldCount_,
+		park = true,
+		adaptive = false,
+		monitor = true
+	};
+};
+
+// OPT-33: Enqueue time of the events in EventQueue.
+// QueueTimestampNone is the default, the queued events don't carry a time.
+// QueueTimestampSteady stamps each event with std::chrono::steady_clock when
+// it's enqueued, so the mixins can measure how long it stays in the queue,
+// see MixinMetrics.
+struct QueueTimestampNone {};
+struct QueueTimestampSteady {};
+
+// OPT-34: Tracer of EventQueue.
+// TracerNone is the default, nothing is traced. Any other type is a tracer,
+// the queued events carry the enqueue time and a 64-bit trace ID, and the
+// tracer gets a TraceRecord for each enqueue and each dispatch,
+//   static void onEnqueue(const TraceRecord & record);
+//   static void onDispatch(const TraceRecord & record);
+// An event enqueued by a listener gets the trace ID of the event being
+// dispatched, so a trace follows the events through the chained queues.
+// See eventpp/utilities/tracers.h for the tracers.
+struct TracerNone {};
+
+// OPT-49: Replies of EventQueue, see EventQueue::enqueueWithReply.
+// QueueReplyNone is the default, the queued events carry no reply.
+// With QueueReplyPooled, each queued event has a pointer to a reply slot,
+// which is null unless the event is enqueued by enqueueWithReply. The
+// slots come from a pool.
+struct QueueReplyNone {};
+struct QueueReplyPooled {};
+
+// OPT-53: Capacity of EventQueue, see EventQueue::setQueueLimits.
+// QueueCapacityNone is the default, the queue is unbounded and counts
+// nothing. With QueueCapacityLimited, the queue counts its events against
+// the limits, and QueueOverflow decides what enqueue does when the queue
+// is full: wait for room, drop the new event, or drop the oldest event.
+struct QueueCapacityNone {};
+struct QueueCapacityLimited {};
+
+struct QueueOverflowBlock {};
+struct QueueOverflowDropNewest {};
+struct QueueOverflowDropOldest {};
+
+// OPT-55: Deadlines of the events in EventQueue.
+// QueueDeadlineNone is the default, the events never expire. With
+// QueueDeadlineSteady, each event carries a std::chrono::steady_clock
+// deadline, set by enqueueWithDeadline, or by the policy function
+//   static Duration getTimeToLive(const Event & event, const Args & ...args);
+// when the event is enqueued. The process functions drop the events which
+// are past their deadline without calling the listeners, and count them.
+// Use DeadlineQueueList to process the earliest deadline first.
+struct QueueDeadlineNone {};
+struct QueueDeadlineSteady {};
+
+// OPT-75: Profiler of CallbackList.
+// ProfilerNone is the default, the listeners are not timed and the nodes
+// carry nothing. Any other type is a profiler, each invoking is a dispatch,
+// and each listener call in it is reported,
+//   static void onDispatchBegin(const void * callbackList);
+//   static void onDispatchEnd(const void * callbackList);
+//   static std::uint64_t onListenerBegin(const void * callbackList, const void * listener, const char * tag);
+//   template <typename Handle>
+//   static void onListenerEnd(const void * callbackList, const void * listener, const char * tag,
+//       std::uint64_t beginTicks, const Handle & handle);
+// listener is the address of the node, handle is a std::weak_ptr to it, and
+// tag is set by CallbackList::setProfileTag. Only ListenerStorageLinkedList
+// supports it. See eventpp/utilities/listenerprofiler.h for the profiler.
+struct ProfilerNone {};
+
 struct DefaultPolicies
 {
 };
@@ -17,10 +17,30 @@
 #include "eventdispatcher.h"
 #include "internal/eventqueue_i.h"
 #include "internal/poolallocator_i.h"
+#include "internal/timingwheel_i.h"
+#include "internal/fdnotifier_i.h"
+#include "internal/tracing_i.h"
+#include "internal/queuereply_i.h"
+#include "internal/coroutine_i.h"
+#include "internal/queueset_i.h"
+#include "internal/waitmonitor_i.h"
+#include "internal/batchlisteners_i.h"
+#include "internal/prefetch_i.h"
+#include "internal/spinwait_i.h"
+#include "internal/queuewaitcore_i.h"
 
 #include <tuple>
 #include <chrono>
+#include <cstdint>
 #include <thread>
+#include <iterator>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#if EVENTPP_HAS_COROUTINE
+#include <optional>
+#endif
 
 namespace eventpp {
 
@@ -68,13 +88,82 @@ private:
 	using Policies = typename super::Policies;
 	using Threading = typename super::Threading;
 	using ConditionVariable = typename Threading::ConditionVariable;
+	using DispatchCache = typename super::DispatchCache;
 
 	using QueuedEventArgumentsType = std::tuple<typename std::decay<Args>::type...>;
 
-	struct QueuedEvent_
+	struct PlainQueuedEvent
+	{
+		typename std::decay<typename super::Event>::type event;
+		QueuedEventArgumentsType arguments;
+
+		typename super::Event getEvent() const {
+			return event;
+		}
+
+		template <std::size_t N>
+		auto getArgument() const
+			-> typename std::tuple_element<N, std::tuple<Args...> >::type {
+			return std::get<N>(arguments);
+		}
+	};
+
+	// OPT-81: The clock of the delayed events, the deadlines and the waits.
+	using TimerClock = typename SelectClock<Policies_, HasTypeClock<Policies_>::value>::Type;
+	using TimerTimePoint = typename TimerClock::time_point;
+	using TimerDuration = typename TimerClock::duration;
+	using IsVirtualClock = std::integral_constant<bool, HasFunctionAdvanceTo<TimerClock>::value>;
+	using QueueTimestamp = typename SelectQueueTimestamp<Policies_, HasTypeQueueTimestamp<Policies_>::value>::Type;
+	using Tracer = typename SelectTracer<Policies_, HasTypeTracer<Policies_>::value>::Type;
+	using HasTracer = std::integral_constant<bool, ! std::is_same<Tracer, TracerNone>::value>;
+	using HasQueueTimestamp = std::integral_constant<bool, std::is_same<QueueTimestamp, QueueTimestampSteady>::value || HasTracer::value>;
+	using QueueReplyType = typename SelectQueueReply<Policies_, HasTypeQueueReply<Policies_>::value>::Type;
+	using HasQueueReply = std::integral_constant<bool, std::is_same<QueueReplyType, QueueReplyPooled>::value>;
+	using QueueDeadline = typename SelectQueueDeadline<Policies_, HasTypeQueueDeadline<Policies_>::value>::Type;
+	using HasQueueDeadline = std::integral_constant<bool, std::is_same<QueueDeadline, QueueDeadlineSteady>::value>;
+	using QueuePrefetchDistance = typename SelectQueuePrefetchDistance<Policies_, HasTypeQueuePrefetchDistance<Policies_>::value>::Type;
+	using Prefetcher = ListPrefetcher<QueuePrefetchDistance::value>;
+	// A visitor is usually too short to hide the prefetch, so processQueueWith
+	// only prefetches when QueuePrefetchDistance is set by the policies.
+	using VisitPrefetcher = ListPrefetcher<
+		HasTypeQueuePrefetchDistance<Policies_>::value ? QueuePrefetchDistance::value : 0
+	>;
+	using HasTimeToLive = std::integral_constant<bool, HasFunctionGetTimeToLive<
+		Policies_, const typename std::decay<typename super::Event>::type &, const typename std::decay<Args>::type &...
+	>::value>;
+	using ReplyResult = typename std::decay<ReturnType>::type;
+	using ReplyCallbackList = CallbackList<ReturnType (Args...), Policies_>;
+	using CanContinueInvoking = typename SelectCanContinueInvoking<
+		Policies_, HasFunctionCanContinueInvoking<Policies_, Args...>::value
+	>::Type;
+
+	// OPT-33: Same as PlainQueuedEvent, plus the time it's made by enqueue.
+	// OPT-34: And the trace ID if there is a Tracer.
+	// OPT-49: And the reply slot with QueueReplyPooled.
+	// OPT-55: And the deadline with QueueDeadlineSteady.
+	// The stamp is initialized by its default member initializers, so the
+	// event is still built as QueuedEvent{ event, arguments }.
+	using QueueTimeOrTraceStamp = typename std::conditional<
+		HasTracer::value,
+		QueueTraceStamp,
+		typename std::conditional<HasQueueTimestamp::value, QueueTimeStamp, QueueEmptyStamp>::type
+	>::type;
+	using QueueTimeOrDeadlineStamp = typename std::conditional<
+		HasQueueDeadline::value,
+		QueueDeadlineStamp<QueueTimeOrTraceStamp, TimerTimePoint>,
+		QueueTimeOrTraceStamp
+	>::type;
+	using QueueStamp = typename std::conditional<
+		HasQueueReply::value,
+		QueueReplyStamp<QueueTimeOrDeadlineStamp, ReplyResult>,
+		QueueTimeOrDeadlineStamp
+	>::type;
+
+	struct StampedQueuedEvent
 	{
 		typename std::decay<typename super::Event>::type event;
 		QueuedEventArgumentsType arguments;
+		QueueStamp stamp = QueueStamp();
 
 		typename super::Event getEvent() const {
 			return event;
@@ -85,6 +174,39 @@ private:
 			-> typename std::tuple_element<N, std::tuple<Args...> >::type {
 			return std::get<N>(arguments);
 		}
+
+		template <typename S = QueueStamp>
+		auto getEnqueueTime() const -> decltype(std::declval<const S &>().enqueueTime) {
+			return stamp.enqueueTime;
+		}
+
+		template <typename S = QueueStamp>
+		auto getTraceId() const -> decltype(std::declval<const S &>().traceId) {
+			return stamp.traceId;
+		}
+
+		template <typename S = QueueStamp>
+		auto getDeadline() const -> decltype(std::declval<const S &>().deadline) {
+			return stamp.deadline;
+		}
+	};
+
+	using QueuedEvent_ = typename std::conditional<
+		HasQueueTimestamp::value || HasQueueReply::value || HasQueueDeadline::value,
+		StampedQueuedEvent,
+		PlainQueuedEvent
+	>::type;
+	using TraceScope = typename std::conditional<
+		HasTracer::value,
+		TraceDispatchScope<Tracer, QueuedEvent_>,
+		NoTraceDispatchScope<QueuedEvent_>
+	>::type;
+
+	struct GetItemArguments
+	{
+		const QueuedEventArgumentsType & operator() (const BufferedItem<QueuedEvent_> & item) const {
+			return item.get().arguments;
+		}
 	};
 
 	using BufferedItemList = typename SelectQueueList<
@@ -93,12 +215,177 @@ private:
 		HasTemplateQueueList<Policies_>::value
 	>::Type;
 
+	using Timer = typename SelectTimer<Policies_, HasTypeTimer<Policies_>::value>::Type;
+	using TimerResolution = typename SelectTimerResolution<Policies_, HasTypeTimerResolution<Policies_>::value>::Type;
+	using HasTimer = std::integral_constant<bool, std::is_same<Timer, TimerWheel>::value>;
+	using DelayedEventWheel = TimingWheel<QueuedEvent_>;
+	using TimerTick = typename DelayedEventWheel::Tick;
+
+	// OPT-29: The delayed events. The ticks are TimerResolution since epoch.
+	// nextTick is a copy of wheel.getNextTick(), so the queue can tell
+	// whether any event is due without locking the wheel.
+	struct DelayedEvents
+	{
+		DelayedEvents()
+			: mutex(), wheel(), nextTick(DelayedEventWheel::noTick), epoch(TimerClock::now())
+		{
+		}
+
+		typename super::Mutex mutex;
+		DelayedEventWheel wheel;
+		typename Threading::template Atomic<TimerTick> nextTick;
+		const TimerTimePoint epoch;
+	};
+
+	struct NoDelayedEvents
+	{
+	};
+
+	using QueueNotifier = typename SelectQueueNotifier<Policies_, HasTypeQueueNotifier<Policies_>::value>::Type;
+	using HasQueueNotifier = std::integral_constant<bool, std::is_same<QueueNotifier, QueueNotifierFd>::value>;
+
+	static_assert(! HasQueueNotifier::value || EVENTPP_HAS_FD_NOTIFIER, "QueueNotifierFd is not supported on this platform.");
+
+	struct NoQueueNotifier
+	{
+	};
+
+	using WaitStrategy = typename SelectWaitStrategy<Policies_, HasTypeWaitStrategy<Policies_>::value>::Type;
+	using IsWaitPark = std::integral_constant<bool, WaitStrategy::park>;
+	using HasWaitMonitor = std::integral_constant<bool, IsWaitMonitor<WaitStrategy>::value>;
+
+	static_assert(WaitStrategy::minSpinCount <= WaitStrategy::spinCount, "WaitStrategy: minSpinCount must not be greater than spinCount.");
+	using QueueParkCore = internal_::QueueParkCore<typename super::Mutex, ConditionVariable>;
+
+	// OPT-60: The producers increase the word after they publish events, the
+	// consumer monitors its cache line, so it's on its own line.
+	struct WaitMonitorWord
+	{
+		EVENTPP_ALIGN_CACHELINE std::atomic<std::uint32_t> word { 0 };
+	};
+
+	struct NoWaitMonitorWord
+	{
+	};
+
+	using QueueCapacity = typename SelectQueueCapacity<Policies_, HasTypeQueueCapacity<Policies_>::value>::Type;
+	using HasQueueCapacity = std::integral_constant<bool, std::is_same<QueueCapacity, QueueCapacityLimited>::value>;
+	using QueueOverflow = typename SelectQueueOverflow<Policies_, HasTypeQueueOverflow<Policies_>::value>::Type;
+
+	// OPT-65: The batch listeners are in their own dispatcher, see
+	// appendBatchListener.
+	using BatchDispatcher = EventDispatcher<
+		EventType_,
+		void (BatchSpan<typename std::decay<Args>::type>...),
+		BatchListenerPolicies<Policies_, HasTemplateMap<Policies_>::value>
+	>;
+	using BatchColumnList = BatchColumns<typename std::decay<Args>::type...>;
+	using CanBatch = std::integral_constant<bool,
+		CanBatchArguments<typename std::decay<Args>::type...>::value
+		&& std::is_copy_constructible<typename std::decay<EventType_>::type>::value
+	>;
+
 public:
 	using QueuedEvent = QueuedEvent_;
+	using Reply = QueueReply<ReplyResult>;
 	using Event = typename super::Event;
 	using Handle = typename super::Handle;
 	using Callback = typename super::Callback;
 	using Mutex = typename super::Mutex;
+	using BatchHandle = typename BatchDispatcher::Handle;
+	using BatchCallback = typename BatchDispatcher::Callback;
+	// OPT-81: The Clock policy, std::chrono::steady_clock by default.
+	using Clock = TimerClock;
+
+	// OPT-31: See getWaitStats.
+	struct WaitStats
+	{
+		std::uint64_t spinWakeCount;
+		std::uint64_t yieldWakeCount;
+		std::uint64_t parkCount;
+		std::uint64_t timeoutCount;
+		unsigned int spinLimit;
+	};
+
+	// OPT-53: See setQueueLimits. Zero is no limit.
+	struct QueueLimits
+	{
+		std::size_t maxEventCount = 0;
+		std::size_t maxByteCount = 0;
+		std::size_t highWatermark = 0;
+		std::size_t lowWatermark = 0;
+		std::size_t maxFreeCount = 0;
+	};
+
+	using OverflowCallback = std::function<void (const QueuedEvent &)>;
+	using WatermarkCallback = std::function<void (bool)>;
+
+private:
+	// OPT-53: The count of the events of QueueCapacityLimited, from when
+	// they are admitted until their nodes are given back, and the limits.
+	// eventCount is written by the producers and the consumers, the limits
+	// are copied to atomics so enqueue doesn't lock to read them.
+	struct CapacityState
+	{
+		CapacityState()
+			:
+				eventCount(0),
+				eventLimit((std::numeric_limits<std::size_t>::max)()),
+				highWatermark((std::numeric_limits<std::size_t>::max)()),
+				lowWatermark(0),
+				maxFreeCount((std::numeric_limits<std::size_t>::max)()),
+				droppedEventCount(0),
+				waitingProducerCount(0),
+				aboveHighWatermark(false),
+				freeCount(0),
+				mutex(),
+				notFullConditionVariable(),
+				watermarkMutex(),
+				limits(),
+				overflowCallback(),
+				watermarkCallback()
+		{
+		}
+
+		EVENTPP_ALIGN_CACHELINE typename Threading::template Atomic<std::size_t> eventCount;
+		typename Threading::template Atomic<std::size_t> eventLimit;
+		typename Threading::template Atomic<std::size_t> highWatermark;
+		typename Threading::template Atomic<std::size_t> lowWatermark;
+		typename Threading::template Atomic<std::size_t> maxFreeCount;
+		typename Threading::template Atomic<std::size_t> droppedEventCount;
+		typename Threading::template Atomic<int> waitingProducerCount;
+		typename Threading::template Atomic<bool> aboveHighWatermark;
+		// Guarded by freeListMutex.
+		std::size_t freeCount;
+		typename super::Mutex mutex;
+		ConditionVariable notFullConditionVariable;
+		typename super::Mutex watermarkMutex;
+		// Guarded by mutex.
+		QueueLimits limits;
+		OverflowCallback overflowCallback;
+		// Guarded by watermarkMutex.
+		WatermarkCallback watermarkCallback;
+	};
+
+	struct NoCapacityState
+	{
+	};
+
+	// OPT-55: The count of the events dropped past their deadline.
+	struct DeadlineState
+	{
+		DeadlineState() : expiredEventCount(0)
+		{
+		}
+
+		typename Threading::template Atomic<std::uint64_t> expiredEventCount;
+	};
+
+	struct NoDeadlineState
+	{
+	};
+
+public:
 
 	struct DisableQueueNotify
 	{
@@ -113,6 +400,10 @@ public:
 			--queue->queueNotifyCounter;
 
 			if(queue->doCanNotifyQueueAvailable() && ! queue->emptyQueue()) {
+				queue->doSignalNotifier(true, HasQueueNotifier());
+				queue->doWakeAwaiters();
+				queue->doSignalQueueSet();
+				queue->doSignalWaitMonitor(HasWaitMonitor());
 				queue->queueListConditionVariable.notify_one();
 			}
 		}
@@ -120,521 +411,3285 @@ public:
 		EventQueueBase * queue;
 	};
 
-public:
-	EventQueueBase()
-		:
-			super(),
-			queueListConditionVariable(),
-			queueEmptyCounter(0),
-			queueNotifyCounter(0),
-			queueListMutex(),
-			queueList(),
-			freeListMutex(),
-			freeList()
+	// Staging buffer owned by one producer thread.
+	// enqueue puts the event in the buffer without touching the queue list.
+	// The buffered events are moved to the queue in one splice when there are
+	// flushThreshold events, when flush() is called, when the buffer is
+	// destroyed, or when a consumer processes the queue. The order of the
+	// events from the same buffer is kept.
+	// A buffer must be used by only one thread, and destroyed before the queue.
+	class ProducerBuffer
 	{
-	}
+	public:
+		explicit ProducerBuffer(EventQueueBase * queue, const size_t flushThreshold = 64)
+			:
+				queue(queue),
+				flushThreshold(flushThreshold == 0 ? 1 : flushThreshold),
+				stageCount(0),
+				mutex(),
+				stageList(),
+				spareList(),
+				previous(nullptr),
+				next(nullptr)
+		{
+			queue->doRegisterProducerBuffer(this);
+		}
 
-	EventQueueBase(const EventQueueBase & other)
-		: super(other)
-	{
-	}
+		~ProducerBuffer()
+		{
+			flush();
+			queue->doUnregisterProducerBuffer(this);
+		}
 
-	EventQueueBase(EventQueueBase && other) noexcept
-		: super(std::move(other))
-	{
-	}
+		ProducerBuffer(const ProducerBuffer &) = delete;
+		ProducerBuffer & operator = (const ProducerBuffer &) = delete;
 
-	EventQueueBase & operator = (const EventQueueBase & other)
-	{
-		super::operator = (other);
-		return *this;
-	}
-	
-	EventQueueBase & operator = (EventQueueBase && other) noexcept
-	{
-		super::operator = (std::move(other));
-		return *this;
-	}
+		template <typename ...A>
+		void enqueue(A && ...args)
+		{
+			if(! queue->doBeforeEnqueue(args...)) {
+				return;
+			}
+			// The spare nodes are only touched by the owner thread, no lock is needed.
+			if(spareList.empty()) {
+				queue->doAcquireItems(spareList, flushThreshold);
+			}
+			spareList.begin()->setFrom([&]() {
+				return queue->doMakeQueuedEvent(std::forward<A>(args)...);
+			});
+			// OPT-53: Counted, but never waits or is dropped.
+			queue->doForceAdmitEvents(1, HasQueueCapacity());
 
-	template <typename ...A>
-	auto enqueue(A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), void>::type
-	{
-		static_assert(super::ArgumentPassingMode::canIncludeEventType, "Enqueuing arguments count doesn't match required (Event type should be included).");
+			bool flushed = false;
+			{
+				std::lock_guard<Mutex> bufferLock(mutex);
+				stageList.splice(stageList.end(), spareList, spareList.begin());
+				if(++stageCount >= flushThreshold) {
+					flushed = doFlush();
+				}
+			}
 
-		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, A...>::value>::Type;
+			if(flushed) {
+				// Not in doFlush, the coroutines are not resumed under the buffer lock.
+				queue->doWakeAwaiters();
+				queue->doSignalQueueSet();
+				queue->doSignalWaitMonitor(HasWaitMonitor());
+				if(queue->doCanProcess()) {
+					queue->queueListConditionVariable.notify_one();
+				}
+			}
+		}
 
-		doEnqueue(QueuedEvent{
-			GetEvent::getEvent(args...),
-			QueuedEventArgumentsType(std::forward<A>(args)...)
-		});
+		void flush()
+		{
+			bool flushed;
+			{
+				std::lock_guard<Mutex> bufferLock(mutex);
+				flushed = doFlush();
+			}
 
-		if(doCanProcess()) {
-			queueListConditionVariable.notify_one();
+			if(flushed) {
+				queue->doWakeAwaiters();
+				queue->doSignalQueueSet();
+				queue->doSignalWaitMonitor(HasWaitMonitor());
+				if(queue->doCanProcess()) {
+					queue->queueListConditionVariable.notify_one();
+				}
+			}
 		}
-	}
 
-	template <typename T, typename ...A>
-	auto enqueue(T && first, A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), void>::type
-	{
-		static_assert(super::ArgumentPassingMode::canExcludeEventType, "Enqueuing arguments count doesn't match required (Event type should NOT be included).");
+	private:
+		// mutex must be locked.
+		bool doFlush()
+		{
+			if(stageCount == 0) {
+				return false;
+			}
 
-		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, T &&, A...>::value>::Type;
+			queue->doAfterEnqueueList(stageList);
 
-		doEnqueue(QueuedEvent{
-			GetEvent::getEvent(std::forward<T>(first), args...),
-			QueuedEventArgumentsType(std::forward<A>(args)...)
-		});
+			bool wasEmpty;
+			{
+				std::lock_guard<Mutex> queueListLock(queue->queueListMutex);
+				wasEmpty = queue->queueList.empty();
+				queue->queueList.splice(queue->queueList.end(), stageList);
+			}
+			stageCount = 0;
+			queue->doSignalNotifier(wasEmpty, HasQueueNotifier());
 
-		if(doCanProcess()) {
-			queueListConditionVariable.notify_one();
+			return true;
 		}
-	}
 
-	bool emptyQueue() const
-	{
-		return queueList.empty() && (queueEmptyCounter.load(std::memory_order_acquire) == 0);
-	}
-	
-	void clearEvents()
+	private:
+		EventQueueBase * queue;
+		const size_t flushThreshold;
+		size_t stageCount;
+		Mutex mutex;
+		BufferedItemList stageList;
+		BufferedItemList spareList;
+		ProducerBuffer * previous;
+		ProducerBuffer * next;
+
+		friend class EventQueueBase;
+	};
+
+	// OPT-65: The DispatchCache of process, processN and processFor, plus the
+	// run of events gathered for the batch listeners. The last run is given
+	// to the batch listeners when the process function returns.
+	class ProcessCache : public DispatchCache
 	{
-		if(! queueList.empty()) {
-			BufferedItemList tempList;
+	public:
+		explicit ProcessCache(EventQueueBase * queue)
+			:
+				DispatchCache(),
+				queue(queue),
+				enabled(queue->batchListenerCount.load(std::memory_order_acquire) != 0),
+				runEvent(),
+				hasBatchListener(false),
+				columns()
+		{
+		}
 
-			{
-				std::lock_guard<Mutex> queueListLock(queueListMutex);
-				std::swap(queueList, tempList);
+		~ProcessCache()
+		{
+			if(enabled) {
+				queue->doFlushBatchRun(*this);
 			}
+		}
 
-			if(! tempList.empty()) {
-				for(auto & item : tempList) {
-					item.clear();
-				}
+	private:
+		ProcessCache(const ProcessCache &) = delete;
+		ProcessCache & operator = (const ProcessCache &) = delete;
 
-				std::lock_guard<Mutex> queueListLock(freeListMutex);
-				freeList.splice(freeList.end(), tempList);
-			}
+	private:
+		EventQueueBase * queue;
+		// Checked once, a batch listener added during the call gets the
+		// events of the next call.
+		const bool enabled;
+		// Empty, or the event of the run.
+		std::vector<typename std::decay<EventType_>::type> runEvent;
+		bool hasBatchListener;
+		BatchColumnList columns;
+
+		friend class EventQueueBase;
+	};
+
+	// OPT-84: The batch dispatcher is made by the first appendBatchListener,
+	// the process functions and the destructor only reach it through
+	// BatchHolder. So its callback lists of spans are only instantiated by
+	// the queues which have batch listeners, not by each EventQueue type.
+	class BatchHolder
+	{
+	public:
+		virtual ~BatchHolder()
+		{
 		}
-	}
 
-	bool process()
+		virtual BatchHolder * clone() const = 0;
+		virtual bool hasAnyListener(const EventType_ & event) const = 0;
+		virtual void dispatch(const EventType_ & event, BatchSpan<typename std::decay<Args>::type> ...spans) = 0;
+	};
+
+	class BatchDispatcherHolder : public BatchHolder
 	{
-		if(! queueList.empty()) {
-			BufferedItemList tempList;
+	public:
+		BatchDispatcherHolder()
+			: dispatcher()
+		{
+		}
 
-			// Use a counter to tell the queue list is not empty during processing
-			// even though queueList is swapped to empty.
-			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+		explicit BatchDispatcherHolder(const BatchDispatcher & dispatcher)
+			: dispatcher(dispatcher)
+		{
+		}
 
-			{
-				std::lock_guard<Mutex> queueListLock(queueListMutex);
-				std::swap(queueList, tempList);
-			}
+		BatchHolder * clone() const override
+		{
+			return new BatchDispatcherHolder(dispatcher);
+		}
 
-			if(! tempList.empty()) {
-				for(auto & item : tempList) {
-					doDispatchQueuedEvent(
-						item.get(),
-						typename MakeIndexSequence<sizeof...(Args)>::Type()
-					);
-					item.clear();
-				}
+		bool hasAnyListener(const EventType_ & event) const override
+		{
+			return dispatcher.hasAnyListener(event);
+		}
 
-				std::lock_guard<Mutex> queueListLock(freeListMutex);
-				freeList.splice(freeList.end(), tempList);
-				
-				return true;
-			}
+		void dispatch(const EventType_ & event, BatchSpan<typename std::decay<Args>::type> ...spans) override
+		{
+			dispatcher.directDispatch(event, spans...);
 		}
-		
-		return false;
-	}
 
-	// OPT-15: Zero-overhead visitor dispatch.
-	// Bypasses the entire EventDispatcher infrastructure:
-	// no shared_lock, no map lookup, no CallbackList traversal,
-	// no std::function indirection.
-	// Visitor protocol: visitor(event, args...)
-	template <typename Visitor>
-	bool processQueueWith(Visitor && visitor)
+		BatchDispatcher dispatcher;
+	};
+
+	// OPT-35: A queued event made by reserve, in a node which is not in the
+	// queue yet. The arguments are written in place through getArguments or
+	// getArgument, then commit puts the event in the queue. If commit is not
+	// called, the node is given back when the slot is destroyed.
+	// A slot must be committed or destroyed before the queue.
+	class EnqueueSlot
 	{
-		if(! queueList.empty()) {
-			BufferedItemList tempList;
+	public:
+		EnqueueSlot() : queue(nullptr), itemList()
+		{
+		}
 
-			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+		EnqueueSlot(EnqueueSlot && other) noexcept
+			: queue(other.queue), itemList()
+		{
+			itemList.splice(itemList.end(), other.itemList);
+			other.queue = nullptr;
+		}
 
-			{
-				std::lock_guard<Mutex> queueListLock(queueListMutex);
-				std::swap(queueList, tempList);
+		EnqueueSlot & operator = (EnqueueSlot && other) noexcept
+		{
+			if(this != &other) {
+				cancel();
+				queue = other.queue;
+				itemList.splice(itemList.end(), other.itemList);
+				other.queue = nullptr;
 			}
+			return *this;
+		}
 
-			if(! tempList.empty()) {
-				for(auto & item : tempList) {
-					doVisitQueuedEvent(
-						visitor,
-						item.get(),
-						typename MakeIndexSequence<sizeof...(Args)>::Type()
-					);
-					item.clear();
-				}
+		~EnqueueSlot()
+		{
+			cancel();
+		}
 
-				std::lock_guard<Mutex> queueListLock(freeListMutex);
-				freeList.splice(freeList.end(), tempList);
+		EnqueueSlot(const EnqueueSlot &) = delete;
+		EnqueueSlot & operator = (const EnqueueSlot &) = delete;
 
-				return true;
-			}
+		bool isActive() const {
+			return queue != nullptr;
 		}
 
-		return false;
-	}
+		QueuedEventArgumentsType & getArguments() {
+			assert(isActive());
+			return itemList.begin()->get().arguments;
+		}
+
+		template <size_t N>
+		typename std::tuple_element<N, QueuedEventArgumentsType>::type & getArgument() {
+			return std::get<N>(getArguments());
+		}
+
+		void commit()
+		{
+			assert(isActive());
+			EventQueueBase * q = queue;
+			queue = nullptr;
+
+			// OPT-53: The overflow policy applies here, not in reserve.
+			if(! q->doAdmitItem(itemList, HasQueueCapacity())) {
+				return;
+			}
+			q->doAfterEnqueue(itemList.begin()->get());
+			q->doPublishItem(itemList, itemList.begin());
+			if(q->doCanProcess()) {
+				q->queueListConditionVariable.notify_one();
+			}
+		}
+
+		// Gives back the node without queuing the event.
+		void cancel()
+		{
+			if(queue == nullptr) {
+				return;
+			}
+			itemList.begin()->clear();
+			queue->doRecycleNodes(itemList);
+			queue = nullptr;
+		}
+
+	private:
+		EnqueueSlot(EventQueueBase * queue, BufferedItemList && list)
+			: queue(queue), itemList()
+		{
+			itemList.splice(itemList.end(), list);
+		}
+
+	private:
+		EventQueueBase * queue;
+		BufferedItemList itemList;
+
+		friend class EventQueueBase;
+	};
+
+	// OPT-36: A batch of events taken out of the queue by borrowEvents. The
+	// events stay in the queue nodes and are read in place, the nodes go back
+	// to the free list when the batch is released or destroyed.
+	class BorrowedEvents
+	{
+	public:
+		class const_iterator
+		{
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = QueuedEvent;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const QueuedEvent *;
+			using reference = const QueuedEvent &;
+
+			const_iterator() : it()
+			{
+			}
+
+			reference operator * () const {
+				return it->get();
+			}
+
+			pointer operator -> () const {
+				return &it->get();
+			}
+
+			const_iterator & operator ++ () {
+				++it;
+				return *this;
+			}
+
+			const_iterator operator ++ (int) {
+				const_iterator result(*this);
+				++it;
+				return result;
+			}
+
+			bool operator == (const const_iterator & other) const {
+				return it == other.it;
+			}
+
+			bool operator != (const const_iterator & other) const {
+				return it != other.it;
+			}
+
+		private:
+			explicit const_iterator(const typename BufferedItemList::const_iterator & it) : it(it)
+			{
+			}
+
+		private:
+			typename BufferedItemList::const_iterator it;
+
+			friend class BorrowedEvents;
+		};
+
+	public:
+		BorrowedEvents() : queue(nullptr), itemList(), count(0)
+		{
+		}
+
+		BorrowedEvents(BorrowedEvents && other) noexcept
+			: queue(other.queue), itemList(), count(other.count)
+		{
+			itemList.splice(itemList.end(), other.itemList);
+			other.queue = nullptr;
+			other.count = 0;
+		}
+
+		BorrowedEvents & operator = (BorrowedEvents && other) noexcept
+		{
+			if(this != &other) {
+				release();
+				queue = other.queue;
+				count = other.count;
+				itemList.splice(itemList.end(), other.itemList);
+				other.queue = nullptr;
+				other.count = 0;
+			}
+			return *this;
+		}
+
+		~BorrowedEvents()
+		{
+			release();
+		}
+
+		BorrowedEvents(const BorrowedEvents &) = delete;
+		BorrowedEvents & operator = (const BorrowedEvents &) = delete;
+
+		bool empty() const {
+			return count == 0;
+		}
+
+		size_t size() const {
+			return count;
+		}
+
+		const_iterator begin() const {
+			return const_iterator(itemList.begin());
+		}
+
+		const_iterator end() const {
+			return const_iterator(itemList.end());
+		}
+
+		const QueuedEvent & front() const {
+			assert(! empty());
+			return itemList.begin()->get();
+		}
+
+		// Destroys the events and gives back the nodes.
+		void release()
+		{
+			if(queue == nullptr) {
+				return;
+			}
+			for(auto & item : itemList) {
+				item.clear();
+			}
+			queue->doRecycleItems(itemList);
+			queue = nullptr;
+			count = 0;
+		}
+
+	private:
+		BorrowedEvents(EventQueueBase * queue, BufferedItemList && list, const size_t count)
+			: queue(queue), itemList(), count(count)
+		{
+			itemList.splice(itemList.end(), list);
+		}
+
+	private:
+		EventQueueBase * queue;
+		BufferedItemList itemList;
+		size_t count;
+
+		friend class EventQueueBase;
+	};
+
+#if EVENTPP_HAS_COROUTINE
+	// OPT-50: The awaiter of next and batch. The awaiter is in the coroutine
+	// frame and is linked in the queue while the coroutine is suspended, so
+	// waiting allocates nothing and blocks no thread. The thread which
+	// publishes an event moves it to the awaiter under the queue list lock,
+	// then resumes the coroutine, so the event can't be taken by another
+	// consumer in between.
+	class AwaiterBase
+	{
+	public:
+		AwaiterBase(const AwaiterBase &) = delete;
+		AwaiterBase & operator = (const AwaiterBase &) = delete;
+
+		// The coroutine must not be destroyed while it's woken.
+		~AwaiterBase()
+		{
+			if(linked) {
+				queue->doUnlinkAwaiter(this);
+			}
+		}
+
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		// Returns false, so the coroutine goes on, if there are events.
+		bool await_suspend(std::coroutine_handle<> handle) {
+			resumer.handle = handle;
+			return queue->doSuspendAwaiter(this);
+		}
+
+	protected:
+		AwaiterBase(EventQueueBase * queue, const size_t maxCount, void * executor, CoroutineResumer::Post post)
+			: queue(queue), maxCount(maxCount), resumer(), itemList(), linked(false), nextAwaiter(nullptr)
+		{
+			resumer.executor = executor;
+			resumer.post = post;
+		}
+
+	protected:
+		EventQueueBase * queue;
+		size_t maxCount;
+		CoroutineResumer resumer;
+		// Filled under the queue list lock, empty if the awaiter is cancelled.
+		BufferedItemList itemList;
+		bool linked;
+		AwaiterBase * nextAwaiter;
+
+		friend class EventQueueBase;
+	};
+
+	class NextAwaiter : public AwaiterBase
+	{
+	public:
+		// Empty if the awaiter is cancelled by cancelAwaiters.
+		std::optional<QueuedEvent> await_resume() {
+			std::optional<QueuedEvent> result;
+			if(! this->itemList.empty()) {
+				this->queue->doAfterDequeue(this->itemList.front().get());
+				result.emplace(std::move(this->itemList.front().get()));
+				this->itemList.front().clear();
+				this->queue->doRecycleItems(this->itemList);
+			}
+			return result;
+		}
+
+	private:
+		using AwaiterBase::AwaiterBase;
+
+		friend class EventQueueBase;
+	};
+
+	class BatchAwaiter : public AwaiterBase
+	{
+	public:
+		// Empty if the awaiter is cancelled by cancelAwaiters.
+		BorrowedEvents await_resume() {
+			const size_t count = this->itemList.size();
+			if(count == 0) {
+				return BorrowedEvents();
+			}
+			for(auto & item : this->itemList) {
+				this->queue->doAfterDequeue(item.get());
+			}
+			return BorrowedEvents(this->queue, std::move(this->itemList), count);
+		}
+
+	private:
+		using AwaiterBase::AwaiterBase;
+
+		friend class EventQueueBase;
+	};
+#endif
+
+public:
+	EventQueueBase()
+		:
+			super(),
+			queueListConditionVariable(),
+			queueEmptyCounter(0),
+			queueNotifyCounter(0),
+			queueListMutex(),
+			queueList(),
+			freeListMutex(),
+			freeList()
+	{
+	}
+
+	EventQueueBase(const EventQueueBase & other)
+		: super(other), batchHolder(other.doCloneBatchHolder()), batchListenerCount(other.batchListenerCount.load())
+	{
+	}
+
+	EventQueueBase(EventQueueBase && other) noexcept
+		: super(std::move(other)), batchHolder(other.batchHolder.exchange(nullptr)), batchListenerCount(other.batchListenerCount.exchange(0))
+	{
+	}
+
+	~EventQueueBase()
+	{
+		delete batchHolder.load(std::memory_order_relaxed);
+	}
+
+	EventQueueBase & operator = (const EventQueueBase & other)
+	{
+		if(this != &other) {
+			super::operator = (other);
+			delete batchHolder.exchange(other.doCloneBatchHolder());
+			batchListenerCount.store(other.batchListenerCount.load());
+		}
+		return *this;
+	}
+	
+	EventQueueBase & operator = (EventQueueBase && other) noexcept
+	{
+		if(this != &other) {
+			super::operator = (std::move(other));
+			delete batchHolder.exchange(other.batchHolder.exchange(nullptr));
+			batchListenerCount.store(other.batchListenerCount.exchange(0));
+		}
+		return *this;
+	}
+
+	// OPT-35: The queued event is constructed in the queue node, the
+	// arguments are copied or moved once, from args.
+	template <typename ...A>
+	auto enqueue(A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), void>::type
+	{
+		if(! doBeforeEnqueue(args...)) {
+			return;
+		}
+		doEnqueueFrom([&]() {
+			return doMakeQueuedEvent(std::forward<A>(args)...);
+		});
+
+		if(doCanProcess()) {
+			queueListConditionVariable.notify_one();
+		}
+	}
+
+	template <typename T, typename ...A>
+	auto enqueue(T && first, A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), void>::type
+	{
+		if(! doBeforeEnqueue(first, args...)) {
+			return;
+		}
+		doEnqueueFrom([&]() {
+			return doMakeQueuedEvent(std::forward<T>(first), std::forward<A>(args)...);
+		});
+
+		if(doCanProcess()) {
+			queueListConditionVariable.notify_one();
+		}
+	}
+
+	// OPT-53: Enqueues the event if the queue has room for it, returns false
+	// immediately if it's full, whatever QueueOverflow is. The arguments are
+	// not touched when it returns false.
+	// An event dropped by mixinBeforeEnqueue returns true, as enqueue drops
+	// it, it doesn't count against the capacity.
+	// Requires the QueueCapacity policy to be QueueCapacityLimited.
+	template <typename ...A>
+	bool tryEnqueue(A && ...args)
+	{
+		static_assert(HasQueueCapacity::value, "tryEnqueue requires the QueueCapacity policy to be QueueCapacityLimited.");
+
+		if(! doBeforeEnqueue(args...)) {
+			return true;
+		}
+		if(! doTryAdmitEvent()) {
+			return false;
+		}
+		doEnqueueAdmitted(std::forward<A>(args)...);
+		return true;
+	}
+
+	// OPT-53: Waits at most duration for the queue to have room, returns
+	// false if it's still full. The arguments are not touched when it
+	// returns false. An event dropped by mixinBeforeEnqueue returns true
+	// without waiting.
+	// Requires the QueueCapacity policy to be QueueCapacityLimited.
+	template <class Rep, class Period, typename ...A>
+	bool tryEnqueueFor(const std::chrono::duration<Rep, Period> & duration, A && ...args)
+	{
+		static_assert(HasQueueCapacity::value, "tryEnqueueFor requires the QueueCapacity policy to be QueueCapacityLimited.");
+
+		if(! doBeforeEnqueue(args...)) {
+			return true;
+		}
+		const TimerTimePoint deadline = TimerClock::now() + std::chrono::duration_cast<TimerDuration>(duration);
+		if(! doAdmitEventUntil(&deadline)) {
+			return false;
+		}
+		doEnqueueAdmitted(std::forward<A>(args)...);
+		return true;
+	}
+
+	// OPT-49: Enqueues the event as enqueue does, and returns its reply. When
+	// the event is dispatched, the reply gets the value returned by the last
+	// listener called. The replies completed by one process call wake their
+	// waiters at the end of the call, with one notification.
+	// Requires the QueueReply policy to be QueueReplyPooled.
+	template <typename ...A>
+	Reply enqueueWithReply(A && ...args)
+	{
+		static_assert(HasQueueReply::value, "enqueueWithReply requires the QueueReply policy to be QueueReplyPooled.");
+
+		ReplySlot<ReplyResult> * slot = ReplySlot<ReplyResult>::create(&replyNotifier);
+		Reply reply(slot);
+
+		// OPT-56: The reply of an event dropped by mixinBeforeEnqueue is ready
+		// with no value, same as an event dropped by QueueOverflow.
+		if(! doBeforeEnqueue(args...)) {
+			slot->addReference();
+			slot->complete(false);
+			return reply;
+		}
+
+		BufferedItemList tempList;
+		doAcquireItem(tempList);
+		auto it = tempList.begin();
+		it->setFrom([&]() {
+			return doMakeQueuedEvent(std::forward<A>(args)...);
+		});
+		it->get().stamp.setReply(slot);
+		// OPT-53: A dropped event completes its reply with no value.
+		if(! doAdmitItem(tempList, HasQueueCapacity())) {
+			return reply;
+		}
+		doAfterEnqueue(it->get());
+		doPublishItem(tempList, it);
+
+		if(doCanProcess()) {
+			queueListConditionVariable.notify_one();
+		}
+		return reply;
+	}
+
+	// OPT-55: Enqueues the event as enqueue does. If the event is still in
+	// the queue at deadline, it's dropped instead of dispatched. The deadline
+	// replaces the time to live of the policies.
+	// Requires the QueueDeadline policy to be QueueDeadlineSteady.
+	template <typename ...A>
+	void enqueueWithDeadline(const TimerTimePoint & deadline, A && ...args)
+	{
+		static_assert(HasQueueDeadline::value, "enqueueWithDeadline requires the QueueDeadline policy to be QueueDeadlineSteady.");
+
+		if(! doBeforeEnqueue(args...)) {
+			return;
+		}
+		BufferedItemList tempList;
+		doAcquireItem(tempList);
+		auto it = tempList.begin();
+		it->setFrom([&]() {
+			return doMakeQueuedEvent(std::forward<A>(args)...);
+		});
+		it->get().stamp.deadline = deadline;
+		if(! doAdmitItem(tempList, HasQueueCapacity())) {
+			return;
+		}
+		doAfterEnqueue(it->get());
+		doPublishItem(tempList, it);
+
+		if(doCanProcess()) {
+			queueListConditionVariable.notify_one();
+		}
+	}
+
+	// OPT-55: The events dropped by the process functions because they were
+	// past their deadline.
+	std::uint64_t getExpiredEventCount() const
+	{
+		static_assert(HasQueueDeadline::value, "getExpiredEventCount requires the QueueDeadline policy to be QueueDeadlineSteady.");
+
+		return deadlineState.expiredEventCount.load(std::memory_order_relaxed);
+	}
+
+	// OPT-35: For the prototypes with one argument, the event is not an
+	// argument. The argument is constructed from ctorArgs in the queue node,
+	// it's never copied or moved. The getEvent of the policies is not used.
+	template <typename ...C>
+	void emplace(const Event & event, C && ...ctorArgs)
+	{
+		static_assert(super::ArgumentPassingMode::canExcludeEventType && sizeof...(Args) == 1,
+			"emplace requires a prototype with one argument, and the event is not an argument.");
+
+		if(! doBeforeEnqueueEvent(event)) {
+			return;
+		}
+		doEnqueueFrom([&]() {
+			return QueuedEvent{
+				event,
+				doMakeEmplacedArguments(std::integral_constant<size_t, sizeof...(C)>(), std::forward<C>(ctorArgs)...)
+			};
+		});
+
+		if(doCanProcess()) {
+			queueListConditionVariable.notify_one();
+		}
+	}
+
+	// OPT-35: Takes a node for the event, the arguments are value
+	// initialized. The caller writes the arguments in the node through the
+	// slot, then calls slot.commit() to put the event in the queue.
+	// If mixinBeforeEnqueue drops the event, no node is taken, and the slot
+	// is not active.
+	EnqueueSlot reserve(const Event & event)
+	{
+		static_assert(std::is_default_constructible<QueuedEventArgumentsType>::value,
+			"reserve requires default constructible arguments.");
+
+		if(! doBeforeEnqueueEvent(event)) {
+			return EnqueueSlot();
+		}
+		BufferedItemList tempList;
+		doAcquireItem(tempList);
+		tempList.begin()->setFrom([&event]() {
+			return QueuedEvent{ event, QueuedEventArgumentsType() };
+		});
+		return EnqueueSlot(this, std::move(tempList));
+	}
+
+	// Enqueue a batch of events with one lock on the free list, one lock on
+	// the queue list and one notification.
+	// Each element is the arguments of enqueue, a std::tuple element is
+	// expanded to the arguments, any other element is the only argument.
+	// Iterator must be a forward iterator.
+	// OPT-56: If a mixin has mixinBeforeEnqueue, each element is checked
+	// first, and the nodes are only taken for the events which pass.
+	template <typename Iterator>
+	void enqueueBulk(Iterator first, const Iterator last)
+	{
+		doEnqueueBulkFrom(first, last, std::integral_constant<bool,
+			internal_::AnyMixinBeforeEnqueue<typename super::MixinRoot, typename super::Mixins, const EventType_ &>::value>());
+	}
+
+	// generator is invoked as generator(index) for index in [0, count),
+	// and returns the element as in enqueueBulk(first, last).
+	// If a mixin has mixinBeforeEnqueue, the elements which pass are kept
+	// in a vector first, generator is still invoked once for each index.
+	template <typename Generator>
+	void enqueueBulk(const size_t count, Generator && generator)
+	{
+		doEnqueueBulkFrom(count, generator, std::integral_constant<bool,
+			internal_::AnyMixinBeforeEnqueue<typename super::MixinRoot, typename super::Mixins, const EventType_ &>::value>());
+	}
+
+	// OPT-29: The event is put in the queue when timePoint is reached, at the
+	// first process call after that. It's never processed before timePoint.
+	// mixinBeforeEnqueue is called here, not when the event is due.
+	// Requires the Timer policy to be TimerWheel.
+	template <typename ...A>
+	void enqueueAt(const TimerTimePoint & timePoint, A && ...args)
+	{
+		static_assert(HasTimer::value, "enqueueAt requires policy Timer to be TimerWheel.");
+
+		if(! doBeforeEnqueue(args...)) {
+			return;
+		}
+		QueuedEvent item(doMakeQueuedEvent(std::forward<A>(args)...));
+		const TimerTick tick = doGetTimerTick(timePoint);
+
+		bool earlier;
+		{
+			std::lock_guard<Mutex> timerLock(delayedEvents.mutex);
+			delayedEvents.wheel.insert(tick, std::move(item));
+			// Same as wheel.getNextTick(), without scanning the wheel.
+			const TimerTick currentTick = delayedEvents.wheel.getCurrentTick();
+			const TimerTick itemTick = (tick < currentTick ? currentTick : tick);
+			earlier = (itemTick < delayedEvents.nextTick.load(std::memory_order_relaxed));
+			if(earlier) {
+				delayedEvents.nextTick.store(itemTick, std::memory_order_release);
+			}
+		}
+
+		// A consumer in waitFor is sleeping until the previous deadline.
+		if(earlier && doCanNotifyQueueAvailable()) {
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				queueListConditionVariable.notify_one();
+			}
+			doSignalQueueSet();
+			doSignalWaitMonitor(HasWaitMonitor());
+		}
+	}
+
+	template <class Rep, class Period, typename ...A>
+	void enqueueAfter(const std::chrono::duration<Rep, Period> & delay, A && ...args)
+	{
+		enqueueAt(TimerClock::now() + std::chrono::duration_cast<TimerDuration>(delay), std::forward<A>(args)...);
+	}
+
+	// The delayed events which are not moved to the queue yet.
+	std::size_t getDelayedEventCount() const
+	{
+		static_assert(HasTimer::value, "getDelayedEventCount requires policy Timer to be TimerWheel.");
+
+		std::lock_guard<Mutex> timerLock(delayedEvents.mutex);
+		return delayedEvents.wheel.size();
+	}
+
+	void clearDelayedEvents()
+	{
+		static_assert(HasTimer::value, "clearDelayedEvents requires policy Timer to be TimerWheel.");
+
+		std::lock_guard<Mutex> timerLock(delayedEvents.mutex);
+		delayedEvents.wheel.clear([](QueuedEvent &&) {});
+		delayedEvents.nextTick.store(DelayedEventWheel::noTick, std::memory_order_release);
+	}
+
+	// OPT-30: The file descriptor becomes readable when the queue turns from
+	// empty to non-empty. It's cleared by the process functions, so after it's
+	// readable, process the queue until it's empty. Don't read or close it.
+	// Requires the QueueNotifier policy to be QueueNotifierFd.
+	// Returns -1 if the descriptor can't be created.
+	int getNotifierFd() const
+	{
+		static_assert(HasQueueNotifier::value, "getNotifierFd requires policy QueueNotifier to be QueueNotifierFd.");
+
+		return queueNotifier.getFd();
+	}
+
+	bool emptyQueue() const
+	{
+		return queueList.empty() && (queueEmptyCounter.load(std::memory_order_acquire) == 0);
+	}
+	
+	void clearEvents()
+	{
+		doCollectEvents();
+
+		if(! queueList.empty()) {
+			BufferedItemList tempList;
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				std::swap(queueList, tempList);
+			}
+
+			if(! tempList.empty()) {
+				for(auto & item : tempList) {
+					doAfterDequeue(item.get());
+					item.clear();
+				}
+
+				doRecycleItems(tempList);
+			}
+		}
+	}
+
+	// OPT-77: Move the queued events to the end of other, in their order,
+	// by splicing the nodes, the events are neither copied nor reallocated.
+	// The events leave this queue and enter other as if they were dequeued
+	// and enqueued, the mixin hooks, the tracer and the capacity see them
+	// so, and their deadlines are kept. The consumers of other are notified.
+	// Returns true if any event is moved. It's O(1) unless the policies have
+	// QueueCapacity, mixins with the enqueue or dequeue hooks, or a tracer.
+	bool moveEventsTo(EventQueueBase & other)
+	{
+		return doMoveEvents(other, [](BufferedItemList & tempList, BufferedItemList & movedList) {
+			movedList.splice(movedList.end(), tempList);
+		});
+	}
+
+	// Same as moveEventsTo, only the events for which predictor(args...)
+	// returns true are moved, the others stay in this queue in their order.
+	template <typename Predictor>
+	bool moveEventsIf(EventQueueBase & other, Predictor && predictor)
+	{
+		return doMoveEvents(other, [this, &predictor](BufferedItemList & tempList, BufferedItemList & movedList) {
+			for(auto it = tempList.begin(); it != tempList.end(); ) {
+				auto tempIt = it;
+				++it;
+				if(doInvokeFuncWithQueuedEvent(
+						predictor,
+						tempIt->get(),
+						typename MakeIndexSequence<sizeof...(Args)>::Type())
+					) {
+					movedList.splice(movedList.end(), tempList, tempIt);
+				}
+			}
+		});
+	}
+
+	// OPT-68: Put empty nodes into the free list until it has count nodes,
+	// so the first count events enqueued don't allocate any node. With
+	// QueueCapacityLimited, the free list keeps at most maxFreeCount nodes.
+	// Not named reserve, which takes the node of one event.
+	void reserveNodes(const size_t count)
+	{
+		size_t freeCount;
+		{
+			std::lock_guard<Mutex> freeListLock(freeListMutex);
+			freeCount = static_cast<size_t>(std::distance(freeList.begin(), freeList.end()));
+		}
+
+		BufferedItemList tempList;
+		for(; freeCount < count; ++freeCount) {
+			tempList.emplace_back();
+		}
+		doRecycleNodes(tempList);
+	}
+
+	// OPT-65: Adds a listener which gets the run of the consecutive queued
+	// events of event in one call, callback(BatchSpan<A>...). There's one
+	// span for each argument of the prototype, A is the decayed argument
+	// type, and the spans have the same size. The arguments are copied to
+	// the spans, so they must be copyable, and can't be bool.
+	// The runs are gathered by process, processN and processFor. The usual
+	// listeners are called for each event first, the batch listeners are
+	// called when the run ends, before the next event is dispatched, or when
+	// the process function returns. The other process functions don't call
+	// the batch listeners. The events dropped by their deadline are not in
+	// the run. The events which can't be compared by operator == are runs
+	// of one event.
+	BatchHandle appendBatchListener(const Event & event, const BatchCallback & callback)
+	{
+		static_assert(CanBatch::value, "EventQueue: batch listeners need copyable arguments which are not bool.");
+
+		BatchHandle handle = doGetBatchDispatcher().appendListener(event, callback);
+		batchListenerCount.fetch_add(1, std::memory_order_release);
+		return handle;
+	}
+
+	bool removeBatchListener(const Event & event, const BatchHandle & handle)
+	{
+		BatchHolder * holder = batchHolder.load(std::memory_order_acquire);
+		if(holder != nullptr && static_cast<BatchDispatcherHolder *>(holder)->dispatcher.removeListener(event, handle)) {
+			batchListenerCount.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+		return false;
+	}
+
+	bool hasAnyBatchListener(const Event & event) const
+	{
+		const BatchHolder * holder = batchHolder.load(std::memory_order_acquire);
+		return holder != nullptr && holder->hasAnyListener(event);
+	}
+
+	bool process()
+	{
+		// OPT-49: The waiters of the replies completed by this call are woken
+		// when it returns.
+		ReplyFlushGuard<decltype(replyNotifier)> replyFlushGuard(replyNotifier);
+		doCollectEvents();
+
+		if(! queueList.empty()) {
+			BufferedItemList tempList;
+
+			// Use a counter to tell the queue list is not empty during processing
+			// even though queueList is swapped to empty.
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				std::swap(queueList, tempList);
+			}
+
+			if(! tempList.empty()) {
+				// OPT-25: Consecutive events of the same type share one lookup.
+				ProcessCache cache(this);
+				// OPT-67: The nodes ahead are prefetched.
+				Prefetcher::forEach(tempList, GetItemArguments(), [this, &cache](BufferedItem<QueuedEvent_> & item) {
+					doDispatchQueuedEventBatched(
+						cache,
+						item.get(),
+						typename MakeIndexSequence<sizeof...(Args)>::Type()
+					);
+					item.clear();
+				});
+
+				doRecycleItems(tempList);
+				
+				return true;
+			}
+		}
+		
+		return false;
+	}
+
+	// OPT-15: Zero-overhead visitor dispatch.
+	// Bypasses the entire EventDispatcher infrastructure:
+	// no shared_lock, no map lookup, no CallbackList traversal,
+	// no std::function indirection.
+	// Visitor protocol: visitor(event, args...)
+	template <typename Visitor>
+	bool processQueueWith(Visitor && visitor)
+	{
+		doCollectEvents();
+
+		if(! queueList.empty()) {
+			BufferedItemList tempList;
+
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				std::swap(queueList, tempList);
+			}
+
+			if(! tempList.empty()) {
+				VisitPrefetcher::forEach(tempList, GetItemArguments(), [this, &visitor](BufferedItem<QueuedEvent_> & item) {
+					doVisitQueuedEvent(
+						visitor,
+						item.get(),
+						typename MakeIndexSequence<sizeof...(Args)>::Type()
+					);
+					item.clear();
+				});
+
+				doRecycleItems(tempList);
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// OPT-15: Single-event variant of processQueueWith.
+	template <typename Visitor>
+	bool processOneWith(Visitor && visitor)
+	{
+		doCollectEvents();
+
+		if(! queueList.empty()) {
+			BufferedItemList tempList;
+
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				if(! queueList.empty()) {
+					tempList.splice(tempList.end(), queueList, queueList.begin());
+				}
+			}
+
+			if(! tempList.empty()) {
+				auto & item = tempList.front();
+				doVisitQueuedEvent(
+					visitor,
+					item.get(),
+					typename MakeIndexSequence<sizeof...(Args)>::Type()
+				);
+				item.clear();
+
+				doRecycleItems(tempList);
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool processOne()
+	{
+		ReplyFlushGuard<decltype(replyNotifier)> replyFlushGuard(replyNotifier);
+		doCollectEvents();
+
+		if(! queueList.empty()) {
+			BufferedItemList tempList;
+
+			// Use a counter to tell the queue list is not empty during processing
+			// even though queueList is swapped to empty.
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				if(! queueList.empty()) {
+					tempList.splice(tempList.end(), queueList, queueList.begin());
+				}
+			}
+
+			if(! tempList.empty()) {
+				auto & item = tempList.front();
+				doDispatchQueuedEvent(
+					item.get(),
+					typename MakeIndexSequence<sizeof...(Args)>::Type()
+				);
+				item.clear();
+
+				doRecycleItems(tempList);
+				
+				return true;
+			}
+		}
+		
+		return false;
+	}
+
+	// Process at most maxCount events from the head of the queue.
+	// Only the events to process are taken from the queue, under one lock.
+	bool processN(const size_t maxCount)
+	{
+		ProcessCache cache(this);
+		return doProcessN(maxCount, [this, &cache](QueuedEvent & queuedEvent) {
+			doDispatchQueuedEventBatched(
+				cache,
+				queuedEvent,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	// Same as processN, and *processedCount is the count of the events
+	// processed, such as for the metrics of a worker.
+	bool processN(const size_t maxCount, size_t * processedCount)
+	{
+		ProcessCache cache(this);
+		size_t count = 0;
+		const bool result = doProcessN(maxCount, [this, &cache, &count](QueuedEvent & queuedEvent) {
+			++count;
+			doDispatchQueuedEventBatched(
+				cache,
+				queuedEvent,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+		*processedCount = count;
+		return result;
+	}
+
+	// Process events until the queue is empty or the duration elapses.
+	// The time is checked after each event, so at least one event is processed
+	// if the queue is not empty. The unprocessed events are put back to the
+	// head of the queue in their original order.
+	template <class Rep, class Period>
+	bool processFor(const std::chrono::duration<Rep, Period> & duration)
+	{
+		ProcessCache cache(this);
+		return doProcessFor(duration, [this, &cache](QueuedEvent & queuedEvent) {
+			doDispatchQueuedEventBatched(
+				cache,
+				queuedEvent,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	// OPT-15: Visitor variants of processN and processFor.
+	template <typename Visitor>
+	bool processNWith(const size_t maxCount, Visitor && visitor)
+	{
+		return doProcessN(maxCount, [this, &visitor](QueuedEvent & queuedEvent) {
+			doVisitQueuedEvent(
+				visitor,
+				queuedEvent,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	template <class Rep, class Period, typename Visitor>
+	bool processForWith(const std::chrono::duration<Rep, Period> & duration, Visitor && visitor)
+	{
+		return doProcessFor(duration, [this, &visitor](QueuedEvent & queuedEvent) {
+			doVisitQueuedEvent(
+				visitor,
+				queuedEvent,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	template <typename Predictor>
+	bool processIf(Predictor && predictor)
+	{
+		ReplyFlushGuard<decltype(replyNotifier)> replyFlushGuard(replyNotifier);
+		doCollectEvents();
+
+		if(! queueList.empty()) {
+			BufferedItemList tempList;
+			BufferedItemList idleList;
+
+			// Use a counter to tell the queue list is not empty during processing
+			// even though queueList is swapped to empty.
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				std::swap(queueList, tempList);
+			}
+
+			if(! tempList.empty()) {
+				for(auto it = tempList.begin(); it != tempList.end(); ) {
+					if(doInvokeFuncWithQueuedEvent(
+							predictor,
+							it->get(),
+							typename MakeIndexSequence<sizeof...(Args)>::Type())
+						) {
+						doDispatchQueuedEvent(
+							it->get(),
+							typename MakeIndexSequence<sizeof...(Args)>::Type()
+						);
+						it->clear();
+						
+						auto tempIt = it;
+						++it;
+						idleList.splice(idleList.end(), tempList, tempIt);
+					}
+					else {
+						++it;
+					}
+				}
+
+				if (! tempList.empty()) {
+					std::lock_guard<Mutex> queueListLock(queueListMutex);
+					queueList.splice(queueList.begin(), tempList);
+				}
+
+				if(! idleList.empty()) {
+					doRecycleItems(idleList);
+					
+					return true;
+				}
+			}
+		}
+		
+		return false;
+	}
+	
+	template <typename Predictor>
+	bool processUntil(Predictor && predictor)
+	{
+		ReplyFlushGuard<decltype(replyNotifier)> replyFlushGuard(replyNotifier);
+		doCollectEvents();
+
+		if(! queueList.empty()) {
+			BufferedItemList tempList;
+			BufferedItemList idleList;
+
+			// Use a counter to tell the queue list is not empty during processing
+			// even though queueList is swapped to empty.
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				std::swap(queueList, tempList);
+			}
+
+			if(! tempList.empty()) {
+				for(auto it = tempList.begin(); it != tempList.end(); ) {
+					if(doInvokeFuncWithQueuedEvent(
+							predictor,
+							it->get(),
+							typename MakeIndexSequence<sizeof...(Args)>::Type())
+						) {
+						break;
+					}
+					else {
+						doDispatchQueuedEvent(
+							it->get(),
+							typename MakeIndexSequence<sizeof...(Args)>::Type()
+						);
+						it->clear();
+						
+						auto tempIt = it;
+						++it;
+						idleList.splice(idleList.end(), tempList, tempIt);
+					}
+				}
+
+				if (! tempList.empty()) {
+					std::lock_guard<Mutex> queueListLock(queueListMutex);
+					queueList.splice(queueList.begin(), tempList);
+				}
+
+				if(! idleList.empty()) {
+					doRecycleItems(idleList);
+					
+					return true;
+				}
+			}
+		}
+		
+		return false;
+	}
+	
+	void wait() const
+	{
+		// OPT-81: With a virtual clock, the clock jumps to the next delayed
+		// event instead of waiting for it.
+		if(doCanProcess() || doAdvanceClockToDueTime(IsVirtualClock()) || doSpinWait()) {
+			return;
+		}
+
+		waitCore.parkCount.fetch_add(1, std::memory_order_relaxed);
+		doIdleWait(IsWaitPark());
+	}
+
+	template <class Rep, class Period>
+	bool waitFor(const std::chrono::duration<Rep, Period> & duration) const
+	{
+		// OPT-8: Three-phase adaptive backoff: Spin -> Yield -> Sleep
+		// Phase 1: Fast check — avoid any synchronization overhead.
+		if(doCanProcess()) {
+			return true;
+		}
+
+		// OPT-81: A virtual clock is advanced instead of waiting.
+		if(IsVirtualClock::value) {
+			return doAdvanceClockFor(duration, IsVirtualClock());
+		}
+
+		// Phase 2 and 3: Spin with CPU hint, then yield time slice.
+		// OPT-31: The counts are from the WaitStrategy policy.
+		if(doSpinWait()) {
+			return true;
+		}
+
+		// Phase 4: Fall back to CV wait (futex), or keep spinning or
+		// yielding until the timeout if the strategy doesn't park.
+		waitCore.parkCount.fetch_add(1, std::memory_order_relaxed);
+		if(doIdleWaitFor(duration, IsWaitPark())) {
+			return true;
+		}
+		waitCore.timeoutCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	// OPT-31: How the waits returned. spinWakeCount and yieldWakeCount are
+	// the waits which found the events while spinning and yielding.
+	// parkCount is the waits which went past these phases, timeoutCount is
+	// the waitFor calls which timed out. spinLimit is the current spin count.
+	WaitStats getWaitStats() const
+	{
+		return WaitStats {
+			waitCore.spinWakeCount.load(std::memory_order_relaxed),
+			waitCore.yieldWakeCount.load(std::memory_order_relaxed),
+			waitCore.parkCount.load(std::memory_order_relaxed),
+			waitCore.timeoutCount.load(std::memory_order_relaxed),
+			waitCore.spinLimit.load(std::memory_order_relaxed)
+		};
+	}
+
+	// OPT-53: Sets the limits of the queue. It can be called at any time,
+	// the producers blocked by the old limit are woken.
+	// maxEventCount and maxByteCount limit the events in the queue, including
+	// the events being processed, maxByteCount is counted by
+	// getQueueItemSize(). When both are set, the lower limit applies.
+	// The watermark callback is called with true when the count of events
+	// reaches highWatermark, then with false when it falls to lowWatermark.
+	// The free list keeps at most maxFreeCount nodes, the others are freed.
+	// Requires the QueueCapacity policy to be QueueCapacityLimited.
+	void setQueueLimits(const QueueLimits & limits)
+	{
+		static_assert(HasQueueCapacity::value, "setQueueLimits requires the QueueCapacity policy to be QueueCapacityLimited.");
+		assert(limits.highWatermark == 0 || limits.lowWatermark < limits.highWatermark);
+
+		constexpr std::size_t noLimit = (std::numeric_limits<std::size_t>::max)();
+		std::size_t eventLimit = (limits.maxEventCount == 0 ? noLimit : limits.maxEventCount);
+		if(limits.maxByteCount > 0) {
+			const std::size_t byteLimit = limits.maxByteCount / getQueueItemSize();
+			eventLimit = (std::min)(eventLimit, (byteLimit == 0 ? std::size_t(1) : byteLimit));
+		}
+
+		{
+			std::lock_guard<Mutex> capacityLock(capacityState.mutex);
+			capacityState.limits = limits;
+			capacityState.eventLimit.store(eventLimit, std::memory_order_relaxed);
+			capacityState.highWatermark.store(limits.highWatermark == 0 ? noLimit : limits.highWatermark, std::memory_order_relaxed);
+			capacityState.lowWatermark.store(limits.lowWatermark, std::memory_order_relaxed);
+			capacityState.maxFreeCount.store(limits.maxFreeCount == 0 ? noLimit : limits.maxFreeCount, std::memory_order_relaxed);
+			capacityState.notFullConditionVariable.notify_all();
+		}
+
+		// The nodes over the new maxFreeCount are freed after the lock.
+		BufferedItemList spillList;
+		{
+			std::lock_guard<Mutex> freeListLock(freeListMutex);
+			while(capacityState.freeCount > capacityState.maxFreeCount.load(std::memory_order_relaxed)) {
+				spillList.splice(spillList.end(), freeList, freeList.begin());
+				--capacityState.freeCount;
+			}
+		}
+	}
+
+	// OPT-54: Waits until the queue is under its limit, for a producer which
+	// enqueues by enqueueBulk or ProducerBuffer, which never wait. An
+	// unbounded queue is never full, they return at once.
+	void waitNotFull()
+	{
+		doWaitNotFullUntil(nullptr, HasQueueCapacity());
+	}
+
+	// Returns false if the queue is still full after duration.
+	template <class Rep, class Period>
+	bool waitNotFullFor(const std::chrono::duration<Rep, Period> & duration)
+	{
+		const TimerTimePoint deadline = TimerClock::now() + std::chrono::duration_cast<TimerDuration>(duration);
+		return doWaitNotFullUntil(&deadline, HasQueueCapacity());
+	}
+
+	QueueLimits getQueueLimits() const
+	{
+		static_assert(HasQueueCapacity::value, "getQueueLimits requires the QueueCapacity policy to be QueueCapacityLimited.");
+
+		std::lock_guard<Mutex> capacityLock(capacityState.mutex);
+		return capacityState.limits;
+	}
+
+	// The memory of one queued event, as counted by maxByteCount. The memory
+	// owned by the arguments, such as the buffer of a std::string, is not
+	// counted.
+	static constexpr std::size_t getQueueItemSize()
+	{
+		// The item and the two links of the list node.
+		return sizeof(BufferedItem<QueuedEvent_>) + 2 * sizeof(void *);
+	}
+
+	// OPT-53: The events in the queue, including the events being processed.
+	std::size_t getQueuedEventCount() const
+	{
+		static_assert(HasQueueCapacity::value, "getQueuedEventCount requires the QueueCapacity policy to be QueueCapacityLimited.");
+
+		return capacityState.eventCount.load(std::memory_order_relaxed);
+	}
+
+	// OPT-53: Events discarded by QueueOverflowDropNewest or
+	// QueueOverflowDropOldest.
+	std::size_t getDroppedEventCount() const
+	{
+		static_assert(HasQueueCapacity::value, "getDroppedEventCount requires the QueueCapacity policy to be QueueCapacityLimited.");
+
+		return capacityState.droppedEventCount.load(std::memory_order_relaxed);
+	}
+
+	// OPT-53: callback is called with each dropped event, in the thread which
+	// enqueues. Not thread safe, set it before the queue is used.
+	void setOverflowCallback(OverflowCallback callback)
+	{
+		static_assert(HasQueueCapacity::value, "setOverflowCallback requires the QueueCapacity policy to be QueueCapacityLimited.");
+
+		capacityState.overflowCallback = std::move(callback);
+	}
+
+	// OPT-53: callback(true) is called when the count of events reaches
+	// highWatermark, callback(false) when it falls to lowWatermark after
+	// that, in the thread which enqueues or processes. The calls are
+	// serialized, it must not call setWatermarkCallback.
+	void setWatermarkCallback(WatermarkCallback callback)
+	{
+		static_assert(HasQueueCapacity::value, "setWatermarkCallback requires the QueueCapacity policy to be QueueCapacityLimited.");
+
+		std::lock_guard<Mutex> watermarkLock(capacityState.watermarkMutex);
+		capacityState.watermarkCallback = std::move(callback);
+	}
+
+	using super::dispatch;
+
+	template <typename U>
+	auto dispatch(const U & queuedEvent)
+		-> typename std::enable_if<std::is_same<U, QueuedEvent>::value, void>::type
+	{
+		doDirectDispatchQueuedEvent(
+			queuedEvent,
+			typename MakeIndexSequence<sizeof...(Args)>::Type()
+		);
+	}
+
+	bool peekEvent(QueuedEvent * queuedEvent)
+	{
+		doCollectEvents();
+
+		if(! queueList.empty()) {
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			
+			if(! queueList.empty()) {
+				*queuedEvent = queueList.front().get();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool takeEvent(QueuedEvent * queuedEvent)
+	{
+		doCollectEvents();
+
+		if(! queueList.empty()) {
+			BufferedItemList tempList;
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+
+				if(! queueList.empty()) {
+					tempList.splice(tempList.end(), queueList, queueList.begin());
+				}
+			}
+
+			if(! tempList.empty()) {
+				doAfterDequeue(tempList.front().get());
+				*queuedEvent = std::move(tempList.front().get());
+				tempList.front().clear();
+
+				doRecycleItems(tempList);
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+#if EVENTPP_HAS_COROUTINE
+	// OPT-50: co_await queue.next() takes one event out of the queue, as
+	// takeEvent does. If the queue is empty, the coroutine is suspended
+	// until an event is enqueued, then it's resumed in the thread which
+	// enqueues the event.
+	NextAwaiter next()
+	{
+		return NextAwaiter(this, 1, nullptr, nullptr);
+	}
+
+	// Same as next, but the coroutine is resumed by executor.post(handle).
+	template <typename Executor>
+	NextAwaiter next(Executor & executor)
+	{
+		return NextAwaiter(this, 1, &executor, &postToExecutor<Executor>);
+	}
+
+	// co_await queue.batch(maxCount) borrows one to maxCount events, as
+	// borrowEvents does, suspending the coroutine if the queue is empty.
+	BatchAwaiter batch(const size_t maxCount)
+	{
+		assert(maxCount > 0);
+		return BatchAwaiter(this, maxCount, nullptr, nullptr);
+	}
+
+	template <typename Executor>
+	BatchAwaiter batch(const size_t maxCount, Executor & executor)
+	{
+		assert(maxCount > 0);
+		return BatchAwaiter(this, maxCount, &executor, &postToExecutor<Executor>);
+	}
+
+	// Resumes all suspended coroutines with no event, such as to stop the
+	// consumers before the queue is destroyed.
+	void cancelAwaiters()
+	{
+		AwaiterBase * awaiter;
+		{
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			awaiter = awaiterHead;
+			awaiterHead = nullptr;
+			awaiterTail = nullptr;
+			awaiterCount.store(0, std::memory_order_relaxed);
+			for(AwaiterBase * a = awaiter; a != nullptr; a = a->nextAwaiter) {
+				a->linked = false;
+			}
+		}
+		doResumeAwaiters(awaiter);
+	}
+#endif
+
+	// OPT-36: Takes at most maxCount events out of the queue without moving
+	// or copying them. The events are not dispatched, they can be read until
+	// the returned BorrowedEvents is released or destroyed.
+	BorrowedEvents borrowEvents(const size_t maxCount = (std::numeric_limits<size_t>::max)())
+	{
+		doCollectEvents();
+
+		BufferedItemList tempList;
+		size_t count = 0;
+
+		if(maxCount > 0 && ! queueList.empty()) {
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			while(count < maxCount && ! queueList.empty()) {
+				tempList.splice(tempList.end(), queueList, queueList.begin());
+				++count;
+			}
+		}
+
+		if(count == 0) {
+			return BorrowedEvents();
+		}
+
+		for(auto & item : tempList) {
+			doAfterDequeue(item.get());
+		}
+
+		return BorrowedEvents(this, std::move(tempList), count);
+	}
+
+protected:
+	template <typename F>
+	bool doProcessN(const size_t maxCount, F && func)
+	{
+		ReplyFlushGuard<decltype(replyNotifier)> replyFlushGuard(replyNotifier);
+		doCollectEvents();
+
+		if(maxCount > 0 && ! queueList.empty()) {
+			BufferedItemList tempList;
+
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				for(size_t i = 0; i < maxCount && ! queueList.empty(); ++i) {
+					tempList.splice(tempList.end(), queueList, queueList.begin());
+				}
+			}
+
+			if(! tempList.empty()) {
+				for(auto & item : tempList) {
+					func(item.get());
+					item.clear();
+				}
+
+				doRecycleItems(tempList);
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	template <class Rep, class Period, typename F>
+	bool doProcessFor(const std::chrono::duration<Rep, Period> & duration, F && func)
+	{
+		ReplyFlushGuard<decltype(replyNotifier)> replyFlushGuard(replyNotifier);
+		doCollectEvents();
+
+		if(! queueList.empty()) {
+			const auto deadline = TimerClock::now() + std::chrono::duration_cast<TimerDuration>(duration);
+
+			BufferedItemList tempList;
+			BufferedItemList idleList;
+
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				std::swap(queueList, tempList);
+			}
+
+			for(auto it = tempList.begin(); it != tempList.end(); ) {
+				func(it->get());
+				it->clear();
+
+				auto tempIt = it;
+				++it;
+				idleList.splice(idleList.end(), tempList, tempIt);
+
+				if(TimerClock::now() >= deadline) {
+					break;
+				}
+			}
+
+			if(! tempList.empty()) {
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				queueList.splice(queueList.begin(), tempList);
+			}
+
+			if(! idleList.empty()) {
+				doRecycleItems(idleList);
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void doRegisterProducerBuffer(ProducerBuffer * buffer)
+	{
+		std::lock_guard<Mutex> producerBufferLock(producerBufferMutex);
+		buffer->next = producerBufferHead;
+		if(producerBufferHead != nullptr) {
+			producerBufferHead->previous = buffer;
+		}
+		producerBufferHead = buffer;
+		++producerBufferCount;
+	}
+
+	void doUnregisterProducerBuffer(ProducerBuffer * buffer)
+	{
+		{
+			std::lock_guard<Mutex> producerBufferLock(producerBufferMutex);
+			if(buffer->previous != nullptr) {
+				buffer->previous->next = buffer->next;
+			}
+			else {
+				producerBufferHead = buffer->next;
+			}
+			if(buffer->next != nullptr) {
+				buffer->next->previous = buffer->previous;
+			}
+			--producerBufferCount;
+		}
+
+		if(! buffer->spareList.empty()) {
+			doRecycleNodes(buffer->spareList);
+		}
+	}
+
+	void doWait(std::false_type) const
+	{
+		QueueParkCore::park(queueListMutex, queueListConditionVariable, this, &EventQueueBase::doCanProcessQueue);
+	}
+
+	void doWait(std::true_type) const
+	{
+		while(! doWaitFor(std::chrono::hours(1), std::true_type())) {
+		}
+	}
+
+	// OPT-31: Phase 2 and 3 of waiting. Returns true if the queue can be processed.
+	// OPT-84: The loops are in QueueWaitCore, which is shared by all the
+	// queue types.
+	bool doSpinWait() const
+	{
+		return waitCore.spinWait(this, &EventQueueBase::doCanProcessQueue, doGetWaitMonitorWord(HasWaitMonitor()), doGetWaitParams());
+	}
+
+	static internal_::QueueWaitParams doGetWaitParams()
+	{
+		return internal_::QueueWaitParams {
+			WaitStrategy::spinCount,
+			WaitStrategy::minSpinCount,
+			WaitStrategy::yieldCount,
+			WaitStrategy::adaptive
+		};
+	}
+
+	static bool doCanProcessQueue(const void * queue)
+	{
+		return static_cast<const EventQueueBase *>(queue)->doCanProcess();
+	}
+
+	bool doAdvanceClockToDueTime(std::false_type) const
+	{
+		return false;
+	}
+
+	bool doAdvanceClockToDueTime(std::true_type) const
+	{
+		const TimerTimePoint dueTime = doGetNextDueTime(HasTimer());
+		if(dueTime == (TimerTimePoint::max)()) {
+			return false;
+		}
+		TimerClock::advanceTo(dueTime);
+		return doCanProcess();
+	}
+
+	template <class Rep, class Period>
+	bool doAdvanceClockFor(const std::chrono::duration<Rep, Period> & /*duration*/, std::false_type) const
+	{
+		return false;
+	}
+
+	// OPT-81: The virtual clock stands still while the thread would wait, so
+	// it jumps to the next delayed event, or to the timeout if it's earlier.
+	// The events enqueued by the other threads are not waited for.
+	template <class Rep, class Period>
+	bool doAdvanceClockFor(const std::chrono::duration<Rep, Period> & duration, std::true_type) const
+	{
+		const TimerTimePoint now = TimerClock::now();
+		const TimerDuration timeout = std::chrono::duration_cast<TimerDuration>(duration);
+		TimerTimePoint wakeTime = (timeout >= (TimerTimePoint::max)() - now ? (TimerTimePoint::max)() : now + timeout);
+		const TimerTimePoint dueTime = doGetNextDueTime(HasTimer());
+		if(dueTime < wakeTime) {
+			wakeTime = dueTime;
+		}
+		if(wakeTime != (TimerTimePoint::max)()) {
+			TimerClock::advanceTo(wakeTime);
+		}
+		if(doCanProcess()) {
+			return true;
+		}
+		waitCore.timeoutCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	void doIdleWait(std::true_type) const
+	{
+		doWait(HasTimer());
+	}
+
+	void doIdleWait(std::false_type) const
+	{
+		waitCore.busyWaitUntil(this, &EventQueueBase::doCanProcessQueue, nullptr, nullptr, doGetWaitParams());
+	}
+
+	template <class Rep, class Period>
+	bool doIdleWaitFor(const std::chrono::duration<Rep, Period> & duration, std::true_type) const
+	{
+		return doWaitFor(duration, HasTimer());
+	}
+
+	template <class Rep, class Period>
+	bool doIdleWaitFor(const std::chrono::duration<Rep, Period> & duration, std::false_type) const
+	{
+		const auto now = TimerClock::now();
+		if(duration >= TimerTimePoint::max() - now) {
+			return waitCore.busyWaitUntil(this, &EventQueueBase::doCanProcessQueue, nullptr, nullptr, doGetWaitParams());
+		}
+		const TimerTimePoint deadline = now + std::chrono::duration_cast<TimerDuration>(duration);
+		return waitCore.busyWaitUntil(this, &EventQueueBase::doCanProcessQueue, &deadline, &internal_::isClockPast<TimerClock>, doGetWaitParams());
+	}
+
+	static const std::atomic<std::uint32_t> * doGetWaitMonitorWord(std::false_type)
+	{
+		return nullptr;
+	}
+
+	const std::atomic<std::uint32_t> * doGetWaitMonitorWord(std::true_type) const
+	{
+		return &waitMonitor.word;
+	}
+
+	void doSignalWaitMonitor(std::false_type)
+	{
+	}
+
+	void doSignalWaitMonitor(std::true_type)
+	{
+		waitMonitor.word.fetch_add(1, std::memory_order_release);
+	}
+
+	template <class Rep, class Period>
+	bool doWaitFor(const std::chrono::duration<Rep, Period> & duration, std::false_type) const
+	{
+		// Rounded up as wait_for does.
+		std::chrono::nanoseconds timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(duration);
+		if(timeout < duration) {
+			++timeout;
+		}
+		return QueueParkCore::parkFor(queueListMutex, queueListConditionVariable, timeout, this, &EventQueueBase::doCanProcessQueue);
+	}
+
+	// OPT-29: Sleep until the next deadline if it's before the timeout.
+	// enqueueAt wakes the consumer if it adds an earlier deadline.
+	template <class Rep, class Period>
+	bool doWaitFor(const std::chrono::duration<Rep, Period> & duration, std::true_type) const
+	{
+		const auto deadline = TimerClock::now() + std::chrono::duration_cast<TimerDuration>(duration);
+
+		std::unique_lock<Mutex> queueListLock(queueListMutex);
+		for(;;) {
+			const auto now = TimerClock::now();
+			if(now >= deadline) {
+				return doCanProcess();
+			}
+
+			const TimerTick nextTick = delayedEvents.nextTick.load(std::memory_order_acquire);
+			auto wakeTime = deadline;
+			if(nextTick != DelayedEventWheel::noTick) {
+				const auto tickTime = doGetTimerTimePoint(nextTick);
+				if(tickTime < wakeTime) {
+					wakeTime = tickTime;
+				}
+			}
+
+			const bool woken = queueListConditionVariable.wait_for(queueListLock, wakeTime - now, [this, nextTick]() -> bool {
+				return doCanProcess() || delayedEvents.nextTick.load(std::memory_order_acquire) != nextTick;
+			});
+			if(woken && doCanProcess()) {
+				return true;
+			}
+		}
+	}
+
+	// Move the pending events, which are staged in the producer buffers or
+	// due in the timer, to the queue list.
+	// OPT-30: The notifier is cleared before the events are taken, so an
+	// event enqueued after that is signaled again.
+	void doCollectEvents()
+	{
+		internal_::ForEachMixins<typename super::MixinRoot, typename super::Mixins, DoMixinBeforeProcess>::forEach(this);
+		doFlushProducerBuffers();
+		doMoveDueEvents(HasTimer());
+		doClearNotifier(HasQueueNotifier());
+	}
+
+	void doMoveDueEvents(std::false_type)
+	{
+	}
+
+	void doMoveDueEvents(std::true_type)
+	{
+		const TimerTick nextTick = delayedEvents.nextTick.load(std::memory_order_acquire);
+		if(nextTick == DelayedEventWheel::noTick) {
+			return;
+		}
+		const TimerTick nowTick = doGetTimerNowTick();
+		if(nowTick < nextTick) {
+			return;
+		}
+
+		BufferedItemList tempList;
+		{
+			std::lock_guard<Mutex> timerLock(delayedEvents.mutex);
+			std::lock_guard<Mutex> freeListLock(freeListMutex);
+			BufferedItemList nodeList;
+			std::size_t takenCount = 0;
+			delayedEvents.wheel.advance(nowTick, [this, &tempList, &nodeList, &takenCount](QueuedEvent && item) {
+				// Same as doEnqueue, one node is set then spliced, so the
+				// QueueList policy sees each event as in enqueue.
+				if(freeList.empty()) {
+					nodeList.emplace_back();
+				}
+				else {
+					nodeList.splice(nodeList.end(), freeList, freeList.begin());
+					++takenCount;
+				}
+				auto it = nodeList.begin();
+				it->set(std::move(item));
+				tempList.splice(tempList.end(), nodeList, it);
+			});
+			doTakeFreeNodes(takenCount, HasQueueCapacity());
+			delayedEvents.nextTick.store(delayedEvents.wheel.getNextTick(), std::memory_order_release);
+		}
+
+		doEnqueueBulk(tempList);
+	}
+
+	bool doHasDueEvents(std::false_type) const
+	{
+		return false;
+	}
+
+	bool doHasDueEvents(std::true_type) const
+	{
+		const TimerTick nextTick = delayedEvents.nextTick.load(std::memory_order_acquire);
+		return nextTick != DelayedEventWheel::noTick && doGetTimerNowTick() >= nextTick;
+	}
+
+	// The first tick which is not before timePoint.
+	TimerTick doGetTimerTick(const TimerTimePoint & timePoint) const
+	{
+		if(timePoint <= delayedEvents.epoch) {
+			return 0;
+		}
+		const auto elapsed = timePoint - delayedEvents.epoch;
+		auto ticks = std::chrono::duration_cast<TimerResolution>(elapsed);
+		if(ticks < elapsed) {
+			++ticks;
+		}
+		return static_cast<TimerTick>(ticks.count());
+	}
+
+	TimerTick doGetTimerNowTick() const
+	{
+		return static_cast<TimerTick>(std::chrono::duration_cast<TimerResolution>(TimerClock::now() - delayedEvents.epoch).count());
+	}
+
+	TimerTimePoint doGetTimerTimePoint(const TimerTick tick) const
+	{
+		return delayedEvents.epoch + std::chrono::duration_cast<TimerDuration>(TimerResolution(static_cast<typename TimerResolution::rep>(tick)));
+	}
+
+	// Move the events staged in the producer buffers to the queue list.
+	// It's only a counter check if ProducerBuffer is not used.
+	void doFlushProducerBuffers()
+	{
+		if(producerBufferCount.load(std::memory_order_acquire) == 0) {
+			return;
+		}
+
+		std::lock_guard<Mutex> producerBufferLock(producerBufferMutex);
+		for(ProducerBuffer * buffer = producerBufferHead; buffer != nullptr; buffer = buffer->next) {
+			std::lock_guard<Mutex> bufferLock(buffer->mutex);
+			buffer->doFlush();
+		}
+	}
+
+	bool doCanProcess() const
+	{
+		return (! emptyQueue() || doHasDueEvents(HasTimer())) && doCanNotifyQueueAvailable();
+	}
+
+	bool doCanNotifyQueueAvailable() const
+	{
+		return queueNotifyCounter.load(std::memory_order_acquire) == 0;
+	}
+
+	// The events taken from the queue are dispatched or visited by these
+	// helpers, so the dequeue hook of the mixins is called here.
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEvent(T && item, IndexSequence<Indexes...>)
+	{
+		doAfterDequeue(item);
+		if(doDropExpired(item, HasQueueDeadline())) {
+			return;
+		}
+		TraceScope traceScope(this, item);
+		if(! doDispatchReplyEvent(item, HasQueueReply(), IndexSequence<Indexes...>())) {
+			doDispatchQueuedArguments(item, typename super::SharesArguments(), IndexSequence<Indexes...>());
+		}
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedArguments(T & item, std::false_type, IndexSequence<Indexes...>)
+	{
+		this->directDispatch(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	// OPT-86: The listeners get the queued arguments by reference.
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedArguments(T & item, std::true_type, IndexSequence<Indexes...>)
+	{
+		DispatchCache cache;
+		this->doDirectDispatchSharedCached(cache, item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedArgumentsCached(DispatchCache & cache, T & item, std::false_type, IndexSequence<Indexes...>)
+	{
+		this->doDirectDispatchCached(cache, item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedArgumentsCached(DispatchCache & cache, T & item, std::true_type, IndexSequence<Indexes...>)
+	{
+		this->doDirectDispatchSharedCached(cache, item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	// Returns false if the event is dropped by its deadline.
+	template <typename T, size_t ...Indexes>
+	bool doDispatchQueuedEventCached(DispatchCache & cache, T && item, IndexSequence<Indexes...>)
+	{
+		doAfterDequeue(item);
+		if(doDropExpired(item, HasQueueDeadline())) {
+			return false;
+		}
+		TraceScope traceScope(this, item);
+		if(! doDispatchReplyEvent(item, HasQueueReply(), IndexSequence<Indexes...>())) {
+			doDispatchQueuedArgumentsCached(cache, item, typename super::SharesArguments(), IndexSequence<Indexes...>());
+		}
+		return true;
+	}
+
+	// OPT-65: Same as doDispatchQueuedEventCached, and the event is added to
+	// the run of the batch listeners.
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEventBatched(ProcessCache & cache, T && item, IndexSequence<Indexes...>)
+	{
+		if(! cache.enabled) {
+			doDispatchQueuedEventCached(cache, item, IndexSequence<Indexes...>());
+			return;
+		}
+
+		doBeginBatchRun(cache, item, CanBatch());
+		if(doDispatchQueuedEventCached(cache, item, IndexSequence<Indexes...>()) && cache.hasBatchListener) {
+			doAddToBatchRun(cache, item, CanBatch());
+		}
+	}
+
+	void doBeginBatchRun(ProcessCache & /*cache*/, const QueuedEvent & /*item*/, std::false_type)
+	{
+	}
+
+	// A new run starts when the event is not the event of the run, and the
+	// last run is given to the batch listeners first.
+	void doBeginBatchRun(ProcessCache & cache, const QueuedEvent & item, std::true_type)
+	{
+		if(! cache.runEvent.empty() && doIsSameBatchEvent(cache.runEvent.front(), item.event)) {
+			return;
+		}
+		doFlushBatchRun(cache);
+		cache.runEvent.clear();
+		cache.runEvent.push_back(item.event);
+		// The holder exists, cache.enabled means a batch listener was added.
+		cache.hasBatchListener = batchHolder.load(std::memory_order_acquire)->hasAnyListener(item.event);
+		if(cache.hasBatchListener) {
+			// An event which only has batch listeners is looked up once for
+			// the run, not for each event, so the cache points to the event
+			// of the run with no callback list. A listener added to it during
+			// the run is seen by the next run.
+			this->doFindDispatchCache(cache, item.event);
+			if(cache.callbackList == nullptr) {
+				cache.event = &cache.runEvent.front();
+			}
+		}
+	}
+
+	void doAddToBatchRun(ProcessCache & /*cache*/, const QueuedEvent & /*item*/, std::false_type)
+	{
+	}
+
+	void doAddToBatchRun(ProcessCache & cache, const QueuedEvent & item, std::true_type)
+	{
+		cache.columns.push(item.arguments);
+	}
+
+	void doFlushBatchRun(ProcessCache & cache)
+	{
+		if(cache.columns.empty()) {
+			return;
+		}
+		const auto & event = cache.runEvent.front();
+		BatchHolder * holder = batchHolder.load(std::memory_order_acquire);
+		cache.columns.invoke([holder, &event](BatchSpan<typename std::decay<Args>::type> ...spans) {
+			holder->dispatch(event, spans...);
+		});
+		cache.columns.clear();
+	}
+
+	// Made once, the holder stays until the queue is destroyed or assigned.
+	BatchDispatcher & doGetBatchDispatcher()
+	{
+		BatchHolder * holder = batchHolder.load(std::memory_order_acquire);
+		if(holder == nullptr) {
+			BatchHolder * newHolder = new BatchDispatcherHolder();
+			if(batchHolder.compare_exchange_strong(holder, newHolder, std::memory_order_acq_rel, std::memory_order_acquire)) {
+				holder = newHolder;
+			}
+			else {
+				delete newHolder;
+			}
+		}
+		return static_cast<BatchDispatcherHolder *>(holder)->dispatcher;
+	}
+
+	BatchHolder * doCloneBatchHolder() const
+	{
+		const BatchHolder * holder = batchHolder.load(std::memory_order_acquire);
+		return (holder != nullptr ? holder->clone() : nullptr);
+	}
+
+	template <typename E>
+	static auto doIsSameBatchEvent(const E & a, const E & b)
+		-> typename std::enable_if<HasOperatorEqual<E>::value, bool>::type
+	{
+		return a == b;
+	}
+
+	template <typename E>
+	static auto doIsSameBatchEvent(const E & /*a*/, const E & /*b*/)
+		-> typename std::enable_if<! HasOperatorEqual<E>::value, bool>::type
+	{
+		return false;
+	}
+
+	template <typename T, size_t ...Indexes>
+	bool doDispatchReplyEvent(T & /*item*/, std::false_type, IndexSequence<Indexes...>)
+	{
+		return false;
+	}
+
+	// OPT-49: Returns false if the event has no reply. The listeners are
+	// called as directDispatch calls them, the value of each one replaces
+	// the value of the previous one.
+	template <typename T, size_t ...Indexes>
+	bool doDispatchReplyEvent(T & item, std::true_type, IndexSequence<Indexes...>)
+	{
+		ReplySlot<ReplyResult> * const slot = item.stamp.takeReply();
+		if(slot == nullptr) {
+			return false;
+		}
+		this->doDirectDispatchWith(
+			item.event,
+			[slot](const ReplyCallbackList & callbackList, typename std::add_lvalue_reference<Args>::type ...args) {
+				callbackList.forEachIf([slot, &args...](const Callback & callback) -> bool {
+					doInvokeForReply(slot->getValue(), callback, std::is_void<ReturnType>(), args...);
+					return CanContinueInvoking::canContinueInvoking(args...);
+				});
+			},
+			std::get<Indexes>(item.arguments)...
+		);
+		slot->complete(true);
+		return true;
+	}
+
+	template <typename ...A>
+	static void doInvokeForReply(ReplyValue<ReplyResult> & value, const Callback & callback, std::false_type, A & ...args)
+	{
+		value.set(callback(args...));
+	}
+
+	template <typename ...A>
+	static void doInvokeForReply(ReplyValue<ReplyResult> & value, const Callback & callback, std::true_type, A & ...args)
+	{
+		callback(args...);
+		value.set();
+	}
+
+	// OPT-15: Direct visitor dispatch -- bypasses directDispatch/map/CallbackList.
+	template <typename V, typename T, size_t ...Indexes>
+	void doVisitQueuedEvent(V && visitor, T && item, IndexSequence<Indexes...>)
+	{
+		doAfterDequeue(item);
+		if(doDropExpired(item, HasQueueDeadline())) {
+			return;
+		}
+		TraceScope traceScope(this, item);
+		visitor(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	bool doDropExpired(const QueuedEvent & /*item*/, std::false_type)
+	{
+		return false;
+	}
+
+	// OPT-55: The clock is only read for the events which have a deadline.
+	// A dropped reply event is completed with no value when it's cleared.
+	bool doDropExpired(const QueuedEvent & item, std::true_type)
+	{
+		if(item.stamp.deadline == (TimerTimePoint::max)() || TimerClock::now() < item.stamp.deadline) {
+			return false;
+		}
+		deadlineState.expiredEventCount.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// For dispatch(queuedEvent), the event is already out of the queue.
+	template <typename T, size_t ...Indexes>
+	void doDirectDispatchQueuedEvent(T && item, IndexSequence<Indexes...>)
+	{
+		this->directDispatch(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	// OPT-33: The enqueue and dequeue hooks of the mixins. They compile to
+	// nothing if no mixin has them.
+	void doAfterEnqueue(QueuedEvent & item) const
+	{
+		doStampTimeToLive(item, HasTimeToLive());
+		doTraceEnqueue(item, HasTracer());
+		internal_::ForEachMixins<typename super::MixinRoot, typename super::Mixins, DoMixinAfterEnqueue>::forEach(this, item);
+	}
+
+	void doStampTimeToLive(QueuedEvent & /*item*/, std::false_type) const
+	{
+	}
+
+	// OPT-55: The deadline is the enqueue time plus the time to live of the
+	// policies, unless enqueueWithDeadline set it. A time to live which is
+	// not positive is no deadline.
+	void doStampTimeToLive(QueuedEvent & item, std::true_type) const
+	{
+		static_assert(HasQueueDeadline::value, "getTimeToLive requires the QueueDeadline policy to be QueueDeadlineSteady.");
+
+		if(item.stamp.deadline == (TimerTimePoint::max)()) {
+			const TimerDuration timeToLive = doGetTimeToLive(item, typename MakeIndexSequence<sizeof...(Args)>::Type());
+			if(timeToLive > TimerDuration::zero()) {
+				item.stamp.deadline = TimerClock::now() + timeToLive;
+			}
+		}
+	}
+
+	template <size_t ...Indexes>
+	static TimerDuration doGetTimeToLive(const QueuedEvent & item, IndexSequence<Indexes...>)
+	{
+		return std::chrono::duration_cast<TimerDuration>(
+			Policies_::getTimeToLive(item.event, std::get<Indexes>(item.arguments)...)
+		);
+	}
+
+	void doTraceEnqueue(const QueuedEvent & /*item*/, std::false_type) const
+	{
+	}
+
+	void doTraceEnqueue(const QueuedEvent & item, std::true_type) const
+	{
+		traceEnqueue<Tracer>(this, item);
+	}
+
+	void doAfterEnqueueList(BufferedItemList & itemList) const
+	{
+		for(auto & item : itemList) {
+			doAfterEnqueue(item.get());
+		}
+	}
+
+	void doAfterDequeue(const QueuedEvent & item) const
+	{
+		internal_::ForEachMixins<typename super::MixinRoot, typename super::Mixins, DoMixinAfterDequeue>::forEach(this, item);
+	}
+
+	// OPT-56: The event is only got if a mixin has mixinBeforeEnqueue.
+	template <typename ...A>
+	bool doBeforeEnqueue(A & ...args) const
+	{
+		return internal_::ForEachMixins<typename super::MixinRoot, typename super::Mixins, DoMixinBeforeEnqueue>::forEach(this, args...);
+	}
+
+	// For emplace and reserve, which have the event but no arguments yet.
+	bool doBeforeEnqueueEvent(const EventType_ & e) const
+	{
+		return internal_::ForEachMixins<typename super::MixinRoot, typename super::Mixins, DoMixinBeforeEnqueueEvent>::forEach(this, e);
+	}
+
+	template <typename ...A>
+	auto doGetEnqueueEvent(A & ...args) const -> typename std::enable_if<sizeof...(A) == sizeof...(Args), EventType_>::type
+	{
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, A &...>::value>::Type;
+		return GetEvent::getEvent(args...);
+	}
+
+	template <typename T, typename ...A>
+	auto doGetEnqueueEvent(T & first, A & ...args) const -> typename std::enable_if<sizeof...(A) == sizeof...(Args), EventType_>::type
+	{
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, T &, A &...>::value>::Type;
+		return GetEvent::getEvent(first, args...);
+	}
+
+	struct DoMixinBeforeEnqueue
+	{
+		template <typename T, typename Self, typename ...A>
+		static auto forEach(const Self * self, A & ...args)
+			-> typename std::enable_if<HasFunctionMixinBeforeEnqueue<T, const EventType_ &>::value, bool>::type {
+			return static_cast<const T *>(self)->mixinBeforeEnqueue(self->doGetEnqueueEvent(args...));
+		}
+
+		template <typename T, typename Self, typename ...A>
+		static auto forEach(const Self * /*self*/, A & .../*args*/)
+			-> typename std::enable_if<! HasFunctionMixinBeforeEnqueue<T, const EventType_ &>::value, bool>::type {
+			return true;
+		}
+	};
+
+	struct DoMixinBeforeEnqueueEvent
+	{
+		template <typename T, typename Self>
+		static auto forEach(const Self * self, const EventType_ & e)
+			-> typename std::enable_if<HasFunctionMixinBeforeEnqueue<T, const EventType_ &>::value, bool>::type {
+			return static_cast<const T *>(self)->mixinBeforeEnqueue(e);
+		}
+
+		template <typename T, typename Self>
+		static auto forEach(const Self * /*self*/, const EventType_ & /*e*/)
+			-> typename std::enable_if<! HasFunctionMixinBeforeEnqueue<T, const EventType_ &>::value, bool>::type {
+			return true;
+		}
+	};
+
+	struct DoMixinBeforeProcess
+	{
+		template <typename T, typename Self>
+		static auto forEach(const Self * self)
+			-> typename std::enable_if<HasFunctionMixinBeforeProcess<T>::value, bool>::type {
+			static_cast<const T *>(self)->mixinBeforeProcess();
+			return true;
+		}
+
+		template <typename T, typename Self>
+		static auto forEach(const Self * /*self*/)
+			-> typename std::enable_if<! HasFunctionMixinBeforeProcess<T>::value, bool>::type {
+			return true;
+		}
+	};
+
+	struct DoMixinAfterEnqueue
+	{
+		template <typename T, typename Self>
+		static auto forEach(const Self * self, const QueuedEvent & item)
+			-> typename std::enable_if<HasFunctionMixinAfterEnqueue<T, const QueuedEvent &>::value, bool>::type {
+			static_cast<const T *>(self)->mixinAfterEnqueue(item);
+			return true;
+		}
+
+		template <typename T, typename Self>
+		static auto forEach(const Self * /*self*/, const QueuedEvent & /*item*/)
+			-> typename std::enable_if<! HasFunctionMixinAfterEnqueue<T, const QueuedEvent &>::value, bool>::type {
+			return true;
+		}
+	};
+
+	struct DoMixinAfterDequeue
+	{
+		template <typename T, typename Self>
+		static auto forEach(const Self * self, const QueuedEvent & item)
+			-> typename std::enable_if<HasFunctionMixinAfterDequeue<T, const QueuedEvent &>::value, bool>::type {
+			static_cast<const T *>(self)->mixinAfterDequeue(item);
+			return true;
+		}
 
-	// OPT-15: Single-event variant of processQueueWith.
-	template <typename Visitor>
-	bool processOneWith(Visitor && visitor)
+		template <typename T, typename Self>
+		static auto forEach(const Self * /*self*/, const QueuedEvent & /*item*/)
+			-> typename std::enable_if<! HasFunctionMixinAfterDequeue<T, const QueuedEvent &>::value, bool>::type {
+			return true;
+		}
+	};
+
+	template <typename F, typename T, size_t ...Indexes>
+	bool doInvokeFuncWithQueuedEvent(F && func, T && item, IndexSequence<Indexes...>) const
 	{
-		if(! queueList.empty()) {
-			BufferedItemList tempList;
+		return doInvokeFuncWithQueuedEventHelper(std::forward<F>(func), std::get<Indexes>(item.arguments)...);
+	}
+	
+	template <typename F>
+	auto doInvokeFuncWithQueuedEventHelper(F && func, Args ...args) const
+		-> typename std::enable_if<! CanInvoke<F>::value, bool>::type
+	{
+		return func(std::forward<Args>(args)...);
+	}
 
-			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+	template <typename F>
+	auto doInvokeFuncWithQueuedEventHelper(F && func, Args .../*args*/) const
+		-> typename std::enable_if<CanInvoke<F>::value, bool>::type
+	{
+		return func();
+	}
 
-			{
-				std::lock_guard<Mutex> queueListLock(queueListMutex);
-				if(! queueList.empty()) {
-					tempList.splice(tempList.end(), queueList, queueList.begin());
-				}
-			}
+	template <typename ...A>
+	auto doMakeQueuedEvent(A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), QueuedEvent>::type
+	{
+		static_assert(super::ArgumentPassingMode::canIncludeEventType, "Enqueuing arguments count doesn't match required (Event type should be included).");
 
-			if(! tempList.empty()) {
-				auto & item = tempList.front();
-				doVisitQueuedEvent(
-					visitor,
-					item.get(),
-					typename MakeIndexSequence<sizeof...(Args)>::Type()
-				);
-				item.clear();
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, A...>::value>::Type;
 
-				std::lock_guard<Mutex> queueListLock(freeListMutex);
-				freeList.splice(freeList.end(), tempList);
+		return QueuedEvent{
+			GetEvent::getEvent(args...),
+			QueuedEventArgumentsType(std::forward<A>(args)...)
+		};
+	}
 
-				return true;
+	template <typename T, typename ...A>
+	auto doMakeQueuedEvent(T && first, A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), QueuedEvent>::type
+	{
+		static_assert(super::ArgumentPassingMode::canExcludeEventType, "Enqueuing arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, T &&, A...>::value>::Type;
+
+		return QueuedEvent{
+			GetEvent::getEvent(std::forward<T>(first), args...),
+			QueuedEventArgumentsType(std::forward<A>(args)...)
+		};
+	}
+
+	template <typename T>
+	QueuedEvent doMakeBulkQueuedEvent(T && element)
+	{
+		return doMakeBulkQueuedEvent(std::forward<T>(element), IsStdTuple<typename std::decay<T>::type>());
+	}
+
+	template <typename T>
+	QueuedEvent doMakeBulkQueuedEvent(T && element, std::false_type)
+	{
+		return doMakeQueuedEvent(std::forward<T>(element));
+	}
+
+	template <typename T>
+	QueuedEvent doMakeBulkQueuedEvent(T && element, std::true_type)
+	{
+		return doMakeBulkQueuedEventFromTuple(
+			std::forward<T>(element),
+			typename MakeIndexSequence<std::tuple_size<typename std::decay<T>::type>::value>::Type()
+		);
+	}
+
+	template <typename T, size_t ...Indexes>
+	QueuedEvent doMakeBulkQueuedEventFromTuple(T && element, IndexSequence<Indexes...>)
+	{
+		return doMakeQueuedEvent(std::get<Indexes>(std::forward<T>(element))...);
+	}
+
+	// std::tuple constructs its element from no argument or one argument in
+	// place, more arguments go through InPlaceArgument. The element types
+	// which are constructible from any type, such as std::function, can only
+	// be emplaced from one argument.
+	QueuedEventArgumentsType doMakeEmplacedArguments(std::integral_constant<size_t, 0>)
+	{
+		return QueuedEventArgumentsType();
+	}
+
+	template <typename C>
+	QueuedEventArgumentsType doMakeEmplacedArguments(std::integral_constant<size_t, 1>, C && ctorArg)
+	{
+		return QueuedEventArgumentsType(std::forward<C>(ctorArg));
+	}
+
+	template <size_t N, typename ...C>
+	QueuedEventArgumentsType doMakeEmplacedArguments(std::integral_constant<size_t, N>, C && ...ctorArgs)
+	{
+		using Argument = typename std::tuple_element<0, QueuedEventArgumentsType>::type;
+		return QueuedEventArgumentsType(InPlaceArgument<Argument, C...>{ std::forward_as_tuple(std::forward<C>(ctorArgs)...) });
+	}
+
+	// Take count items into tempList, recycled from freeList as many as possible.
+	// Unlike doEnqueue, the free list is always locked, one lock for the whole
+	// batch is cheaper than allocating the nodes.
+	void doAcquireItems(BufferedItemList & tempList, const size_t count)
+	{
+		size_t acquired = 0;
+		if(count > 0 && ! freeList.empty()) {
+			std::lock_guard<Mutex> queueListLock(freeListMutex);
+			while(acquired < count && ! freeList.empty()) {
+				tempList.splice(tempList.end(), freeList, freeList.begin());
+				++acquired;
 			}
+			doTakeFreeNodes(acquired, HasQueueCapacity());
 		}
 
-		return false;
+		for(; acquired < count; ++acquired) {
+			tempList.emplace_back();
+		}
 	}
 
-	bool processOne()
+	template <typename Iterator>
+	void doEnqueueBulkFrom(Iterator first, const Iterator last, std::false_type)
 	{
-		if(! queueList.empty()) {
-			BufferedItemList tempList;
+		BufferedItemList tempList;
+		doAcquireItems(tempList, static_cast<size_t>(std::distance(first, last)));
 
-			// Use a counter to tell the queue list is not empty during processing
-			// even though queueList is swapped to empty.
-			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+		for(auto it = tempList.begin(); first != last; ++first, ++it) {
+			it->setFrom([this, &first]() {
+				return doMakeBulkQueuedEvent(*first);
+			});
+		}
 
-			{
-				std::lock_guard<Mutex> queueListLock(queueListMutex);
-				if(! queueList.empty()) {
-					tempList.splice(tempList.end(), queueList, queueList.begin());
-				}
+		doEnqueueBulk(tempList);
+	}
+
+	template <typename Generator>
+	void doEnqueueBulkFrom(const size_t count, Generator & generator, std::false_type)
+	{
+		BufferedItemList tempList;
+		doAcquireItems(tempList, count);
+
+		size_t index = 0;
+		for(auto & item : tempList) {
+			item.setFrom([this, &generator, index]() {
+				return doMakeBulkQueuedEvent(generator(index));
+			});
+			++index;
+		}
+
+		doEnqueueBulk(tempList);
+	}
+
+	// OPT-56: The elements are checked in order, the nodes are taken for
+	// the ones which pass. The iterators are kept, so the elements are
+	// not copied.
+	template <typename Iterator>
+	void doEnqueueBulkFrom(Iterator first, const Iterator last, std::true_type)
+	{
+		std::vector<Iterator> passedList;
+		passedList.reserve(static_cast<size_t>(std::distance(first, last)));
+		for(; first != last; ++first) {
+			if(doBeforeEnqueueElement(*first)) {
+				passedList.push_back(first);
 			}
+		}
 
-			if(! tempList.empty()) {
-				auto & item = tempList.front();
-				doDispatchQueuedEvent(
-					item.get(),
-					typename MakeIndexSequence<sizeof...(Args)>::Type()
-				);
-				item.clear();
+		BufferedItemList tempList;
+		doAcquireItems(tempList, passedList.size());
 
-				std::lock_guard<Mutex> queueListLock(freeListMutex);
-				freeList.splice(freeList.end(), tempList);
-				
-				return true;
+		auto it = tempList.begin();
+		for(const Iterator & passed : passedList) {
+			it->setFrom([this, &passed]() {
+				return doMakeBulkQueuedEvent(*passed);
+			});
+			++it;
+		}
+
+		doEnqueueBulk(tempList);
+	}
+
+	// The elements made by generator are temporaries, the ones which pass
+	// are moved to a vector.
+	template <typename Generator>
+	void doEnqueueBulkFrom(const size_t count, Generator & generator, std::true_type)
+	{
+		using Element = typename std::decay<decltype(generator(size_t()))>::type;
+
+		std::vector<Element> passedList;
+		passedList.reserve(count);
+		for(size_t index = 0; index < count; ++index) {
+			Element element(generator(index));
+			if(doBeforeEnqueueElement(element)) {
+				passedList.push_back(std::move(element));
 			}
 		}
-		
-		return false;
+
+		doEnqueueBulkFrom(std::make_move_iterator(passedList.begin()), std::make_move_iterator(passedList.end()), std::false_type());
 	}
 
-	template <typename Predictor>
-	bool processIf(Predictor && predictor)
+	template <typename T>
+	bool doBeforeEnqueueElement(T & element)
 	{
-		if(! queueList.empty()) {
-			BufferedItemList tempList;
-			BufferedItemList idleList;
+		return doBeforeEnqueueElement(element, IsStdTuple<typename std::decay<T>::type>());
+	}
 
-			// Use a counter to tell the queue list is not empty during processing
-			// even though queueList is swapped to empty.
-			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+	template <typename T>
+	bool doBeforeEnqueueElement(T & element, std::false_type)
+	{
+		return doBeforeEnqueue(element);
+	}
+
+	template <typename T>
+	bool doBeforeEnqueueElement(T & element, std::true_type)
+	{
+		return doBeforeEnqueueElementFromTuple(
+			element,
+			typename MakeIndexSequence<std::tuple_size<typename std::decay<T>::type>::value>::Type()
+		);
+	}
+
+	template <typename T, size_t ...Indexes>
+	bool doBeforeEnqueueElementFromTuple(T & element, IndexSequence<Indexes...>)
+	{
+		return doBeforeEnqueue(std::get<Indexes>(element)...);
+	}
+
+	void doEnqueueBulk(BufferedItemList & tempList)
+	{
+		if(tempList.empty()) {
+			return;
+		}
+
+		// OPT-53: The batch is counted, but never waits or is dropped.
+		doForceAdmitItems(tempList, HasQueueCapacity());
+		doAfterEnqueueList(tempList);
+
+		bool wasEmpty;
+		{
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			wasEmpty = queueList.empty();
+			queueList.splice(queueList.end(), tempList);
+		}
+		doSignalNotifier(wasEmpty, HasQueueNotifier());
+		doWakeAwaiters();
+		doSignalQueueSet();
+		doSignalWaitMonitor(HasWaitMonitor());
 
+		if(doCanProcess()) {
+			queueListConditionVariable.notify_one();
+		}
+	}
+
+	// OPT-77: The events are taken out of this queue like in processIf, so
+	// select and the hooks run without a lock. Both lists are then locked in
+	// the order of their addresses, so two queues moving to each other don't
+	// deadlock, and the kept events are put back in the same step as the
+	// moved events are published.
+	template <typename Select>
+	bool doMoveEvents(EventQueueBase & other, Select && select)
+	{
+		if(&other == this) {
+			return false;
+		}
+
+		doCollectEvents();
+		if(queueList.empty()) {
+			return false;
+		}
+
+		BufferedItemList tempList;
+		BufferedItemList movedList;
+
+		CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+		{
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			std::swap(queueList, tempList);
+		}
+		if(tempList.empty()) {
+			return false;
+		}
+
+		select(tempList, movedList);
+
+		if(movedList.empty()) {
+			bool wasEmpty;
 			{
 				std::lock_guard<Mutex> queueListLock(queueListMutex);
-				std::swap(queueList, tempList);
+				wasEmpty = queueList.empty();
+				queueList.splice(queueList.begin(), tempList);
 			}
+			// The notifier was cleared by doCollectEvents.
+			doSignalNotifier(wasEmpty, HasQueueNotifier());
+			return false;
+		}
 
-			if(! tempList.empty()) {
-				for(auto it = tempList.begin(); it != tempList.end(); ) {
-					if(doInvokeFuncWithQueuedEvent(
-							predictor,
-							it->get(),
-							typename MakeIndexSequence<sizeof...(Args)>::Type())
-						) {
-						doDispatchQueuedEvent(
-							it->get(),
-							typename MakeIndexSequence<sizeof...(Args)>::Type()
-						);
-						it->clear();
-						
-						auto tempIt = it;
-						++it;
-						idleList.splice(idleList.end(), tempList, tempIt);
-					}
-					else {
-						++it;
-					}
-				}
+		for(auto & item : movedList) {
+			doAfterDequeue(item.get());
+		}
+		doReleaseItems(movedList, HasQueueCapacity());
+		other.doForceAdmitItems(movedList, HasQueueCapacity());
+		other.doAfterEnqueueList(movedList);
+
+		const bool restored = ! tempList.empty();
+		bool wasEmpty;
+		bool otherWasEmpty;
+		{
+			Mutex & firstMutex = (std::less<Mutex *>()(&queueListMutex, &other.queueListMutex) ? queueListMutex : other.queueListMutex);
+			Mutex & secondMutex = (&firstMutex == &queueListMutex ? other.queueListMutex : queueListMutex);
+			std::lock_guard<Mutex> firstLock(firstMutex);
+			std::lock_guard<Mutex> secondLock(secondMutex);
+			wasEmpty = queueList.empty();
+			queueList.splice(queueList.begin(), tempList);
+			otherWasEmpty = other.queueList.empty();
+			other.queueList.splice(other.queueList.end(), movedList);
+		}
+
+		// The notifier was cleared by doCollectEvents.
+		if(restored) {
+			doSignalNotifier(wasEmpty, HasQueueNotifier());
+		}
+
+		other.doSignalNotifier(otherWasEmpty, HasQueueNotifier());
+		other.doWakeAwaiters();
+		other.doSignalQueueSet();
+		other.doSignalWaitMonitor(HasWaitMonitor());
+		if(other.doCanProcess()) {
+			other.queueListConditionVariable.notify_one();
+		}
+
+		return true;
+	}
+
+	template <typename Maker>
+	void doEnqueueFrom(Maker && maker)
+	{
+		BufferedItemList tempList;
+		doAcquireItem(tempList);
+
+		auto it = tempList.begin();
+		it->setFrom(maker);
+		if(! doAdmitItem(tempList, HasQueueCapacity())) {
+			return;
+		}
+		doAfterEnqueue(it->get());
+		doPublishItem(tempList, it);
+	}
+
+	// OPT-53: The event is already counted by tryEnqueue or tryEnqueueFor.
+	template <typename ...A>
+	void doEnqueueAdmitted(A && ...args)
+	{
+		BufferedItemList tempList;
+		doAcquireItem(tempList);
+
+		auto it = tempList.begin();
+		it->setFrom([&]() {
+			return doMakeQueuedEvent(std::forward<A>(args)...);
+		});
+		doAfterEnqueue(it->get());
+		doPublishItem(tempList, it);
+
+		if(doCanProcess()) {
+			queueListConditionVariable.notify_one();
+		}
+	}
+
+	// Takes one empty node into tempList.
+	void doAcquireItem(BufferedItemList & tempList)
+	{
+		if(! freeList.empty()) {
+			// OPT-4: Use try_lock to avoid blocking on freeListMutex.
+			// If contended, skip recycling and allocate fresh — the item
+			// will be recycled later. This eliminates freeListMutex as a
+			// bottleneck on the enqueue hot path.
+			std::unique_lock<Mutex> lock(freeListMutex, std::try_to_lock);
+			if(lock.owns_lock() && ! freeList.empty()) {
+				tempList.splice(tempList.end(), freeList, freeList.begin());
+				doTakeFreeNodes(1, HasQueueCapacity());
+			}
+		}
+
+		if(tempList.empty()) {
+			tempList.emplace_back();
+		}
+	}
+
+	void doPublishItem(BufferedItemList & tempList, const typename BufferedItemList::iterator it)
+	{
+		bool wasEmpty;
+		{
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			wasEmpty = queueList.empty();
+			queueList.splice(queueList.end(), tempList, it);
+		}
+		doSignalNotifier(wasEmpty, HasQueueNotifier());
+		doWakeAwaiters();
+		doSignalQueueSet();
+		doSignalWaitMonitor(HasWaitMonitor());
+	}
+
+	// OPT-53: The events in itemList are destroyed, their nodes are given
+	// back and they are no longer counted.
+	void doRecycleItems(BufferedItemList & itemList)
+	{
+		doReleaseItems(itemList, HasQueueCapacity());
+		doRecycleNodes(itemList, HasQueueCapacity());
+	}
 
-				if (! tempList.empty()) {
-					std::lock_guard<Mutex> queueListLock(queueListMutex);
-					queueList.splice(queueList.begin(), tempList);
-				}
+	// The nodes in itemList hold no event.
+	void doRecycleNodes(BufferedItemList & itemList)
+	{
+		doRecycleNodes(itemList, HasQueueCapacity());
+	}
 
-				if(! idleList.empty()) {
-					std::lock_guard<Mutex> queueListLock(freeListMutex);
-					freeList.splice(freeList.end(), idleList);
-					
-					return true;
-				}
-			}
+	// OPT-67: The nodes go to the back of freeList and are taken from the
+	// front, so they are reused in the order they were queued, and the
+	// consecutive events tend to get the nodes which were adjacent.
+	void doRecycleNodes(BufferedItemList & itemList, std::false_type)
+	{
+		std::lock_guard<Mutex> freeListLock(freeListMutex);
+		freeList.splice(freeList.end(), itemList);
+	}
+
+	// The nodes over maxFreeCount are moved to spillList, which is destroyed
+	// after the lock is released.
+	void doRecycleNodes(BufferedItemList & itemList, std::true_type)
+	{
+		BufferedItemList spillList;
+		std::lock_guard<Mutex> freeListLock(freeListMutex);
+		const std::size_t maxFreeCount = capacityState.maxFreeCount.load(std::memory_order_relaxed);
+		while(! itemList.empty() && capacityState.freeCount < maxFreeCount) {
+			freeList.splice(freeList.end(), itemList, itemList.begin());
+			++capacityState.freeCount;
 		}
-		
-		return false;
+		spillList.splice(spillList.end(), itemList);
 	}
-	
-	template <typename Predictor>
-	bool processUntil(Predictor && predictor)
+
+	// freeListMutex must be locked.
+	void doTakeFreeNodes(const std::size_t /*count*/, std::false_type)
 	{
-		if(! queueList.empty()) {
-			BufferedItemList tempList;
-			BufferedItemList idleList;
+	}
 
-			// Use a counter to tell the queue list is not empty during processing
-			// even though queueList is swapped to empty.
-			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+	void doTakeFreeNodes(const std::size_t count, std::true_type)
+	{
+		capacityState.freeCount -= count;
+	}
 
-			{
-				std::lock_guard<Mutex> queueListLock(queueListMutex);
-				std::swap(queueList, tempList);
-			}
+	void doReleaseItems(BufferedItemList & /*itemList*/, std::false_type)
+	{
+	}
 
-			if(! tempList.empty()) {
-				for(auto it = tempList.begin(); it != tempList.end(); ) {
-					if(doInvokeFuncWithQueuedEvent(
-							predictor,
-							it->get(),
-							typename MakeIndexSequence<sizeof...(Args)>::Type())
-						) {
-						break;
-					}
-					else {
-						doDispatchQueuedEvent(
-							it->get(),
-							typename MakeIndexSequence<sizeof...(Args)>::Type()
-						);
-						it->clear();
-						
-						auto tempIt = it;
-						++it;
-						idleList.splice(idleList.end(), tempList, tempIt);
-					}
-				}
+	void doReleaseItems(BufferedItemList & itemList, std::true_type)
+	{
+		const std::size_t count = static_cast<std::size_t>(std::distance(itemList.begin(), itemList.end()));
+		if(count == 0) {
+			return;
+		}
 
-				if (! tempList.empty()) {
-					std::lock_guard<Mutex> queueListLock(queueListMutex);
-					queueList.splice(queueList.begin(), tempList);
-				}
+		const std::size_t eventCount = capacityState.eventCount.fetch_sub(count, std::memory_order_relaxed) - count;
+		if(eventCount <= capacityState.lowWatermark.load(std::memory_order_relaxed)
+			&& capacityState.aboveHighWatermark.load(std::memory_order_relaxed)) {
+			doCrossWatermark(false);
+		}
 
-				if(! idleList.empty()) {
-					std::lock_guard<Mutex> queueListLock(freeListMutex);
-					freeList.splice(freeList.end(), idleList);
-					
-					return true;
-				}
-			}
+		// Pairs with the fence in doAdmitEventUntil, either the producer sees
+		// the room or this sees the producer.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(capacityState.waitingProducerCount.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<Mutex> capacityLock(capacityState.mutex);
+			capacityState.notFullConditionVariable.notify_all();
 		}
-		
-		return false;
 	}
-	
-	void wait() const
+
+	// Counts one event if it fits, without the watermark.
+	bool doTryCountEvent()
 	{
-		std::unique_lock<Mutex> queueListLock(queueListMutex);
-		queueListConditionVariable.wait(queueListLock, [this]() -> bool {
-			return doCanProcess();
-		});
+		const std::size_t eventLimit = capacityState.eventLimit.load(std::memory_order_relaxed);
+		std::size_t eventCount = capacityState.eventCount.load(std::memory_order_relaxed);
+		do {
+			if(eventCount >= eventLimit) {
+				return false;
+			}
+		} while(! capacityState.eventCount.compare_exchange_weak(eventCount, eventCount + 1, std::memory_order_relaxed));
+		return true;
 	}
 
-	template <class Rep, class Period>
-	bool waitFor(const std::chrono::duration<Rep, Period> & duration) const
+	bool doTryAdmitEvent()
 	{
-		// OPT-8: Three-phase adaptive backoff: Spin -> Yield -> Sleep
-		// Phase 1: Fast check — avoid any synchronization overhead.
-		if(doCanProcess()) {
+		if(! doTryCountEvent()) {
+			return false;
+		}
+		doCheckHighWatermark();
+		return true;
+	}
+
+	// Waits until the event fits, or until deadline if it's not null.
+	bool doAdmitEventUntil(const TimerTimePoint * deadline)
+	{
+		if(doTryAdmitEvent()) {
 			return true;
 		}
 
-		// Phase 2: Spin with CPU hint (~0.5-2us).
-		// Cheapest wait: no syscall, no context switch.
-		for(int i = 0; i < 128; ++i) {
-			if(doCanProcess()) {
-				return true;
-			}
-#if defined(__aarch64__) || defined(__arm__)
-			__asm__ __volatile__("yield");
-#elif defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
-			__builtin_ia32_pause();
-#endif
+		const bool admitted = doWaitCapacityUntil(deadline, [this]() -> bool {
+			return doTryCountEvent();
+		});
+		// Not under the lock, the callback may set the limits.
+		if(admitted) {
+			doCheckHighWatermark();
 		}
+		return admitted;
+	}
 
-		// Phase 3: Yield time slice (~2-20us).
-		// Gives up CPU without sleeping — smoother than jumping to futex
-		// under high scheduling load.
-		for(int i = 0; i < 16; ++i) {
-			if(doCanProcess()) {
-				return true;
+	bool doWaitNotFullUntil(const TimerTimePoint * /*deadline*/, std::false_type)
+	{
+		return true;
+	}
+
+	bool doWaitNotFullUntil(const TimerTimePoint * deadline, std::true_type)
+	{
+		const auto notFull = [this]() -> bool {
+			return capacityState.eventCount.load(std::memory_order_relaxed)
+				< capacityState.eventLimit.load(std::memory_order_relaxed);
+		};
+		return notFull() || doWaitCapacityUntil(deadline, notFull);
+	}
+
+	// Waits until func returns true, or until deadline if it's not null.
+	// The consumers notify when they see a waiting producer.
+	template <typename F>
+	bool doWaitCapacityUntil(const TimerTimePoint * deadline, F && func)
+	{
+		bool result = false;
+		std::unique_lock<Mutex> capacityLock(capacityState.mutex);
+		capacityState.waitingProducerCount.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		for(;;) {
+			if(func()) {
+				result = true;
+				break;
+			}
+			if(deadline == nullptr) {
+				capacityState.notFullConditionVariable.wait(capacityLock);
+			}
+			else if(doWaitNotFullConditionUntil(capacityLock, *deadline, IsVirtualClock())) {
+				result = func();
+				break;
 			}
-			std::this_thread::yield();
 		}
+		capacityState.waitingProducerCount.fetch_sub(1, std::memory_order_relaxed);
+		return result;
+	}
 
-		// Phase 4: Fall back to CV wait (futex).
-		std::unique_lock<Mutex> queueListLock(queueListMutex);
-		return queueListConditionVariable.wait_for(queueListLock, duration, [this]() -> bool {
-			return doCanProcess();
-		});
+	// Returns true if it timed out.
+	bool doWaitNotFullConditionUntil(std::unique_lock<Mutex> & capacityLock, const TimerTimePoint & deadline, std::false_type)
+	{
+		return capacityState.notFullConditionVariable.wait_until(capacityLock, deadline) == std::cv_status::timeout;
 	}
 
-	using super::dispatch;
+	// OPT-81: The virtual clock doesn't move while the producer waits.
+	bool doWaitNotFullConditionUntil(std::unique_lock<Mutex> & /*capacityLock*/, const TimerTimePoint & deadline, std::true_type)
+	{
+		TimerClock::advanceTo(deadline);
+		return true;
+	}
 
-	template <typename U>
-	auto dispatch(const U & queuedEvent)
-		-> typename std::enable_if<std::is_same<U, QueuedEvent>::value, void>::type
+	void doForceAdmitEvents(const std::size_t /*count*/, std::false_type)
 	{
-		doDispatchQueuedEvent(
-			queuedEvent,
-			typename MakeIndexSequence<sizeof...(Args)>::Type()
-		);
 	}
 
-	bool peekEvent(QueuedEvent * queuedEvent)
+	void doForceAdmitEvents(const std::size_t count, std::true_type)
 	{
-		if(! queueList.empty()) {
-			std::lock_guard<Mutex> queueListLock(queueListMutex);
-			
-			if(! queueList.empty()) {
-				*queuedEvent = queueList.front().get();
-				return true;
-			}
-		}
+		capacityState.eventCount.fetch_add(count, std::memory_order_relaxed);
+		doCheckHighWatermark();
+	}
 
-		return false;
+	void doForceAdmitItems(BufferedItemList & /*itemList*/, std::false_type)
+	{
 	}
 
-	bool takeEvent(QueuedEvent * queuedEvent)
+	void doForceAdmitItems(BufferedItemList & itemList, std::true_type)
 	{
-		if(! queueList.empty()) {
-			BufferedItemList tempList;
+		doForceAdmitEvents(static_cast<std::size_t>(std::distance(itemList.begin(), itemList.end())), std::true_type());
+	}
 
-			{
-				std::lock_guard<Mutex> queueListLock(queueListMutex);
+	// The event in tempList is not in the queue yet. Returns false if it's
+	// dropped by QueueOverflow, its node is then given back.
+	bool doAdmitItem(BufferedItemList & /*tempList*/, std::false_type)
+	{
+		return true;
+	}
 
-				if(! queueList.empty()) {
-					tempList.splice(tempList.end(), queueList, queueList.begin());
-				}
-			}
+	bool doAdmitItem(BufferedItemList & tempList, std::true_type)
+	{
+		return doAdmitItem(tempList, QueueOverflow());
+	}
 
-			if(! tempList.empty()) {
-				*queuedEvent = std::move(tempList.front().get());
-				tempList.front().clear();
+	bool doAdmitItem(BufferedItemList & /*tempList*/, QueueOverflowBlock)
+	{
+		return doAdmitEventUntil(nullptr);
+	}
+
+	bool doAdmitItem(BufferedItemList & tempList, QueueOverflowDropNewest)
+	{
+		if(doTryAdmitEvent()) {
+			return true;
+		}
+		doDropItem(tempList);
+		return false;
+	}
 
-				std::lock_guard<Mutex> queueListLock(freeListMutex);
-				freeList.splice(freeList.end(), tempList);
+	bool doAdmitItem(BufferedItemList & tempList, QueueOverflowDropOldest)
+	{
+		if(doTryAdmitEvent()) {
+			return true;
+		}
 
-				return true;
+		BufferedItemList oldList;
+		{
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			if(! queueList.empty()) {
+				oldList.splice(oldList.end(), queueList, queueList.begin());
 			}
 		}
+		// All counted events are being processed, none can be dropped.
+		if(oldList.empty()) {
+			doDropItem(tempList);
+			return false;
+		}
 
-		return false;
+		// The new event takes the count of the oldest one.
+		doAfterDequeue(oldList.front().get());
+		doDropItem(oldList);
+		return true;
 	}
 
-protected:
-	bool doCanProcess() const
+	// The event in itemList is not counted.
+	void doDropItem(BufferedItemList & itemList)
 	{
-		return ! emptyQueue() && doCanNotifyQueueAvailable();
+		capacityState.droppedEventCount.fetch_add(1, std::memory_order_relaxed);
+		if(capacityState.overflowCallback) {
+			capacityState.overflowCallback(itemList.front().get());
+		}
+		itemList.front().clear();
+		doRecycleNodes(itemList);
 	}
 
-	bool doCanNotifyQueueAvailable() const
+	void doCheckHighWatermark()
 	{
-		return queueNotifyCounter.load(std::memory_order_acquire) == 0;
+		if(capacityState.eventCount.load(std::memory_order_relaxed) >= capacityState.highWatermark.load(std::memory_order_relaxed)
+			&& ! capacityState.aboveHighWatermark.load(std::memory_order_relaxed)) {
+			doCrossWatermark(true);
+		}
 	}
 
-	template <typename T, size_t ...Indexes>
-	void doDispatchQueuedEvent(T && item, IndexSequence<Indexes...>)
+	// The state is checked again under the lock, so the callback sees each
+	// transition once, in order.
+	void doCrossWatermark(const bool high)
 	{
-		this->directDispatch(item.event, std::get<Indexes>(item.arguments)...);
+		std::lock_guard<Mutex> watermarkLock(capacityState.watermarkMutex);
+		if(capacityState.aboveHighWatermark.load(std::memory_order_relaxed) == high) {
+			return;
+		}
+		const std::size_t eventCount = capacityState.eventCount.load(std::memory_order_relaxed);
+		if(high ? eventCount < capacityState.highWatermark.load(std::memory_order_relaxed)
+			: eventCount > capacityState.lowWatermark.load(std::memory_order_relaxed)) {
+			return;
+		}
+		capacityState.aboveHighWatermark.store(high, std::memory_order_relaxed);
+		if(capacityState.watermarkCallback) {
+			capacityState.watermarkCallback(high);
+		}
 	}
 
-	// OPT-15: Direct visitor dispatch -- bypasses directDispatch/map/CallbackList.
-	template <typename V, typename T, size_t ...Indexes>
-	void doVisitQueuedEvent(V && visitor, T && item, IndexSequence<Indexes...>)
+	void doSignalNotifier(const bool /*wasEmpty*/, std::false_type)
 	{
-		visitor(item.event, std::get<Indexes>(item.arguments)...);
 	}
 
-	template <typename F, typename T, size_t ...Indexes>
-	bool doInvokeFuncWithQueuedEvent(F && func, T && item, IndexSequence<Indexes...>) const
+	// OPT-30: Only the empty to non-empty transition is signaled, the
+	// following events are picked up by the same wakeup.
+	void doSignalNotifier(const bool wasEmpty, std::true_type)
 	{
-		return doInvokeFuncWithQueuedEventHelper(std::forward<F>(func), std::get<Indexes>(item.arguments)...);
+		if(wasEmpty && doCanNotifyQueueAvailable()) {
+			queueNotifier.signal();
+		}
 	}
-	
-	template <typename F>
-	auto doInvokeFuncWithQueuedEventHelper(F && func, Args ...args) const
-		-> typename std::enable_if<! CanInvoke<F>::value, bool>::type
+
+	void doClearNotifier(std::false_type)
 	{
-		return func(std::forward<Args>(args)...);
 	}
 
-	template <typename F>
-	auto doInvokeFuncWithQueuedEventHelper(F && func, Args .../*args*/) const
-		-> typename std::enable_if<CanInvoke<F>::value, bool>::type
+#if EVENTPP_HAS_COROUTINE
+	// The awaiter is linked under the queue list lock after the queue is
+	// seen empty, and an event is published under the same lock before
+	// awaiterCount is read, so either the awaiter sees the event or the
+	// publisher sees the awaiter.
+	void doWakeAwaiters()
 	{
-		return func();
+		if(awaiterCount.load(std::memory_order_relaxed) == 0 || ! doCanNotifyQueueAvailable()) {
+			return;
+		}
+
+		AwaiterBase * head = nullptr;
+		AwaiterBase * tail = nullptr;
+		{
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			while(awaiterHead != nullptr && ! queueList.empty()) {
+				AwaiterBase * awaiter = awaiterHead;
+				awaiterHead = awaiter->nextAwaiter;
+				awaiterCount.fetch_sub(1, std::memory_order_relaxed);
+				awaiter->linked = false;
+				awaiter->nextAwaiter = nullptr;
+				doMoveToAwaiter(awaiter);
+				if(tail == nullptr) {
+					head = awaiter;
+				}
+				else {
+					tail->nextAwaiter = awaiter;
+				}
+				tail = awaiter;
+			}
+			if(awaiterHead == nullptr) {
+				awaiterTail = nullptr;
+			}
+		}
+		doResumeAwaiters(head);
 	}
 
-	void doEnqueue(QueuedEvent && item)
+	static void doResumeAwaiters(AwaiterBase * awaiter)
 	{
-		BufferedItemList tempList;
-		if(! freeList.empty()) {
-			// OPT-4: Use try_lock to avoid blocking on freeListMutex.
-			// If contended, skip recycling and allocate fresh — the item
-			// will be recycled later. This eliminates freeListMutex as a
-			// bottleneck on the enqueue hot path.
-			std::unique_lock<Mutex> lock(freeListMutex, std::try_to_lock);
-			if(lock.owns_lock() && ! freeList.empty()) {
-				tempList.splice(tempList.end(), freeList, freeList.begin());
+		while(awaiter != nullptr) {
+			// The awaiter is gone once its coroutine is resumed.
+			AwaiterBase * next = awaiter->nextAwaiter;
+			awaiter->resumer.resume();
+			awaiter = next;
+		}
+	}
+
+	// queueListMutex must be locked.
+	void doMoveToAwaiter(AwaiterBase * awaiter)
+	{
+		for(size_t i = 0; i < awaiter->maxCount && ! queueList.empty(); ++i) {
+			awaiter->itemList.splice(awaiter->itemList.end(), queueList, queueList.begin());
+		}
+	}
+
+	bool doSuspendAwaiter(AwaiterBase * awaiter)
+	{
+		doCollectEvents();
+
+		std::lock_guard<Mutex> queueListLock(queueListMutex);
+		if(! queueList.empty() && doCanNotifyQueueAvailable()) {
+			doMoveToAwaiter(awaiter);
+			return false;
+		}
+		awaiter->linked = true;
+		if(awaiterTail == nullptr) {
+			awaiterHead = awaiter;
+		}
+		else {
+			awaiterTail->nextAwaiter = awaiter;
+		}
+		awaiterTail = awaiter;
+		awaiterCount.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	void doUnlinkAwaiter(AwaiterBase * awaiter)
+	{
+		std::lock_guard<Mutex> queueListLock(queueListMutex);
+		if(! awaiter->linked) {
+			return;
+		}
+		AwaiterBase * previous = nullptr;
+		for(AwaiterBase * a = awaiterHead; a != nullptr; previous = a, a = a->nextAwaiter) {
+			if(a == awaiter) {
+				(previous == nullptr ? awaiterHead : previous->nextAwaiter) = a->nextAwaiter;
+				if(awaiterTail == a) {
+					awaiterTail = previous;
+				}
+				awaiterCount.fetch_sub(1, std::memory_order_relaxed);
+				awaiter->linked = false;
+				break;
 			}
 		}
+	}
+#else
+	void doWakeAwaiters()
+	{
+	}
+#endif
 
-		if(tempList.empty()) {
-			tempList.emplace_back();
+	void doClearNotifier(std::true_type)
+	{
+		queueNotifier.clear();
+	}
+
+	// OPT-57: Only a queue in a QueueSet pays more than one relaxed load.
+	void doSignalQueueSet() const
+	{
+		if(queueSetSignal.load(std::memory_order_relaxed) == nullptr) {
+			return;
 		}
+		// The QueueSet retires the signal through the reclaimer.
+		EpochReclaimer::ReadGuard readGuard;
+		QueueSetSignal * signal = queueSetSignal.load(std::memory_order_acquire);
+		if(signal != nullptr) {
+			signal->signal();
+		}
+	}
 
-		auto it = tempList.begin();
-		it->set(std::move(item));
+	// The functions used by QueueSet.
+	void doAttachQueueSet(QueueSetSignal * signal)
+	{
+		assert(signal == nullptr || queueSetSignal.load(std::memory_order_relaxed) == nullptr);
+		queueSetSignal.store(signal, std::memory_order_release);
+	}
 
+	bool doIsReadyForQueueSet() const
+	{
 		std::lock_guard<Mutex> queueListLock(queueListMutex);
-		queueList.splice(queueList.end(), tempList, it);
+		return doCanProcess();
+	}
+
+	TimerTimePoint doGetNextDueTime(std::false_type) const
+	{
+		return (TimerTimePoint::max)();
+	}
+
+	TimerTimePoint doGetNextDueTime(std::true_type) const
+	{
+		const TimerTick nextTick = delayedEvents.nextTick.load(std::memory_order_acquire);
+		if(nextTick == DelayedEventWheel::noTick) {
+			return (TimerTimePoint::max)();
+		}
+		return doGetTimerTimePoint(nextTick);
 	}
 
+	friend class eventpp::QueueSet;
+
 private:
 	EVENTPP_ALIGN_CACHELINE mutable ConditionVariable queueListConditionVariable;
 	typename Threading::template Atomic<int> queueEmptyCounter;
@@ -643,6 +3698,25 @@ private:
 	BufferedItemList queueList;
 	EVENTPP_ALIGN_CACHELINE Mutex freeListMutex;
 	BufferedItemList freeList;
+	Mutex producerBufferMutex;
+	ProducerBuffer * producerBufferHead = nullptr;
+	typename Threading::template Atomic<int> producerBufferCount { 0 };
+	mutable typename std::conditional<HasTimer::value, DelayedEvents, NoDelayedEvents>::type delayedEvents;
+	typename std::conditional<HasQueueNotifier::value, FdNotifier<typename Threading::template Atomic<bool> >, NoQueueNotifier>::type queueNotifier;
+	mutable internal_::QueueWaitCore waitCore { WaitStrategy::spinCount };
+	typename std::conditional<HasQueueReply::value, ReplyNotifier, NoReplyNotifier>::type replyNotifier;
+	mutable typename std::conditional<HasQueueCapacity::value, CapacityState, NoCapacityState>::type capacityState;
+	typename std::conditional<HasQueueDeadline::value, DeadlineState, NoDeadlineState>::type deadlineState;
+#if EVENTPP_HAS_COROUTINE
+	// Guarded by queueListMutex, awaiterCount is read without it.
+	AwaiterBase * awaiterHead = nullptr;
+	AwaiterBase * awaiterTail = nullptr;
+	typename Threading::template Atomic<int> awaiterCount { 0 };
+#endif
+	std::atomic<QueueSetSignal *> queueSetSignal { nullptr };
+	mutable typename std::conditional<HasWaitMonitor::value, WaitMonitorWord, NoWaitMonitorWord>::type waitMonitor;
+	std::atomic<BatchHolder *> batchHolder { nullptr };
+	std::atomic<std::size_t> batchListenerCount { 0 };
 };
 
 } //namespace internal_
@@ -670,6 +3744,26 @@ public:
 
 } //namespace eventpp
 
+// OPT-84: Explicit instantiation of the process and wait functions of an
+// EventQueue type, so a type which is used in many translation units is
+// compiled once. Queue is the name of the EventQueue type, such as a type
+// alias, with no template arguments. EVENTPP_EXTERN_TEMPLATE_EVENTQUEUE is
+// put in the header which declares Queue, EVENTPP_INSTANTIATE_EVENTQUEUE in
+// one source file, both at namespace scope.
+// The compiler may still inline the functions, the other translation units
+// only don't emit their own copies.
+#define EVENTPP_EVENTQUEUE_MEMBERS_I_(prefix, Queue) \
+	prefix bool Queue::EventQueueBase::process(); \
+	prefix bool Queue::EventQueueBase::processOne(); \
+	prefix bool Queue::EventQueueBase::processN(const std::size_t); \
+	prefix bool Queue::EventQueueBase::processN(const std::size_t, std::size_t *); \
+	prefix void Queue::EventQueueBase::wait() const; \
+	prefix bool Queue::EventQueueBase::emptyQueue() const; \
+	prefix void Queue::EventQueueBase::clearEvents()
+
+#define EVENTPP_EXTERN_TEMPLATE_EVENTQUEUE(Queue) EVENTPP_EVENTQUEUE_MEMBERS_I_(extern template, Queue)
+#define EVENTPP_INSTANTIATE_EVENTQUEUE(Queue) EVENTPP_EVENTQUEUE_MEMBERS_I_(template, Queue)
+
 
 #endif
 
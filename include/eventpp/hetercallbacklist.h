@@ -17,13 +17,25 @@
 #include "internal/hetercallbacklist_i.h"
 #include "callbacklist.h"
 
-#include <array>
+#include <memory>
 #include <mutex>
+#include <tuple>
 
 namespace eventpp {
 
 namespace internal_ {
 
+// OPT-46: One CallbackList for each prototype, all in a tuple in the
+// HeterCallbackList, so they are made with it and next to each other.
+template <typename PrototypeList_, typename Policies_>
+struct HeterCallbackListStorage;
+
+template <typename ...Prototypes, typename Policies_>
+struct HeterCallbackListStorage <HeterTuple<Prototypes...>, Policies_>
+{
+	using Type = std::tuple<CallbackList<Prototypes, Policies_>...>;
+};
+
 template <
 	typename PrototypeList_,
 	typename Policies_
@@ -37,7 +49,7 @@ protected:
 		std::weak_ptr<void> homoHandle;
 
 		operator bool () const noexcept {
-			return (bool)homoHandle;
+			return ! homoHandle.expired();
 		}
 	};
 
@@ -45,45 +57,18 @@ protected:
 	{
 	};
 
-	class HomoCallbackListTypeBase
-	{
-	public:
-		virtual ~HomoCallbackListTypeBase() {}
-
-		virtual bool empty() = 0;
-		virtual bool doRemove(const HeterHandle_ & handle) = 0;
-		virtual std::shared_ptr<HomoCallbackListTypeBase> doClone() = 0;
-	};
-
-	template <typename T>
-	class HomoCallbackListType : public CallbackList<T, UnderlyingPoliciesType_>, public HomoCallbackListTypeBase
-	{
-	private:
-		using super = CallbackList<T, UnderlyingPoliciesType_>;
-
-	public:
-		virtual bool empty() override {
-			return super::empty();
-		}
-
-		virtual bool doRemove(const HeterHandle_ & handle) override {
-			auto sp = handle.homoHandle.lock();
-			if(! sp) {
-				return false;
-			}
-			return this->remove(typename super::Handle(std::static_pointer_cast<typename super::Handle::element_type>(sp)));
-		}
-
-		virtual std::shared_ptr<HomoCallbackListTypeBase> doClone() override {
-			return std::make_shared<HomoCallbackListType<T> >(*this);
-		}
-	};
-
 	using Policies = Policies_;
 	using Threading = typename SelectThreading<Policies, HasTypeThreading<Policies>::value>::Type;
 
 	using PrototypeList = PrototypeList_;
 
+	using CallbackListList = typename HeterCallbackListStorage<PrototypeList_, UnderlyingPoliciesType_>::Type;
+
+	enum { prototypeCount = HeterTupleSize<PrototypeList_>::value };
+
+	template <int index>
+	using HomoCallbackList = typename std::tuple_element<index, CallbackListList>::type;
+
 public:
 	using Handle = HeterHandle_;
 	using Mutex = typename Threading::Mutex;
@@ -91,27 +76,19 @@ public:
 public:
 	HeterCallbackListBase()
 		:
-			callbackListList(),
-			callbackListListMutex()
+			callbackListList()
 	{
 	}
 
 	HeterCallbackListBase(const HeterCallbackListBase & other)
 		:
-			callbackListList(),
-			callbackListListMutex()
+			callbackListList(other.callbackListList)
 	{
-		for(size_t i = 0; i < callbackListList.size(); ++i) {
-			if(other.callbackListList[i]) {
-				callbackListList[i] = other.callbackListList[i]->doClone();
-			}
-		}
 	}
 
 	HeterCallbackListBase(HeterCallbackListBase && other) noexcept
 		:
-			callbackListList(std::move(other.callbackListList)),
-			callbackListListMutex()
+			callbackListList(std::move(other.callbackListList))
 	{
 	}
 
@@ -129,28 +106,18 @@ public:
 	HeterCallbackListBase & operator = (HeterCallbackListBase && other) noexcept
 	{
 		if(this != &other) {
-			for(size_t i = 0; i < callbackListList.size(); ++i) {
-				callbackListList[i] = std::move(other.callbackListList[i]);
-			}
+			callbackListList = std::move(other.callbackListList);
 		}
 
 		return *this;
 	}
 
 	void swap(HeterCallbackListBase & other) noexcept {
-		using std::swap;
-
-		swap(callbackListList, other.callbackListList);
+		doSwap<0>(other);
 	}
 
 	bool empty() const {
-		for(const auto & callbackList : callbackListList) {
-			if(callbackList && ! callbackList->empty()) {
-				return false;
-			}
-		}
-
-		return true;
+		return doEmpty<0>();
 	}
 
 	operator bool() const {
@@ -163,10 +130,9 @@ public:
 		using PrototypeInfo = FindPrototypeByCallable<PrototypeList_, C>;
 		static_assert(PrototypeInfo::index >= 0, "Can't find invoker for the given argument types.");
 
-		auto callbackList= doGetCallbackList<PrototypeInfo>();
 		return Handle {
 			PrototypeInfo::index,
-			callbackList->append(callback)
+			doGetCallbackList<PrototypeInfo::index>().append(callback)
 		};
 	}
 
@@ -176,10 +142,9 @@ public:
 		using PrototypeInfo = FindPrototypeByCallable<PrototypeList_, C>;
 		static_assert(PrototypeInfo::index >= 0, "Can't find invoker for the given argument types.");
 
-		auto callbackList= doGetCallbackList<PrototypeInfo>();
 		return Handle {
 			PrototypeInfo::index,
-			callbackList->prepend(callback)
+			doGetCallbackList<PrototypeInfo::index>().prepend(callback)
 		};
 	}
 
@@ -189,34 +154,27 @@ public:
 		using PrototypeInfo = FindPrototypeByCallable<PrototypeList_, C>;
 		static_assert(PrototypeInfo::index >= 0, "Can't find invoker for the given argument types.");
 
-		auto callbackList= doGetCallbackList<PrototypeInfo>();
+		auto & callbackList = doGetCallbackList<PrototypeInfo::index>();
 
 		if(before.index != PrototypeInfo::index) {
 			return Handle {
 				PrototypeInfo::index,
-				callbackList->append(callback)
+				callbackList.append(callback)
 			};
 		}
 
-		using UnderlyingHandle = typename decltype(callbackList)::element_type::Handle;
-
 		return Handle {
 			PrototypeInfo::index,
-			callbackList->insert(
+			callbackList.insert(
 				callback,
-				UnderlyingHandle(std::static_pointer_cast<typename UnderlyingHandle::element_type>(before.homoHandle.lock()))
+				doGetUnderlyingHandle<PrototypeInfo::index>(before)
 			)
 		};
 	}
 
 	bool remove(const Handle & handle)
 	{
-		auto callbackList = callbackListList[handle.index];
-		if(callbackList) {
-			return callbackList->doRemove(handle);
-		}
-
-		return false;
+		return doRemove<0>(handle);
 	}
 
 	template <typename Prototype, typename Func>
@@ -225,9 +183,8 @@ public:
 		using PrototypeInfo = FindPrototypeByCallable<PrototypeList, Prototype>;
 		static_assert(PrototypeInfo::index >= 0, "Can't find invoker for the given argument types.");
 
-		auto callbackList= doGetCallbackList<PrototypeInfo>();
-		using CL = typename decltype(callbackList)::element_type;
-		callbackList->forEach([this, &func](const typename CL::Handle & handle, const typename CL::Callback & callback) {
+		using CL = HomoCallbackList<PrototypeInfo::index>;
+		doGetCallbackList<PrototypeInfo::index>().forEach([this, &func](const typename CL::Handle & handle, const typename CL::Callback & callback) {
 			doForEachInvoke<void, PrototypeInfo::index>(func, handle, callback);
 		});
 	}
@@ -238,21 +195,21 @@ public:
 		using PrototypeInfo = FindPrototypeByCallable<PrototypeList, Prototype>;
 		static_assert(PrototypeInfo::index >= 0, "Can't find invoker for the given argument types.");
 
-		auto callbackList= doGetCallbackList<PrototypeInfo>();
-		using CL = typename decltype(callbackList)::element_type;
-		return callbackList->forEachIf([this, &func](const typename CL::Handle & handle, const typename CL::Callback & callback) {
+		using CL = HomoCallbackList<PrototypeInfo::index>;
+		return doGetCallbackList<PrototypeInfo::index>().forEachIf([this, &func](const typename CL::Handle & handle, const typename CL::Callback & callback) {
 			return doForEachInvoke<bool, PrototypeInfo::index>(func, handle, callback);
 		});
 	}
 
+	// The prototype is found at compile time, the call goes straight to its
+	// CallbackList.
 	template <typename ...Args>
 	void operator() (Args && ...args) const
 	{
 		using PrototypeInfo = FindPrototypeByArgs<PrototypeList, Args...>;
 		static_assert(PrototypeInfo::index >= 0, "Can't find invoker for the given argument types.");
 
-		auto callbackList= doGetCallbackList<PrototypeInfo>();
-		(*callbackList)(std::forward<Args>(args)...);
+		doGetCallbackList<PrototypeInfo::index>()(std::forward<Args>(args)...);
 	}
 
 private:
@@ -270,27 +227,78 @@ private:
 		return func(callback);
 	}
 
-	template <typename PrototypeInfo>
-	auto doGetCallbackList() const
-		-> std::shared_ptr<HomoCallbackListType<typename PrototypeInfo::Prototype> >
+	template <int index>
+	HomoCallbackList<index> & doGetCallbackList()
 	{
-		static_assert(PrototypeInfo::index >= 0, "Can't find invoker for the given argument types.");
+		return std::get<index>(callbackListList);
+	}
+
+	template <int index>
+	const HomoCallbackList<index> & doGetCallbackList() const
+	{
+		return std::get<index>(callbackListList);
+	}
 
-		if(! callbackListList[PrototypeInfo::index]) {
-			std::lock_guard<Mutex> lockGuard(callbackListListMutex);
+	template <int index>
+	static typename HomoCallbackList<index>::Handle doGetUnderlyingHandle(const Handle & handle)
+	{
+		using UnderlyingHandle = typename HomoCallbackList<index>::Handle;
+		return UnderlyingHandle(std::static_pointer_cast<typename UnderlyingHandle::element_type>(handle.homoHandle.lock()));
+	}
 
-			if(! callbackListList[PrototypeInfo::index]) {
-				callbackListList[PrototypeInfo::index] = std::make_shared<HomoCallbackListType<typename PrototypeInfo::Prototype> >();
-			}
+	// The index of a handle is only known at run time, these go through the
+	// prototypes to find it.
+	template <int index>
+	auto doRemove(const Handle & handle)
+		-> typename std::enable_if<(index < prototypeCount), bool>::type
+	{
+		if(handle.index != index) {
+			return doRemove<index + 1>(handle);
+		}
+		if(handle.homoHandle.expired()) {
+			return false;
 		}
+		return doGetCallbackList<index>().remove(doGetUnderlyingHandle<index>(handle));
+	}
 
-		return std::static_pointer_cast<HomoCallbackListType<typename PrototypeInfo::Prototype> >(callbackListList[PrototypeInfo::index]);
+	template <int index>
+	auto doRemove(const Handle & /*handle*/)
+		-> typename std::enable_if<(index >= prototypeCount), bool>::type
+	{
+		return false;
+	}
+
+	template <int index>
+	auto doEmpty() const
+		-> typename std::enable_if<(index < prototypeCount), bool>::type
+	{
+		return doGetCallbackList<index>().empty() && doEmpty<index + 1>();
+	}
+
+	template <int index>
+	auto doEmpty() const
+		-> typename std::enable_if<(index >= prototypeCount), bool>::type
+	{
+		return true;
+	}
+
+	template <int index>
+	auto doSwap(HeterCallbackListBase & other) noexcept
+		-> typename std::enable_if<(index < prototypeCount)>::type
+	{
+		doGetCallbackList<index>().swap(other.doGetCallbackList<index>());
+		doSwap<index + 1>(other);
+	}
+
+	template <int index>
+	auto doSwap(HeterCallbackListBase & /*other*/) noexcept
+		-> typename std::enable_if<(index >= prototypeCount)>::type
+	{
 	}
 
 private:
 	// the postfix 'ListList' is not good, but it's better to use consistent naming convention.
-	mutable std::array<std::shared_ptr<HomoCallbackListTypeBase>, HeterTupleSize<PrototypeList_>::value> callbackListList;
-	mutable Mutex callbackListListMutex;
+	CallbackListList callbackListList;
 };
 
 
@@ -15,6 +15,7 @@
 #define HETEREVENTDISPATCHER_H_127766658555
 
 #include "mixins/mixinheterfilter.h"
+#include "internal/eventconstant_i.h"
 
 namespace eventpp {
 
@@ -78,33 +79,40 @@ public:
 	HeterEventDispatcherBase()
 		:
 		eventCallbackListMap(),
-		listenerMutex()
+		listenerMutex(),
+		dispatcherId(getNextDispatcherId())
 	{
 	}
 
 	HeterEventDispatcherBase(const HeterEventDispatcherBase & other)
 		:
 		eventCallbackListMap(other.eventCallbackListMap),
-		listenerMutex()
+		listenerMutex(),
+		dispatcherId(getNextDispatcherId())
 	{
 	}
 
 	HeterEventDispatcherBase(HeterEventDispatcherBase && other) noexcept
 		:
 		eventCallbackListMap(std::move(other.eventCallbackListMap)),
-		listenerMutex()
+		listenerMutex(),
+		dispatcherId(getNextDispatcherId())
 	{
+		other.dispatcherId = getNextDispatcherId();
 	}
 
 	HeterEventDispatcherBase & operator = (const HeterEventDispatcherBase & other)
 	{
 		eventCallbackListMap = other.eventCallbackListMap;
+		dispatcherId = getNextDispatcherId();
 		return *this;
 	}
 
 	HeterEventDispatcherBase & operator = (HeterEventDispatcherBase && other) noexcept
 	{
 		eventCallbackListMap = std::move(other.eventCallbackListMap);
+		dispatcherId = getNextDispatcherId();
+		other.dispatcherId = getNextDispatcherId();
 		return *this;
 	}
 
@@ -112,6 +120,8 @@ public:
 		using std::swap;
 
 		swap(eventCallbackListMap, other.eventCallbackListMap);
+		dispatcherId = getNextDispatcherId();
+		other.dispatcherId = getNextDispatcherId();
 	}
 
 	template <typename C>
@@ -184,6 +194,25 @@ public:
 		doDispatch<ArgumentPassingMode>(std::forward<T>(first), std::forward<Args>(args)...);
 	}
 
+	// OPT-72: The event is EventConstant::value, known at compile time, and
+	// its CallbackList is cached for the calling thread when it's found, as
+	// EventDispatcher::dispatch<EventConstant>. The prototype is found from
+	// the arguments at compile time by HeterCallbackList.
+	// OPT-79: With TypeId events, EventConstant is the type of the event.
+	template <typename EventConstant, typename ...Args>
+	void dispatch(Args && ...args) const
+	{
+		if(! internal_::ForEachMixins<MixinRoot, Mixins, DoMixinBeforeDispatch>::forEach(
+			this, typename std::add_lvalue_reference<Args>::type(args)...)) {
+			return;
+		}
+
+		const CallbackList_ * callableList = doFindConstantCallableList<EventConstant>();
+		if(callableList) {
+			(*callableList)(std::forward<Args>(args)...);
+		}
+	}
+
 	// Bypass any getEvent policy. The first argument is the event type.
 	// Most used for internal purpose.
 	template <typename ...Args>
@@ -250,6 +279,21 @@ protected:
 		return doFindCallableListHelper(this, e);
 	}
 
+	template <typename EventConstant>
+	const CallbackList_ * doFindConstantCallableList() const
+	{
+		EventConstantCache<CallbackList_> & cache = getEventConstantCache<ThisType, EventConstant, CallbackList_>();
+		if(cache.dispatcherId == dispatcherId) {
+			return cache.callbackList;
+		}
+		const CallbackList_ * callableList = doFindCallableList(EventConstantValue<Event, EventConstant>::get());
+		if(callableList != nullptr) {
+			cache.dispatcherId = dispatcherId;
+			cache.callbackList = callableList;
+		}
+		return callableList;
+	}
+
 private:
 	// template helper to avoid code duplication in doFindCallableList
 	template <typename T>
@@ -289,6 +333,7 @@ private:
 private:
 	Map eventCallbackListMap;
 	mutable SharedMutex listenerMutex;
+	std::uint64_t dispatcherId;
 };
 
 } //namespace internal_
@@ -18,6 +18,7 @@
 
 // temp, should move the internal code in eventqueue to separated file
 #include "eventqueue.h"
+#include "internal/spinwait_i.h"
 
 namespace eventpp {
 
@@ -55,26 +56,25 @@ private:
 	using Threading = typename super::Threading;
 	using ConditionVariable = typename Threading::ConditionVariable;
 
-	struct QueuedItemBase;
-	using ItemDispatcher = void (*)(const HeterEventQueueBase *, const QueuedItemBase &);
-
+	// The type of an item is given by callableIndex, so the item doesn't
+	// store any function pointer. The functions are looked up in a table
+	// indexed by callableIndex.
 	struct QueuedItemBase
 	{
-		QueuedItemBase(const int callableIndex, const EventType_ & event, const ItemDispatcher dispatcher)
-			: callableIndex(callableIndex), event(event), dispatcher(dispatcher)
+		QueuedItemBase(const int callableIndex, const EventType_ & event)
+			: callableIndex(callableIndex), event(event)
 		{
 		}
 
 		int callableIndex;
 		EventType_ event;
-		ItemDispatcher dispatcher;
 	};
 
 	template <typename T>
 	struct QueuedItem : public QueuedItemBase
 	{
-		QueuedItem(const int callableIndex, const EventType_ & event, const ItemDispatcher dispatcher, T && arguments)
-			: QueuedItemBase(callableIndex, event, dispatcher), arguments(std::move(arguments))
+		QueuedItem(const int callableIndex, const EventType_ & event, T && arguments)
+			: QueuedItemBase(callableIndex, event), arguments(std::move(arguments))
 		{
 		}
 
@@ -84,9 +84,430 @@ private:
 	template <typename ...Args>
 	using QueuedItemSizer = QueuedItem<std::tuple<typename std::remove_cv<typename std::remove_reference<Args>::type>::type...> >;
 
+	template <int index>
+	using QueuedItemOfIndex = QueuedItem<
+		typename GetPrototypeArgsTuple<typename FindPrototypeByIndex<PrototypeList_, index>::Prototype>::Type
+	>;
+
+	using ItemDispatcher = void (*)(const HeterEventQueueBase *, const QueuedItemBase &);
+
+	struct ItemFunctions
+	{
+		ItemDispatcher dispatch;
+		std::size_t size;
+		RelocateFunc relocate;
+		DtorFunc destroy;
+	};
+
+	struct PackedItemTraits
+	{
+		static std::size_t getSize(const void * item) {
+			return doGetItemFunctions(item).size;
+		}
+
+		static void relocate(void * from, void * to) {
+			doGetItemFunctions(from).relocate(from, to);
+		}
+
+		static void destroy(void * item) {
+			doGetItemFunctions(item).destroy(item);
+		}
+
+	private:
+		static const ItemFunctions & doGetItemFunctions(const void * item) {
+			return getItemFunctions(static_cast<const QueuedItemBase *>(item)->callableIndex);
+		}
+	};
+
 	using BufferedQueuedItem = BufferedUnion<GetCallablePrototypeMaxSize<PrototypeList_, QueuedItemSizer>::value>;
 
-	using BufferedItemList = std::list<BufferedQueuedItem>;
+	using BufferedItemList = typename SelectQueueList<
+		BufferedQueuedItem,
+		Policies_,
+		HasTemplateQueueList<Policies_>::value
+	>::Type;
+
+	using Mutex_ = typename super::Mutex;
+
+	// The visitors passed to the storages take a QueuedItemBase &.
+	// processIf visitor returns true if the item was dispatched and is removed.
+
+	// One list node per item, the nodes are recycled through a free list.
+	class ListStorage
+	{
+	public:
+		ListStorage() : queueListMutex(), queueList(), freeListMutex(), freeList()
+		{
+		}
+
+		Mutex_ & getMutex() const {
+			return queueListMutex;
+		}
+
+		bool empty() const {
+			return queueList.empty();
+		}
+
+		template <typename T>
+		void push(T && item)
+		{
+			BufferedItemList tempList;
+			if(! freeList.empty()) {
+				// OPT-4: Same as EventQueue::doAcquireItem, if freeListMutex is
+				// contended, a new node is allocated instead of waiting.
+				std::unique_lock<Mutex_> freeListLock(freeListMutex, std::try_to_lock);
+				if(freeListLock.owns_lock() && ! freeList.empty()) {
+					tempList.splice(tempList.end(), freeList, freeList.begin());
+				}
+			}
+
+			if(tempList.empty()) {
+				tempList.emplace_back();
+			}
+
+			auto it = tempList.begin();
+			it->set(std::move(item));
+
+			std::lock_guard<Mutex_> queueListLock(queueListMutex);
+			queueList.splice(queueList.end(), tempList, it);
+		}
+
+		// maker(index) returns the item for index in [0, count).
+		template <typename Maker>
+		void pushBulk(const size_t count, Maker && maker)
+		{
+			BufferedItemList tempList;
+			doAcquireItems(tempList, count);
+
+			size_t index = 0;
+			for(auto & item : tempList) {
+				item.set(maker(index));
+				++index;
+			}
+
+			if(! tempList.empty()) {
+				std::lock_guard<Mutex_> queueListLock(queueListMutex);
+				queueList.splice(queueList.end(), tempList);
+			}
+		}
+
+		void clear()
+		{
+			BufferedItemList tempList;
+
+			{
+				std::lock_guard<Mutex_> queueListLock(queueListMutex);
+				std::swap(queueList, tempList);
+			}
+
+			if(! tempList.empty()) {
+				for(auto & item : tempList) {
+					item.clear();
+				}
+
+				doRecycle(tempList);
+			}
+		}
+
+		template <typename F>
+		bool processAll(F && visit)
+		{
+			BufferedItemList tempList;
+
+			{
+				std::lock_guard<Mutex_> queueListLock(queueListMutex);
+				std::swap(queueList, tempList);
+			}
+
+			if(! tempList.empty()) {
+				for(auto & item : tempList) {
+					visit(item.template get<QueuedItemBase>());
+					item.clear();
+				}
+
+				doRecycle(tempList);
+
+				return true;
+			}
+
+			return false;
+		}
+
+		template <typename F>
+		bool processOne(F && visit)
+		{
+			BufferedItemList tempList;
+
+			{
+				std::lock_guard<Mutex_> queueListLock(queueListMutex);
+				if(! queueList.empty()) {
+					tempList.splice(tempList.end(), queueList, queueList.begin());
+				}
+			}
+
+			if(! tempList.empty()) {
+				auto & item = tempList.front();
+				visit(item.template get<QueuedItemBase>());
+				item.clear();
+
+				doRecycle(tempList);
+
+				return true;
+			}
+
+			return false;
+		}
+
+		template <typename F>
+		bool processIf(F && visit)
+		{
+			BufferedItemList tempList;
+			BufferedItemList idleList;
+
+			{
+				std::lock_guard<Mutex_> queueListLock(queueListMutex);
+				std::swap(queueList, tempList);
+			}
+
+			if(! tempList.empty()) {
+				for(auto it = tempList.begin(); it != tempList.end(); ) {
+					if(visit(it->template get<QueuedItemBase>())) {
+						it->clear();
+
+						auto tempIt = it;
+						++it;
+						idleList.splice(idleList.end(), tempList, tempIt);
+					}
+					else {
+						++it;
+					}
+				}
+
+				if(! tempList.empty()) {
+					std::lock_guard<Mutex_> queueListLock(queueListMutex);
+					queueList.splice(queueList.begin(), tempList);
+				}
+
+				if(! idleList.empty()) {
+					doRecycle(idleList);
+
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+	private:
+		// Same as EventQueue::doAcquireItems.
+		void doAcquireItems(BufferedItemList & tempList, const size_t count)
+		{
+			size_t acquired = 0;
+			if(count > 0 && ! freeList.empty()) {
+				std::lock_guard<Mutex_> queueListLock(freeListMutex);
+				while(acquired < count && ! freeList.empty()) {
+					tempList.splice(tempList.end(), freeList, freeList.begin());
+					++acquired;
+				}
+			}
+
+			for(; acquired < count; ++acquired) {
+				tempList.emplace_back();
+			}
+		}
+
+		void doRecycle(BufferedItemList & tempList)
+		{
+			std::lock_guard<Mutex_> queueListLock(freeListMutex);
+			freeList.splice(freeList.end(), tempList);
+		}
+
+	private:
+		// OPT-10: The producers and the consumer contend on the two mutexes,
+		// they are in their own cache lines.
+		EVENTPP_ALIGN_CACHELINE mutable Mutex_ queueListMutex;
+		BufferedItemList queueList;
+		EVENTPP_ALIGN_CACHELINE Mutex_ freeListMutex;
+		BufferedItemList freeList;
+	};
+
+	// OPT-26: The items are packed in a contiguous buffer, each item takes
+	// its exact size. process swaps the buffer with a spare one, so the
+	// producers and the consumer reuse two buffers and don't allocate once
+	// the buffers have grown.
+	class PackedStorage
+	{
+	private:
+		using Buffer = PackedItemBuffer<PackedItemTraits>;
+
+	public:
+		PackedStorage() : queueListMutex(), queueBuffer(), spareMutex(), spareBuffer()
+		{
+		}
+
+		Mutex_ & getMutex() const {
+			return queueListMutex;
+		}
+
+		bool empty() const {
+			return queueBuffer.empty();
+		}
+
+		template <typename T>
+		void push(T && item)
+		{
+			std::lock_guard<Mutex_> queueListLock(queueListMutex);
+			queueBuffer.push(std::forward<T>(item));
+		}
+
+		// The items are made in a spare buffer without holding the lock,
+		// then moved to the queue at once.
+		template <typename Maker>
+		void pushBulk(const size_t count, Maker && maker)
+		{
+			if(count == 0) {
+				return;
+			}
+
+			Buffer tempBuffer;
+			doTakeSpare(tempBuffer);
+
+			for(size_t index = 0; index < count; ++index) {
+				tempBuffer.push(maker(index));
+			}
+
+			{
+				std::lock_guard<Mutex_> queueListLock(queueListMutex);
+				tempBuffer.moveAllTo(queueBuffer);
+			}
+
+			doReturnSpare(tempBuffer);
+		}
+
+		void clear()
+		{
+			Buffer tempBuffer;
+			doTakeSpare(tempBuffer);
+
+			{
+				std::lock_guard<Mutex_> queueListLock(queueListMutex);
+				queueBuffer.swap(tempBuffer);
+			}
+
+			tempBuffer.clear();
+			doReturnSpare(tempBuffer);
+		}
+
+		template <typename F>
+		bool processAll(F && visit)
+		{
+			Buffer tempBuffer;
+			doTakeSpare(tempBuffer);
+
+			{
+				std::lock_guard<Mutex_> queueListLock(queueListMutex);
+				queueBuffer.swap(tempBuffer);
+			}
+
+			const bool processed = ! tempBuffer.empty();
+			tempBuffer.consume([&visit](void * item) {
+				visit(*static_cast<QueuedItemBase *>(item));
+			});
+
+			doReturnSpare(tempBuffer);
+
+			return processed;
+		}
+
+		template <typename F>
+		bool processOne(F && visit)
+		{
+			Buffer tempBuffer;
+			doTakeSpare(tempBuffer);
+
+			{
+				std::lock_guard<Mutex_> queueListLock(queueListMutex);
+				if(! queueBuffer.empty()) {
+					queueBuffer.moveFrontTo(tempBuffer);
+				}
+			}
+
+			const bool processed = ! tempBuffer.empty();
+			tempBuffer.consume([&visit](void * item) {
+				visit(*static_cast<QueuedItemBase *>(item));
+			});
+
+			doReturnSpare(tempBuffer);
+
+			return processed;
+		}
+
+		template <typename F>
+		bool processIf(F && visit)
+		{
+			Buffer tempBuffer;
+			doTakeSpare(tempBuffer);
+
+			{
+				std::lock_guard<Mutex_> queueListLock(queueListMutex);
+				queueBuffer.swap(tempBuffer);
+			}
+
+			bool processed = false;
+			Buffer remainingBuffer;
+			tempBuffer.extractIf([&visit, &processed](void * item) -> bool {
+				if(visit(*static_cast<QueuedItemBase *>(item))) {
+					processed = true;
+					return true;
+				}
+				return false;
+			}, remainingBuffer);
+
+			if(! remainingBuffer.empty()) {
+				// The remaining items go before the items enqueued during processing.
+				std::lock_guard<Mutex_> queueListLock(queueListMutex);
+				queueBuffer.moveAllTo(remainingBuffer);
+				queueBuffer.swap(remainingBuffer);
+			}
+
+			doReturnSpare(tempBuffer);
+
+			return processed;
+		}
+
+	private:
+		void doTakeSpare(Buffer & buffer)
+		{
+			std::lock_guard<Mutex_> spareLock(spareMutex);
+			buffer.swap(spareBuffer);
+		}
+
+		// Keeps the larger buffer as the spare one.
+		void doReturnSpare(Buffer & buffer)
+		{
+			std::lock_guard<Mutex_> spareLock(spareMutex);
+			if(buffer.getCapacity() > spareBuffer.getCapacity()) {
+				buffer.swap(spareBuffer);
+			}
+		}
+
+	private:
+		// OPT-10: Same as ListStorage.
+		EVENTPP_ALIGN_CACHELINE mutable Mutex_ queueListMutex;
+		Buffer queueBuffer;
+		EVENTPP_ALIGN_CACHELINE Mutex_ spareMutex;
+		Buffer spareBuffer;
+	};
+
+	using QueueStorage = typename SelectQueueStorage<
+		Policies_, HasTypeQueueStorage<Policies_>::value
+	>::Type;
+
+	using Storage = typename std::conditional<
+		std::is_same<QueueStorage, QueueStoragePacked>::value,
+		PackedStorage,
+		ListStorage
+	>::type;
 
 	using PrototypeList = typename super::PrototypeList;
 
@@ -104,10 +525,7 @@ public:
 		queueListConditionVariable(),
 		queueEmptyCounter(0),
 		queueNotifyCounter(0),
-		queueListMutex(),
-		queueList(),
-		freeListMutex(),
-		freeList()
+		storage()
 	{
 	}
 
@@ -136,60 +554,58 @@ public:
 	template <typename T, typename ...Args>
 	void enqueue(T && first, Args && ...args)
 	{
-		doEnqueue<ArgumentPassingMode>(std::forward<T>(first), std::forward<Args>(args)...);
+		storage.push(doMakeQueuedItem<ArgumentPassingMode>(std::forward<T>(first), std::forward<Args>(args)...));
+
+		if(doCanProcess()) {
+			queueListConditionVariable.notify_one();
+		}
 	}
 
-	bool emptyQueue() const
+	// Same as EventQueue::enqueueBulk. Each element is the arguments of enqueue,
+	// a std::tuple element is expanded to the arguments, any other element is
+	// the only argument. Iterator must be a forward iterator.
+	template <typename Iterator>
+	void enqueueBulk(Iterator first, const Iterator last)
 	{
-		return queueList.empty() && (queueEmptyCounter.load(std::memory_order_acquire) == 0);
+		const size_t count = static_cast<size_t>(std::distance(first, last));
+		doEnqueueBulk(count, [this, &first](const size_t /*index*/) {
+			auto item = doMakeBulkQueuedItem(*first);
+			++first;
+			return item;
+		});
 	}
 
-	void clearEvents()
+	// generator is invoked as generator(index) for index in [0, count).
+	template <typename Generator>
+	void enqueueBulk(const size_t count, Generator && generator)
 	{
-		if(! queueList.empty()) {
-			BufferedItemList tempList;
-
-			{
-				std::lock_guard<Mutex> queueListLock(queueListMutex);
-				std::swap(queueList, tempList);
-			}
+		doEnqueueBulk(count, [this, &generator](const size_t index) {
+			return doMakeBulkQueuedItem(generator(index));
+		});
+	}
 
-			if(! tempList.empty()) {
-				for(auto & item : tempList) {
-					item.clear();
-				}
+	bool emptyQueue() const
+	{
+		return storage.empty() && (queueEmptyCounter.load(std::memory_order_acquire) == 0);
+	}
 
-				std::lock_guard<Mutex> queueListLock(freeListMutex);
-				freeList.splice(freeList.end(), tempList);
-			}
+	void clearEvents()
+	{
+		if(! storage.empty()) {
+			storage.clear();
 		}
 	}
 
 	bool process()
 	{
-		if(! queueList.empty()) {
-			BufferedItemList tempList;
-
+		if(! storage.empty()) {
 			// Use a counter to tell the queue list is not empty during processing
 			// even though queueList is swapped to empty.
 			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
 
-			{
-				std::lock_guard<Mutex> queueListLock(queueListMutex);
-				std::swap(queueList, tempList);
-			}
-
-			if(! tempList.empty()) {
-				for(auto & item : tempList) {
-					doDispatchQueuedEvent(item.template get<QueuedItemBase>());
-					item.clear();
-				}
-
-				std::lock_guard<Mutex> queueListLock(freeListMutex);
-				freeList.splice(freeList.end(), tempList);
-
-				return true;
-			}
+			return storage.processAll([this](const QueuedItemBase & item) {
+				doDispatchQueuedEvent(item);
+			});
 		}
 
 		return false;
@@ -197,30 +613,49 @@ public:
 
 	bool processOne()
 	{
-		if(! queueList.empty()) {
-			BufferedItemList tempList;
-
+		if(! storage.empty()) {
 			// Use a counter to tell the queue list is not empty during processing
 			// even though queueList is swapped to empty.
 			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
 
-			{
-				std::lock_guard<Mutex> queueListLock(queueListMutex);
-				if(! queueList.empty()) {
-					tempList.splice(tempList.end(), queueList, queueList.begin());
-				}
-			}
+			return storage.processOne([this](const QueuedItemBase & item) {
+				doDispatchQueuedEvent(item);
+			});
+		}
 
-			if(! tempList.empty()) {
-				auto & item = tempList.front();
-				doDispatchQueuedEvent(item.template get<QueuedItemBase>());
-				item.clear();
+		return false;
+	}
 
-				std::lock_guard<Mutex> queueListLock(freeListMutex);
-				freeList.splice(freeList.end(), tempList);
+	// OPT-15: Same as EventQueue::processQueueWith, visitor(event, args...)
+	// is called instead of dispatching to the listeners. The arguments have
+	// the types of the prototype the event is enqueued with, so visitor must
+	// be callable with the arguments of each prototype, such as a generic
+	// lambda. The prototype is found by the index in the item, there is no
+	// map lookup or std::function call.
+	template <typename Visitor>
+	bool processQueueWith(Visitor && visitor)
+	{
+		if(! storage.empty()) {
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
 
-				return true;
-			}
+			return storage.processAll([&visitor](const QueuedItemBase & item) {
+				doVisitItem(visitor, item, std::integral_constant<int, 0>());
+			});
+		}
+
+		return false;
+	}
+
+	// OPT-15: Single-event variant of processQueueWith.
+	template <typename Visitor>
+	bool processOneWith(Visitor && visitor)
+	{
+		if(! storage.empty()) {
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+			return storage.processOne([&visitor](const QueuedItemBase & item) {
+				doVisitItem(visitor, item, std::integral_constant<int, 0>());
+			});
 		}
 
 		return false;
@@ -229,7 +664,7 @@ public:
 	template <typename F>
 	bool processIf(F && func)
 	{
-		if(queueList.empty()) {
+		if(storage.empty()) {
 			return false;
 		}
 
@@ -239,7 +674,7 @@ public:
 
 	void wait() const
 	{
-		std::unique_lock<Mutex> queueListLock(queueListMutex);
+		std::unique_lock<Mutex> queueListLock(storage.getMutex());
 		queueListConditionVariable.wait(queueListLock, [this]() -> bool {
 			return doCanProcess();
 		});
@@ -248,7 +683,18 @@ public:
 	template <class Rep, class Period>
 	bool waitFor(const std::chrono::duration<Rep, Period> & duration) const
 	{
-		std::unique_lock<Mutex> queueListLock(queueListMutex);
+		// OPT-8: Spin -> Yield -> Sleep, same as EventQueue::waitFor.
+		if(doCanProcess()) {
+			return true;
+		}
+
+		if(internal_::spinThenYield([this]() -> bool {
+			return doCanProcess();
+		})) {
+			return true;
+		}
+
+		std::unique_lock<Mutex> queueListLock(storage.getMutex());
 		return queueListConditionVariable.wait_for(queueListLock, duration, [this]() -> bool {
 			return doCanProcess();
 		});
@@ -269,78 +715,117 @@ private:
 
 	void doDispatchQueuedEvent(const QueuedItemBase & item)
 	{
-		item.dispatcher(this, item);
+		getItemFunctions(item.callableIndex).dispatch(this, item);
 	}
 
-	template <typename PrototypeInfo>
+	static const ItemFunctions & getItemFunctions(const int callableIndex)
+	{
+		static const ItemFunctions * table = doMakeItemFunctionsTable(
+			typename MakeIndexSequence<HeterTupleSize<PrototypeList_>::value>::Type()
+		);
+
+		assert(callableIndex >= 0 && callableIndex < (int)HeterTupleSize<PrototypeList_>::value);
+		return table[callableIndex];
+	}
+
+	template <size_t ...Indexes>
+	static const ItemFunctions * doMakeItemFunctionsTable(IndexSequence<Indexes...>)
+	{
+		// The last entry is never used, it keeps the array not empty.
+		static const ItemFunctions table[] = {
+			doMakeItemFunctions<QueuedItemOfIndex<(int)Indexes> >()...,
+			ItemFunctions { nullptr, 0, nullptr, nullptr }
+		};
+		return table;
+	}
+
+	template <typename Item>
+	static ItemFunctions doMakeItemFunctions()
+	{
+		return ItemFunctions {
+			&HeterEventQueueBase::doDispatchItem<Item>,
+			sizeof(Item),
+			&commonRelocate<Item>,
+			&commonDtor<Item>
+		};
+	}
+
+	template <typename Item>
 	static void doDispatchItem(const HeterEventQueueBase * self, const QueuedItemBase & baseItem)
 	{
-		const auto & item = static_cast<const QueuedItem<typename PrototypeInfo::ArgsTuple> &>(baseItem);
-		self->doDispatchQueuedItem<PrototypeInfo>(
+		const auto & item = static_cast<const Item &>(baseItem);
+		self->doDispatchQueuedItem(
 			item,
-			typename MakeIndexSequence<std::tuple_size<typename PrototypeInfo::ArgsTuple>::value>::Type()
+			typename MakeIndexSequence<std::tuple_size<decltype(item.arguments)>::value>::Type()
 		);
 	}
 
-	template <typename PrototypeInfo, typename T, size_t ...Indexes>
+	template <typename T, size_t ...Indexes>
 	void doDispatchQueuedItem(T && item, IndexSequence<Indexes...>) const
 	{
 		this->directDispatch(item.event, std::get<Indexes>(item.arguments)...);
 	}
 
+	template <typename Visitor, int index>
+	static auto doVisitItem(Visitor & visitor, const QueuedItemBase & baseItem, std::integral_constant<int, index>)
+		-> typename std::enable_if<(index < (int)HeterTupleSize<PrototypeList_>::value), void>::type
+	{
+		if(baseItem.callableIndex == index) {
+			const auto & item = static_cast<const QueuedItemOfIndex<index> &>(baseItem);
+			doVisitQueuedItem(
+				visitor,
+				item,
+				typename MakeIndexSequence<std::tuple_size<decltype(item.arguments)>::value>::Type()
+			);
+		}
+		else {
+			doVisitItem(visitor, baseItem, std::integral_constant<int, index + 1>());
+		}
+	}
+
+	template <typename Visitor, int index>
+	static auto doVisitItem(Visitor & /*visitor*/, const QueuedItemBase & /*baseItem*/, std::integral_constant<int, index>)
+		-> typename std::enable_if<(index >= (int)HeterTupleSize<PrototypeList_>::value), void>::type
+	{
+		assert(false);
+	}
+
+	template <typename Visitor, typename T, size_t ...Indexes>
+	static void doVisitQueuedItem(Visitor & visitor, T && item, IndexSequence<Indexes...>)
+	{
+		visitor(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
 	template <typename PrototypeInfo, typename F>
 	auto doProcessIf(F && func)
 		-> typename std::enable_if<(PrototypeInfo::index >= 0), bool>::type
 	{
-		BufferedItemList tempList;
-		BufferedItemList idleList;
-
 		// Use a counter to tell the queue list is not empty during processing
 		// even though queueList is swapped to empty.
 		CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
 
-		{
-			std::lock_guard<Mutex> queueListLock(queueListMutex);
-			std::swap(queueList, tempList);
-		}
-
-		if(! tempList.empty()) {
-			for(auto it = tempList.begin(); it != tempList.end(); ) {
-				using ArgsTuple = typename PrototypeInfo::ArgsTuple;
-				auto item = it->template get<QueuedItem<ArgsTuple> >();
+		using ArgsTuple = typename PrototypeInfo::ArgsTuple;
 
-				if(item.callableIndex != PrototypeInfo::index) {
-					++it;
-					continue;
-				}
-				if(doInvokeFuncWithQueuedEvent(
-					func,
-					item,
-					typename MakeIndexSequence<std::tuple_size<ArgsTuple>::value>::Type())
-					) {
-					doDispatchQueuedEvent(item);
-					it->clear();
-
-					auto tempIt = it;
-					++it;
-					idleList.splice(idleList.end(), tempList, tempIt);
-				}
-				else {
-					++it;
-				}
+		const bool processed = storage.processIf([this, &func](const QueuedItemBase & baseItem) -> bool {
+			if(baseItem.callableIndex != PrototypeInfo::index) {
+				return false;
 			}
 
-			if (! tempList.empty()) {
-				std::lock_guard<Mutex> queueListLock(queueListMutex);
-				queueList.splice(queueList.begin(), tempList);
+			const auto & item = static_cast<const QueuedItem<ArgsTuple> &>(baseItem);
+			if(doInvokeFuncWithQueuedEvent(
+				func,
+				item,
+				typename MakeIndexSequence<std::tuple_size<ArgsTuple>::value>::Type())
+				) {
+				doDispatchQueuedEvent(item);
+				return true;
 			}
 
-			if(! idleList.empty()) {
-				std::lock_guard<Mutex> queueListLock(freeListMutex);
-				freeList.splice(freeList.end(), idleList);
+			return false;
+		});
 
-				return true;
-			}
+		if(processed) {
+			return true;
 		}
 
 		using NextPrototypeInfo = FindPrototypeByCallableFromIndex<PrototypeInfo::index + 1, PrototypeList, F>;
@@ -371,8 +856,11 @@ private:
 	}
 
 	template <typename ArgumentMode, typename T, typename ...Args>
-	auto doEnqueue(T && first, Args && ...args)
-		-> typename std::enable_if<std::is_same<ArgumentMode, ArgumentPassingIncludeEvent>::value>::type
+	auto doMakeQueuedItem(T && first, Args && ...args)
+		-> typename std::enable_if<
+			std::is_same<ArgumentMode, ArgumentPassingIncludeEvent>::value,
+			QueuedItem<typename FindPrototypeByArgs<PrototypeList_, T, Args...>::ArgsTuple>
+		>::type
 	{
 		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, T &&, Args...>::value>::Type;
 		using PrototypeInfo = FindPrototypeByArgs<PrototypeList_, T, Args...>;
@@ -381,21 +869,19 @@ private:
 		static_assert(PrototypeInfo::index >= 0, "Can't find invoker for the given argument types.");
 		static_assert(std::tuple_size<typename PrototypeInfo::ArgsTuple>::value == 1 + sizeof...(Args), "Arguments count mismatch.");
 
-		doEnqueueItem(QueuedItemType(
+		return QueuedItemType(
 			PrototypeInfo::index,
 			GetEvent::getEvent(std::forward<T>(first), args...),
-			&HeterEventQueueBase::doDispatchItem<PrototypeInfo>,
 			typename PrototypeInfo::ArgsTuple(std::forward<T>(first), std::forward<Args>(args)...)
-		));
-
-		if(doCanProcess()) {
-			queueListConditionVariable.notify_one();
-		}
+		);
 	}
 
 	template <typename ArgumentMode, typename T, typename ...Args>
-	auto doEnqueue(T && first, Args && ...args)
-		-> typename std::enable_if<std::is_same<ArgumentMode, ArgumentPassingExcludeEvent>::value>::type
+	auto doMakeQueuedItem(T && first, Args && ...args)
+		-> typename std::enable_if<
+			std::is_same<ArgumentMode, ArgumentPassingExcludeEvent>::value,
+			QueuedItem<typename FindPrototypeByArgs<PrototypeList_, Args...>::ArgsTuple>
+		>::type
 	{
 		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, T &&, Args...>::value>::Type;
 		using PrototypeInfo = FindPrototypeByArgs<PrototypeList_, Args...>;
@@ -404,50 +890,60 @@ private:
 		static_assert(PrototypeInfo::index >= 0, "Can't find invoker for the given argument types.");
 		static_assert(std::tuple_size<typename PrototypeInfo::ArgsTuple>::value == sizeof...(Args), "Arguments count mismatch.");
 
-		doEnqueueItem(QueuedItemType(
+		return QueuedItemType(
 			PrototypeInfo::index,
 			GetEvent::getEvent(std::forward<T>(first), args...),
-			&HeterEventQueueBase::doDispatchItem<PrototypeInfo>,
 			typename PrototypeInfo::ArgsTuple(std::forward<Args>(args)...)
-		));
+		);
+	}
 
-		if(doCanProcess()) {
-			queueListConditionVariable.notify_one();
-		}
+	// The item type depends on the element, so the return types are deduced (C++14).
+	template <typename T>
+	auto doMakeBulkQueuedItem(T && element)
+	{
+		return doMakeBulkQueuedItem(std::forward<T>(element), IsStdTuple<typename std::decay<T>::type>());
 	}
 
 	template <typename T>
-	void doEnqueueItem(T && item)
+	auto doMakeBulkQueuedItem(T && element, std::false_type)
 	{
-		BufferedItemList tempList;
-		if(! freeList.empty()) {
-			{
-				std::lock_guard<Mutex> queueListLock(freeListMutex);
-				if(! freeList.empty()) {
-					tempList.splice(tempList.end(), freeList, freeList.begin());
-				}
-			}
-		}
+		return doMakeQueuedItem<ArgumentPassingMode>(std::forward<T>(element));
+	}
 
-		if(tempList.empty()) {
-			tempList.emplace_back();
+	template <typename T>
+	auto doMakeBulkQueuedItem(T && element, std::true_type)
+	{
+		return doMakeBulkQueuedItemFromTuple(
+			std::forward<T>(element),
+			typename MakeIndexSequence<std::tuple_size<typename std::decay<T>::type>::value>::Type()
+		);
+	}
+
+	template <typename T, size_t ...Indexes>
+	auto doMakeBulkQueuedItemFromTuple(T && element, IndexSequence<Indexes...>)
+	{
+		return doMakeQueuedItem<ArgumentPassingMode>(std::get<Indexes>(std::forward<T>(element))...);
+	}
+
+	template <typename Maker>
+	void doEnqueueBulk(const size_t count, Maker && maker)
+	{
+		if(count == 0) {
+			return;
 		}
 
-		auto it = tempList.begin();
-		it->set(std::move(item));
+		storage.pushBulk(count, std::forward<Maker>(maker));
 
-		std::lock_guard<Mutex> queueListLock(queueListMutex);
-		queueList.splice(queueList.end(), tempList, it);
+		if(doCanProcess()) {
+			queueListConditionVariable.notify_one();
+		}
 	}
 
 private:
-	mutable ConditionVariable queueListConditionVariable;
+	EVENTPP_ALIGN_CACHELINE mutable ConditionVariable queueListConditionVariable;
 	typename Threading::template Atomic<int> queueEmptyCounter;
 	typename Threading::template Atomic<int> queueNotifyCounter;
-	mutable Mutex queueListMutex;
-	BufferedItemList queueList;
-	Mutex freeListMutex;
-	BufferedItemList freeList;
+	Storage storage;
 };
 
 
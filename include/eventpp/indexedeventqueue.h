@@ -0,0 +1,743 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INDEXEDEVENTQUEUE_H_EVENTPP
+#define INDEXEDEVENTQUEUE_H_EVENTPP
+
+#include "eventdispatcher.h"
+#include "internal/eventqueue_i.h"
+#include "internal/spinwait_i.h"
+
+#include <list>
+#include <tuple>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <initializer_list>
+#include <type_traits>
+
+namespace eventpp {
+
+namespace internal_ {
+
+template <typename T, typename ...Args>
+struct HasFunctionIndexKey
+{
+	template <typename C> static std::true_type test(decltype(C::indexKey(std::declval<Args>()...)) *) ;
+	template <typename C> static std::false_type test(...);
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+
+// The key is the result of Policies::indexKey(event, args...) if it exists,
+// otherwise the event itself.
+template <typename Policies, typename Event, bool, typename ...Args>
+struct SelectIndexKey
+{
+	using Type = typename std::decay<decltype(Policies::indexKey(std::declval<const Event &>(), std::declval<const Args &>()...))>::type;
+
+	template <typename ...A>
+	static Type getKey(const Event & e, const A & ...args) {
+		return Policies::indexKey(e, args...);
+	}
+};
+
+template <typename Policies, typename Event, typename ...Args>
+struct SelectIndexKey <Policies, Event, false, Args...>
+{
+	using Type = Event;
+
+	template <typename ...A>
+	static Type getKey(const Event & e, const A & .../*args*/) {
+		return e;
+	}
+};
+
+template <
+	typename EventType_,
+	typename Prototype_,
+	typename Policies_
+>
+class IndexedEventQueueBase;
+
+// OPT-51: EventQueue with one sub-queue per key.
+// processIf takes the whole queue and runs the predicate on every event, so a
+// consumer of one event pays for all the others, again on each call. Here
+// each key has its own list, and processEvent(key) takes that list out in
+// one splice, it never sees the events of the other keys. Each event gets a
+// sequence number when it's enqueued, the functions which take several
+// lists merge them by the number, so the global FIFO order is kept.
+template <
+	typename EventType_,
+	typename Policies_,
+	typename ReturnType, typename ...Args
+>
+class IndexedEventQueueBase <
+		EventType_,
+		ReturnType (Args...),
+		Policies_
+	> : public EventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		IndexedEventQueueBase <
+			EventType_,
+			ReturnType (Args...),
+			Policies_
+		>
+	>
+{
+private:
+	using super = EventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		IndexedEventQueueBase <
+			EventType_,
+			ReturnType (Args...),
+			Policies_
+		>
+	>;
+
+	using Policies = typename super::Policies;
+	using Threading = typename super::Threading;
+	using DispatchCache = typename super::DispatchCache;
+	using ConditionVariable = typename Threading::ConditionVariable;
+
+	using QueuedEventArgumentsType = std::tuple<typename std::decay<Args>::type...>;
+
+	struct QueuedEvent_
+	{
+		typename std::decay<typename super::Event>::type event;
+		QueuedEventArgumentsType arguments;
+
+		typename super::Event getEvent() const {
+			return event;
+		}
+
+		template <std::size_t N>
+		auto getArgument() const
+			-> typename std::tuple_element<N, std::tuple<Args...> >::type {
+			return std::get<N>(arguments);
+		}
+	};
+
+	using IndexKeySelector = SelectIndexKey<
+		Policies_,
+		typename std::decay<typename super::Event>::type,
+		HasFunctionIndexKey<
+			Policies_,
+			const typename std::decay<typename super::Event>::type &,
+			const typename std::decay<Args>::type & ...
+		>::value,
+		typename std::decay<Args>::type...
+	>;
+
+	struct IndexedItem
+	{
+		std::uint64_t sequence;
+		BufferedItem<QueuedEvent_> item;
+	};
+
+	// The sub-queues are spliced and merged node by node, so the list must be
+	// a std::list, the QueueList policy is not used.
+	using BufferedItemList = std::list<IndexedItem>;
+
+public:
+	using QueuedEvent = QueuedEvent_;
+	using Event = typename super::Event;
+	using Handle = typename super::Handle;
+	using Callback = typename super::Callback;
+	using Mutex = typename super::Mutex;
+	using IndexKey = typename IndexKeySelector::Type;
+
+private:
+	using LaneMap = typename SelectMap<IndexKey, BufferedItemList, Policies_, false>::Type;
+
+public:
+	struct DisableQueueNotify
+	{
+		DisableQueueNotify(IndexedEventQueueBase * queue)
+			: queue(queue)
+		{
+			++queue->queueNotifyCounter;
+		}
+
+		~DisableQueueNotify()
+		{
+			--queue->queueNotifyCounter;
+
+			if(queue->doCanNotifyQueueAvailable() && ! queue->emptyQueue()) {
+				queue->queueListConditionVariable.notify_one();
+			}
+		}
+
+		IndexedEventQueueBase * queue;
+	};
+
+public:
+	IndexedEventQueueBase()
+		:
+			super(),
+			queueListConditionVariable(),
+			queueEmptyCounter(0),
+			queueNotifyCounter(0),
+			queuedEventCount(0),
+			queueListMutex(),
+			nextSequence(0),
+			laneMap(),
+			freeList()
+	{
+	}
+
+	// Same as EventQueue, only the listeners are copied or moved, the queued events are not.
+	IndexedEventQueueBase(const IndexedEventQueueBase & other)
+		: IndexedEventQueueBase()
+	{
+		super::operator = (other);
+	}
+
+	IndexedEventQueueBase(IndexedEventQueueBase && other) noexcept
+		: IndexedEventQueueBase()
+	{
+		super::operator = (std::move(other));
+	}
+
+	IndexedEventQueueBase & operator = (const IndexedEventQueueBase & other)
+	{
+		super::operator = (other);
+		return *this;
+	}
+
+	IndexedEventQueueBase & operator = (IndexedEventQueueBase && other) noexcept
+	{
+		super::operator = (std::move(other));
+		return *this;
+	}
+
+	template <typename ...A>
+	auto enqueue(A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), void>::type
+	{
+		static_assert(super::ArgumentPassingMode::canIncludeEventType, "Enqueuing arguments count doesn't match required (Event type should be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, A...>::value>::Type;
+
+		doEnqueue(QueuedEvent{
+			GetEvent::getEvent(args...),
+			QueuedEventArgumentsType(std::forward<A>(args)...)
+		});
+	}
+
+	template <typename T, typename ...A>
+	auto enqueue(T && first, A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), void>::type
+	{
+		static_assert(super::ArgumentPassingMode::canExcludeEventType, "Enqueuing arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, T &&, A...>::value>::Type;
+
+		doEnqueue(QueuedEvent{
+			GetEvent::getEvent(std::forward<T>(first), args...),
+			QueuedEventArgumentsType(std::forward<A>(args)...)
+		});
+	}
+
+	bool emptyQueue() const
+	{
+		return queuedEventCount.load(std::memory_order_acquire) == 0
+			&& (queueEmptyCounter.load(std::memory_order_acquire) == 0);
+	}
+
+	// The count of the queued events with the key.
+	std::size_t getQueuedEventCount(const IndexKey & key) const
+	{
+		std::lock_guard<Mutex> queueListLock(queueListMutex);
+
+		auto it = laneMap.find(key);
+		return it == laneMap.end() ? 0 : it->second.size();
+	}
+
+	void clearEvents()
+	{
+		if(queuedEventCount.load(std::memory_order_acquire) != 0) {
+			std::vector<BufferedItemList> laneList;
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				doTakeAllLanes(laneList);
+			}
+
+			for(auto & lane : laneList) {
+				for(auto & node : lane) {
+					node.item.clear();
+				}
+				doRecycle(lane);
+			}
+		}
+	}
+
+	// Dispatches all the queued events in the order they are enqueued.
+	bool process()
+	{
+		std::vector<BufferedItemList> laneList;
+		return doProcessLanes(
+			[this, &laneList]() {
+				doTakeAllLanes(laneList);
+			},
+			laneList
+		);
+	}
+
+	bool processOne()
+	{
+		return doProcessOne([this](QueuedEvent & item) {
+			doDispatchQueuedEvent(
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	// Dispatches the queued events with the key, in the order they are
+	// enqueued. The events of the other keys are not touched.
+	bool processEvent(const IndexKey & key)
+	{
+		std::vector<BufferedItemList> laneList;
+		return doProcessLanes(
+			[this, &laneList, &key]() {
+				doTakeLane(laneList, key);
+			},
+			laneList
+		);
+	}
+
+	// Dispatches the first queued event with the key.
+	bool processOneEvent(const IndexKey & key)
+	{
+		return doProcessOneEvent(key, [this](QueuedEvent & item) {
+			doDispatchQueuedEvent(
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	// Dispatches the queued events with any of the keys, in the order they
+	// are enqueued. The keys can repeat.
+	template <typename Iterator>
+	bool processEvents(Iterator first, Iterator last)
+	{
+		std::vector<BufferedItemList> laneList;
+		return doProcessLanes(
+			[this, &laneList, first, last]() {
+				for(Iterator it = first; it != last; ++it) {
+					doTakeLane(laneList, *it);
+				}
+			},
+			laneList
+		);
+	}
+
+	bool processEvents(std::initializer_list<IndexKey> keys)
+	{
+		return processEvents(keys.begin(), keys.end());
+	}
+
+	// OPT-15: Zero-overhead visitor dispatch, see EventQueue::processQueueWith.
+	// Visitor protocol: visitor(event, args...)
+	template <typename Visitor>
+	bool processQueueWith(Visitor && visitor)
+	{
+		std::vector<BufferedItemList> laneList;
+		return doProcessLanesWith(
+			[this, &laneList]() {
+				doTakeAllLanes(laneList);
+			},
+			laneList,
+			[this, &visitor](QueuedEvent & item) {
+				doVisitQueuedEvent(
+					visitor,
+					item,
+					typename MakeIndexSequence<sizeof...(Args)>::Type()
+				);
+			}
+		);
+	}
+
+	// OPT-15: Single-event variant of processQueueWith.
+	template <typename Visitor>
+	bool processOneWith(Visitor && visitor)
+	{
+		return doProcessOne([this, &visitor](QueuedEvent & item) {
+			doVisitQueuedEvent(
+				visitor,
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	void wait() const
+	{
+		std::unique_lock<Mutex> queueListLock(queueListMutex);
+		queueListConditionVariable.wait(queueListLock, [this]() -> bool {
+			return doCanProcess();
+		});
+	}
+
+	template <class Rep, class Period>
+	bool waitFor(const std::chrono::duration<Rep, Period> & duration) const
+	{
+		// OPT-8: Spin -> Yield -> Sleep, same as EventQueue::waitFor.
+		if(doCanProcess()) {
+			return true;
+		}
+
+		if(internal_::spinThenYield([this]() -> bool {
+			return doCanProcess();
+		})) {
+			return true;
+		}
+
+		std::unique_lock<Mutex> queueListLock(queueListMutex);
+		return queueListConditionVariable.wait_for(queueListLock, duration, [this]() -> bool {
+			return doCanProcess();
+		});
+	}
+
+	using super::dispatch;
+
+	template <typename U>
+	auto dispatch(const U & queuedEvent)
+		-> typename std::enable_if<std::is_same<U, QueuedEvent>::value, void>::type
+	{
+		doDispatchQueuedEvent(
+			queuedEvent,
+			typename MakeIndexSequence<sizeof...(Args)>::Type()
+		);
+	}
+
+	bool peekEvent(QueuedEvent * queuedEvent)
+	{
+		if(queuedEventCount.load(std::memory_order_acquire) != 0) {
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+
+			BufferedItemList * lane = doFindFirstLane();
+			if(lane != nullptr) {
+				*queuedEvent = lane->front().item.get();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool takeEvent(QueuedEvent * queuedEvent)
+	{
+		return doProcessOne([queuedEvent](QueuedEvent & item) {
+			*queuedEvent = std::move(item);
+		});
+	}
+
+	bool takeEvent(const IndexKey & key, QueuedEvent * queuedEvent)
+	{
+		return doProcessOneEvent(key, [queuedEvent](QueuedEvent & item) {
+			*queuedEvent = std::move(item);
+		});
+	}
+
+protected:
+	// takeLanes moves the lists to process to laneList under the queue lock.
+	template <typename TakeLanes>
+	bool doProcessLanes(TakeLanes && takeLanes, std::vector<BufferedItemList> & laneList)
+	{
+		// OPT-25: The events of one key are mostly the same event, they share one lookup.
+		DispatchCache cache;
+		return doProcessLanesWith(
+			std::forward<TakeLanes>(takeLanes),
+			laneList,
+			[this, &cache](QueuedEvent & item) {
+				doDispatchQueuedEventCached(
+					cache,
+					item,
+					typename MakeIndexSequence<sizeof...(Args)>::Type()
+				);
+			}
+		);
+	}
+
+	template <typename TakeLanes, typename F>
+	bool doProcessLanesWith(TakeLanes && takeLanes, std::vector<BufferedItemList> & laneList, F && func)
+	{
+		if(queuedEventCount.load(std::memory_order_acquire) != 0) {
+			// Use a counter to tell the queue is not empty during processing
+			// even though the lists are taken out.
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				takeLanes();
+			}
+
+			if(! laneList.empty()) {
+				// The lists are merged without the lock, the producers are not blocked.
+				BufferedItemList tempList;
+				doMergeLanes(laneList, tempList);
+
+				for(auto & node : tempList) {
+					func(node.item.get());
+					node.item.clear();
+				}
+
+				doRecycle(tempList);
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	template <typename F>
+	bool doProcessOne(F && func)
+	{
+		if(queuedEventCount.load(std::memory_order_acquire) != 0) {
+			BufferedItemList tempList;
+
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+
+				BufferedItemList * lane = doFindFirstLane();
+				if(lane != nullptr) {
+					tempList.splice(tempList.end(), *lane, lane->begin());
+					doSubtractQueuedCount(1);
+				}
+			}
+
+			return doProcessTempList(tempList, std::forward<F>(func));
+		}
+
+		return false;
+	}
+
+	template <typename F>
+	bool doProcessOneEvent(const IndexKey & key, F && func)
+	{
+		if(queuedEventCount.load(std::memory_order_acquire) != 0) {
+			BufferedItemList tempList;
+
+			CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+			{
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+
+				auto it = laneMap.find(key);
+				if(it != laneMap.end() && ! it->second.empty()) {
+					tempList.splice(tempList.end(), it->second, it->second.begin());
+					doSubtractQueuedCount(1);
+				}
+			}
+
+			return doProcessTempList(tempList, std::forward<F>(func));
+		}
+
+		return false;
+	}
+
+	template <typename F>
+	bool doProcessTempList(BufferedItemList & tempList, F && func)
+	{
+		if(! tempList.empty()) {
+			func(tempList.front().item.get());
+			tempList.front().item.clear();
+
+			doRecycle(tempList);
+
+			return true;
+		}
+
+		return false;
+	}
+
+	// The lists are kept in the map when they are empty, so a key which is
+	// enqueued again doesn't allocate a map node.
+	void doTakeAllLanes(std::vector<BufferedItemList> & laneList)
+	{
+		for(auto & item : laneMap) {
+			if(! item.second.empty()) {
+				laneList.emplace_back();
+				laneList.back().swap(item.second);
+			}
+		}
+		queuedEventCount.store(0, std::memory_order_release);
+	}
+
+	void doTakeLane(std::vector<BufferedItemList> & laneList, const IndexKey & key)
+	{
+		auto it = laneMap.find(key);
+		if(it != laneMap.end() && ! it->second.empty()) {
+			doSubtractQueuedCount(it->second.size());
+			laneList.emplace_back();
+			laneList.back().swap(it->second);
+		}
+	}
+
+	// The lane which has the oldest event, or nullptr if the queue is empty.
+	// It's linear in the count of keys.
+	BufferedItemList * doFindFirstLane()
+	{
+		BufferedItemList * result = nullptr;
+		for(auto & item : laneMap) {
+			if(! item.second.empty()
+				&& (result == nullptr || item.second.front().sequence < result->front().sequence)) {
+				result = &item.second;
+			}
+		}
+		return result;
+	}
+
+	// Each list is sorted by the sequence, they are merged pairwise, so the cost
+	// is O(n log k) for n events in k lists. The nodes are relinked, not copied.
+	static void doMergeLanes(std::vector<BufferedItemList> & laneList, BufferedItemList & result)
+	{
+		const auto compare = [](const IndexedItem & a, const IndexedItem & b) -> bool {
+			return a.sequence < b.sequence;
+		};
+		for(std::size_t step = 1; step < laneList.size(); step *= 2) {
+			for(std::size_t i = 0; i + step < laneList.size(); i += step * 2) {
+				laneList[i].merge(laneList[i + step], compare);
+			}
+		}
+		result.swap(laneList.front());
+	}
+
+	void doSubtractQueuedCount(const std::size_t count)
+	{
+		queuedEventCount.store(
+			queuedEventCount.load(std::memory_order_relaxed) - count,
+			std::memory_order_release
+		);
+	}
+
+	bool doCanProcess() const
+	{
+		return ! emptyQueue() && doCanNotifyQueueAvailable();
+	}
+
+	bool doCanNotifyQueueAvailable() const
+	{
+		return queueNotifyCounter.load(std::memory_order_acquire) == 0;
+	}
+
+	template <typename T, size_t ...Indexes>
+	static IndexKey doGetIndexKey(const T & item, IndexSequence<Indexes...>)
+	{
+		return IndexKeySelector::getKey(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEvent(T && item, IndexSequence<Indexes...>)
+	{
+		this->directDispatch(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEventCached(DispatchCache & cache, T && item, IndexSequence<Indexes...>)
+	{
+		this->doDirectDispatchCached(cache, item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename V, typename T, size_t ...Indexes>
+	void doVisitQueuedEvent(V && visitor, T && item, IndexSequence<Indexes...>)
+	{
+		visitor(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	void doEnqueue(QueuedEvent && item)
+	{
+		// The key is computed before taking the lock.
+		IndexKey key = doGetIndexKey(item, typename MakeIndexSequence<sizeof...(Args)>::Type());
+
+		{
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+
+			// The free list shares queueListMutex, the sequence number needs
+			// this lock anyway, so enqueue takes only one lock.
+			if(freeList.empty()) {
+				freeList.emplace_back();
+			}
+			auto it = freeList.begin();
+			it->sequence = nextSequence++;
+			it->item.set(std::move(item));
+			auto & lane = laneMap[std::move(key)];
+			lane.splice(lane.end(), freeList, it);
+			queuedEventCount.store(
+				queuedEventCount.load(std::memory_order_relaxed) + 1,
+				std::memory_order_release
+			);
+		}
+
+		if(doCanProcess()) {
+			queueListConditionVariable.notify_one();
+		}
+	}
+
+	void doRecycle(BufferedItemList & tempList)
+	{
+		if(! tempList.empty()) {
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			freeList.splice(freeList.end(), tempList);
+		}
+	}
+
+private:
+	EVENTPP_ALIGN_CACHELINE mutable ConditionVariable queueListConditionVariable;
+	typename Threading::template Atomic<int> queueEmptyCounter;
+	typename Threading::template Atomic<int> queueNotifyCounter;
+	// Written only under queueListMutex, read without it by emptyQueue.
+	typename Threading::template Atomic<std::size_t> queuedEventCount;
+	EVENTPP_ALIGN_CACHELINE mutable Mutex queueListMutex;
+	std::uint64_t nextSequence;
+	LaneMap laneMap;
+	BufferedItemList freeList;
+};
+
+} //namespace internal_
+
+template <
+	typename Event_,
+	typename Prototype_,
+	typename Policies_ = DefaultPolicies
+>
+class IndexedEventQueue : public internal_::InheritMixins<
+		internal_::IndexedEventQueueBase<Event_, Prototype_, Policies_>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type, public TagEventDispatcher, public TagEventQueue
+{
+private:
+	using super = typename internal_::InheritMixins<
+		internal_::IndexedEventQueueBase<Event_, Prototype_, Policies_>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type;
+
+public:
+	using super::super;
+};
+
+
+} //namespace eventpp
+
+
+#endif
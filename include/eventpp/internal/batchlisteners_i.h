@@ -0,0 +1,184 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BATCHLISTENERS_I_H_EVENTPP
+#define BATCHLISTENERS_I_H_EVENTPP
+
+#include "../eventpolicies.h"
+#include "eventqueue_i.h"
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace eventpp {
+
+// OPT-65: The values of one argument of a run of events, given to a batch
+// listener of EventQueue, see EventQueue::appendBatchListener.
+// The values are contiguous, and valid until the listener returns.
+template <typename T>
+class BatchSpan
+{
+public:
+	using value_type = T;
+	using const_iterator = const T *;
+
+public:
+	BatchSpan(const T * data, const std::size_t count)
+		: data_(data), count(count)
+	{
+	}
+
+	const T * data() const {
+		return data_;
+	}
+
+	std::size_t size() const {
+		return count;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+
+	const T & operator [] (const std::size_t index) const {
+		return data_[index];
+	}
+
+	const_iterator begin() const {
+		return data_;
+	}
+
+	const_iterator end() const {
+		return data_ + count;
+	}
+
+private:
+	const T * data_;
+	std::size_t count;
+};
+
+namespace internal_ {
+
+// The arguments can be batched if they can be copied to the columns.
+// std::vector<bool> is not contiguous, so bool can't be batched.
+template <typename ...Types>
+struct CanBatchArguments;
+
+template <>
+struct CanBatchArguments <>
+{
+	enum { value = true };
+};
+
+template <typename T, typename ...Types>
+struct CanBatchArguments <T, Types...>
+{
+	enum {
+		value = std::is_copy_constructible<T>::value
+			&& ! std::is_same<T, bool>::value
+			&& CanBatchArguments<Types...>::value
+	};
+};
+
+// The policies of the dispatcher of the batch listeners. The Map of the
+// queue is used if it has one.
+template <typename Policies, bool hasMap>
+struct BatchListenerPolicies
+{
+	using Threading = typename SelectThreading<Policies, HasTypeThreading<Policies>::value>::Type;
+};
+
+template <typename Policies>
+struct BatchListenerPolicies <Policies, true> : public BatchListenerPolicies<Policies, false>
+{
+	template <typename Key, typename T>
+	using Map = typename Policies::template Map<Key, T>;
+};
+
+// Each argument of the run of events is copied to its own column, so a
+// batch listener sees the values of one argument side by side.
+// clear keeps the capacity, so the columns are allocated once for the
+// longest run.
+template <typename ...Columns>
+class BatchColumns
+{
+private:
+	using IndexList = typename MakeIndexSequence<sizeof...(Columns)>::Type;
+
+public:
+	BatchColumns()
+		: columnList(), count(0)
+	{
+	}
+
+	template <typename Tuple>
+	void push(const Tuple & arguments)
+	{
+		doPush(arguments, IndexList());
+		++count;
+	}
+
+	// Calls func(BatchSpan<Columns>...).
+	template <typename Func>
+	void invoke(Func && func) const
+	{
+		doInvoke(func, IndexList());
+	}
+
+	void clear()
+	{
+		doClear(IndexList());
+		count = 0;
+	}
+
+	std::size_t size() const {
+		return count;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+
+private:
+	template <typename Tuple, std::size_t ...Indexes>
+	void doPush(const Tuple & arguments, IndexSequence<Indexes...>)
+	{
+		const int dummy[] = { 0, (std::get<Indexes>(columnList).push_back(std::get<Indexes>(arguments)), 0)... };
+		(void)dummy;
+	}
+
+	template <typename Func, std::size_t ...Indexes>
+	void doInvoke(Func & func, IndexSequence<Indexes...>) const
+	{
+		func(BatchSpan<Columns>(std::get<Indexes>(columnList).data(), count)...);
+	}
+
+	template <std::size_t ...Indexes>
+	void doClear(IndexSequence<Indexes...>)
+	{
+		const int dummy[] = { 0, (std::get<Indexes>(columnList).clear(), 0)... };
+		(void)dummy;
+	}
+
+private:
+	std::tuple<std::vector<Columns>...> columnList;
+	std::size_t count;
+};
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
@@ -0,0 +1,246 @@
+// eventpp library - ARM-Linux / x86-Linux optimization extension
+// Multicast ring buffer used by BroadcastEventQueue.
+//
+// Design (OPT-52):
+// - Fixed power-of-two array of slots, as RingBuffer (OPT-17), but an item
+//   is not removed by a consumer. Each consumer has its own cursor, the
+//   count of items it has consumed, and reads the items in place.
+// - A producer claims a position with a CAS on claimPos (RingProducerMulti),
+//   or with a plain store when there is only one producer (RingProducerSingle).
+//   The position is free once every cursor has passed it by the capacity,
+//   the minimum of the cursors is cached so a claim seldom reads them.
+// - A slot is published when its sequence is position + 1.
+// - A cursor may depend on other cursors, it doesn't pass them, so the
+//   consumers form a dependency graph (the sequence barrier of the LMAX
+//   Disruptor).
+// - The item in a slot is destroyed when the slot is reused, or when the
+//   ring is destroyed.
+// - claimPos and the cached minimum live on separate cache lines (OPT-10),
+//   each cursor is padded to a cache line.
+
+#ifndef BROADCASTRING_I_H_EVENTPP
+#define BROADCASTRING_I_H_EVENTPP
+
+#include "eventqueue_i.h"
+#include "../eventpolicies.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <type_traits>
+
+namespace eventpp {
+
+namespace internal_ {
+
+struct BroadcastCursor
+{
+	BroadcastCursor() : position(0), dependencyList()
+	{
+	}
+
+	std::atomic<std::size_t> position;
+	std::vector<const BroadcastCursor *> dependencyList;
+	// Padded rather than aligned, so it can be allocated by new in C++14.
+	char padding[EVENTPP_CACHELINE_SIZE];
+};
+
+template <typename T, typename RingProducer_>
+class BroadcastRing
+{
+private:
+	struct Slot
+	{
+		Slot() : sequence(0), item()
+		{
+		}
+
+		std::atomic<std::size_t> sequence;
+		BufferedItem<T> item;
+	};
+
+	static constexpr bool singleProducer = std::is_same<RingProducer_, RingProducerSingle>::value;
+
+	static std::size_t roundUpCapacity(std::size_t capacity) {
+		std::size_t result = 2;
+		while(result < capacity) {
+			result <<= 1;
+		}
+		return result;
+	}
+
+	static bool isBefore(const std::size_t a, const std::size_t b) {
+		return static_cast<std::ptrdiff_t>(a - b) < 0;
+	}
+
+public:
+	explicit BroadcastRing(const std::size_t capacity)
+		:
+			mask(roundUpCapacity(capacity) - 1),
+			slotList(new Slot[mask + 1]),
+			cursorList(),
+			claimPos(0),
+			cachedMinPosition(0)
+	{
+	}
+
+	BroadcastRing(const BroadcastRing &) = delete;
+	BroadcastRing & operator = (const BroadcastRing &) = delete;
+
+	// Not thread safe, the cursors must be added before the items are pushed.
+	// A new cursor starts at the items which are not pushed yet, or at the
+	// slowest cursor it depends on.
+	BroadcastCursor * addCursor(std::vector<const BroadcastCursor *> dependencyList)
+	{
+		cursorList.emplace_back(new BroadcastCursor());
+		BroadcastCursor * cursor = cursorList.back().get();
+
+		std::size_t position = claimPos.load(std::memory_order_acquire);
+		for(const BroadcastCursor * dependency : dependencyList) {
+			const std::size_t p = dependency->position.load(std::memory_order_acquire);
+			if(isBefore(p, position)) {
+				position = p;
+			}
+		}
+		cursor->position.store(position, std::memory_order_relaxed);
+		cursor->dependencyList = std::move(dependencyList);
+		cachedMinPosition.store(doGetMinPosition(position), std::memory_order_release);
+		return cursor;
+	}
+
+	// Returns false and leaves item untouched if the slowest cursor is a
+	// whole ring behind.
+	bool tryPush(T && item)
+	{
+		std::size_t pos = claimPos.load(std::memory_order_relaxed);
+		for(;;) {
+			// The acquire load pairs with the release store of the cursors,
+			// directly or through cachedMinPosition, so the consumers are done
+			// with the slot before it's reused.
+			if(! isBefore(pos, cachedMinPosition.load(std::memory_order_acquire) + mask + 1)) {
+				const std::size_t minPosition = doGetMinPosition(pos);
+				cachedMinPosition.store(minPosition, std::memory_order_release);
+				if(! isBefore(pos, minPosition + mask + 1)) {
+					return false;
+				}
+			}
+			if(singleProducer) {
+				claimPos.store(pos + 1, std::memory_order_relaxed);
+				break;
+			}
+			if(claimPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		}
+
+		Slot & slot = slotList[pos & mask];
+		if(pos > mask) {
+			// The previous item in the slot is published before a cursor can
+			// pass it, this only waits when there is no cursor and another
+			// producer is still writing it.
+			while(slot.sequence.load(std::memory_order_acquire) != pos - mask) {
+				std::this_thread::yield();
+			}
+			slot.item.clear();
+		}
+		slot.item.set(std::move(item));
+		slot.sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Passes at most maxCount published items to func, in order, and moves
+	// the cursor past them. Returns the count of the items.
+	// Only one thread may consume with a cursor at the same time.
+	template <typename F>
+	std::size_t consume(BroadcastCursor & cursor, const std::size_t maxCount, F && func)
+	{
+		std::size_t pos = cursor.position.load(std::memory_order_relaxed);
+		std::size_t limit = pos + maxCount;
+		for(const BroadcastCursor * dependency : cursor.dependencyList) {
+			const std::size_t p = dependency->position.load(std::memory_order_acquire);
+			if(isBefore(p, limit)) {
+				limit = p;
+			}
+		}
+
+		std::size_t count = 0;
+		while(isBefore(pos, limit)) {
+			const Slot & slot = slotList[pos & mask];
+			if(slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+				break;
+			}
+			func(slot.item.get());
+			++pos;
+			++count;
+			// Free the slots to the producers in chunks, not once per item.
+			if((count & 63) == 0) {
+				cursor.position.store(pos, std::memory_order_release);
+			}
+		}
+		if(count > 0) {
+			cursor.position.store(pos, std::memory_order_release);
+		}
+		return count;
+	}
+
+	// True if the cursor can consume an item now.
+	bool canConsume(const BroadcastCursor & cursor) const
+	{
+		const std::size_t pos = cursor.position.load(std::memory_order_acquire);
+		for(const BroadcastCursor * dependency : cursor.dependencyList) {
+			if(! isBefore(pos, dependency->position.load(std::memory_order_acquire))) {
+				return false;
+			}
+		}
+		return slotList[pos & mask].sequence.load(std::memory_order_acquire) == pos + 1;
+	}
+
+	// Approximate count of the items the cursor has not consumed, it includes
+	// the items which are being written.
+	std::size_t getPendingCount(const BroadcastCursor & cursor) const
+	{
+		const std::size_t tail = cursor.position.load(std::memory_order_acquire);
+		const std::size_t head = claimPos.load(std::memory_order_acquire);
+		return isBefore(tail, head) ? head - tail : 0;
+	}
+
+	bool full() const
+	{
+		const std::size_t pos = claimPos.load(std::memory_order_acquire);
+		return ! isBefore(pos, doGetMinPosition(pos) + mask + 1);
+	}
+
+	std::size_t capacity() const
+	{
+		return mask + 1;
+	}
+
+private:
+	// The position of the slowest cursor, or pos if there is no cursor.
+	std::size_t doGetMinPosition(std::size_t pos) const
+	{
+		for(const auto & cursor : cursorList) {
+			const std::size_t p = cursor->position.load(std::memory_order_acquire);
+			if(isBefore(p, pos)) {
+				pos = p;
+			}
+		}
+		return pos;
+	}
+
+private:
+	const std::size_t mask;
+	std::unique_ptr<Slot[]> slotList;
+	std::vector<std::unique_ptr<BroadcastCursor> > cursorList;
+	EVENTPP_ALIGN_CACHELINE std::atomic<std::size_t> claimPos;
+	EVENTPP_ALIGN_CACHELINE std::atomic<std::size_t> cachedMinPosition;
+};
+
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
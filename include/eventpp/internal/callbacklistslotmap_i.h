@@ -0,0 +1,718 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Don't include this header, include callbacklist.h instead
+
+#ifndef CALLBACKLISTSLOTMAP_I_H_EVENTPP
+#define CALLBACKLISTSLOTMAP_I_H_EVENTPP
+
+#include "../eventpolicies.h"
+#include "listenergroup_i.h"
+#include "parallelinvoke_i.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// OPT-61: Slot map storage for CallbackList.
+// Selected by `using ListenerStorage = eventpp::ListenerStorageSlotMap;`.
+//
+// The nodes are slots in a per-list table, linked by 32-bit indexes. The
+// table grows by chunks which never move. A Handle is the index of the slot
+// and its generation, 8 bytes without a control block, so remove and
+// ownsHandle compare the generation of one slot, O(1), and no reference
+// count is touched. The generations come from one counter per list type,
+// so the handle of another list, or of a removed listener, doesn't match.
+// It wraps after 2^32 listeners are added.
+//
+// A removed slot may still be walked by a reader, it's retired, and reused
+// by the next writer which sees no active readers, as the snapshot storage
+// frees its snapshots. NodeAllocator is not used, the slots are allocated
+// by chunks.
+template <
+	typename Prototype,
+	typename PoliciesType
+>
+class CallbackListSlotMapBase;
+
+template <
+	typename PoliciesType,
+	typename ReturnType, typename ...Args
+>
+class CallbackListSlotMapBase<
+	ReturnType (Args...),
+	PoliciesType
+>
+{
+private:
+	using Policies = PoliciesType;
+
+	using Threading = typename SelectThreading<Policies, HasTypeThreading<Policies>::value>::Type;
+
+	// OPT-75: The profiler is only supported by ListenerStorageLinkedList.
+	static_assert(std::is_same<typename SelectProfiler<Policies, HasTypeProfiler<Policies>::value>::Type, ProfilerNone>::value,
+		"CallbackList: ListenerStorageSlotMap doesn't support Profiler.");
+
+	using Callback_ = typename SelectCallback<
+		Policies,
+		HasTypeCallback<Policies>::value,
+		std::function<ReturnType (Args...)>
+	>::Type;
+
+	using CanContinueInvoking = typename SelectCanContinueInvoking<
+		Policies, HasFunctionCanContinueInvoking<Policies, Args...>::value
+	>::Type;
+
+	using Index = std::uint32_t;
+	using Generation = std::uint32_t;
+	using Counter = unsigned int;
+
+	enum : Index {
+		noIndex = 0xffffffffu
+	};
+
+	enum : Counter {
+		removedCounter = 0
+	};
+
+	enum : std::size_t {
+		chunkShift = 6,
+		chunkSize = std::size_t(1) << chunkShift
+	};
+
+	// OPT-47: With ListenerGroupsNone the group of a slot is empty, it's a
+	// base so it takes no space.
+	using ListenerGroup_ = typename SelectListenerGroup<Policies>::Group;
+	using GroupReference = typename SelectListenerGroup<Policies>::Reference;
+
+	struct Slot : public GroupReference
+	{
+		Callback_ callback;
+		Counter counter = removedCounter;
+		// 0 if the slot is removed or free.
+		Generation generation = 0;
+		// next is also the link of the free list.
+		Index previous = noIndex;
+		Index next = noIndex;
+
+		const GroupReference & group() const {
+			return *this;
+		}
+
+		void setGroup(GroupReference reference) {
+			static_cast<GroupReference &>(*this) = std::move(reference);
+		}
+	};
+
+	class Handle_
+	{
+	public:
+		Handle_() noexcept : index(noIndex), generation(0) {
+		}
+
+		// True if the handle is made by the list. It stays true after the
+		// listener is removed, use ownsHandle to check it.
+		operator bool () const noexcept {
+			return generation != 0;
+		}
+
+		// Unique among the handles of the lists of this type.
+		std::uint64_t getKey() const noexcept {
+			return (static_cast<std::uint64_t>(generation) << 32) | index;
+		}
+
+		friend bool operator == (const Handle_ & a, const Handle_ & b) noexcept {
+			return a.index == b.index && a.generation == b.generation;
+		}
+
+		friend bool operator != (const Handle_ & a, const Handle_ & b) noexcept {
+			return ! (a == b);
+		}
+
+	private:
+		Handle_(const Index index, const Generation generation) noexcept
+			: index(index), generation(generation) {
+		}
+
+		Index index;
+		Generation generation;
+
+		friend class CallbackListSlotMapBase;
+	};
+
+	static_assert(sizeof(Handle_) == 8, "CallbackListSlotMapBase: the handle should be 8 bytes.");
+
+	using ReaderCounter = typename Threading::template Atomic<int>;
+
+	struct ReaderGuard
+	{
+		explicit ReaderGuard(ReaderCounter & counter) : counter(counter) {
+			// Must be seq_cst to pair with the load in doReclaim, otherwise a
+			// writer may reuse a slot we are about to walk.
+			counter.fetch_add(1, std::memory_order_seq_cst);
+		}
+
+		~ReaderGuard() {
+			counter.fetch_sub(1, std::memory_order_release);
+		}
+
+		ReaderCounter & counter;
+	};
+
+	// The slot and the handle of a node, taken under the lock.
+	struct BatchItem
+	{
+		Slot * slot;
+		Index index;
+		Generation generation;
+	};
+
+public:
+	using Callback = Callback_;
+	using Handle = Handle_;
+	using Mutex = typename Threading::Mutex;
+
+public:
+	CallbackListSlotMapBase() noexcept
+		:
+			chunkList(),
+			slotCount(0),
+			head(noIndex),
+			tail(noIndex),
+			freeHead(noIndex),
+			retiredList(),
+			linkedCount(0),
+			readerCount(0),
+			mutex(),
+			currentCounter(0)
+	{
+	}
+
+	CallbackListSlotMapBase(const CallbackListSlotMapBase & other)
+		: CallbackListSlotMapBase()
+	{
+		cloneFrom(other);
+	}
+
+	CallbackListSlotMapBase(CallbackListSlotMapBase && other) noexcept
+		: CallbackListSlotMapBase()
+	{
+		swap(other);
+	}
+
+	CallbackListSlotMapBase & operator = (const CallbackListSlotMapBase & other) {
+		if(this != &other) {
+			CallbackListSlotMapBase copied(other);
+			swap(copied);
+		}
+		return *this;
+	}
+
+	CallbackListSlotMapBase & operator = (CallbackListSlotMapBase && other) noexcept {
+		if(this != &other) {
+			swap(other);
+		}
+		return *this;
+	}
+
+	void swap(CallbackListSlotMapBase & other) noexcept {
+		using std::swap;
+
+		swap(chunkList, other.chunkList);
+		swap(slotCount, other.slotCount);
+		swap(head, other.head);
+		swap(tail, other.tail);
+		swap(freeHead, other.freeHead);
+		swap(retiredList, other.retiredList);
+
+		const auto count = linkedCount.load();
+		linkedCount.exchange(other.linkedCount.load());
+		other.linkedCount.exchange(count);
+
+		const auto value = currentCounter.load();
+		currentCounter.exchange(other.currentCounter.load());
+		other.currentCounter.exchange(value);
+	}
+
+	bool empty() const {
+		return linkedCount.load(std::memory_order_acquire) == 0;
+	}
+
+	operator bool() const {
+		return ! empty();
+	}
+
+	Handle append(const Callback & callback)
+	{
+		return doAppend(callback, GroupReference());
+	}
+
+	Handle append(const Callback & callback, ListenerGroup_ & group)
+	{
+		return doAppend(callback, group.doGetReference());
+	}
+
+	// OPT-87: See CallbackList::appendBulk. The slots are allocated and
+	// linked under one lock.
+	template <typename Iterator>
+	void appendBulk(Iterator first, Iterator last)
+	{
+		doAppendBulk(first, last, BulkItemSelf(), DiscardIterator());
+	}
+
+	template <typename Iterator, typename OutputIterator>
+	OutputIterator appendBulk(Iterator first, Iterator last, OutputIterator handles)
+	{
+		return doAppendBulk(first, last, BulkItemSelf(), handles);
+	}
+
+	template <typename Iterator, typename GetCallback, typename OutputIterator>
+	OutputIterator doAppendBulk(Iterator first, Iterator last, GetCallback && getCallback, OutputIterator handles)
+	{
+		if(first == last) {
+			return handles;
+		}
+
+		const Counter counter = getNextCounter();
+
+		std::lock_guard<Mutex> lockGuard(mutex);
+
+		size_t count = 0;
+		for(; first != last; ++first) {
+			const auto & item = *first;
+			const Index index = doAllocateSlot(getCallback(item), counter, GroupReference());
+			Slot & slot = doGetSlot(index);
+			slot.previous = tail;
+			slot.next = noIndex;
+			if(tail != noIndex) {
+				doGetSlot(tail).next = index;
+			}
+			else {
+				head = index;
+			}
+			tail = index;
+			*handles = Handle(index, slot.generation);
+			++handles;
+			++count;
+		}
+		linkedCount.fetch_add(count, std::memory_order_release);
+
+		return handles;
+	}
+
+	Handle prepend(const Callback & callback)
+	{
+		return doPrepend(callback, GroupReference());
+	}
+
+	Handle prepend(const Callback & callback, ListenerGroup_ & group)
+	{
+		return doPrepend(callback, group.doGetReference());
+	}
+
+	Handle insert(const Callback & callback, const Handle & before)
+	{
+		return doInsertBefore(callback, before, GroupReference());
+	}
+
+	Handle insert(const Callback & callback, const Handle & before, ListenerGroup_ & group)
+	{
+		return doInsertBefore(callback, before, group.doGetReference());
+	}
+
+	bool remove(const Handle & handle)
+	{
+		std::lock_guard<Mutex> lockGuard(mutex);
+
+		if(! doIsValid(handle)) {
+			return false;
+		}
+		Slot & slot = doGetSlot(handle.index);
+		// Mark it as deleted so any reader still walking it skips it.
+		slot.counter = removedCounter;
+		doUnlinkSlot(handle.index);
+		doReclaim();
+
+		return true;
+	}
+
+	bool ownsHandle(const Handle & handle) const
+	{
+		std::lock_guard<Mutex> lockGuard(mutex);
+
+		return doIsValid(handle);
+	}
+
+	template <typename Func>
+	void forEach(Func && func) const
+	{
+		doForEachIf([&func, this](const BatchItem & item) -> bool {
+			doForEachInvoke<void>(func, item);
+			return true;
+		});
+	}
+
+	template <typename Func>
+	bool forEachIf(Func && func) const
+	{
+		return doForEachIf([&func, this](const BatchItem & item) -> bool {
+			return doForEachInvoke<bool>(func, item);
+		});
+	}
+
+	void operator() (Args ...args) const
+	{
+		doForEachIf([&args...](const BatchItem & item) -> bool {
+			// Don't std::forward, see CallbackListBase::operator().
+			item.slot->callback(args...);
+			return CanContinueInvoking::canContinueInvoking(args...);
+		});
+	}
+
+	// OPT-64: Same as CallbackListBase::invokeParallel.
+	template <typename Executor>
+	void invokeParallel(Executor & executor, Args ...args) const
+	{
+		doInvokeParallel(
+			executor,
+			std::integral_constant<bool, HasFunctionCanContinueInvoking<Policies, Args...>::value>(),
+			args...
+		);
+	}
+
+private:
+	template <typename Executor>
+	void doInvokeParallel(Executor & /*executor*/, std::true_type, Args ...args) const
+	{
+		(*this)(args...);
+	}
+
+	// readerCount is held until all the listeners return, so the slots are
+	// not reused during the call.
+	template <typename Executor>
+	void doInvokeParallel(Executor & executor, std::false_type, Args ...args) const
+	{
+		ReaderGuard readerGuard(readerCount);
+
+		std::vector<const Slot *> slotList;
+		doForEachIf([&slotList](const BatchItem & item) -> bool {
+			slotList.push_back(item.slot);
+			return true;
+		});
+
+		internal_::parallelInvoke(executor, slotList.size(), [&slotList, &args...](const std::size_t index) {
+			const Slot * slot = slotList[index];
+			if(slot->counter != removedCounter && ! slot->group().isRemoved()) {
+				slot->callback(args...);
+			}
+		});
+	}
+
+	// Same batched walk as CallbackListBase. The slots in the batch are not
+	// reused while readerCount is held, so they are used without the lock.
+	template <typename F>
+	bool doForEachIf(F && f) const
+	{
+		const Counter counter = currentCounter.load(std::memory_order_acquire);
+
+		ReaderGuard readerGuard(readerCount);
+
+		static constexpr std::size_t kBatchSize = 8;
+		BatchItem batch[kBatchSize];
+
+		Index index;
+		{
+			std::lock_guard<Mutex> lockGuard(mutex);
+			index = head;
+		}
+
+		while(index != noIndex) {
+			std::size_t count = 0;
+			{
+				std::lock_guard<Mutex> lockGuard(mutex);
+				Index current = index;
+				while(current != noIndex && count < kBatchSize) {
+					Slot & slot = doGetSlot(current);
+					// OPT-47: Unlink the nodes of the removed groups. They stay
+					// in the batch, and are skipped.
+					if(slot.generation != 0 && slot.group().isRemoved()) {
+						doUnlinkSlot(current);
+					}
+					batch[count++] = BatchItem { &slot, current, slot.generation };
+					current = slot.next;
+				}
+			}
+
+			for(std::size_t i = 0; i < count; ++i) {
+				const Slot * slot = batch[i].slot;
+				if(slot->counter != removedCounter && counter >= slot->counter
+					&& ! slot->group().isRemoved()) {
+					if(! f(batch[i])) {
+						return false;
+					}
+				}
+			}
+
+			{
+				std::lock_guard<Mutex> lockGuard(mutex);
+				index = batch[count - 1].slot->next;
+			}
+		}
+
+		return true;
+	}
+
+	template <typename RT, typename Func>
+	auto doForEachInvoke(Func && func, const BatchItem & item) const
+		-> typename std::enable_if<CanInvoke<Func, Handle, Callback &>::value, RT>::type
+	{
+		return func(Handle(item.index, item.generation), item.slot->callback);
+	}
+
+	template <typename RT, typename Func>
+	auto doForEachInvoke(Func && func, const BatchItem & item) const
+		-> typename std::enable_if<CanInvoke<Func, Callback &>::value, RT>::type
+	{
+		return func(item.slot->callback);
+	}
+
+	Handle doAppend(const Callback & callback, GroupReference group)
+	{
+		const Counter counter = getNextCounter();
+
+		std::lock_guard<Mutex> lockGuard(mutex);
+
+		const Index index = doAllocateSlot(callback, counter, std::move(group));
+		Slot & slot = doGetSlot(index);
+		slot.previous = tail;
+		slot.next = noIndex;
+		if(tail != noIndex) {
+			doGetSlot(tail).next = index;
+		}
+		else {
+			head = index;
+		}
+		tail = index;
+		linkedCount.fetch_add(1, std::memory_order_release);
+
+		return Handle(index, slot.generation);
+	}
+
+	Handle doPrepend(const Callback & callback, GroupReference group)
+	{
+		const Counter counter = getNextCounter();
+
+		std::lock_guard<Mutex> lockGuard(mutex);
+
+		const Index index = doAllocateSlot(callback, counter, std::move(group));
+		Slot & slot = doGetSlot(index);
+		slot.previous = noIndex;
+		slot.next = head;
+		if(head != noIndex) {
+			doGetSlot(head).previous = index;
+		}
+		else {
+			tail = index;
+		}
+		head = index;
+		linkedCount.fetch_add(1, std::memory_order_release);
+
+		return Handle(index, slot.generation);
+	}
+
+	Handle doInsertBefore(const Callback & callback, const Handle & before, GroupReference group)
+	{
+		const Counter counter = getNextCounter();
+
+		{
+			std::lock_guard<Mutex> lockGuard(mutex);
+
+			if(doIsValid(before)) {
+				const Index index = doAllocateSlot(callback, counter, std::move(group));
+				Slot & slot = doGetSlot(index);
+				Slot & beforeSlot = doGetSlot(before.index);
+				slot.previous = beforeSlot.previous;
+				slot.next = before.index;
+				if(beforeSlot.previous != noIndex) {
+					doGetSlot(beforeSlot.previous).next = index;
+				}
+				else {
+					head = index;
+				}
+				beforeSlot.previous = index;
+				linkedCount.fetch_add(1, std::memory_order_release);
+
+				return Handle(index, slot.generation);
+			}
+		}
+
+		return doAppend(callback, std::move(group));
+	}
+
+	// Must be called under the lock.
+	bool doIsValid(const Handle & handle) const
+	{
+		return handle.generation != 0
+			&& handle.index < slotCount
+			&& doGetSlot(handle.index).generation == handle.generation;
+	}
+
+	Slot & doGetSlot(const Index index) const
+	{
+		return chunkList[index >> chunkShift][index & (chunkSize - 1)];
+	}
+
+	// Must be called under the lock. Takes a free slot, or a new one.
+	Index doAllocateSlot(const Callback & callback, const Counter counter, GroupReference group)
+	{
+		Index index = freeHead;
+		if(index != noIndex) {
+			freeHead = doGetSlot(index).next;
+		}
+		else {
+			if((slotCount & (chunkSize - 1)) == 0) {
+				chunkList.emplace_back(new Slot[chunkSize]);
+			}
+			index = static_cast<Index>(slotCount++);
+		}
+
+		Slot & slot = doGetSlot(index);
+		slot.callback = callback;
+		slot.counter = counter;
+		slot.generation = doGetNextGeneration();
+		slot.setGroup(std::move(group));
+		return index;
+	}
+
+	static Generation doGetNextGeneration()
+	{
+		static std::atomic<Generation> generationCounter(0);
+		Generation result = generationCounter.fetch_add(1, std::memory_order_relaxed) + 1;
+		while(result == 0) {
+			result = generationCounter.fetch_add(1, std::memory_order_relaxed) + 1;
+		}
+		return result;
+	}
+
+	// Must be called under the lock. It's const as the traversal unlinks the
+	// nodes of the removed groups. The links of the slot are kept, a reader
+	// may be on it, it's retired instead of freed.
+	void doUnlinkSlot(const Index index) const
+	{
+		Slot & slot = doGetSlot(index);
+		if(slot.next != noIndex) {
+			doGetSlot(slot.next).previous = slot.previous;
+		}
+		if(slot.previous != noIndex) {
+			doGetSlot(slot.previous).next = slot.next;
+		}
+		if(head == index) {
+			head = slot.next;
+		}
+		if(tail == index) {
+			tail = slot.previous;
+		}
+
+		slot.generation = 0;
+		linkedCount.fetch_sub(1, std::memory_order_release);
+		retiredList.push_back(index);
+	}
+
+	// Must be called under the lock. Any reader which increases readerCount
+	// after this load will lock the mutex and not see the retired slots.
+	void doReclaim()
+	{
+		if(retiredList.empty() || readerCount.load(std::memory_order_seq_cst) != 0) {
+			return;
+		}
+		for(const Index index : retiredList) {
+			Slot & slot = doGetSlot(index);
+			slot.callback = Callback();
+			slot.setGroup(GroupReference());
+			slot.next = freeHead;
+			freeHead = index;
+		}
+		retiredList.clear();
+	}
+
+	Counter getNextCounter()
+	{
+		Counter result = ++currentCounter;
+		if(result == 0) { // overflow, let's reset all nodes' counters.
+			{
+				std::lock_guard<Mutex> lockGuard(mutex);
+				for(Index index = head; index != noIndex; index = doGetSlot(index).next) {
+					doGetSlot(index).counter = 1;
+				}
+			}
+			result = ++currentCounter;
+		}
+
+		return result;
+	}
+
+	void cloneFrom(const CallbackListSlotMapBase & other)
+	{
+		// Before locking other, see CallbackListSnapshotBase::cloneFrom.
+		const Counter counter = getNextCounter();
+
+		std::lock_guard<Mutex> lockGuard(other.mutex);
+		for(Index index = other.head; index != noIndex; index = other.doGetSlot(index).next) {
+			const Slot & fromSlot = other.doGetSlot(index);
+			// The copy doesn't belong to the group, and the removed ones are not copied.
+			if(fromSlot.group().isRemoved()) {
+				continue;
+			}
+			const Index newIndex = doAllocateSlot(fromSlot.callback, counter, GroupReference());
+			Slot & slot = doGetSlot(newIndex);
+			slot.previous = tail;
+			if(tail != noIndex) {
+				doGetSlot(tail).next = newIndex;
+			}
+			else {
+				head = newIndex;
+			}
+			tail = newIndex;
+			linkedCount.fetch_add(1, std::memory_order_release);
+		}
+	}
+
+private:
+	std::vector<std::unique_ptr<Slot[]> > chunkList;
+	std::size_t slotCount;
+	// mutable as the traversal unlinks the nodes of the removed groups.
+	mutable Index head;
+	mutable Index tail;
+	Index freeHead;
+	mutable std::vector<Index> retiredList;
+	mutable typename Threading::template Atomic<std::size_t> linkedCount;
+	mutable ReaderCounter readerCount;
+	mutable Mutex mutex;
+	typename Threading::template Atomic<Counter> currentCounter;
+};
+
+
+} //namespace internal_
+
+
+} //namespace eventpp
+
+
+#endif
@@ -0,0 +1,639 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Don't include this header, include callbacklist.h instead
+
+#ifndef CALLBACKLISTSNAPSHOT_I_H
+#define CALLBACKLISTSNAPSHOT_I_H
+
+#include "../eventpolicies.h"
+#include "listenergroup_i.h"
+#include "parallelinvoke_i.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// OPT-16: Copy-on-write snapshot storage for CallbackList.
+// Selected by `using ListenerStorage = eventpp::ListenerStorageSnapshot;`.
+//
+// The listeners are held in a contiguous array which is published as an
+// immutable snapshot. append/prepend/insert/remove build a new snapshot under
+// the mutex and publish it with one atomic store (RCU style).
+// Invoking is one reader counter increment, one atomic load of the snapshot
+// and a linear walk over the array, without the mutex and without any
+// shared_ptr reference count traffic.
+//
+// Replaced snapshots are retired and freed by the next writer which sees no
+// active readers, or by the destructor.
+// This is the same trade off as any RCU: writes are O(n), reads are O(1) setup.
+template <
+	typename Prototype,
+	typename PoliciesType
+>
+class CallbackListSnapshotBase;
+
+template <
+	typename PoliciesType,
+	typename ReturnType, typename ...Args
+>
+class CallbackListSnapshotBase<
+	ReturnType (Args...),
+	PoliciesType
+>
+{
+private:
+	using Policies = PoliciesType;
+
+	using Threading = typename SelectThreading<Policies, HasTypeThreading<Policies>::value>::Type;
+
+	// OPT-75: The profiler is only supported by ListenerStorageLinkedList.
+	static_assert(std::is_same<typename SelectProfiler<Policies, HasTypeProfiler<Policies>::value>::Type, ProfilerNone>::value,
+		"CallbackList: ListenerStorageSnapshot doesn't support Profiler.");
+
+	using Callback_ = typename SelectCallback<
+		Policies,
+		HasTypeCallback<Policies>::value,
+		std::function<ReturnType (Args...)>
+	>::Type;
+
+	using CanContinueInvoking = typename SelectCanContinueInvoking<
+		Policies, HasFunctionCanContinueInvoking<Policies, Args...>::value
+	>::Type;
+
+	// OPT-47: With ListenerGroupsNone the group of a node is empty.
+	using ListenerGroup_ = typename SelectListenerGroup<Policies>::Group;
+	using GroupReference = typename SelectListenerGroup<Policies>::Reference;
+
+	struct Node;
+	using NodePtr = std::shared_ptr<Node>;
+	using NodeAllocator = typename SelectNodeAllocator<
+		Node, Policies, HasTemplateNodeAllocator<Policies>::value
+	>::Type;
+
+	struct Node
+	{
+		using Counter = unsigned int;
+
+		Node(const Callback_ & callback, const Counter counter, GroupReference group)
+			: callback(callback), counter(counter), group(std::move(group))
+		{
+		}
+
+		Callback_ callback;
+		Counter counter;
+		GroupReference group;
+	};
+
+	class Handle_ : public std::weak_ptr<Node>
+	{
+	private:
+		using super = std::weak_ptr<Node>;
+
+	public:
+		using super::super;
+
+		operator bool () const noexcept {
+			return ! this->expired();
+		}
+	};
+
+	using Counter = typename Node::Counter;
+	enum : Counter {
+		removedCounter = 0
+	};
+
+	// The snapshot owns the nodes. Readers only dereference the raw pointers
+	// held by the shared_ptr, so the reference counts are never touched on the
+	// invoking path.
+	struct Snapshot
+	{
+		std::vector<NodePtr> nodeList;
+		Snapshot * nextRetired;
+	};
+
+	using ReaderCounter = typename Threading::template Atomic<int>;
+
+	struct ReaderGuard
+	{
+		explicit ReaderGuard(ReaderCounter & counter) : counter(counter) {
+			// Must be seq_cst to pair with the seq_cst publish in doPublish,
+			// otherwise a writer may free a snapshot we are about to load.
+			counter.fetch_add(1, std::memory_order_seq_cst);
+		}
+
+		~ReaderGuard() {
+			counter.fetch_sub(1, std::memory_order_release);
+		}
+
+		ReaderCounter & counter;
+	};
+
+public:
+	using Callback = Callback_;
+	using Handle = Handle_;
+	using Mutex = typename Threading::Mutex;
+
+public:
+	CallbackListSnapshotBase() noexcept
+		:
+			snapshot(nullptr),
+			retiredList(nullptr),
+			readerCount(0),
+			mutex(),
+			currentCounter(0)
+	{
+	}
+
+	CallbackListSnapshotBase(const CallbackListSnapshotBase & other)
+		: CallbackListSnapshotBase()
+	{
+		cloneFrom(other);
+	}
+
+	CallbackListSnapshotBase(CallbackListSnapshotBase && other) noexcept
+		: CallbackListSnapshotBase()
+	{
+		swap(other);
+	}
+
+	CallbackListSnapshotBase & operator = (const CallbackListSnapshotBase & other) {
+		if(this != &other) {
+			CallbackListSnapshotBase copied(other);
+			swap(copied);
+		}
+		return *this;
+	}
+
+	CallbackListSnapshotBase & operator = (CallbackListSnapshotBase && other) noexcept {
+		if(this != &other) {
+			swap(other);
+		}
+		return *this;
+	}
+
+	~CallbackListSnapshotBase() {
+		// Don't lock mutex here since it may throw exception
+
+		doFreeSnapshot(snapshot.load(std::memory_order_acquire));
+		doFreeRetiredList(retiredList);
+	}
+
+	void swap(CallbackListSnapshotBase & other) noexcept {
+		using std::swap;
+
+		Snapshot * s = snapshot.load(std::memory_order_acquire);
+		snapshot.store(other.snapshot.load(std::memory_order_acquire), std::memory_order_seq_cst);
+		other.snapshot.store(s, std::memory_order_seq_cst);
+
+		swap(retiredList, other.retiredList);
+
+		const auto value = currentCounter.load();
+		currentCounter.exchange(other.currentCounter.load());
+		other.currentCounter.exchange(value);
+	}
+
+	bool empty() const {
+		return snapshot.load(std::memory_order_acquire) == nullptr;
+	}
+
+	operator bool() const {
+		return ! empty();
+	}
+
+	Handle append(const Callback & callback)
+	{
+		return doAppend(doAllocateNode(callback, GroupReference()));
+	}
+
+	Handle append(const Callback & callback, ListenerGroup_ & group)
+	{
+		return doAppend(doAllocateNode(callback, group.doGetReference()));
+	}
+
+	// OPT-87: See CallbackList::appendBulk. The snapshot is built once for
+	// all the callbacks, instead of once for each.
+	template <typename Iterator>
+	void appendBulk(Iterator first, Iterator last)
+	{
+		doAppendBulk(first, last, BulkItemSelf(), DiscardIterator());
+	}
+
+	template <typename Iterator, typename OutputIterator>
+	OutputIterator appendBulk(Iterator first, Iterator last, OutputIterator handles)
+	{
+		return doAppendBulk(first, last, BulkItemSelf(), handles);
+	}
+
+	template <typename Iterator, typename GetCallback, typename OutputIterator>
+	OutputIterator doAppendBulk(Iterator first, Iterator last, GetCallback && getCallback, OutputIterator handles)
+	{
+		if(first == last) {
+			return handles;
+		}
+
+		const Counter counter = getNextCounter();
+		std::vector<NodePtr> nodeList;
+		for(; first != last; ++first) {
+			const auto & item = *first;
+			nodeList.push_back(std::allocate_shared<Node>(NodeAllocator(), getCallback(item), counter, GroupReference()));
+			*handles = Handle(nodeList.back());
+			++handles;
+		}
+
+		std::lock_guard<Mutex> lockGuard(mutex);
+
+		const Snapshot * current = snapshot.load(std::memory_order_acquire);
+		const size_t count = (current == nullptr ? 0 : current->nodeList.size());
+		Snapshot * result = new Snapshot { std::vector<NodePtr>(), nullptr };
+		result->nodeList.reserve(count + nodeList.size());
+		for(size_t i = 0; i < count; ++i) {
+			if(! current->nodeList[i]->group.isRemoved()) {
+				result->nodeList.push_back(current->nodeList[i]);
+			}
+		}
+		for(NodePtr & node : nodeList) {
+			result->nodeList.push_back(std::move(node));
+		}
+		doPublish(result);
+
+		return handles;
+	}
+
+	Handle prepend(const Callback & callback)
+	{
+		return doPrepend(doAllocateNode(callback, GroupReference()));
+	}
+
+	Handle prepend(const Callback & callback, ListenerGroup_ & group)
+	{
+		return doPrepend(doAllocateNode(callback, group.doGetReference()));
+	}
+
+	Handle insert(const Callback & callback, const Handle & before)
+	{
+		return doInsertBefore(callback, before, GroupReference());
+	}
+
+	Handle insert(const Callback & callback, const Handle & before, ListenerGroup_ & group)
+	{
+		return doInsertBefore(callback, before, group.doGetReference());
+	}
+
+	bool remove(const Handle & handle)
+	{
+		std::lock_guard<Mutex> lockGuard(mutex);
+
+		auto node = handle.lock();
+		if(node) {
+			const Snapshot * current = snapshot.load(std::memory_order_acquire);
+			const size_t index = doFindNodeIndex(current, node.get());
+			if(current != nullptr && index < current->nodeList.size()) {
+				// Mark it as deleted so any reader still walking an older
+				// snapshot skips it, same as the linked list storage.
+				node->counter = removedCounter;
+				doPublish(doBuildSnapshot(current, index, nullptr, node.get()));
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool ownsHandle(const Handle & handle) const
+	{
+		std::lock_guard<Mutex> lockGuard(mutex);
+
+		auto node = handle.lock();
+		if(node) {
+			const Snapshot * current = snapshot.load(std::memory_order_acquire);
+			return current != nullptr && doFindNodeIndex(current, node.get()) < current->nodeList.size();
+		}
+
+		return false;
+	}
+
+	template <typename Func>
+	void forEach(Func && func) const
+	{
+		doForEachIf([&func, this](const NodePtr & node) -> bool {
+			doForEachInvoke<void>(func, node);
+			return true;
+		});
+	}
+
+	template <typename Func>
+	bool forEachIf(Func && func) const
+	{
+		return doForEachIf([&func, this](const NodePtr & node) -> bool {
+			return doForEachInvoke<bool>(func, node);
+		});
+	}
+
+	void operator() (Args ...args) const
+	{
+		const Counter counter = currentCounter.load(std::memory_order_acquire);
+
+		ReaderGuard readerGuard(readerCount);
+		const Snapshot * current = snapshot.load(std::memory_order_seq_cst);
+		if(current == nullptr) {
+			return;
+		}
+
+		for(const NodePtr & node : current->nodeList) {
+			const Node * rawNode = node.get();
+			if(rawNode->counter != removedCounter && counter >= rawNode->counter
+				&& ! rawNode->group.isRemoved()) {
+				// Don't std::forward, see CallbackListBase::operator().
+				rawNode->callback(args...);
+				if(! CanContinueInvoking::canContinueInvoking(args...)) {
+					break;
+				}
+			}
+		}
+	}
+
+	// OPT-64: Same as CallbackListBase::invokeParallel.
+	template <typename Executor>
+	void invokeParallel(Executor & executor, Args ...args) const
+	{
+		doInvokeParallel(
+			executor,
+			std::integral_constant<bool, HasFunctionCanContinueInvoking<Policies, Args...>::value>(),
+			args...
+		);
+	}
+
+private:
+	template <typename Executor>
+	void doInvokeParallel(Executor & /*executor*/, std::true_type, Args ...args) const
+	{
+		(*this)(args...);
+	}
+
+	// The nodes are copied, so they outlive the snapshot.
+	template <typename Executor>
+	void doInvokeParallel(Executor & executor, std::false_type, Args ...args) const
+	{
+		std::vector<NodePtr> nodeList;
+		doForEachIf([&nodeList](const NodePtr & node) -> bool {
+			nodeList.push_back(node);
+			return true;
+		});
+
+		internal_::parallelInvoke(executor, nodeList.size(), [&nodeList, &args...](const std::size_t index) {
+			const Node * node = nodeList[index].get();
+			if(node->counter != removedCounter && ! node->group.isRemoved()) {
+				node->callback(args...);
+			}
+		});
+	}
+
+	template <typename F>
+	bool doForEachIf(F && f) const
+	{
+		const Counter counter = currentCounter.load(std::memory_order_acquire);
+
+		ReaderGuard readerGuard(readerCount);
+		const Snapshot * current = snapshot.load(std::memory_order_seq_cst);
+		if(current == nullptr) {
+			return true;
+		}
+
+		for(const NodePtr & node : current->nodeList) {
+			if(node->counter != removedCounter && counter >= node->counter
+				&& ! node->group.isRemoved()) {
+				if(! f(node)) {
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	template <typename RT, typename Func>
+	auto doForEachInvoke(Func && func, const NodePtr & node) const
+		-> typename std::enable_if<CanInvoke<Func, Handle, Callback &>::value, RT>::type
+	{
+		return func(Handle(node), node->callback);
+	}
+
+	template <typename RT, typename Func>
+	auto doForEachInvoke(Func && func, const NodePtr & node) const
+		-> typename std::enable_if<CanInvoke<Func, Callback &>::value, RT>::type
+	{
+		return func(node->callback);
+	}
+
+	Handle doAppend(NodePtr node)
+	{
+		std::lock_guard<Mutex> lockGuard(mutex);
+
+		const Snapshot * current = snapshot.load(std::memory_order_acquire);
+		doPublish(doBuildSnapshot(current, current == nullptr ? 0 : current->nodeList.size(), &node, nullptr));
+
+		return Handle(node);
+	}
+
+	Handle doPrepend(NodePtr node)
+	{
+		std::lock_guard<Mutex> lockGuard(mutex);
+
+		const Snapshot * current = snapshot.load(std::memory_order_acquire);
+		doPublish(doBuildSnapshot(current, 0, &node, nullptr));
+
+		return Handle(node);
+	}
+
+	Handle doInsertBefore(const Callback & callback, const Handle & before, GroupReference group)
+	{
+		NodePtr node(doAllocateNode(callback, std::move(group)));
+		NodePtr beforeNode = before.lock();
+		if(beforeNode) {
+			std::lock_guard<Mutex> lockGuard(mutex);
+
+			const Snapshot * current = snapshot.load(std::memory_order_acquire);
+			const size_t index = doFindNodeIndex(current, beforeNode.get());
+			if(current != nullptr && index < current->nodeList.size()) {
+				doPublish(doBuildSnapshot(current, index, &node, nullptr));
+				return Handle(node);
+			}
+		}
+
+		return doAppend(std::move(node));
+	}
+
+	NodePtr doAllocateNode(const Callback & callback, GroupReference group)
+	{
+		return std::allocate_shared<Node>(NodeAllocator(), callback, getNextCounter(), std::move(group));
+	}
+
+	static size_t doFindNodeIndex(const Snapshot * current, const Node * node)
+	{
+		if(current == nullptr) {
+			return 0;
+		}
+		const size_t count = current->nodeList.size();
+		for(size_t i = 0; i < count; ++i) {
+			if(current->nodeList[i].get() == node) {
+				return i;
+			}
+		}
+		return count;
+	}
+
+	// Build a new snapshot from current.
+	// If nodeToInsert is not null, it's inserted at index.
+	// If nodeToRemove is not null, the node at index is dropped.
+	// OPT-47: The nodes of the removed groups are dropped too.
+	// Return nullptr if the new snapshot is empty.
+	static Snapshot * doBuildSnapshot(
+			const Snapshot * current,
+			const size_t index,
+			NodePtr * nodeToInsert,
+			const Node * nodeToRemove
+		)
+	{
+		const size_t count = (current == nullptr ? 0 : current->nodeList.size());
+		const size_t newCount = count + (nodeToInsert != nullptr ? 1 : 0) - (nodeToRemove != nullptr ? 1 : 0);
+		if(newCount == 0) {
+			return nullptr;
+		}
+
+		Snapshot * result = new Snapshot { std::vector<NodePtr>(), nullptr };
+		result->nodeList.reserve(newCount);
+		for(size_t i = 0; i < count; ++i) {
+			if(i == index) {
+				if(nodeToInsert != nullptr) {
+					result->nodeList.push_back(*nodeToInsert);
+				}
+				if(nodeToRemove != nullptr) {
+					continue;
+				}
+			}
+			if(! current->nodeList[i]->group.isRemoved()) {
+				result->nodeList.push_back(current->nodeList[i]);
+			}
+		}
+		if(nodeToInsert != nullptr && index >= count) {
+			result->nodeList.push_back(*nodeToInsert);
+		}
+		if(result->nodeList.empty()) {
+			delete result;
+			return nullptr;
+		}
+
+		return result;
+	}
+
+	// Must be called under mutex.
+	void doPublish(Snapshot * newSnapshot)
+	{
+		Snapshot * old = snapshot.exchange(newSnapshot, std::memory_order_seq_cst);
+		if(old != nullptr) {
+			old->nextRetired = retiredList;
+			retiredList = old;
+		}
+
+		// Any reader which increases readerCount after this load will see
+		// newSnapshot, so the retired ones are safe to free.
+		if(readerCount.load(std::memory_order_seq_cst) == 0) {
+			doFreeRetiredList(retiredList);
+			retiredList = nullptr;
+		}
+	}
+
+	static void doFreeSnapshot(Snapshot * s)
+	{
+		delete s;
+	}
+
+	static void doFreeRetiredList(Snapshot * s)
+	{
+		while(s != nullptr) {
+			Snapshot * next = s->nextRetired;
+			doFreeSnapshot(s);
+			s = next;
+		}
+	}
+
+	Counter getNextCounter()
+	{
+		Counter result = ++currentCounter;
+		if(result == 0) { // overflow, let's reset all nodes' counters.
+			{
+				std::lock_guard<Mutex> lockGuard(mutex);
+				const Snapshot * current = snapshot.load(std::memory_order_acquire);
+				if(current != nullptr) {
+					for(const NodePtr & node : current->nodeList) {
+						node->counter = 1;
+					}
+				}
+			}
+			result = ++currentCounter;
+		}
+
+		return result;
+	}
+
+	void cloneFrom(const CallbackListSnapshotBase & other)
+	{
+		// Taken before locking other, on overflow it locks our mutex, which
+		// may be the same as the mutex of other with StripedMutex.
+		const Counter counter = getNextCounter();
+
+		std::lock_guard<Mutex> lockGuard(other.mutex);
+
+		const Snapshot * fromSnapshot = other.snapshot.load(std::memory_order_acquire);
+		if(fromSnapshot == nullptr) {
+			return;
+		}
+
+		Snapshot * newSnapshot = new Snapshot { std::vector<NodePtr>(), nullptr };
+		newSnapshot->nodeList.reserve(fromSnapshot->nodeList.size());
+		for(const NodePtr & node : fromSnapshot->nodeList) {
+			// The copy doesn't belong to the group, and the removed ones are not copied.
+			if(! node->group.isRemoved()) {
+				newSnapshot->nodeList.push_back(std::allocate_shared<Node>(NodeAllocator(), node->callback, counter, GroupReference()));
+			}
+		}
+		if(newSnapshot->nodeList.empty()) {
+			delete newSnapshot;
+			return;
+		}
+		snapshot.store(newSnapshot, std::memory_order_seq_cst);
+	}
+
+private:
+	typename Threading::template Atomic<Snapshot *> snapshot;
+	Snapshot * retiredList;
+	mutable ReaderCounter readerCount;
+	mutable Mutex mutex;
+	typename Threading::template Atomic<Counter> currentCounter;
+};
+
+
+} //namespace internal_
+
+
+} //namespace eventpp
+
+
+#endif
+
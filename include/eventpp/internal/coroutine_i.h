@@ -0,0 +1,71 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef COROUTINE_I_H_EVENTPP
+#define COROUTINE_I_H_EVENTPP
+
+// The coroutine support needs C++20 and <coroutine>. Without them nothing
+// below is compiled, and the C++14 build is not changed.
+#if !defined(EVENTPP_HAS_COROUTINE)
+	#if defined(__cpp_impl_coroutine) && defined(__has_include)
+		#if __has_include(<coroutine>)
+			#define EVENTPP_HAS_COROUTINE 1
+		#endif
+	#endif
+#endif
+#if !defined(EVENTPP_HAS_COROUTINE)
+	#define EVENTPP_HAS_COROUTINE 0
+#endif
+
+#if EVENTPP_HAS_COROUTINE
+
+#include <coroutine>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// OPT-50: How a coroutine suspended in EventQueue::next or batch is
+// resumed, by its executor, or in the thread which wakes it if it has none.
+struct CoroutineResumer
+{
+	using Post = void (*)(void * executor, std::coroutine_handle<> handle);
+
+	std::coroutine_handle<> handle;
+	void * executor = nullptr;
+	Post post = nullptr;
+
+	void resume() const {
+		if(executor != nullptr) {
+			post(executor, handle);
+		}
+		else {
+			handle.resume();
+		}
+	}
+};
+
+template <typename Executor>
+void postToExecutor(void * executor, std::coroutine_handle<> handle)
+{
+	static_cast<Executor *>(executor)->post(handle);
+}
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
+
+#endif
+
@@ -0,0 +1,274 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EPOCHRECLAIMER_I_H_EVENTPP
+#define EPOCHRECLAIMER_I_H_EVENTPP
+
+#include "../eventpolicies.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// OPT-39: Epoch based reclamation, shared by all lists in the process.
+// A reader holds a ReadGuard while it uses the objects it found through an
+// atomic pointer. It only writes the record of its own thread. An object
+// which was unpublished from the pointer is given to retire, and is freed
+// once every thread which was reading when it was retired has left its
+// guard. If no such thread is reading, retire frees it at once, else the
+// retiring thread frees it later, when it leaves a guard or retires again.
+// Nothing here takes a lock, except for the objects left by the threads
+// which exited.
+class EpochReclaimer
+{
+private:
+	struct RetiredItem
+	{
+		std::uint64_t epoch;
+		std::shared_ptr<void> object;
+	};
+
+	// The records are never freed, a record of an exited thread is reused.
+	struct ThreadRecord
+	{
+		// The global epoch when the outermost guard was entered, 0 if the
+		// thread isn't reading.
+		std::atomic<std::uint64_t> epoch;
+		std::atomic<bool> inUse;
+		ThreadRecord * next;
+		unsigned int depth;
+		// The guards to leave before trying to reclaim again, after a try
+		// which couldn't free everything.
+		unsigned int reclaimSkipCount;
+		unsigned int reclaimBackoff;
+		// Only used by the owner thread.
+		std::vector<RetiredItem> retiredList;
+		// Padded rather than aligned, so it can be allocated by new in C++14.
+		char padding[EVENTPP_CACHELINE_SIZE];
+	};
+
+	enum { maxReclaimBackoff = 64 };
+
+	struct Registry
+	{
+		std::atomic<std::uint64_t> epoch;
+		std::atomic<ThreadRecord *> recordHead;
+		std::atomic<bool> hasOrphan;
+		std::mutex orphanMutex;
+		std::vector<RetiredItem> orphanList;
+	};
+
+	// Gives the record back when the thread exits.
+	struct ThreadRecordHolder
+	{
+		ThreadRecordHolder() : record(doAcquireRecord())
+		{
+		}
+
+		~ThreadRecordHolder()
+		{
+			doReclaim(*record);
+			if(! record->retiredList.empty()) {
+				Registry & registry = doGetRegistry();
+				std::lock_guard<std::mutex> lockGuard(registry.orphanMutex);
+				for(auto & item : record->retiredList) {
+					registry.orphanList.push_back(std::move(item));
+				}
+				record->retiredList.clear();
+				registry.hasOrphan.store(true, std::memory_order_release);
+			}
+			record->inUse.store(false, std::memory_order_release);
+		}
+
+		ThreadRecord * record;
+	};
+
+public:
+	class ReadGuard
+	{
+	public:
+		ReadGuard() : record(doGetThreadRecord())
+		{
+			if(record.depth++ == 0) {
+				record.epoch.store(doGetRegistry().epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+				// Pairs with the fence in doReclaim, either the reclaimer sees
+				// this reader, or this reader sees the unpublished pointer.
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+			}
+		}
+
+		~ReadGuard()
+		{
+			if(--record.depth == 0) {
+				record.epoch.store(0, std::memory_order_release);
+				if(! record.retiredList.empty() || doGetRegistry().hasOrphan.load(std::memory_order_relaxed)) {
+					if(record.reclaimSkipCount > 0) {
+						--record.reclaimSkipCount;
+					}
+					else {
+						doReclaim(record);
+						doUpdateBackoff(record);
+					}
+				}
+			}
+		}
+
+		ReadGuard(const ReadGuard &) = delete;
+		ReadGuard & operator = (const ReadGuard &) = delete;
+
+	private:
+		ThreadRecord & record;
+	};
+
+	// object must be unpublished already, no new reader can find it.
+	static void retire(std::shared_ptr<void> object)
+	{
+		ThreadRecord & record = doGetThreadRecord();
+		const std::uint64_t epoch = doGetRegistry().epoch.fetch_add(1, std::memory_order_acq_rel);
+		record.retiredList.push_back(RetiredItem { epoch, std::move(object) });
+		doReclaim(record);
+	}
+
+	// The count of the objects retired by this thread, or by the exited
+	// threads, which are not freed yet.
+	static std::size_t getRetiredCount()
+	{
+		Registry & registry = doGetRegistry();
+		std::lock_guard<std::mutex> lockGuard(registry.orphanMutex);
+		return doGetThreadRecord().retiredList.size() + registry.orphanList.size();
+	}
+
+private:
+	// Never destroyed, the threads which exit after main still use it.
+	static Registry & doGetRegistry()
+	{
+		static Registry * registry = doCreateRegistry();
+		return *registry;
+	}
+
+	static Registry * doCreateRegistry()
+	{
+		Registry * registry = new Registry();
+		registry->epoch.store(1, std::memory_order_relaxed);
+		registry->recordHead.store(nullptr, std::memory_order_relaxed);
+		registry->hasOrphan.store(false, std::memory_order_relaxed);
+		return registry;
+	}
+
+	static ThreadRecord & doGetThreadRecord()
+	{
+		static thread_local ThreadRecordHolder holder;
+		return *holder.record;
+	}
+
+	static ThreadRecord * doAcquireRecord()
+	{
+		Registry & registry = doGetRegistry();
+		for(ThreadRecord * record = registry.recordHead.load(std::memory_order_acquire); record != nullptr; record = record->next) {
+			bool inUse = false;
+			if(! record->inUse.load(std::memory_order_relaxed)
+				&& record->inUse.compare_exchange_strong(inUse, true, std::memory_order_acq_rel)) {
+				return record;
+			}
+		}
+
+		ThreadRecord * record = new ThreadRecord();
+		record->epoch.store(0, std::memory_order_relaxed);
+		record->inUse.store(true, std::memory_order_relaxed);
+		record->depth = 0;
+		record->reclaimSkipCount = 0;
+		record->reclaimBackoff = 0;
+		record->next = registry.recordHead.load(std::memory_order_relaxed);
+		while(! registry.recordHead.compare_exchange_weak(record->next, record, std::memory_order_release, std::memory_order_relaxed)) {
+		}
+		return record;
+	}
+
+	// The readers which block the rest are still reading, trying at each
+	// guard would scan all records for nothing.
+	static void doUpdateBackoff(ThreadRecord & record)
+	{
+		if(record.retiredList.empty()) {
+			record.reclaimBackoff = 0;
+		}
+		else {
+			record.reclaimBackoff = (record.reclaimBackoff == 0 ? 1 : (std::min)(record.reclaimBackoff * 2, static_cast<unsigned int>(maxReclaimBackoff)));
+		}
+		record.reclaimSkipCount = record.reclaimBackoff;
+	}
+
+	// A reader which entered after an object was retired read a later
+	// epoch, so the object tagged e can be freed when every reader is at an
+	// epoch after e. The objects are freed after the lists are updated,
+	// their destructors may retire more.
+	static void doReclaim(ThreadRecord & record)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		Registry & registry = doGetRegistry();
+		std::uint64_t minEpoch = (std::numeric_limits<std::uint64_t>::max)();
+		for(const ThreadRecord * r = registry.recordHead.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+			const std::uint64_t epoch = r->epoch.load(std::memory_order_acquire);
+			if(epoch != 0 && epoch < minEpoch) {
+				minEpoch = epoch;
+			}
+		}
+
+		std::vector<std::shared_ptr<void> > freeList;
+		doCollect(record.retiredList, minEpoch, freeList);
+
+		if(registry.hasOrphan.load(std::memory_order_acquire)) {
+			std::unique_lock<std::mutex> lock(registry.orphanMutex, std::try_to_lock);
+			if(lock.owns_lock()) {
+				doCollect(registry.orphanList, minEpoch, freeList);
+				registry.hasOrphan.store(! registry.orphanList.empty(), std::memory_order_release);
+			}
+		}
+	}
+
+	static void doCollect(std::vector<RetiredItem> & retiredList, const std::uint64_t minEpoch, std::vector<std::shared_ptr<void> > & freeList)
+	{
+		std::size_t keptCount = 0;
+		for(std::size_t i = 0; i < retiredList.size(); ++i) {
+			RetiredItem & item = retiredList[i];
+			if(item.epoch < minEpoch) {
+				freeList.push_back(std::move(item.object));
+			}
+			else {
+				if(i != keptCount) {
+					retiredList[keptCount] = std::move(item);
+				}
+				++keptCount;
+			}
+		}
+		retiredList.resize(keptCount);
+	}
+};
+
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
+
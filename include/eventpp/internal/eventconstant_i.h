@@ -0,0 +1,70 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EVENTCONSTANT_I_H_EVENTPP
+#define EVENTCONSTANT_I_H_EVENTPP
+
+#include <atomic>
+#include <cstdint>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// OPT-72: Each dispatcher has an ID which is never reused in the process.
+// A dispatcher gets a new ID when its map is replaced, by assignment, move
+// or swap, so a cached CallbackList of the old map is never used.
+inline std::uint64_t getNextDispatcherId()
+{
+	static std::atomic<std::uint64_t> nextId(0);
+	return nextId.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+// The CallbackList of a compile-time event key, found by the dispatcher
+// which has dispatcherId. There is one cache for each thread, dispatcher
+// type and event key, so using the same key on several dispatchers of the
+// same type from one thread only makes the cache miss more, it's still
+// correct.
+template <typename CallbackList>
+struct EventConstantCache
+{
+	std::uint64_t dispatcherId;
+	const CallbackList * callbackList;
+};
+
+// Returns the cache of the calling thread for Owner and EventConstant.
+// The cache is trivially constructible, so it needs no guard.
+template <typename Owner, typename EventConstant, typename CallbackList>
+EventConstantCache<CallbackList> & getEventConstantCache()
+{
+	static thread_local EventConstantCache<CallbackList> cache { 0, nullptr };
+	return cache;
+}
+
+// OPT-79: The event of dispatch<EventConstant>, EventConstant::value. It's
+// specialized for the event types which name the event with a type, such
+// as TypeId.
+template <typename Event, typename EventConstant>
+struct EventConstantValue
+{
+	static const Event & get()
+	{
+		return EventConstant::value;
+	}
+};
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
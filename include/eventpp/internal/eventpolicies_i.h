@@ -89,6 +89,25 @@ class HasHash
 public:
 	enum { value = !! decltype(test<T>(0))() };
 };
+// OPT-37: A Map which can be looked up while it's inserted into.
+template <typename T>
+struct HasTypeConcurrentFind
+{
+	template <typename C> static std::true_type test(typename C::ConcurrentFind *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+// OPT-68: The map has reserve(size_t), such as std::unordered_map.
+template <typename T>
+struct HasFunctionReserve
+{
+	template <typename C> static std::true_type test(decltype(std::declval<C &>().reserve(std::size_t())) *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+
 template <typename Key, typename Value, typename T, bool>
 struct SelectMap
 {
@@ -121,6 +140,282 @@ struct SelectQueueList<Value, T, false> {
 	using Type = std::list<Value>;
 };
 
+// OPT-40: Allocator of the listener nodes of CallbackList, the nodes are
+// allocated together with their shared_ptr control block by allocate_shared.
+template <typename T>
+struct HasTemplateNodeAllocator
+{
+	template <typename C> static std::true_type test(typename C::template NodeAllocator<int> *);
+	template <typename C> static std::false_type test(...);
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename Value, typename T, bool>
+struct SelectNodeAllocator
+{
+	using Type = typename T::template NodeAllocator<Value>;
+};
+template <typename Value, typename T>
+struct SelectNodeAllocator<Value, T, false> {
+	using Type = std::allocator<Value>;
+};
+
+template <typename T>
+struct HasTypeListenerStorage
+{
+	template <typename C> static std::true_type test(typename C::ListenerStorage *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectListenerStorage { using Type = typename T::ListenerStorage; };
+template <typename T> struct SelectListenerStorage <T, false> { using Type = ListenerStorageLinkedList; };
+
+template <typename T>
+struct HasTypeReentrancy
+{
+	template <typename C> static std::true_type test(typename C::Reentrancy *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectReentrancy { using Type = typename T::Reentrancy; };
+template <typename T> struct SelectReentrancy <T, false> { using Type = ReentrancyFull; };
+
+template <typename T>
+struct HasTypeArgumentFanOut
+{
+	template <typename C> static std::true_type test(typename C::ArgumentFanOut *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectArgumentFanOut { using Type = typename T::ArgumentFanOut; };
+template <typename T> struct SelectArgumentFanOut <T, false> { using Type = ArgumentFanOutCopy; };
+
+template <typename T>
+struct HasTypeListenerGroups
+{
+	template <typename C> static std::true_type test(typename C::ListenerGroups *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectListenerGroups { using Type = typename T::ListenerGroups; };
+template <typename T> struct SelectListenerGroups <T, false> { using Type = ListenerGroupsNone; };
+
+template <typename T>
+struct HasTypeRingOverflow
+{
+	template <typename C> static std::true_type test(typename C::RingOverflow *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectRingOverflow { using Type = typename T::RingOverflow; };
+template <typename T> struct SelectRingOverflow <T, false> { using Type = RingOverflowBlock; };
+
+template <typename T>
+struct HasTypeRingProducer
+{
+	template <typename C> static std::true_type test(typename C::RingProducer *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectRingProducer { using Type = typename T::RingProducer; };
+template <typename T> struct SelectRingProducer <T, false> { using Type = RingProducerMulti; };
+
+template <typename T>
+struct HasTypeRingCapacity
+{
+	template <typename C> static std::true_type test(typename C::RingCapacity *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectRingCapacity { using Type = typename T::RingCapacity; };
+template <typename T> struct SelectRingCapacity <T, false> { using Type = std::integral_constant<std::size_t, 1024>; };
+
+template <typename T>
+struct HasTypeQueueStorage
+{
+	template <typename C> static std::true_type test(typename C::QueueStorage *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectQueueStorage { using Type = typename T::QueueStorage; };
+template <typename T> struct SelectQueueStorage <T, false> { using Type = QueueStorageList; };
+
+template <typename T>
+struct HasTypeTimer
+{
+	template <typename C> static std::true_type test(typename C::Timer *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectTimer { using Type = typename T::Timer; };
+template <typename T> struct SelectTimer <T, false> { using Type = TimerNone; };
+
+template <typename T>
+struct HasTypeTimerResolution
+{
+	template <typename C> static std::true_type test(typename C::TimerResolution *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectTimerResolution { using Type = typename T::TimerResolution; };
+template <typename T> struct SelectTimerResolution <T, false> { using Type = std::chrono::microseconds; };
+
+template <typename T>
+struct HasTypeClock
+{
+	template <typename C> static std::true_type test(typename C::Clock *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectClock { using Type = typename T::Clock; };
+template <typename T> struct SelectClock <T, false> { using Type = std::chrono::steady_clock; };
+
+// OPT-81: A virtual clock is moved by advanceTo, see VirtualClock.
+template <typename T>
+struct HasFunctionAdvanceTo
+{
+	template <typename C> static std::true_type test(decltype(C::advanceTo(std::declval<const typename C::time_point &>())) *) ;
+	template <typename C> static std::false_type test(...);
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+
+template <typename T>
+struct HasTypeQueueNotifier
+{
+	template <typename C> static std::true_type test(typename C::QueueNotifier *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectQueueNotifier { using Type = typename T::QueueNotifier; };
+template <typename T> struct SelectQueueNotifier <T, false> { using Type = QueueNotifierNone; };
+
+template <typename T>
+struct HasTypeWaitStrategy
+{
+	template <typename C> static std::true_type test(typename C::WaitStrategy *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectWaitStrategy { using Type = typename T::WaitStrategy; };
+template <typename T> struct SelectWaitStrategy <T, false> { using Type = WaitSpinThenPark<>; };
+
+// OPT-60: A WaitStrategy without monitor doesn't monitor.
+template <typename T, typename Enabled = void>
+struct IsWaitMonitor : std::false_type {};
+template <typename T>
+struct IsWaitMonitor <T, typename std::enable_if<T::monitor>::type> : std::true_type {};
+
+template <typename T>
+struct HasTypeQueueTimestamp
+{
+	template <typename C> static std::true_type test(typename C::QueueTimestamp *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectQueueTimestamp { using Type = typename T::QueueTimestamp; };
+template <typename T> struct SelectQueueTimestamp <T, false> { using Type = QueueTimestampNone; };
+
+template <typename T>
+struct HasTypeTracer
+{
+	template <typename C> static std::true_type test(typename C::Tracer *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectTracer { using Type = typename T::Tracer; };
+template <typename T> struct SelectTracer <T, false> { using Type = TracerNone; };
+
+template <typename T>
+struct HasTypeProfiler
+{
+	template <typename C> static std::true_type test(typename C::Profiler *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectProfiler { using Type = typename T::Profiler; };
+template <typename T> struct SelectProfiler <T, false> { using Type = ProfilerNone; };
+
+template <typename T>
+struct HasTypeQueueReply
+{
+	template <typename C> static std::true_type test(typename C::QueueReply *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectQueueReply { using Type = typename T::QueueReply; };
+template <typename T> struct SelectQueueReply <T, false> { using Type = QueueReplyNone; };
+
+template <typename T>
+struct HasTypeQueueCapacity
+{
+	template <typename C> static std::true_type test(typename C::QueueCapacity *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectQueueCapacity { using Type = typename T::QueueCapacity; };
+template <typename T> struct SelectQueueCapacity <T, false> { using Type = QueueCapacityNone; };
+
+template <typename T>
+struct HasTypeQueueOverflow
+{
+	template <typename C> static std::true_type test(typename C::QueueOverflow *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectQueueOverflow { using Type = typename T::QueueOverflow; };
+template <typename T> struct SelectQueueOverflow <T, false> { using Type = QueueOverflowBlock; };
+
+template <typename T>
+struct HasTypeQueueDeadline
+{
+	template <typename C> static std::true_type test(typename C::QueueDeadline *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectQueueDeadline { using Type = typename T::QueueDeadline; };
+template <typename T> struct SelectQueueDeadline <T, false> { using Type = QueueDeadlineNone; };
+
+template <typename T>
+struct HasTypeQueuePrefetchDistance
+{
+	template <typename C> static std::true_type test(typename C::QueuePrefetchDistance *) ;
+	template <typename C> static std::false_type test(...);    
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectQueuePrefetchDistance { using Type = typename T::QueuePrefetchDistance; };
+template <typename T> struct SelectQueuePrefetchDistance <T, false> { using Type = std::integral_constant<std::size_t, 4>; };
+
+template <typename T, typename ...Args>
+struct HasFunctionGetTimeToLive
+{
+	template <typename C> static std::true_type test(decltype(C::getTimeToLive(std::declval<Args>()...)) *) ;
+	template <typename C> static std::false_type test(...);
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+
 template <typename T>
 struct HasTypeMixins
 {
@@ -176,6 +471,38 @@ struct ForEachMixins <Root, MixinList<>, Func>
 	}
 };
 
+// A mixin which doesn't declare a hook inherits it from the mixins below it.
+// The hook is only called for the mixin which declares it, so it's not called
+// twice. The owner is void if it can't be told, such as an overloaded hook,
+// then the hook is called.
+template <typename T>
+struct MemberFunctionClass
+{
+	using Type = void;
+};
+
+template <typename C, typename R, typename ...A>
+struct MemberFunctionClass <R (C::*)(A...)>
+{
+	using Type = C;
+};
+
+template <typename C, typename R, typename ...A>
+struct MemberFunctionClass <R (C::*)(A...) const>
+{
+	using Type = C;
+};
+
+template <typename T, typename ...Args>
+struct MixinBeforeDispatchOwner
+{
+	template <typename C> static typename MemberFunctionClass<decltype(&C::template mixinBeforeDispatch<Args...>)>::Type * test(int);
+	template <typename C> static typename MemberFunctionClass<decltype(&C::mixinBeforeDispatch)>::Type * test(long);
+	template <typename C> static void * test(...);
+
+	using Type = typename std::remove_pointer<decltype(test<T>(0))>::type;
+};
+
 template <typename T, typename ...Args>
 struct HasFunctionMixinBeforeDispatch
 {
@@ -184,8 +511,169 @@ struct HasFunctionMixinBeforeDispatch
 	);
 	template <typename C> static std::false_type test(...);    
 
-	enum { value = !! decltype(test<T>(0))() };
+	using Owner = typename MixinBeforeDispatchOwner<T, Args...>::Type;
+
+	enum { value = !! decltype(test<T>(0))() && (std::is_same<Owner, void>::value || std::is_same<Owner, T>::value) };
+};
+
+// OPT-44: mixinBeforeDispatchEvent(e, args...) is mixinBeforeDispatch
+// which also receives the event. Args are the arguments after the event.
+template <typename T, typename ...Args>
+struct MixinBeforeDispatchEventOwner
+{
+	template <typename C> static typename MemberFunctionClass<decltype(&C::template mixinBeforeDispatchEvent<Args...>)>::Type * test(int);
+	template <typename C> static typename MemberFunctionClass<decltype(&C::mixinBeforeDispatchEvent)>::Type * test(long);
+	template <typename C> static void * test(...);
+
+	using Type = typename std::remove_pointer<decltype(test<T>(0))>::type;
+};
+
+template <typename T, typename Event, typename ...Args>
+struct HasFunctionMixinBeforeDispatchEvent
+{
+	template <typename C> static std::true_type test(
+		decltype(std::declval<C>().mixinBeforeDispatchEvent(std::declval<Event>(), std::declval<Args>()...)) *
+	);
+	template <typename C> static std::false_type test(...);
+
+	using Owner = typename MixinBeforeDispatchEventOwner<T, Args...>::Type;
+
+	enum { value = !! decltype(test<T>(0))() && (std::is_same<Owner, void>::value || std::is_same<Owner, T>::value) };
+};
+
+template <typename T, typename ...Args>
+struct MixinAfterDispatchOwner
+{
+	template <typename C> static typename MemberFunctionClass<decltype(&C::template mixinAfterDispatch<Args...>)>::Type * test(int);
+	template <typename C> static typename MemberFunctionClass<decltype(&C::mixinAfterDispatch)>::Type * test(long);
+	template <typename C> static void * test(...);
+
+	using Type = typename std::remove_pointer<decltype(test<T>(0))>::type;
 };
 
+template <typename T, typename ...Args>
+struct HasFunctionMixinAfterDispatch
+{
+	template <typename C> static std::true_type test(
+		decltype(std::declval<C>().mixinAfterDispatch(std::declval<Args>()...)) *
+	);
+	template <typename C> static std::false_type test(...);    
+
+	using Owner = typename MixinAfterDispatchOwner<T, Args...>::Type;
+
+	enum { value = !! decltype(test<T>(0))() && (std::is_same<Owner, void>::value || std::is_same<Owner, T>::value) };
+};
+
+template <typename T, typename ...Args>
+struct MixinAfterEnqueueOwner
+{
+	template <typename C> static typename MemberFunctionClass<decltype(&C::template mixinAfterEnqueue<Args...>)>::Type * test(int);
+	template <typename C> static typename MemberFunctionClass<decltype(&C::mixinAfterEnqueue)>::Type * test(long);
+	template <typename C> static void * test(...);
+
+	using Type = typename std::remove_pointer<decltype(test<T>(0))>::type;
+};
+
+template <typename T, typename ...Args>
+struct HasFunctionMixinAfterEnqueue
+{
+	template <typename C> static std::true_type test(
+		decltype(std::declval<C>().mixinAfterEnqueue(std::declval<Args>()...)) *
+	);
+	template <typename C> static std::false_type test(...);    
+
+	using Owner = typename MixinAfterEnqueueOwner<T, Args...>::Type;
+
+	enum { value = !! decltype(test<T>(0))() && (std::is_same<Owner, void>::value || std::is_same<Owner, T>::value) };
+};
+
+template <typename T, typename ...Args>
+struct MixinAfterDequeueOwner
+{
+	template <typename C> static typename MemberFunctionClass<decltype(&C::template mixinAfterDequeue<Args...>)>::Type * test(int);
+	template <typename C> static typename MemberFunctionClass<decltype(&C::mixinAfterDequeue)>::Type * test(long);
+	template <typename C> static void * test(...);
+
+	using Type = typename std::remove_pointer<decltype(test<T>(0))>::type;
+};
+
+template <typename T, typename ...Args>
+struct HasFunctionMixinAfterDequeue
+{
+	template <typename C> static std::true_type test(
+		decltype(std::declval<C>().mixinAfterDequeue(std::declval<Args>()...)) *
+	);
+	template <typename C> static std::false_type test(...);    
+
+	using Owner = typename MixinAfterDequeueOwner<T, Args...>::Type;
+
+	enum { value = !! decltype(test<T>(0))() && (std::is_same<Owner, void>::value || std::is_same<Owner, T>::value) };
+};
+
+// OPT-56: mixinBeforeEnqueue(e) is called by each enqueue function of
+// EventQueue before the event takes a node, the event is not enqueued if it
+// returns false.
+// mixinBeforeProcess() is called when each process function starts.
+template <typename T>
+struct MixinBeforeEnqueueOwner
+{
+	template <typename C> static typename MemberFunctionClass<decltype(&C::mixinBeforeEnqueue)>::Type * test(int);
+	template <typename C> static void * test(...);
+
+	using Type = typename std::remove_pointer<decltype(test<T>(0))>::type;
+};
+
+template <typename T, typename Event>
+struct HasFunctionMixinBeforeEnqueue
+{
+	template <typename C> static std::true_type test(
+		decltype(std::declval<C>().mixinBeforeEnqueue(std::declval<Event>())) *
+	);
+	template <typename C> static std::false_type test(...);
+
+	using Owner = typename MixinBeforeEnqueueOwner<T>::Type;
+
+	enum { value = !! decltype(test<T>(0))() && (std::is_same<Owner, void>::value || std::is_same<Owner, T>::value) };
+};
+
+// Whether any mixin in TList has mixinBeforeEnqueue. The bulk enqueues only
+// check the events one by one if one has.
+template <typename Root, typename TList, typename Event>
+struct AnyMixinBeforeEnqueue;
+
+template <typename Root, template <typename> class T, template <typename> class ...Args, typename Event>
+struct AnyMixinBeforeEnqueue <Root, MixinList<T, Args...>, Event>
+{
+	enum { value = HasFunctionMixinBeforeEnqueue<typename InheritMixins<Root, MixinList<T, Args...> >::Type, Event>::value
+		|| AnyMixinBeforeEnqueue<Root, MixinList<Args...>, Event>::value };
+};
+
+template <typename Root, typename Event>
+struct AnyMixinBeforeEnqueue <Root, MixinList<>, Event>
+{
+	enum { value = false };
+};
+
+template <typename T>
+struct MixinBeforeProcessOwner
+{
+	template <typename C> static typename MemberFunctionClass<decltype(&C::mixinBeforeProcess)>::Type * test(int);
+	template <typename C> static void * test(...);
+
+	using Type = typename std::remove_pointer<decltype(test<T>(0))>::type;
+};
+
+template <typename T>
+struct HasFunctionMixinBeforeProcess
+{
+	template <typename C> static std::true_type test(
+		decltype(std::declval<C>().mixinBeforeProcess()) *
+	);
+	template <typename C> static std::false_type test(...);
+
+	using Owner = typename MixinBeforeProcessOwner<T>::Type;
+
+	enum { value = !! decltype(test<T>(0))() && (std::is_same<Owner, void>::value || std::is_same<Owner, T>::value) };
+};
 
 } //namespace internal_
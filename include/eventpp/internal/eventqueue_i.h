@@ -3,6 +3,11 @@
 
 #include <array>
 #include <cassert>
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 namespace eventpp {
 
@@ -24,6 +29,17 @@ struct MakeIndexSequence<0, Indexes...>
 	using Type = IndexSequence<Indexes...>;
 };
 
+// used by enqueueBulk, a std::tuple element is expanded to the arguments of enqueue.
+template <typename T>
+struct IsStdTuple : std::false_type
+{
+};
+
+template <typename ...Types>
+struct IsStdTuple <std::tuple<Types...> > : std::true_type
+{
+};
+
 template <typename T>
 struct CounterGuard
 {
@@ -38,6 +54,23 @@ struct CounterGuard
 	T & value;
 };
 
+// OPT-35: Converts to a T constructed from the references it holds, so
+// std::tuple<T>(InPlaceArgument) constructs the element from them in place.
+template <typename T, typename ...C>
+struct InPlaceArgument
+{
+	std::tuple<C &&...> args;
+
+	operator T () const {
+		return doMake(typename MakeIndexSequence<sizeof...(C)>::Type());
+	}
+
+	template <size_t ...Indexes>
+	T doMake(IndexSequence<Indexes...>) const {
+		return T(std::forward<C>(std::get<Indexes>(args))...);
+	}
+};
+
 using DtorFunc = void (*)(void *);
 
 template <typename T>
@@ -46,6 +79,17 @@ void commonDtor(void * instance)
 	reinterpret_cast<T *>(instance)->~T();
 }
 
+using RelocateFunc = void (*)(void *, void *);
+
+// Move constructs the object at to from the object at from, then destroys from.
+template <typename T>
+void commonRelocate(void * from, void * to)
+{
+	T * object = reinterpret_cast<T *>(from);
+	new (to) T(std::move(*object));
+	object->~T();
+}
+
 // used by EventQueue
 template <typename T>
 class BufferedItem
@@ -76,6 +120,15 @@ public:
 		dtor = &commonDtor<T>;
 	}
 
+	// OPT-35: The T returned by maker is constructed in the buffer, not moved.
+	template <typename Maker>
+	void setFrom(Maker && maker) {
+		assert(dtor == nullptr);
+
+		new (buffer.data()) T(maker());
+		dtor = &commonDtor<T>;
+	}
+
 	T & get() {
 		assert(dtor != nullptr);
 
@@ -164,6 +217,183 @@ private:
 	DtorFunc dtor;
 };
 
+// OPT-26: used by HeterEventQueue with QueueStoragePacked.
+// A contiguous buffer of items of different types. Each item takes its own
+// size rounded up to alignof(std::max_align_t), there is no per item header,
+// ItemTraits tells the size of an item and how to move and destroy it,
+//   static std::size_t getSize(const void * item);
+//   static void relocate(void * from, void * to);
+//   static void destroy(void * item);
+// The items are in [head, tail). The buffer grows by doubling and relocating
+// the items. clear keeps the memory, so a buffer which is reused doesn't
+// allocate any more once it has grown to the size of a burst.
+template <typename ItemTraits>
+class PackedItemBuffer
+{
+public:
+	static constexpr std::size_t alignment = alignof(std::max_align_t);
+
+public:
+	PackedItemBuffer() noexcept : data(nullptr), capacity(0), head(0), tail(0)
+	{
+	}
+
+	~PackedItemBuffer()
+	{
+		clear();
+		::operator delete(data);
+	}
+
+	PackedItemBuffer(const PackedItemBuffer &) = delete;
+	PackedItemBuffer & operator = (const PackedItemBuffer &) = delete;
+
+	void swap(PackedItemBuffer & other) noexcept {
+		using std::swap;
+		swap(data, other.data);
+		swap(capacity, other.capacity);
+		swap(head, other.head);
+		swap(tail, other.tail);
+	}
+
+	bool empty() const {
+		return head == tail;
+	}
+
+	std::size_t getCapacity() const {
+		return capacity;
+	}
+
+	template <typename U>
+	void push(U && item) {
+		using T = typename std::decay<U>::type;
+		static_assert(alignof(T) <= alignment, "Item is over aligned for PackedItemBuffer");
+
+		const std::size_t size = alignSize(sizeof(T));
+		new (doReserve(size)) T(std::forward<U>(item));
+		tail += size;
+	}
+
+	void * front() {
+		assert(! empty());
+
+		return data + head;
+	}
+
+	void popFront() {
+		void * item = front();
+		const std::size_t size = alignSize(ItemTraits::getSize(item));
+		ItemTraits::destroy(item);
+		doAdvanceHead(size);
+	}
+
+	// Relocates the first item to the end of other.
+	void moveFrontTo(PackedItemBuffer & other) {
+		void * item = front();
+		const std::size_t size = alignSize(ItemTraits::getSize(item));
+		ItemTraits::relocate(item, other.doReserve(size));
+		other.tail += size;
+		doAdvanceHead(size);
+	}
+
+	// Relocates all items to the end of other.
+	void moveAllTo(PackedItemBuffer & other) {
+		if(empty()) {
+			return;
+		}
+		if(other.empty() && other.capacity <= capacity) {
+			other.swap(*this);
+			return;
+		}
+		other.doReserve(tail - head);
+		while(! empty()) {
+			moveFrontTo(other);
+		}
+	}
+
+	// Calls func(item) on each item in order.
+	// If func returns true the item is destroyed, otherwise it's relocated
+	// to the end of remaining. The buffer is empty after the call.
+	template <typename F>
+	void extractIf(F && func, PackedItemBuffer & remaining) {
+		while(! empty()) {
+			if(func(front())) {
+				popFront();
+			}
+			else {
+				moveFrontTo(remaining);
+			}
+		}
+	}
+
+	// Calls func(item) on each item in order, then destroys all items.
+	template <typename F>
+	void consume(F && func) {
+		while(! empty()) {
+			func(front());
+			popFront();
+		}
+	}
+
+	void clear() {
+		while(! empty()) {
+			popFront();
+		}
+	}
+
+private:
+	static constexpr std::size_t alignSize(const std::size_t size) {
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	void doAdvanceHead(const std::size_t size) {
+		head += size;
+		if(head == tail) {
+			head = 0;
+			tail = 0;
+		}
+	}
+
+	// Returns the address at tail where size bytes can be put.
+	void * doReserve(const std::size_t size) {
+		if(tail + size > capacity) {
+			doGrow(tail - head + size);
+		}
+		return data + tail;
+	}
+
+	void doGrow(const std::size_t required) {
+		std::size_t newCapacity = (capacity > 0 ? capacity : alignment * 16);
+		while(newCapacity < required) {
+			newCapacity *= 2;
+		}
+		if(newCapacity < capacity) {
+			newCapacity = capacity;
+		}
+
+		// operator new aligns to at least alignof(std::max_align_t).
+		unsigned char * newData = static_cast<unsigned char *>(::operator new(newCapacity));
+		std::size_t newTail = 0;
+		while(head != tail) {
+			void * item = data + head;
+			const std::size_t size = alignSize(ItemTraits::getSize(item));
+			ItemTraits::relocate(item, newData + newTail);
+			newTail += size;
+			head += size;
+		}
+		::operator delete(data);
+		data = newData;
+		capacity = newCapacity;
+		head = 0;
+		tail = newTail;
+	}
+
+private:
+	unsigned char * data;
+	std::size_t capacity;
+	std::size_t head;
+	std::size_t tail;
+};
+
 
 } //namespace internal_
 
@@ -0,0 +1,176 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Don't include this header, include callbacklist.h instead
+
+#ifndef FANOUTCALLBACK_I_H_EVENTPP
+#define FANOUTCALLBACK_I_H_EVENTPP
+
+#include "../eventpolicies.h"
+
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// How an argument of the prototype is given to a listener. The arguments
+// passed by value are held by the invoking and given by reference, shared,
+// copied or moved. The references are given as they are.
+template <typename T>
+struct FanOutPass
+{
+	using Argument = T &;
+
+	static const T & share(T & value) {
+		return value;
+	}
+
+	static T copy(T & value) {
+		return value;
+	}
+
+	static T && move(T & value) {
+		return std::move(value);
+	}
+};
+
+template <typename T>
+struct FanOutPass <T &>
+{
+	using Argument = T &;
+
+	static T & share(T & value) {
+		return value;
+	}
+
+	static T & copy(T & value) {
+		return value;
+	}
+
+	static T & move(T & value) {
+		return value;
+	}
+};
+
+template <typename Prototype>
+class FanOutCallback;
+
+// OPT-86: The Callback of CallbackList with an ArgumentFanOut policy. It's
+// made from any callable, as std::function, and remembers whether the
+// callable can take the arguments by const reference. Then callShared gives
+// it the arguments of the invoking instead of a copy. A callable which can't,
+// such as one taking std::string &&, gets a copy, as with std::function.
+// callMoving moves the arguments to the callable, as operator() does.
+template <typename ReturnType, typename ...Args>
+class FanOutCallback <ReturnType (Args...)>
+{
+private:
+	using Function = std::function<ReturnType (bool, typename FanOutPass<Args>::Argument...)>;
+
+	template <typename F>
+	struct Caller
+	{
+		using SharesArguments = std::integral_constant<bool,
+			CanInvoke<F &, decltype(FanOutPass<Args>::share(std::declval<typename FanOutPass<Args>::Argument>()))...>::value
+		>;
+
+		ReturnType operator() (const bool moving, typename FanOutPass<Args>::Argument ...args)
+		{
+			if(moving) {
+				return func(FanOutPass<Args>::move(args)...);
+			}
+			return doCallShared(SharesArguments(), args...);
+		}
+
+		ReturnType doCallShared(std::true_type, typename FanOutPass<Args>::Argument ...args)
+		{
+			return func(FanOutPass<Args>::share(args)...);
+		}
+
+		ReturnType doCallShared(std::false_type, typename FanOutPass<Args>::Argument ...args)
+		{
+			return func(FanOutPass<Args>::copy(args)...);
+		}
+
+		F func;
+	};
+
+public:
+	FanOutCallback() noexcept
+		: function()
+	{
+	}
+
+	FanOutCallback(std::nullptr_t) noexcept
+		: function()
+	{
+	}
+
+	template <typename F, typename std::enable_if<
+		! std::is_same<typename std::decay<F>::type, FanOutCallback>::value
+			&& CanInvoke<F &, Args...>::value,
+		int>::type = 0>
+	FanOutCallback(F func)
+		: function(Caller<F> { std::move(func) })
+	{
+	}
+
+	explicit operator bool () const noexcept {
+		return static_cast<bool>(function);
+	}
+
+	ReturnType operator() (Args ...args) const
+	{
+		return function(true, args...);
+	}
+
+	ReturnType callShared(typename FanOutPass<Args>::Argument ...args) const
+	{
+		return function(false, args...);
+	}
+
+	ReturnType callMoving(typename FanOutPass<Args>::Argument ...args) const
+	{
+		return function(true, args...);
+	}
+
+private:
+	Function function;
+};
+
+// The default Callback. FanOutCallback is only used by the linked list
+// storage, which is the only one that invokes it by callShared.
+template <typename Policies, typename Prototype>
+struct SelectDefaultCallback
+{
+	using ArgumentFanOut = typename SelectArgumentFanOut<Policies, HasTypeArgumentFanOut<Policies>::value>::Type;
+	using ListenerStorage = typename SelectListenerStorage<Policies, HasTypeListenerStorage<Policies>::value>::Type;
+
+	using Type = typename std::conditional<
+		! std::is_same<ArgumentFanOut, ArgumentFanOutCopy>::value
+			&& std::is_same<ListenerStorage, ListenerStorageLinkedList>::value,
+		FanOutCallback<Prototype>,
+		std::function<Prototype>
+	>::type;
+};
+
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
@@ -0,0 +1,140 @@
+// eventpp library - ARM-Linux / x86-Linux optimization extension
+// Pollable wakeup file descriptor used by the QueueNotifierFd policy of EventQueue.
+//
+// Design (OPT-30):
+// - The producer calls signal() when the queue turns from empty to non-empty,
+//   so a burst of events costs at most one write.
+// - The consumer calls clear() before it takes the events. A signal which
+//   comes between clear() and the processing only causes one extra wakeup,
+//   a signal is never lost.
+// - signaled tells whether there may be data in the descriptor, so clear()
+//   doesn't make a system call when nothing is signaled. It's set after the
+//   write, so the consumer never sees the flag without the data.
+// - Linux uses one eventfd. The other POSIX systems use a pipe, the read end
+//   is the pollable descriptor. Both ends are non blocking and close-on-exec.
+// - Not available on Windows.
+
+#ifndef FDNOTIFIER_I_H_EVENTPP
+#define FDNOTIFIER_I_H_EVENTPP
+
+#if defined(__unix__) || defined(__unix) || defined(__APPLE__)
+	#define EVENTPP_HAS_FD_NOTIFIER 1
+#else
+	#define EVENTPP_HAS_FD_NOTIFIER 0
+#endif
+
+#if EVENTPP_HAS_FD_NOTIFIER
+
+#include <cerrno>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+	#include <sys/eventfd.h>
+#endif
+
+#endif
+
+namespace eventpp {
+
+namespace internal_ {
+
+template <typename AtomicBool>
+class FdNotifier;
+
+#if EVENTPP_HAS_FD_NOTIFIER
+
+template <typename AtomicBool>
+class FdNotifier
+{
+public:
+	FdNotifier()
+		: readFd(-1), writeFd(-1), signaled(false)
+	{
+#if defined(__linux__)
+		readFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		writeFd = readFd;
+#else
+		int fds[2];
+		if(pipe(fds) == 0) {
+			for(const int fd : fds) {
+				fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+				fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+			}
+			readFd = fds[0];
+			writeFd = fds[1];
+		}
+#endif
+	}
+
+	~FdNotifier()
+	{
+		if(readFd >= 0) {
+			close(readFd);
+		}
+		if(writeFd >= 0 && writeFd != readFd) {
+			close(writeFd);
+		}
+	}
+
+	FdNotifier(const FdNotifier &) = delete;
+	FdNotifier & operator = (const FdNotifier &) = delete;
+
+	// -1 if the descriptor can't be created.
+	int getFd() const {
+		return readFd;
+	}
+
+	void signal() {
+		if(writeFd < 0) {
+			return;
+		}
+
+#if defined(__linux__)
+		const std::uint64_t value = 1;
+#else
+		const char value = 0;
+#endif
+		// EAGAIN means the descriptor is full, so it's readable already.
+		while(write(writeFd, &value, sizeof(value)) < 0 && errno == EINTR) {
+		}
+		signaled.store(true, std::memory_order_release);
+	}
+
+	void clear() {
+		if(! signaled.exchange(false, std::memory_order_acq_rel)) {
+			return;
+		}
+
+#if defined(__linux__)
+		// One read resets the eventfd counter to zero.
+		std::uint64_t value;
+		while(read(readFd, &value, sizeof(value)) < 0 && errno == EINTR) {
+		}
+#else
+		char buffer[64];
+		for(;;) {
+			const ssize_t size = read(readFd, buffer, sizeof(buffer));
+			if(size == static_cast<ssize_t>(sizeof(buffer)) || (size < 0 && errno == EINTR)) {
+				continue;
+			}
+			break;
+		}
+#endif
+	}
+
+private:
+	int readFd;
+	int writeFd;
+	AtomicBool signaled;
+};
+
+#endif
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
+
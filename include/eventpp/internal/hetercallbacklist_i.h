@@ -219,6 +219,16 @@ struct FindPrototypeByIndex : public FindPrototypeByIndexHelper <0, N, Prototype
 {
 };
 
+// The same std::tuple as FindPrototypeByArgs::ArgsTuple for the prototype.
+template <typename Prototype>
+struct GetPrototypeArgsTuple;
+
+template <typename RT, typename ...Args>
+struct GetPrototypeArgsTuple <RT (Args...)>
+{
+	using Type = std::tuple<typename std::remove_cv<typename std::remove_reference<Args>::type>::type...>;
+};
+
 template <typename PrototypeList_, template <typename ...> class Record>
 struct GetCallablePrototypeMaxSize;
 
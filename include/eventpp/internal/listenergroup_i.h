@@ -0,0 +1,332 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LISTENERGROUP_I_H_EVENTPP
+#define LISTENERGROUP_I_H_EVENTPP
+
+#include "../eventpolicies.h"
+
+#include <atomic>
+#include <type_traits>
+#include <utility>
+
+namespace eventpp {
+
+class ListenerGroup;
+
+namespace internal_ {
+
+template <typename Prototype, typename PoliciesType>
+class CallbackListBase;
+
+template <typename Prototype, typename PoliciesType>
+class CallbackListSnapshotBase;
+
+template <typename Prototype, typename PoliciesType>
+class CallbackListSlotMapBase;
+
+// OPT-48: A state may be the base of the data of a listener, as with
+// CounterRemover, so the destructor is virtual.
+struct ListenerGroupState
+{
+	ListenerGroupState() noexcept
+		: removed(false), referenceCount(1)
+	{
+	}
+
+	virtual ~ListenerGroupState() {
+	}
+
+	std::atomic<bool> removed;
+	std::atomic<unsigned int> referenceCount;
+};
+
+inline void releaseListenerGroupState(ListenerGroupState * state) noexcept
+{
+	if(state != nullptr && state->referenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		delete state;
+	}
+}
+
+// Each node of a group holds a reference, so the state lives as long as
+// the nodes, even after the ListenerGroup is gone.
+class ListenerGroupReference
+{
+public:
+	ListenerGroupReference() noexcept
+		: state(nullptr)
+	{
+	}
+
+	// With addReference false, the reference takes over the one the state
+	// holds when it's made.
+	explicit ListenerGroupReference(ListenerGroupState * state, const bool addReference = true) noexcept
+		: state(state)
+	{
+		if(addReference) {
+			doAddReference();
+		}
+	}
+
+	ListenerGroupReference(const ListenerGroupReference & other) noexcept
+		: state(other.state)
+	{
+		doAddReference();
+	}
+
+	ListenerGroupReference(ListenerGroupReference && other) noexcept
+		: state(other.state)
+	{
+		other.state = nullptr;
+	}
+
+	~ListenerGroupReference() {
+		releaseListenerGroupState(state);
+	}
+
+	ListenerGroupReference & operator = (const ListenerGroupReference & other) noexcept {
+		if(this != &other) {
+			releaseListenerGroupState(state);
+			state = other.state;
+			doAddReference();
+		}
+		return *this;
+	}
+
+	ListenerGroupReference & operator = (ListenerGroupReference && other) noexcept {
+		if(this != &other) {
+			releaseListenerGroupState(state);
+			state = other.state;
+			other.state = nullptr;
+		}
+		return *this;
+	}
+
+	// The nodes which are not in a group have no state, they only pay for
+	// the null check.
+	bool isRemoved() const noexcept {
+		return state != nullptr && state->removed.load(std::memory_order_acquire);
+	}
+
+	ListenerGroupState * get() const noexcept {
+		return state;
+	}
+
+private:
+	void doAddReference() noexcept {
+		if(state != nullptr) {
+			state->referenceCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+private:
+	ListenerGroupState * state;
+};
+
+} //namespace internal_
+
+// OPT-47: A tag for the listeners which are added with it. removeAll removes
+// all of them with one atomic store, instead of one remove, with its lock,
+// for each listener. A removed listener is not invoked any more, its node
+// is unlinked the next time the list is invoked or, with
+// ListenerStorageSnapshot, the next time the list is changed.
+// The state is allocated when the first listener is added, so an unused
+// ListenerGroup costs nothing.
+// Adding listeners with a group from several threads is fine, but removeAll
+// must not run at the same time as them.
+// The lists only take a group with the ListenerGroupsEnabled policy.
+class ListenerGroup
+{
+private:
+	using State = internal_::ListenerGroupState;
+	using Reference = internal_::ListenerGroupReference;
+
+public:
+	ListenerGroup() noexcept
+		: state(nullptr)
+	{
+	}
+
+	// The group of an existing state, used by the utilities which make the
+	// state themselves.
+	explicit ListenerGroup(const internal_::ListenerGroupReference & reference) noexcept
+		: state(reference.get())
+	{
+		if(reference.get() != nullptr) {
+			reference.get()->referenceCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	ListenerGroup(ListenerGroup && other) noexcept
+		: state(other.state.exchange(nullptr, std::memory_order_acq_rel))
+	{
+	}
+
+	// The listeners which are not removed stay in their lists, same as when
+	// the handles are dropped. Call removeAll to remove them.
+	~ListenerGroup() {
+		internal_::releaseListenerGroupState(state.load(std::memory_order_acquire));
+	}
+
+	ListenerGroup & operator = (ListenerGroup && other) noexcept {
+		if(this != &other) {
+			internal_::releaseListenerGroupState(state.exchange(
+				other.state.exchange(nullptr, std::memory_order_acq_rel),
+				std::memory_order_acq_rel
+			));
+		}
+		return *this;
+	}
+
+	ListenerGroup(const ListenerGroup &) = delete;
+	ListenerGroup & operator = (const ListenerGroup &) = delete;
+
+	void swap(ListenerGroup & other) noexcept {
+		State * s = state.load(std::memory_order_acquire);
+		state.store(other.state.load(std::memory_order_acquire), std::memory_order_release);
+		other.state.store(s, std::memory_order_release);
+	}
+
+	// Removes all listeners added with this group so far. The listeners
+	// added after it are in a new group.
+	void removeAll() noexcept {
+		State * s = state.exchange(nullptr, std::memory_order_acq_rel);
+		if(s != nullptr) {
+			s->removed.store(true, std::memory_order_release);
+			internal_::releaseListenerGroupState(s);
+		}
+	}
+
+private:
+	Reference doGetReference() {
+		State * s = state.load(std::memory_order_acquire);
+		if(s == nullptr) {
+			State * newState = new State();
+			if(state.compare_exchange_strong(s, newState, std::memory_order_acq_rel)) {
+				s = newState;
+			}
+			else {
+				delete newState;
+			}
+		}
+		return Reference(s);
+	}
+
+private:
+	std::atomic<State *> state;
+
+	template <typename Prototype, typename PoliciesType>
+	friend class internal_::CallbackListBase;
+	template <typename Prototype, typename PoliciesType>
+	friend class internal_::CallbackListSnapshotBase;
+	template <typename Prototype, typename PoliciesType>
+	friend class internal_::CallbackListSlotMapBase;
+};
+
+inline void swap(ListenerGroup & first, ListenerGroup & second) noexcept
+{
+	first.swap(second);
+}
+
+namespace internal_ {
+
+// OPT-47: With ListenerGroupsNone the nodes keep a NoListenerGroupReference,
+// which is empty. NoListenerGroup can't be made, so the functions which take
+// it in place of ListenerGroup never match, and the utilities see the list
+// has no groups.
+class NoListenerGroup
+{
+public:
+	NoListenerGroup() = delete;
+};
+
+struct NoListenerGroupReference
+{
+	bool isRemoved() const noexcept {
+		return false;
+	}
+
+	ListenerGroupState * get() const noexcept {
+		return nullptr;
+	}
+};
+
+template <typename Policies>
+struct SelectListenerGroup
+{
+	using ListenerGroups = typename SelectListenerGroups<Policies, HasTypeListenerGroups<Policies>::value>::Type;
+	static constexpr bool enabled = std::is_same<ListenerGroups, ListenerGroupsEnabled>::value;
+
+	using Group = typename std::conditional<enabled, ListenerGroup, NoListenerGroup>::type;
+	using Reference = typename std::conditional<enabled, ListenerGroupReference, NoListenerGroupReference>::type;
+};
+
+// The heterogeneous classes have no single Callback type, and no ListenerGroup.
+struct NoCallbackType
+{
+};
+
+template <typename T>
+struct SelectCallbackType
+{
+	template <typename C> static typename C::Callback test(typename C::Callback *);
+	template <typename C> static NoCallbackType test(...);
+
+	using Type = decltype(test<T>(nullptr));
+};
+
+template <typename T, typename Event, typename Callback>
+struct HasFunctionAppendListenerWithGroup
+{
+	template <typename C> static std::true_type test(decltype(std::declval<C &>().appendListener(
+		std::declval<const Event &>(),
+		std::declval<const Callback &>(),
+		std::declval<ListenerGroup &>()
+	)) *);
+	template <typename C> static std::false_type test(...);
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+
+template <typename T, typename Callback>
+struct HasFunctionAppendWithGroup
+{
+	template <typename C> static std::true_type test(decltype(std::declval<C &>().append(
+		std::declval<const Callback &>(),
+		std::declval<ListenerGroup &>()
+	)) *);
+	template <typename C> static std::false_type test(...);
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+
+template <typename DispatcherType>
+using DispatcherHasListenerGroup = std::integral_constant<bool, HasFunctionAppendListenerWithGroup<
+	DispatcherType,
+	typename DispatcherType::Event,
+	typename SelectCallbackType<DispatcherType>::Type
+>::value>;
+
+template <typename CallbackListType>
+using CallbackListHasListenerGroup = std::integral_constant<bool, HasFunctionAppendWithGroup<
+	CallbackListType,
+	typename SelectCallbackType<CallbackListType>::Type
+>::value>;
+
+} //namespace internal_
+
+
+} //namespace eventpp
+
+#endif
+
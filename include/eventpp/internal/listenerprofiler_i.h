@@ -0,0 +1,147 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LISTENERPROFILER_I_H_EVENTPP
+#define LISTENERPROFILER_I_H_EVENTPP
+
+#include "../eventpolicies.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// OPT-75: What a node of CallbackList carries for the profiler. profileSelf
+// makes the handle of a slow listener without a reference count on each call.
+template <typename Profiler, typename Node>
+struct ProfiledNode
+{
+	ProfiledNode() : profileTag(nullptr), profileSelf()
+	{
+	}
+
+	void initProfile(const std::shared_ptr<Node> & self, const char * tag)
+	{
+		profileSelf = self;
+		profileTag.store(tag, std::memory_order_relaxed);
+	}
+
+	void setProfileTag(const char * tag)
+	{
+		profileTag.store(tag, std::memory_order_relaxed);
+	}
+
+	const char * getProfileTag() const
+	{
+		return profileTag.load(std::memory_order_relaxed);
+	}
+
+	std::atomic<const char *> profileTag;
+	std::weak_ptr<Node> profileSelf;
+};
+
+template <typename Node>
+struct ProfiledNode <ProfilerNone, Node>
+{
+	void initProfile(const std::shared_ptr<Node> & /*self*/, const char * /*tag*/)
+	{
+	}
+
+	const char * getProfileTag() const
+	{
+		return nullptr;
+	}
+};
+
+// Marks an invoking of the list as a dispatch, for the watchdog.
+template <typename Profiler>
+class ProfileDispatchScope
+{
+public:
+	explicit ProfileDispatchScope(const void * callbackList)
+		: callbackList(callbackList)
+	{
+		Profiler::onDispatchBegin(callbackList);
+	}
+
+	~ProfileDispatchScope()
+	{
+		Profiler::onDispatchEnd(callbackList);
+	}
+
+	ProfileDispatchScope(const ProfileDispatchScope &) = delete;
+	ProfileDispatchScope & operator = (const ProfileDispatchScope &) = delete;
+
+private:
+	const void * callbackList;
+};
+
+template <>
+class ProfileDispatchScope <ProfilerNone>
+{
+public:
+	explicit ProfileDispatchScope(const void * /*callbackList*/)
+	{
+	}
+};
+
+// Calls the callback of a node. A listener which throws is not reported.
+template <typename Profiler>
+struct ProfileInvoker
+{
+	template <typename Node, typename ...A>
+	static void invoke(const void * callbackList, Node * node, A & ...args)
+	{
+		const char * tag = node->getProfileTag();
+		const std::uint64_t beginTicks = Profiler::onListenerBegin(callbackList, node, tag);
+		node->callback(args...);
+		Profiler::onListenerEnd(callbackList, node, tag, beginTicks, node->profileSelf);
+	}
+
+	// OPT-86: Same as invoke, call(callback) calls the callback.
+	template <typename Node, typename Call>
+	static void invokeWith(const void * callbackList, Node * node, Call && call)
+	{
+		const char * tag = node->getProfileTag();
+		const std::uint64_t beginTicks = Profiler::onListenerBegin(callbackList, node, tag);
+		call(node->callback);
+		Profiler::onListenerEnd(callbackList, node, tag, beginTicks, node->profileSelf);
+	}
+};
+
+template <>
+struct ProfileInvoker <ProfilerNone>
+{
+	template <typename Node, typename ...A>
+	static void invoke(const void * /*callbackList*/, Node * node, A & ...args)
+	{
+		node->callback(args...);
+	}
+
+	template <typename Node, typename Call>
+	static void invokeWith(const void * /*callbackList*/, Node * node, Call && call)
+	{
+		call(node->callback);
+	}
+};
+
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
+
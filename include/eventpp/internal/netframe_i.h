@@ -0,0 +1,96 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NETFRAME_I_H_EVENTPP
+#define NETFRAME_I_H_EVENTPP
+
+#include "eventqueue_i.h"
+#include "sharedmemoryring_i.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// The length prefix of a frame. size is the size of the whole frame,
+// header included. signature tells the frames of another prototype apart.
+struct NetFrameHeader
+{
+	std::uint32_t size;
+	std::uint32_t signature;
+};
+
+template <typename Event, typename Prototype>
+struct NetFrameCodec;
+
+// OPT-74: A frame is the header followed by the event and the arguments,
+// as in SharedMemoryEventQueue they must be trivially copyable, and are
+// copied as bytes. Both hosts must have the same byte order and layout.
+template <typename Event, typename R, typename ...Args>
+struct NetFrameCodec <Event, R (Args...)>
+{
+	static_assert(AllTriviallyCopyable<typename std::decay<Event>::type, typename std::decay<Args>::type...>::value,
+		"eventpp/net: the event and the arguments must be trivially copyable.");
+
+	using Payload = TrivialTuple<typename std::decay<Event>::type, typename std::decay<Args>::type...>;
+
+	// The element of EventQueue::enqueueBulk, which is expanded to enqueue(event, args...).
+	using Element = std::tuple<typename std::decay<Event>::type, typename std::decay<Args>::type...>;
+
+	enum : std::uint32_t {
+		frameSize = static_cast<std::uint32_t>(sizeof(NetFrameHeader) + sizeof(Payload)),
+		signature = 0x45500000u ^ (static_cast<std::uint32_t>(sizeof...(Args)) << 16) ^ static_cast<std::uint32_t>(sizeof(Payload))
+	};
+
+	template <typename ...A>
+	static void encode(char * buffer, A && ...args)
+	{
+		const NetFrameHeader header { frameSize, signature };
+		const Payload payload(std::forward<A>(args)...);
+		std::memcpy(buffer, &header, sizeof(header));
+		std::memcpy(buffer + sizeof(header), &payload, sizeof(payload));
+	}
+
+	static bool isValid(const char * buffer)
+	{
+		NetFrameHeader header;
+		std::memcpy(&header, buffer, sizeof(header));
+		return header.size == frameSize && header.signature == signature;
+	}
+
+	static Element decode(const char * buffer)
+	{
+		Payload payload;
+		std::memcpy(&payload, buffer + sizeof(NetFrameHeader), sizeof(payload));
+		return doMakeElement(payload, typename MakeIndexSequence<sizeof...(Args) + 1>::Type());
+	}
+
+private:
+	template <std::size_t ...Indexes>
+	static Element doMakeElement(const Payload & payload, IndexSequence<Indexes...>)
+	{
+		return Element(TrivialTupleGetter<Indexes>::get(payload)...);
+	}
+};
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
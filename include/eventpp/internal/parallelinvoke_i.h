@@ -0,0 +1,126 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PARALLELINVOKE_I_H_EVENTPP
+#define PARALLELINVOKE_I_H_EVENTPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace eventpp {
+
+namespace internal_ {
+
+template <typename Executor>
+struct HasFunctionGetThreadCount
+{
+	template <typename C> static std::true_type test(decltype(std::declval<C>().getThreadCount()) *);
+	template <typename C> static std::false_type test(...);
+
+	enum { value = !! decltype(test<Executor>(0))() };
+};
+
+// The count of the helper tasks which can run at the same time as the
+// calling thread.
+template <typename Executor>
+std::size_t getParallelHelperLimit(Executor & executor, std::true_type)
+{
+	return static_cast<std::size_t>(executor.getThreadCount());
+}
+
+template <typename Executor>
+std::size_t getParallelHelperLimit(Executor & /*executor*/, std::false_type)
+{
+	return std::max<std::size_t>(1, std::thread::hardware_concurrency()) - 1;
+}
+
+// OPT-64: Calls invoke(index) for each index in [0, count) on the calling
+// thread and on the helper tasks posted by executor.post(task), one for each
+// thread of executor.getThreadCount() if it exists, else one for each other
+// hardware thread. The indexes are taken one by one from a shared counter,
+// so a thread which finishes early takes the next item, the slow listeners
+// don't hold back the others. Returns when all are done.
+// The calling thread works too, so it doesn't deadlock when the executor is
+// busy or is the caller itself. A helper which starts after all the items
+// are taken returns without touching invoke.
+template <typename Executor, typename Invoke>
+void parallelInvoke(Executor & executor, const std::size_t count, const Invoke & invoke)
+{
+	struct State
+	{
+		State(const Invoke & invoke, const std::size_t count)
+			: invoke(invoke), count(count), nextIndex(0), doneCount(0), mutex(), condition()
+		{
+		}
+
+		const Invoke & invoke;
+		const std::size_t count;
+		std::atomic<std::size_t> nextIndex;
+		std::atomic<std::size_t> doneCount;
+		std::mutex mutex;
+		std::condition_variable condition;
+	};
+
+	if(count == 0) {
+		return;
+	}
+
+	const auto state = std::make_shared<State>(invoke, count);
+	const auto work = [](State & s) {
+		for(;;) {
+			const std::size_t index = s.nextIndex.fetch_add(1, std::memory_order_relaxed);
+			if(index >= s.count) {
+				return;
+			}
+			s.invoke(index);
+			if(s.doneCount.fetch_add(1, std::memory_order_acq_rel) + 1 == s.count) {
+				{
+					// Pairs with the wait below, so the wakeup isn't lost.
+					std::lock_guard<std::mutex> lockGuard(s.mutex);
+				}
+				s.condition.notify_all();
+			}
+		}
+	};
+
+	const std::size_t helperLimit = getParallelHelperLimit(
+		executor,
+		std::integral_constant<bool, HasFunctionGetThreadCount<Executor>::value>()
+	);
+	const std::size_t helperCount = std::min(count - 1, helperLimit);
+	for(std::size_t i = 0; i < helperCount; ++i) {
+		executor.post([state, work]() {
+			work(*state);
+		});
+	}
+
+	work(*state);
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->condition.wait(lock, [&state]() {
+		return state->doneCount.load(std::memory_order_acquire) == state->count;
+	});
+}
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
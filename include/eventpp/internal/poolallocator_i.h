@@ -9,12 +9,18 @@
 //   new slabs dynamically instead of falling back to ::operator new.
 // - OPT-9b: Lock-free free list — uses atomic CAS stack instead of SpinLock
 //   for allocate/deallocate. SpinLock only protects grow() (rare path).
+// - OPT-20: ABA-safe tagged free list, per-thread magazine caches.
+// - OPT-21: Pluggable slab source (mmap, huge pages, NUMA, user arena).
+// - OPT-22: Aligned slabs with a header, memory usage stats, and trimming
+//   of the slabs which are entirely free.
+// - OPT-68: Pre-growing a pool, and locking the slabs in memory.
 // - Thread-safe: lock-free hot path + SpinLock cold path (grow only).
 
 #ifndef POOLALLOCATOR_I_H_EVENTPP
 #define POOLALLOCATOR_I_H_EVENTPP
 
 #include <atomic>
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
@@ -22,12 +28,31 @@
 #include <list>
 #include <memory>
 #include <new>
+#include <thread>
 #include <type_traits>
 
 #include "../eventpolicies.h"
+#include "slabsource_i.h"
+#include "spinwait_i.h"
 
 namespace eventpp {
 
+// OPT-22: Memory usage of the node pools. The counters are updated without
+// stopping the pool, so they are exact only when the pool is idle.
+struct PoolStats
+{
+	size_t slabCount = 0;
+	size_t slabBytes = 0;
+	size_t slotCount = 0;
+	// Free slots in the shared free lists. The free slots cached by the
+	// threads (OPT-20 magazines) are counted as used.
+	size_t freeSlotCount = 0;
+	size_t usedSlotCount = 0;
+	size_t peakUsedSlotCount = 0;
+	size_t growCount = 0;
+	size_t trimmedSlabCount = 0;
+};
+
 namespace internal_ {
 
 // OPT-11: SpinLock with exponential backoff for pool operations.
@@ -40,11 +65,7 @@ struct PoolSpinLock
 		unsigned backoff = 1;
 		while(locked.test_and_set(std::memory_order_acquire)) {
 			for(unsigned i = 0; i < backoff; ++i) {
-#if defined(__aarch64__) || defined(__arm__)
-				__asm__ __volatile__("yield");
-#elif defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
-				__builtin_ia32_pause();
-#endif
+				internal_::cpuRelax();
 			}
 			if(backoff < kMaxBackoff) {
 				backoff <<= 1;
@@ -61,21 +82,171 @@ private:
 	std::atomic_flag locked = ATOMIC_FLAG_INIT;
 };
 
-// OPT-9a/9b: Multi-slab node pool with lock-free free list.
+// OPT-20: Lock-free LIFO stack of pool nodes with an ABA tag.
+// The head packs the node pointer and a counter, which is bumped by every
+// successful update, in one 64-bit word. A pop which read an outdated
+// node->next fails on the CAS even if the same node is the head again.
+// 64-bit platforms keep the pointer in the low 48 bits (x86-64 and AArch64
+// user space), 32-bit platforms keep it in the low 32 bits.
+// Link is the pointer member used to chain the nodes in this stack.
+template <typename Node, Node * Node::*Link>
+class TaggedNodeStack
+{
+private:
+	static constexpr unsigned kPointerBits = sizeof(void *) >= 8 ? 48 : 32;
+	static constexpr uint64_t kPointerMask = (uint64_t(1) << kPointerBits) - 1;
+
+	static Node * to_node(const uint64_t head) noexcept {
+		return reinterpret_cast<Node *>(static_cast<uintptr_t>(head & kPointerMask));
+	}
+
+	static uint64_t pack(Node * node, const uint64_t previous_head) noexcept {
+		const uint64_t tag = (previous_head >> kPointerBits) + 1;
+		return (tag << kPointerBits) | static_cast<uint64_t>(reinterpret_cast<uintptr_t>(node));
+	}
+
+public:
+	TaggedNodeStack() noexcept : head(0) {}
+
+	// Push the chain first..last, which is linked by Link.
+	void push(Node * first, Node * last) noexcept {
+		uint64_t old_head = head.load(std::memory_order_relaxed);
+		do {
+			last->*Link = to_node(old_head);
+		} while(!head.compare_exchange_weak(
+			old_head, pack(first, old_head),
+			std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	Node * pop() noexcept {
+		// seq_cst pairs with take_all, see NodePool::trim.
+		uint64_t old_head = head.load(std::memory_order_seq_cst);
+		while(true) {
+			Node * node = to_node(old_head);
+			if(node == nullptr) {
+				return nullptr;
+			}
+			// node may be popped and reused by another thread here, then the
+			// value read is garbage, but the tag makes the CAS fail.
+			// NodePool::trim doesn't release a slab while a pop is running.
+			Node * next = node->*Link;
+			if(head.compare_exchange_weak(
+				old_head, pack(next, old_head),
+				std::memory_order_acq_rel, std::memory_order_acquire)) {
+				return node;
+			}
+		}
+	}
+
+	// Take the whole stack at once, returns the first node.
+	Node * take_all() noexcept {
+		uint64_t old_head = head.load(std::memory_order_relaxed);
+		while(!head.compare_exchange_weak(
+			old_head, pack(nullptr, old_head),
+			std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		}
+		return to_node(old_head);
+	}
+
+	bool empty() const noexcept {
+		return to_node(head.load(std::memory_order_acquire)) == nullptr;
+	}
+
+private:
+	std::atomic<uint64_t> head;
+};
+
+// OPT-68: Locks the pages of [p, p + size) in memory, so they are never
+// swapped out. Returns false if it fails, for example over RLIMIT_MEMLOCK,
+// or on the platforms other than Linux.
+inline bool lockMemoryRange(void * p, const std::size_t size) noexcept
+{
+#if defined(__linux__)
+	return ::mlock(p, size) == 0;
+#else
+	(void)p;
+	(void)size;
+	return false;
+#endif
+}
+
+// OPT-22: Every NodePool registers itself here, so the memory of all pools
+// can be reported and trimmed without knowing the node types, which are
+// internal to the containers.
+class NodePoolBase
+{
+public:
+	virtual PoolStats getStats() const noexcept = 0;
+	virtual size_t trim(size_t keepFreeSlabCount) noexcept = 0;
+	virtual bool lockMemory() noexcept = 0;
+
+	template <typename F>
+	static void forEach(F && f) {
+		Registry & registry = get_registry();
+		registry.lock.lock();
+		for(NodePoolBase * pool = registry.head; pool != nullptr; pool = pool->registry_next_) {
+			f(*pool);
+		}
+		registry.lock.unlock();
+	}
+
+protected:
+	NodePoolBase() noexcept {
+		Registry & registry = get_registry();
+		registry.lock.lock();
+		registry_next_ = registry.head;
+		registry.head = this;
+		registry.lock.unlock();
+	}
+
+	virtual ~NodePoolBase() {
+		Registry & registry = get_registry();
+		registry.lock.lock();
+		NodePoolBase ** link = &registry.head;
+		while(*link != this) {
+			link = &(*link)->registry_next_;
+		}
+		*link = registry_next_;
+		registry.lock.unlock();
+	}
+
+private:
+	struct Registry {
+		PoolSpinLock lock;
+		NodePoolBase * head = nullptr;
+	};
+
+	// Constructed before the first pool, so destroyed after the last one.
+	static Registry & get_registry() noexcept {
+		static Registry registry;
+		return registry;
+	}
+
+	NodePoolBase * registry_next_;
+};
+
+// OPT-9a/9b/20: Multi-slab node pool with lock-free free list.
 // One static instance per type T, shared by all PoolAllocator<T>.
 //
 // OPT-9a: When the initial slab is exhausted, grow() allocates a new slab
 //   (linked list of slabs) instead of falling back to ::operator new.
-// OPT-9b: allocate/deallocate use atomic CAS on free_head_ (lock-free).
+// OPT-9b: allocate/deallocate use atomic CAS on free_stack_ (lock-free).
 //   Only grow() uses SpinLock (called once per SlabCapacity allocations).
-//
-// ABA safety: free list is a LIFO stack with unique slab-internal addresses.
-// A node is removed from free list on allocate, returned on deallocate.
-// The same pointer cannot appear twice in the free list simultaneously,
-// so ABA cannot occur.
-template <typename T, size_t SlabCapacity>
-class NodePool
+// OPT-20: free_stack_ is a tagged stack, see TaggedNodeStack for the ABA
+//   problem. With MagazineSize > 0, each thread caches up to
+//   2 * MagazineSize free nodes. allocate/deallocate only touch the shared
+//   stacks to move a full magazine of MagazineSize nodes, so when the
+//   producers allocate and the consumer deallocates, the nodes travel
+//   between the threads in batches instead of one CAS per event.
+// OPT-22: Each slab is aligned to a power of two not less than its size and
+//   starts with a header, so the slab of a slot is found by masking the slot
+//   address. trim() releases the slabs whose slots are all in the shared
+//   free lists, getStats() reports the memory usage.
+template <typename T, size_t SlabCapacity, size_t MagazineSize = 32, typename SlabSource = SlabSourceDefault>
+class NodePool : public NodePoolBase
 {
+	static_assert(SlabCapacity > 0, "SlabCapacity must be greater than 0.");
+
 public:
 	static NodePool & instance() {
 		static NodePool pool;
@@ -83,57 +254,222 @@ public:
 	}
 
 	T * allocate() noexcept {
-		FreeNode * old_head = free_head_.load(std::memory_order_acquire);
+		if(MagazineSize > 0) {
+			Magazine & magazine = get_magazine();
+			if(magazine.head != nullptr) {
+				FreeNode * node = magazine.head;
+				magazine.head = node->next;
+				--magazine.count;
+				return reinterpret_cast<T *>(node);
+			}
+
+			FreeNode * batch = pop_batch();
+			if(batch != nullptr) {
+				magazine.head = batch->next;
+				magazine.count = MagazineSize - 1;
+				return reinterpret_cast<T *>(batch);
+			}
+		}
+
 		while(true) {
-			if(old_head == nullptr) {
-				// Pool exhausted — try to grow under lock
-				grow_lock_.lock();
-				old_head = free_head_.load(std::memory_order_acquire);
-				if(old_head == nullptr) {
-					grow();
-					old_head = free_head_.load(std::memory_order_acquire);
-				}
-				grow_lock_.unlock();
-				if(old_head == nullptr) {
-					return nullptr;  // grow() failed (out of memory)
+			FreeNode * node = pop_free();
+			if(node != nullptr) {
+				return reinterpret_cast<T *>(node);
+			}
+			if(MagazineSize > 0) {
+				node = pop_batch();
+				if(node != nullptr) {
+					// Another thread grew the pool, keep its batch locally.
+					Magazine & magazine = get_magazine();
+					magazine.head = node->next;
+					magazine.count = MagazineSize - 1;
+					return reinterpret_cast<T *>(node);
 				}
 			}
-			// CAS: try to pop head from free list
-			if(free_head_.compare_exchange_weak(
-				old_head, old_head->next,
-				std::memory_order_acq_rel, std::memory_order_acquire))
-			{
-				return reinterpret_cast<T *>(old_head);
+
+			// Pool exhausted — try to grow under lock
+			grow_lock_.lock();
+			const bool grown = (! free_stack_.empty() || ! depot_stack_.empty()) || grow();
+			grow_lock_.unlock();
+			if(! grown) {
+				return nullptr;  // grow() failed (out of memory)
 			}
-			// CAS failed — old_head updated by compare_exchange_weak, retry
 		}
 	}
 
 	void deallocate(T * ptr) noexcept {
-		auto * raw = reinterpret_cast<unsigned char *>(ptr);
-		if(is_in_pool(raw)) {
-			// Return to pool via lock-free push
-			FreeNode * node = reinterpret_cast<FreeNode *>(ptr);
-			FreeNode * old_head = free_head_.load(std::memory_order_relaxed);
-			do {
-				node->next = old_head;
-			} while(!free_head_.compare_exchange_weak(
-				old_head, node,
-				std::memory_order_release, std::memory_order_relaxed));
+		FreeNode * node = reinterpret_cast<FreeNode *>(ptr);
+		// OPT-22: O(1) ownership check instead of scanning the slab list.
+		assert(get_slab(node)->header.owner == this);
+		if(MagazineSize == 0) {
+			push_free(node, node, 1);
+			return;
 		}
-		else {
-			// Allocated before pool existed or from multi-element fallback
-			::operator delete(ptr);
+
+		Magazine & magazine = get_magazine();
+		node->next = magazine.head;
+		magazine.head = node;
+		++magazine.count;
+		if(magazine.count >= MagazineSize * 2) {
+			// Keep the newest MagazineSize nodes, they are likely in cache,
+			// and give the older ones to the depot as one batch.
+			FreeNode * last = magazine.head;
+			for(size_t i = 1; i < MagazineSize; ++i) {
+				last = last->next;
+			}
+			FreeNode * batch = last->next;
+			last->next = nullptr;
+			magazine.count = MagazineSize;
+			push_batch(batch);
+		}
+	}
+
+	PoolStats getStats() const noexcept override {
+		PoolStats stats;
+		stats.slabCount = slab_count_.load(std::memory_order_relaxed);
+		stats.slabBytes = stats.slabCount * sizeof(Slab);
+		stats.slotCount = stats.slabCount * SlabCapacity;
+		const size_t free_count = free_count_.load(std::memory_order_relaxed);
+		stats.freeSlotCount = free_count < stats.slotCount ? free_count : stats.slotCount;
+		stats.usedSlotCount = stats.slotCount - stats.freeSlotCount;
+		stats.peakUsedSlotCount = peak_used_.load(std::memory_order_relaxed);
+		stats.growCount = grow_count_.load(std::memory_order_relaxed);
+		stats.trimmedSlabCount = trimmed_count_.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	// Release the slabs whose slots are all in the shared free lists, except
+	// keepFreeSlabCount of them. The slots cached by the threads keep their
+	// slabs. Returns the number of slabs released.
+	// The free lists are empty while trimming, a concurrent allocate waits
+	// on grow_lock_ then retries, it doesn't allocate a new slab.
+	size_t trim(const size_t keepFreeSlabCount = 0) noexcept override {
+		grow_lock_.lock();
+		FreeNode * free_list = free_stack_.take_all();
+		FreeNode * batch_list = MagazineSize > 0 ? depot_stack_.take_all() : nullptr;
+
+		// A pop which read the head before take_all may still read node->next,
+		// wait until it's done before releasing the memory of any node.
+		// If it takes too long (the thread is preempted), give up.
+		bool idle = false;
+		for(int i = 0; i < kTrimWaitCount && ! idle; ++i) {
+			idle = (active_pops_.load(std::memory_order_seq_cst) == 0);
+			if(! idle) {
+				std::this_thread::yield();
+			}
+		}
+
+		for(Slab * s = slab_head_; s != nullptr; s = s->header.next) {
+			s->header.free_count = 0;
+		}
+		const size_t taken_count = for_each_node(free_list, batch_list, [](FreeNode * node) {
+			++get_slab(node)->header.free_count;
+		});
+
+		size_t free_slab_count = 0;
+		size_t released_count = 0;
+		for(Slab * s = slab_head_; s != nullptr; s = s->header.next) {
+			// A slab is entirely free since it has SlabCapacity free slots.
+			s->header.releasing = idle
+				&& s->header.free_count == SlabCapacity
+				&& ++free_slab_count > keepFreeSlabCount;
+			if(s->header.releasing) {
+				++released_count;
+			}
+		}
+
+		// Chain the slots which are kept, then put them back.
+		FreeNode * kept_head = nullptr;
+		size_t kept_count = 0;
+		for_each_node(free_list, batch_list, [&kept_head, &kept_count](FreeNode * node) {
+			if(! get_slab(node)->header.releasing) {
+				node->next = kept_head;
+				kept_head = node;
+				++kept_count;
+			}
+		});
+		release_chain(kept_head);
+
+		Slab ** link = &slab_head_;
+		while(*link != nullptr) {
+			Slab * s = *link;
+			if(s->header.releasing) {
+				*link = s->header.next;
+				SlabSource::deallocate(s, sizeof(Slab));
+			}
+			else {
+				link = &s->header.next;
+			}
+		}
+		// The slot count goes down first, so the used count never looks higher.
+		slab_count_.fetch_sub(released_count, std::memory_order_relaxed);
+		free_count_.fetch_sub(taken_count - kept_count, std::memory_order_relaxed);
+		trimmed_count_.fetch_add(released_count, std::memory_order_relaxed);
+		grow_lock_.unlock();
+		return released_count;
+	}
+
+	// OPT-68: Grow the pool until the shared free lists have at least
+	// freeSlotCount slots, so the next freeSlotCount allocations don't grow
+	// it. Returns false if out of memory.
+	bool reserve(const size_t freeSlotCount) noexcept {
+		grow_lock_.lock();
+		bool grown = true;
+		while(grown && free_count_.load(std::memory_order_relaxed) < freeSlotCount) {
+			grown = grow();
+		}
+		grow_lock_.unlock();
+		return grown;
+	}
+
+	// OPT-68: Lock the slabs in memory. The slots are written when the slab
+	// is allocated, so the pages are already resident. The slabs allocated
+	// later are not locked. Returns false if any slab is not locked.
+	bool lockMemory() noexcept override {
+		grow_lock_.lock();
+		bool locked = true;
+		for(Slab * s = slab_head_; s != nullptr; s = s->header.next) {
+			locked = lockMemoryRange(s, sizeof(Slab)) && locked;
 		}
+		grow_lock_.unlock();
+		return locked;
 	}
 
 private:
 	struct FreeNode {
+		// Next node in the same magazine or in free_stack_.
 		FreeNode * next;
+		// Next magazine in depot_stack_, only valid in the first node of a magazine.
+		FreeNode * next_batch;
+	};
+
+	using FreeStack = TaggedNodeStack<FreeNode, &FreeNode::next>;
+	using DepotStack = TaggedNodeStack<FreeNode, &FreeNode::next_batch>;
+
+	// Thread local cache of free nodes, linked by FreeNode::next.
+	// The nodes go back to the shared free list when the thread exits.
+	struct Magazine {
+		~Magazine() {
+			if(head != nullptr) {
+				FreeNode * last = head;
+				while(last->next != nullptr) {
+					last = last->next;
+				}
+				NodePool::instance().push_free(head, last, count);
+			}
+		}
+
+		FreeNode * head = nullptr;
+		size_t count = 0;
 	};
 
+	static Magazine & get_magazine() noexcept {
+		static thread_local Magazine magazine;
+		return magazine;
+	}
+
 	// Slot must be large enough for T and properly aligned,
-	// and also large enough for FreeNode (pointer) when in free list.
+	// and also large enough for FreeNode when in free list.
 	static constexpr size_t SlotSize =
 		sizeof(T) > sizeof(FreeNode) ? sizeof(T) : sizeof(FreeNode);
 	static constexpr size_t SlotAlign =
@@ -143,13 +479,56 @@ private:
 		unsigned char data[SlotSize];
 	};
 
+	struct Slab;
+
+	struct SlabHeader {
+		NodePool * owner;
+		Slab * next;
+		// Only used by trim().
+		size_t free_count;
+		bool releasing;
+	};
+
 	// OPT-9a: Slab structure — linked list of fixed-capacity slabs.
 	struct Slab {
+		SlabHeader header;
 		alignas(SlotAlign) unsigned char data[sizeof(Slot) * SlabCapacity];
-		Slab * next;
 	};
 
-	NodePool() : slab_head_(nullptr), free_head_(nullptr) {
+	static constexpr size_t next_power_of_two(const size_t n) {
+		return n <= 1 ? 1 : 2 * next_power_of_two((n + 1) / 2);
+	}
+
+	// OPT-22: The slab address has all the low bits of SlabAlignment cleared.
+	static constexpr size_t SlabAlignment = next_power_of_two(sizeof(Slab));
+
+	static constexpr int kTrimWaitCount = 1024;
+
+	// Counts the threads which are popping from the shared stacks.
+	struct PopGuard {
+		explicit PopGuard(std::atomic<size_t> & counter) noexcept : counter(counter) {
+			counter.fetch_add(1, std::memory_order_seq_cst);
+		}
+
+		~PopGuard() {
+			counter.fetch_sub(1, std::memory_order_release);
+		}
+
+		std::atomic<size_t> & counter;
+	};
+
+	NodePool()
+		:
+			slab_head_(nullptr),
+			free_stack_(),
+			depot_stack_(),
+			active_pops_(0),
+			slab_count_(0),
+			free_count_(0),
+			peak_used_(0),
+			grow_count_(0),
+			trimmed_count_(0)
+	{
 		// Allocate initial slab
 		grow();
 	}
@@ -158,8 +537,8 @@ private:
 		// Free all dynamically allocated slabs
 		Slab * s = slab_head_;
 		while(s != nullptr) {
-			Slab * next = s->next;
-			::operator delete(s);
+			Slab * next = s->header.next;
+			SlabSource::deallocate(s, sizeof(Slab));
 			s = next;
 		}
 	}
@@ -167,59 +546,211 @@ private:
 	NodePool(const NodePool &) = delete;
 	NodePool & operator=(const NodePool &) = delete;
 
-	// Allocate a new slab and add all its slots to the free list.
+	FreeNode * get_slot(Slab * slab, const size_t index) noexcept {
+		return reinterpret_cast<FreeNode *>(&slab->data[index * sizeof(Slot)]);
+	}
+
+	static Slab * get_slab(FreeNode * node) noexcept {
+		return reinterpret_cast<Slab *>(
+			reinterpret_cast<uintptr_t>(node) & ~static_cast<uintptr_t>(SlabAlignment - 1));
+	}
+
+	// The nodes are counted before they are visible to the other threads,
+	// so free_count_ is never less than the nodes in the shared stacks.
+	void push_free(FreeNode * first, FreeNode * last, const size_t count) noexcept {
+		free_count_.fetch_add(count, std::memory_order_relaxed);
+		free_stack_.push(first, last);
+	}
+
+	void push_batch(FreeNode * batch) noexcept {
+		free_count_.fetch_add(MagazineSize, std::memory_order_relaxed);
+		depot_stack_.push(batch, batch);
+	}
+
+	FreeNode * pop_free() noexcept {
+		PopGuard guard(active_pops_);
+		FreeNode * node = free_stack_.pop();
+		if(node != nullptr) {
+			on_taken(1);
+		}
+		return node;
+	}
+
+	FreeNode * pop_batch() noexcept {
+		PopGuard guard(active_pops_);
+		FreeNode * batch = depot_stack_.pop();
+		if(batch != nullptr) {
+			on_taken(MagazineSize);
+		}
+		return batch;
+	}
+
+	void on_taken(const size_t count) noexcept {
+		const size_t free_count = free_count_.fetch_sub(count, std::memory_order_relaxed) - count;
+		const size_t slot_count = slab_count_.load(std::memory_order_relaxed) * SlabCapacity;
+		if(free_count >= slot_count) {
+			// The counters are not updated together, skip the stale result.
+			return;
+		}
+		const size_t used = slot_count - free_count;
+		size_t peak = peak_used_.load(std::memory_order_relaxed);
+		while(used > peak && ! peak_used_.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {
+		}
+	}
+
+	// Call f on each node in free_list (linked by next) and in the batches of
+	// batch_list (linked by next_batch). f may change node->next.
+	// Returns the number of nodes.
+	template <typename F>
+	static size_t for_each_node(FreeNode * free_list, FreeNode * batch_list, F && f) {
+		size_t count = 0;
+		while(free_list != nullptr) {
+			FreeNode * next = free_list->next;
+			f(free_list);
+			free_list = next;
+			++count;
+		}
+		while(batch_list != nullptr) {
+			FreeNode * next_batch = batch_list->next_batch;
+			for(FreeNode * node = batch_list; node != nullptr; ) {
+				FreeNode * next = node->next;
+				f(node);
+				node = next;
+				++count;
+			}
+			batch_list = next_batch;
+		}
+		return count;
+	}
+
+	// Put the chain back to the shared stacks without counting the nodes.
+	// With magazines, the chain is cut in full magazines for the depot.
 	// Must be called under grow_lock_.
-	void grow() {
-		Slab * new_slab = static_cast<Slab *>(
-			::operator new(sizeof(Slab), std::nothrow));
+	void release_chain(FreeNode * head) noexcept {
+		if(MagazineSize > 0) {
+			while(head != nullptr) {
+				FreeNode * last = head;
+				size_t count = 1;
+				for(; count < MagazineSize && last->next != nullptr; ++count) {
+					last = last->next;
+				}
+				if(count < MagazineSize) {
+					break;
+				}
+				FreeNode * next = last->next;
+				last->next = nullptr;
+				depot_stack_.push(head, head);
+				head = next;
+			}
+		}
+		if(head != nullptr) {
+			FreeNode * last = head;
+			while(last->next != nullptr) {
+				last = last->next;
+			}
+			free_stack_.push(head, last);
+		}
+	}
+
+	// Allocate a new slab and put all its slots in the free stacks.
+	// Must be called under grow_lock_. Returns false if out of memory.
+	bool grow() {
+		// OPT-21: The memory comes from SlabSource, see slabsource_i.h.
+		Slab * new_slab = static_cast<Slab *>(SlabSource::allocate(sizeof(Slab), SlabAlignment));
 		if(new_slab == nullptr) {
-			return;  // Out of memory
+			return false;  // Out of memory
 		}
-		new_slab->next = slab_head_;
+		assert((reinterpret_cast<uintptr_t>(new_slab) & (SlabAlignment - 1)) == 0);
+		new_slab->header.owner = this;
+		new_slab->header.next = slab_head_;
 		slab_head_ = new_slab;
+		// The free count goes up first, so the used count never looks higher.
+		free_count_.fetch_add(SlabCapacity, std::memory_order_relaxed);
+		slab_count_.fetch_add(1, std::memory_order_relaxed);
+		grow_count_.fetch_add(1, std::memory_order_relaxed);
+
+		// Chain the slots and push them with one CAS per chain.
+		// With magazines, the slab is split in full magazines for the depot.
+		for(size_t i = 0; i + 1 < SlabCapacity; ++i) {
+			get_slot(new_slab, i)->next = get_slot(new_slab, i + 1);
+		}
+		get_slot(new_slab, SlabCapacity - 1)->next = nullptr;
 
-		// Build free list from new slab's slots (push all to free_head_)
-		// We're under grow_lock_ and free_head_ is null (or we wouldn't grow),
-		// but other threads may be doing CAS on free_head_ concurrently for
-		// deallocate. Use CAS to safely push each node.
-		for(size_t i = 0; i < SlabCapacity; ++i) {
-			FreeNode * node = reinterpret_cast<FreeNode *>(
-				&new_slab->data[i * sizeof(Slot)]);
-			FreeNode * old_head = free_head_.load(std::memory_order_relaxed);
-			do {
-				node->next = old_head;
-			} while(!free_head_.compare_exchange_weak(
-				old_head, node,
-				std::memory_order_release, std::memory_order_relaxed));
-		}
-	}
-
-	// Check if a pointer belongs to any slab in the pool.
-	// Slab count is typically <= 3, so linear scan is fine.
-	bool is_in_pool(unsigned char * raw) const noexcept {
-		const size_t slab_data_size = sizeof(Slot) * SlabCapacity;
-		Slab * s = slab_head_;
-		while(s != nullptr) {
-			if(raw >= s->data && raw < s->data + slab_data_size) {
-				return true;
+		size_t first = 0;
+		if(MagazineSize > 0) {
+			for(; SlabCapacity - first >= MagazineSize; first += MagazineSize) {
+				get_slot(new_slab, first + MagazineSize - 1)->next = nullptr;
+				depot_stack_.push(get_slot(new_slab, first), get_slot(new_slab, first));
 			}
-			s = s->next;
 		}
-		return false;
+		if(first < SlabCapacity) {
+			free_stack_.push(get_slot(new_slab, first), get_slot(new_slab, SlabCapacity - 1));
+		}
+		return true;
 	}
 
-	Slab * slab_head_;
-	std::atomic<FreeNode *> free_head_;  // OPT-9b: lock-free free list head
-	PoolSpinLock grow_lock_;             // Only protects grow()
+	Slab * slab_head_;        // Changed under grow_lock_
+	FreeStack free_stack_;    // OPT-9b/20: single free nodes
+	DepotStack depot_stack_;  // OPT-20: full magazines
+	PoolSpinLock grow_lock_;  // Only protects grow() and trim()
+	std::atomic<size_t> active_pops_;
+	// OPT-22: Stats
+	std::atomic<size_t> slab_count_;
+	std::atomic<size_t> free_count_;  // Nodes in free_stack_ and depot_stack_
+	std::atomic<size_t> peak_used_;
+	std::atomic<size_t> grow_count_;
+	std::atomic<size_t> trimmed_count_;
 };
 
 } // namespace internal_
 
+// OPT-22: Memory usage of all node pools in the process, for example all the
+// PoolQueueList of the event queues. peakUsedSlotCount is the sum of the peak
+// of each pool.
+inline PoolStats getPoolStats()
+{
+	PoolStats total;
+	internal_::NodePoolBase::forEach([&total](const internal_::NodePoolBase & pool) {
+		const PoolStats stats = pool.getStats();
+		total.slabCount += stats.slabCount;
+		total.slabBytes += stats.slabBytes;
+		total.slotCount += stats.slotCount;
+		total.freeSlotCount += stats.freeSlotCount;
+		total.usedSlotCount += stats.usedSlotCount;
+		total.peakUsedSlotCount += stats.peakUsedSlotCount;
+		total.growCount += stats.growCount;
+		total.trimmedSlabCount += stats.trimmedSlabCount;
+	});
+	return total;
+}
+
+// OPT-22: Trim all node pools, each pool keeps keepFreeSlabCount free slabs
+// as the high watermark for the next burst. Returns the number of slabs released.
+inline size_t trimPools(const size_t keepFreeSlabCount = 0)
+{
+	size_t released_count = 0;
+	internal_::NodePoolBase::forEach([&released_count, keepFreeSlabCount](internal_::NodePoolBase & pool) {
+		released_count += pool.trim(keepFreeSlabCount);
+	});
+	return released_count;
+}
+
+// OPT-68: Lock the slabs of all node pools in memory, usually at startup
+// after the pools are reserved. Returns false if any slab is not locked.
+inline bool lockPoolMemory()
+{
+	bool locked = true;
+	internal_::NodePoolBase::forEach([&locked](internal_::NodePoolBase & pool) {
+		locked = pool.lockMemory() && locked;
+	});
+	return locked;
+}
+
 
 // C++14 conforming allocator backed by a static per-type pool.
 // All instances of PoolAllocator<T, Capacity> compare equal,
 // which is required for std::list::splice() between lists.
-template <typename T, size_t Capacity = 4096>
+template <typename T, size_t Capacity = 4096, size_t MagazineSize = 32, typename SlabSource = SlabSourceDefault>
 class PoolAllocator
 {
 public:
@@ -232,11 +763,16 @@ public:
 	PoolAllocator() noexcept = default;
 
 	template <typename U>
-	PoolAllocator(const PoolAllocator<U, Capacity> &) noexcept {}
+	PoolAllocator(const PoolAllocator<U, Capacity, MagazineSize, SlabSource> &) noexcept {}
+
+	// OPT-68: Grow the pool of T to have at least count free slots.
+	static bool reserve(const size_type count) noexcept {
+		return internal_::NodePool<T, Capacity, MagazineSize, SlabSource>::instance().reserve(count);
+	}
 
 	T * allocate(size_type n) {
 		if(n == 1) {
-			T * ptr = internal_::NodePool<T, Capacity>::instance().allocate();
+			T * ptr = internal_::NodePool<T, Capacity, MagazineSize, SlabSource>::instance().allocate();
 			if(ptr == nullptr) {
 				throw std::bad_alloc();
 			}
@@ -248,7 +784,7 @@ public:
 
 	void deallocate(T * ptr, size_type n) noexcept {
 		if(n == 1) {
-			internal_::NodePool<T, Capacity>::instance().deallocate(ptr);
+			internal_::NodePool<T, Capacity, MagazineSize, SlabSource>::instance().deallocate(ptr);
 		}
 		else {
 			::operator delete(ptr);
@@ -257,17 +793,17 @@ public:
 
 	template <typename U>
 	struct rebind {
-		using other = PoolAllocator<U, Capacity>;
+		using other = PoolAllocator<U, Capacity, MagazineSize, SlabSource>;
 	};
 };
 
-template <typename T1, typename T2, size_t C>
-bool operator==(const PoolAllocator<T1, C> &, const PoolAllocator<T2, C> &) noexcept {
+template <typename T1, typename T2, size_t C, size_t M, typename S>
+bool operator==(const PoolAllocator<T1, C, M, S> &, const PoolAllocator<T2, C, M, S> &) noexcept {
 	return true;  // All instances share static pool, always equal
 }
 
-template <typename T1, typename T2, size_t C>
-bool operator!=(const PoolAllocator<T1, C> &, const PoolAllocator<T2, C> &) noexcept {
+template <typename T1, typename T2, size_t C, size_t M, typename S>
+bool operator!=(const PoolAllocator<T1, C, M, S> &, const PoolAllocator<T2, C, M, S> &) noexcept {
 	return false;
 }
 
@@ -280,8 +816,12 @@ bool operator!=(const PoolAllocator<T1, C> &, const PoolAllocator<T2, C> &) noex
 //   };
 //   eventpp::EventQueue<int, void(), MyPolicies> queue;
 //
-template <typename T, size_t Capacity = 4096>
-using PoolQueueList = std::list<T, PoolAllocator<T, Capacity>>;
+// MagazineSize is the number of free nodes moved between a thread cache and
+// the shared pool at once (OPT-20), 0 disables the thread caches.
+// SlabSource provides the memory of the slabs (OPT-21), for example
+// eventpp::SlabSourceMmap<> for pre-faulted huge pages.
+template <typename T, size_t Capacity = 4096, size_t MagazineSize = 32, typename SlabSource = SlabSourceDefault>
+using PoolQueueList = std::list<T, PoolAllocator<T, Capacity, MagazineSize, SlabSource>>;
 
 // OPT-14: One-stop high-performance policy preset.
 // Combines SpinLock (OPT-1/11), PoolAllocator (OPT-5/9), and shared_mutex (OPT-3)
@@ -299,6 +839,11 @@ struct HighPerfPolicy {
 	// 8192 slots per slab; auto-grows when exhausted (OPT-9a).
 	template <typename T>
 	using QueueList = PoolQueueList<T, 8192>;
+
+	// OPT-40: Listener nodes come from a pool too, so append/remove
+	// don't call malloc.
+	template <typename T>
+	using NodeAllocator = PoolAllocator<T, 1024>;
 };
 
 
@@ -0,0 +1,149 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PREFETCH_I_H_EVENTPP
+#define PREFETCH_I_H_EVENTPP
+
+#include "../eventpolicies.h"
+#include "eventqueue_i.h"
+
+#include <cstddef>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+namespace eventpp {
+
+namespace internal_ {
+
+// A hint only, an invalid address doesn't fault.
+inline void prefetchForRead(const void * address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_prefetch(address, 0, 3);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_prefetch(static_cast<const char *>(address), _MM_HINT_T0);
+#else
+	(void)address;
+#endif
+}
+
+// Prefetches the cache lines of *object, and the links of its list node,
+// which are right before the value in the node of std::list.
+template <typename T>
+void prefetchListValue(const T * object)
+{
+	const char * begin = reinterpret_cast<const char *>(object) - 2 * sizeof(void *);
+	const char * end = reinterpret_cast<const char *>(object) + sizeof(T);
+	for(const char * p = begin; p < end; p += EVENTPP_CACHELINE_SIZE) {
+		prefetchForRead(p);
+	}
+	prefetchForRead(end - 1);
+}
+
+// The payload of an argument is what it points to.
+template <typename T>
+void prefetchPayload(const T & /*argument*/)
+{
+}
+
+template <typename T>
+void prefetchPayload(T * const & argument)
+{
+	prefetchForRead(argument);
+}
+
+template <typename T>
+void prefetchPayload(const std::shared_ptr<T> & argument)
+{
+	prefetchForRead(argument.get());
+}
+
+template <typename T, typename D>
+void prefetchPayload(const std::unique_ptr<T, D> & argument)
+{
+	prefetchForRead(argument.get());
+}
+
+template <typename Tuple, std::size_t ...Indexes>
+void prefetchTuplePayload(const Tuple & tuple, IndexSequence<Indexes...>)
+{
+	const int dummy[] = { 0, (prefetchPayload(std::get<Indexes>(tuple)), 0)... };
+	(void)dummy;
+}
+
+// OPT-67: Calls func(item) for each item in list. While an item is
+// dispatched, the node distance items ahead is prefetched, and so is the
+// payload of the arguments of the node distance - 1 items ahead, whose node
+// is already in the cache. So the loop doesn't stall on the next node when
+// the nodes are scattered in memory.
+// getArguments(item) returns the tuple of the arguments of the item.
+template <std::size_t distance>
+struct ListPrefetcher
+{
+	template <typename List, typename GetArguments, typename Func>
+	static void forEach(List & list, GetArguments && getArguments, Func && func)
+	{
+		using Arguments = typename std::decay<decltype(getArguments(*list.begin()))>::type;
+		using IndexList = typename MakeIndexSequence<std::tuple_size<Arguments>::value>::Type;
+
+		const auto end = list.end();
+		auto ahead = list.begin();
+		if(ahead == end) {
+			return;
+		}
+
+		// ahead is the last node which is prefetched, its next node is only
+		// read after it's in the cache.
+		prefetchListValue(&*ahead);
+		for(std::size_t i = 1; i < distance; ++i) {
+			prefetchTuplePayload(getArguments(*ahead), IndexList());
+			if(++ahead == end) {
+				break;
+			}
+			prefetchListValue(&*ahead);
+		}
+
+		for(auto it = list.begin(); it != end; ++it) {
+			if(ahead != end) {
+				prefetchTuplePayload(getArguments(*ahead), IndexList());
+				if(++ahead != end) {
+					prefetchListValue(&*ahead);
+				}
+			}
+			func(*it);
+		}
+	}
+};
+
+template <>
+struct ListPrefetcher <0>
+{
+	template <typename List, typename GetArguments, typename Func>
+	static void forEach(List & list, GetArguments && /*getArguments*/, Func && func)
+	{
+		for(auto & item : list) {
+			func(item);
+		}
+	}
+};
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
@@ -0,0 +1,399 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef QUEUEREPLY_I_H_EVENTPP
+#define QUEUEREPLY_I_H_EVENTPP
+
+#include "poolallocator_i.h"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace eventpp {
+
+template <typename R>
+class QueueReply;
+
+namespace internal_ {
+
+// Wakes the threads waiting on the replies of one queue. A consumer which
+// completes replies while it processes the queue notifies once, when it's
+// done, so one wake fulfils all replies of the batch.
+struct ReplyNotifier
+{
+	ReplyNotifier() : mutex(), condition(), waiterCount(0), notifyPending(false)
+	{
+	}
+
+	// The waiter counts itself before it checks the slot, and the slot is
+	// ready before this reads the count, both sequentially consistent, so
+	// either the waiter sees the slot ready or this sees the waiter.
+	void notifyWaiters() {
+		if(waiterCount.load(std::memory_order_seq_cst) > 0) {
+			{
+				std::lock_guard<std::mutex> lockGuard(mutex);
+			}
+			condition.notify_all();
+		}
+	}
+
+	void flush() {
+		if(notifyPending.load(std::memory_order_relaxed)
+			&& notifyPending.exchange(false, std::memory_order_acq_rel)) {
+			notifyWaiters();
+		}
+	}
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::atomic<int> waiterCount;
+	std::atomic<bool> notifyPending;
+};
+
+// The queues without QueueReplyPooled have nothing to notify.
+struct NoReplyNotifier
+{
+	void flush() {
+	}
+};
+
+template <typename Notifier>
+struct ReplyFlushGuard
+{
+	explicit ReplyFlushGuard(Notifier & notifier) : notifier(notifier)
+	{
+	}
+
+	~ReplyFlushGuard() {
+		notifier.flush();
+	}
+
+	Notifier & notifier;
+};
+
+template <typename R>
+struct ReplyValue
+{
+	ReplyValue() : storage(), hasValue(false)
+	{
+	}
+
+	~ReplyValue() {
+		reset();
+	}
+
+	template <typename T>
+	void set(T && value) {
+		reset();
+		new (&storage) R(std::forward<T>(value));
+		hasValue = true;
+	}
+
+	void reset() {
+		if(hasValue) {
+			get().~R();
+			hasValue = false;
+		}
+	}
+
+	R & get() {
+		assert(hasValue);
+		return *reinterpret_cast<R *>(&storage);
+	}
+
+	typename std::aligned_storage<sizeof(R), alignof(R)>::type storage;
+	bool hasValue;
+};
+
+template <>
+struct ReplyValue <void>
+{
+	ReplyValue() : hasValue(false)
+	{
+	}
+
+	void set() {
+		hasValue = true;
+	}
+
+	void get() {
+	}
+
+	bool hasValue;
+};
+
+// OPT-49: The shared state of a reply, taken from a NodePool instead of the
+// heap allocated state of a std::promise. The QueueReply holds a reference,
+// and so does the queued event until it's dispatched. The value is written
+// by the consumer before ready is set, and read by the requester after it
+// sees ready.
+template <typename R>
+class ReplySlot
+{
+private:
+	using Pool = NodePool<ReplySlot, 256>;
+
+public:
+	static ReplySlot * create(ReplyNotifier * notifier) {
+		void * p = Pool::instance().allocate();
+		if(p == nullptr) {
+			throw std::bad_alloc();
+		}
+		return new (p) ReplySlot(notifier);
+	}
+
+	void addReference() {
+		referenceCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void release() {
+		if(referenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			this->~ReplySlot();
+			Pool::instance().deallocate(this);
+		}
+	}
+
+	ReplyValue<R> & getValue() {
+		return value;
+	}
+
+	// Called once, by the consumer. With deferNotify, the waiters are woken
+	// by the flush at the end of the batch. Releases the reference of the
+	// queued event.
+	void complete(const bool deferNotify) {
+		ReplyNotifier * const n = notifier;
+		ready.store(true, std::memory_order_seq_cst);
+		if(deferNotify) {
+			n->notifyPending.store(true, std::memory_order_release);
+		}
+		else {
+			n->notifyWaiters();
+		}
+		release();
+	}
+
+	bool isReady() const {
+		return ready.load(std::memory_order_acquire);
+	}
+
+	void wait() const {
+		if(isReady()) {
+			return;
+		}
+		notifier->waiterCount.fetch_add(1, std::memory_order_seq_cst);
+		{
+			std::unique_lock<std::mutex> lock(notifier->mutex);
+			notifier->condition.wait(lock, [this]() {
+				return ready.load(std::memory_order_seq_cst);
+			});
+		}
+		notifier->waiterCount.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	template <class Rep, class Period>
+	bool waitFor(const std::chrono::duration<Rep, Period> & duration) const {
+		if(isReady()) {
+			return true;
+		}
+		notifier->waiterCount.fetch_add(1, std::memory_order_seq_cst);
+		bool result;
+		{
+			std::unique_lock<std::mutex> lock(notifier->mutex);
+			result = notifier->condition.wait_for(lock, duration, [this]() {
+				return ready.load(std::memory_order_seq_cst);
+			});
+		}
+		notifier->waiterCount.fetch_sub(1, std::memory_order_relaxed);
+		return result;
+	}
+
+private:
+	explicit ReplySlot(ReplyNotifier * notifier)
+		: ready(false), referenceCount(1), notifier(notifier), value()
+	{
+	}
+
+	ReplySlot(const ReplySlot &) = delete;
+	ReplySlot & operator = (const ReplySlot &) = delete;
+
+private:
+	std::atomic<bool> ready;
+	std::atomic<unsigned int> referenceCount;
+	ReplyNotifier * notifier;
+	ReplyValue<R> value;
+};
+
+// The stamp of a queued event which has no time and no trace ID, used when
+// only the reply is stamped.
+struct QueueEmptyStamp
+{
+};
+
+// The reply of a queued event made by enqueueWithReply, null for the other
+// events. A copy of the event has no reply. If the event is destroyed
+// before it's dispatched, the reply is completed with no value, so the
+// requester never waits for an event which is gone.
+template <typename Base, typename R>
+struct QueueReplyStamp : public Base
+{
+	QueueReplyStamp() : Base(), reply(nullptr)
+	{
+	}
+
+	QueueReplyStamp(const QueueReplyStamp & other)
+		: Base(other), reply(nullptr)
+	{
+	}
+
+	QueueReplyStamp(QueueReplyStamp && other) noexcept
+		: Base(std::move(other)), reply(other.reply)
+	{
+		other.reply = nullptr;
+	}
+
+	~QueueReplyStamp() {
+		if(reply != nullptr) {
+			reply->complete(false);
+		}
+	}
+
+	QueueReplyStamp & operator = (const QueueReplyStamp & other) {
+		Base::operator = (other);
+		return *this;
+	}
+
+	QueueReplyStamp & operator = (QueueReplyStamp && other) noexcept {
+		if(this != &other) {
+			Base::operator = (std::move(other));
+			if(reply != nullptr) {
+				reply->complete(false);
+			}
+			reply = other.reply;
+			other.reply = nullptr;
+		}
+		return *this;
+	}
+
+	void setReply(ReplySlot<R> * slot) {
+		assert(reply == nullptr);
+		slot->addReference();
+		reply = slot;
+	}
+
+	ReplySlot<R> * takeReply() {
+		ReplySlot<R> * slot = reply;
+		reply = nullptr;
+		return slot;
+	}
+
+	ReplySlot<R> * reply;
+};
+
+} //namespace internal_
+
+// OPT-49: The reply of an event enqueued by EventQueue::enqueueWithReply.
+// It's ready when the event is dispatched, and has the value returned by
+// the last listener called. It's ready with no value if no listener is
+// called, or if the event is destroyed without being dispatched, such as by
+// clearEvents, or a visitor processes it.
+// A QueueReply is movable, not copyable. The queue must outlive the waits
+// on its replies, the reply itself can outlive the queue.
+template <typename R>
+class QueueReply
+{
+private:
+	using Slot = internal_::ReplySlot<R>;
+
+public:
+	QueueReply() noexcept : slot(nullptr)
+	{
+	}
+
+	// Takes over the reference of slot, used by EventQueue.
+	explicit QueueReply(Slot * slot) noexcept : slot(slot)
+	{
+	}
+
+	QueueReply(QueueReply && other) noexcept : slot(other.slot)
+	{
+		other.slot = nullptr;
+	}
+
+	QueueReply & operator = (QueueReply && other) noexcept {
+		if(this != &other) {
+			if(slot != nullptr) {
+				slot->release();
+			}
+			slot = other.slot;
+			other.slot = nullptr;
+		}
+		return *this;
+	}
+
+	~QueueReply() {
+		if(slot != nullptr) {
+			slot->release();
+		}
+	}
+
+	QueueReply(const QueueReply &) = delete;
+	QueueReply & operator = (const QueueReply &) = delete;
+
+	bool valid() const {
+		return slot != nullptr;
+	}
+
+	bool isReady() const {
+		assert(valid());
+		return slot->isReady();
+	}
+
+	void wait() const {
+		assert(valid());
+		slot->wait();
+	}
+
+	// Returns false if the reply is not ready after duration.
+	template <class Rep, class Period>
+	bool waitFor(const std::chrono::duration<Rep, Period> & duration) const {
+		assert(valid());
+		return slot->waitFor(duration);
+	}
+
+	// Must be called after the reply is ready.
+	bool hasValue() const {
+		assert(isReady());
+		return slot->getValue().hasValue;
+	}
+
+	// Waits for the reply, which must have a value.
+	typename std::add_lvalue_reference<R>::type get() {
+		wait();
+		return slot->getValue().get();
+	}
+
+private:
+	Slot * slot;
+};
+
+
+} //namespace eventpp
+
+#endif
+
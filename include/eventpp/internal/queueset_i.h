@@ -0,0 +1,101 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef QUEUESET_I_H_EVENTPP
+#define QUEUESET_I_H_EVENTPP
+
+#include "epochreclaimer_i.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace eventpp {
+
+class QueueSet;
+
+namespace internal_ {
+
+// OPT-57: The wakeup object which the queues in a QueueSet share.
+// signal is called by the producers after an event is published. The
+// sequence tells a waiter whether any queue was signaled after it checked
+// the queues, and the mutex is only locked if a thread is waiting.
+class QueueSetSignal
+{
+public:
+	QueueSetSignal()
+		: mutex(), conditionVariable(), sequence(0), waiterCount(0)
+	{
+	}
+
+	QueueSetSignal(const QueueSetSignal &) = delete;
+	QueueSetSignal & operator = (const QueueSetSignal &) = delete;
+
+	void signal()
+	{
+		sequence.fetch_add(1, std::memory_order_seq_cst);
+		if(waiterCount.load(std::memory_order_seq_cst) > 0) {
+			{
+				// A waiter between its check and its wait holds the mutex.
+				std::lock_guard<std::mutex> lock(mutex);
+			}
+			conditionVariable.notify_all();
+		}
+	}
+
+	// Must be called before the queues are checked.
+	void addWaiter()
+	{
+		waiterCount.fetch_add(1, std::memory_order_seq_cst);
+	}
+
+	void removeWaiter()
+	{
+		waiterCount.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	std::uint64_t getSequence() const
+	{
+		return sequence.load(std::memory_order_seq_cst);
+	}
+
+	// Returns when the sequence is not lastSequence or the time is out.
+	void waitUntil(const std::uint64_t lastSequence, const std::chrono::steady_clock::time_point & deadline)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		auto isSignaled = [this, lastSequence]() -> bool {
+			return sequence.load(std::memory_order_seq_cst) != lastSequence;
+		};
+		if(deadline == (std::chrono::steady_clock::time_point::max)()) {
+			conditionVariable.wait(lock, isSignaled);
+		}
+		else {
+			conditionVariable.wait_until(lock, deadline, isSignaled);
+		}
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable conditionVariable;
+	std::atomic<std::uint64_t> sequence;
+	std::atomic<int> waiterCount;
+};
+
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
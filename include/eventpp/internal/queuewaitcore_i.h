@@ -0,0 +1,211 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef QUEUEWAITCORE_I_H_EVENTPP
+#define QUEUEWAITCORE_I_H_EVENTPP
+
+#include "spinwait_i.h"
+#include "waitmonitor_i.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// The shared code is only shared if the compiler doesn't copy it into the
+// callers again.
+#ifndef EVENTPP_NOINLINE
+	#if defined(_MSC_VER)
+		#define EVENTPP_NOINLINE __declspec(noinline)
+	#elif defined(__GNUC__)
+		#define EVENTPP_NOINLINE __attribute__((noinline))
+	#else
+		#define EVENTPP_NOINLINE
+	#endif
+#endif
+
+namespace eventpp {
+
+namespace internal_ {
+
+// OPT-84: The counts of the WaitStrategy policy, as values.
+struct QueueWaitParams
+{
+	unsigned int spinCount;
+	unsigned int minSpinCount;
+	unsigned int yieldCount;
+	bool adaptive;
+};
+
+// Returns true if the queue, passed as a pointer, has events to process.
+using QueueCanProcessFunc = bool (*)(const void * queue);
+// Returns true if the clock is at or past the deadline, passed as a pointer.
+using QueueIsPastFunc = bool (*)(const void * deadline);
+
+template <typename Clock>
+bool isClockPast(const void * deadline)
+{
+	return Clock::now() >= *static_cast<const typename Clock::time_point *>(deadline);
+}
+
+// OPT-84: The spin, yield and busy phases of EventQueue::wait and waitFor,
+// and their counters (OPT-31). It's not a template, the queue is only a
+// pointer and a function to check it, so all the EventQueue types share one
+// copy of the loops. The park phase is in QueueParkCore, it needs the mutex
+// and the condition variable of the Threading policy.
+class QueueWaitCore
+{
+public:
+	explicit QueueWaitCore(const unsigned int spinCount)
+		: spinWakeCount(0), yieldWakeCount(0), parkCount(0), timeoutCount(0), spinLimit(spinCount)
+	{
+	}
+
+	// Phase 2 and 3 of waiting. Returns true if the queue can be processed.
+	// monitorWord is null, or the word the producers increase (OPT-60).
+	EVENTPP_NOINLINE bool spinWait(
+			const void * queue,
+			const QueueCanProcessFunc canProcess,
+			const std::atomic<std::uint32_t> * monitorWord,
+			const QueueWaitParams params
+		)
+	{
+		const unsigned int limit = (params.adaptive ? spinLimit.load(std::memory_order_relaxed) : params.spinCount);
+		for(unsigned int i = 0; i < limit; ++i) {
+			// Read before the queue is checked, so an event published after
+			// the check changes the word and ends the round.
+			const std::uint32_t monitorValue = (monitorWord != nullptr ? monitorWord->load(std::memory_order_acquire) : 0);
+			if(canProcess(queue)) {
+				spinWakeCount.fetch_add(1, std::memory_order_relaxed);
+				// Nearly missed the events, spin longer next time.
+				if(i >= limit / 2) {
+					adaptSpinLimit(limit, true, params);
+				}
+				return true;
+			}
+			if(monitorWord != nullptr) {
+				WaitMonitor::waitWhileEqual(*monitorWord, monitorValue);
+			}
+			else {
+				cpuRelax();
+			}
+		}
+
+		for(unsigned int i = 0; i < params.yieldCount; ++i) {
+			if(canProcess(queue)) {
+				yieldWakeCount.fetch_add(1, std::memory_order_relaxed);
+				// The events came shortly after spinning.
+				adaptSpinLimit(limit, true, params);
+				return true;
+			}
+			std::this_thread::yield();
+		}
+
+		// The events are far apart, spinning only wastes the CPU.
+		adaptSpinLimit(limit, false, params);
+		return false;
+	}
+
+	// Spin, or yield if yieldCount isn't 0, and check the deadline every 64
+	// rounds, for the strategies which don't park.
+	EVENTPP_NOINLINE bool busyWaitUntil(
+			const void * queue,
+			const QueueCanProcessFunc canProcess,
+			const void * deadline,
+			const QueueIsPastFunc isPast,
+			const QueueWaitParams params
+		) const
+	{
+		for(;;) {
+			for(int i = 0; i < 64; ++i) {
+				if(canProcess(queue)) {
+					return true;
+				}
+				if(params.yieldCount > 0) {
+					std::this_thread::yield();
+				}
+				else {
+					cpuRelax();
+				}
+			}
+			if(deadline != nullptr && isPast(deadline)) {
+				return canProcess(queue);
+			}
+		}
+	}
+
+	std::atomic<std::uint64_t> spinWakeCount;
+	std::atomic<std::uint64_t> yieldWakeCount;
+	std::atomic<std::uint64_t> parkCount;
+	std::atomic<std::uint64_t> timeoutCount;
+	std::atomic<unsigned int> spinLimit;
+
+private:
+	void adaptSpinLimit(const unsigned int limit, const bool grow, const QueueWaitParams params)
+	{
+		if(! params.adaptive) {
+			return;
+		}
+		const unsigned int maxLimit = params.spinCount;
+		const unsigned int minLimit = params.minSpinCount;
+		unsigned int newLimit;
+		if(grow) {
+			newLimit = (limit >= maxLimit / 2 ? maxLimit : limit * 2);
+		}
+		else {
+			newLimit = (limit <= minLimit * 2 ? minLimit : limit / 2);
+		}
+		spinLimit.store(newLimit, std::memory_order_relaxed);
+	}
+};
+
+// OPT-84: The park phase, on the condition variable of the queue. It only
+// depends on the Threading policy, so the queues with the same threading
+// share it.
+template <typename Mutex, typename ConditionVariable>
+struct QueueParkCore
+{
+	EVENTPP_NOINLINE static void park(
+			Mutex & mutex,
+			ConditionVariable & conditionVariable,
+			const void * queue,
+			const QueueCanProcessFunc canProcess
+		)
+	{
+		std::unique_lock<Mutex> lock(mutex);
+		conditionVariable.wait(lock, [queue, canProcess]() -> bool {
+			return canProcess(queue);
+		});
+	}
+
+	EVENTPP_NOINLINE static bool parkFor(
+			Mutex & mutex,
+			ConditionVariable & conditionVariable,
+			const std::chrono::nanoseconds timeout,
+			const void * queue,
+			const QueueCanProcessFunc canProcess
+		)
+	{
+		std::unique_lock<Mutex> lock(mutex);
+		return conditionVariable.wait_for(lock, timeout, [queue, canProcess]() -> bool {
+			return canProcess(queue);
+		});
+	}
+};
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
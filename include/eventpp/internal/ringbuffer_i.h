@@ -0,0 +1,220 @@
+// eventpp library - ARM-Linux / x86-Linux optimization extension
+// Bounded lock-free ring buffer used by RingEventQueue.
+//
+// Design (OPT-17):
+// - Fixed power-of-two array of slots, each slot carries a sequence number
+//   (Dmitry Vyukov's bounded queue). A slot is writable when
+//   sequence == position, readable when sequence == position + 1.
+// - Producers claim a position with a CAS on enqueuePos (RingProducerMulti),
+//   or with a plain store when there is only one producer (RingProducerSingle).
+// - Consumers always claim with a CAS on dequeuePos, so several threads may
+//   process the same queue, and a producer can evict the oldest item.
+// - The item is consumed in place and the slot is released after the
+//   consumer returns, no copy or move is needed to dispatch it.
+//   tryPopReleased moves the item out and releases the slot first, for a
+//   consumer which may push to the same full ring.
+// - enqueuePos and dequeuePos live on separate cache lines (OPT-10).
+
+#ifndef RINGBUFFER_I_H_EVENTPP
+#define RINGBUFFER_I_H_EVENTPP
+
+#include "eventqueue_i.h"
+#include "../eventpolicies.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace eventpp {
+
+namespace internal_ {
+
+template <typename T, typename RingProducer_>
+class RingBuffer
+{
+private:
+	struct Slot
+	{
+		std::atomic<std::size_t> sequence;
+		BufferedItem<T> item;
+	};
+
+	static constexpr bool singleProducer = std::is_same<RingProducer_, RingProducerSingle>::value;
+
+	static std::size_t roundUpCapacity(std::size_t capacity) {
+		std::size_t result = 2;
+		while(result < capacity) {
+			result <<= 1;
+		}
+		return result;
+	}
+
+	static bool isBefore(const std::size_t a, const std::size_t b) {
+		return static_cast<std::ptrdiff_t>(a - b) < 0;
+	}
+
+	struct SlotReleaser
+	{
+		~SlotReleaser() {
+			slot->item.clear();
+			slot->sequence.store(nextSequence, std::memory_order_release);
+		}
+
+		Slot * slot;
+		std::size_t nextSequence;
+	};
+
+public:
+	explicit RingBuffer(const std::size_t capacity)
+		:
+			mask(roundUpCapacity(capacity) - 1),
+			slotList(new Slot[mask + 1]),
+			enqueuePos(0),
+			dequeuePos(0)
+	{
+		for(std::size_t i = 0; i <= mask; ++i) {
+			slotList[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	RingBuffer(const RingBuffer &) = delete;
+	RingBuffer & operator = (const RingBuffer &) = delete;
+
+	// Returns false and leaves item untouched if the ring is full.
+	bool tryPush(T && item)
+	{
+		Slot * slot;
+		std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+		for(;;) {
+			slot = &slotList[pos & mask];
+			const std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+			if(sequence == pos) {
+				if(singleProducer) {
+					enqueuePos.store(pos + 1, std::memory_order_relaxed);
+					break;
+				}
+				if(enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			}
+			else if(isBefore(sequence, pos)) {
+				return false;
+			}
+			else {
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		slot->item.set(std::move(item));
+		slot->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Claims the oldest item, passes it to func, then releases the slot.
+	// Returns false if the ring is empty.
+	template <typename F>
+	bool tryPop(F && func)
+	{
+		Slot * slot;
+		std::size_t pos;
+		if(! doClaimPop(slot, pos)) {
+			return false;
+		}
+
+		SlotReleaser releaser { slot, pos + mask + 1 };
+		func(slot->item.get());
+		return true;
+	}
+
+	// Same as tryPop, but the item is moved out of the slot and the slot is
+	// released before func is called, so func may push to the ring even if
+	// it's full.
+	template <typename F>
+	bool tryPopReleased(F && func)
+	{
+		Slot * slot;
+		std::size_t pos;
+		if(! doClaimPop(slot, pos)) {
+			return false;
+		}
+
+		BufferedItem<T> item;
+		{
+			SlotReleaser releaser { slot, pos + mask + 1 };
+			item.set(std::move(slot->item.get()));
+		}
+		func(item.get());
+		return true;
+	}
+
+	// OPT-85: The oldest item, which stays in the ring until tryPop, or
+	// nullptr if the ring is empty. Only for a single consumer.
+	T * peek()
+	{
+		const std::size_t pos = dequeuePos.load(std::memory_order_relaxed);
+		Slot & slot = slotList[pos & mask];
+		if(slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+			return nullptr;
+		}
+		return &slot.item.get();
+	}
+
+	bool empty() const
+	{
+		const std::size_t pos = dequeuePos.load(std::memory_order_acquire);
+		return isBefore(slotList[pos & mask].sequence.load(std::memory_order_acquire), pos + 1);
+	}
+
+	bool full() const
+	{
+		const std::size_t pos = enqueuePos.load(std::memory_order_acquire);
+		return isBefore(slotList[pos & mask].sequence.load(std::memory_order_acquire), pos);
+	}
+
+	// Approximate count, it includes the items which are being written or read.
+	std::size_t size() const
+	{
+		const std::size_t tail = dequeuePos.load(std::memory_order_acquire);
+		const std::size_t head = enqueuePos.load(std::memory_order_acquire);
+		return isBefore(tail, head) ? head - tail : 0;
+	}
+
+	std::size_t capacity() const
+	{
+		return mask + 1;
+	}
+
+private:
+	bool doClaimPop(Slot *& slot, std::size_t & pos)
+	{
+		pos = dequeuePos.load(std::memory_order_relaxed);
+		for(;;) {
+			slot = &slotList[pos & mask];
+			const std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+			if(sequence == pos + 1) {
+				if(dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					return true;
+				}
+			}
+			else if(isBefore(sequence, pos + 1)) {
+				return false;
+			}
+			else {
+				pos = dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	const std::size_t mask;
+	std::unique_ptr<Slot[]> slotList;
+	EVENTPP_ALIGN_CACHELINE std::atomic<std::size_t> enqueuePos;
+	EVENTPP_ALIGN_CACHELINE std::atomic<std::size_t> dequeuePos;
+};
+
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
@@ -0,0 +1,249 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SELFREMOVER_I_H_EVENTPP
+#define SELFREMOVER_I_H_EVENTPP
+
+#include "listenergroup_i.h"
+
+#include <atomic>
+#include <type_traits>
+#include <utility>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// With ListenerGroup, the data of the listener is its group, setting
+// removed removes it, there is nothing more to do.
+struct GroupSelfRemover
+{
+	template <typename ...Args>
+	explicit GroupSelfRemover(Args && ...)
+	{
+	}
+
+	void operator() () const {
+	}
+};
+
+// The classes without ListenerGroup remove the listener by its handle. The
+// handle is set after the listener is added, and another thread may call
+// and disarm the listener before that. Both sides set their flag, the one
+// which comes last removes the listener, so it's removed once, and the
+// handle is only read after it's written.
+class SelfRemoverHandleFlags
+{
+public:
+	// Called after the handle is written. Returns true if the listener is
+	// already disarmed, then the caller removes it.
+	bool publish() {
+		return (flags.fetch_or(handleSet, std::memory_order_acq_rel) & disarmed) != 0;
+	}
+
+	// Called when the listener is disarmed. Returns true if the handle is
+	// written, then the caller removes it.
+	bool disarm() {
+		return (flags.fetch_or(disarmed, std::memory_order_acq_rel) & handleSet) != 0;
+	}
+
+private:
+	enum : unsigned int {
+		handleSet = 1,
+		disarmed = 2
+	};
+
+	std::atomic<unsigned int> flags { 0 };
+};
+
+template <typename DispatcherType>
+struct DispatcherSelfRemover
+{
+	DispatcherSelfRemover(DispatcherType & dispatcher, const typename DispatcherType::Event & event)
+		: dispatcher(dispatcher), event(event), handle(), flags()
+	{
+	}
+
+	void operator() () {
+		if(flags.disarm()) {
+			dispatcher.removeListener(event, handle);
+		}
+	}
+
+	void setHandle(const typename DispatcherType::Handle & newHandle) {
+		handle = newHandle;
+		if(flags.publish()) {
+			dispatcher.removeListener(event, handle);
+		}
+	}
+
+	DispatcherType & dispatcher;
+	typename DispatcherType::Event event;
+	typename DispatcherType::Handle handle;
+	SelfRemoverHandleFlags flags;
+};
+
+template <typename CallbackListType>
+struct CallbackListSelfRemover
+{
+	explicit CallbackListSelfRemover(CallbackListType & callbackList)
+		: callbackList(callbackList), handle(), flags()
+	{
+	}
+
+	void operator() () {
+		if(flags.disarm()) {
+			callbackList.remove(handle);
+		}
+	}
+
+	void setHandle(const typename CallbackListType::Handle & newHandle) {
+		handle = newHandle;
+		if(flags.publish()) {
+			callbackList.remove(handle);
+		}
+	}
+
+	CallbackListType & callbackList;
+	typename CallbackListType::Handle handle;
+	SelfRemoverHandleFlags flags;
+};
+
+// OPT-48: The data of a listener which removes itself, as with
+// CounterRemover and ConditionalRemover. It's held by an intrusive
+// reference in the wrapper, and by the node when it's the group of the
+// listener, so there is one allocation and no shared_ptr.
+// removed is also the flag which disarms the listener. The thread which
+// disarms it is the only one to make the last call. It also removes the
+// listener, unless the handle isn't set yet, then the thread which sets
+// the handle removes it.
+template <typename Callback, typename Remover>
+struct SelfRemoverData : public ListenerGroupState
+{
+	template <typename ...RemoverArgs>
+	explicit SelfRemoverData(const Callback & listener, RemoverArgs && ...removerArgs)
+		: ListenerGroupState(), listener(listener), remover(std::forward<RemoverArgs>(removerArgs)...)
+	{
+	}
+
+	// Returns false if the listener is already disarmed.
+	bool disarm() {
+		if(removed.exchange(true, std::memory_order_acq_rel)) {
+			return false;
+		}
+		remover();
+		return true;
+	}
+
+	bool isDisarmed() const {
+		return removed.load(std::memory_order_acquire);
+	}
+
+	Callback listener;
+	Remover remover;
+};
+
+// The data of the listener is its group, the listener is removed without
+// its handle, with no lock.
+template <typename DispatcherType, typename Wrapper>
+typename DispatcherType::Handle addSelfRemoverListener(
+		DispatcherType & dispatcher,
+		const typename DispatcherType::Event & event,
+		const Wrapper & wrapper,
+		const typename DispatcherType::Handle * before,
+		const bool prepend,
+		std::true_type
+	)
+{
+	ListenerGroup group(wrapper.reference);
+	if(before != nullptr) {
+		return dispatcher.insertListener(event, wrapper, *before, group);
+	}
+	if(prepend) {
+		return dispatcher.prependListener(event, wrapper, group);
+	}
+	return dispatcher.appendListener(event, wrapper, group);
+}
+
+template <typename DispatcherType, typename Wrapper>
+typename DispatcherType::Handle addSelfRemoverListener(
+		DispatcherType & dispatcher,
+		const typename DispatcherType::Event & event,
+		const Wrapper & wrapper,
+		const typename DispatcherType::Handle * before,
+		const bool prepend,
+		std::false_type
+	)
+{
+	typename DispatcherType::Handle handle;
+	if(before != nullptr) {
+		handle = dispatcher.insertListener(event, wrapper, *before);
+	}
+	else if(prepend) {
+		handle = dispatcher.prependListener(event, wrapper);
+	}
+	else {
+		handle = dispatcher.appendListener(event, wrapper);
+	}
+	static_cast<typename Wrapper::Data *>(wrapper.reference.get())->remover.setHandle(handle);
+	return handle;
+}
+
+template <typename CallbackListType, typename Wrapper>
+typename CallbackListType::Handle addSelfRemoverCallback(
+		CallbackListType & callbackList,
+		const Wrapper & wrapper,
+		const typename CallbackListType::Handle * before,
+		const bool prepend,
+		std::true_type
+	)
+{
+	ListenerGroup group(wrapper.reference);
+	if(before != nullptr) {
+		return callbackList.insert(wrapper, *before, group);
+	}
+	if(prepend) {
+		return callbackList.prepend(wrapper, group);
+	}
+	return callbackList.append(wrapper, group);
+}
+
+template <typename CallbackListType, typename Wrapper>
+typename CallbackListType::Handle addSelfRemoverCallback(
+		CallbackListType & callbackList,
+		const Wrapper & wrapper,
+		const typename CallbackListType::Handle * before,
+		const bool prepend,
+		std::false_type
+	)
+{
+	typename CallbackListType::Handle handle;
+	if(before != nullptr) {
+		handle = callbackList.insert(wrapper, *before);
+	}
+	else if(prepend) {
+		handle = callbackList.prepend(wrapper);
+	}
+	else {
+		handle = callbackList.append(wrapper);
+	}
+	static_cast<typename Wrapper::Data *>(wrapper.reference.get())->remover.setHandle(handle);
+	return handle;
+}
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
+
@@ -0,0 +1,438 @@
+// eventpp library - ARM-Linux / x86-Linux optimization extension
+// Bounded ring buffer in shared memory, used by SharedMemoryEventQueue.
+//
+// Design (OPT-32):
+// - Same algorithm as RingBuffer (OPT-17), a power-of-two array of slots,
+//   each slot carries a sequence number. Producers and consumers claim the
+//   positions with a CAS, so any number of processes may enqueue and process.
+// - The layout is fixed: a header with the positions on separate cache lines,
+//   followed by the slots. The items are trivially copyable and are copied
+//   into the slot with memcpy, there are no pointers in the region.
+// - The first process which maps the region initializes it, the state word
+//   goes 0 (zero filled by ftruncate) -> 1 (initializing) -> 2 (ready).
+//   The others wait for 2, then check the layout matches their own.
+// - A consumer which has nothing to do sleeps on a futex in the region,
+//   without FUTEX_PRIVATE_FLAG so it's woken across processes. Producers make
+//   the wake system call only when waitingCount is not zero. The other POSIX
+//   systems, which have no futex, sleep in short steps instead.
+// - A process which dies while writing a slot leaves it claimed, the
+//   consumers stop at that slot until the region is recreated.
+
+#ifndef SHAREDMEMORYRING_I_H_EVENTPP
+#define SHAREDMEMORYRING_I_H_EVENTPP
+
+#include "../eventpolicies.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+	#include <linux/futex.h>
+	#include <sys/syscall.h>
+	#include <time.h>
+#endif
+
+namespace eventpp {
+
+namespace internal_ {
+
+// A std::tuple is not trivially copyable, so the arguments in shared memory
+// are kept in this plain struct. It's trivially copyable if all Ts are.
+template <typename ...Ts>
+struct TrivialTuple
+{
+};
+
+template <typename T, typename ...Ts>
+struct TrivialTuple <T, Ts...>
+{
+	TrivialTuple() = default;
+
+	template <typename U, typename ...Us,
+		typename std::enable_if<! std::is_same<typename std::decay<U>::type, TrivialTuple>::value, int>::type = 0
+	>
+	explicit TrivialTuple(U && value, Us && ...values)
+		: head(std::forward<U>(value)), tail(std::forward<Us>(values)...)
+	{
+	}
+
+	T head;
+	TrivialTuple<Ts...> tail;
+};
+
+template <std::size_t N>
+struct TrivialTupleGetter
+{
+	template <typename T, typename ...Ts>
+	static auto get(TrivialTuple<T, Ts...> & tuple) -> decltype(TrivialTupleGetter<N - 1>::get(tuple.tail)) {
+		return TrivialTupleGetter<N - 1>::get(tuple.tail);
+	}
+
+	template <typename T, typename ...Ts>
+	static auto get(const TrivialTuple<T, Ts...> & tuple) -> decltype(TrivialTupleGetter<N - 1>::get(tuple.tail)) {
+		return TrivialTupleGetter<N - 1>::get(tuple.tail);
+	}
+};
+
+template <>
+struct TrivialTupleGetter <0>
+{
+	template <typename T, typename ...Ts>
+	static T & get(TrivialTuple<T, Ts...> & tuple) {
+		return tuple.head;
+	}
+
+	template <typename T, typename ...Ts>
+	static const T & get(const TrivialTuple<T, Ts...> & tuple) {
+		return tuple.head;
+	}
+};
+
+template <typename T>
+class SharedMemoryRing
+{
+private:
+	static_assert(std::is_trivially_copyable<T>::value, "SharedMemoryRing: the item must be trivially copyable.");
+	static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "SharedMemoryRing: requires lock free atomics.");
+
+	enum : std::uint32_t {
+		magicNumber = 0x51505645, // "EVPQ"
+		layoutVersion = 1,
+		stateReady = 2
+	};
+
+	struct Header
+	{
+		std::atomic<std::uint32_t> state;
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint32_t slotSize;
+		std::uint64_t capacity;
+		EVENTPP_ALIGN_CACHELINE std::atomic<std::uint64_t> enqueuePos;
+		EVENTPP_ALIGN_CACHELINE std::atomic<std::uint64_t> dequeuePos;
+		EVENTPP_ALIGN_CACHELINE std::atomic<std::uint32_t> wakeSequence;
+		std::atomic<std::uint32_t> waitingCount;
+	};
+
+	struct Slot
+	{
+		std::atomic<std::uint64_t> sequence;
+		T item;
+	};
+
+	static constexpr std::size_t slotOffset = (sizeof(Header) + EVENTPP_CACHELINE_SIZE - 1) / EVENTPP_CACHELINE_SIZE * EVENTPP_CACHELINE_SIZE;
+
+	static std::uint64_t roundUpCapacity(const std::size_t capacity) {
+		std::uint64_t result = 2;
+		while(result < capacity) {
+			result <<= 1;
+		}
+		return result;
+	}
+
+	static bool isBefore(const std::uint64_t a, const std::uint64_t b) {
+		return static_cast<std::int64_t>(a - b) < 0;
+	}
+
+	struct SlotReleaser
+	{
+		~SlotReleaser() {
+			slot->sequence.store(nextSequence, std::memory_order_release);
+		}
+
+		Slot * slot;
+		std::uint64_t nextSequence;
+	};
+
+public:
+	// The size of the region for capacity items.
+	static std::size_t getMemorySize(const std::size_t capacity) {
+		return slotOffset + static_cast<std::size_t>(roundUpCapacity(capacity)) * sizeof(Slot);
+	}
+
+	SharedMemoryRing()
+		: memory(nullptr), memorySize(0), header(nullptr), slotList(nullptr), mask(0)
+	{
+	}
+
+	~SharedMemoryRing()
+	{
+		if(memory != nullptr) {
+			munmap(memory, memorySize);
+		}
+	}
+
+	SharedMemoryRing(const SharedMemoryRing &) = delete;
+	SharedMemoryRing & operator = (const SharedMemoryRing &) = delete;
+
+	// Maps the shared memory object fd. If it's empty, it's sized for capacity
+	// and initialized, otherwise its existing layout is used.
+	// Returns false if fd can't be mapped, or the layout doesn't match T.
+	bool open(const int fd, const std::size_t capacity)
+	{
+		struct stat fileStat;
+		if(memory != nullptr || fd < 0 || fstat(fd, &fileStat) != 0) {
+			return false;
+		}
+
+		std::size_t size = static_cast<std::size_t>(fileStat.st_size);
+		if(size == 0) {
+			size = getMemorySize(capacity);
+			if(ftruncate(fd, static_cast<off_t>(size)) != 0) {
+				return false;
+			}
+		}
+		if(size < slotOffset) {
+			return false;
+		}
+
+		void * address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if(address == MAP_FAILED) {
+			return false;
+		}
+		memory = address;
+		memorySize = size;
+		header = static_cast<Header *>(memory);
+
+		std::uint32_t state = 0;
+		if(header->state.compare_exchange_strong(state, 1, std::memory_order_acq_rel)) {
+			doInitialize((size - slotOffset) / sizeof(Slot));
+		}
+		else if(! doWaitReady()) {
+			doClose();
+			return false;
+		}
+
+		if(header->magic != magicNumber
+			|| header->version != layoutVersion
+			|| header->slotSize != sizeof(Slot)
+			|| header->capacity == 0
+			|| slotOffset + header->capacity * sizeof(Slot) > size
+		) {
+			doClose();
+			return false;
+		}
+		mask = header->capacity - 1;
+		slotList = reinterpret_cast<Slot *>(static_cast<char *>(memory) + slotOffset);
+		return true;
+	}
+
+	bool isOpen() const
+	{
+		return slotList != nullptr;
+	}
+
+	bool tryPush(const T & item)
+	{
+		Slot * slot;
+		std::uint64_t pos = header->enqueuePos.load(std::memory_order_relaxed);
+		for(;;) {
+			slot = &slotList[pos & mask];
+			const std::uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+			if(sequence == pos) {
+				if(header->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			}
+			else if(isBefore(sequence, pos)) {
+				return false;
+			}
+			else {
+				pos = header->enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		std::memcpy(static_cast<void *>(&slot->item), &item, sizeof(T));
+		slot->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Claims the oldest item, passes it to func in place, then releases the slot.
+	// Returns false if the ring is empty.
+	template <typename F>
+	bool tryPop(F && func)
+	{
+		Slot * slot;
+		std::uint64_t pos = header->dequeuePos.load(std::memory_order_relaxed);
+		for(;;) {
+			slot = &slotList[pos & mask];
+			const std::uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+			if(sequence == pos + 1) {
+				if(header->dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			}
+			else if(isBefore(sequence, pos + 1)) {
+				return false;
+			}
+			else {
+				pos = header->dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		SlotReleaser releaser { slot, pos + mask + 1 };
+		func(slot->item);
+		return true;
+	}
+
+	bool empty() const
+	{
+		const std::uint64_t pos = header->dequeuePos.load(std::memory_order_acquire);
+		return isBefore(slotList[pos & mask].sequence.load(std::memory_order_acquire), pos + 1);
+	}
+
+	// Approximate count, it includes the items which are being written or read.
+	std::size_t size() const
+	{
+		const std::uint64_t tail = header->dequeuePos.load(std::memory_order_acquire);
+		const std::uint64_t head = header->enqueuePos.load(std::memory_order_acquire);
+		return isBefore(tail, head) ? static_cast<std::size_t>(head - tail) : 0;
+	}
+
+	std::size_t capacity() const
+	{
+		return static_cast<std::size_t>(mask + 1);
+	}
+
+	// Called by the producers after tryPush. The fence pairs with the one
+	// in waitFor, so either the producer sees the waiter, or the waiter
+	// sees the item.
+	void notify()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(header->waitingCount.load(std::memory_order_relaxed) > 0) {
+			header->wakeSequence.fetch_add(1, std::memory_order_release);
+			doFutexWake();
+		}
+	}
+
+	// Sleeps until the ring is not empty, or the timeout.
+	template <class Rep, class Period>
+	bool waitFor(const std::chrono::duration<Rep, Period> & duration)
+	{
+		using Clock = std::chrono::steady_clock;
+
+		const auto now = Clock::now();
+		const auto deadline = (duration >= Clock::time_point::max() - now)
+			? Clock::time_point::max()
+			: now + std::chrono::duration_cast<Clock::duration>(duration);
+		for(;;) {
+			if(! empty()) {
+				return true;
+			}
+
+			header->waitingCount.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const std::uint32_t sequence = header->wakeSequence.load(std::memory_order_acquire);
+			bool ready = ! empty();
+			if(! ready) {
+				const auto current = Clock::now();
+				if(current >= deadline) {
+					header->waitingCount.fetch_sub(1, std::memory_order_relaxed);
+					return false;
+				}
+				doFutexWait(sequence, deadline - current);
+				ready = ! empty();
+			}
+			header->waitingCount.fetch_sub(1, std::memory_order_relaxed);
+			if(ready) {
+				return true;
+			}
+		}
+	}
+
+private:
+	void doInitialize(const std::size_t slotCount)
+	{
+		std::uint64_t capacity = 2;
+		while(capacity * 2 <= slotCount) {
+			capacity <<= 1;
+		}
+		if(capacity > slotCount) {
+			capacity = 0;
+		}
+
+		Slot * slots = reinterpret_cast<Slot *>(static_cast<char *>(memory) + slotOffset);
+		for(std::uint64_t i = 0; i < capacity; ++i) {
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		header->magic = magicNumber;
+		header->version = layoutVersion;
+		header->slotSize = static_cast<std::uint32_t>(sizeof(Slot));
+		header->capacity = capacity;
+		header->enqueuePos.store(0, std::memory_order_relaxed);
+		header->dequeuePos.store(0, std::memory_order_relaxed);
+		header->wakeSequence.store(0, std::memory_order_relaxed);
+		header->waitingCount.store(0, std::memory_order_relaxed);
+		header->state.store(stateReady, std::memory_order_release);
+	}
+
+	// Another process is initializing the region, give it up to a second.
+	bool doWaitReady() const
+	{
+		for(int i = 0; i < 10000; ++i) {
+			if(header->state.load(std::memory_order_acquire) == stateReady) {
+				return true;
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		return false;
+	}
+
+	void doClose()
+	{
+		munmap(memory, memorySize);
+		memory = nullptr;
+		memorySize = 0;
+		header = nullptr;
+		slotList = nullptr;
+	}
+
+	template <class Rep, class Period>
+	void doFutexWait(const std::uint32_t sequence, const std::chrono::duration<Rep, Period> & duration)
+	{
+#if defined(__linux__)
+		const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+		timespec timeout;
+		timeout.tv_sec = static_cast<time_t>(nanoseconds / 1000000000);
+		timeout.tv_nsec = static_cast<long>(nanoseconds % 1000000000);
+		syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&header->wakeSequence), FUTEX_WAIT, sequence, &timeout, nullptr, 0);
+#else
+		(void)sequence;
+		const auto step = std::chrono::microseconds(200);
+		std::this_thread::sleep_for(duration < step ? std::chrono::duration_cast<std::chrono::microseconds>(duration) : step);
+#endif
+	}
+
+	void doFutexWake()
+	{
+#if defined(__linux__)
+		syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&header->wakeSequence), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+	}
+
+private:
+	void * memory;
+	std::size_t memorySize;
+	Header * header;
+	Slot * slotList;
+	std::uint64_t mask;
+};
+
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
+
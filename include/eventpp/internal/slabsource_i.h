@@ -0,0 +1,158 @@
+// eventpp library - ARM-Linux / x86-Linux optimization extension
+// Slab sources for NodePool.
+//
+// Design (OPT-21):
+// - A slab source is a type with two static functions,
+//     static void * allocate(std::size_t size, std::size_t alignment);
+//     static void deallocate(void * p, std::size_t size);
+//   allocate returns nullptr when out of memory. alignment is a power of
+//   two which is not less than size, NodePool finds the slab of a slot by
+//   masking the slot address (OPT-22). NodePool calls allocate for each new
+//   slab under its grow lock, and deallocate with the same size when the
+//   slab is trimmed or the pool is destroyed.
+// - SlabSourceDefault uses ::operator new. It over-allocates by alignment
+//   to align the slab, the pages which are not used are never touched.
+// - SlabSourceMmap maps the slab with mmap, optionally backed by huge pages,
+//   bound to a NUMA node, and pre-faulted so the first burst of events
+//   doesn't take page faults. On other platforms it falls back to
+//   SlabSourceDefault.
+// - A user-supplied arena is just another slab source type.
+
+#ifndef SLABSOURCE_I_H_EVENTPP
+#define SLABSOURCE_I_H_EVENTPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace eventpp {
+
+struct SlabSourceDefault
+{
+	static void * allocate(const std::size_t size, const std::size_t alignment) noexcept {
+		// The pointer returned by operator new is stored just before the slab.
+		void * raw = ::operator new(size + alignment + sizeof(void *), std::nothrow);
+		if(raw == nullptr) {
+			return nullptr;
+		}
+		const std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(raw) + sizeof(void *) + alignment - 1)
+			& ~static_cast<std::uintptr_t>(alignment - 1);
+		reinterpret_cast<void **>(aligned)[-1] = raw;
+		return reinterpret_cast<void *>(aligned);
+	}
+
+	static void deallocate(void * p, const std::size_t /*size*/) noexcept {
+		::operator delete(static_cast<void **>(p)[-1]);
+	}
+};
+
+// hugePage: try MAP_HUGETLB first, then fall back to normal pages with
+//   madvise(MADV_HUGEPAGE), so transparent huge pages can back the slab.
+//   The slab size is rounded up to 2MB, choose SlabCapacity accordingly.
+// numaNode: if >= 0, prefer allocating the slab on that NUMA node (mbind).
+// prefault: touch every page when the slab is allocated.
+template <bool hugePage = true, int numaNode = -1, bool prefault = true>
+struct SlabSourceMmap
+{
+#if defined(__linux__)
+	static void * allocate(const std::size_t size, const std::size_t alignment) noexcept {
+		const std::size_t mapSize = getMapSize(size);
+		void * p = nullptr;
+#if defined(MAP_HUGETLB)
+		if(hugePage) {
+			// Fails if no huge page is reserved (vm.nr_hugepages).
+			p = doMapAligned(mapSize, alignment, kHugePageSize, MAP_HUGETLB);
+		}
+#endif
+		if(p == nullptr) {
+			p = doMapAligned(mapSize, alignment, static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)), 0);
+			if(p == nullptr) {
+				return nullptr;
+			}
+#if defined(MADV_HUGEPAGE)
+			if(hugePage) {
+				::madvise(p, mapSize, MADV_HUGEPAGE);
+			}
+#endif
+		}
+		doPrepare(p, mapSize);
+		return p;
+	}
+
+	static void deallocate(void * p, const std::size_t size) noexcept {
+		::munmap(p, getMapSize(size));
+	}
+
+private:
+	static constexpr std::size_t kHugePageSize = 2 * 1024 * 1024;
+
+	// With hugePage the size is always rounded up to the huge page size, so
+	// a slab mapped with either kind of pages is unmapped with the same size.
+	static std::size_t getMapSize(const std::size_t size) noexcept {
+		const std::size_t pageSize = hugePage ? kHugePageSize : static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+		return (size + pageSize - 1) / pageSize * pageSize;
+	}
+
+	// Maps mapSize bytes aligned to alignment. The mapping is over-sized by
+	// alignment then the unaligned head and the tail are unmapped.
+	static void * doMapAligned(const std::size_t mapSize, const std::size_t alignment, const std::size_t pageSize, const int flags) noexcept {
+		const std::size_t extra = alignment > pageSize ? alignment : 0;
+		void * p = ::mmap(nullptr, mapSize + extra, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+		if(p == MAP_FAILED) {
+			return nullptr;
+		}
+		const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(p);
+		const std::uintptr_t aligned = (base + alignment - 1) & ~static_cast<std::uintptr_t>(alignment - 1);
+		const std::size_t head = static_cast<std::size_t>(aligned - base);
+		if(head > 0) {
+			::munmap(p, head);
+		}
+		if(extra > head) {
+			::munmap(reinterpret_cast<void *>(aligned + mapSize), extra - head);
+		}
+		return reinterpret_cast<void *>(aligned);
+	}
+
+	static void doPrepare(void * p, const std::size_t mapSize) noexcept {
+#if defined(SYS_mbind)
+		if(numaNode >= 0 && numaNode < static_cast<int>(sizeof(unsigned long) * 8)) {
+			// MPOL_PREFERRED, falls back to other nodes instead of failing.
+			const unsigned long nodeMask = 1UL << (numaNode >= 0 ? numaNode : 0);
+			::syscall(SYS_mbind, p, mapSize, 1, &nodeMask, sizeof(nodeMask) * 8 + 1, 0);
+		}
+#endif
+		if(prefault) {
+			const std::size_t pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+			volatile unsigned char * bytes = static_cast<unsigned char *>(p);
+			for(std::size_t i = 0; i < mapSize; i += pageSize) {
+				bytes[i] = 0;
+			}
+		}
+	}
+#else
+	static void * allocate(const std::size_t size, const std::size_t alignment) noexcept {
+		void * p = SlabSourceDefault::allocate(size, alignment);
+		if(p != nullptr && prefault) {
+			std::memset(p, 0, size);
+		}
+		return p;
+	}
+
+	static void deallocate(void * p, const std::size_t size) noexcept {
+		SlabSourceDefault::deallocate(p, size);
+	}
+#endif
+};
+
+
+} //namespace eventpp
+
+#endif
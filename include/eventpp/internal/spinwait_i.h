@@ -0,0 +1,69 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SPINWAIT_I_H_EVENTPP
+#define SPINWAIT_I_H_EVENTPP
+
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86) || defined(_M_ARM64) || defined(_M_ARM))
+#include <intrin.h>
+#endif
+
+namespace eventpp {
+
+namespace internal_ {
+
+// OPT-8: Tells the CPU that the thread is spinning, so the sibling hyper
+// thread gets the core and leaving the loop doesn't flush the pipeline.
+inline void cpuRelax() noexcept
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_pause();
+#elif defined(_MSC_VER) && (defined(_M_ARM64) || defined(_M_ARM))
+	__yield();
+#elif defined(__aarch64__) || defined(__arm__)
+	__asm__ __volatile__("yield");
+#elif defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+// OPT-8: The spin and yield phases of Spin -> Yield -> Sleep. Returns true
+// as soon as ready() returns true, false if it's still false after them,
+// then the caller sleeps.
+template <typename Ready>
+bool spinThenYield(Ready && ready)
+{
+	for(int i = 0; i < 128; ++i) {
+		if(ready()) {
+			return true;
+		}
+		cpuRelax();
+	}
+
+	for(int i = 0; i < 16; ++i) {
+		if(ready()) {
+			return true;
+		}
+		std::this_thread::yield();
+	}
+
+	return false;
+}
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
@@ -0,0 +1,251 @@
+// eventpp library - ARM-Linux / x86-Linux optimization extension
+// Hierarchical timing wheel used by the delayed events of EventQueue.
+//
+// Design (OPT-29):
+// - Time is counted in ticks. Level L has 2^slotBits slots, each slot of
+//   level L covers 2^(slotBits * L) ticks, so a slot of level 0 is one tick.
+// - An item is put in the lowest level whose block contains both its tick
+//   and the current tick. So all items of level 0 are before any item of
+//   level 1, and so on. The items beyond the top level are in an overflow
+//   list.
+// - When the current tick enters the block of a slot of a higher level,
+//   the slot is redistributed to the lower levels (cascading). advance jumps
+//   over the empty slots, so an idle wheel costs nothing however far the
+//   time moves.
+// - Items of the same tick are taken in the order they are inserted.
+// - The list nodes are recycled, insert doesn't allocate once the wheel is
+//   warmed up.
+// - TimingWheel is not thread safe, the caller locks it.
+
+#ifndef TIMINGWHEEL_I_H_EVENTPP
+#define TIMINGWHEEL_I_H_EVENTPP
+
+#include "eventqueue_i.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <utility>
+
+namespace eventpp {
+
+namespace internal_ {
+
+template <typename T, std::size_t slotBits = 6, std::size_t levelCount = 5>
+class TimingWheel
+{
+public:
+	using Tick = std::uint64_t;
+
+	static constexpr Tick noTick = (std::numeric_limits<Tick>::max)();
+
+private:
+	static_assert(slotBits > 0 && slotBits * levelCount < 64, "TimingWheel: too many slots");
+
+	static constexpr std::size_t slotCount = std::size_t(1) << slotBits;
+	static constexpr Tick slotMask = slotCount - 1;
+
+	struct Entry
+	{
+		Tick tick;
+		BufferedItem<T> item;
+	};
+
+	using EntryList = std::list<Entry>;
+	using Level = std::array<EntryList, slotCount>;
+
+public:
+	TimingWheel()
+		: levels(), overflowList(), freeList(), currentTick(0), itemCount(0)
+	{
+	}
+
+	bool empty() const {
+		return itemCount == 0;
+	}
+
+	std::size_t size() const {
+		return itemCount;
+	}
+
+	Tick getCurrentTick() const {
+		return currentTick;
+	}
+
+	// An item before the current tick is due at the current tick.
+	void insert(const Tick tick, T && value) {
+		if(freeList.empty()) {
+			freeList.emplace_back();
+		}
+		auto it = freeList.begin();
+		it->tick = tick;
+		it->item.set(std::move(value));
+		doPlace(freeList, it);
+		++itemCount;
+	}
+
+	// Returns the tick of the earliest item, or noTick if the wheel is empty.
+	// An item before the current tick is at the current tick.
+	Tick getNextTick() const {
+		if(itemCount == 0) {
+			return noTick;
+		}
+
+		const EntryList * slot = doFindNextSlot();
+		Tick tick = noTick;
+		for(const auto & entry : *slot) {
+			if(entry.tick < tick) {
+				tick = entry.tick;
+			}
+		}
+		return tick < currentTick ? currentTick : tick;
+	}
+
+	// Moves the current tick to tick, and calls func(value) for the items
+	// which are due, in the order of their ticks. func must not touch the wheel.
+	template <typename F>
+	void advance(const Tick tick, F && func) {
+		if(tick < currentTick) {
+			return;
+		}
+
+		for(;;) {
+			doExpire(levels[0][currentTick & slotMask], func);
+
+			if(currentTick == tick) {
+				break;
+			}
+
+			const Tick nextTick = doGetNextStop();
+			if(nextTick > tick) {
+				// All the blocks passed over are empty, nothing to cascade.
+				currentTick = tick;
+				break;
+			}
+
+			currentTick = nextTick;
+			doCascade();
+		}
+	}
+
+	// Calls func(value) for all items and removes them, in no specific order.
+	template <typename F>
+	void clear(F && func) {
+		for(auto & level : levels) {
+			for(auto & slot : level) {
+				doExpire(slot, func);
+			}
+		}
+		doExpire(overflowList, func);
+	}
+
+private:
+	// The first non empty slot, all items in it are before the items in
+	// the other slots. The wheel must not be empty.
+	const EntryList * doFindNextSlot() const {
+		for(std::size_t level = 0; level < levelCount; ++level) {
+			const Tick index = (currentTick >> (slotBits * level)) & slotMask;
+			// The current slot of a higher level was either cascaded, or the
+			// current tick is not in its block yet.
+			for(Tick slot = (level == 0 ? index : index + 1); slot < slotCount; ++slot) {
+				if(! levels[level][slot].empty()) {
+					return &levels[level][slot];
+				}
+			}
+		}
+		return &overflowList;
+	}
+
+	// The tick advance must stop at, where an item is due, or a slot is
+	// cascaded. Returns noTick if the wheel is empty.
+	Tick doGetNextStop() const {
+		if(itemCount == 0) {
+			return noTick;
+		}
+
+		for(std::size_t level = 0; level < levelCount; ++level) {
+			const std::size_t shift = slotBits * level;
+			const Tick index = (currentTick >> shift) & slotMask;
+			for(Tick slot = (level == 0 ? index : index + 1); slot < slotCount; ++slot) {
+				if(! levels[level][slot].empty()) {
+					const Tick blockStart = (currentTick >> (shift + slotBits)) << (shift + slotBits);
+					return blockStart | (slot << shift);
+				}
+			}
+		}
+
+		const std::size_t topShift = slotBits * levelCount;
+		return ((currentTick >> topShift) + 1) << topShift;
+	}
+
+	void doPlace(EntryList & from, const typename EntryList::iterator & it) {
+		const Tick tick = (it->tick < currentTick ? currentTick : it->tick);
+		for(std::size_t level = 0; level < levelCount; ++level) {
+			const std::size_t shift = slotBits * level;
+			if((tick >> (shift + slotBits)) == (currentTick >> (shift + slotBits))) {
+				auto & slot = levels[level][(tick >> shift) & slotMask];
+				slot.splice(slot.end(), from, it);
+				return;
+			}
+		}
+		overflowList.splice(overflowList.end(), from, it);
+	}
+
+	// The current tick just entered the block of a higher level slot, or of
+	// the overflow list. Put their items in the lower levels, from the top.
+	void doCascade() {
+		const std::size_t topShift = slotBits * levelCount;
+		if((currentTick & ((Tick(1) << topShift) - 1)) == 0) {
+			doRedistribute(overflowList);
+		}
+		for(std::size_t level = levelCount - 1; level > 0; --level) {
+			const std::size_t shift = slotBits * level;
+			if((currentTick & ((Tick(1) << shift) - 1)) == 0) {
+				doRedistribute(levels[level][(currentTick >> shift) & slotMask]);
+			}
+		}
+	}
+
+	void doRedistribute(EntryList & slot) {
+		// The items which are still beyond the top level go back to the
+		// overflow list, so take them out first.
+		EntryList tempList;
+		tempList.swap(slot);
+		while(! tempList.empty()) {
+			doPlace(tempList, tempList.begin());
+		}
+	}
+
+	template <typename F>
+	void doExpire(EntryList & slot, F & func) {
+		if(slot.empty()) {
+			return;
+		}
+		for(auto & entry : slot) {
+			func(std::move(entry.item.get()));
+			entry.item.clear();
+			--itemCount;
+		}
+		freeList.splice(freeList.end(), slot);
+	}
+
+private:
+	std::array<Level, levelCount> levels;
+	EntryList overflowList;
+	EntryList freeList;
+	Tick currentTick;
+	std::size_t itemCount;
+};
+
+template <typename T, std::size_t slotBits, std::size_t levelCount>
+constexpr typename TimingWheel<T, slotBits, levelCount>::Tick TimingWheel<T, slotBits, levelCount>::noTick;
+
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
+
@@ -0,0 +1,200 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRACING_I_H_EVENTPP
+#define TRACING_I_H_EVENTPP
+
+#include "../eventpolicies.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+namespace eventpp {
+
+// OPT-34: What a Tracer receives. For onEnqueue, beginTime and endTime are
+// the enqueue time. eventId is the event if it's an integer or an enum, else
+// its std::hash, else 0. queue is the address of the queue.
+struct TraceRecord
+{
+	std::uint64_t traceId;
+	std::uint64_t eventId;
+	const void * queue;
+	std::chrono::steady_clock::time_point enqueueTime;
+	std::chrono::steady_clock::time_point beginTime;
+	std::chrono::steady_clock::time_point endTime;
+};
+
+namespace internal_ {
+
+// The trace of the event which is being dispatched in this thread. An event
+// enqueued by its listeners gets the same trace ID, so the ID follows the
+// event from queue to queue. 0 is no trace.
+class TraceContext
+{
+public:
+	static std::uint64_t getCurrentTraceId()
+	{
+		return doGetCurrent();
+	}
+
+	static std::uint64_t setCurrentTraceId(const std::uint64_t traceId)
+	{
+		const std::uint64_t previous = doGetCurrent();
+		doGetCurrent() = traceId;
+		return previous;
+	}
+
+	// The trace ID for an event enqueued now.
+	static std::uint64_t getEnqueueTraceId()
+	{
+		const std::uint64_t current = doGetCurrent();
+		return current != 0 ? current : newTraceId();
+	}
+
+	// The IDs are taken from a shared counter in blocks, so the threads
+	// rarely touch the same cache line.
+	static std::uint64_t newTraceId()
+	{
+		static std::atomic<std::uint64_t> nextBlock(1);
+		static thread_local std::uint64_t next = 0;
+		static thread_local std::uint64_t limit = 0;
+
+		if(next == limit) {
+			next = nextBlock.fetch_add(blockSize, std::memory_order_relaxed);
+			limit = next + blockSize;
+		}
+		return next++;
+	}
+
+private:
+	enum { blockSize = 4096 };
+
+	static std::uint64_t & doGetCurrent()
+	{
+		static thread_local std::uint64_t current = 0;
+		return current;
+	}
+};
+
+template <typename E, typename Enabled = void>
+struct TraceEventId
+{
+	static std::uint64_t get(const E & /*e*/) {
+		return 0;
+	}
+};
+
+template <typename E>
+struct TraceEventId <E, typename std::enable_if<std::is_integral<E>::value || std::is_enum<E>::value>::type>
+{
+	static std::uint64_t get(const E & e) {
+		return static_cast<std::uint64_t>(e);
+	}
+};
+
+template <typename E>
+struct TraceEventId <E, typename std::enable_if<! std::is_integral<E>::value && ! std::is_enum<E>::value && HasHash<E>::value>::type>
+{
+	static std::uint64_t get(const E & e) {
+		return static_cast<std::uint64_t>(std::hash<E>()(e));
+	}
+};
+
+// The stamps of a queued event, the default member initializers are run
+// when the event is made by enqueue.
+struct QueueTimeStamp
+{
+	std::chrono::steady_clock::time_point enqueueTime = std::chrono::steady_clock::now();
+};
+
+struct QueueTraceStamp
+{
+	std::chrono::steady_clock::time_point enqueueTime = std::chrono::steady_clock::now();
+	std::uint64_t traceId = TraceContext::getEnqueueTraceId();
+};
+
+// The deadline is set when the event is enqueued, the maximum time point is
+// no deadline.
+template <typename Base, typename TimePoint = std::chrono::steady_clock::time_point>
+struct QueueDeadlineStamp : public Base
+{
+	TimePoint deadline = (TimePoint::max)();
+};
+
+template <typename Tracer, typename QueuedEvent>
+void traceEnqueue(const void * queue, const QueuedEvent & item)
+{
+	Tracer::onEnqueue(TraceRecord {
+		item.getTraceId(),
+		TraceEventId<typename std::decay<decltype(item.getEvent())>::type>::get(item.getEvent()),
+		queue,
+		item.getEnqueueTime(),
+		item.getEnqueueTime(),
+		item.getEnqueueTime()
+	});
+}
+
+// Makes the event the current trace while it's dispatched, and reports the
+// dispatch to the tracer when the scope ends.
+template <typename Tracer, typename QueuedEvent>
+class TraceDispatchScope
+{
+public:
+	TraceDispatchScope(const void * queue, const QueuedEvent & item)
+		:
+			record {
+				item.getTraceId(),
+				TraceEventId<typename std::decay<decltype(item.getEvent())>::type>::get(item.getEvent()),
+				queue,
+				item.getEnqueueTime(),
+				std::chrono::steady_clock::now(),
+				std::chrono::steady_clock::time_point()
+			},
+			previousTraceId(TraceContext::setCurrentTraceId(item.getTraceId()))
+	{
+	}
+
+	~TraceDispatchScope()
+	{
+		TraceContext::setCurrentTraceId(previousTraceId);
+		record.endTime = std::chrono::steady_clock::now();
+		Tracer::onDispatch(record);
+	}
+
+	TraceDispatchScope(const TraceDispatchScope &) = delete;
+	TraceDispatchScope & operator = (const TraceDispatchScope &) = delete;
+
+private:
+	TraceRecord record;
+	std::uint64_t previousTraceId;
+};
+
+template <typename QueuedEvent>
+class NoTraceDispatchScope
+{
+public:
+	NoTraceDispatchScope(const void * /*queue*/, const QueuedEvent & /*item*/)
+	{
+	}
+};
+
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
+
@@ -16,6 +16,7 @@
 
 #include <utility>
 #include <tuple>
+#include <type_traits>
 
 namespace eventpp {
 
@@ -87,6 +88,20 @@ struct CanInvoke
 	};
 };
 
+template <typename T>
+struct HasOperatorEqual
+{
+	template <typename U>
+	static auto test(int) -> decltype(static_cast<bool>(std::declval<const U &>() == std::declval<const U &>()), std::true_type());
+
+	template <typename U>
+	static auto test(...) -> std::false_type;
+
+	enum {
+		value = !! decltype(test<T>(0))()
+	};
+};
+
 template <typename T>
 struct ShiftTuple;
 
@@ -102,6 +117,55 @@ struct ShiftTuple <std::tuple<> >
 	using Type = std::tuple<>;
 };
 
+// Used by the queues which copy the events as bytes.
+template <typename ...Ts>
+struct AllTriviallyCopyable : std::true_type
+{
+};
+
+template <typename T, typename ...Ts>
+struct AllTriviallyCopyable <T, Ts...> : std::integral_constant<bool,
+		std::is_trivially_copyable<T>::value && AllTriviallyCopyable<Ts...>::value
+	>
+{
+};
+
+// OPT-87: An output iterator which drops the values, for the bulk functions
+// when the caller doesn't want the handles.
+struct DiscardIterator
+{
+	DiscardIterator & operator * () {
+		return *this;
+	}
+
+	DiscardIterator & operator ++ () {
+		return *this;
+	}
+
+	template <typename T>
+	DiscardIterator & operator = (T && /*value*/) {
+		return *this;
+	}
+};
+
+// The callback of a bulk item, the item itself for a CallbackList.
+struct BulkItemSelf
+{
+	template <typename T>
+	T & operator() (T & item) const {
+		return item;
+	}
+};
+
+// {event, callback} of EventDispatcher, a std::pair or a std::tuple.
+struct BulkItemSecond
+{
+	template <typename T>
+	auto operator() (T & item) const -> decltype(std::get<1>(item)) {
+		return std::get<1>(item);
+	}
+};
+
 // for compile time debug
 template<typename T>
 void printTypeInCompileTime(T * = 0)
@@ -0,0 +1,105 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef WAITMONITOR_I_H_EVENTPP
+#define WAITMONITOR_I_H_EVENTPP
+
+#include "spinwait_i.h"
+
+#include <atomic>
+#include <cstdint>
+
+// UMWAIT needs the WAITPKG intrinsics, compile with -mwaitpkg (or an -march
+// which has it) to use them. The CPU is checked at run time too.
+#if defined(__WAITPKG__) && (defined(__x86_64__) || defined(__i386__))
+	#include <cpuid.h>
+	#include <immintrin.h>
+	#include <x86intrin.h>
+	#define EVENTPP_HAS_UMWAIT 1
+#endif
+
+namespace eventpp {
+
+namespace internal_ {
+
+// OPT-60: Waits in a low power state until another thread writes the cache
+// line of a word. A waiting round returns when the word may have changed,
+// or after a short time, so the caller checks its own condition in a loop.
+// - AArch64: LDAXR arms the exclusive monitor, WFE sleeps until a write to
+//   the monitored line clears it, or the timer event stream (100 us on
+//   Linux) wakes the core.
+// - x86 with WAITPKG: UMONITOR and UMWAIT in C0.2, up to umwaitCycles.
+// - Others: spins pollCount rounds with a pause hint.
+struct WaitMonitor
+{
+	enum : std::uint64_t {
+		umwaitCycles = 100000
+	};
+
+	enum {
+		pollCount = 64
+	};
+
+	static void waitWhileEqual(const std::atomic<std::uint32_t> & word, const std::uint32_t value)
+	{
+#if defined(__aarch64__)
+		std::uint32_t current;
+		__asm__ __volatile__(
+			"ldaxr %w0, [%1]"
+			: "=&r" (current)
+			: "r" (&word)
+			: "memory"
+		);
+		if(current == value) {
+			__asm__ __volatile__("wfe" : : : "memory");
+		}
+#elif defined(EVENTPP_HAS_UMWAIT)
+		if(hasUmwait()) {
+			_umonitor(const_cast<std::atomic<std::uint32_t> *>(&word));
+			if(word.load(std::memory_order_acquire) == value) {
+				_umwait(0, __rdtsc() + umwaitCycles);
+			}
+			return;
+		}
+		doPoll(word, value);
+#else
+		doPoll(word, value);
+#endif
+	}
+
+#if defined(EVENTPP_HAS_UMWAIT)
+	// CPUID.(EAX=7, ECX=0):ECX bit 5.
+	static bool hasUmwait()
+	{
+		static const bool result = []() -> bool {
+			unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+			return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ecx & (1u << 5)) != 0;
+		}();
+		return result;
+	}
+#endif
+
+private:
+	static void doPoll(const std::atomic<std::uint32_t> & word, const std::uint32_t value)
+	{
+		for(int i = 0; i < pollCount && word.load(std::memory_order_relaxed) == value; ++i) {
+			internal_::cpuRelax();
+		}
+	}
+};
+
+} //namespace internal_
+
+} //namespace eventpp
+
+#endif
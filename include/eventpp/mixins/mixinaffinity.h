@@ -0,0 +1,406 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MIXINAFFINITY_H_EVENTPP
+#define MIXINAFFINITY_H_EVENTPP
+
+#include "../eventqueue.h"
+#include "../internal/epochreclaimer_i.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace eventpp {
+
+using AffinityTask = std::function<void ()>;
+
+// OPT-71: The queue of a home thread. The home thread calls process (or
+// runs the queue in an ActiveObject), then the affine listeners which were
+// appended with this queue are called on that thread.
+class AffinityQueue : public EventQueue<int, void (const AffinityTask &)>
+{
+private:
+	using super = EventQueue<int, void (const AffinityTask &)>;
+
+public:
+	AffinityQueue()
+		: super()
+	{
+		super::appendListener(0, [](const AffinityTask & task) {
+			task();
+		});
+	}
+
+	void post(AffinityTask task)
+	{
+		super::enqueue(0, std::move(task));
+	}
+};
+
+namespace internal_ {
+
+template <typename Prototype>
+struct AffinityArguments;
+
+template <typename R, typename ...Args>
+struct AffinityArguments <R (Args...)>
+{
+	using Tuple = std::tuple<typename std::decay<Args>::type...>;
+
+	template <typename Callback, std::size_t ...Indexes>
+	static void invoke(const Callback & callback, Tuple & arguments, IndexSequence<Indexes...>)
+	{
+		callback(std::get<Indexes>(arguments)...);
+	}
+
+	template <typename Callback>
+	static void invoke(const Callback & callback, Tuple & arguments)
+	{
+		invoke(callback, arguments, typename MakeIndexSequence<sizeof...(Args)>::Type());
+	}
+};
+
+} //namespace internal_
+
+// OPT-71: Thread affine listeners, as the queued connections in Qt.
+// appendListener(event, callback, targetQueue) adds a listener which is
+// called on the home thread of targetQueue. A dispatch copies the arguments
+// once for each target queue, not once for each listener, and posts one
+// task to each target queue, which calls all the listeners of the event
+// on that queue. The listeners without a target queue are called by the
+// dispatch as before.
+// The affine listeners are in a table which is rebuilt when a listener is
+// appended or removed, and published through an atomic pointer, as
+// MixinFilter (OPT-44), so a dispatch finds them with no lock.
+// A listener which is removed before its task runs is not called.
+template <typename Base>
+class MixinAffinity : public Base
+{
+private:
+	using super = Base;
+	using Event_ = typename super::Event;
+	using Callback_ = typename super::Callback;
+	using Mutex = typename super::Mutex;
+	using Arguments = internal_::AffinityArguments<typename super::Prototype>;
+
+	struct Entry
+	{
+		std::uint64_t id;
+		Callback_ callback;
+		std::atomic<bool> removed;
+	};
+	using EntryPtr = std::shared_ptr<Entry>;
+
+	// The listeners of one event on one target queue. Never changed after
+	// it's published, a task keeps it alive until the task runs.
+	struct Group
+	{
+		AffinityQueue * targetQueue;
+		std::vector<EntryPtr> entryList;
+	};
+	using GroupPtr = std::shared_ptr<const Group>;
+
+	using GroupMap = typename internal_::SelectMap<
+		Event_,
+		std::vector<GroupPtr>,
+		DefaultPolicies,
+		false
+	>::Type;
+
+	struct AffinityTable
+	{
+		GroupMap groupMap;
+	};
+	using AffinityTablePtr = std::shared_ptr<AffinityTable>;
+	using EpochReclaimer = internal_::EpochReclaimer;
+
+public:
+	class AffinityHandle
+	{
+	public:
+		AffinityHandle() : id(0)
+		{
+		}
+
+		explicit operator bool () const {
+			return id != 0;
+		}
+
+	private:
+		explicit AffinityHandle(const std::uint64_t id) : id(id)
+		{
+		}
+
+		std::uint64_t id;
+
+		friend class MixinAffinity;
+	};
+
+public:
+	using super::super;
+	using super::appendListener;
+	using super::removeListener;
+
+	MixinAffinity()
+		: super()
+	{
+	}
+
+	// The copy has the same affine listeners, the handles work on both.
+	MixinAffinity(const MixinAffinity & other)
+		: super(other)
+	{
+		doCopyFrom(other);
+	}
+
+	MixinAffinity(MixinAffinity && other) noexcept
+		: super(std::move(other))
+	{
+		doCopyFrom(other);
+	}
+
+	MixinAffinity & operator = (const MixinAffinity & other)
+	{
+		super::operator = (other);
+		if(this != &other) {
+			doCopyFrom(other);
+		}
+		return *this;
+	}
+
+	MixinAffinity & operator = (MixinAffinity && other) noexcept
+	{
+		super::operator = (std::move(other));
+		if(this != &other) {
+			doCopyFrom(other);
+		}
+		return *this;
+	}
+
+	// targetQueue must outlive the listener and the tasks posted to it.
+	AffinityHandle appendListener(const Event_ & event, const Callback_ & callback, AffinityQueue & targetQueue)
+	{
+		AffinityTablePtr oldTable;
+		std::uint64_t id;
+		{
+			std::lock_guard<Mutex> lockGuard(affinityMutex);
+			id = ++nextListenerId;
+			EntryPtr entry = std::make_shared<Entry>();
+			entry->id = id;
+			entry->callback = callback;
+			entry->removed.store(false, std::memory_order_relaxed);
+
+			AffinityTablePtr newTable = doCloneTable();
+			std::vector<GroupPtr> & groupList = newTable->groupMap[event];
+			auto it = groupList.begin();
+			while(it != groupList.end() && (*it)->targetQueue != &targetQueue) {
+				++it;
+			}
+			std::shared_ptr<Group> group = std::make_shared<Group>();
+			group->targetQueue = &targetQueue;
+			if(it != groupList.end()) {
+				group->entryList = (*it)->entryList;
+				group->entryList.push_back(std::move(entry));
+				*it = std::move(group);
+			}
+			else {
+				group->entryList.push_back(std::move(entry));
+				groupList.push_back(std::move(group));
+			}
+			oldTable = doPublish(std::move(newTable));
+		}
+		// A dispatch which started before may still read the old table.
+		if(oldTable) {
+			EpochReclaimer::retire(std::move(oldTable));
+		}
+		return AffinityHandle(id);
+	}
+
+	bool removeListener(const Event_ & event, const AffinityHandle & handle)
+	{
+		if(! handle) {
+			return false;
+		}
+
+		AffinityTablePtr oldTable;
+		{
+			std::lock_guard<Mutex> lockGuard(affinityMutex);
+			if(! table) {
+				return false;
+			}
+			auto mapIt = table->groupMap.find(event);
+			if(mapIt == table->groupMap.end()) {
+				return false;
+			}
+			std::vector<GroupPtr> groupList;
+			bool found = false;
+			for(const GroupPtr & group : mapIt->second) {
+				std::vector<EntryPtr> entryList;
+				for(const EntryPtr & entry : group->entryList) {
+					if(entry->id == handle.id) {
+						entry->removed.store(true, std::memory_order_relaxed);
+						found = true;
+					}
+					else {
+						entryList.push_back(entry);
+					}
+				}
+				if(entryList.size() == group->entryList.size()) {
+					groupList.push_back(group);
+				}
+				else if(! entryList.empty()) {
+					std::shared_ptr<Group> newGroup = std::make_shared<Group>();
+					newGroup->targetQueue = group->targetQueue;
+					newGroup->entryList = std::move(entryList);
+					groupList.push_back(std::move(newGroup));
+				}
+			}
+			if(! found) {
+				return false;
+			}
+			AffinityTablePtr newTable = doCloneTable();
+			if(groupList.empty()) {
+				newTable->groupMap.erase(event);
+			}
+			else {
+				newTable->groupMap[event] = std::move(groupList);
+			}
+			oldTable = doPublish(std::move(newTable));
+		}
+		EpochReclaimer::retire(std::move(oldTable));
+		return true;
+	}
+
+	template <typename ...Args>
+	bool mixinBeforeDispatchEvent(const Event_ & e, Args && ...args) const {
+		if(publishedTable.load(std::memory_order_relaxed) == nullptr) {
+			return true;
+		}
+
+		EpochReclaimer::ReadGuard readGuard;
+		const AffinityTable * const affinityTable = publishedTable.load(std::memory_order_acquire);
+		if(affinityTable == nullptr) {
+			return true;
+		}
+		auto it = affinityTable->groupMap.find(e);
+		if(it == affinityTable->groupMap.end()) {
+			return true;
+		}
+		for(const GroupPtr & group : it->second) {
+			// One copy of the arguments and one task for each target queue.
+			group->targetQueue->post(
+				[group, arguments = typename Arguments::Tuple(args...)]() mutable {
+					for(const EntryPtr & entry : group->entryList) {
+						if(! entry->removed.load(std::memory_order_relaxed)) {
+							Arguments::invoke(entry->callback, arguments);
+						}
+					}
+				}
+			);
+		}
+
+		return true;
+	}
+
+private:
+	// Must be called under the lock.
+	AffinityTablePtr doCloneTable() const
+	{
+		AffinityTablePtr newTable = std::make_shared<AffinityTable>();
+		if(table) {
+			newTable->groupMap = table->groupMap;
+		}
+		return newTable;
+	}
+
+	// Must be called under the lock. Returns the table which was replaced.
+	AffinityTablePtr doPublish(AffinityTablePtr newTable)
+	{
+		if(newTable->groupMap.empty()) {
+			newTable.reset();
+		}
+		publishedTable.store(newTable.get(), std::memory_order_release);
+		AffinityTablePtr oldTable = std::move(table);
+		table = std::move(newTable);
+		return oldTable;
+	}
+
+	// The entries are copied too, so removing a listener from one copy
+	// doesn't skip it in the other copy.
+	static AffinityTablePtr doCopyTable(const AffinityTablePtr & otherTable)
+	{
+		if(! otherTable) {
+			return AffinityTablePtr();
+		}
+		AffinityTablePtr newTable = std::make_shared<AffinityTable>();
+		for(const auto & item : otherTable->groupMap) {
+			std::vector<GroupPtr> & groupList = newTable->groupMap[item.first];
+			for(const GroupPtr & group : item.second) {
+				std::shared_ptr<Group> newGroup = std::make_shared<Group>();
+				newGroup->targetQueue = group->targetQueue;
+				for(const EntryPtr & entry : group->entryList) {
+					EntryPtr newEntry = std::make_shared<Entry>();
+					newEntry->id = entry->id;
+					newEntry->callback = entry->callback;
+					newEntry->removed.store(false, std::memory_order_relaxed);
+					newGroup->entryList.push_back(std::move(newEntry));
+				}
+				groupList.push_back(std::move(newGroup));
+			}
+		}
+		return newTable;
+	}
+
+	void doCopyFrom(const MixinAffinity & other)
+	{
+		AffinityTablePtr otherTable;
+		std::uint64_t otherNextListenerId;
+		{
+			std::lock_guard<Mutex> lockGuard(other.affinityMutex);
+			otherTable = doCopyTable(other.table);
+			otherNextListenerId = other.nextListenerId;
+		}
+		AffinityTablePtr oldTable;
+		{
+			std::lock_guard<Mutex> lockGuard(affinityMutex);
+			publishedTable.store(otherTable.get(), std::memory_order_release);
+			oldTable = std::move(table);
+			table = std::move(otherTable);
+			nextListenerId = otherNextListenerId;
+		}
+		if(oldTable) {
+			EpochReclaimer::retire(std::move(oldTable));
+		}
+	}
+
+private:
+	mutable Mutex affinityMutex {};
+	AffinityTablePtr table {};
+	std::atomic<const AffinityTable *> publishedTable { nullptr };
+	std::uint64_t nextListenerId = 0;
+};
+
+
+} //namespace eventpp
+
+
+#endif
+
@@ -15,14 +15,32 @@
 #define MIXINFILTER_H_713231680355
 
 #include "../callbacklist.h"
+#include "../internal/epochreclaimer_i.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace eventpp {
 
+// OPT-44: The filters are in an array, which is rebuilt when a filter is
+// appended or removed, and published through an atomic pointer. A filter
+// can be appended with the events it applies to. Each event which has such
+// a filter has a bitset of the filters to call, the other events use the
+// bitset of the filters for all events, so a dispatch calls the filters in
+// one bitset only, with no lock and no reference count.
 template <typename Base>
 class MixinFilter : public Base
 {
 private:
 	using super = Base;
+	using Event_ = typename super::Event;
+	using Mutex = typename super::Mutex;
 
 	using BoolReferencePrototype = typename internal_::ReplaceReturnType<
 		typename internal_::TransformArguments<
@@ -33,30 +51,173 @@ private:
 	>::Type;
 
 	using Filter = std::function<BoolReferencePrototype>;
-	using FilterList = CallbackList<BoolReferencePrototype>;
+	using MaskWord = std::uint64_t;
+
+	enum : std::size_t {
+		maskWordBits = 64
+	};
+
+	struct FilterItem
+	{
+		std::uint64_t id;
+		Filter filter;
+		// Empty for the filters for all events.
+		std::vector<Event_> eventList;
+	};
+
+	using RowMap = typename internal_::SelectMap<
+		Event_,
+		std::size_t,
+		DefaultPolicies,
+		false
+	>::Type;
+
+	// Never changed after it's published.
+	struct FilterChain
+	{
+		std::vector<FilterItem> filterList;
+		std::size_t wordCount;
+		// wordCount words for each row. Row 0 is for the events which are
+		// not in rowMap, it has the filters for all events.
+		std::vector<MaskWord> maskList;
+		RowMap rowMap;
+	};
+
+	using FilterChainPtr = std::shared_ptr<FilterChain>;
+	using EpochReclaimer = internal_::EpochReclaimer;
 
 public:
-	using FilterHandle = typename FilterList::Handle;
+	class FilterHandle
+	{
+	public:
+		FilterHandle() : id(0)
+		{
+		}
+
+		explicit operator bool () const {
+			return id != 0;
+		}
+
+	private:
+		explicit FilterHandle(const std::uint64_t id) : id(id)
+		{
+		}
+
+		std::uint64_t id;
+
+		friend class MixinFilter;
+	};
 
 public:
+	using super::super;
+
+	MixinFilter()
+		: super()
+	{
+	}
+
+	// The copy has the same filters, the handles work on both.
+	MixinFilter(const MixinFilter & other)
+		: super(other)
+	{
+		doCopyFrom(other);
+	}
+
+	MixinFilter(MixinFilter && other) noexcept
+		: super(std::move(other))
+	{
+		doCopyFrom(other);
+	}
+
+	MixinFilter & operator = (const MixinFilter & other)
+	{
+		super::operator = (other);
+		if(this != &other) {
+			doCopyFrom(other);
+		}
+		return *this;
+	}
+
+	MixinFilter & operator = (MixinFilter && other) noexcept
+	{
+		super::operator = (std::move(other));
+		if(this != &other) {
+			doCopyFrom(other);
+		}
+		return *this;
+	}
+
+	// The filter is called for all events.
 	FilterHandle appendFilter(const Filter & filter)
 	{
-		return filterList.append(filter);
+		return doAppendFilter(filter, std::vector<Event_>());
+	}
+
+	// The filter is only called for the events in eventList.
+	FilterHandle appendFilter(const std::vector<Event_> & eventList, const Filter & filter)
+	{
+		return doAppendFilter(filter, eventList);
+	}
+
+	FilterHandle appendFilter(const std::initializer_list<Event_> & eventList, const Filter & filter)
+	{
+		return doAppendFilter(filter, std::vector<Event_>(eventList));
 	}
 
 	bool removeFilter(const FilterHandle & filterHandle)
 	{
-		return filterList.remove(filterHandle);
+		if(! filterHandle) {
+			return false;
+		}
+
+		FilterChainPtr oldChain;
+		{
+			std::lock_guard<Mutex> lockGuard(filterMutex);
+			if(! chain) {
+				return false;
+			}
+			std::vector<FilterItem> filterList;
+			filterList.reserve(chain->filterList.size());
+			for(const FilterItem & item : chain->filterList) {
+				if(item.id != filterHandle.id) {
+					filterList.push_back(item);
+				}
+			}
+			if(filterList.size() == chain->filterList.size()) {
+				return false;
+			}
+			oldChain = doPublish(std::move(filterList));
+		}
+		EpochReclaimer::retire(std::move(oldChain));
+		return true;
 	}
 
 	template <typename ...Args>
-	bool mixinBeforeDispatch(Args && ...args) const {
-		if(! filterList.empty()) {
-			if(! filterList.forEachIf([&args...](typename FilterList::Callback & callback) {
-					return callback(args...);
-				})
-			) {
-				return false;
+	bool mixinBeforeDispatchEvent(const Event_ & e, Args && ...args) const {
+		if(publishedChain.load(std::memory_order_relaxed) == nullptr) {
+			return true;
+		}
+
+		EpochReclaimer::ReadGuard readGuard;
+		const FilterChain * const filterChain = publishedChain.load(std::memory_order_acquire);
+		if(filterChain == nullptr) {
+			return true;
+		}
+		const MaskWord * mask = filterChain->maskList.data();
+		if(! filterChain->rowMap.empty()) {
+			auto it = filterChain->rowMap.find(e);
+			if(it != filterChain->rowMap.end()) {
+				mask += it->second * filterChain->wordCount;
+			}
+		}
+		for(std::size_t i = 0; i < filterChain->wordCount; ++i) {
+			MaskWord word = mask[i];
+			while(word != 0) {
+				const std::size_t index = i * maskWordBits + doGetLowestBit(word);
+				word &= word - 1;
+				if(! filterChain->filterList[index].filter(args...)) {
+					return false;
+				}
 			}
 		}
 
@@ -64,7 +225,106 @@ public:
 	}
 
 private:
-	FilterList filterList;
+	FilterHandle doAppendFilter(const Filter & filter, std::vector<Event_> eventList)
+	{
+		FilterChainPtr oldChain;
+		std::uint64_t id;
+		{
+			std::lock_guard<Mutex> lockGuard(filterMutex);
+			std::vector<FilterItem> filterList;
+			if(chain) {
+				filterList = chain->filterList;
+			}
+			id = ++nextFilterId;
+			filterList.push_back(FilterItem { id, filter, std::move(eventList) });
+			oldChain = doPublish(std::move(filterList));
+		}
+		// A dispatch which started before may still read the old chain.
+		if(oldChain) {
+			EpochReclaimer::retire(std::move(oldChain));
+		}
+		return FilterHandle(id);
+	}
+
+	// Must be called under the lock. Returns the chain which was replaced.
+	FilterChainPtr doPublish(std::vector<FilterItem> filterList)
+	{
+		FilterChainPtr newChain;
+		if(! filterList.empty()) {
+			newChain = std::make_shared<FilterChain>();
+			newChain->wordCount = (filterList.size() + maskWordBits - 1) / maskWordBits;
+			for(const FilterItem & item : filterList) {
+				for(const Event_ & e : item.eventList) {
+					if(newChain->rowMap.find(e) == newChain->rowMap.end()) {
+						const std::size_t row = newChain->rowMap.size() + 1;
+						newChain->rowMap[e] = row;
+					}
+				}
+			}
+			newChain->maskList.resize(newChain->wordCount * (newChain->rowMap.size() + 1));
+			for(std::size_t i = 0; i < filterList.size(); ++i) {
+				const MaskWord bit = static_cast<MaskWord>(1) << (i % maskWordBits);
+				const std::size_t word = i / maskWordBits;
+				if(filterList[i].eventList.empty()) {
+					// A filter for all events is in every row.
+					for(std::size_t row = 0; row <= newChain->rowMap.size(); ++row) {
+						newChain->maskList[row * newChain->wordCount + word] |= bit;
+					}
+				}
+				else {
+					for(const Event_ & e : filterList[i].eventList) {
+						newChain->maskList[newChain->rowMap[e] * newChain->wordCount + word] |= bit;
+					}
+				}
+			}
+			newChain->filterList = std::move(filterList);
+		}
+		publishedChain.store(newChain.get(), std::memory_order_release);
+		FilterChainPtr oldChain = std::move(chain);
+		chain = std::move(newChain);
+		return oldChain;
+	}
+
+	void doCopyFrom(const MixinFilter & other)
+	{
+		FilterChainPtr otherChain;
+		std::uint64_t otherNextFilterId;
+		{
+			std::lock_guard<Mutex> lockGuard(other.filterMutex);
+			otherChain = other.chain;
+			otherNextFilterId = other.nextFilterId;
+		}
+		FilterChainPtr oldChain;
+		{
+			std::lock_guard<Mutex> lockGuard(filterMutex);
+			publishedChain.store(otherChain.get(), std::memory_order_release);
+			oldChain = std::move(chain);
+			chain = std::move(otherChain);
+			nextFilterId = otherNextFilterId;
+		}
+		if(oldChain) {
+			EpochReclaimer::retire(std::move(oldChain));
+		}
+	}
+
+	static std::size_t doGetLowestBit(const MaskWord word)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return static_cast<std::size_t>(__builtin_ctzll(word));
+#else
+		std::size_t bit = 0;
+		while((word & (static_cast<MaskWord>(1) << bit)) == 0) {
+			++bit;
+		}
+		return bit;
+#endif
+	}
+
+private:
+	mutable Mutex filterMutex {};
+	FilterChainPtr chain {};
+	std::atomic<const FilterChain *> publishedChain { nullptr };
+	std::uint64_t nextFilterId = 0;
 };
 
 
@@ -72,4 +332,3 @@ private:
 
 
 #endif
-
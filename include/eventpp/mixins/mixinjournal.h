@@ -0,0 +1,272 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MIXINJOURNAL_H_EVENTPP
+#define MIXINJOURNAL_H_EVENTPP
+
+#include "../utilities/eventjournal.h"
+#include "../utilities/anydataregistry.h"
+#include "../internal/eventqueue_i.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace eventpp {
+
+// OPT-43: Writes each event enqueued to an EventQueue to an EventJournal,
+// so the events can be replayed after a restart. The event and the
+// arguments are serialized by AnyDataSerializer, so they must be trivially
+// copyable, std::string, or have a specialization of AnyDataSerializer.
+// A record is the 32 bit size and the bytes of the event, then the same for
+// each argument.
+// The record is copied to the mapped journal in mixinAfterEnqueue, there is
+// no system call per event. The records are durable after commitJournal,
+// or after the syncInterval of the options.
+// A delayed event is journaled when it's due, as mixinAfterEnqueue is
+// called then. With several producers, the order in the
+// journal is the order of each producer, not always the order in the queue.
+template <typename Base>
+class MixinJournal : public Base
+{
+private:
+	using super = Base;
+	using Event_ = typename std::decay<typename super::Event>::type;
+	using ArgumentTuple = decltype(std::declval<typename super::QueuedEvent>().arguments);
+
+	enum : std::size_t {
+		argumentCount = std::tuple_size<ArgumentTuple>::value,
+		sizeFieldSize = sizeof(std::uint32_t)
+	};
+
+	template <std::size_t N>
+	using ArgumentType = typename std::tuple_element<N, ArgumentTuple>::type;
+
+	// The event and the arguments read from a record, they are constructed
+	// in place by AnyDataSerializer::read, and destroyed in reverse order.
+	template <typename T>
+	struct ReadValue
+	{
+		ReadValue() : constructed(false)
+		{
+		}
+
+		~ReadValue() {
+			if(constructed) {
+				get().~T();
+			}
+		}
+
+		ReadValue(const ReadValue &) = delete;
+		ReadValue & operator = (const ReadValue &) = delete;
+
+		bool read(const unsigned char *& p, const unsigned char * end) {
+			if(static_cast<std::size_t>(end - p) < sizeFieldSize) {
+				return false;
+			}
+			std::uint32_t size;
+			std::memcpy(&size, p, sizeFieldSize);
+			p += sizeFieldSize;
+			if(size > static_cast<std::size_t>(end - p)
+				|| ! AnyDataSerializer<T>::read(p, size, &storage)) {
+				return false;
+			}
+			p += size;
+			constructed = true;
+			return true;
+		}
+
+		T & get() {
+			return *reinterpret_cast<T *>(&storage);
+		}
+
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+		bool constructed;
+	};
+
+public:
+	using super::super;
+
+	MixinJournal()
+		: super()
+	{
+	}
+
+	// The journal is not copied, the copy has no journal open.
+	MixinJournal(const MixinJournal & other)
+		: super(other)
+	{
+	}
+
+	MixinJournal(MixinJournal && other) noexcept
+		: super(std::move(other))
+	{
+	}
+
+	MixinJournal & operator = (const MixinJournal & other)
+	{
+		super::operator = (other);
+		return *this;
+	}
+
+	MixinJournal & operator = (MixinJournal && other) noexcept
+	{
+		super::operator = (std::move(other));
+		return *this;
+	}
+
+	// Opens the journal in directory, the events enqueued from now on are
+	// appended to it. Call it before the producers start.
+	bool openJournal(const std::string & directory, const EventJournalOptions & options = EventJournalOptions())
+	{
+		return journal.open(directory, options);
+	}
+
+	void closeJournal()
+	{
+		journal.close();
+	}
+
+	// Makes the events enqueued so far durable, with one msync.
+	bool commitJournal()
+	{
+		return journal.commit();
+	}
+
+	EventJournal & getJournal()
+	{
+		return journal;
+	}
+
+	const EventJournal & getJournal() const
+	{
+		return journal;
+	}
+
+	// Dispatches the events in the journal from fromOffset, in the order they
+	// were journaled, without putting them in the queue. Returns the offset
+	// to replay from next time. It stops at a record which can't be read.
+	std::uint64_t replayJournal(const std::uint64_t fromOffset = 0)
+	{
+		return doReplay(fromOffset, [this](const Event_ & e, ArgumentTuple & arguments) {
+			doDispatchArguments(e, arguments, typename internal_::MakeIndexSequence<argumentCount>::Type());
+		});
+	}
+
+	// Same as replayJournal, but calls visitor(event, args...) as
+	// processQueueWith does, instead of dispatching.
+	template <typename Visitor>
+	std::uint64_t replayJournalWith(const std::uint64_t fromOffset, Visitor && visitor)
+	{
+		return doReplay(fromOffset, [&visitor](const Event_ & e, ArgumentTuple & arguments) {
+			doVisitArguments(visitor, e, arguments, typename internal_::MakeIndexSequence<argumentCount>::Type());
+		});
+	}
+
+	template <typename QueuedEvent>
+	void mixinAfterEnqueue(const QueuedEvent & item) const
+	{
+		// append does nothing if the journal is not open.
+		doAppend(item.event, item.arguments, typename internal_::MakeIndexSequence<argumentCount>::Type());
+	}
+
+private:
+	template <size_t ...Indexes>
+	void doAppend(const Event_ & e, const ArgumentTuple & arguments, internal_::IndexSequence<Indexes...>) const
+	{
+		const std::size_t eventSize = AnyDataSerializer<Event_>::getSize(e);
+		const std::size_t sizeList[] = { eventSize, AnyDataSerializer<ArgumentType<Indexes> >::getSize(std::get<Indexes>(arguments))... };
+		std::size_t recordSize = 0;
+		for(const std::size_t size : sizeList) {
+			recordSize += sizeFieldSize + size;
+		}
+		journal.append(recordSize, [&e, &arguments, &sizeList](void * buffer) {
+			unsigned char * p = static_cast<unsigned char *>(buffer);
+			doWriteValue(p, sizeList[0], e);
+			const int dummy[] = { 0, (doWriteValue(p, sizeList[Indexes + 1], std::get<Indexes>(arguments)), 0)... };
+			(void)dummy;
+		});
+	}
+
+	template <typename T>
+	static void doWriteValue(unsigned char *& p, const std::size_t size, const T & value)
+	{
+		const std::uint32_t size32 = static_cast<std::uint32_t>(size);
+		std::memcpy(p, &size32, sizeFieldSize);
+		AnyDataSerializer<T>::write(value, p + sizeFieldSize);
+		p += sizeFieldSize + size;
+	}
+
+	template <typename F>
+	std::uint64_t doReplay(const std::uint64_t fromOffset, F && func)
+	{
+		bool failed = false;
+		std::uint64_t failedOffset = 0;
+		const std::uint64_t offset = journal.replay(fromOffset,
+			[&failed, &failedOffset, &func](const void * data, const std::size_t size, const std::uint64_t recordOffset) {
+				if(failed) {
+					return;
+				}
+				if(! doReadRecord(static_cast<const unsigned char *>(data), size, func, typename internal_::MakeIndexSequence<argumentCount>::Type())) {
+					failed = true;
+					failedOffset = recordOffset;
+				}
+			}
+		);
+		return failed ? failedOffset : offset;
+	}
+
+	// The arguments are read into ReadValue, then moved to an ArgumentTuple,
+	// as QueuedEvent::arguments is passed by the queue.
+	template <typename F, size_t ...Indexes>
+	static bool doReadRecord(const unsigned char * p, const std::size_t size, F & func, internal_::IndexSequence<Indexes...>)
+	{
+		const unsigned char * const end = p + size;
+		ReadValue<Event_> e;
+		std::tuple<ReadValue<ArgumentType<Indexes> >...> values;
+		bool ok = e.read(p, end);
+		const bool okList[] = { ok, (ok = ok && std::get<Indexes>(values).read(p, end))... };
+		(void)okList;
+		if(! ok || p != end) {
+			return false;
+		}
+		ArgumentTuple arguments(std::move(std::get<Indexes>(values).get())...);
+		func(e.get(), arguments);
+		return true;
+	}
+
+	template <size_t ...Indexes>
+	void doDispatchArguments(const Event_ & e, ArgumentTuple & arguments, internal_::IndexSequence<Indexes...>)
+	{
+		this->directDispatch(e, std::get<Indexes>(arguments)...);
+	}
+
+	template <typename Visitor, size_t ...Indexes>
+	static void doVisitArguments(Visitor & visitor, const Event_ & e, ArgumentTuple & arguments, internal_::IndexSequence<Indexes...>)
+	{
+		visitor(e, std::get<Indexes>(arguments)...);
+	}
+
+private:
+	mutable EventJournal journal;
+};
+
+
+} //namespace eventpp
+
+#endif
+
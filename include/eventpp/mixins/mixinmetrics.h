@@ -0,0 +1,412 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MIXINMETRICS_H_EVENTPP
+#define MIXINMETRICS_H_EVENTPP
+
+#include "../eventpolicies.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+namespace eventpp {
+
+namespace internal_ {
+
+template <typename T>
+struct HasFunctionGetEnqueueTime
+{
+	template <typename C> static std::true_type test(decltype(std::declval<C>().getEnqueueTime()) *) ;
+	template <typename C> static std::false_type test(...);
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+
+} //namespace internal_
+
+// OPT-33: Counters and latency histograms per event, for the dispatchers
+// and the queues. The listener time is measured between mixinBeforeDispatch
+// and mixinAfterDispatch. The queue residency requires the QueueTimestamp
+// policy to be QueueTimestampSteady.
+// Each event has shardCount shards, a thread always updates the same shard
+// with relaxed atomic operations, the snapshot adds up the shards.
+template <typename Base>
+class MixinMetrics : public Base
+{
+private:
+	using super = Base;
+	using Event_ = typename super::Event;
+	using SharedMutex = typename super::SharedMutex;
+	using Clock = std::chrono::steady_clock;
+
+	// The queues don't expose the Threading policy to the mixins.
+	template <typename T>
+	using Atomic = std::atomic<T>;
+
+	enum {
+		shardCount = 4,
+		// Log-linear buckets as in HdrHistogram, 8 buckets for each power of
+		// two, so the error of a value is at most 12.5%.
+		subBucketBits = 3,
+		subBucketCount = 1 << subBucketBits,
+		// Values from 2^40 nanoseconds (about 18 minutes) go to the last bucket.
+		maxExponent = 40,
+		bucketCount = (maxExponent - subBucketBits + 2) * subBucketCount,
+		maxNestedDispatch = 32
+	};
+
+	struct HistogramShard
+	{
+		HistogramShard() : count(0), sum(0), max(0)
+		{
+			for(auto & bucket : buckets) {
+				bucket.store(0, std::memory_order_relaxed);
+			}
+		}
+
+		Atomic<std::uint64_t> count;
+		Atomic<std::uint64_t> sum;
+		Atomic<std::uint64_t> max;
+		Atomic<std::uint64_t> buckets[bucketCount];
+	};
+
+	struct EventShard
+	{
+		EventShard() : enqueueCount(0), dequeueCount(0), residency(), execution()
+		{
+		}
+
+		EVENTPP_ALIGN_CACHELINE Atomic<std::uint64_t> enqueueCount;
+		Atomic<std::uint64_t> dequeueCount;
+		HistogramShard residency;
+		HistogramShard execution;
+	};
+
+	struct EventMetrics
+	{
+		EventShard shards[shardCount];
+	};
+
+	using MetricsMap = typename internal_::SelectMap<
+		Event_,
+		std::unique_ptr<EventMetrics>,
+		DefaultPolicies,
+		false
+	>::Type;
+
+	// The start times of the dispatches which are running in this thread.
+	// A listener may dispatch again, so it's a stack.
+	struct DispatchStack
+	{
+		Clock::time_point startList[maxNestedDispatch];
+		int depth;
+	};
+
+public:
+	struct MetricsHistogram
+	{
+		struct Bucket
+		{
+			// The largest value in the bucket, in nanoseconds.
+			std::uint64_t upperBound;
+			std::uint64_t count;
+		};
+
+		std::uint64_t count;
+		// In nanoseconds.
+		std::uint64_t sum;
+		std::uint64_t max;
+		// The non-empty buckets in ascending order, the counts are not cumulative.
+		std::vector<Bucket> bucketList;
+
+		// Returns the upper bound of the bucket which contains the value at
+		// percentile, which is between 0 and 100.
+		std::uint64_t getValueAtPercentile(const double percentile) const
+		{
+			const double target = static_cast<double>(count) * percentile / 100.0;
+			std::uint64_t seen = 0;
+			for(const Bucket & bucket : bucketList) {
+				seen += bucket.count;
+				if(static_cast<double>(seen) >= target) {
+					return bucket.upperBound;
+				}
+			}
+			return max;
+		}
+	};
+
+	struct EventMetricsSnapshot
+	{
+		Event_ event;
+		std::uint64_t enqueueCount;
+		std::uint64_t dequeueCount;
+		// Time from enqueue to dequeue, empty without QueueTimestampSteady.
+		MetricsHistogram residency;
+		// Time of the listeners and the mixins after MixinMetrics.
+		MetricsHistogram execution;
+	};
+
+	struct MetricsSnapshot
+	{
+		std::vector<EventMetricsSnapshot> eventList;
+		// The events in the queue now, and the most ever.
+		std::int64_t queueDepth;
+		std::int64_t queueHighWatermark;
+	};
+
+public:
+	using super::super;
+
+	MixinMetrics()
+		: super()
+	{
+	}
+
+	// The metrics are not copied, the copy starts from zero.
+	MixinMetrics(const MixinMetrics & other)
+		: super(other)
+	{
+	}
+
+	MixinMetrics(MixinMetrics && other) noexcept
+		: super(std::move(other))
+	{
+	}
+
+	MixinMetrics & operator = (const MixinMetrics & other)
+	{
+		super::operator = (other);
+		return *this;
+	}
+
+	MixinMetrics & operator = (MixinMetrics && other) noexcept
+	{
+		super::operator = (std::move(other));
+		return *this;
+	}
+
+	MetricsSnapshot getMetricsSnapshot() const
+	{
+		MetricsSnapshot snapshot {
+			{},
+			queueDepth.load(std::memory_order_relaxed),
+			queueHighWatermark.load(std::memory_order_relaxed)
+		};
+
+		std::shared_lock<SharedMutex> lockGuard(metricsMutex);
+		snapshot.eventList.reserve(metricsMap.size());
+		for(const auto & item : metricsMap) {
+			EventMetricsSnapshot eventSnapshot {
+				item.first,
+				0,
+				0,
+				MetricsHistogram(),
+				MetricsHistogram()
+			};
+			for(const EventShard & shard : item.second->shards) {
+				eventSnapshot.enqueueCount += shard.enqueueCount.load(std::memory_order_relaxed);
+				eventSnapshot.dequeueCount += shard.dequeueCount.load(std::memory_order_relaxed);
+			}
+			doSnapshotHistogram(eventSnapshot.residency, *item.second, &EventShard::residency);
+			doSnapshotHistogram(eventSnapshot.execution, *item.second, &EventShard::execution);
+			snapshot.eventList.push_back(std::move(eventSnapshot));
+		}
+
+		return snapshot;
+	}
+
+	template <typename ...A>
+	bool mixinBeforeDispatch(A && .../*args*/) const
+	{
+		DispatchStack & stack = doGetDispatchStack();
+		if(stack.depth < maxNestedDispatch) {
+			stack.startList[stack.depth] = Clock::now();
+		}
+		++stack.depth;
+		return true;
+	}
+
+	void mixinAfterDispatch(const Event_ & e) const
+	{
+		DispatchStack & stack = doGetDispatchStack();
+		--stack.depth;
+		if(stack.depth < maxNestedDispatch) {
+			doRecord(doGetShard(e).execution, Clock::now() - stack.startList[stack.depth]);
+		}
+	}
+
+	template <typename QueuedEvent>
+	void mixinAfterEnqueue(const QueuedEvent & item) const
+	{
+		doGetShard(item.getEvent()).enqueueCount.fetch_add(1, std::memory_order_relaxed);
+
+		const std::int64_t depth = queueDepth.fetch_add(1, std::memory_order_relaxed) + 1;
+		std::int64_t highWatermark = queueHighWatermark.load(std::memory_order_relaxed);
+		while(depth > highWatermark
+			&& ! queueHighWatermark.compare_exchange_weak(highWatermark, depth, std::memory_order_relaxed)) {
+		}
+	}
+
+	template <typename QueuedEvent>
+	void mixinAfterDequeue(const QueuedEvent & item) const
+	{
+		EventShard & shard = doGetShard(item.getEvent());
+		shard.dequeueCount.fetch_add(1, std::memory_order_relaxed);
+		doRecordResidency(shard, item, std::integral_constant<bool, internal_::HasFunctionGetEnqueueTime<QueuedEvent>::value>());
+		queueDepth.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+private:
+	template <typename QueuedEvent>
+	static void doRecordResidency(EventShard & shard, const QueuedEvent & item, std::true_type)
+	{
+		doRecord(shard.residency, Clock::now() - item.getEnqueueTime());
+	}
+
+	template <typename QueuedEvent>
+	static void doRecordResidency(EventShard & /*shard*/, const QueuedEvent & /*item*/, std::false_type)
+	{
+	}
+
+	EventShard & doGetShard(const Event_ & e) const
+	{
+		return doGetEventMetrics(e).shards[doGetShardIndex()];
+	}
+
+	// The metrics are never erased, so the reference stays valid.
+	EventMetrics & doGetEventMetrics(const Event_ & e) const
+	{
+		{
+			std::shared_lock<SharedMutex> lockGuard(metricsMutex);
+			auto it = metricsMap.find(e);
+			if(it != metricsMap.end()) {
+				return *it->second;
+			}
+		}
+
+		std::lock_guard<SharedMutex> lockGuard(metricsMutex);
+		auto & metrics = metricsMap[e];
+		if(! metrics) {
+			metrics.reset(new EventMetrics());
+		}
+		return *metrics;
+	}
+
+	static unsigned int doGetShardIndex()
+	{
+		static std::atomic<unsigned int> nextIndex(0);
+		static thread_local const unsigned int index = nextIndex.fetch_add(1, std::memory_order_relaxed) % shardCount;
+		return index;
+	}
+
+	static DispatchStack & doGetDispatchStack()
+	{
+		static thread_local DispatchStack stack {};
+		return stack;
+	}
+
+	static void doRecord(HistogramShard & histogram, const Clock::duration & duration)
+	{
+		const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+		const std::uint64_t value = (nanoseconds > 0 ? static_cast<std::uint64_t>(nanoseconds) : 0);
+
+		histogram.buckets[doGetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+		histogram.count.fetch_add(1, std::memory_order_relaxed);
+		histogram.sum.fetch_add(value, std::memory_order_relaxed);
+		std::uint64_t max = histogram.max.load(std::memory_order_relaxed);
+		while(value > max && ! histogram.max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+		}
+	}
+
+	static std::size_t doGetBucketIndex(const std::uint64_t value)
+	{
+		if(value < subBucketCount) {
+			return static_cast<std::size_t>(value);
+		}
+
+		const int exponent = doGetHighestBit(value);
+		if(exponent > maxExponent) {
+			return bucketCount - 1;
+		}
+		const std::size_t subBucket = static_cast<std::size_t>(value >> (exponent - subBucketBits)) & (subBucketCount - 1);
+		return static_cast<std::size_t>(exponent - subBucketBits + 1) * subBucketCount + subBucket;
+	}
+
+	static std::uint64_t doGetBucketUpperBound(const std::size_t index)
+	{
+		if(index < subBucketCount) {
+			return index;
+		}
+
+		const int shift = static_cast<int>(index / subBucketCount) - 1;
+		const std::uint64_t subBucket = index % subBucketCount;
+		return ((subBucketCount + subBucket + 1) << shift) - 1;
+	}
+
+	static int doGetHighestBit(std::uint64_t value)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return 63 - __builtin_clzll(value);
+#else
+		int bit = 0;
+		while(value >>= 1) {
+			++bit;
+		}
+		return bit;
+#endif
+	}
+
+	static void doSnapshotHistogram(MetricsHistogram & histogram, const EventMetrics & metrics, HistogramShard EventShard::* member)
+	{
+		histogram.count = 0;
+		histogram.sum = 0;
+		histogram.max = 0;
+		for(std::size_t i = 0; i < bucketCount; ++i) {
+			std::uint64_t count = 0;
+			for(const EventShard & shard : metrics.shards) {
+				count += (shard.*member).buckets[i].load(std::memory_order_relaxed);
+			}
+			if(count > 0) {
+				histogram.bucketList.push_back(typename MetricsHistogram::Bucket { doGetBucketUpperBound(i), count });
+			}
+		}
+		for(const EventShard & shard : metrics.shards) {
+			const HistogramShard & shardHistogram = shard.*member;
+			histogram.count += shardHistogram.count.load(std::memory_order_relaxed);
+			histogram.sum += shardHistogram.sum.load(std::memory_order_relaxed);
+			const std::uint64_t max = shardHistogram.max.load(std::memory_order_relaxed);
+			if(max > histogram.max) {
+				histogram.max = max;
+			}
+		}
+	}
+
+private:
+	mutable MetricsMap metricsMap;
+	mutable SharedMutex metricsMutex;
+	mutable Atomic<std::int64_t> queueDepth { 0 };
+	mutable Atomic<std::int64_t> queueHighWatermark { 0 };
+};
+
+
+} //namespace eventpp
+
+
+#endif
+
@@ -0,0 +1,396 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MIXINRATELIMIT_H_EVENTPP
+#define MIXINRATELIMIT_H_EVENTPP
+
+#include "../eventpolicies.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// The dense index of an integral or enum event, or -1 if it has none.
+template <typename E, typename Enabled = void>
+struct RateLimitDenseIndex
+{
+	static std::ptrdiff_t get(const E & /*e*/) {
+		return -1;
+	}
+};
+
+template <typename E>
+struct RateLimitDenseIndex <E, typename std::enable_if<std::is_integral<E>::value || std::is_enum<E>::value>::type>
+{
+	static std::ptrdiff_t get(const E & e) {
+		return static_cast<std::ptrdiff_t>(e);
+	}
+};
+
+} //namespace internal_
+
+// OPT-56: Token bucket rate limits and 1-in-N sampling per event.
+// The buckets of the integral events below denseEventLimit are in a flat
+// array indexed by the event, the other events are in a map. The table is
+// published through an atomic pointer and is never changed after that, so
+// a check is an atomic load and an array access, with no lock. Only adding
+// an event publishes a new table, the old tables are kept until the mixin
+// is destroyed.
+// A bucket is the GCRA form of the token bucket, one atomic time at which
+// the bucket is full again, updated by a CAS.
+// The events are dropped before the listener map is looked up. In a queue
+// the clock is read once when each process call starts, a plain dispatcher
+// reads it for each check. A limit with onEnqueue is applied by the enqueue
+// functions instead, with the current time, so the dropped events never
+// take a node.
+template <typename Base>
+class MixinRateLimit : public Base
+{
+private:
+	using super = Base;
+	using Event_ = typename super::Event;
+	using Mutex = typename super::Mutex;
+	using Clock = std::chrono::steady_clock;
+	using DenseIndex = internal_::RateLimitDenseIndex<Event_>;
+
+	enum : std::ptrdiff_t {
+		denseEventLimit = 4096
+	};
+
+	struct RateBucket
+	{
+		explicit RateBucket(const Event_ & e)
+			:
+				event(e),
+				interval(0),
+				tolerance(0),
+				sampleEvery(1),
+				onEnqueue(false),
+				fullTime(0),
+				sampleCounter(0),
+				passedCount(0),
+				droppedCount(0)
+		{
+		}
+
+		const Event_ event;
+		// Nanoseconds, 0 is no rate limit.
+		std::atomic<std::int64_t> interval;
+		std::atomic<std::int64_t> tolerance;
+		std::atomic<std::uint32_t> sampleEvery;
+		std::atomic<bool> onEnqueue;
+		// The theoretical arrival time of GCRA, in nanoseconds of Clock.
+		std::atomic<std::int64_t> fullTime;
+		std::atomic<std::uint64_t> sampleCounter;
+		std::atomic<std::uint64_t> passedCount;
+		std::atomic<std::uint64_t> droppedCount;
+	};
+
+	using BucketMap = typename internal_::SelectMap<
+		Event_,
+		RateBucket *,
+		DefaultPolicies,
+		false
+	>::Type;
+
+	// Never changed after it's published.
+	struct RateTable
+	{
+		std::vector<RateBucket *> denseList;
+		BucketMap bucketMap;
+	};
+
+public:
+	struct RateLimit
+	{
+		// 0 is no rate limit.
+		double eventsPerSecond = 0;
+		// The events which can pass at once after the bucket is full.
+		double burst = 1;
+		// Only 1 in sampleEvery events is passed to the rate limit, 1 is all.
+		std::uint32_t sampleEvery = 1;
+		// Applied by enqueue instead of the dispatch.
+		bool onEnqueue = false;
+	};
+
+	struct RateLimitSnapshot
+	{
+		Event_ event;
+		std::uint64_t passedCount;
+		std::uint64_t droppedCount;
+	};
+
+public:
+	using super::super;
+
+	MixinRateLimit()
+		: super()
+	{
+	}
+
+	// The copy has the same limits, its buckets and counts start from zero.
+	MixinRateLimit(const MixinRateLimit & other)
+		: super(other)
+	{
+		doCopyFrom(other);
+	}
+
+	MixinRateLimit(MixinRateLimit && other) noexcept
+		: super(std::move(other))
+	{
+		doCopyFrom(other);
+	}
+
+	MixinRateLimit & operator = (const MixinRateLimit & other)
+	{
+		super::operator = (other);
+		if(this != &other) {
+			doCopyFrom(other);
+		}
+		return *this;
+	}
+
+	MixinRateLimit & operator = (MixinRateLimit && other) noexcept
+	{
+		super::operator = (std::move(other));
+		if(this != &other) {
+			doCopyFrom(other);
+		}
+		return *this;
+	}
+
+	// Sets the limit of e, the bucket of e is full again.
+	void setRateLimit(const Event_ & e, const RateLimit & limit)
+	{
+		std::lock_guard<Mutex> lockGuard(rateMutex);
+		doSetRateLimit(doGetBucket(e), limit);
+	}
+
+	// Returns false if e has no limit.
+	bool removeRateLimit(const Event_ & e)
+	{
+		std::lock_guard<Mutex> lockGuard(rateMutex);
+		for(const auto & bucket : bucketList) {
+			if(bucket->event == e) {
+				doSetRateLimit(bucket.get(), RateLimit());
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// The counts of the events which have or had a limit.
+	std::vector<RateLimitSnapshot> getRateLimitSnapshot() const
+	{
+		std::vector<RateLimitSnapshot> snapshotList;
+		std::lock_guard<Mutex> lockGuard(rateMutex);
+		snapshotList.reserve(bucketList.size());
+		for(const auto & bucket : bucketList) {
+			snapshotList.push_back(RateLimitSnapshot {
+				bucket->event,
+				bucket->passedCount.load(std::memory_order_relaxed),
+				bucket->droppedCount.load(std::memory_order_relaxed)
+			});
+		}
+		return snapshotList;
+	}
+
+	template <typename ...Args>
+	bool mixinBeforeDispatchEvent(const Event_ & e, Args && .../*args*/) const
+	{
+		RateBucket * const bucket = doFindBucket(e);
+		if(bucket == nullptr || bucket->onEnqueue.load(std::memory_order_relaxed)) {
+			return true;
+		}
+		return doTryPass(*bucket, doGetDispatchTime());
+	}
+
+	bool mixinBeforeEnqueue(const Event_ & e) const
+	{
+		RateBucket * const bucket = doFindBucket(e);
+		if(bucket == nullptr || ! bucket->onEnqueue.load(std::memory_order_relaxed)) {
+			return true;
+		}
+		return doTryPass(*bucket, doGetNanoseconds(Clock::now()));
+	}
+
+	void mixinBeforeProcess() const
+	{
+		if(publishedTable.load(std::memory_order_relaxed) != nullptr) {
+			processTime.store(doGetNanoseconds(Clock::now()), std::memory_order_relaxed);
+			hasProcessTime.store(true, std::memory_order_relaxed);
+		}
+	}
+
+private:
+	RateBucket * doFindBucket(const Event_ & e) const
+	{
+		const RateTable * const table = publishedTable.load(std::memory_order_acquire);
+		if(table == nullptr) {
+			return nullptr;
+		}
+		const std::ptrdiff_t index = DenseIndex::get(e);
+		if(index >= 0 && index < denseEventLimit) {
+			return static_cast<std::size_t>(index) < table->denseList.size() ? table->denseList[index] : nullptr;
+		}
+		if(table->bucketMap.empty()) {
+			return nullptr;
+		}
+		auto it = table->bucketMap.find(e);
+		return it != table->bucketMap.end() ? it->second : nullptr;
+	}
+
+	static bool doTryPass(RateBucket & bucket, const std::int64_t now)
+	{
+		const std::uint32_t sampleEvery = bucket.sampleEvery.load(std::memory_order_relaxed);
+		if(sampleEvery > 1 && bucket.sampleCounter.fetch_add(1, std::memory_order_relaxed) % sampleEvery != 0) {
+			bucket.droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		const std::int64_t interval = bucket.interval.load(std::memory_order_relaxed);
+		if(interval > 0) {
+			const std::int64_t tolerance = bucket.tolerance.load(std::memory_order_relaxed);
+			std::int64_t fullTime = bucket.fullTime.load(std::memory_order_relaxed);
+			for(;;) {
+				if(fullTime - now > tolerance) {
+					bucket.droppedCount.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				}
+				const std::int64_t newFullTime = (fullTime > now ? fullTime : now) + interval;
+				if(bucket.fullTime.compare_exchange_weak(fullTime, newFullTime, std::memory_order_relaxed)) {
+					break;
+				}
+			}
+		}
+
+		bucket.passedCount.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	std::int64_t doGetDispatchTime() const
+	{
+		if(hasProcessTime.load(std::memory_order_relaxed)) {
+			return processTime.load(std::memory_order_relaxed);
+		}
+		return doGetNanoseconds(Clock::now());
+	}
+
+	static std::int64_t doGetNanoseconds(const Clock::time_point & timePoint)
+	{
+		return static_cast<std::int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(timePoint.time_since_epoch()).count());
+	}
+
+	// Must be called under the lock.
+	static void doSetRateLimit(RateBucket * bucket, const RateLimit & limit)
+	{
+		std::int64_t interval = 0;
+		std::int64_t tolerance = 0;
+		if(limit.eventsPerSecond > 0) {
+			interval = static_cast<std::int64_t>(1e9 / limit.eventsPerSecond);
+			if(interval <= 0) {
+				interval = 1;
+			}
+			const double burst = (limit.burst > 1 ? limit.burst : 1);
+			tolerance = static_cast<std::int64_t>(static_cast<double>(interval) * (burst - 1));
+		}
+		bucket->interval.store(interval, std::memory_order_relaxed);
+		bucket->tolerance.store(tolerance, std::memory_order_relaxed);
+		bucket->sampleEvery.store(limit.sampleEvery > 1 ? limit.sampleEvery : 1, std::memory_order_relaxed);
+		bucket->onEnqueue.store(limit.onEnqueue, std::memory_order_relaxed);
+		bucket->fullTime.store(0, std::memory_order_relaxed);
+	}
+
+	// Must be called under the lock.
+	RateBucket * doGetBucket(const Event_ & e)
+	{
+		for(const auto & bucket : bucketList) {
+			if(bucket->event == e) {
+				return bucket.get();
+			}
+		}
+
+		bucketList.emplace_back(new RateBucket(e));
+		std::unique_ptr<RateTable> table(new RateTable());
+		for(const auto & bucket : bucketList) {
+			const std::ptrdiff_t index = DenseIndex::get(bucket->event);
+			if(index >= 0 && index < denseEventLimit) {
+				if(static_cast<std::size_t>(index) >= table->denseList.size()) {
+					table->denseList.resize(static_cast<std::size_t>(index) + 1, nullptr);
+				}
+				table->denseList[index] = bucket.get();
+			}
+			else {
+				table->bucketMap[bucket->event] = bucket.get();
+			}
+		}
+		// A dispatch which started before may still read the old table.
+		publishedTable.store(table.get(), std::memory_order_release);
+		tableList.push_back(std::move(table));
+		return bucketList.back().get();
+	}
+
+	void doCopyFrom(const MixinRateLimit & other)
+	{
+		std::vector<std::pair<Event_, RateLimit> > limitList;
+		{
+			std::lock_guard<Mutex> lockGuard(other.rateMutex);
+			for(const auto & bucket : other.bucketList) {
+				limitList.push_back(std::make_pair(bucket->event, other.doGetRateLimit(*bucket)));
+			}
+		}
+		std::lock_guard<Mutex> lockGuard(rateMutex);
+		for(const auto & item : limitList) {
+			RateBucket * const bucket = doGetBucket(item.first);
+			doSetRateLimit(bucket, item.second);
+			bucket->passedCount.store(0, std::memory_order_relaxed);
+			bucket->droppedCount.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	static RateLimit doGetRateLimit(const RateBucket & bucket)
+	{
+		RateLimit limit;
+		const std::int64_t interval = bucket.interval.load(std::memory_order_relaxed);
+		if(interval > 0) {
+			limit.eventsPerSecond = 1e9 / static_cast<double>(interval);
+			limit.burst = 1 + static_cast<double>(bucket.tolerance.load(std::memory_order_relaxed)) / static_cast<double>(interval);
+		}
+		limit.sampleEvery = bucket.sampleEvery.load(std::memory_order_relaxed);
+		limit.onEnqueue = bucket.onEnqueue.load(std::memory_order_relaxed);
+		return limit;
+	}
+
+private:
+	mutable Mutex rateMutex {};
+	std::vector<std::unique_ptr<RateBucket> > bucketList {};
+	std::vector<std::unique_ptr<RateTable> > tableList {};
+	std::atomic<const RateTable *> publishedTable { nullptr };
+	mutable std::atomic<std::int64_t> processTime { 0 };
+	mutable std::atomic<bool> hasProcessTime { false };
+};
+
+
+} //namespace eventpp
+
+#endif
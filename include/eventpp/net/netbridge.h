@@ -0,0 +1,417 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef NETBRIDGE_H_EVENTPP
+#define NETBRIDGE_H_EVENTPP
+
+#if ! defined(__unix__) && ! defined(__unix) && ! defined(__APPLE__)
+	#error "eventpp/net requires a POSIX system."
+#endif
+
+#include "../internal/netframe_i.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+namespace eventpp {
+
+// The payload of an Ethernet frame without the IPv4 and UDP headers.
+constexpr std::size_t netDefaultDatagramSize = 1472;
+constexpr std::size_t netDefaultBatchCapacity = 64;
+
+namespace internal_ {
+
+inline bool isStreamSocket(const int fd)
+{
+	int type = 0;
+	socklen_t length = sizeof(type);
+	return getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &length) == 0 && type == SOCK_STREAM;
+}
+
+#if defined(MSG_NOSIGNAL)
+constexpr int netSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int netSendFlags = 0;
+#endif
+
+} //namespace internal_
+
+// OPT-74: Sends the events of Prototype to a socket in batches.
+// send() writes a length-prefixed frame of the event and the arguments in
+// a buffer, flush() sends the buffer with one system call.
+// On a datagram socket the frames are packed into datagrams of up to
+// maxDatagramSize bytes, and the datagrams are sent with one sendmmsg (one
+// sendmsg for each datagram on the systems without sendmmsg). On a stream
+// socket the chunks are gathered by one sendmsg, as writev does.
+// fd is not owned, and must be connected. Not thread safe, use one sender
+// for each thread.
+template <typename Event_, typename Prototype_>
+class NetSender
+{
+private:
+	using Codec = internal_::NetFrameCodec<Event_, Prototype_>;
+
+public:
+	explicit NetSender(
+			const int fd,
+			const std::size_t maxDatagramSize = netDefaultDatagramSize,
+			const std::size_t batchCapacity = netDefaultBatchCapacity
+		)
+		:
+			fd(fd),
+			stream(internal_::isStreamSocket(fd)),
+			chunkSize(std::max<std::size_t>(maxDatagramSize, Codec::frameSize)),
+			chunkCount(std::max<std::size_t>(batchCapacity, 1)),
+			buffer(chunkSize * chunkCount),
+			usedSizeList(chunkCount, 0),
+			iovecList(chunkCount),
+#if defined(__linux__)
+			messageList(chunkCount),
+#endif
+			currentChunk(0),
+			pendingCount(0)
+	{
+#if defined(__linux__)
+		for(std::size_t i = 0; i < chunkCount; ++i) {
+			messageList[i].msg_hdr.msg_iov = &iovecList[i];
+			messageList[i].msg_hdr.msg_iovlen = 1;
+		}
+#endif
+	}
+
+	NetSender(const NetSender &) = delete;
+	NetSender & operator = (const NetSender &) = delete;
+
+	// The events which are not sent yet are sent.
+	~NetSender()
+	{
+		flush();
+	}
+
+	// Buffers one event, args are the same as EventQueue::enqueue(event, args...).
+	// Flushes first if the buffer is full, returns false if that flush failed.
+	template <typename ...A>
+	bool send(A && ...args)
+	{
+		bool result = true;
+		if(usedSizeList[currentChunk] + Codec::frameSize > chunkSize) {
+			if(currentChunk + 1 < chunkCount) {
+				++currentChunk;
+			}
+			else {
+				result = flush();
+			}
+		}
+		Codec::encode(buffer.data() + currentChunk * chunkSize + usedSizeList[currentChunk], std::forward<A>(args)...);
+		usedSizeList[currentChunk] += Codec::frameSize;
+		++pendingCount;
+		return result;
+	}
+
+	// Sends the buffered events. Returns false and sets errno if the socket
+	// failed, the buffered events are discarded either way.
+	bool flush()
+	{
+		if(pendingCount == 0) {
+			return true;
+		}
+
+		const std::size_t count = currentChunk + 1;
+		for(std::size_t i = 0; i < count; ++i) {
+			iovecList[i].iov_base = buffer.data() + i * chunkSize;
+			iovecList[i].iov_len = usedSizeList[i];
+		}
+		const bool result = (stream ? doSendStream(count) : doSendDatagrams(count));
+
+		std::fill(usedSizeList.begin(), usedSizeList.begin() + count, 0);
+		currentChunk = 0;
+		pendingCount = 0;
+		return result;
+	}
+
+	// The count of the events which are buffered and not sent yet.
+	std::size_t getPendingCount() const
+	{
+		return pendingCount;
+	}
+
+private:
+	bool doSendDatagrams(const std::size_t count)
+	{
+#if defined(__linux__)
+		std::size_t sentCount = 0;
+		while(sentCount < count) {
+			const int result = sendmmsg(fd, messageList.data() + sentCount, static_cast<unsigned int>(count - sentCount), 0);
+			if(result < 0) {
+				if(errno == EINTR) {
+					continue;
+				}
+				return false;
+			}
+			sentCount += static_cast<std::size_t>(result);
+		}
+#else
+		for(std::size_t i = 0; i < count; ++i) {
+			msghdr message {};
+			message.msg_iov = &iovecList[i];
+			message.msg_iovlen = 1;
+			while(sendmsg(fd, &message, 0) < 0) {
+				if(errno != EINTR) {
+					return false;
+				}
+			}
+		}
+#endif
+		return true;
+	}
+
+	bool doSendStream(const std::size_t count)
+	{
+		iovec * first = iovecList.data();
+		std::size_t remainingCount = count;
+		while(remainingCount > 0) {
+			msghdr message {};
+			message.msg_iov = first;
+			message.msg_iovlen = remainingCount;
+			const ssize_t result = sendmsg(fd, &message, internal_::netSendFlags);
+			if(result < 0) {
+				if(errno == EINTR) {
+					continue;
+				}
+				return false;
+			}
+			// A partial write, skip what was written.
+			std::size_t written = static_cast<std::size_t>(result);
+			while(remainingCount > 0 && written >= first->iov_len) {
+				written -= first->iov_len;
+				++first;
+				--remainingCount;
+			}
+			if(remainingCount > 0) {
+				first->iov_base = static_cast<char *>(first->iov_base) + written;
+				first->iov_len -= written;
+			}
+		}
+		return true;
+	}
+
+private:
+	const int fd;
+	const bool stream;
+	const std::size_t chunkSize;
+	const std::size_t chunkCount;
+	std::vector<char> buffer;
+	std::vector<std::size_t> usedSizeList;
+	std::vector<iovec> iovecList;
+#if defined(__linux__)
+	std::vector<mmsghdr> messageList;
+#endif
+	std::size_t currentChunk;
+	std::size_t pendingCount;
+};
+
+// OPT-74: Receives the events which NetSender sent, and enqueues them to
+// an EventQueue with enqueueBulk, that's one lock and one notification for
+// each batch. The event nodes are taken from the queue in one go and built
+// from the received bytes in place.
+// On a datagram socket receive takes up to batchCapacity datagrams with one
+// recvmmsg. maxDatagramSize must not be smaller than the one of the
+// sender, a truncated datagram is dropped. On a stream socket receive takes
+// up to batchCapacity * maxDatagramSize bytes with one recv, a frame which
+// is split is kept until the rest arrives.
+// fd is not owned. Not thread safe, use one receiver for each socket.
+template <typename Event_, typename Prototype_>
+class NetReceiver
+{
+private:
+	using Codec = internal_::NetFrameCodec<Event_, Prototype_>;
+
+public:
+	explicit NetReceiver(
+			const int fd,
+			const std::size_t maxDatagramSize = netDefaultDatagramSize,
+			const std::size_t batchCapacity = netDefaultBatchCapacity
+		)
+		:
+			fd(fd),
+			stream(internal_::isStreamSocket(fd)),
+			chunkSize(std::max<std::size_t>(maxDatagramSize, Codec::frameSize)),
+			chunkCount(std::max<std::size_t>(batchCapacity, 1)),
+			buffer(chunkSize * chunkCount),
+			streamUsedSize(0),
+			iovecList(stream ? 0 : chunkCount),
+#if defined(__linux__)
+			messageList(stream ? 0 : chunkCount),
+#endif
+			frameList(),
+			droppedFrameCount(0)
+	{
+		for(std::size_t i = 0; i < iovecList.size(); ++i) {
+			iovecList[i].iov_base = buffer.data() + i * chunkSize;
+			iovecList[i].iov_len = chunkSize;
+#if defined(__linux__)
+			messageList[i].msg_hdr.msg_iov = &iovecList[i];
+			messageList[i].msg_hdr.msg_iovlen = 1;
+#endif
+		}
+	}
+
+	NetReceiver(const NetReceiver &) = delete;
+	NetReceiver & operator = (const NetReceiver &) = delete;
+
+	// Receives with one system call and enqueues the events to queue.
+	// If wait is true, waits until there is data, otherwise returns 0 if
+	// there is none. Returns the count of the events enqueued, or -1 and
+	// sets errno if the socket failed. On a stream socket errno is
+	// ENOTCONN if the peer closed it, and EPROTO if a frame is malformed,
+	// the frames before the malformed one are enqueued, and the stream
+	// can't be used any more.
+	template <typename Queue>
+	int receive(Queue & queue, const bool wait = true)
+	{
+		frameList.clear();
+		const int result = (stream ? doReceiveStream(wait) : doReceiveDatagrams(wait));
+		if(! frameList.empty()) {
+			queue.enqueueBulk(frameList.size(), [this](const std::size_t index) {
+				return Codec::decode(frameList[index]);
+			});
+		}
+		if(stream && ! frameList.empty()) {
+			doCompactStream();
+		}
+		return result < 0 ? result : static_cast<int>(frameList.size());
+	}
+
+	// The count of the frames which were dropped because they were
+	// truncated or malformed, on a datagram socket.
+	std::size_t getDroppedFrameCount() const
+	{
+		return droppedFrameCount;
+	}
+
+private:
+	int doReceiveDatagrams(const bool wait)
+	{
+#if defined(__linux__)
+		const int count = recvmmsg(fd, messageList.data(), static_cast<unsigned int>(chunkCount), wait ? MSG_WAITFORONE : MSG_DONTWAIT, nullptr);
+		if(count < 0) {
+			return doIsNoData() ? 0 : -1;
+		}
+		for(int i = 0; i < count; ++i) {
+			doParseDatagram(i, messageList[i].msg_len, messageList[i].msg_hdr.msg_flags);
+		}
+#else
+		for(std::size_t i = 0; i < chunkCount; ++i) {
+			msghdr message {};
+			message.msg_iov = &iovecList[i];
+			message.msg_iovlen = 1;
+			const ssize_t size = recvmsg(fd, &message, (wait && i == 0) ? 0 : MSG_DONTWAIT);
+			if(size < 0) {
+				if(i > 0 || doIsNoData()) {
+					break;
+				}
+				return -1;
+			}
+			doParseDatagram(i, static_cast<std::size_t>(size), message.msg_flags);
+		}
+#endif
+		return 0;
+	}
+
+	void doParseDatagram(const std::size_t index, const std::size_t size, const int flags)
+	{
+		if((flags & MSG_TRUNC) != 0) {
+			++droppedFrameCount;
+			return;
+		}
+		const char * datagram = buffer.data() + index * chunkSize;
+		for(std::size_t offset = 0; offset < size; offset += Codec::frameSize) {
+			if(size - offset < Codec::frameSize || ! Codec::isValid(datagram + offset)) {
+				// The rest of the datagram can't be framed.
+				++droppedFrameCount;
+				break;
+			}
+			frameList.push_back(datagram + offset);
+		}
+	}
+
+	int doReceiveStream(const bool wait)
+	{
+		ssize_t size;
+		do {
+			size = recv(fd, buffer.data() + streamUsedSize, buffer.size() - streamUsedSize, wait ? 0 : MSG_DONTWAIT);
+		} while(size < 0 && errno == EINTR);
+		if(size < 0) {
+			return doIsNoData() ? 0 : -1;
+		}
+		if(size == 0) {
+			errno = ENOTCONN;
+			return -1;
+		}
+		streamUsedSize += static_cast<std::size_t>(size);
+
+		std::size_t offset = 0;
+		while(streamUsedSize - offset >= Codec::frameSize) {
+			if(! Codec::isValid(buffer.data() + offset)) {
+				// A stream can't find the next frame boundary.
+				streamUsedSize = offset;
+				errno = EPROTO;
+				return -1;
+			}
+			frameList.push_back(buffer.data() + offset);
+			offset += Codec::frameSize;
+		}
+		return 0;
+	}
+
+	// Moves the split frame at the end to the beginning of the buffer.
+	void doCompactStream()
+	{
+		const std::size_t consumedSize = frameList.size() * Codec::frameSize;
+		streamUsedSize -= consumedSize;
+		std::memmove(buffer.data(), buffer.data() + consumedSize, streamUsedSize);
+	}
+
+	static bool doIsNoData()
+	{
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	}
+
+private:
+	const int fd;
+	const bool stream;
+	const std::size_t chunkSize;
+	const std::size_t chunkCount;
+	std::vector<char> buffer;
+	std::size_t streamUsedSize;
+	std::vector<iovec> iovecList;
+#if defined(__linux__)
+	std::vector<mmsghdr> messageList;
+#endif
+	std::vector<const char *> frameList;
+	std::size_t droppedFrameCount;
+};
+
+
+} //namespace eventpp
+
+
+#endif
@@ -0,0 +1,578 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PARALLELEVENTQUEUE_H_EVENTPP
+#define PARALLELEVENTQUEUE_H_EVENTPP
+
+#include "eventdispatcher.h"
+#include "internal/eventqueue_i.h"
+#include "internal/spinwait_i.h"
+
+#include <array>
+#include <deque>
+#include <vector>
+#include <tuple>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <functional>
+#include <type_traits>
+
+namespace eventpp {
+
+namespace internal_ {
+
+template <typename T>
+struct HasTypeShardCount
+{
+	template <typename C> static std::true_type test(typename C::ShardCount *) ;
+	template <typename C> static std::false_type test(...);
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename T, bool> struct SelectShardCount { using Type = typename T::ShardCount; };
+template <typename T> struct SelectShardCount <T, false> { using Type = std::integral_constant<std::size_t, 64>; };
+
+template <typename T, typename ...Args>
+struct HasFunctionShardKey
+{
+	template <typename C> static std::true_type test(decltype(C::shardKey(std::declval<Args>()...)) *);
+	template <typename C> static std::false_type test(...);
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+template <typename E>
+struct DefaultShardKey
+{
+	template <typename ...A>
+	static std::size_t shardKey(const E & e, A && ...) {
+		return std::hash<E>()(e);
+	}
+};
+template <typename T, typename E, bool> struct SelectShardKey { using Type = T; };
+template <typename T, typename E> struct SelectShardKey<T, E, false> { using Type = DefaultShardKey<E>; };
+
+template <
+	typename EventType_,
+	typename Prototype_,
+	typename Policies_
+>
+class ParallelEventQueueBase;
+
+// OPT-18: EventQueue which is processed by several worker threads.
+// Each queued event is routed to a shard by shardKey(event, args...). A shard
+// is owned by at most one worker at a time, so the events in the same shard
+// are processed in the order they are enqueued. Ready shards are put in the
+// deque of their home worker, an idle worker steals shards from the others.
+template <
+	typename EventType_,
+	typename Policies_,
+	typename ReturnType, typename ...Args
+>
+class ParallelEventQueueBase <
+		EventType_,
+		ReturnType (Args...),
+		Policies_
+	> : public EventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		ParallelEventQueueBase <
+			EventType_,
+			ReturnType (Args...),
+			Policies_
+		>
+	>
+{
+private:
+	using super = EventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		ParallelEventQueueBase <
+			EventType_,
+			ReturnType (Args...),
+			Policies_
+		>
+	>;
+
+	using Policies = typename super::Policies;
+	using Threading = typename super::Threading;
+	using DispatchCache = typename super::DispatchCache;
+	using ConditionVariable = typename Threading::ConditionVariable;
+
+	using QueuedEventArgumentsType = std::tuple<typename std::decay<Args>::type...>;
+
+	struct QueuedEvent_
+	{
+		typename std::decay<typename super::Event>::type event;
+		QueuedEventArgumentsType arguments;
+
+		typename super::Event getEvent() const {
+			return event;
+		}
+
+		template <std::size_t N>
+		auto getArgument() const
+			-> typename std::tuple_element<N, std::tuple<Args...> >::type {
+			return std::get<N>(arguments);
+		}
+	};
+
+public:
+	using ShardCount = typename SelectShardCount<Policies_, HasTypeShardCount<Policies_>::value>::Type;
+	using ShardKey = typename SelectShardKey<
+		Policies_,
+		typename std::decay<EventType_>::type,
+		HasFunctionShardKey<
+			Policies_,
+			const typename std::decay<EventType_>::type &,
+			const typename std::decay<Args>::type &...
+		>::value
+	>::Type;
+
+	using QueuedEvent = QueuedEvent_;
+	using Event = typename super::Event;
+	using Handle = typename super::Handle;
+	using Callback = typename super::Callback;
+	using Mutex = typename super::Mutex;
+
+private:
+	static_assert(ShardCount::value > 0, "ShardCount must be greater than 0.");
+
+	struct Shard
+	{
+		Mutex mutex;
+		std::vector<QueuedEvent> eventList;
+		// True while the shard is in a worker deque or a worker is processing it.
+		bool scheduled = false;
+	};
+
+	struct WorkerDeque
+	{
+		Mutex mutex;
+		std::deque<std::size_t> shardIndexList;
+		// Read without the lock so stealing skips the empty deques.
+		typename Threading::template Atomic<int> size { 0 };
+	};
+
+public:
+	// workerCount is the number of threads which call process(workerIndex),
+	// 0 means std::thread::hardware_concurrency().
+	explicit ParallelEventQueueBase(const std::size_t workerCount = 0)
+		:
+			super(),
+			shardList(),
+			workerCount(workerCount > 0 ? workerCount : doGetDefaultWorkerCount()),
+			workerDequeList(new WorkerDeque[this->workerCount]),
+			pendingEventCount(0),
+			readyShardCount(0),
+			waitingConsumerCount(0),
+			queueListConditionVariable(),
+			queueListMutex()
+	{
+	}
+
+	// Same as EventQueue, only the listeners are copied or moved, the queued events are not.
+	ParallelEventQueueBase(const ParallelEventQueueBase & other)
+		: ParallelEventQueueBase(other.workerCount)
+	{
+		super::operator = (other);
+	}
+
+	ParallelEventQueueBase(ParallelEventQueueBase && other) noexcept
+		: ParallelEventQueueBase(other.workerCount)
+	{
+		super::operator = (std::move(other));
+	}
+
+	ParallelEventQueueBase & operator = (const ParallelEventQueueBase & other)
+	{
+		super::operator = (other);
+		return *this;
+	}
+
+	ParallelEventQueueBase & operator = (ParallelEventQueueBase && other) noexcept
+	{
+		super::operator = (std::move(other));
+		return *this;
+	}
+
+	template <typename ...A>
+	auto enqueue(A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args)>::type
+	{
+		static_assert(super::ArgumentPassingMode::canIncludeEventType, "Enqueuing arguments count doesn't match required (Event type should be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, A...>::value>::Type;
+
+		doEnqueue(QueuedEvent{
+			GetEvent::getEvent(args...),
+			QueuedEventArgumentsType(std::forward<A>(args)...)
+		});
+	}
+
+	template <typename T, typename ...A>
+	auto enqueue(T && first, A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args)>::type
+	{
+		static_assert(super::ArgumentPassingMode::canExcludeEventType, "Enqueuing arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, T &&, A...>::value>::Type;
+
+		doEnqueue(QueuedEvent{
+			GetEvent::getEvent(std::forward<T>(first), args...),
+			QueuedEventArgumentsType(std::forward<A>(args)...)
+		});
+	}
+
+	// Returns true if no event is queued or being processed.
+	bool emptyQueue() const
+	{
+		return pendingEventCount.load(std::memory_order_acquire) == 0;
+	}
+
+	std::size_t getWorkerCount() const
+	{
+		return workerCount;
+	}
+
+	std::size_t getShardCount() const
+	{
+		return ShardCount::value;
+	}
+
+	void clearEvents()
+	{
+		for(Shard & shard : shardList) {
+			std::lock_guard<Mutex> shardLock(shard.mutex);
+			pendingEventCount.fetch_sub(static_cast<int>(shard.eventList.size()), std::memory_order_release);
+			shard.eventList.clear();
+		}
+	}
+
+	// Called by worker workerIndex, which must be less than getWorkerCount().
+	// Processes the shards in the deque of the worker, then steals shards from
+	// the other workers. Returns true if any event is processed.
+	bool process(const std::size_t workerIndex)
+	{
+		// OPT-25: Consecutive events of the same type share one lookup.
+		DispatchCache cache;
+		return doProcessWorker(workerIndex, [this, &cache](QueuedEvent & item) {
+			doDispatchQueuedEventCached(
+				cache,
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	// Processes all ready shards in the calling thread.
+	bool process()
+	{
+		return process(0);
+	}
+
+	// OPT-15: Visitor dispatch, see EventQueue::processQueueWith.
+	// Visitor protocol: visitor(event, args...)
+	// The visitor may be called from several workers concurrently, but never
+	// concurrently for the events in the same shard.
+	template <typename Visitor>
+	bool processQueueWith(const std::size_t workerIndex, Visitor && visitor)
+	{
+		return doProcessWorker(workerIndex, [this, &visitor](QueuedEvent & item) {
+			doVisitQueuedEvent(
+				visitor,
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	template <typename Visitor>
+	bool processQueueWith(Visitor && visitor)
+	{
+		return processQueueWith(0, std::forward<Visitor>(visitor));
+	}
+
+	void wait() const
+	{
+		while(! waitFor(std::chrono::hours(1))) {
+		}
+	}
+
+	// Returns true if there is any shard ready to be processed.
+	template <class Rep, class Period>
+	bool waitFor(const std::chrono::duration<Rep, Period> & duration) const
+	{
+		// OPT-8: Spin -> Yield -> Sleep, same as EventQueue::waitFor.
+		if(doCanProcess()) {
+			return true;
+		}
+
+		if(internal_::spinThenYield([this]() -> bool {
+			return doCanProcess();
+		})) {
+			return true;
+		}
+
+		// The fence pairs with the one in doNotifyQueueAvailable.
+		waitingConsumerCount.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		bool result;
+		{
+			std::unique_lock<Mutex> queueListLock(queueListMutex);
+			result = queueListConditionVariable.wait_for(queueListLock, duration, [this]() -> bool {
+				return doCanProcess();
+			});
+		}
+		waitingConsumerCount.fetch_sub(1, std::memory_order_relaxed);
+		return result;
+	}
+
+	using super::dispatch;
+
+	template <typename U>
+	auto dispatch(const U & queuedEvent)
+		-> typename std::enable_if<std::is_same<U, QueuedEvent>::value, void>::type
+	{
+		doDispatchQueuedEvent(
+			queuedEvent,
+			typename MakeIndexSequence<sizeof...(Args)>::Type()
+		);
+	}
+
+protected:
+	// Puts the events which are not processed, because a listener throws,
+	// back to the shard head, then reschedules or releases the shard.
+	// The events left in the batch are not counted as processed.
+	struct ShardReleaser
+	{
+		~ShardReleaser() {
+			queue->doReleaseShard(workerIndex, shardIndex, *batch, processedCount);
+		}
+
+		ParallelEventQueueBase * queue;
+		std::size_t workerIndex;
+		std::size_t shardIndex;
+		std::vector<QueuedEvent> * batch;
+		std::size_t processedCount;
+	};
+
+	template <typename F>
+	bool doProcessWorker(const std::size_t workerIndex, F && func)
+	{
+		if(readyShardCount.load(std::memory_order_acquire) == 0) {
+			return false;
+		}
+
+		// Bound the loop so a shard refilled by busy producers can't keep
+		// the worker here forever.
+		std::size_t shardBudget = ShardCount::value;
+		std::size_t shardIndex;
+		bool processed = false;
+		std::vector<QueuedEvent> batch;
+		while(shardBudget > 0 && doPopShard(workerIndex, &shardIndex)) {
+			--shardBudget;
+
+			{
+				std::lock_guard<Mutex> shardLock(shardList[shardIndex].mutex);
+				batch.swap(shardList[shardIndex].eventList);
+			}
+
+			ShardReleaser releaser { this, workerIndex, shardIndex, &batch, 0 };
+			for(QueuedEvent & item : batch) {
+				// Counted before dispatching, so an event whose listener throws
+				// is not dispatched again.
+				++releaser.processedCount;
+				func(item);
+			}
+			processed = processed || releaser.processedCount > 0;
+		}
+		return processed;
+	}
+
+	bool doPopShard(const std::size_t workerIndex, std::size_t * shardIndex)
+	{
+		for(std::size_t i = 0; i < workerCount; ++i) {
+			WorkerDeque & workerDeque = workerDequeList[(workerIndex + i) % workerCount];
+			if(workerDeque.size.load(std::memory_order_acquire) == 0) {
+				continue;
+			}
+
+			std::lock_guard<Mutex> dequeLock(workerDeque.mutex);
+			if(workerDeque.shardIndexList.empty()) {
+				continue;
+			}
+			// The owner takes the oldest shard, a thief takes the newest one.
+			if(i == 0) {
+				*shardIndex = workerDeque.shardIndexList.front();
+				workerDeque.shardIndexList.pop_front();
+			}
+			else {
+				*shardIndex = workerDeque.shardIndexList.back();
+				workerDeque.shardIndexList.pop_back();
+			}
+			workerDeque.size.fetch_sub(1, std::memory_order_relaxed);
+			readyShardCount.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+		return false;
+	}
+
+	void doReleaseShard(
+			const std::size_t workerIndex,
+			const std::size_t shardIndex,
+			std::vector<QueuedEvent> & batch,
+			const std::size_t processedCount
+		)
+	{
+		Shard & shard = shardList[shardIndex];
+		bool reschedule;
+		{
+			std::lock_guard<Mutex> shardLock(shard.mutex);
+			if(processedCount < batch.size()) {
+				shard.eventList.insert(
+					shard.eventList.begin(),
+					std::make_move_iterator(batch.begin() + processedCount),
+					std::make_move_iterator(batch.end())
+				);
+			}
+			batch.clear();
+			// Give the buffer back to the shard to reuse its capacity.
+			if(shard.eventList.empty()) {
+				shard.eventList.swap(batch);
+			}
+			reschedule = ! shard.eventList.empty();
+			shard.scheduled = reschedule;
+		}
+		pendingEventCount.fetch_sub(static_cast<int>(processedCount), std::memory_order_release);
+		if(reschedule) {
+			doScheduleShard(workerIndex, shardIndex);
+		}
+	}
+
+	void doScheduleShard(const std::size_t workerIndex, const std::size_t shardIndex)
+	{
+		WorkerDeque & workerDeque = workerDequeList[workerIndex];
+		{
+			std::lock_guard<Mutex> dequeLock(workerDeque.mutex);
+			workerDeque.shardIndexList.push_back(shardIndex);
+			workerDeque.size.fetch_add(1, std::memory_order_relaxed);
+		}
+		readyShardCount.fetch_add(1, std::memory_order_release);
+		doNotifyQueueAvailable();
+	}
+
+	bool doCanProcess() const
+	{
+		return readyShardCount.load(std::memory_order_acquire) > 0;
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEvent(T && item, IndexSequence<Indexes...>)
+	{
+		this->directDispatch(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEventCached(DispatchCache & cache, T && item, IndexSequence<Indexes...>)
+	{
+		this->doDirectDispatchCached(cache, item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename V, typename T, size_t ...Indexes>
+	void doVisitQueuedEvent(V && visitor, T && item, IndexSequence<Indexes...>)
+	{
+		visitor(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename T, size_t ...Indexes>
+	std::size_t doGetShardIndex(const T & item, IndexSequence<Indexes...>) const
+	{
+		return static_cast<std::size_t>(
+			ShardKey::shardKey(item.event, std::get<Indexes>(item.arguments)...)
+		) % ShardCount::value;
+	}
+
+	void doEnqueue(QueuedEvent && item)
+	{
+		const std::size_t shardIndex = doGetShardIndex(item, typename MakeIndexSequence<sizeof...(Args)>::Type());
+		Shard & shard = shardList[shardIndex];
+
+		pendingEventCount.fetch_add(1, std::memory_order_acq_rel);
+		bool schedule = false;
+		{
+			std::lock_guard<Mutex> shardLock(shard.mutex);
+			shard.eventList.push_back(std::move(item));
+			if(! shard.scheduled) {
+				shard.scheduled = true;
+				schedule = true;
+			}
+		}
+		if(schedule) {
+			doScheduleShard(shardIndex % workerCount, shardIndex);
+		}
+	}
+
+	void doNotifyQueueAvailable()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(waitingConsumerCount.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			queueListConditionVariable.notify_one();
+		}
+	}
+
+	static std::size_t doGetDefaultWorkerCount()
+	{
+		const std::size_t count = std::thread::hardware_concurrency();
+		return count > 0 ? count : 1;
+	}
+
+private:
+	std::array<Shard, ShardCount::value> shardList;
+	std::size_t workerCount;
+	std::unique_ptr<WorkerDeque[]> workerDequeList;
+	EVENTPP_ALIGN_CACHELINE typename Threading::template Atomic<int> pendingEventCount;
+	EVENTPP_ALIGN_CACHELINE typename Threading::template Atomic<int> readyShardCount;
+	mutable typename Threading::template Atomic<int> waitingConsumerCount;
+	mutable ConditionVariable queueListConditionVariable;
+	mutable Mutex queueListMutex;
+};
+
+} //namespace internal_
+
+template <
+	typename Event_,
+	typename Prototype_,
+	typename Policies_ = DefaultPolicies
+>
+class ParallelEventQueue : public internal_::InheritMixins<
+		internal_::ParallelEventQueueBase<Event_, Prototype_, Policies_>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type, public TagEventDispatcher, public TagEventQueue
+{
+private:
+	using super = typename internal_::InheritMixins<
+		internal_::ParallelEventQueueBase<Event_, Prototype_, Policies_>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type;
+
+public:
+	using super::super;
+};
+
+
+} //namespace eventpp
+
+
+#endif
@@ -0,0 +1,258 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REPLICATEDEVENTDISPATCHER_H_EVENTPP
+#define REPLICATEDEVENTDISPATCHER_H_EVENTPP
+
+#include "eventdispatcher.h"
+#include "internal/eventconstant_i.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// The master and the replicas are plain EventDispatchers, a mixin would
+// keep a separate state in each replica.
+template <typename Policies>
+struct ReplicaPolicies : public Policies
+{
+	using Mixins = MixinList<>;
+};
+
+} //namespace internal_
+
+// OPT-73: Read-mostly dispatcher for many cores. The listeners are added to
+// and removed from a master EventDispatcher, each of which bumps a version.
+// Each thread which dispatches holds its own sealed copy of the master,
+// made by the EventDispatcher copy constructor on that thread, so it's in
+// memory local to the thread. A dispatch compares the version of the copy
+// with the global version, which is a read of a shared cache line which
+// only changes when the listeners change, and copies the master again if
+// it's stale. Otherwise a dispatch touches only the copy of the thread.
+// The copy isn't replaced while it's dispatching on the thread, so a
+// listener which changes the listeners and dispatches again sees the
+// change after the outer dispatch returns.
+template <
+	typename Event_,
+	typename Prototype_,
+	typename Policies_ = DefaultPolicies
+>
+class ReplicatedEventDispatcher : public TagEventDispatcher
+{
+private:
+	using Dispatcher = EventDispatcher<Event_, Prototype_, internal_::ReplicaPolicies<Policies_> >;
+	using SharedMutex = typename Dispatcher::SharedMutex;
+
+	struct Replica
+	{
+		std::uint64_t version;
+		unsigned int depth;
+		std::unique_ptr<Dispatcher> dispatcher;
+		// Padded rather than aligned, so it can be allocated by new in C++14.
+		char padding[EVENTPP_CACHELINE_SIZE];
+	};
+
+	// The replica which the calling thread used last, so a thread which
+	// dispatches one dispatcher doesn't look up the registry.
+	struct ReplicaCache
+	{
+		std::uint64_t ownerId;
+		Replica * replica;
+	};
+
+	struct DepthGuard
+	{
+		explicit DepthGuard(Replica & replica) : replica(replica) {
+			++replica.depth;
+		}
+
+		~DepthGuard() {
+			--replica.depth;
+		}
+
+		Replica & replica;
+	};
+
+public:
+	using Handle = typename Dispatcher::Handle;
+	using Callback = typename Dispatcher::Callback;
+	using Event = typename Dispatcher::Event;
+
+public:
+	ReplicatedEventDispatcher()
+		:
+			master(),
+			masterMutex(),
+			version(1),
+			id(internal_::getNextDispatcherId()),
+			registryMutex(),
+			replicaMap()
+	{
+	}
+
+	// The replicas belong to the threads, so it can't be copied or moved.
+	ReplicatedEventDispatcher(const ReplicatedEventDispatcher &) = delete;
+	ReplicatedEventDispatcher & operator = (const ReplicatedEventDispatcher &) = delete;
+
+	Handle appendListener(const Event & event, const Callback & callback)
+	{
+		std::unique_lock<SharedMutex> lockGuard(masterMutex);
+		const Handle handle = master.appendListener(event, callback);
+		doBumpVersion();
+		return handle;
+	}
+
+	Handle prependListener(const Event & event, const Callback & callback)
+	{
+		std::unique_lock<SharedMutex> lockGuard(masterMutex);
+		const Handle handle = master.prependListener(event, callback);
+		doBumpVersion();
+		return handle;
+	}
+
+	Handle insertListener(const Event & event, const Callback & callback, const Handle & before)
+	{
+		std::unique_lock<SharedMutex> lockGuard(masterMutex);
+		const Handle handle = master.insertListener(event, callback, before);
+		doBumpVersion();
+		return handle;
+	}
+
+	bool removeListener(const Event & event, const Handle handle)
+	{
+		std::unique_lock<SharedMutex> lockGuard(masterMutex);
+		if(! master.removeListener(event, handle)) {
+			return false;
+		}
+		doBumpVersion();
+		return true;
+	}
+
+	bool hasAnyListener(const Event & event) const
+	{
+		std::shared_lock<SharedMutex> lockGuard(masterMutex);
+		return master.hasAnyListener(event);
+	}
+
+	bool ownsHandle(const Event & event, const Handle & handle) const
+	{
+		std::shared_lock<SharedMutex> lockGuard(masterMutex);
+		return master.ownsHandle(event, handle);
+	}
+
+	template <typename ...A>
+	void dispatch(A && ...args) const
+	{
+		Replica & replica = doGetReplica();
+		if(replica.depth == 0 && replica.version != version.load(std::memory_order_acquire)) {
+			doSync(replica);
+		}
+		DepthGuard depthGuard(replica);
+		replica.dispatcher->dispatch(std::forward<A>(args)...);
+	}
+
+	// Copies the master to the replica of the calling thread now, so the
+	// first dispatch after a change doesn't pay for the copy.
+	void sync() const
+	{
+		Replica & replica = doGetReplica();
+		if(replica.depth == 0 && replica.version != version.load(std::memory_order_acquire)) {
+			doSync(replica);
+		}
+	}
+
+	// Starts from 1, increased by each change of the listeners.
+	std::uint64_t getVersion() const
+	{
+		return version.load(std::memory_order_acquire);
+	}
+
+	// The count of the threads which have dispatched. A replica is freed
+	// with the dispatcher, not when its thread exits.
+	std::size_t getReplicaCount() const
+	{
+		std::lock_guard<std::mutex> lockGuard(registryMutex);
+		return replicaMap.size();
+	}
+
+private:
+	// Must be called under the unique lock of masterMutex.
+	void doBumpVersion()
+	{
+		version.fetch_add(1, std::memory_order_release);
+	}
+
+	Replica & doGetReplica() const
+	{
+		static thread_local ReplicaCache cache { 0, nullptr };
+		if(cache.ownerId == id) {
+			return *cache.replica;
+		}
+
+		Replica * replica;
+		{
+			std::lock_guard<std::mutex> lockGuard(registryMutex);
+			std::unique_ptr<Replica> & item = replicaMap[std::this_thread::get_id()];
+			if(! item) {
+				// Allocated by the thread which uses it.
+				item.reset(new Replica());
+				item->version = 0;
+				item->depth = 0;
+			}
+			replica = item.get();
+		}
+		cache.ownerId = id;
+		cache.replica = replica;
+		return *replica;
+	}
+
+	void doSync(Replica & replica) const
+	{
+		std::unique_ptr<Dispatcher> dispatcher;
+		std::uint64_t newVersion;
+		{
+			std::shared_lock<SharedMutex> lockGuard(masterMutex);
+			dispatcher.reset(new Dispatcher(master));
+			newVersion = version.load(std::memory_order_relaxed);
+		}
+		// A replica never gets a new event, so dispatch doesn't lock its map.
+		dispatcher->seal();
+		replica.dispatcher = std::move(dispatcher);
+		replica.version = newVersion;
+	}
+
+private:
+	Dispatcher master;
+	mutable SharedMutex masterMutex;
+	std::atomic<std::uint64_t> version;
+	// Never reused, so the cache of a destroyed dispatcher never matches.
+	const std::uint64_t id;
+
+	mutable std::mutex registryMutex;
+	mutable std::unordered_map<std::thread::id, std::unique_ptr<Replica> > replicaMap;
+};
+
+
+} //namespace eventpp
+
+
+#endif
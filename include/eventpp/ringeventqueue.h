@@ -0,0 +1,549 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RINGEVENTQUEUE_H_EVENTPP
+#define RINGEVENTQUEUE_H_EVENTPP
+
+#include "eventdispatcher.h"
+#include "internal/eventqueue_i.h"
+#include "internal/spinwait_i.h"
+#include "internal/ringbuffer_i.h"
+
+#include <tuple>
+#include <chrono>
+#include <thread>
+#include <type_traits>
+
+namespace eventpp {
+
+namespace internal_ {
+
+template <
+	typename EventType_,
+	typename Prototype_,
+	typename Policies_
+>
+class RingEventQueueBase;
+
+// OPT-17: EventQueue backed by a bounded lock-free ring buffer.
+// enqueue never takes a lock unless a consumer is sleeping in wait/waitFor,
+// or the ring is full and RingOverflow is RingOverflowBlock.
+template <
+	typename EventType_,
+	typename Policies_,
+	typename ReturnType, typename ...Args
+>
+class RingEventQueueBase <
+		EventType_,
+		ReturnType (Args...),
+		Policies_
+	> : public EventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		RingEventQueueBase <
+			EventType_,
+			ReturnType (Args...),
+			Policies_
+		>
+	>
+{
+private:
+	using super = EventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		RingEventQueueBase <
+			EventType_,
+			ReturnType (Args...),
+			Policies_
+		>
+	>;
+
+	using Policies = typename super::Policies;
+	using Threading = typename super::Threading;
+	using DispatchCache = typename super::DispatchCache;
+	using ConditionVariable = typename Threading::ConditionVariable;
+
+	using QueuedEventArgumentsType = std::tuple<typename std::decay<Args>::type...>;
+
+	struct QueuedEvent_
+	{
+		typename std::decay<typename super::Event>::type event;
+		QueuedEventArgumentsType arguments;
+
+		typename super::Event getEvent() const {
+			return event;
+		}
+
+		template <std::size_t N>
+		auto getArgument() const
+			-> typename std::tuple_element<N, std::tuple<Args...> >::type {
+			return std::get<N>(arguments);
+		}
+	};
+
+public:
+	using RingOverflow = typename SelectRingOverflow<Policies_, HasTypeRingOverflow<Policies_>::value>::Type;
+	using RingProducer = typename SelectRingProducer<Policies_, HasTypeRingProducer<Policies_>::value>::Type;
+	using RingCapacity = typename SelectRingCapacity<Policies_, HasTypeRingCapacity<Policies_>::value>::Type;
+
+private:
+	using Ring = RingBuffer<QueuedEvent_, RingProducer>;
+
+	static constexpr bool blockOnOverflow = std::is_same<RingOverflow, RingOverflowBlock>::value;
+
+public:
+	using QueuedEvent = QueuedEvent_;
+	using Event = typename super::Event;
+	using Handle = typename super::Handle;
+	using Callback = typename super::Callback;
+	using Mutex = typename super::Mutex;
+
+	struct DisableQueueNotify
+	{
+		DisableQueueNotify(RingEventQueueBase * queue)
+			: queue(queue)
+		{
+			++queue->queueNotifyCounter;
+		}
+
+		~DisableQueueNotify()
+		{
+			--queue->queueNotifyCounter;
+
+			if(queue->doCanNotifyQueueAvailable() && ! queue->emptyQueue()) {
+				std::lock_guard<Mutex> queueListLock(queue->queueListMutex);
+				queue->queueListConditionVariable.notify_one();
+			}
+		}
+
+		RingEventQueueBase * queue;
+	};
+
+public:
+	RingEventQueueBase()
+		:
+			super(),
+			ring(RingCapacity::value),
+			queueEmptyCounter(0),
+			queueNotifyCounter(0),
+			waitingConsumerCount(0),
+			waitingProducerCount(0),
+			droppedEventCount(0),
+			queueListConditionVariable(),
+			queueNotFullConditionVariable(),
+			queueListMutex()
+	{
+	}
+
+	// Same as EventQueue, only the listeners are copied or moved, the queued events are not.
+	RingEventQueueBase(const RingEventQueueBase & other)
+		: RingEventQueueBase()
+	{
+		super::operator = (other);
+	}
+
+	RingEventQueueBase(RingEventQueueBase && other) noexcept
+		: RingEventQueueBase()
+	{
+		super::operator = (std::move(other));
+	}
+
+	RingEventQueueBase & operator = (const RingEventQueueBase & other)
+	{
+		super::operator = (other);
+		return *this;
+	}
+
+	RingEventQueueBase & operator = (RingEventQueueBase && other) noexcept
+	{
+		super::operator = (std::move(other));
+		return *this;
+	}
+
+	// Returns true if the event is put in the queue.
+	template <typename ...A>
+	auto enqueue(A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), bool>::type
+	{
+		static_assert(super::ArgumentPassingMode::canIncludeEventType, "Enqueuing arguments count doesn't match required (Event type should be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, A...>::value>::Type;
+
+		return doEnqueue(QueuedEvent{
+			GetEvent::getEvent(args...),
+			QueuedEventArgumentsType(std::forward<A>(args)...)
+		});
+	}
+
+	template <typename T, typename ...A>
+	auto enqueue(T && first, A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), bool>::type
+	{
+		static_assert(super::ArgumentPassingMode::canExcludeEventType, "Enqueuing arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, T &&, A...>::value>::Type;
+
+		return doEnqueue(QueuedEvent{
+			GetEvent::getEvent(std::forward<T>(first), args...),
+			QueuedEventArgumentsType(std::forward<A>(args)...)
+		});
+	}
+
+	bool emptyQueue() const
+	{
+		return ring.empty() && (queueEmptyCounter.load(std::memory_order_acquire) == 0);
+	}
+
+	std::size_t getQueueCapacity() const
+	{
+		return ring.capacity();
+	}
+
+	// Events discarded by RingOverflowDropNewest or RingOverflowDropOldest.
+	std::size_t getDroppedEventCount() const
+	{
+		return droppedEventCount.load(std::memory_order_relaxed);
+	}
+
+	void clearEvents()
+	{
+		while(ring.tryPop([](QueuedEvent &) {})) {
+		}
+		doNotifyQueueNotFull();
+	}
+
+	// Only the events in the queue when process is called are dispatched,
+	// events enqueued during processing are left to the next call.
+	bool process()
+	{
+		// OPT-25: Consecutive events of the same type share one lookup.
+		DispatchCache cache;
+		return doProcessBatch([this, &cache](QueuedEvent & item) {
+			doDispatchQueuedEventCached(
+				cache,
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	bool processOne()
+	{
+		CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+		const bool processed = doPop([this](QueuedEvent & item) {
+			doDispatchQueuedEvent(
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+		if(processed) {
+			doNotifyQueueNotFull();
+		}
+		return processed;
+	}
+
+	// OPT-15: Zero-overhead visitor dispatch, see EventQueue::processQueueWith.
+	// Visitor protocol: visitor(event, args...)
+	template <typename Visitor>
+	bool processQueueWith(Visitor && visitor)
+	{
+		return doProcessBatch([this, &visitor](QueuedEvent & item) {
+			doVisitQueuedEvent(
+				visitor,
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	// OPT-15: Single-event variant of processQueueWith.
+	template <typename Visitor>
+	bool processOneWith(Visitor && visitor)
+	{
+		CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+		const bool processed = doPop([this, &visitor](QueuedEvent & item) {
+			doVisitQueuedEvent(
+				visitor,
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+		if(processed) {
+			doNotifyQueueNotFull();
+		}
+		return processed;
+	}
+
+	void wait() const
+	{
+		while(! waitFor(std::chrono::hours(1))) {
+		}
+	}
+
+	template <class Rep, class Period>
+	bool waitFor(const std::chrono::duration<Rep, Period> & duration) const
+	{
+		// OPT-8: Spin -> Yield -> Sleep, same as EventQueue::waitFor.
+		if(doCanProcess()) {
+			return true;
+		}
+
+		if(internal_::spinThenYield([this]() -> bool {
+			return doCanProcess();
+		})) {
+			return true;
+		}
+
+		// Producers only take queueListMutex to notify when waitingConsumerCount
+		// is not zero. The fence pairs with the one in doNotifyQueueAvailable.
+		waitingConsumerCount.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		bool result;
+		{
+			std::unique_lock<Mutex> queueListLock(queueListMutex);
+			result = queueListConditionVariable.wait_for(queueListLock, duration, [this]() -> bool {
+				return doCanProcess();
+			});
+		}
+		waitingConsumerCount.fetch_sub(1, std::memory_order_relaxed);
+		return result;
+	}
+
+	using super::dispatch;
+
+	template <typename U>
+	auto dispatch(const U & queuedEvent)
+		-> typename std::enable_if<std::is_same<U, QueuedEvent>::value, void>::type
+	{
+		doDispatchQueuedEvent(
+			queuedEvent,
+			typename MakeIndexSequence<sizeof...(Args)>::Type()
+		);
+	}
+
+	bool takeEvent(QueuedEvent * queuedEvent)
+	{
+		const bool taken = ring.tryPop([queuedEvent](QueuedEvent & item) {
+			*queuedEvent = std::move(item);
+		});
+		if(taken) {
+			doNotifyQueueNotFull();
+		}
+		return taken;
+	}
+
+protected:
+	template <typename F>
+	bool doProcessBatch(F && func)
+	{
+		if(ring.empty()) {
+			return false;
+		}
+
+		CounterGuard<decltype(queueEmptyCounter)> counterGuard(queueEmptyCounter);
+
+		// Bound the batch so busy producers can't keep the consumer here forever.
+		std::size_t count = ring.size();
+		bool processed = false;
+		while(count > 0 && doPop(func)) {
+			processed = true;
+			--count;
+			// Wake blocked producers once a chunk of slots is free, not per event.
+			if(blockOnOverflow && (count & 63) == 0 && waitingProducerCount.load(std::memory_order_relaxed) > 0) {
+				doNotifyQueueNotFull();
+			}
+		}
+
+		if(processed) {
+			doNotifyQueueNotFull();
+		}
+		return processed;
+	}
+
+	// With RingOverflowBlock a listener which enqueues to the full ring
+	// would wait for the slot it's dispatched from, so the event is moved
+	// out and its slot is freed before the listeners are called.
+	template <typename F>
+	bool doPop(F && func)
+	{
+		return doPop(std::forward<F>(func), std::integral_constant<bool, blockOnOverflow>());
+	}
+
+	template <typename F>
+	bool doPop(F && func, std::false_type)
+	{
+		return ring.tryPop(std::forward<F>(func));
+	}
+
+	template <typename F>
+	bool doPop(F && func, std::true_type)
+	{
+		return ring.tryPopReleased(std::forward<F>(func));
+	}
+
+	bool doCanProcess() const
+	{
+		return ! emptyQueue() && doCanNotifyQueueAvailable();
+	}
+
+	bool doCanNotifyQueueAvailable() const
+	{
+		return queueNotifyCounter.load(std::memory_order_acquire) == 0;
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEvent(T && item, IndexSequence<Indexes...>)
+	{
+		this->directDispatch(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEventCached(DispatchCache & cache, T && item, IndexSequence<Indexes...>)
+	{
+		this->doDirectDispatchCached(cache, item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename V, typename T, size_t ...Indexes>
+	void doVisitQueuedEvent(V && visitor, T && item, IndexSequence<Indexes...>)
+	{
+		visitor(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	bool doEnqueue(QueuedEvent && item)
+	{
+		const bool queued = doPush(std::move(item), RingOverflow());
+		if(queued) {
+			doNotifyQueueAvailable();
+		}
+		return queued;
+	}
+
+	bool doPush(QueuedEvent && item, RingOverflowReturnFalse)
+	{
+		return ring.tryPush(std::move(item));
+	}
+
+	bool doPush(QueuedEvent && item, RingOverflowDropNewest)
+	{
+		if(ring.tryPush(std::move(item))) {
+			return true;
+		}
+		droppedEventCount.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	bool doPush(QueuedEvent && item, RingOverflowDropOldest)
+	{
+		while(! ring.tryPush(std::move(item))) {
+			if(ring.tryPop([](QueuedEvent &) {})) {
+				droppedEventCount.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+		return true;
+	}
+
+	bool doPush(QueuedEvent && item, RingOverflowBlock)
+	{
+		if(ring.tryPush(std::move(item))) {
+			return true;
+		}
+
+		if(internal_::spinThenYield([this, &item]() -> bool {
+			return ring.tryPush(std::move(item));
+		})) {
+			return true;
+		}
+
+		for(;;) {
+			if(ring.tryPush(std::move(item))) {
+				return true;
+			}
+
+			// The fence pairs with the one in doNotifyQueueNotFull. Either the
+			// predicate sees the slot a consumer freed, or the consumer sees
+			// waitingProducerCount and notifies under queueListMutex.
+			waitingProducerCount.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			{
+				std::unique_lock<Mutex> queueListLock(queueListMutex);
+				queueNotFullConditionVariable.wait(queueListLock, [this]() -> bool {
+					return ! ring.full();
+				});
+			}
+			waitingProducerCount.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+	void doNotifyQueueAvailable()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(waitingConsumerCount.load(std::memory_order_relaxed) > 0 && doCanNotifyQueueAvailable()) {
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			queueListConditionVariable.notify_one();
+		}
+	}
+
+	void doNotifyQueueNotFull()
+	{
+		if(! blockOnOverflow) {
+			return;
+		}
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(waitingProducerCount.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			queueNotFullConditionVariable.notify_all();
+		}
+	}
+
+private:
+	Ring ring;
+	typename Threading::template Atomic<int> queueEmptyCounter;
+	typename Threading::template Atomic<int> queueNotifyCounter;
+	EVENTPP_ALIGN_CACHELINE mutable typename Threading::template Atomic<int> waitingConsumerCount;
+	typename Threading::template Atomic<int> waitingProducerCount;
+	typename Threading::template Atomic<std::size_t> droppedEventCount;
+	EVENTPP_ALIGN_CACHELINE mutable ConditionVariable queueListConditionVariable;
+	ConditionVariable queueNotFullConditionVariable;
+	mutable Mutex queueListMutex;
+};
+
+} //namespace internal_
+
+template <
+	typename Event_,
+	typename Prototype_,
+	typename Policies_ = DefaultPolicies
+>
+class RingEventQueue : public internal_::InheritMixins<
+		internal_::RingEventQueueBase<Event_, Prototype_, Policies_>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type, public TagEventDispatcher, public TagEventQueue
+{
+private:
+	using super = typename internal_::InheritMixins<
+		internal_::RingEventQueueBase<Event_, Prototype_, Policies_>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type;
+
+public:
+	using super::super;
+};
+
+
+} //namespace eventpp
+
+
+#endif
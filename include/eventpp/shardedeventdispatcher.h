@@ -0,0 +1,290 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHARDEDEVENTDISPATCHER_H_EVENTPP
+#define SHARDEDEVENTDISPATCHER_H_EVENTPP
+
+#include "eventdispatcher.h"
+
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// The shards are plain EventDispatchers, the mixins are called once by
+// ShardedEventDispatcher.
+template <typename Policies>
+struct ShardPolicies : public Policies
+{
+	using Mixins = MixinList<>;
+};
+
+template <
+	typename EventType_,
+	typename Prototype_,
+	typename Policies_,
+	std::size_t shardCount,
+	typename MixinRoot_
+>
+class ShardedEventDispatcherBase;
+
+// OPT-63: The events are partitioned by their hash into shardCount shards.
+// Each shard is an EventDispatcher, with its own map and listenerMutex, on
+// its own cache lines. appendListener locks only the shard of the event,
+// so adding and removing the listeners of different events don't block
+// each other, and don't block the dispatching of the other shards.
+template <
+	typename EventType_,
+	typename Policies_,
+	std::size_t shardCount,
+	typename MixinRoot_,
+	typename ReturnType, typename ...Args
+>
+class ShardedEventDispatcherBase <
+	EventType_,
+	ReturnType (Args...),
+	Policies_,
+	shardCount,
+	MixinRoot_
+>
+{
+protected:
+	using ThisType = ShardedEventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		shardCount,
+		MixinRoot_
+	>;
+	using MixinRoot = typename std::conditional<
+		std::is_same<MixinRoot_, void>::value,
+		ThisType,
+		MixinRoot_
+	>::type;
+	using Policies = Policies_;
+
+	using Threading = typename SelectThreading<Policies_, HasTypeThreading<Policies_>::value>::Type;
+
+	using ArgumentPassingMode = typename SelectArgumentPassingMode<
+		Policies_,
+		HasTypeArgumentPassingMode<Policies_>::value,
+		ArgumentPassingAutoDetect
+	>::Type;
+
+	using Prototype = ReturnType (Args...);
+
+	using Mixins = typename internal_::SelectMixins<
+		Policies_,
+		internal_::HasTypeMixins<Policies_>::value
+	>::Type;
+
+	using DoMixinBeforeDispatch = DispatcherMixinBeforeDispatch<EventType_>;
+	using DoMixinAfterDispatch = DispatcherMixinAfterDispatch<EventType_>;
+
+	using ShardDispatcher = EventDispatcher<EventType_, Prototype, ShardPolicies<Policies_> >;
+	// OPT-47: NoListenerGroup with ListenerGroupsNone, see ListenerGroups.
+	using ListenerGroup_ = typename SelectListenerGroup<Policies_>::Group;
+
+	struct EVENTPP_ALIGN_CACHELINE Shard
+	{
+		ShardDispatcher dispatcher;
+	};
+
+	static_assert(shardCount > 0, "ShardedEventDispatcher: shardCount must not be 0.");
+	static_assert(HasHash<EventType_>::value, "ShardedEventDispatcher: the event type must have std::hash.");
+
+public:
+	using Handle = typename ShardDispatcher::Handle;
+	using Callback = typename ShardDispatcher::Callback;
+	using Event = EventType_;
+	using Mutex = typename Threading::Mutex;
+	using SharedMutex = typename Threading::SharedMutex;
+
+public:
+	ShardedEventDispatcherBase()
+		: shardList()
+	{
+	}
+
+	void swap(ShardedEventDispatcherBase & other) noexcept {
+		for(std::size_t i = 0; i < shardCount; ++i) {
+			shardList[i].dispatcher.swap(other.shardList[i].dispatcher);
+		}
+	}
+
+	Handle appendListener(const Event & event, const Callback & callback)
+	{
+		return doGetShard(event).appendListener(event, callback);
+	}
+
+	Handle prependListener(const Event & event, const Callback & callback)
+	{
+		return doGetShard(event).prependListener(event, callback);
+	}
+
+	Handle insertListener(const Event & event, const Callback & callback, const Handle & before)
+	{
+		return doGetShard(event).insertListener(event, callback, before);
+	}
+
+	Handle appendListener(const Event & event, const Callback & callback, ListenerGroup_ & group)
+	{
+		return doGetShard(event).appendListener(event, callback, group);
+	}
+
+	Handle prependListener(const Event & event, const Callback & callback, ListenerGroup_ & group)
+	{
+		return doGetShard(event).prependListener(event, callback, group);
+	}
+
+	Handle insertListener(const Event & event, const Callback & callback, const Handle & before, ListenerGroup_ & group)
+	{
+		return doGetShard(event).insertListener(event, callback, before, group);
+	}
+
+	// Seals every shard, see EventDispatcher::seal.
+	void seal()
+	{
+		for(Shard & shard : shardList) {
+			shard.dispatcher.seal();
+		}
+	}
+
+	bool isSealed() const
+	{
+		return shardList[shardCount - 1].dispatcher.isSealed();
+	}
+
+	bool removeListener(const Event & event, const Handle handle)
+	{
+		return doGetShard(event).removeListener(event, handle);
+	}
+
+	bool hasAnyListener(const Event & event) const
+	{
+		return doGetShard(event).hasAnyListener(event);
+	}
+
+	bool ownsHandle(const Event & event, const Handle & handle) const
+	{
+		return doGetShard(event).ownsHandle(event, handle);
+	}
+
+	template <typename Func>
+	void forEach(const Event & event, Func && func) const
+	{
+		doGetShard(event).forEach(event, std::forward<Func>(func));
+	}
+
+	template <typename Func>
+	bool forEachIf(const Event & event, Func && func) const
+	{
+		return doGetShard(event).forEachIf(event, std::forward<Func>(func));
+	}
+
+	void dispatch(Args ...args) const
+	{
+		static_assert(ArgumentPassingMode::canIncludeEventType, "Dispatching arguments count doesn't match required (Event type should be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, Args...>::value>::Type;
+
+		directDispatch(
+			GetEvent::getEvent(args...),
+			std::forward<Args>(args)...
+		);
+	}
+
+	template <typename T>
+	void dispatch(T && first, Args ...args) const
+	{
+		static_assert(ArgumentPassingMode::canExcludeEventType, "Dispatching arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, T &&, Args...>::value>::Type;
+
+		directDispatch(
+			GetEvent::getEvent(std::forward<T>(first), args...),
+			std::forward<Args>(args)...
+		);
+	}
+
+	// Bypass any getEvent policy. The first argument is the event type.
+	void directDispatch(const Event & e, Args ...args) const
+	{
+		int passedMixinCount = 0;
+		if(internal_::ForEachMixins<MixinRoot, Mixins, DoMixinBeforeDispatch>::forEach(
+			this, passedMixinCount, e, typename std::add_lvalue_reference<Args>::type(args)...)) {
+			doGetShard(e).directDispatch(e, std::forward<Args>(args)...);
+		}
+		internal_::ForEachMixins<MixinRoot, Mixins, DoMixinAfterDispatch>::forEach(this, passedMixinCount, e);
+	}
+
+private:
+	static std::size_t doGetShardIndex(const Event & e)
+	{
+		std::size_t hash = std::hash<Event>()(e);
+		// Some hashes leave the low bits the same, such as the pointers.
+		hash ^= hash >> 17;
+		return hash % shardCount;
+	}
+
+	ShardDispatcher & doGetShard(const Event & e)
+	{
+		return shardList[doGetShardIndex(e)].dispatcher;
+	}
+
+	const ShardDispatcher & doGetShard(const Event & e) const
+	{
+		return shardList[doGetShardIndex(e)].dispatcher;
+	}
+
+private:
+	Shard shardList[shardCount];
+};
+
+
+} //namespace internal_
+
+template <
+	typename Event_,
+	typename Prototype_,
+	typename Policies_ = DefaultPolicies,
+	std::size_t shardCount = 16
+>
+class ShardedEventDispatcher : public internal_::InheritMixins<
+		internal_::ShardedEventDispatcherBase<Event_, Prototype_, Policies_, shardCount, void>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type, public TagEventDispatcher
+{
+private:
+	using super = typename internal_::InheritMixins<
+		internal_::ShardedEventDispatcherBase<Event_, Prototype_, Policies_, shardCount, void>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type;
+
+public:
+	using super::super;
+
+	friend void swap(ShardedEventDispatcher & first, ShardedEventDispatcher & second) noexcept {
+		first.swap(second);
+	}
+};
+
+
+} //namespace eventpp
+
+
+#endif
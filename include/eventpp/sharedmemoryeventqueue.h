@@ -0,0 +1,372 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHAREDMEMORYEVENTQUEUE_H_EVENTPP
+#define SHAREDMEMORYEVENTQUEUE_H_EVENTPP
+
+#if ! defined(__unix__) && ! defined(__unix) && ! defined(__APPLE__)
+	#error "SharedMemoryEventQueue requires a POSIX system."
+#endif
+
+#include "eventdispatcher.h"
+#include "internal/eventqueue_i.h"
+#include "internal/spinwait_i.h"
+#include "internal/sharedmemoryring_i.h"
+
+#include <chrono>
+#include <thread>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace eventpp {
+
+namespace internal_ {
+
+template <
+	typename EventType_,
+	typename Prototype_,
+	typename Policies_
+>
+class SharedMemoryEventQueueBase;
+
+// OPT-32: EventQueue whose events are in a ring in shared memory.
+// Each process attaches its own queue object to the same region, and has
+// its own listeners. The event and the arguments must be trivially copyable,
+// they are copied into the region once by enqueue, and dispatched in place.
+template <
+	typename EventType_,
+	typename Policies_,
+	typename ReturnType, typename ...Args
+>
+class SharedMemoryEventQueueBase <
+		EventType_,
+		ReturnType (Args...),
+		Policies_
+	> : public EventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		SharedMemoryEventQueueBase <
+			EventType_,
+			ReturnType (Args...),
+			Policies_
+		>
+	>
+{
+private:
+	using super = EventDispatcherBase<
+		EventType_,
+		ReturnType (Args...),
+		Policies_,
+		SharedMemoryEventQueueBase <
+			EventType_,
+			ReturnType (Args...),
+			Policies_
+		>
+	>;
+
+	using Policies = typename super::Policies;
+	using DispatchCache = typename super::DispatchCache;
+
+	using QueuedEventArgumentsType = TrivialTuple<typename std::decay<Args>::type...>;
+
+	struct QueuedEvent_
+	{
+		typename std::decay<typename super::Event>::type event;
+		QueuedEventArgumentsType arguments;
+
+		typename super::Event getEvent() const {
+			return event;
+		}
+
+		template <std::size_t N>
+		auto getArgument() const
+			-> typename std::tuple_element<N, std::tuple<Args...> >::type {
+			return TrivialTupleGetter<N>::get(arguments);
+		}
+	};
+
+	static_assert(AllTriviallyCopyable<typename std::decay<typename super::Event>::type, typename std::decay<Args>::type...>::value,
+		"SharedMemoryEventQueue: the event and the arguments must be trivially copyable.");
+
+	using Ring = SharedMemoryRing<QueuedEvent_>;
+
+public:
+	using QueuedEvent = QueuedEvent_;
+	using Event = typename super::Event;
+	using Handle = typename super::Handle;
+	using Callback = typename super::Callback;
+	using Mutex = typename super::Mutex;
+
+public:
+	// Opens the POSIX shared memory object name, creates it if it doesn't exist.
+	// The first queue which opens it sizes it for capacity events, rounded up
+	// to a power of two. The others use the existing capacity.
+	SharedMemoryEventQueueBase(const char * name, const std::size_t capacity)
+		: super(), ring()
+	{
+		const int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+		if(fd >= 0) {
+			ring.open(fd, capacity);
+			close(fd);
+		}
+	}
+
+	// Maps the shared memory fd, such as from memfd_create, or inherited from
+	// the parent process. fd is not closed, it can be closed after this.
+	SharedMemoryEventQueueBase(const int fd, const std::size_t capacity)
+		: super(), ring()
+	{
+		ring.open(fd, capacity);
+	}
+
+	// The region is shared by the processes, a copy would be another view of
+	// it, so the queue can't be copied or moved.
+	SharedMemoryEventQueueBase(const SharedMemoryEventQueueBase &) = delete;
+	SharedMemoryEventQueueBase & operator = (const SharedMemoryEventQueueBase &) = delete;
+
+	// Removes the name of a shared memory object. The processes which have it
+	// open keep using it, the memory is freed when the last one closes it.
+	static bool unlink(const char * name)
+	{
+		return shm_unlink(name) == 0;
+	}
+
+	// The size of the shared memory for capacity events.
+	static std::size_t getMemorySize(const std::size_t capacity)
+	{
+		return Ring::getMemorySize(capacity);
+	}
+
+	// False if the shared memory can't be opened or mapped, or it's created
+	// by a queue of different types. No other function can be called then.
+	bool isOpen() const
+	{
+		return ring.isOpen();
+	}
+
+	// Returns false if the queue is full.
+	template <typename ...A>
+	auto enqueue(A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), bool>::type
+	{
+		static_assert(super::ArgumentPassingMode::canIncludeEventType, "Enqueuing arguments count doesn't match required (Event type should be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, A...>::value>::Type;
+
+		return doEnqueue(QueuedEvent{
+			GetEvent::getEvent(args...),
+			QueuedEventArgumentsType(std::forward<A>(args)...)
+		});
+	}
+
+	template <typename T, typename ...A>
+	auto enqueue(T && first, A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), bool>::type
+	{
+		static_assert(super::ArgumentPassingMode::canExcludeEventType, "Enqueuing arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename SelectGetEvent<Policies_, EventType_, HasFunctionGetEvent<Policies_, T &&, A...>::value>::Type;
+
+		return doEnqueue(QueuedEvent{
+			GetEvent::getEvent(std::forward<T>(first), args...),
+			QueuedEventArgumentsType(std::forward<A>(args)...)
+		});
+	}
+
+	// True if no process has queued events, it's approximate as other
+	// processes may enqueue or process at the same time.
+	bool emptyQueue() const
+	{
+		return ring.empty();
+	}
+
+	std::size_t getQueueCapacity() const
+	{
+		return ring.capacity();
+	}
+
+	void clearEvents()
+	{
+		while(ring.tryPop([](QueuedEvent &) {})) {
+		}
+	}
+
+	// Only the events in the queue when process is called are dispatched.
+	bool process()
+	{
+		// OPT-25: Consecutive events of the same type share one lookup.
+		DispatchCache cache;
+		return doProcessBatch([this, &cache](QueuedEvent & item) {
+			doDispatchQueuedEventCached(
+				cache,
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	bool processOne()
+	{
+		return ring.tryPop([this](QueuedEvent & item) {
+			doDispatchQueuedEvent(
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	// OPT-15: Zero-overhead visitor dispatch, see EventQueue::processQueueWith.
+	// Visitor protocol: visitor(event, args...), the arguments are references
+	// into the shared memory.
+	template <typename Visitor>
+	bool processQueueWith(Visitor && visitor)
+	{
+		return doProcessBatch([this, &visitor](QueuedEvent & item) {
+			doVisitQueuedEvent(
+				visitor,
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	template <typename Visitor>
+	bool processOneWith(Visitor && visitor)
+	{
+		return ring.tryPop([this, &visitor](QueuedEvent & item) {
+			doVisitQueuedEvent(
+				visitor,
+				item,
+				typename MakeIndexSequence<sizeof...(Args)>::Type()
+			);
+		});
+	}
+
+	void wait()
+	{
+		while(! waitFor(std::chrono::hours(1))) {
+		}
+	}
+
+	// OPT-8: Spin -> Yield -> Sleep, same as EventQueue::waitFor. The sleep
+	// is a futex wait in the shared memory, so any process can wake it.
+	template <class Rep, class Period>
+	bool waitFor(const std::chrono::duration<Rep, Period> & duration)
+	{
+		if(! ring.empty()) {
+			return true;
+		}
+
+		if(internal_::spinThenYield([this]() -> bool {
+			return ! ring.empty();
+		})) {
+			return true;
+		}
+
+		return ring.waitFor(duration);
+	}
+
+	using super::dispatch;
+
+	template <typename U>
+	auto dispatch(const U & queuedEvent)
+		-> typename std::enable_if<std::is_same<U, QueuedEvent>::value, void>::type
+	{
+		doDispatchQueuedEvent(
+			queuedEvent,
+			typename MakeIndexSequence<sizeof...(Args)>::Type()
+		);
+	}
+
+	bool takeEvent(QueuedEvent * queuedEvent)
+	{
+		return ring.tryPop([queuedEvent](QueuedEvent & item) {
+			*queuedEvent = item;
+		});
+	}
+
+protected:
+	template <typename F>
+	bool doProcessBatch(F && func)
+	{
+		// Bound the batch so busy producers can't keep the consumer here forever.
+		std::size_t count = ring.size();
+		bool processed = false;
+		while(count > 0 && ring.tryPop(func)) {
+			processed = true;
+			--count;
+		}
+		return processed;
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEvent(T && item, IndexSequence<Indexes...>)
+	{
+		this->directDispatch(item.event, TrivialTupleGetter<Indexes>::get(item.arguments)...);
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEventCached(DispatchCache & cache, T && item, IndexSequence<Indexes...>)
+	{
+		this->doDirectDispatchCached(cache, item.event, TrivialTupleGetter<Indexes>::get(item.arguments)...);
+	}
+
+	template <typename V, typename T, size_t ...Indexes>
+	void doVisitQueuedEvent(V && visitor, T && item, IndexSequence<Indexes...>)
+	{
+		visitor(item.event, TrivialTupleGetter<Indexes>::get(item.arguments)...);
+	}
+
+	bool doEnqueue(const QueuedEvent & item)
+	{
+		if(! ring.tryPush(item)) {
+			return false;
+		}
+		ring.notify();
+		return true;
+	}
+
+private:
+	Ring ring;
+};
+
+} //namespace internal_
+
+template <
+	typename Event_,
+	typename Prototype_,
+	typename Policies_ = DefaultPolicies
+>
+class SharedMemoryEventQueue : public internal_::InheritMixins<
+		internal_::SharedMemoryEventQueueBase<Event_, Prototype_, Policies_>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type, public TagEventDispatcher, public TagEventQueue
+{
+private:
+	using super = typename internal_::InheritMixins<
+		internal_::SharedMemoryEventQueueBase<Event_, Prototype_, Policies_>,
+		typename internal_::SelectMixins<Policies_, internal_::HasTypeMixins<Policies_>::value >::Type
+	>::Type;
+
+public:
+	using super::super;
+};
+
+
+} //namespace eventpp
+
+
+#endif
+
@@ -0,0 +1,225 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STATICEVENTDISPATCHER_H_EVENTPP
+#define STATICEVENTDISPATCHER_H_EVENTPP
+
+#include "eventpolicies.h"
+
+#include <type_traits>
+#include <utility>
+
+namespace eventpp {
+
+// OPT-24: Dispatcher whose listeners are bound at compile time.
+// There is no map, no CallbackList and no std::function. dispatch compares
+// the event with each bound event, the same code as a hand written switch,
+// and calls the handlers directly, so they can be inlined.
+
+struct TagStaticBinding {};
+
+// Binds the handlers of the same type, which are usually function pointers,
+// to event. Works in C++14.
+//   eventpp::BindingOf<int, 1, void (*)(int), &onOne, &onOneAgain>
+template <typename Event, Event event_, typename Handler, Handler ...handlers>
+struct BindingOf : public TagStaticBinding
+{
+	static constexpr Event event = event_;
+
+	template <typename ...A>
+	static void invoke(A & ...args) {
+		// Don't std::forward, the arguments are passed to more than one handler.
+		int dummy[] = { 0, ((void)handlers(args...), 0)... };
+		(void)dummy;
+	}
+};
+
+template <typename Event, Event event_, typename Handler, Handler ...handlers>
+constexpr Event BindingOf<Event, event_, Handler, handlers...>::event;
+
+#if defined(__cpp_nontype_template_parameter_auto)
+// C++17, the handlers can have different types.
+//   eventpp::Binding<1, &onOne, &onOneAgain>
+template <auto event_, auto ...handlers>
+struct Binding : public TagStaticBinding
+{
+	static constexpr auto event = event_;
+
+	template <typename ...A>
+	static void invoke(A & ...args) {
+		((void)handlers(args...), ...);
+	}
+};
+#endif
+
+namespace internal_ {
+
+template <typename T>
+using IsStaticBinding = std::is_base_of<TagStaticBinding, T>;
+
+// The item which is not a binding is the policies.
+template <typename ...Items>
+struct SelectStaticPolicies
+{
+	using Type = DefaultPolicies;
+};
+
+template <typename T, typename ...Items>
+struct SelectStaticPolicies <T, Items...>
+{
+	using Type = typename std::conditional<
+		IsStaticBinding<T>::value,
+		typename SelectStaticPolicies<Items...>::Type,
+		T
+	>::type;
+};
+
+template <typename ...Items>
+struct StaticDispatchHelper
+{
+	template <typename E, typename ...A>
+	static void dispatch(const E & /*e*/, A & ... /*args*/) {
+	}
+
+	template <typename E>
+	static constexpr bool hasBinding(const E & /*e*/) {
+		return false;
+	}
+};
+
+template <typename T, typename ...Items>
+struct StaticDispatchHelper <T, Items...>
+{
+	template <typename E, typename ...A>
+	static void dispatch(const E & e, A & ...args) {
+		doDispatch<T>(e, args...);
+		StaticDispatchHelper<Items...>::dispatch(e, args...);
+	}
+
+	template <typename E>
+	static constexpr bool hasBinding(const E & e) {
+		return doHasBinding<T>(e) || StaticDispatchHelper<Items...>::hasBinding(e);
+	}
+
+private:
+	template <typename U, typename E, typename ...A>
+	static auto doDispatch(const E & e, A & ...args)
+		-> typename std::enable_if<IsStaticBinding<U>::value>::type {
+		if(e == U::event) {
+			U::invoke(args...);
+		}
+	}
+
+	template <typename U, typename E, typename ...A>
+	static auto doDispatch(const E & /*e*/, A & ... /*args*/)
+		-> typename std::enable_if<! IsStaticBinding<U>::value>::type {
+	}
+
+	template <typename U, typename E>
+	static constexpr auto doHasBinding(const E & e)
+		-> typename std::enable_if<IsStaticBinding<U>::value, bool>::type {
+		return e == U::event;
+	}
+
+	template <typename U, typename E>
+	static constexpr auto doHasBinding(const E & /*e*/)
+		-> typename std::enable_if<! IsStaticBinding<U>::value, bool>::type {
+		return false;
+	}
+};
+
+} //namespace internal_
+
+// Items are the bindings, and optionally one policies class at any position.
+// Only the policies ArgumentPassingMode and getEvent are used.
+// More than one binding can have the same event, the handlers are called in
+// the order of the bindings.
+template <
+	typename Event_,
+	typename Prototype_,
+	typename ...Items
+>
+class StaticEventDispatcher;
+
+template <
+	typename Event_,
+	typename ReturnType, typename ...Args,
+	typename ...Items
+>
+class StaticEventDispatcher <
+	Event_,
+	ReturnType (Args...),
+	Items...
+> : public TagEventDispatcher
+{
+private:
+	using Policies = typename internal_::SelectStaticPolicies<Items...>::Type;
+
+	using ArgumentPassingMode = typename internal_::SelectArgumentPassingMode<
+		Policies,
+		internal_::HasTypeArgumentPassingMode<Policies>::value,
+		ArgumentPassingAutoDetect
+	>::Type;
+
+	using DispatchHelper = internal_::StaticDispatchHelper<Items...>;
+
+public:
+	using Event = Event_;
+	using Prototype = ReturnType (Args...);
+
+public:
+	static void dispatch(Args ...args)
+	{
+		static_assert(ArgumentPassingMode::canIncludeEventType, "Dispatching arguments count doesn't match required (Event type should be included).");
+
+		using GetEvent = typename internal_::SelectGetEvent<Policies, Event_, internal_::HasFunctionGetEvent<Policies, Args...>::value>::Type;
+
+		directDispatch(GetEvent::getEvent(args...), args...);
+	}
+
+	template <typename T>
+	static void dispatch(T && first, Args ...args)
+	{
+		static_assert(ArgumentPassingMode::canExcludeEventType, "Dispatching arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename internal_::SelectGetEvent<Policies, Event_, internal_::HasFunctionGetEvent<Policies, T &&, Args...>::value>::Type;
+
+		directDispatch(GetEvent::getEvent(std::forward<T>(first), args...), args...);
+	}
+
+	// Bypass any getEvent policy. The first argument is the event type.
+	static void directDispatch(const Event & e, Args ...args)
+	{
+		DispatchHelper::dispatch(e, args...);
+	}
+
+	// The visitor of EventQueue::processQueueWith, so
+	// queue.processQueueWith(StaticEventDispatcher<...>()) dispatches the
+	// queued events to the bound handlers.
+	void operator() (const Event & e, Args ...args) const
+	{
+		directDispatch(e, args...);
+	}
+
+	static constexpr bool hasAnyListener(const Event & e)
+	{
+		return DispatchHelper::hasBinding(e);
+	}
+};
+
+
+} //namespace eventpp
+
+
+#endif
+
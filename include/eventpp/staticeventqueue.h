@@ -0,0 +1,622 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STATICEVENTQUEUE_H_EVENTPP
+#define STATICEVENTQUEUE_H_EVENTPP
+
+#include "eventpolicies.h"
+#include "internal/eventqueue_i.h"
+#include "utilities/inplacefunction.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace eventpp {
+
+// OPT-58: An event queue which never allocates memory. The queued events,
+// the listeners, and the map from the events to their listeners are arrays
+// in the object, sized by the template parameters, so a queue defined as a
+// global or in a task's stack doesn't call operator new at all.
+// enqueue returns false when the queue is full, and appendListener returns
+// an empty handle when there are maxListeners listeners, nothing throws.
+// The callback is InplaceFunction by default, the Callback policy can
+// replace it with another type which doesn't allocate.
+// Only the policies Threading, ArgumentPassingMode, getEvent and Callback
+// are used. The event type must be trivially copyable, such as an integer
+// or an enum, and std::hash must support it.
+template <
+	typename Event_,
+	typename Prototype_,
+	std::size_t capacity_,
+	std::size_t maxListeners_,
+	typename Policies_ = DefaultPolicies
+>
+class StaticEventQueue;
+
+template <
+	typename Event_,
+	typename ReturnType, typename ...Args,
+	std::size_t capacity_,
+	std::size_t maxListeners_,
+	typename Policies_
+>
+class StaticEventQueue <
+	Event_,
+	ReturnType (Args...),
+	capacity_,
+	maxListeners_,
+	Policies_
+> : public TagEventDispatcher, public TagEventQueue
+{
+private:
+	static_assert(capacity_ > 0, "StaticEventQueue: capacity must be greater than 0.");
+	static_assert(maxListeners_ > 0, "StaticEventQueue: maxListeners must be greater than 0.");
+	static_assert(std::is_trivially_copyable<Event_>::value, "StaticEventQueue: the event type must be trivially copyable.");
+
+	using Policies = Policies_;
+	using Threading = typename internal_::SelectThreading<Policies, internal_::HasTypeThreading<Policies>::value>::Type;
+	using ConditionVariable = typename Threading::ConditionVariable;
+
+	using ArgumentPassingMode = typename internal_::SelectArgumentPassingMode<
+		Policies,
+		internal_::HasTypeArgumentPassingMode<Policies>::value,
+		ArgumentPassingAutoDetect
+	>::Type;
+
+	using Callback_ = typename internal_::SelectCallback<
+		Policies,
+		internal_::HasTypeCallback<Policies>::value,
+		InplaceFunction<ReturnType (Args...)>
+	>::Type;
+
+	using QueuedEventArgumentsType = std::tuple<typename std::decay<Args>::type...>;
+
+	struct QueuedEvent_
+	{
+		typename std::decay<Event_>::type event;
+		QueuedEventArgumentsType arguments;
+
+		Event_ getEvent() const {
+			return event;
+		}
+
+		template <std::size_t N>
+		auto getArgument() const
+			-> typename std::tuple_element<N, std::tuple<Args...> >::type {
+			return std::get<N>(arguments);
+		}
+	};
+
+	using Index = std::int32_t;
+	using Serial = std::uint32_t;
+
+	enum : Index {
+		noIndex = -1
+	};
+
+	static constexpr std::size_t nextPowerOfTwo(const std::size_t n) {
+		return n <= 1 ? 1 : 2 * nextPowerOfTwo((n + 1) / 2);
+	}
+
+	// At least twice the listeners, so a probe always finds a free entry.
+	enum : std::size_t {
+		mapSize = nextPowerOfTwo(maxListeners_ * 2)
+	};
+
+	struct ListenerSlot
+	{
+		Callback_ callback;
+		Event_ event;
+		// 0 if the slot is free.
+		Serial serial;
+		// The next listener of the same event, or the next free slot.
+		Index next;
+	};
+
+	// A map entry is kept for its event after the last listener is removed,
+	// it's reused by another event then. So the probes never break.
+	struct MapEntry
+	{
+		Event_ event;
+		Index head;
+		Index tail;
+		bool used;
+	};
+
+	struct alignas(QueuedEvent_) QueueSlot
+	{
+		unsigned char data[sizeof(QueuedEvent_)];
+	};
+
+	class Handle_
+	{
+	public:
+		Handle_() noexcept : index(noIndex), serial(0) {
+		}
+
+		explicit operator bool () const noexcept {
+			return index != noIndex;
+		}
+
+	private:
+		Handle_(const Index index, const Serial serial) noexcept : index(index), serial(serial) {
+		}
+
+		Index index;
+		Serial serial;
+
+		friend class StaticEventQueue;
+	};
+
+public:
+	using Event = Event_;
+	using Prototype = ReturnType (Args...);
+	using Callback = Callback_;
+	using Handle = Handle_;
+	using Mutex = typename Threading::Mutex;
+	using QueuedEvent = QueuedEvent_;
+
+	enum : std::size_t {
+		capacity = capacity_,
+		maxListeners = maxListeners_
+	};
+
+public:
+	StaticEventQueue() noexcept
+		:
+			listenerMutex(),
+			queueListMutex(),
+			queueListConditionVariable(),
+			listenerList(),
+			mapList(),
+			freeListenerHead(0),
+			listenerCount(0),
+			serialCounter(0),
+			queueHead(0),
+			queueCount(0),
+			waitingConsumerCount(0),
+			droppedEventCount(0)
+	{
+		for(std::size_t i = 0; i < maxListeners_; ++i) {
+			listenerList[i].serial = 0;
+			listenerList[i].next = (i + 1 < maxListeners_ ? static_cast<Index>(i + 1) : noIndex);
+		}
+		for(MapEntry & entry : mapList) {
+			entry.head = noIndex;
+			entry.tail = noIndex;
+			entry.used = false;
+		}
+	}
+
+	~StaticEventQueue()
+	{
+		clearEvents();
+	}
+
+	// The storage is in the object, it can't be moved or copied cheaply.
+	StaticEventQueue(const StaticEventQueue &) = delete;
+	StaticEventQueue & operator = (const StaticEventQueue &) = delete;
+
+	// Returns an empty handle if there are maxListeners listeners already.
+	Handle appendListener(const Event & event, const Callback & callback)
+	{
+		std::lock_guard<Mutex> lockGuard(listenerMutex);
+
+		if(freeListenerHead == noIndex) {
+			return Handle();
+		}
+		MapEntry * entry = doFindEntry(event, true);
+		if(entry == nullptr) {
+			return Handle();
+		}
+
+		const Index index = freeListenerHead;
+		ListenerSlot & slot = listenerList[index];
+		freeListenerHead = slot.next;
+
+		slot.callback = callback;
+		slot.event = event;
+		slot.serial = doGetNextSerial();
+		slot.next = noIndex;
+		if(entry->tail == noIndex) {
+			entry->head = index;
+		}
+		else {
+			listenerList[entry->tail].next = index;
+		}
+		entry->tail = index;
+		++listenerCount;
+
+		return Handle(index, slot.serial);
+	}
+
+	bool removeListener(const Event & event, const Handle & handle)
+	{
+		if(! handle) {
+			return false;
+		}
+
+		std::lock_guard<Mutex> lockGuard(listenerMutex);
+
+		ListenerSlot & slot = listenerList[handle.index];
+		if(slot.serial != handle.serial || ! (slot.event == event)) {
+			return false;
+		}
+		MapEntry * entry = doFindEntry(event, false);
+		assert(entry != nullptr);
+
+		Index previous = noIndex;
+		for(Index index = entry->head; index != handle.index; index = listenerList[index].next) {
+			previous = index;
+		}
+		if(previous == noIndex) {
+			entry->head = slot.next;
+		}
+		else {
+			listenerList[previous].next = slot.next;
+		}
+		if(entry->tail == handle.index) {
+			entry->tail = previous;
+		}
+
+		slot.callback = Callback();
+		slot.serial = 0;
+		slot.next = freeListenerHead;
+		freeListenerHead = handle.index;
+		--listenerCount;
+		return true;
+	}
+
+	bool hasAnyListener(const Event & event) const
+	{
+		std::lock_guard<Mutex> lockGuard(listenerMutex);
+		const MapEntry * entry = const_cast<StaticEventQueue *>(this)->doFindEntry(event, false);
+		return entry != nullptr && entry->head != noIndex;
+	}
+
+	std::size_t getListenerCount() const
+	{
+		std::lock_guard<Mutex> lockGuard(listenerMutex);
+		return listenerCount;
+	}
+
+	void dispatch(Args ...args)
+	{
+		static_assert(ArgumentPassingMode::canIncludeEventType, "Dispatching arguments count doesn't match required (Event type should be included).");
+
+		using GetEvent = typename internal_::SelectGetEvent<Policies, Event_, internal_::HasFunctionGetEvent<Policies, Args...>::value>::Type;
+
+		directDispatch(GetEvent::getEvent(args...), args...);
+	}
+
+	template <typename T>
+	void dispatch(T && first, Args ...args)
+	{
+		static_assert(ArgumentPassingMode::canExcludeEventType, "Dispatching arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename internal_::SelectGetEvent<Policies, Event_, internal_::HasFunctionGetEvent<Policies, T &&, Args...>::value>::Type;
+
+		directDispatch(GetEvent::getEvent(std::forward<T>(first), args...), args...);
+	}
+
+	// A listener is copied out of the table before it's called, so it can
+	// append or remove listeners. The listeners appended while dispatching
+	// are not called.
+	void directDispatch(const Event & event, Args ...args)
+	{
+		std::unique_lock<Mutex> lockGuard(listenerMutex);
+
+		const MapEntry * entry = doFindEntry(event, false);
+		if(entry == nullptr) {
+			return;
+		}
+		const Serial lastSerial = serialCounter;
+		Index index = entry->head;
+		while(index != noIndex) {
+			const Serial serial = listenerList[index].serial;
+			if(serial > lastSerial) {
+				break;
+			}
+			Callback callback(listenerList[index].callback);
+			lockGuard.unlock();
+			callback(args...);
+			lockGuard.lock();
+
+			if(listenerList[index].serial == serial) {
+				index = listenerList[index].next;
+			}
+			else {
+				// The listener was removed while it was called. The listeners
+				// are chained in the order of their serials, so continue from
+				// the first one after it.
+				if(! (entry->event == event)) {
+					break;
+				}
+				index = entry->head;
+				while(index != noIndex && listenerList[index].serial <= serial) {
+					index = listenerList[index].next;
+				}
+			}
+		}
+	}
+
+	// Returns false if the queue is full, the event is dropped.
+	template <typename ...A>
+	auto enqueue(A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), bool>::type
+	{
+		static_assert(ArgumentPassingMode::canIncludeEventType, "Enqueuing arguments count doesn't match required (Event type should be included).");
+
+		using GetEvent = typename internal_::SelectGetEvent<Policies, Event_, internal_::HasFunctionGetEvent<Policies, A...>::value>::Type;
+
+		const Event event = GetEvent::getEvent(args...);
+		return doEnqueue(event, std::forward<A>(args)...);
+	}
+
+	template <typename T, typename ...A>
+	auto enqueue(T && first, A && ...args) -> typename std::enable_if<sizeof...(A) == sizeof...(Args), bool>::type
+	{
+		static_assert(ArgumentPassingMode::canExcludeEventType, "Enqueuing arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename internal_::SelectGetEvent<Policies, Event_, internal_::HasFunctionGetEvent<Policies, T &&, A...>::value>::Type;
+
+		const Event event = GetEvent::getEvent(std::forward<T>(first), args...);
+		return doEnqueue(event, std::forward<A>(args)...);
+	}
+
+	bool emptyQueue() const
+	{
+		return queueCount.load(std::memory_order_acquire) == 0;
+	}
+
+	std::size_t getQueuedEventCount() const
+	{
+		return queueCount.load(std::memory_order_acquire);
+	}
+
+	std::size_t getQueueCapacity() const
+	{
+		return capacity_;
+	}
+
+	std::size_t getDroppedEventCount() const
+	{
+		return droppedEventCount.load(std::memory_order_relaxed);
+	}
+
+	void clearEvents()
+	{
+		std::lock_guard<Mutex> queueListLock(queueListMutex);
+		while(queueCount.load(std::memory_order_relaxed) > 0) {
+			doGetQueuedEvent(queueHead).~QueuedEvent();
+			doPopFront();
+		}
+	}
+
+	// Only the events in the queue when process is called are dispatched.
+	bool process()
+	{
+		std::size_t count = getQueuedEventCount();
+		bool processed = false;
+		while(count > 0 && processOne()) {
+			processed = true;
+			--count;
+		}
+		return processed;
+	}
+
+	bool processOne()
+	{
+		return doProcessOne([this](QueuedEvent & item) {
+			doDispatchQueuedEvent(item, typename internal_::MakeIndexSequence<sizeof...(Args)>::Type());
+		});
+	}
+
+	// Visitor protocol: visitor(event, args...), same as
+	// EventQueue::processQueueWith. The listeners are not called.
+	template <typename Visitor>
+	bool processQueueWith(Visitor && visitor)
+	{
+		std::size_t count = getQueuedEventCount();
+		bool processed = false;
+		while(count > 0 && doProcessOne([this, &visitor](QueuedEvent & item) {
+			doVisitQueuedEvent(visitor, item, typename internal_::MakeIndexSequence<sizeof...(Args)>::Type());
+		})) {
+			processed = true;
+			--count;
+		}
+		return processed;
+	}
+
+	void wait() const
+	{
+		std::unique_lock<Mutex> queueListLock(queueListMutex);
+		waitingConsumerCount.fetch_add(1, std::memory_order_relaxed);
+		queueListConditionVariable.wait(queueListLock, [this]() -> bool {
+			return ! emptyQueue();
+		});
+		waitingConsumerCount.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	template <class Rep, class Period>
+	bool waitFor(const std::chrono::duration<Rep, Period> & duration) const
+	{
+		if(! emptyQueue()) {
+			return true;
+		}
+
+		std::unique_lock<Mutex> queueListLock(queueListMutex);
+		waitingConsumerCount.fetch_add(1, std::memory_order_relaxed);
+		const bool result = queueListConditionVariable.wait_for(queueListLock, duration, [this]() -> bool {
+			return ! emptyQueue();
+		});
+		waitingConsumerCount.fetch_sub(1, std::memory_order_relaxed);
+		return result;
+	}
+
+private:
+	// Must be called under listenerMutex. With add, returns the entry of
+	// event, or a new entry for it, nullptr if the map is full.
+	MapEntry * doFindEntry(const Event & event, const bool add)
+	{
+		std::size_t position = std::hash<Event>()(event) & (mapSize - 1);
+		MapEntry * reusable = nullptr;
+		for(std::size_t i = 0; i < mapSize; ++i) {
+			MapEntry & entry = mapList[position];
+			if(! entry.used) {
+				break;
+			}
+			if(entry.event == event) {
+				return &entry;
+			}
+			if(add && reusable == nullptr && entry.head == noIndex) {
+				reusable = &entry;
+			}
+			position = (position + 1) & (mapSize - 1);
+		}
+		if(! add) {
+			return nullptr;
+		}
+		if(reusable == nullptr) {
+			MapEntry & entry = mapList[position];
+			if(entry.used) {
+				return nullptr;
+			}
+			reusable = &entry;
+		}
+		reusable->event = event;
+		reusable->head = noIndex;
+		reusable->tail = noIndex;
+		reusable->used = true;
+		return reusable;
+	}
+
+	// Must be called under listenerMutex. 0 is never used.
+	Serial doGetNextSerial()
+	{
+		if(++serialCounter == 0) {
+			++serialCounter;
+		}
+		return serialCounter;
+	}
+
+	template <typename ...A>
+	bool doEnqueue(const Event & event, A && ...args)
+	{
+		{
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			const std::size_t count = queueCount.load(std::memory_order_relaxed);
+			if(count == capacity_) {
+				droppedEventCount.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			std::size_t position = queueHead + count;
+			if(position >= capacity_) {
+				position -= capacity_;
+			}
+			new (queueSlotList[position].data) QueuedEvent {
+				event,
+				QueuedEventArgumentsType(std::forward<A>(args)...)
+			};
+			queueCount.store(count + 1, std::memory_order_release);
+			if(waitingConsumerCount.load(std::memory_order_relaxed) == 0) {
+				return true;
+			}
+		}
+		queueListConditionVariable.notify_one();
+		return true;
+	}
+
+	// The event is moved out of its slot under the lock, the slot is free
+	// while the event is dispatched.
+	template <typename F>
+	bool doProcessOne(F && func)
+	{
+		typename std::aligned_storage<sizeof(QueuedEvent), alignof(QueuedEvent)>::type buffer;
+		QueuedEvent * item;
+		{
+			std::lock_guard<Mutex> queueListLock(queueListMutex);
+			if(queueCount.load(std::memory_order_relaxed) == 0) {
+				return false;
+			}
+			QueuedEvent & front = doGetQueuedEvent(queueHead);
+			item = new (&buffer) QueuedEvent(std::move(front));
+			front.~QueuedEvent();
+			doPopFront();
+		}
+
+		struct ItemGuard
+		{
+			~ItemGuard() {
+				item->~QueuedEvent();
+			}
+			QueuedEvent * item;
+		};
+		ItemGuard itemGuard { item };
+		func(*item);
+		return true;
+	}
+
+	// Must be called under queueListMutex.
+	void doPopFront()
+	{
+		if(++queueHead == capacity_) {
+			queueHead = 0;
+		}
+		queueCount.store(queueCount.load(std::memory_order_relaxed) - 1, std::memory_order_release);
+	}
+
+	QueuedEvent & doGetQueuedEvent(const std::size_t position)
+	{
+		return *reinterpret_cast<QueuedEvent *>(queueSlotList[position].data);
+	}
+
+	template <typename T, std::size_t ...Indexes>
+	void doDispatchQueuedEvent(T && item, internal_::IndexSequence<Indexes...>)
+	{
+		directDispatch(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename V, typename T, std::size_t ...Indexes>
+	void doVisitQueuedEvent(V && visitor, T && item, internal_::IndexSequence<Indexes...>)
+	{
+		visitor(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+private:
+	mutable Mutex listenerMutex;
+	mutable Mutex queueListMutex;
+	mutable ConditionVariable queueListConditionVariable;
+	ListenerSlot listenerList[maxListeners_];
+	MapEntry mapList[mapSize];
+	Index freeListenerHead;
+	std::size_t listenerCount;
+	Serial serialCounter;
+	QueueSlot queueSlotList[capacity_];
+	std::size_t queueHead;
+	typename Threading::template Atomic<std::size_t> queueCount;
+	mutable typename Threading::template Atomic<int> waitingConsumerCount;
+	typename Threading::template Atomic<std::size_t> droppedEventCount;
+};
+
+
+} //namespace eventpp
+
+
+#endif
@@ -0,0 +1,398 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ACTIVEOBJECT_H_EVENTPP
+#define ACTIVEOBJECT_H_EVENTPP
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace eventpp {
+
+// OPT-54: Pins the calling thread to the CPUs in cpuList. Returns false if
+// the list is empty or has no valid CPU, or if the platform doesn't support
+// pinning.
+inline bool pinCurrentThread(const std::vector<int> & cpuList)
+{
+#ifdef __linux__
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	bool hasCpu = false;
+	for(const int cpu : cpuList) {
+		if(cpu >= 0 && cpu < CPU_SETSIZE) {
+			CPU_SET(cpu, &cpuSet);
+			hasCpu = true;
+		}
+	}
+	return hasCpu && pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+	(void)cpuList;
+	return false;
+#endif
+}
+
+struct ActiveObjectOptions
+{
+	// The CPUs the worker thread is pinned to, empty is not pinned.
+	std::vector<int> cpuList;
+	// The most events dispatched by one batch, the outputs are flushed
+	// after each batch.
+	std::size_t batchSize = 256;
+	// The longest the idle worker sleeps before it checks stop.
+	std::chrono::microseconds stopCheckInterval = std::chrono::milliseconds(10);
+};
+
+// The times are in nanoseconds.
+struct ActiveObjectStats
+{
+	std::uint64_t eventCount;
+	std::uint64_t batchCount;
+	std::uint64_t maxBatchSize;
+	// The time spent in the batches.
+	std::uint64_t busyTime;
+	// The time spent waiting for room in the output queues.
+	std::uint64_t backpressureTime;
+};
+
+namespace internal_ {
+
+class ActiveObjectOutputBase
+{
+public:
+	virtual ~ActiveObjectOutputBase()
+	{
+	}
+
+	virtual void flush() = 0;
+	virtual void waitNotFull() = 0;
+};
+
+class ActiveObjectBase
+{
+public:
+	virtual ~ActiveObjectBase()
+	{
+	}
+
+	virtual void start() = 0;
+	virtual void stop() = 0;
+};
+
+} //namespace internal_
+
+template <typename Queue>
+class ActiveObject;
+
+// OPT-54: The events a stage hands to the next stage. enqueue stages the
+// event in a ProducerBuffer of the next queue, the buffer is moved to the
+// queue in one splice when it has batchSize events, and after each batch
+// of the stage, so the next worker is woken once per batch, not once per
+// event.
+// Only the worker of the stage which owns the output may enqueue on it.
+template <typename Queue>
+class ActiveObjectOutput : public internal_::ActiveObjectOutputBase
+{
+public:
+	ActiveObjectOutput(const ActiveObjectOutput &) = delete;
+	ActiveObjectOutput & operator = (const ActiveObjectOutput &) = delete;
+
+	template <typename ...A>
+	void enqueue(A && ...args)
+	{
+		buffer.enqueue(std::forward<A>(args)...);
+	}
+
+	Queue & getQueue()
+	{
+		return *queue;
+	}
+
+	void flush() override
+	{
+		buffer.flush();
+	}
+
+	// The buffered events never wait for room, the worker waits before a
+	// batch instead, so a bounded queue is over its limit by at most one
+	// batch of output.
+	void waitNotFull() override
+	{
+		queue->waitNotFull();
+	}
+
+private:
+	ActiveObjectOutput(Queue * queue, const std::size_t batchSize)
+		: queue(queue), buffer(queue, batchSize)
+	{
+	}
+
+private:
+	Queue * queue;
+	typename Queue::ProducerBuffer buffer;
+
+	template <typename> friend class ActiveObject;
+};
+
+// OPT-54: An EventQueue with its own worker thread. The worker waits for
+// the queue, then dispatches the events in batches of at most batchSize.
+// stop dispatches the events which are still in the queue before the
+// worker exits.
+// A listener which throws terminates the program, as any thread does.
+template <typename Queue>
+class ActiveObject : public internal_::ActiveObjectBase
+{
+private:
+	using Clock = std::chrono::steady_clock;
+
+public:
+	explicit ActiveObject(ActiveObjectOptions options = ActiveObjectOptions())
+		:
+			queue(),
+			options(std::move(options)),
+			outputList(),
+			thread(),
+			stopRequested(false),
+			eventCount(0),
+			batchCount(0),
+			maxBatchSize(0),
+			busyTime(0),
+			backpressureTime(0)
+	{
+		assert(this->options.batchSize > 0);
+	}
+
+	~ActiveObject()
+	{
+		stop();
+	}
+
+	ActiveObject(const ActiveObject &) = delete;
+	ActiveObject & operator = (const ActiveObject &) = delete;
+
+	// The queue has cache line aligned members, which the global new of
+	// C++14 doesn't align, so Pipeline can allocate the stages in C++14.
+	static void * operator new(const std::size_t size)
+	{
+		constexpr std::size_t alignment = alignof(ActiveObject);
+		void * raw = ::operator new(size + alignment + sizeof(void *));
+		const std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(raw) + sizeof(void *) + alignment - 1)
+			& ~static_cast<std::uintptr_t>(alignment - 1);
+		reinterpret_cast<void **>(aligned)[-1] = raw;
+		return reinterpret_cast<void *>(aligned);
+	}
+
+	static void operator delete(void * p)
+	{
+		if(p != nullptr) {
+			::operator delete(static_cast<void **>(p)[-1]);
+		}
+	}
+
+	Queue & getQueue()
+	{
+		return queue;
+	}
+
+	const Queue & getQueue() const
+	{
+		return queue;
+	}
+
+	// Adds an output to toQueue, for the listeners of this object. It must be
+	// added before start, and toQueue must outlive this object.
+	template <typename ToQueue>
+	ActiveObjectOutput<ToQueue> & addOutput(ToQueue & toQueue, const std::size_t batchSize = 64)
+	{
+		assert(! isRunning());
+
+		ActiveObjectOutput<ToQueue> * output = new ActiveObjectOutput<ToQueue>(&toQueue, batchSize);
+		outputList.emplace_back(output);
+		return *output;
+	}
+
+	void start() override
+	{
+		assert(! isRunning());
+
+		stopRequested.store(false, std::memory_order_relaxed);
+		thread = std::thread([this]() {
+			doRun();
+		});
+	}
+
+	// Returns when the worker has dispatched the queued events and exited.
+	// The producers should stop first, or the queue may not drain.
+	void stop() override
+	{
+		if(! thread.joinable()) {
+			return;
+		}
+		stopRequested.store(true, std::memory_order_release);
+		thread.join();
+	}
+
+	bool isRunning() const
+	{
+		return thread.joinable();
+	}
+
+	ActiveObjectStats getStats() const
+	{
+		return ActiveObjectStats {
+			eventCount.load(std::memory_order_relaxed),
+			batchCount.load(std::memory_order_relaxed),
+			maxBatchSize.load(std::memory_order_relaxed),
+			busyTime.load(std::memory_order_relaxed),
+			backpressureTime.load(std::memory_order_relaxed)
+		};
+	}
+
+private:
+	void doRun()
+	{
+		if(! options.cpuList.empty()) {
+			pinCurrentThread(options.cpuList);
+		}
+
+		while(! stopRequested.load(std::memory_order_acquire)) {
+			if(queue.waitFor(options.stopCheckInterval)) {
+				doProcessBatch();
+			}
+		}
+
+		while(doProcessBatch()) {
+		}
+	}
+
+	bool doProcessBatch()
+	{
+		if(! outputList.empty()) {
+			const Clock::time_point waitStart = Clock::now();
+			for(auto & output : outputList) {
+				output->waitNotFull();
+			}
+			backpressureTime.fetch_add(doGetNanoseconds(waitStart, Clock::now()), std::memory_order_relaxed);
+		}
+
+		const Clock::time_point start = Clock::now();
+		std::size_t count = 0;
+		const bool processed = queue.processN(options.batchSize, &count);
+		for(auto & output : outputList) {
+			output->flush();
+		}
+
+		if(processed) {
+			eventCount.fetch_add(count, std::memory_order_relaxed);
+			batchCount.fetch_add(1, std::memory_order_relaxed);
+			if(count > maxBatchSize.load(std::memory_order_relaxed)) {
+				maxBatchSize.store(count, std::memory_order_relaxed);
+			}
+			busyTime.fetch_add(doGetNanoseconds(start, Clock::now()), std::memory_order_relaxed);
+		}
+		return processed;
+	}
+
+	static std::uint64_t doGetNanoseconds(const Clock::time_point & from, const Clock::time_point & to)
+	{
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+	}
+
+private:
+	Queue queue;
+	const ActiveObjectOptions options;
+	std::vector<std::unique_ptr<internal_::ActiveObjectOutputBase> > outputList;
+	std::thread thread;
+	std::atomic<bool> stopRequested;
+	// Written by the worker only.
+	std::atomic<std::uint64_t> eventCount;
+	std::atomic<std::uint64_t> batchCount;
+	std::atomic<std::uint64_t> maxBatchSize;
+	std::atomic<std::uint64_t> busyTime;
+	std::atomic<std::uint64_t> backpressureTime;
+};
+
+// OPT-54: A chain of ActiveObject stages. The stages are added from the
+// first to the last, start starts them from the last, stop stops them from
+// the first, so each stage drains into the next one before it's stopped.
+// The producers of the first stage should stop before stop is called.
+class Pipeline
+{
+public:
+	Pipeline() : stageList()
+	{
+	}
+
+	// The stages are destroyed from the first, before the queues their
+	// outputs point to.
+	~Pipeline()
+	{
+		stop();
+		for(auto & stage : stageList) {
+			stage.reset();
+		}
+	}
+
+	Pipeline(const Pipeline &) = delete;
+	Pipeline & operator = (const Pipeline &) = delete;
+
+	template <typename Queue>
+	ActiveObject<Queue> & addStage(ActiveObjectOptions options = ActiveObjectOptions())
+	{
+		ActiveObject<Queue> * stage = new ActiveObject<Queue>(std::move(options));
+		stageList.emplace_back(stage);
+		return *stage;
+	}
+
+	// The listeners of from hand events to to through the returned output.
+	template <typename FromQueue, typename ToQueue>
+	ActiveObjectOutput<ToQueue> & connect(ActiveObject<FromQueue> & from, ActiveObject<ToQueue> & to, const std::size_t batchSize = 64)
+	{
+		return from.addOutput(to.getQueue(), batchSize);
+	}
+
+	void start()
+	{
+		for(auto it = stageList.rbegin(); it != stageList.rend(); ++it) {
+			(*it)->start();
+		}
+	}
+
+	void stop()
+	{
+		for(auto & stage : stageList) {
+			if(stage) {
+				stage->stop();
+			}
+		}
+	}
+
+private:
+	std::vector<std::unique_ptr<internal_::ActiveObjectBase> > stageList;
+};
+
+
+} //namespace eventpp
+
+#endif
@@ -14,11 +14,16 @@
 #ifndef ANYDATA_H_320827729782
 #define ANYDATA_H_320827729782
 
+#include "../internal/poolallocator_i.h"
+
 #include <array>
+#include <atomic>
 #include <type_traits>
+#include <cstddef>
 #include <cstdint>
 #include <cassert>
 #include <memory>
+#include <new>
 
 namespace eventpp {
 
@@ -56,10 +61,46 @@ void funcMoveConstruct(void * object, void * buffer)
 	doFuncMoveConstruct<T>(object, buffer);
 }
 
+template <typename T>
+void funcCopyConstruct(const void * object, void * buffer)
+{
+	new (buffer) T(*static_cast<const T *>(object));
+}
+
+template <typename T>
+struct CanCopyConstruct : std::is_copy_constructible<T> {};
+
+template <typename T>
+auto doGetFuncCopyConstruct()
+	-> typename std::enable_if<CanCopyConstruct<T>::value, void (*)(const void *, void *)>::type
+{
+	return &funcCopyConstruct<T>;
+}
+
+template <typename T>
+auto doGetFuncCopyConstruct()
+	-> typename std::enable_if<! CanCopyConstruct<T>::value, void (*)(const void *, void *)>::type
+{
+	return nullptr;
+}
+
+// OPT-42: The address is unique for each type.
+template <typename T>
+struct TypeKey
+{
+	static const char key;
+};
+
+template <typename T>
+const char TypeKey<T>::key = 0;
+
 struct AnyDataFunctions
 {
 	void (*free)(void *);
 	void (*moveConstruct)(void *, void *);
+	// nullptr if the object can't be copied.
+	void (*copyConstruct)(const void *, void *);
+	const void * typeKey;
 };
 
 template <typename T>
@@ -67,7 +108,9 @@ const AnyDataFunctions * doGetAnyDataFunctions()
 {
 	static const AnyDataFunctions functions {
 		&funcFreeObject<T>,
-		&funcMoveConstruct<T>
+		&funcMoveConstruct<T>,
+		doGetFuncCopyConstruct<T>(),
+		&TypeKey<T>::key
 	};
 	return &functions;
 }
@@ -103,29 +146,128 @@ struct MaxSizeOf <T>
 	static constexpr std::size_t value = sizeof(T);
 };
 
+// OPT-41: The pools of the large objects, one per power of 2 size class
+// from 64 bytes. Each slab is at most 64 KB, so the slabs of the large
+// classes don't waste much of their power of 2 alignment.
+template <std::size_t size>
+struct LargeBlock
+{
+	alignas(std::max_align_t) unsigned char data[size];
+};
+
+constexpr std::size_t getLargeSizeClass(const std::size_t size, const std::size_t sizeClass = 64)
+{
+	return sizeClass >= size ? sizeClass : getLargeSizeClass(size, sizeClass * 2);
+}
+
+enum : std::size_t {
+	largeSlabSize = 64 * 1024,
+	maxLargeSizeClass = largeSlabSize / 2
+};
+
+template <std::size_t size>
+using LargePool = internal_::NodePool<
+	LargeBlock<getLargeSizeClass(size)>,
+	largeSlabSize / getLargeSizeClass(size) - 1
+>;
+
+template <std::size_t size, std::size_t maxPooledSize>
+struct IsPooledSize
+{
+	enum { value = getLargeSizeClass(size) <= maxPooledSize };
+};
+
+template <std::size_t size, std::size_t maxPooledSize>
+auto doAllocateLarge()
+	-> typename std::enable_if<IsPooledSize<size, maxPooledSize>::value, void *>::type
+{
+	void * p = LargePool<size>::instance().allocate();
+	if(p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+template <std::size_t size, std::size_t maxPooledSize>
+auto doAllocateLarge()
+	-> typename std::enable_if<! IsPooledSize<size, maxPooledSize>::value, void *>::type
+{
+	return ::operator new(size);
+}
+
+template <std::size_t size, std::size_t maxPooledSize>
+auto doFreeLarge(void * p)
+	-> typename std::enable_if<IsPooledSize<size, maxPooledSize>::value>::type
+{
+	LargePool<size>::instance().deallocate(static_cast<LargeBlock<getLargeSizeClass(size)> *>(p));
+}
+
+template <std::size_t size, std::size_t maxPooledSize>
+auto doFreeLarge(void * p)
+	-> typename std::enable_if<! IsPooledSize<size, maxPooledSize>::value>::type
+{
+	::operator delete(p);
+}
+
+// The over aligned objects are allocated by new, which knows their alignment.
+template <typename U, std::size_t maxPooledSize>
+struct LargePoolOf
+{
+	static constexpr std::size_t value = (alignof(U) <= alignof(std::max_align_t) ? maxPooledSize : 0);
+};
+
+template <typename U, typename Storage>
+void funcDestroyLarge(void * object)
+{
+	Storage::template destroy<U>(static_cast<U *>(object));
+}
+
+struct LargeDataFunctions
+{
+	void (*destroy)(void *);
+	const void * typeKey;
+};
+
+template <typename U, typename Storage>
+const LargeDataFunctions * getLargeDataFunctions()
+{
+	static const LargeDataFunctions functions {
+		&funcDestroyLarge<U, Storage>,
+		&TypeKey<U>::key
+	};
+	return &functions;
+}
+
+template <typename Storage>
 class LargeData
 {
 public:
 	template <typename T>
-	explicit LargeData(T && object) : data(), deleter() {
+	explicit LargeData(T && object) : data(), functions() {
 		using U = typename RemoveCvRef<T>::Type;
-		deleter = &funcDeleteObject<U>;
-		data = new U(std::forward<T>(object));
+		functions = getLargeDataFunctions<U, Storage>();
+		data = Storage::template create<U>(std::forward<T>(object));
 	}
 
 	~LargeData() {
 		if(data != nullptr) {
-			assert(deleter != nullptr);
-			deleter(data);
+			assert(functions != nullptr);
+			functions->destroy(data);
 		}
 	}
 
-	LargeData(LargeData && other) : data(), deleter() {
+	LargeData(LargeData && other) : data(), functions() {
 		std::swap(data, other.data);
-		std::swap(deleter, other.deleter);
+		std::swap(functions, other.functions);
+	}
+
+	// Only the storages which share the objects, such as AnyDataLargeSharedPool, can copy.
+	LargeData(const LargeData & other) : data(other.data), functions(other.functions) {
+		if(data != nullptr) {
+			Storage::share(data);
+		}
 	}
 
-	LargeData(const LargeData & other) = delete;
 	LargeData & operator = (const LargeData & other) = delete;
 	LargeData & operator = (LargeData && other) = delete;
 
@@ -133,28 +275,144 @@ public:
 		return data;
 	}
 
+	const void * getTypeKey() const {
+		return functions->typeKey;
+	}
+
 	template <typename T>
 	bool isType() const {
-		using U = typename RemoveCvRef<T>::Type;
-		return deleter == &funcDeleteObject<U>;
+		return getTypeKey() == &TypeKey<typename RemoveCvRef<T>::Type>::key;
 	}
 
 private:
 	void * data;
-	void (*deleter)(void *);
+	const LargeDataFunctions * functions;
 };
 
+template <typename Storage, typename = void>
+struct CanShareLarge : std::false_type {};
+
+template <typename Storage>
+struct CanShareLarge <Storage, decltype(Storage::share(nullptr))> : std::true_type {};
+
+template <typename Storage>
+struct CanCopyConstruct <LargeData<Storage> > : CanShareLarge<Storage> {};
+
+struct NotCopyable {};
+
 } //namespace anydata_internal_
 
-template <std::size_t maxSize_>
+// Where AnyData puts the objects larger than maxSize.
+// Each object is allocated by new.
+struct AnyDataLargeHeap
+{
+	template <typename U, typename T>
+	static U * create(T && object) {
+		return new U(std::forward<T>(object));
+	}
+
+	template <typename U>
+	static void destroy(U * object) {
+		delete object;
+	}
+};
+
+// OPT-41: Each object is allocated from the pool of its size class, the
+// objects larger than maxPooledSize are allocated by new.
+template <std::size_t maxPooledSize = 4096>
+struct AnyDataLargePool
+{
+	static_assert(maxPooledSize <= anydata_internal_::maxLargeSizeClass, "AnyDataLargePool: maxPooledSize must not be greater than 32768.");
+
+	template <typename U, typename T>
+	static U * create(T && object) {
+		constexpr std::size_t poolSize = anydata_internal_::LargePoolOf<U, maxPooledSize>::value;
+		void * p = anydata_internal_::doAllocateLarge<sizeof(U), poolSize>();
+		try {
+			return new (p) U(std::forward<T>(object));
+		}
+		catch(...) {
+			anydata_internal_::doFreeLarge<sizeof(U), poolSize>(p);
+			throw;
+		}
+	}
+
+	template <typename U>
+	static void destroy(U * object) {
+		object->~U();
+		anydata_internal_::doFreeLarge<sizeof(U), anydata_internal_::LargePoolOf<U, maxPooledSize>::value>(object);
+	}
+};
+
+// OPT-41: As AnyDataLargePool, and the object is reference counted.
+// Copying an AnyData which holds a large object only increments the count,
+// so the same payload can be enqueued to several queues without copying it.
+// The shared object must not be modified.
+template <std::size_t maxPooledSize = 4096>
+struct AnyDataLargeSharedPool
+{
+	static_assert(maxPooledSize <= anydata_internal_::maxLargeSizeClass, "AnyDataLargeSharedPool: maxPooledSize must not be greater than 32768.");
+
+	// Followed by the object.
+	struct alignas(std::max_align_t) Header
+	{
+		std::atomic<std::size_t> referenceCount;
+	};
+
+	template <typename U, typename T>
+	static U * create(T && object) {
+		constexpr std::size_t poolSize = anydata_internal_::LargePoolOf<U, maxPooledSize>::value;
+		void * p = anydata_internal_::doAllocateLarge<sizeof(Header) + sizeof(U), poolSize>();
+		try {
+			U * u = new (static_cast<char *>(p) + sizeof(Header)) U(std::forward<T>(object));
+			new (p) Header { { 1 } };
+			return u;
+		}
+		catch(...) {
+			anydata_internal_::doFreeLarge<sizeof(Header) + sizeof(U), poolSize>(p);
+			throw;
+		}
+	}
+
+	template <typename U>
+	static void destroy(U * object) {
+		Header * header = getHeader(object);
+		if(header->referenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			object->~U();
+			header->~Header();
+			anydata_internal_::doFreeLarge<sizeof(Header) + sizeof(U), anydata_internal_::LargePoolOf<U, maxPooledSize>::value>(header);
+		}
+	}
+
+	static void share(void * object) {
+		getHeader(object)->referenceCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static Header * getHeader(void * object) {
+		return reinterpret_cast<Header *>(static_cast<char *>(object) - sizeof(Header));
+	}
+};
+
+template <std::size_t maxSize_, typename LargeStorage = AnyDataLargeHeap>
 class AnyData
 {
 private:
-	using LargeData = anydata_internal_::LargeData;
+	using LargeData = anydata_internal_::LargeData<LargeStorage>;
 	static constexpr std::size_t maxSize = maxSize_ < sizeof(LargeData) ? sizeof(LargeData) : maxSize_;
 
 	static_assert(maxSize > 0, "AnyData: maxSize must be greater than 0");
 
+	using CopySource = typename std::conditional<
+		anydata_internal_::CanShareLarge<LargeStorage>::value,
+		AnyData,
+		anydata_internal_::NotCopyable
+	>::type;
+
+	template <typename T>
+	using IsObject = std::integral_constant<bool,
+		! std::is_same<typename anydata_internal_::RemoveCvRef<T>::Type, AnyData>::value
+	>;
+
 public:
 	~AnyData() {
 		if(functions != nullptr) {
@@ -164,7 +422,7 @@ public:
 
 	template <typename T>
 	AnyData(T && object,
-		typename std::enable_if<(sizeof(typename anydata_internal_::RemoveCvRef<T>::Type) <= maxSize)>::type * = 0)
+		typename std::enable_if<IsObject<T>::value && (sizeof(typename anydata_internal_::RemoveCvRef<T>::Type) <= maxSize)>::type * = 0)
 		: functions(anydata_internal_::getAnyDataFunctions<T>()), buffer() {
 		using U = typename std::remove_reference<T>::type;
 		new (buffer.data()) U(std::forward<T>(object));
@@ -172,7 +430,7 @@ public:
 
 	template <typename T>
 	AnyData(T && object,
-		typename std::enable_if<(sizeof(typename anydata_internal_::RemoveCvRef<T>::Type) > maxSize)>::type * = 0)
+		typename std::enable_if<IsObject<T>::value && (sizeof(typename anydata_internal_::RemoveCvRef<T>::Type) > maxSize)>::type * = 0)
 		: functions(anydata_internal_::getAnyDataFunctions<LargeData>()), buffer() {
 		new (buffer.data()) LargeData(std::forward<T>(object));
 	}
@@ -183,8 +441,17 @@ public:
 		}
 	}
 
-	AnyData(const AnyData & other) = delete;
-	AnyData(AnyData & other) = delete;
+	// The copy constructor, only with AnyDataLargeSharedPool. A large object
+	// is shared, a small object is copied, it must be copy constructible.
+	// Otherwise the copy constructor is deleted, since there is a move
+	// constructor.
+	AnyData(const CopySource & other) : functions(other.functions), buffer() {
+		if(functions != nullptr) {
+			assert(functions->copyConstruct != nullptr);
+			functions->copyConstruct(other.buffer.data(), buffer.data());
+		}
+	}
+
 	AnyData & operator = (const AnyData & other) = delete;
 	AnyData & operator = (AnyData && other) = delete;
 
@@ -210,7 +477,21 @@ public:
 			return anydata_internal_::getAnyDataFunctions<T>() == functions;
 		}
 		else {
-			return ((const LargeData *)buffer.data())->isType<T>();
+			return ((const LargeData *)buffer.data())->template isType<T>();
+		}
+	}
+
+	// OPT-42: Identifies the type of the object, it's the same for all
+	// AnyData holding the type, whatever maxSize and LargeStorage are.
+	// AnyDataRegistry uses it to find the registered type.
+	const void * getTypeKey() const {
+		assert(functions != nullptr);
+
+		if(! isLargerData()) {
+			return functions->typeKey;
+		}
+		else {
+			return ((const LargeData *)buffer.data())->getTypeKey();
 		}
 	}
 
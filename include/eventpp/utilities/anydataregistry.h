@@ -0,0 +1,305 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ANYDATAREGISTRY_H_EVENTPP
+#define ANYDATAREGISTRY_H_EVENTPP
+
+#include "anydata.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace eventpp {
+
+// OPT-42: Converts a T to bytes and back.
+// getSize returns the count of the bytes write writes. read constructs a T
+// at object from size bytes, or returns false if the bytes are not a T.
+// The trivially copyable types are copied as they are in memory, specialize
+// it for the other types.
+template <typename T, typename Enabled = void>
+struct AnyDataSerializer;
+
+template <typename T>
+struct AnyDataSerializer <T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type>
+{
+	static std::size_t getSize(const T & /*object*/) {
+		return sizeof(T);
+	}
+
+	static void write(const T & object, void * buffer) {
+		std::memcpy(buffer, &object, sizeof(T));
+	}
+
+	static bool read(const void * buffer, const std::size_t size, void * object) {
+		if(size != sizeof(T)) {
+			return false;
+		}
+		std::memcpy(object, buffer, sizeof(T));
+		return true;
+	}
+};
+
+template <>
+struct AnyDataSerializer <std::string>
+{
+	static std::size_t getSize(const std::string & object) {
+		return object.size();
+	}
+
+	static void write(const std::string & object, void * buffer) {
+		std::memcpy(buffer, object.data(), object.size());
+	}
+
+	static bool read(const void * buffer, const std::size_t size, void * object) {
+		new (object) std::string(static_cast<const char *>(buffer), size);
+		return true;
+	}
+};
+
+// OPT-42: The types which can be serialized in AnyDataType, which is an
+// AnyData. Each type is registered with a stable ID, the ID is written
+// instead of the type, so the bytes can be read by another process or
+// another build. A serialized AnyData is the 32 bit type ID, the 32 bit
+// size of the object and the bytes of AnyDataSerializer, in the native byte
+// order.
+// Register the types before using the registry, the other functions can
+// then be called by any threads at the same time.
+template <typename AnyDataType>
+class AnyDataRegistry
+{
+public:
+	using TypeId = std::uint32_t;
+
+private:
+	struct Entry
+	{
+		TypeId typeId;
+		std::size_t (*getSize)(const AnyDataType & data);
+		void (*write)(const AnyDataType & data, void * buffer);
+		bool (*read)(const void * buffer, std::size_t size, void * data);
+	};
+
+	enum : std::size_t {
+		headerSize = sizeof(std::uint32_t) * 2
+	};
+
+public:
+	// Returns false if typeId or T is registered already.
+	template <typename T>
+	bool registerType(const TypeId typeId)
+	{
+		using U = typename anydata_internal_::RemoveCvRef<T>::Type;
+		const void * typeKey = &anydata_internal_::TypeKey<U>::key;
+		if(typeKeyMap.find(typeKey) != typeKeyMap.end() || typeIdMap.find(typeId) != typeIdMap.end()) {
+			return false;
+		}
+		const Entry entry {
+			typeId,
+			&doGetObjectSize<U>,
+			&doWriteObject<U>,
+			&doReadObject<U>
+		};
+		typeKeyMap[typeKey] = entry;
+		typeIdMap[typeId] = entry;
+		return true;
+	}
+
+	bool isRegistered(const AnyDataType & data) const {
+		return doFindEntry(data) != nullptr;
+	}
+
+	// Returns 0 if the type of data is not registered.
+	std::size_t getSerializedSize(const AnyDataType & data) const {
+		const Entry * entry = doFindEntry(data);
+		return entry == nullptr ? 0 : headerSize + entry->getSize(data);
+	}
+
+	// Returns the count of the bytes written, or 0 if the type of data is not
+	// registered or bufferSize is too small.
+	std::size_t serialize(const AnyDataType & data, void * buffer, const std::size_t bufferSize) const {
+		const Entry * entry = doFindEntry(data);
+		if(entry == nullptr) {
+			return 0;
+		}
+		const std::size_t size = entry->getSize(data);
+		if(headerSize + size > bufferSize) {
+			return 0;
+		}
+		unsigned char * p = static_cast<unsigned char *>(buffer);
+		doWriteUint32(p, entry->typeId);
+		doWriteUint32(p + sizeof(std::uint32_t), static_cast<std::uint32_t>(size));
+		entry->write(data, p + headerSize);
+		return headerSize + size;
+	}
+
+	std::size_t serialize(const AnyDataType & data, std::vector<unsigned char> & output) const {
+		const std::size_t size = getSerializedSize(data);
+		if(size == 0) {
+			return 0;
+		}
+		const std::size_t offset = output.size();
+		output.resize(offset + size);
+		return serialize(data, output.data() + offset, size);
+	}
+
+	// Calls func(AnyDataType && data) with the AnyData read from buffer.
+	// Returns the count of the bytes read, or 0 if the bytes are not a
+	// registered type, then func is not called.
+	template <typename F>
+	std::size_t deserialize(const void * buffer, const std::size_t bufferSize, F && func) const {
+		if(bufferSize < headerSize) {
+			return 0;
+		}
+		const unsigned char * p = static_cast<const unsigned char *>(buffer);
+		const auto it = typeIdMap.find(doReadUint32(p));
+		const std::size_t size = doReadUint32(p + sizeof(std::uint32_t));
+		if(it == typeIdMap.end() || headerSize + size > bufferSize) {
+			return 0;
+		}
+		typename std::aligned_storage<sizeof(AnyDataType), alignof(AnyDataType)>::type storage;
+		if(! it->second.read(p + headerSize, size, &storage)) {
+			return 0;
+		}
+		AnyDataType & data = *reinterpret_cast<AnyDataType *>(&storage);
+		DestroyGuard<> guard { data };
+		func(std::move(data));
+		return headerSize + size;
+	}
+
+	// Takes all events out of queue and appends them to log, without
+	// dispatching them. The prototype of queue must have one argument,
+	// which is AnyDataType, and the event must not be an argument, as for
+	// EventQueue::emplace. The event type is serialized by
+	// AnyDataSerializer. The events whose data type isn't registered are
+	// dropped. Returns the count of the events written.
+	template <typename Queue>
+	std::size_t dumpQueue(Queue & queue, std::vector<unsigned char> & log) const {
+		using Event = typename std::decay<typename Queue::Event>::type;
+		std::size_t count = 0;
+		for(const auto & queuedEvent : queue.borrowEvents()) {
+			const AnyDataType & data = std::get<0>(queuedEvent.arguments);
+			if(! isRegistered(data)) {
+				continue;
+			}
+			const std::size_t eventSize = AnyDataSerializer<Event>::getSize(queuedEvent.event);
+			const std::size_t offset = log.size();
+			log.resize(offset + sizeof(std::uint32_t) + eventSize);
+			doWriteUint32(log.data() + offset, static_cast<std::uint32_t>(eventSize));
+			AnyDataSerializer<Event>::write(queuedEvent.event, log.data() + offset + sizeof(std::uint32_t));
+			serialize(data, log);
+			++count;
+		}
+		return count;
+	}
+
+	// Enqueues the events written by dumpQueue to queue, in the same order.
+	// Stops at the first record which can't be read. Returns the count of
+	// the events enqueued.
+	template <typename Queue>
+	std::size_t replayQueue(Queue & queue, const void * log, const std::size_t logSize) const {
+		using Event = typename std::decay<typename Queue::Event>::type;
+		const unsigned char * p = static_cast<const unsigned char *>(log);
+		const unsigned char * const end = p + logSize;
+		std::size_t count = 0;
+		while(static_cast<std::size_t>(end - p) > sizeof(std::uint32_t)) {
+			const std::size_t eventSize = doReadUint32(p);
+			p += sizeof(std::uint32_t);
+			if(eventSize > static_cast<std::size_t>(end - p)) {
+				break;
+			}
+			typename std::aligned_storage<sizeof(Event), alignof(Event)>::type eventStorage;
+			if(! AnyDataSerializer<Event>::read(p, eventSize, &eventStorage)) {
+				break;
+			}
+			Event & event = *reinterpret_cast<Event *>(&eventStorage);
+			DestroyGuard<Event> eventGuard { event };
+			p += eventSize;
+			const std::size_t dataSize = deserialize(p, static_cast<std::size_t>(end - p), [&queue, &event](AnyDataType && data) {
+				queue.enqueue(event, std::move(data));
+			});
+			if(dataSize == 0) {
+				break;
+			}
+			p += dataSize;
+			++count;
+		}
+		return count;
+	}
+
+private:
+	template <typename T = AnyDataType>
+	struct DestroyGuard
+	{
+		~DestroyGuard() {
+			object.~T();
+		}
+
+		T & object;
+	};
+
+	const Entry * doFindEntry(const AnyDataType & data) const {
+		const auto it = typeKeyMap.find(data.getTypeKey());
+		return it == typeKeyMap.end() ? nullptr : &it->second;
+	}
+
+	template <typename U>
+	static std::size_t doGetObjectSize(const AnyDataType & data) {
+		return AnyDataSerializer<U>::getSize(data.template get<U>());
+	}
+
+	template <typename U>
+	static void doWriteObject(const AnyDataType & data, void * buffer) {
+		AnyDataSerializer<U>::write(data.template get<U>(), buffer);
+	}
+
+	template <typename U>
+	static bool doReadObject(const void * buffer, const std::size_t size, void * data) {
+		typename std::aligned_storage<sizeof(U), alignof(U)>::type storage;
+		if(! AnyDataSerializer<U>::read(buffer, size, &storage)) {
+			return false;
+		}
+		U & object = *reinterpret_cast<U *>(&storage);
+		DestroyGuard<U> guard { object };
+		new (data) AnyDataType(std::move(object));
+		return true;
+	}
+
+	static void doWriteUint32(unsigned char * p, const std::uint32_t value) {
+		std::memcpy(p, &value, sizeof(value));
+	}
+
+	static std::uint32_t doReadUint32(const unsigned char * p) {
+		std::uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+private:
+	std::unordered_map<const void *, Entry> typeKeyMap;
+	std::unordered_map<TypeId, Entry> typeIdMap;
+};
+
+
+} //namespace eventpp
+
+#endif
+
@@ -14,10 +14,16 @@
 #ifndef ARGUMENTADAPTER_H_566280692673
 #define ARGUMENTADAPTER_H_566280692673
 
+#include "intrusiveptr.h"
+
 #include <memory>
+#include <type_traits>
 
 namespace eventpp {
 
+template <typename Schema>
+class LazyPayload;
+
 namespace adapter_internal_ {
 
 template <typename T>
@@ -40,6 +46,69 @@ struct StaticCast<std::shared_ptr<T> >
 	}
 };
 
+// OPT-70: IntrusivePtr by value costs one increment and one decrement.
+template <typename T>
+struct StaticCast<IntrusivePtr<T> >
+{
+	template <typename U>
+	static IntrusivePtr<T> cast(const IntrusivePtr<U> & value)
+	{
+		return staticPointerCast<T>(value);
+	}
+};
+
+// Borrows the reference of the argument, so a listener which receives
+// `const IntrusivePtr<T> &` doesn't touch the reference count at all.
+// The borrow lives until the listener returns.
+template <typename T>
+struct IntrusivePtrBorrow : public IntrusivePtr<T>
+{
+	explicit IntrusivePtrBorrow(T * object) noexcept
+		: IntrusivePtr<T>(object, IntrusiveAdoptTag())
+	{
+	}
+
+	IntrusivePtrBorrow(IntrusivePtrBorrow && other) noexcept = default;
+
+	~IntrusivePtrBorrow()
+	{
+		this->detach();
+	}
+};
+
+template <typename T>
+struct StaticCast<const IntrusivePtr<T> &>
+{
+	template <typename U>
+	static IntrusivePtrBorrow<T> cast(const IntrusivePtr<U> & value)
+	{
+		return IntrusivePtrBorrow<T>(static_cast<T *>(value.get()));
+	}
+};
+
+// OPT-80: A LazyPayload by value shares the bytes of the argument, one
+// increment and one decrement.
+template <typename Schema>
+struct StaticCast<LazyPayload<Schema> >
+{
+	template <typename U>
+	static LazyPayload<Schema> cast(const U & value)
+	{
+		return LazyPayload<Schema>(value);
+	}
+};
+
+// Borrows the bytes of the argument, as IntrusivePtrBorrow does.
+template <typename Schema>
+struct StaticCast<const LazyPayload<Schema> &>
+{
+	template <typename U>
+	static typename LazyPayload<Schema>::Borrow cast(const U & value)
+	{
+		return typename LazyPayload<Schema>::Borrow(value);
+	}
+};
+
 template <typename T>
 struct IsSharedPtr
 {
@@ -52,6 +121,42 @@ struct IsSharedPtr<std::shared_ptr<T> >
 	enum { value = true };
 };
 
+template <typename T>
+struct IsIntrusivePtr
+{
+	enum { value = false };
+};
+
+template <typename T>
+struct IsIntrusivePtr<IntrusivePtr<T> >
+{
+	enum { value = true };
+};
+
+template <typename T>
+struct IsIntrusivePtr<const IntrusivePtr<T> &>
+{
+	enum { value = true };
+};
+
+template <typename T>
+struct IsLazyPayload
+{
+	enum { value = false };
+};
+
+template <typename Schema>
+struct IsLazyPayload<LazyPayload<Schema> >
+{
+	enum { value = true };
+};
+
+template <typename Schema>
+struct IsLazyPayload<const LazyPayload<Schema> &>
+{
+	enum { value = true };
+};
+
 template <typename ...Args>
 struct IsAnySharedPtr
 {
@@ -62,6 +167,8 @@ template <typename First, typename ...Others>
 struct IsAnySharedPtr <First, Others...>
 {
 	enum { value = IsSharedPtr<First>::value
+		|| IsIntrusivePtr<First>::value
+		|| IsLazyPayload<First>::value
 		|| IsAnySharedPtr<Others...>::value };
 };
 
@@ -82,9 +189,10 @@ struct ArgumentAdapter <
 	{
 	}
 
+	// OPT-80: Returns the result of func, so a filter can be adapted too.
 	template <typename ...A>
-	void operator() (A &&...args) {
-		func(std::forward<Args>(static_cast<Args>(args))...);
+	R operator() (A &&...args) {
+		return func(std::forward<Args>(static_cast<Args>(args))...);
 	}
 
 	Func func;
@@ -103,8 +211,10 @@ struct ArgumentAdapter <
 	}
 
 	template <typename ...A>
-	void operator() (A &&...args) {
-		func(std::forward<Args>(adapter_internal_::StaticCast<Args>::cast(args))...);
+	R operator() (A &&...args) {
+		// cast() already returns the value category of Args, and the borrow of
+		// IntrusivePtr must bind to `const IntrusivePtr<T> &` as a temporary.
+		return func(adapter_internal_::StaticCast<Args>::cast(args)...);
 	}
 
 	Func func;
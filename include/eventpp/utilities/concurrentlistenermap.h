@@ -0,0 +1,211 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CONCURRENTLISTENERMAP_H_EVENTPP
+#define CONCURRENTLISTENERMAP_H_EVENTPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace eventpp {
+
+// OPT-37: Map policy whose find() can run at the same time as operator [],
+// without any lock and without writing to shared memory. It's an open
+// addressing table of pointers to the entries. An entry is never moved or
+// erased, it's published into the table after it's constructed. When the
+// table grows, the new table is published and the old one is kept until the
+// map is destroyed, so a reader which still probes it stays valid. The old
+// tables are at most as large as the current one.
+// operator [] must not be called concurrently with itself, EventDispatcher
+// calls it under its listener mutex.
+template <
+	typename Key,
+	typename T,
+	typename Hash = std::hash<Key>,
+	typename KeyEqual = std::equal_to<Key>
+>
+class ConcurrentListenerMap
+{
+public:
+	struct value_type
+	{
+		explicit value_type(const Key & key)
+			: first(key), second()
+		{
+		}
+
+		Key first;
+		T second;
+	};
+
+	using key_type = Key;
+	using mapped_type = T;
+	using size_type = std::size_t;
+	using iterator = value_type *;
+	using const_iterator = const value_type *;
+
+	// Tells EventDispatcher that find doesn't need the listener mutex.
+	using ConcurrentFind = std::true_type;
+
+private:
+	struct Table
+	{
+		explicit Table(const std::size_t capacity)
+			: mask(capacity - 1), slotList(new std::atomic<value_type *>[capacity])
+		{
+			for(std::size_t i = 0; i < capacity; ++i) {
+				slotList[i].store(nullptr, std::memory_order_relaxed);
+			}
+		}
+
+		const std::size_t mask;
+		std::unique_ptr<std::atomic<value_type *>[]> slotList;
+	};
+
+	enum { initialCapacity = 16 };
+
+public:
+	ConcurrentListenerMap()
+		: nodeList(), tableList(), currentTable(nullptr)
+	{
+	}
+
+	ConcurrentListenerMap(const ConcurrentListenerMap & other)
+		: ConcurrentListenerMap()
+	{
+		for(const auto & node : other.nodeList) {
+			(*this)[node->first] = node->second;
+		}
+	}
+
+	ConcurrentListenerMap(ConcurrentListenerMap && other) noexcept
+		: ConcurrentListenerMap()
+	{
+		swap(other);
+	}
+
+	ConcurrentListenerMap & operator = (ConcurrentListenerMap other) noexcept
+	{
+		swap(other);
+		return *this;
+	}
+
+	T & operator[] (const Key & key) {
+		iterator it = find(key);
+		if(it != end()) {
+			return it->second;
+		}
+
+		nodeList.emplace_back(new value_type(key));
+		value_type * node = nodeList.back().get();
+		Table * table = currentTable.load(std::memory_order_relaxed);
+		// The load factor is at most 1/2, so a probe always ends at a null slot.
+		if(table == nullptr || nodeList.size() * 2 > table->mask + 1) {
+			doGrow(table == nullptr ? static_cast<std::size_t>(initialCapacity) : (table->mask + 1) * 2);
+		}
+		else {
+			doInsert(*table, node);
+		}
+		return node->second;
+	}
+
+	iterator find(const Key & key) {
+		return const_cast<iterator>(static_cast<const ConcurrentListenerMap *>(this)->find(key));
+	}
+
+	const_iterator find(const Key & key) const {
+		const Table * table = currentTable.load(std::memory_order_acquire);
+		if(table == nullptr) {
+			return end();
+		}
+		for(std::size_t i = doGetIndex(key, table->mask); ; i = (i + 1) & table->mask) {
+			const value_type * node = table->slotList[i].load(std::memory_order_acquire);
+			if(node == nullptr) {
+				return end();
+			}
+			if(KeyEqual()(node->first, key)) {
+				return node;
+			}
+		}
+	}
+
+	iterator end() {
+		return nullptr;
+	}
+
+	const_iterator end() const {
+		return nullptr;
+	}
+
+	size_type size() const {
+		return nodeList.size();
+	}
+
+	bool empty() const {
+		return nodeList.empty();
+	}
+
+	void swap(ConcurrentListenerMap & other) noexcept {
+		nodeList.swap(other.nodeList);
+		tableList.swap(other.tableList);
+		Table * table = currentTable.load(std::memory_order_relaxed);
+		currentTable.store(other.currentTable.load(std::memory_order_relaxed), std::memory_order_release);
+		other.currentTable.store(table, std::memory_order_release);
+	}
+
+	friend void swap(ConcurrentListenerMap & first, ConcurrentListenerMap & second) noexcept {
+		first.swap(second);
+	}
+
+private:
+	static std::size_t doGetIndex(const Key & key, const std::size_t mask) {
+		// std::hash of the integers is the identity, mix it so the close
+		// events don't make long probes.
+		const std::uint64_t hash = static_cast<std::uint64_t>(Hash()(key)) * 0x9e3779b97f4a7c15ull;
+		return static_cast<std::size_t>(hash ^ (hash >> 32)) & mask;
+	}
+
+	static void doInsert(Table & table, value_type * node) {
+		std::size_t i = doGetIndex(node->first, table.mask);
+		while(table.slotList[i].load(std::memory_order_relaxed) != nullptr) {
+			i = (i + 1) & table.mask;
+		}
+		table.slotList[i].store(node, std::memory_order_release);
+	}
+
+	void doGrow(const std::size_t capacity) {
+		tableList.emplace_back(new Table(capacity));
+		Table & table = *tableList.back();
+		for(const auto & node : nodeList) {
+			doInsert(table, node.get());
+		}
+		currentTable.store(&table, std::memory_order_release);
+	}
+
+private:
+	std::vector<std::unique_ptr<value_type> > nodeList;
+	std::vector<std::unique_ptr<Table> > tableList;
+	std::atomic<Table *> currentTable;
+};
+
+
+} //namespace eventpp
+
+#endif
+
@@ -15,9 +15,68 @@
 #define CONDITIONALREMOVER_H_882115092280
 
 #include "../eventpolicies.h"
+#include "../internal/typeutil_i.h"
+#include "../internal/selfremover_i.h"
+
+#include <type_traits>
+#include <utility>
 
 namespace eventpp {
 
+namespace internal_ {
+
+template <typename Callback, typename Condition, typename Remover>
+struct ConditionalRemoverData : public SelfRemoverData<Callback, Remover>
+{
+	template <typename ...RemoverArgs>
+	ConditionalRemoverData(const Callback & listener, const Condition & shouldRemove, RemoverArgs && ...removerArgs)
+		: SelfRemoverData<Callback, Remover>(listener, std::forward<RemoverArgs>(removerArgs)...),
+			shouldRemove(shouldRemove)
+	{
+	}
+
+	Condition shouldRemove;
+};
+
+// OPT-48: When the condition is met, the listener is disarmed, then removed,
+// and the call which disarms it is the last one. If several threads meet
+// the condition at once, only one of them calls the listener.
+template <typename Callback, typename Condition, typename Remover>
+struct ConditionalRemoverWrapper
+{
+	using Data = ConditionalRemoverData<Callback, Condition, Remover>;
+
+	template <typename ...RemoverArgs>
+	ConditionalRemoverWrapper(const Callback & listener, const Condition & condition, RemoverArgs && ...removerArgs)
+		: reference(new Data(listener, condition, std::forward<RemoverArgs>(removerArgs)...), false)
+	{
+	}
+
+	template <typename ...Args>
+	auto operator() (Args && ...args) const
+		-> typename std::enable_if<internal_::CanInvoke<Condition, Args...>::value>::type {
+		Data * data = static_cast<Data *>(reference.get());
+		if(data->isDisarmed() || (data->shouldRemove(args...) && ! data->disarm())) {
+			return;
+		}
+		data->listener(std::forward<Args>(args)...);
+	}
+
+	template <typename ...Args>
+	auto operator() (Args && ...args) const
+		-> typename std::enable_if<! internal_::CanInvoke<Condition, Args...>::value>::type {
+		Data * data = static_cast<Data *>(reference.get());
+		if(data->isDisarmed() || (data->shouldRemove() && ! data->disarm())) {
+			return;
+		}
+		data->listener(std::forward<Args>(args)...);
+	}
+
+	ListenerGroupReference reference;
+};
+
+} //namespace internal_
+
 template <typename DispatcherType, typename Enabled = void>
 class ConditionalRemover;
 
@@ -28,38 +87,14 @@ class ConditionalRemover <
 	>
 {
 private:
-	template <typename Callback, typename Condition>
-	struct ItemByCondition
-	{
-		struct Data
-		{
-			Condition shouldRemove;
-			DispatcherType & dispatcher;
-			typename DispatcherType::Event event;
-			Callback listener;
-			typename DispatcherType::Handle handle;
-		};
-
-		template <typename ...Args>
-		auto operator() (Args && ...args) const
-			-> typename std::enable_if<internal_::CanInvoke<Condition, Args...>::value>::type {
-			if(data->shouldRemove(args...)) {
-				data->dispatcher.removeListener(data->event, data->handle);
-			}
-			data->listener(std::forward<Args>(args)...);
-		}
-
-		template <typename ...Args>
-		auto operator() (Args && ...args) const
-			-> typename std::enable_if<! internal_::CanInvoke<Condition, Args...>::value>::type {
-			if(data->shouldRemove()) {
-				data->dispatcher.removeListener(data->event, data->handle);
-			}
-			data->listener(std::forward<Args>(args)...);
-		}
-
-		std::shared_ptr<Data> data;
-	};
+	using Event = typename DispatcherType::Event;
+	using Handle = typename DispatcherType::Handle;
+	using HasListenerGroup = internal_::DispatcherHasListenerGroup<DispatcherType>;
+	using Remover = typename std::conditional<
+		HasListenerGroup::value,
+		internal_::GroupSelfRemover,
+		internal_::DispatcherSelfRemover<DispatcherType>
+	>::type;
 
 public:
 	explicit ConditionalRemover(DispatcherType & dispatcher)
@@ -68,49 +103,48 @@ public:
 	}
 	
 	template <typename Callback, typename Condition>
-	typename DispatcherType::Handle appendListener(
-			const typename DispatcherType::Event & event,
+	Handle appendListener(
+			const Event & event,
 			const Callback & listener,
 			const Condition & condition
 		)
 	{
-		using Wrapper = ItemByCondition<Callback, Condition>;
-		auto data = std::make_shared<typename Wrapper::Data>(typename Wrapper::Data {
-			condition, dispatcher, event, listener, typename DispatcherType::Handle()
-		});
-		data->handle = dispatcher.appendListener(event, Wrapper{data});
-		return data->handle;
+		return doAddListener(event, listener, condition, nullptr, false);
 	}
 
 	template <typename Callback, typename Condition>
-	typename DispatcherType::Handle prependListener(
-			const typename DispatcherType::Event & event,
+	Handle prependListener(
+			const Event & event,
 			const Callback & listener,
 			const Condition & condition
 		)
 	{
-		using Wrapper = ItemByCondition<Callback, Condition>;
-		auto data = std::make_shared<typename Wrapper::Data>(typename Wrapper::Data {
-			condition, dispatcher, event, listener, typename DispatcherType::Handle()
-		});
-		data->handle = dispatcher.prependListener(event, Wrapper{data});
-		return data->handle;
+		return doAddListener(event, listener, condition, nullptr, true);
 	}
 
 	template <typename Callback, typename Condition>
-	typename DispatcherType::Handle insertListener(
-			const typename DispatcherType::Event & event,
+	Handle insertListener(
+			const Event & event,
 			const Callback & listener,
-			const typename DispatcherType::Handle & before,
+			const Handle & before,
 			const Condition & condition
 		)
 	{
-		using Wrapper = ItemByCondition<Callback, Condition>;
-		auto data = std::make_shared<typename Wrapper::Data>(typename Wrapper::Data {
-			condition, dispatcher, event, listener, typename DispatcherType::Handle()
-		});
-		data->handle = dispatcher.insertListener(event, Wrapper{data}, before);
-		return data->handle;
+		return doAddListener(event, listener, condition, &before, false);
+	}
+
+private:
+	template <typename Callback, typename Condition>
+	Handle doAddListener(const Event & event, const Callback & listener, const Condition & condition, const Handle * before, const bool prepend)
+	{
+		return internal_::addSelfRemoverListener(
+			dispatcher,
+			event,
+			internal_::ConditionalRemoverWrapper<Callback, Condition, Remover>(listener, condition, dispatcher, event),
+			before,
+			prepend,
+			HasListenerGroup()
+		);
 	}
 
 private:
@@ -124,37 +158,13 @@ class ConditionalRemover <
 	>
 {
 private:
-	template <typename Callback, typename Condition>
-	struct ItemByCondition
-	{
-		struct Data
-		{
-			Condition shouldRemove;
-			CallbackListType & callbackList;
-			Callback listener;
-			typename CallbackListType::Handle handle;
-		};
-
-		template <typename ...Args>
-		auto operator() (Args && ...args) const
-			-> typename std::enable_if<internal_::CanInvoke<Condition, Args...>::value>::type const {
-			if(data->shouldRemove(args...)) {
-				data->callbackList.remove(data->handle);
-			}
-			data->listener(std::forward<Args>(args)...);
-		}
-
-		template <typename ...Args>
-		auto operator() (Args && ...args) const
-			-> typename std::enable_if<! internal_::CanInvoke<Condition, Args...>::value>::type {
-			if(data->shouldRemove()) {
-				data->callbackList.remove(data->handle);
-			}
-			data->listener(std::forward<Args>(args)...);
-		}
-		
-		std::shared_ptr<Data> data;
-	};
+	using Handle = typename CallbackListType::Handle;
+	using HasListenerGroup = internal_::CallbackListHasListenerGroup<CallbackListType>;
+	using Remover = typename std::conditional<
+		HasListenerGroup::value,
+		internal_::GroupSelfRemover,
+		internal_::CallbackListSelfRemover<CallbackListType>
+	>::type;
 
 public:
 	explicit ConditionalRemover(CallbackListType & callbackList)
@@ -163,46 +173,44 @@ public:
 	}
 	
 	template <typename Callback, typename Condition>
-	typename CallbackListType::Handle append(
+	Handle append(
 			const Callback & listener,
 			const Condition & condition
 		)
 	{
-		using Wrapper = ItemByCondition<Callback, Condition>;
-		auto data = std::make_shared<typename Wrapper::Data>(typename Wrapper::Data {
-			condition, callbackList, listener, typename CallbackListType::Handle()
-		});
-		data->handle = callbackList.append(Wrapper{data});
-		return data->handle;
+		return doAdd(listener, condition, nullptr, false);
 	}
 
 	template <typename Callback, typename Condition>
-	typename CallbackListType::Handle prepend(
+	Handle prepend(
 			const Callback & listener,
 			const Condition & condition
 		)
 	{
-		using Wrapper = ItemByCondition<Callback, Condition>;
-		auto data = std::make_shared<typename Wrapper::Data>(typename Wrapper::Data {
-			condition, callbackList, listener, typename CallbackListType::Handle()
-		});
-		data->handle = callbackList.prepend(Wrapper{data});
-		return data->handle;
+		return doAdd(listener, condition, nullptr, true);
 	}
 
 	template <typename Callback, typename Condition>
-	typename CallbackListType::Handle insert(
+	Handle insert(
 			const Callback & listener,
-			const typename CallbackListType::Handle & before,
+			const Handle & before,
 			const Condition & condition
 		)
 	{
-		using Wrapper = ItemByCondition<Callback, Condition>;
-		auto data = std::make_shared<typename Wrapper::Data>(typename Wrapper::Data {
-			condition, callbackList, listener, typename CallbackListType::Handle()
-		});
-		data->handle = callbackList.insert(Wrapper{data}, before);
-		return data->handle;
+		return doAdd(listener, condition, &before, false);
+	}
+
+private:
+	template <typename Callback, typename Condition>
+	Handle doAdd(const Callback & listener, const Condition & condition, const Handle * before, const bool prepend)
+	{
+		return internal_::addSelfRemoverCallback(
+			callbackList,
+			internal_::ConditionalRemoverWrapper<Callback, Condition, Remover>(listener, condition, callbackList),
+			before,
+			prepend,
+			HasListenerGroup()
+		);
 	}
 
 private:
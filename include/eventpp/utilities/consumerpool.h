@@ -0,0 +1,346 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CONSUMERPOOL_H_EVENTPP
+#define CONSUMERPOOL_H_EVENTPP
+
+#include "activeobject.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace eventpp {
+
+struct ConsumerPoolOptions
+{
+	// The CPUs the consumers are pinned to, empty is not pinned.
+	std::vector<int> cpuList;
+	std::size_t minConsumerCount = 1;
+	std::size_t maxConsumerCount = 4;
+	// The bounds of the processN batch of a consumer.
+	std::size_t minBatchSize = 1;
+	std::size_t maxBatchSize = 256;
+	// How often the controller looks at the queue.
+	std::chrono::microseconds controlInterval = std::chrono::milliseconds(10);
+	// A consumer is added when the depth is more than scaleUpDepth for each
+	// consumer, or the residency is more than scaleUpResidency.
+	std::size_t scaleUpDepth = 256;
+	std::chrono::microseconds scaleUpResidency = std::chrono::milliseconds(5);
+	// A consumer is parked after scaleDownIntervalCount intervals in a row
+	// with the depth at most scaleDownDepth for each consumer.
+	std::size_t scaleDownDepth = 16;
+	unsigned int scaleDownIntervalCount = 10;
+	// The longest an idle consumer sleeps before it checks stop.
+	std::chrono::microseconds stopCheckInterval = std::chrono::milliseconds(10);
+};
+
+// The times are in nanoseconds.
+struct ConsumerPoolStats
+{
+	// The decisions of the last control interval.
+	std::size_t consumerCount;
+	std::size_t batchSize;
+	// The depth seen by the last control interval, and the residency
+	// estimated from it.
+	std::size_t queueDepth;
+	std::uint64_t residency;
+	std::uint64_t eventCount;
+	std::uint64_t scaleUpCount;
+	std::uint64_t scaleDownCount;
+};
+
+// OPT-82: A pool of consumer threads for one EventQueue, sized by the load.
+// maxConsumerCount threads are started, the ones past the consumer count
+// are parked on a condition variable. Consumer 0 is also the controller,
+// each controlInterval it reads the depth of the queue, estimates the
+// residency by Little's law, depth / dequeue rate, and
+// - adds a consumer if the depth or the residency is over its limit, or
+//   parks one if the depth stays low, one consumer for each interval, so
+//   a burst doesn't start all the threads for one interval of backlog.
+// - sets the batch of processN to the depth shared by the consumers, in
+//   [minBatchSize, maxBatchSize], small batches release the lock of the
+//   queue sooner when it's shallow, large ones take fewer locks when deep.
+// The depth is EventQueue::getQueuedEventCount, so the queue must have the
+// QueueCapacity policy QueueCapacityLimited, zero limits only count.
+template <typename Queue>
+class ConsumerPool
+{
+private:
+	using Clock = std::chrono::steady_clock;
+
+public:
+	using DecisionCallback = std::function<void (const ConsumerPoolStats &)>;
+
+public:
+	// queue must outlive the pool.
+	explicit ConsumerPool(Queue & queue, ConsumerPoolOptions options = ConsumerPoolOptions())
+		:
+			queue(queue),
+			options(std::move(options)),
+			threadList(),
+			parkMutex(),
+			parkConditionVariable(),
+			stopRequested(false),
+			consumerCount(0),
+			batchSize(0),
+			queueDepth(0),
+			residency(0),
+			eventCount(0),
+			scaleUpCount(0),
+			scaleDownCount(0),
+			decisionCallback(),
+			lastControlTime(),
+			lastEventCount(0),
+			lowIntervalCount(0)
+	{
+		assert(this->options.minConsumerCount > 0);
+		assert(this->options.minConsumerCount <= this->options.maxConsumerCount);
+		assert(this->options.minBatchSize > 0);
+		assert(this->options.minBatchSize <= this->options.maxBatchSize);
+	}
+
+	~ConsumerPool()
+	{
+		stop();
+	}
+
+	ConsumerPool(const ConsumerPool &) = delete;
+	ConsumerPool & operator = (const ConsumerPool &) = delete;
+
+	Queue & getQueue()
+	{
+		return queue;
+	}
+
+	// Called by the controller, in consumer 0, when it changes the consumer
+	// count or the batch size. Set it before start.
+	void setDecisionCallback(DecisionCallback callback)
+	{
+		assert(! isRunning());
+
+		decisionCallback = std::move(callback);
+	}
+
+	void start()
+	{
+		assert(! isRunning());
+
+		stopRequested.store(false, std::memory_order_relaxed);
+		consumerCount.store(options.minConsumerCount, std::memory_order_relaxed);
+		batchSize.store(options.minBatchSize, std::memory_order_relaxed);
+		lastControlTime = Clock::now();
+		lastEventCount = eventCount.load(std::memory_order_relaxed);
+		lowIntervalCount = 0;
+		for(std::size_t i = 0; i < options.maxConsumerCount; ++i) {
+			threadList.emplace_back([this, i]() {
+				doRun(i);
+			});
+		}
+	}
+
+	// Returns when the running consumers have dispatched the queued events
+	// and all the threads exited. The producers should stop first.
+	void stop()
+	{
+		if(threadList.empty()) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lockGuard(parkMutex);
+			stopRequested.store(true, std::memory_order_release);
+		}
+		parkConditionVariable.notify_all();
+		for(auto & thread : threadList) {
+			thread.join();
+		}
+		threadList.clear();
+	}
+
+	bool isRunning() const
+	{
+		return ! threadList.empty();
+	}
+
+	ConsumerPoolStats getStats() const
+	{
+		return ConsumerPoolStats {
+			consumerCount.load(std::memory_order_relaxed),
+			batchSize.load(std::memory_order_relaxed),
+			queueDepth.load(std::memory_order_relaxed),
+			residency.load(std::memory_order_relaxed),
+			eventCount.load(std::memory_order_relaxed),
+			scaleUpCount.load(std::memory_order_relaxed),
+			scaleDownCount.load(std::memory_order_relaxed)
+		};
+	}
+
+private:
+	void doRun(const std::size_t index)
+	{
+		if(! options.cpuList.empty()) {
+			pinCurrentThread(options.cpuList);
+		}
+
+		const std::chrono::microseconds waitInterval = (index == 0
+			? (std::min)(options.controlInterval, options.stopCheckInterval)
+			: options.stopCheckInterval
+		);
+		bool active = true;
+		while(! stopRequested.load(std::memory_order_acquire)) {
+			if(index >= consumerCount.load(std::memory_order_acquire)) {
+				active = doPark(index);
+				continue;
+			}
+			if(queue.waitFor(waitInterval)) {
+				doProcessBatch();
+			}
+			if(index == 0) {
+				doControlIfDue();
+			}
+		}
+
+		// The parked consumers don't drain, the running ones do.
+		if(active) {
+			while(doProcessBatch()) {
+			}
+		}
+	}
+
+	// Returns whether the consumer runs again, false if it's stopped.
+	bool doPark(const std::size_t index)
+	{
+		std::unique_lock<std::mutex> lock(parkMutex);
+		parkConditionVariable.wait(lock, [this, index]() {
+			return stopRequested.load(std::memory_order_relaxed)
+				|| index < consumerCount.load(std::memory_order_relaxed);
+		});
+		return ! stopRequested.load(std::memory_order_relaxed);
+	}
+
+	bool doProcessBatch()
+	{
+		std::size_t count = 0;
+		const bool processed = queue.processN(batchSize.load(std::memory_order_relaxed), &count);
+		if(processed) {
+			eventCount.fetch_add(count, std::memory_order_relaxed);
+		}
+		return processed;
+	}
+
+	void doControlIfDue()
+	{
+		const Clock::time_point now = Clock::now();
+		if(now - lastControlTime < options.controlInterval) {
+			return;
+		}
+
+		const std::size_t depth = queue.getQueuedEventCount();
+		const std::uint64_t totalCount = eventCount.load(std::memory_order_relaxed);
+		const std::uint64_t processedCount = totalCount - lastEventCount;
+		const std::uint64_t elapsed = static_cast<std::uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastControlTime).count());
+		lastControlTime = now;
+		lastEventCount = totalCount;
+
+		// Little's law. A queue which didn't move at all has waited the
+		// whole interval, at least.
+		std::uint64_t estimatedResidency = 0;
+		if(depth > 0) {
+			estimatedResidency = (processedCount > 0
+				? static_cast<std::uint64_t>(static_cast<double>(depth) * static_cast<double>(elapsed) / static_cast<double>(processedCount))
+				: elapsed
+			);
+		}
+		queueDepth.store(depth, std::memory_order_relaxed);
+		residency.store(estimatedResidency, std::memory_order_relaxed);
+
+		const std::size_t oldCount = consumerCount.load(std::memory_order_relaxed);
+		std::size_t newCount = oldCount;
+		const std::uint64_t scaleUpResidency = static_cast<std::uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(options.scaleUpResidency).count());
+		if(depth > options.scaleUpDepth * oldCount || estimatedResidency > scaleUpResidency) {
+			lowIntervalCount = 0;
+			if(oldCount < options.maxConsumerCount) {
+				newCount = oldCount + 1;
+			}
+		}
+		else if(depth <= options.scaleDownDepth * oldCount) {
+			if(++lowIntervalCount >= options.scaleDownIntervalCount) {
+				lowIntervalCount = 0;
+				if(oldCount > options.minConsumerCount) {
+					newCount = oldCount - 1;
+				}
+			}
+		}
+		else {
+			lowIntervalCount = 0;
+		}
+
+		const std::size_t oldBatchSize = batchSize.load(std::memory_order_relaxed);
+		const std::size_t newBatchSize = (std::max)(options.minBatchSize, (std::min)(options.maxBatchSize, depth / newCount));
+		batchSize.store(newBatchSize, std::memory_order_relaxed);
+
+		if(newCount != oldCount) {
+			{
+				std::lock_guard<std::mutex> lockGuard(parkMutex);
+				consumerCount.store(newCount, std::memory_order_release);
+			}
+			if(newCount > oldCount) {
+				scaleUpCount.fetch_add(1, std::memory_order_relaxed);
+				parkConditionVariable.notify_all();
+			}
+			else {
+				scaleDownCount.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		if(decisionCallback && (newCount != oldCount || newBatchSize != oldBatchSize)) {
+			decisionCallback(getStats());
+		}
+	}
+
+private:
+	Queue & queue;
+	const ConsumerPoolOptions options;
+	std::vector<std::thread> threadList;
+	std::mutex parkMutex;
+	std::condition_variable parkConditionVariable;
+	std::atomic<bool> stopRequested;
+	std::atomic<std::size_t> consumerCount;
+	std::atomic<std::size_t> batchSize;
+	std::atomic<std::size_t> queueDepth;
+	std::atomic<std::uint64_t> residency;
+	std::atomic<std::uint64_t> eventCount;
+	std::atomic<std::uint64_t> scaleUpCount;
+	std::atomic<std::uint64_t> scaleDownCount;
+	DecisionCallback decisionCallback;
+	// Used by consumer 0 only.
+	Clock::time_point lastControlTime;
+	std::uint64_t lastEventCount;
+	unsigned int lowIntervalCount;
+};
+
+
+} //namespace eventpp
+
+#endif
@@ -0,0 +1,169 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef COROUTINE_H_EVENTPP
+#define COROUTINE_H_EVENTPP
+
+#include "../internal/coroutine_i.h"
+
+#if EVENTPP_HAS_COROUTINE
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+
+namespace eventpp {
+
+// OPT-50: The return type of a coroutine listener. The coroutine starts
+// when the listener is called and destroys itself when it's done, so
+// dispatch returns at its first suspension. A std::function which returns
+// void can hold it, so the listener is added to a CallbackList,
+// EventDispatcher or EventQueue as any other listener.
+// An exception which leaves the coroutine calls std::terminate, there is
+// nobody to receive it.
+struct EventTask
+{
+	struct promise_type
+	{
+		EventTask get_return_object() noexcept {
+			return EventTask();
+		}
+
+		std::suspend_never initial_suspend() noexcept {
+			return {};
+		}
+
+		std::suspend_never final_suspend() noexcept {
+			return {};
+		}
+
+		void return_void() noexcept {
+		}
+
+		void unhandled_exception() noexcept {
+			std::terminate();
+		}
+	};
+};
+
+// A run queue of coroutines shared by a few threads. Each thread calls run,
+// the coroutines posted to it are resumed by whichever thread is free, so
+// many suspended consumers use no thread at all.
+// It can be given to EventQueue::next and batch, and co_await
+// executor.schedule() moves a coroutine, such as a listener, to it.
+class CoroutineExecutor
+{
+private:
+	struct ScheduleAwaiter
+	{
+		bool await_ready() const noexcept {
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> handle) {
+			executor->post(handle);
+		}
+
+		void await_resume() const noexcept {
+		}
+
+		CoroutineExecutor * executor;
+	};
+
+public:
+	CoroutineExecutor() : mutex(), condition(), handleList(), stopped(false)
+	{
+	}
+
+	CoroutineExecutor(const CoroutineExecutor &) = delete;
+	CoroutineExecutor & operator = (const CoroutineExecutor &) = delete;
+
+	void post(std::coroutine_handle<> handle) {
+		{
+			std::lock_guard<std::mutex> lockGuard(mutex);
+			handleList.push_back(handle);
+		}
+		condition.notify_one();
+	}
+
+	ScheduleAwaiter schedule() {
+		return ScheduleAwaiter { this };
+	}
+
+	// Resumes one posted coroutine. Returns false if there is none.
+	bool runOne() {
+		std::coroutine_handle<> handle;
+		{
+			std::lock_guard<std::mutex> lockGuard(mutex);
+			if(handleList.empty()) {
+				return false;
+			}
+			handle = handleList.front();
+			handleList.pop_front();
+		}
+		handle.resume();
+		return true;
+	}
+
+	// Resumes the posted coroutines until there are none. Returns the count.
+	std::size_t poll() {
+		std::size_t count = 0;
+		while(runOne()) {
+			++count;
+		}
+		return count;
+	}
+
+	// Resumes the posted coroutines, waiting for them, until stop is called.
+	void run() {
+		for(;;) {
+			std::coroutine_handle<> handle;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() {
+					return stopped || ! handleList.empty();
+				});
+				if(handleList.empty()) {
+					return;
+				}
+				handle = handleList.front();
+				handleList.pop_front();
+			}
+			handle.resume();
+		}
+	}
+
+	// run returns when there is nothing left to resume.
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lockGuard(mutex);
+			stopped = true;
+		}
+		condition.notify_all();
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<std::coroutine_handle<> > handleList;
+	bool stopped;
+};
+
+} //namespace eventpp
+
+#endif
+
+#endif
+
@@ -16,9 +16,88 @@
 
 #include "../eventpolicies.h"
 #include "../internal/typeutil_i.h"
+#include "../internal/selfremover_i.h"
+
+#include <atomic>
+#include <type_traits>
+#include <utility>
 
 namespace eventpp {
 
+namespace internal_ {
+
+template <typename Callback, typename Remover>
+struct CounterRemoverData : public SelfRemoverData<Callback, Remover>
+{
+	template <typename ...RemoverArgs>
+	CounterRemoverData(const Callback & listener, const int triggerCount, RemoverArgs && ...removerArgs)
+		: SelfRemoverData<Callback, Remover>(listener, std::forward<RemoverArgs>(removerArgs)...),
+			triggerCount(triggerCount)
+	{
+	}
+
+	std::atomic<int> triggerCount;
+};
+
+// OPT-48: A listener which is called at most triggerCount times, even when
+// it's dispatched by several threads at once. Each call takes a count with
+// one atomic operation, the call which takes the last one disarms and
+// removes the listener, the calls which get no count return.
+template <typename Callback, typename Remover>
+struct CounterRemoverWrapper
+{
+	using Data = CounterRemoverData<Callback, Remover>;
+
+	template <typename ...RemoverArgs>
+	CounterRemoverWrapper(const Callback & listener, const int triggerCount, RemoverArgs && ...removerArgs)
+		: reference(new Data(listener, triggerCount, std::forward<RemoverArgs>(removerArgs)...), false)
+	{
+	}
+
+	template <typename ...Args>
+	auto operator() (Args && ...args) const
+		-> typename std::enable_if<internal_::CanInvoke<Callback, Args ...>::value, void>::type {
+		Data * data = static_cast<Data *>(reference.get());
+		const int count = data->triggerCount.fetch_sub(1, std::memory_order_acq_rel);
+		if(count <= 0) {
+			return;
+		}
+		if(count == 1) {
+			data->disarm();
+		}
+		data->listener(std::forward<Args>(args)...);
+	}
+
+	ListenerGroupReference reference;
+};
+
+// The listeners with triggerCount 1, usually for a reply, have no counter,
+// disarming the listener is the only atomic operation of the call.
+template <typename Callback, typename Remover>
+struct OneShotRemoverWrapper
+{
+	using Data = SelfRemoverData<Callback, Remover>;
+
+	template <typename ...RemoverArgs>
+	explicit OneShotRemoverWrapper(const Callback & listener, RemoverArgs && ...removerArgs)
+		: reference(new Data(listener, std::forward<RemoverArgs>(removerArgs)...), false)
+	{
+	}
+
+	template <typename ...Args>
+	auto operator() (Args && ...args) const
+		-> typename std::enable_if<internal_::CanInvoke<Callback, Args ...>::value, void>::type {
+		Data * data = static_cast<Data *>(reference.get());
+		if(data->disarm()) {
+			data->listener(std::forward<Args>(args)...);
+		}
+	}
+
+	ListenerGroupReference reference;
+};
+
+} //namespace internal_
+
 template <typename DispatcherType, typename Enabled = void>
 class CounterRemover;
 
@@ -29,30 +108,15 @@ class CounterRemover <
 	>
 {
 private:
-	template <typename Callback>
-	struct Wrapper
-	{
-		struct Data
-		{
-			int triggerCount;
-			DispatcherType & dispatcher;
-			typename DispatcherType::Event event;
-			Callback listener;
-			typename DispatcherType::Handle handle;
-		};
-
-		template <typename ...Args>
-		auto operator() (Args && ...args) const
-			-> typename std::enable_if<internal_::CanInvoke<Callback, Args ...>::value, void>::type {
-			if(--data->triggerCount <= 0) {
-				data->dispatcher.removeListener(data->event, data->handle);
-			}
-			data->listener(std::forward<Args>(args)...);
-		}
-		
-		std::shared_ptr<Data> data;
-	};
-	
+	using Event = typename DispatcherType::Event;
+	using Handle = typename DispatcherType::Handle;
+	using HasListenerGroup = internal_::DispatcherHasListenerGroup<DispatcherType>;
+	using Remover = typename std::conditional<
+		HasListenerGroup::value,
+		internal_::GroupSelfRemover,
+		internal_::DispatcherSelfRemover<DispatcherType>
+	>::type;
+
 public:
 	explicit CounterRemover(DispatcherType & dispatcher)
 		: dispatcher(dispatcher)
@@ -60,46 +124,59 @@ public:
 	}
 	
 	template <typename Callback>
-	typename DispatcherType::Handle appendListener(
-			const typename DispatcherType::Event & event,
+	Handle appendListener(
+			const Event & event,
 			const Callback & listener,
 			const int triggerCount = 1
 		)
 	{
-		auto data = std::make_shared<typename Wrapper<Callback>::Data>(typename Wrapper<Callback>::Data {
-			triggerCount, dispatcher, event, listener, typename DispatcherType::Handle()
-		});
-		data->handle = dispatcher.appendListener(event, Wrapper<Callback>{data});
-		return data->handle;
+		return doAddListener(event, listener, nullptr, false, triggerCount);
 	}
 
 	template <typename Callback>
-	typename DispatcherType::Handle prependListener(
-			const typename DispatcherType::Event & event,
+	Handle prependListener(
+			const Event & event,
 			const Callback & listener,
 			const int triggerCount = 1
 		)
 	{
-		auto data = std::make_shared<typename Wrapper<Callback>::Data>(typename Wrapper<Callback>::Data {
-			triggerCount, dispatcher, event, listener, typename DispatcherType::Handle()
-		});
-		data->handle = dispatcher.prependListener(event, Wrapper<Callback>{data});
-		return data->handle;
+		return doAddListener(event, listener, nullptr, true, triggerCount);
 	}
 
 	template <typename Callback>
-	typename DispatcherType::Handle insertListener(
-			const typename DispatcherType::Event & event,
+	Handle insertListener(
+			const Event & event,
 			const Callback & listener,
-			const typename DispatcherType::Handle & before,
+			const Handle & before,
 			const int triggerCount = 1
 		)
 	{
-		auto data = std::make_shared<typename Wrapper<Callback>::Data>(typename Wrapper<Callback>::Data {
-			triggerCount, dispatcher, event, listener, typename DispatcherType::Handle()
-		});
-		data->handle = dispatcher.insertListener(event, Wrapper<Callback>{data}, before);
-		return data->handle;
+		return doAddListener(event, listener, &before, false, triggerCount);
+	}
+
+private:
+	// A triggerCount less than 1 is the same as 1, the listener is called once.
+	template <typename Callback>
+	Handle doAddListener(const Event & event, const Callback & listener, const Handle * before, const bool prepend, const int triggerCount)
+	{
+		if(triggerCount <= 1) {
+			return internal_::addSelfRemoverListener(
+				dispatcher,
+				event,
+				internal_::OneShotRemoverWrapper<Callback, Remover>(listener, dispatcher, event),
+				before,
+				prepend,
+				HasListenerGroup()
+			);
+		}
+		return internal_::addSelfRemoverListener(
+			dispatcher,
+			event,
+			internal_::CounterRemoverWrapper<Callback, Remover>(listener, triggerCount, dispatcher, event),
+			before,
+			prepend,
+			HasListenerGroup()
+		);
 	}
 
 private:
@@ -113,28 +190,13 @@ class CounterRemover <
 	>
 {
 private:
-	template <typename Callback>
-	struct Wrapper
-	{
-		struct Data
-		{
-			int triggerCount;
-			CallbackListType & callbackList;
-			Callback listener;
-			typename CallbackListType::Handle handle;
-		};
-
-		template <typename ...Args>
-		auto operator() (Args && ...args) const
-			-> typename std::enable_if<internal_::CanInvoke<Callback, Args ...>::value, void>::type {
-			if(--data->triggerCount <= 0) {
-				data->callbackList.remove(data->handle);
-			}
-			data->listener(std::forward<Args>(args)...);
-		}
-		
-		std::shared_ptr<Data> data;
-	};
+	using Handle = typename CallbackListType::Handle;
+	using HasListenerGroup = internal_::CallbackListHasListenerGroup<CallbackListType>;
+	using Remover = typename std::conditional<
+		HasListenerGroup::value,
+		internal_::GroupSelfRemover,
+		internal_::CallbackListSelfRemover<CallbackListType>
+	>::type;
 
 public:
 	explicit CounterRemover(CallbackListType & callbackList)
@@ -143,43 +205,53 @@ public:
 	}
 	
 	template <typename Callback>
-	typename CallbackListType::Handle append(
+	Handle append(
 			const Callback & listener,
 			const int triggerCount = 1
 		)
 	{
-		auto data = std::make_shared<typename Wrapper<Callback>::Data>(typename Wrapper<Callback>::Data {
-			triggerCount, callbackList, listener, typename CallbackListType::Handle()
-		});
-		data->handle = callbackList.append(Wrapper<Callback>{data});
-		return data->handle;
+		return doAdd(listener, nullptr, false, triggerCount);
 	}
 
 	template <typename Callback>
-	typename CallbackListType::Handle prepend(
+	Handle prepend(
 			const Callback & listener,
 			const int triggerCount = 1
 		)
 	{
-		auto data = std::make_shared<typename Wrapper<Callback>::Data>(typename Wrapper<Callback>::Data {
-			triggerCount, callbackList, listener, typename CallbackListType::Handle()
-		});
-		data->handle = callbackList.prepend(Wrapper<Callback>{data});
-		return data->handle;
+		return doAdd(listener, nullptr, true, triggerCount);
 	}
 
 	template <typename Callback>
-	typename CallbackListType::Handle insert(
+	Handle insert(
 			const Callback & listener,
-			const typename CallbackListType::Handle & before,
+			const Handle & before,
 			const int triggerCount = 1
 		)
 	{
-		auto data = std::make_shared<typename Wrapper<Callback>::Data>(typename Wrapper<Callback>::Data {
-			triggerCount, callbackList, listener, typename CallbackListType::Handle()
-		});
-		data->handle = callbackList.insert(Wrapper<Callback>{data}, before);
-		return data->handle;
+		return doAdd(listener, &before, false, triggerCount);
+	}
+
+private:
+	template <typename Callback>
+	Handle doAdd(const Callback & listener, const Handle * before, const bool prepend, const int triggerCount)
+	{
+		if(triggerCount <= 1) {
+			return internal_::addSelfRemoverCallback(
+				callbackList,
+				internal_::OneShotRemoverWrapper<Callback, Remover>(listener, callbackList),
+				before,
+				prepend,
+				HasListenerGroup()
+			);
+		}
+		return internal_::addSelfRemoverCallback(
+			callbackList,
+			internal_::CounterRemoverWrapper<Callback, Remover>(listener, triggerCount, callbackList),
+			before,
+			prepend,
+			HasListenerGroup()
+		);
 	}
 
 private:
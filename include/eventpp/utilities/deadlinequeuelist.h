@@ -0,0 +1,109 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef DEADLINEQUEUELIST_H_EVENTPP
+#define DEADLINEQUEUELIST_H_EVENTPP
+
+#include "../eventpolicies.h"
+
+#include <chrono>
+#include <iterator>
+#include <list>
+#include <type_traits>
+#include <utility>
+
+namespace eventpp {
+
+// OPT-55: A QueueList which keeps the events in the order of their
+// deadlines, for the earliest deadline first processing of EventQueue with
+// QueueDeadlineSteady. The events with the same deadline, and the events
+// without a deadline, which are the last, keep their enqueue order.
+// Unlike OrderedQueueList, the list is never sorted again. An event is
+// inserted from the back, so it's O(1) when the deadlines come in order,
+// as they do with one time to live, and the lists are merged.
+//   struct MyPolicies {
+//     using QueueDeadline = eventpp::QueueDeadlineSteady;
+//     template <typename T>
+//     using QueueList = eventpp::DeadlineQueueList<T>;
+//   };
+template <typename T>
+class DeadlineQueueList : private std::list<T>
+{
+private:
+	using super = std::list<T>;
+
+public:
+	using iterator = typename super::iterator;
+	using const_iterator = typename super::const_iterator;
+	using super::empty;
+	using super::size;
+	using super::begin;
+	using super::end;
+	using super::front;
+	using super::swap;
+	using super::emplace_back;
+
+	// Where pos is doesn't matter, the events are merged by their deadlines.
+	void splice(const_iterator /*pos*/, DeadlineQueueList & other) {
+		if(other.empty()) {
+			return;
+		}
+		if(! other.isSorted()) {
+			other.super::sort(&DeadlineQueueList::isEarlier);
+		}
+		super::merge(static_cast<super &>(other), &DeadlineQueueList::isEarlier);
+	}
+
+	void splice(const_iterator /*pos*/, DeadlineQueueList & other, const_iterator it) {
+		const auto deadline = getDeadline(*it);
+		const_iterator position = this->cend();
+		while(position != this->cbegin()) {
+			const_iterator previous = std::prev(position);
+			if(! (deadline < getDeadline(*previous))) {
+				break;
+			}
+			position = previous;
+		}
+		super::splice(position, other, it);
+	}
+
+private:
+	// OPT-81: The time point of the Clock policy of the queue.
+	using TimePoint = typename std::decay<decltype(std::declval<const T &>().get().getDeadline())>::type;
+
+	// The recycled items are empty, they have no deadline.
+	static TimePoint getDeadline(const T & item) {
+		return item.empty() ? (TimePoint::max)() : item.get().getDeadline();
+	}
+
+	static bool isEarlier(const T & a, const T & b) {
+		return getDeadline(a) < getDeadline(b);
+	}
+
+	bool isSorted() const {
+		auto it = this->cbegin();
+		auto previous = it;
+		for(++it; it != this->cend(); ++it) {
+			if(isEarlier(*it, *previous)) {
+				return false;
+			}
+			previous = it;
+		}
+		return true;
+	}
+};
+
+
+} //namespace eventpp
+
+#endif
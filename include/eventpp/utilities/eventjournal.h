@@ -0,0 +1,594 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EVENTJOURNAL_H_EVENTPP
+#define EVENTJOURNAL_H_EVENTPP
+
+#if ! defined(__unix__) && ! defined(__unix) && ! defined(__APPLE__)
+	#error "EventJournal requires a POSIX system."
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace eventpp {
+
+struct EventJournalOptions
+{
+	// The size of each segment file, the records are never split between
+	// segments, so a record can be at most segmentSize - 40 bytes.
+	std::size_t segmentSize = 64 * 1024 * 1024;
+	// If not zero, a thread commits the journal at this interval.
+	std::chrono::milliseconds syncInterval = std::chrono::milliseconds(0);
+};
+
+// OPT-43: Append only log of records, in memory mapped segment files of a
+// directory. append copies the record to the mapped segment, it makes no
+// system call except when a segment is full and the next one is created.
+// commit writes the records appended since the last commit to the disk with
+// one msync (group commit), either called by the user after a batch, or by
+// the sync thread at each syncInterval.
+// Each record has its size and a checksum, a record which was not written
+// completely before a crash is found by its checksum, replay stops there and
+// open appends after the last complete record.
+// An offset is the position of a record in the whole journal, it only grows.
+// All functions can be called by any threads at the same time, but open and
+// close must not be called while the journal is used.
+class EventJournal
+{
+private:
+	struct SegmentHeader
+	{
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint64_t baseOffset;
+		std::uint64_t size;
+		std::uint64_t reserved;
+	};
+
+	struct RecordHeader
+	{
+		std::uint32_t size;
+		std::uint32_t checksum;
+	};
+
+	enum : std::uint32_t {
+		segmentMagic = 0x4c4a5045, // "EPJL"
+		segmentVersion = 1
+	};
+
+	enum : std::size_t {
+		recordAlignment = 8,
+		segmentHeaderSize = sizeof(SegmentHeader)
+	};
+
+	// A mapped segment file, it's unmapped by the last owner. commit keeps
+	// a reference, so the segment can be rotated away while it's synced.
+	struct Segment
+	{
+		Segment() : fd(-1), data(nullptr), size(0), baseOffset(0)
+		{
+		}
+
+		~Segment() {
+			if(data != nullptr) {
+				munmap(data, size);
+			}
+			if(fd >= 0) {
+				::close(fd);
+			}
+		}
+
+		Segment(const Segment &) = delete;
+		Segment & operator = (const Segment &) = delete;
+
+		int fd;
+		unsigned char * data;
+		std::size_t size;
+		std::uint64_t baseOffset;
+	};
+
+	using SegmentPtr = std::shared_ptr<Segment>;
+
+public:
+	static constexpr std::uint64_t invalidOffset = (std::numeric_limits<std::uint64_t>::max)();
+
+public:
+	EventJournal()
+		:
+			directory(),
+			options(),
+			mutex(),
+			segment(),
+			writePosition(0),
+			syncedPosition(0),
+			beginOffset(0),
+			syncMutex(),
+			syncThread(),
+			syncConditionVariable(),
+			stopping(false)
+	{
+	}
+
+	~EventJournal()
+	{
+		close();
+	}
+
+	EventJournal(const EventJournal &) = delete;
+	EventJournal & operator = (const EventJournal &) = delete;
+
+	// Opens the journal in directory, which is created if it doesn't exist.
+	// The appended records go after the records which are in it already.
+	bool open(const std::string & directory_, const EventJournalOptions & options_ = EventJournalOptions())
+	{
+		close();
+
+		if(options_.segmentSize < segmentHeaderSize + sizeof(RecordHeader) + recordAlignment) {
+			return false;
+		}
+		if(::mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST) {
+			return false;
+		}
+		directory = directory_;
+		options = options_;
+
+		const std::vector<std::uint64_t> baseOffsetList = doListSegments();
+		if(baseOffsetList.empty()) {
+			segment = doCreateSegment(0);
+			writePosition = segmentHeaderSize;
+		}
+		else {
+			segment = doMapSegment(baseOffsetList.back(), true);
+			if(segment) {
+				writePosition = doFindEnd(*segment);
+				// Clear what a crash left after the last complete record, so
+				// it's not read as a record after the new ones.
+				std::memset(segment->data + writePosition, 0, segment->size - writePosition);
+			}
+		}
+		if(! segment) {
+			directory.clear();
+			return false;
+		}
+		syncedPosition = writePosition;
+		beginOffset = baseOffsetList.empty() ? 0 : baseOffsetList.front();
+
+		if(options.syncInterval.count() > 0) {
+			stopping = false;
+			syncThread = std::thread([this]() {
+				doSyncLoop();
+			});
+		}
+		return true;
+	}
+
+	// Commits and closes the journal.
+	void close()
+	{
+		if(syncThread.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(syncMutex);
+				stopping = true;
+			}
+			syncConditionVariable.notify_one();
+			syncThread.join();
+		}
+		if(segment) {
+			commit();
+			segment.reset();
+		}
+		directory.clear();
+	}
+
+	bool isOpen() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return static_cast<bool>(segment);
+	}
+
+	// Appends a record of size bytes, write(void * buffer) writes them.
+	// Returns the offset of the record, or invalidOffset if the journal is
+	// not open, the record is larger than a segment or the next segment
+	// can't be created.
+	template <typename W>
+	std::uint64_t append(const std::size_t size, W && write)
+	{
+		const std::size_t recordSize = doGetRecordSize(size);
+		std::lock_guard<std::mutex> lock(mutex);
+		if(! segment || recordSize > options.segmentSize - segmentHeaderSize) {
+			return invalidOffset;
+		}
+		if(writePosition + recordSize > segment->size && ! doRotate()) {
+			return invalidOffset;
+		}
+		unsigned char * p = segment->data + writePosition;
+		write(static_cast<void *>(p + sizeof(RecordHeader)));
+		const RecordHeader header {
+			static_cast<std::uint32_t>(size),
+			doGetChecksum(p + sizeof(RecordHeader), size)
+		};
+		std::memcpy(p, &header, sizeof(header));
+		const std::uint64_t offset = segment->baseOffset + writePosition;
+		writePosition += recordSize;
+		return offset;
+	}
+
+	std::uint64_t append(const void * data, const std::size_t size)
+	{
+		return append(size, [data, size](void * buffer) {
+			std::memcpy(buffer, data, size);
+		});
+	}
+
+	// Writes the records appended since the last commit to the disk.
+	// Returns false if the journal is not open or msync fails.
+	bool commit()
+	{
+		SegmentPtr syncedSegment;
+		std::size_t from;
+		std::size_t to;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(! segment) {
+				return false;
+			}
+			if(syncedPosition == writePosition) {
+				return true;
+			}
+			syncedSegment = segment;
+			from = syncedPosition;
+			to = writePosition;
+			syncedPosition = writePosition;
+		}
+		return doSync(*syncedSegment, from, to);
+	}
+
+	// The offset of the first record, the records before it were removed.
+	std::uint64_t getBeginOffset() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return beginOffset;
+	}
+
+	// The offset the next record will be appended at, if it fits in the
+	// current segment.
+	std::uint64_t getEndOffset() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return segment ? segment->baseOffset + writePosition : 0;
+	}
+
+	// Calls func(const void * data, std::size_t size, std::uint64_t offset)
+	// for each record from fromOffset, in the order they were appended.
+	// fromOffset is 0, an offset returned by append, or a value returned by
+	// replay. Returns the offset after the last record read, replaying from
+	// it reads the records appended since.
+	// The records appended while replaying may or may not be read.
+	template <typename F>
+	std::uint64_t replay(const std::uint64_t fromOffset, F && func) const
+	{
+		std::string journalDirectory;
+		std::uint64_t endOffset;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if(! segment) {
+				return fromOffset;
+			}
+			journalDirectory = directory;
+			endOffset = segment->baseOffset + writePosition;
+		}
+
+		const std::vector<std::uint64_t> baseOffsetList = doListSegments(journalDirectory);
+		std::uint64_t offset = fromOffset;
+		for(std::size_t i = 0; i < baseOffsetList.size(); ++i) {
+			const std::uint64_t nextBaseOffset = (i + 1 < baseOffsetList.size() ? baseOffsetList[i + 1] : invalidOffset);
+			if(nextBaseOffset <= offset) {
+				continue;
+			}
+			const SegmentPtr readSegment = doMapSegment(journalDirectory, baseOffsetList[i], false);
+			if(! readSegment) {
+				break;
+			}
+			std::size_t position = segmentHeaderSize;
+			if(offset > readSegment->baseOffset + segmentHeaderSize) {
+				position = static_cast<std::size_t>(offset - readSegment->baseOffset);
+			}
+			bool complete = true;
+			while(readSegment->baseOffset + position < endOffset) {
+				const unsigned char * record = doGetRecord(*readSegment, position);
+				if(record == nullptr) {
+					// The rest of a segment is empty if the next record
+					// didn't fit, the journal goes on in the next one.
+					complete = (nextBaseOffset != invalidOffset && doIsEmpty(*readSegment, position));
+					break;
+				}
+				RecordHeader header;
+				std::memcpy(&header, record, sizeof(header));
+				func(static_cast<const void *>(record + sizeof(RecordHeader)), static_cast<std::size_t>(header.size), readSegment->baseOffset + position);
+				position += doGetRecordSize(header.size);
+			}
+			offset = readSegment->baseOffset + position;
+			if(! complete) {
+				break;
+			}
+			if(nextBaseOffset != invalidOffset) {
+				offset = (std::max)(offset, nextBaseOffset);
+			}
+		}
+		return offset;
+	}
+
+	// Deletes the segment files which only have records before offset,
+	// such as after the events up to offset are processed and saved
+	// elsewhere. The current segment is never deleted. Returns the count
+	// of the files deleted.
+	std::size_t removeSegmentsBefore(const std::uint64_t offset)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if(! segment) {
+			return 0;
+		}
+		const std::vector<std::uint64_t> baseOffsetList = doListSegments();
+		std::size_t count = 0;
+		for(std::size_t i = 0; i + 1 < baseOffsetList.size(); ++i) {
+			if(baseOffsetList[i + 1] > offset || baseOffsetList[i] == segment->baseOffset) {
+				break;
+			}
+			if(::unlink(doGetSegmentPath(directory, baseOffsetList[i]).c_str()) == 0) {
+				++count;
+				beginOffset = baseOffsetList[i + 1];
+			}
+		}
+		return count;
+	}
+
+private:
+	static std::size_t doGetRecordSize(const std::size_t size)
+	{
+		return (sizeof(RecordHeader) + size + recordAlignment - 1) & ~static_cast<std::size_t>(recordAlignment - 1);
+	}
+
+	// FNV-1a, 0 is reserved for the empty space.
+	static std::uint32_t doGetChecksum(const unsigned char * data, const std::size_t size)
+	{
+		std::uint32_t hash = 2166136261u ^ static_cast<std::uint32_t>(size);
+		for(std::size_t i = 0; i < size; ++i) {
+			hash = (hash ^ data[i]) * 16777619u;
+		}
+		return hash == 0 ? 1 : hash;
+	}
+
+	// Returns the record at position, or nullptr if there is no complete
+	// record.
+	static const unsigned char * doGetRecord(const Segment & segment, const std::size_t position)
+	{
+		if(position + sizeof(RecordHeader) > segment.size) {
+			return nullptr;
+		}
+		const unsigned char * record = segment.data + position;
+		RecordHeader header;
+		std::memcpy(&header, record, sizeof(header));
+		if(header.checksum == 0
+			|| doGetRecordSize(header.size) > segment.size - position
+			|| doGetChecksum(record + sizeof(RecordHeader), header.size) != header.checksum) {
+			return nullptr;
+		}
+		return record;
+	}
+
+	static bool doIsEmpty(const Segment & segment, const std::size_t position)
+	{
+		for(std::size_t i = position; i < segment.size && i < position + sizeof(RecordHeader); ++i) {
+			if(segment.data[i] != 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static std::size_t doFindEnd(const Segment & segment)
+	{
+		std::size_t position = segmentHeaderSize;
+		while(const unsigned char * record = doGetRecord(segment, position)) {
+			RecordHeader header;
+			std::memcpy(&header, record, sizeof(header));
+			position += doGetRecordSize(header.size);
+		}
+		return position;
+	}
+
+	static std::string doGetSegmentPath(const std::string & journalDirectory, const std::uint64_t baseOffset)
+	{
+		char name[64];
+		std::snprintf(name, sizeof(name), "/journal-%020llu.log", static_cast<unsigned long long>(baseOffset));
+		return journalDirectory + name;
+	}
+
+	std::vector<std::uint64_t> doListSegments() const
+	{
+		return doListSegments(directory);
+	}
+
+	static std::vector<std::uint64_t> doListSegments(const std::string & journalDirectory)
+	{
+		std::vector<std::uint64_t> baseOffsetList;
+		DIR * dir = ::opendir(journalDirectory.c_str());
+		if(dir == nullptr) {
+			return baseOffsetList;
+		}
+		while(const dirent * entry = ::readdir(dir)) {
+			unsigned long long baseOffset = 0;
+			char tail = 0;
+			if(std::strlen(entry->d_name) == 32
+				&& std::sscanf(entry->d_name, "journal-%20llu.lo%c", &baseOffset, &tail) == 2
+				&& tail == 'g') {
+				baseOffsetList.push_back(static_cast<std::uint64_t>(baseOffset));
+			}
+		}
+		::closedir(dir);
+		std::sort(baseOffsetList.begin(), baseOffsetList.end());
+		return baseOffsetList;
+	}
+
+	SegmentPtr doMapSegment(const std::uint64_t baseOffset, const bool writable) const
+	{
+		return doMapSegment(directory, baseOffset, writable);
+	}
+
+	static SegmentPtr doMapSegment(const std::string & journalDirectory, const std::uint64_t baseOffset, const bool writable)
+	{
+		SegmentPtr result = std::make_shared<Segment>();
+		result->fd = ::open(doGetSegmentPath(journalDirectory, baseOffset).c_str(), writable ? O_RDWR : O_RDONLY);
+		struct stat fileStat;
+		if(result->fd < 0 || ::fstat(result->fd, &fileStat) != 0
+			|| static_cast<std::size_t>(fileStat.st_size) < segmentHeaderSize) {
+			return SegmentPtr();
+		}
+		result->size = static_cast<std::size_t>(fileStat.st_size);
+		void * data = ::mmap(nullptr, result->size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, result->fd, 0);
+		if(data == MAP_FAILED) {
+			return SegmentPtr();
+		}
+		result->data = static_cast<unsigned char *>(data);
+
+		SegmentHeader header;
+		std::memcpy(&header, result->data, sizeof(header));
+		if(header.magic != segmentMagic || header.version != segmentVersion
+			|| header.baseOffset != baseOffset || header.size != result->size) {
+			return SegmentPtr();
+		}
+		result->baseOffset = baseOffset;
+		return result;
+	}
+
+	// The file is sized and synced once here, so msync of the records is
+	// enough to make them durable.
+	SegmentPtr doCreateSegment(const std::uint64_t baseOffset)
+	{
+		const std::string path = doGetSegmentPath(directory, baseOffset);
+		SegmentPtr result = std::make_shared<Segment>();
+		result->fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if(result->fd < 0) {
+			return SegmentPtr();
+		}
+		result->size = options.segmentSize;
+		result->baseOffset = baseOffset;
+		void * data = MAP_FAILED;
+		if(::ftruncate(result->fd, static_cast<off_t>(result->size)) == 0) {
+			data = ::mmap(nullptr, result->size, PROT_READ | PROT_WRITE, MAP_SHARED, result->fd, 0);
+		}
+		if(data == MAP_FAILED) {
+			::unlink(path.c_str());
+			return SegmentPtr();
+		}
+		result->data = static_cast<unsigned char *>(data);
+
+		const SegmentHeader header { segmentMagic, segmentVersion, baseOffset, result->size, 0 };
+		std::memcpy(result->data, &header, sizeof(header));
+		if(::msync(result->data, segmentHeaderSize, MS_SYNC) != 0 || ::fsync(result->fd) != 0) {
+			::unlink(path.c_str());
+			return SegmentPtr();
+		}
+		doSyncDirectory();
+		return result;
+	}
+
+	void doSyncDirectory() const
+	{
+		const int fd = ::open(directory.c_str(), O_RDONLY);
+		if(fd >= 0) {
+			::fsync(fd);
+			::close(fd);
+		}
+	}
+
+	// Called with mutex locked. The records of the full segment are synced
+	// before it's left, so commit only needs to sync the current segment.
+	bool doRotate()
+	{
+		SegmentPtr nextSegment = doCreateSegment(segment->baseOffset + segment->size);
+		if(! nextSegment) {
+			return false;
+		}
+		doSync(*segment, syncedPosition, writePosition);
+		segment = std::move(nextSegment);
+		writePosition = segmentHeaderSize;
+		syncedPosition = writePosition;
+		return true;
+	}
+
+	static bool doSync(const Segment & syncedSegment, const std::size_t from, const std::size_t to)
+	{
+		if(from >= to) {
+			return true;
+		}
+		const std::size_t pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+		const std::size_t begin = from & ~(pageSize - 1);
+		return ::msync(syncedSegment.data + begin, to - begin, MS_SYNC) == 0;
+	}
+
+	void doSyncLoop()
+	{
+		std::unique_lock<std::mutex> lock(syncMutex);
+		while(! stopping) {
+			syncConditionVariable.wait_for(lock, options.syncInterval);
+			if(stopping) {
+				break;
+			}
+			lock.unlock();
+			commit();
+			lock.lock();
+		}
+	}
+
+private:
+	std::string directory;
+	EventJournalOptions options;
+
+	mutable std::mutex mutex;
+	SegmentPtr segment;
+	std::size_t writePosition;
+	std::size_t syncedPosition;
+	std::uint64_t beginOffset;
+
+	std::mutex syncMutex;
+	std::thread syncThread;
+	std::condition_variable syncConditionVariable;
+	bool stopping;
+};
+
+
+} //namespace eventpp
+
+#endif
+
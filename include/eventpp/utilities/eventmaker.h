@@ -97,7 +97,7 @@
 #define EVENTPP_ADD_BRACKETS(x) EVENTPP_IF(EVENTPP_IS_ENCLOSED_BY_BRACKETS(x), x, (x))
 #define EVENTPP_REMOVE_BRACKETS(x) EVENTPP_BRACKETS_EXPAND(EVENTPP_IF(EVENTPP_IS_ENCLOSED_BY_BRACKETS(x), (EVENTPP_EXPAND x), (x)))
 
-#define I_EVENTPP_MAKE_EVENT(className, baseClassName, baseClassArgs, ...) \
+#define I_EVENTPP_MAKE_EVENT_WITH(EXTRA, className, baseClassName, baseClassArgs, ...) \
 	class className : public EVENTPP_REMOVE_BRACKETS(baseClassName) { \
 		public: \
 			className() \
@@ -108,19 +108,40 @@
 					EVENTPP_ITERATE_ARGS(EVENTPP_EXEC_MAKE_INITIALIZE, EVENTPP_COMMA, __VA_ARGS__) {} \
 			EVENTPP_ITERATE_ARGS(EVENTPP_EXEC_MAKE_GETTER, EVENTPP_EMPTY, __VA_ARGS__) \
 			EVENTPP_ITERATE_ARGS(EVENTPP_EXEC_MAKE_SETTER, EVENTPP_EMPTY, __VA_ARGS__) \
+			EXTRA(className) \
 		private: \
 			EVENTPP_ITERATE_ARGS(EVENTPP_EXEC_MAKE_FIELD, EVENTPP_SEMICOLON, __VA_ARGS__); \
 	}
 
+#define I_EVENTPP_MAKE_NO_EXTRA(className)
+
+// OPT-70: The pooled events are created from the NodePool of their own type,
+// the root base class must derive from eventpp::IntrusiveRefCounted, and
+// eventpp/utilities/intrusiveptr.h must be included.
+#define I_EVENTPP_MAKE_POOLED_EXTRA(className) \
+	template <typename ...EventppArgs> \
+	static ::eventpp::IntrusivePtr<className> create(EventppArgs && ...args) { \
+		return ::eventpp::makePooled<className>(std::forward<EventppArgs>(args)...); \
+	}
+
+#define I_EVENTPP_MAKE_EVENT(className, baseClassName, baseClassArgs, ...) I_EVENTPP_MAKE_EVENT_WITH(I_EVENTPP_MAKE_NO_EXTRA, className, baseClassName, baseClassArgs, __VA_ARGS__)
+
 #define EVENTPP_MAKE_EVENT(className, baseClassName, baseClassArgs, ...) EVENTPP_EXPAND(I_EVENTPP_MAKE_EVENT(className, baseClassName, baseClassArgs, __VA_ARGS__))
 
-#define EVENTPP_MAKE_EMPTY_EVENT(className, baseClassName, baseClassArgs) \
+#define EVENTPP_MAKE_POOLED_EVENT(className, baseClassName, baseClassArgs, ...) EVENTPP_EXPAND(I_EVENTPP_MAKE_EVENT_WITH(I_EVENTPP_MAKE_POOLED_EXTRA, className, baseClassName, baseClassArgs, __VA_ARGS__))
+
+#define I_EVENTPP_MAKE_EMPTY_EVENT_WITH(EXTRA, className, baseClassName, baseClassArgs) \
 	class className : public EVENTPP_REMOVE_BRACKETS(baseClassName) { \
 		public: \
 			className() \
 				: EVENTPP_REMOVE_BRACKETS(baseClassName) EVENTPP_ADD_BRACKETS(baseClassArgs) {} \
+			EXTRA(className) \
 	}
 
+#define EVENTPP_MAKE_EMPTY_EVENT(className, baseClassName, baseClassArgs) I_EVENTPP_MAKE_EMPTY_EVENT_WITH(I_EVENTPP_MAKE_NO_EXTRA, className, baseClassName, baseClassArgs)
+
+#define EVENTPP_MAKE_POOLED_EMPTY_EVENT(className, baseClassName, baseClassArgs) I_EVENTPP_MAKE_EMPTY_EVENT_WITH(I_EVENTPP_MAKE_POOLED_EXTRA, className, baseClassName, baseClassArgs)
+
 
 #endif
 
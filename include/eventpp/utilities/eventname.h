@@ -0,0 +1,151 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef EVENTNAME_H_EVENTPP
+#define EVENTNAME_H_EVENTPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+namespace eventpp {
+
+namespace eventname_internal_ {
+
+// FNV-1a, 64 bits.
+constexpr std::uint64_t getNameHash(const char * data, const std::size_t size)
+{
+	std::uint64_t hash = 14695981039346656037ull;
+	for(std::size_t i = 0; i < size; ++i) {
+		hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+	}
+	return hash;
+}
+
+constexpr bool isSameName(const char * a, const char * b, const std::size_t size)
+{
+	for(std::size_t i = 0; i < size; ++i) {
+		if(a[i] != b[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} //namespace eventname_internal_
+
+// OPT-45: An event ID which is a string with its hash computed when it's
+// made, at compile time for the literals, "order.filled"_evt. std::hash
+// returns the stored hash, so the maps hash nothing when an event is
+// dispatched, and == compares the hashes, then the pointers, and only then
+// the characters.
+// EventName doesn't own the characters. They are a string literal, or are
+// interned by intern, which keeps them until the program ends and gives the
+// same pointer for the same string.
+class EventName
+{
+public:
+	constexpr EventName()
+		: hash(eventname_internal_::getNameHash("", 0)), data(""), size(0)
+	{
+	}
+
+	// data must live as long as the EventName and its copies.
+	constexpr EventName(const char * data, const std::size_t size)
+		: hash(eventname_internal_::getNameHash(data, size)), data(data), size(size)
+	{
+	}
+
+	static EventName intern(const std::string & name)
+	{
+		static std::mutex * mutex = new std::mutex();
+		// Never destroyed, the names may be used after main returns.
+		static std::unordered_set<std::string> * nameSet = new std::unordered_set<std::string>();
+
+		std::lock_guard<std::mutex> lockGuard(*mutex);
+		const std::string & interned = *nameSet->insert(name).first;
+		return EventName(interned.data(), interned.size());
+	}
+
+	constexpr std::uint64_t getHash() const {
+		return hash;
+	}
+
+	constexpr const char * getData() const {
+		return data;
+	}
+
+	constexpr std::size_t getSize() const {
+		return size;
+	}
+
+	std::string toString() const {
+		return std::string(data, size);
+	}
+
+private:
+	std::uint64_t hash;
+	const char * data;
+	std::size_t size;
+};
+
+constexpr bool operator == (const EventName & a, const EventName & b)
+{
+	return a.getHash() == b.getHash()
+		&& (a.getData() == b.getData()
+			|| (a.getSize() == b.getSize() && eventname_internal_::isSameName(a.getData(), b.getData(), a.getSize())))
+	;
+}
+
+constexpr bool operator != (const EventName & a, const EventName & b)
+{
+	return ! (a == b);
+}
+
+// The order of the hashes, not the alphabetical order.
+inline bool operator < (const EventName & a, const EventName & b)
+{
+	if(a.getHash() != b.getHash()) {
+		return a.getHash() < b.getHash();
+	}
+	return a.toString() < b.toString();
+}
+
+namespace literals {
+
+constexpr EventName operator""_evt(const char * data, const std::size_t size)
+{
+	return EventName(data, size);
+}
+
+} //namespace literals
+
+} //namespace eventpp
+
+namespace std
+{
+template <>
+struct hash<eventpp::EventName>
+{
+	std::size_t operator()(const eventpp::EventName & value) const noexcept
+	{
+		return static_cast<std::size_t>(value.getHash());
+	}
+};
+} //namespace std
+
+#endif
+
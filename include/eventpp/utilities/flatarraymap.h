@@ -0,0 +1,112 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FLATARRAYMAP_H_EVENTPP
+#define FLATARRAYMAP_H_EVENTPP
+
+#include <vector>
+#include <cstddef>
+#include <cassert>
+#include <utility>
+
+namespace eventpp {
+
+// OPT-19: Map policy for dense integer or enum event types in [0, size).
+// All slots are allocated up front and the event value is the index, so
+// find() is a bound check and an array access, and the map never changes
+// its structure after construction, which makes EventDispatcher::seal cheap.
+template <typename Key, typename T, std::size_t size_>
+class FlatArrayMap
+{
+public:
+	struct value_type
+	{
+		Key first;
+		T second;
+	};
+
+	using key_type = Key;
+	using mapped_type = T;
+	using size_type = std::size_t;
+	using iterator = value_type *;
+	using const_iterator = const value_type *;
+
+public:
+	FlatArrayMap()
+		: slotList(size_)
+	{
+		for(std::size_t i = 0; i < size_; ++i) {
+			slotList[i].first = static_cast<Key>(i);
+		}
+	}
+
+	// key must be in [0, size).
+	T & operator[] (const Key & key) {
+		assert(doIsInRange(key));
+		return slotList[static_cast<std::size_t>(key)].second;
+	}
+
+	iterator find(const Key & key) {
+		return doIsInRange(key) ? &slotList[static_cast<std::size_t>(key)] : end();
+	}
+
+	const_iterator find(const Key & key) const {
+		return doIsInRange(key) ? &slotList[static_cast<std::size_t>(key)] : end();
+	}
+
+	iterator begin() {
+		return slotList.data();
+	}
+
+	const_iterator begin() const {
+		return slotList.data();
+	}
+
+	iterator end() {
+		return slotList.data() + slotList.size();
+	}
+
+	const_iterator end() const {
+		return slotList.data() + slotList.size();
+	}
+
+	// A moved from map has no slot.
+	size_type size() const {
+		return slotList.size();
+	}
+
+	bool empty() const {
+		return slotList.empty();
+	}
+
+	void swap(FlatArrayMap & other) noexcept {
+		slotList.swap(other.slotList);
+	}
+
+	friend void swap(FlatArrayMap & first, FlatArrayMap & second) noexcept {
+		first.swap(second);
+	}
+
+private:
+	bool doIsInRange(const Key & key) const {
+		return static_cast<std::size_t>(key) < slotList.size();
+	}
+
+private:
+	std::vector<value_type> slotList;
+};
+
+
+} //namespace eventpp
+
+#endif
@@ -0,0 +1,285 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INPLACEFUNCTION_H_473920516834
+#define INPLACEFUNCTION_H_473920516834
+
+#include <cstddef>
+#include <cassert>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace eventpp {
+
+namespace inplacefunction_internal_ {
+
+template <typename RT, typename ...Args>
+struct InplaceFunctionFunctions
+{
+	RT (*invoke)(void *, Args && ...);
+	void (*copyConstruct)(const void *, void *);
+	void (*moveConstruct)(void *, void *);
+	void (*free)(void *);
+	// Only set when the target is a function pointer, used by operator ==.
+	bool (*equal)(const void *, const void *);
+};
+
+template <typename F, typename RT, typename ...Args>
+auto doFuncInvoke(void * object, Args && ...args)
+	-> typename std::enable_if<std::is_void<RT>::value, RT>::type
+{
+	// The return value of the target, if any, is discarded, same as std::function.
+	(*static_cast<F *>(object))(std::forward<Args>(args)...);
+}
+
+template <typename F, typename RT, typename ...Args>
+auto doFuncInvoke(void * object, Args && ...args)
+	-> typename std::enable_if<! std::is_void<RT>::value, RT>::type
+{
+	return (*static_cast<F *>(object))(std::forward<Args>(args)...);
+}
+
+template <typename F, typename RT, typename ...Args>
+RT funcInvoke(void * object, Args && ...args)
+{
+	return doFuncInvoke<F, RT, Args...>(object, std::forward<Args>(args)...);
+}
+
+template <typename F>
+void funcCopyConstruct(const void * object, void * buffer)
+{
+	new (buffer) F(*static_cast<const F *>(object));
+}
+
+template <typename F>
+void funcMoveConstruct(void * object, void * buffer)
+{
+	new (buffer) F(std::move(*static_cast<F *>(object)));
+}
+
+template <typename F>
+void funcFreeObject(void * object)
+{
+	static_cast<F *>(object)->~F();
+}
+
+template <typename F>
+bool funcEqual(const void * object, const void * other)
+{
+	return *static_cast<const F *>(object) == *static_cast<const F *>(other);
+}
+
+template <typename F>
+struct IsFunctionPointer : std::integral_constant<bool,
+	std::is_pointer<F>::value && std::is_function<typename std::remove_pointer<F>::type>::value>
+{
+};
+
+template <typename F>
+auto getFuncEqual()
+	-> typename std::enable_if<IsFunctionPointer<F>::value, bool (*)(const void *, const void *)>::type
+{
+	return &funcEqual<F>;
+}
+
+template <typename F>
+auto getFuncEqual()
+	-> typename std::enable_if<! IsFunctionPointer<F>::value, bool (*)(const void *, const void *)>::type
+{
+	return nullptr;
+}
+
+template <typename F, typename RT, typename ...Args>
+const InplaceFunctionFunctions<RT, Args...> * getInplaceFunctionFunctions()
+{
+	static const InplaceFunctionFunctions<RT, Args...> functions {
+		&funcInvoke<F, RT, Args...>,
+		&funcCopyConstruct<F>,
+		&funcMoveConstruct<F>,
+		&funcFreeObject<F>,
+		getFuncEqual<F>()
+	};
+	return &functions;
+}
+
+template <typename F>
+bool isNullFunction(const F & func, typename std::enable_if<IsFunctionPointer<F>::value>::type * = 0)
+{
+	return func == nullptr;
+}
+
+template <typename F>
+bool isNullFunction(const F &, typename std::enable_if<! IsFunctionPointer<F>::value>::type * = 0)
+{
+	return false;
+}
+
+} //namespace inplacefunction_internal_
+
+// OPT-23: A std::function replacement which never allocates. The target is stored
+// in a buffer of capacity bytes, a target which doesn't fit is a compile error.
+// It can be used as the Callback policy,
+//   struct MyPolicies {
+//     using Callback = eventpp::InplaceFunction<void (int), 48>;
+//   };
+template <typename Prototype, std::size_t capacity = 32>
+class InplaceFunction;
+
+template <typename RT, typename ...Args, std::size_t capacity>
+class InplaceFunction <RT (Args...), capacity>
+{
+private:
+	using Functions = inplacefunction_internal_::InplaceFunctionFunctions<RT, Args...>;
+
+	static_assert(capacity >= sizeof(void *), "InplaceFunction: capacity must be at least sizeof(void *)");
+
+	template <typename F>
+	using IsCallable = std::integral_constant<bool,
+		! std::is_same<typename std::decay<F>::type, InplaceFunction>::value
+		&& ! std::is_same<typename std::decay<F>::type, std::nullptr_t>::value
+	>;
+
+public:
+	using result_type = RT;
+
+	InplaceFunction() noexcept : functions(nullptr) {
+	}
+
+	InplaceFunction(std::nullptr_t) noexcept : functions(nullptr) {
+	}
+
+	template <typename F, typename std::enable_if<IsCallable<F>::value>::type * = nullptr>
+	InplaceFunction(F && func) : functions(nullptr) {
+		using U = typename std::decay<F>::type;
+		static_assert(sizeof(U) <= capacity, "InplaceFunction: the callable is larger than capacity");
+		static_assert(alignof(U) <= alignof(std::max_align_t), "InplaceFunction: the callable is over aligned");
+		static_assert(std::is_copy_constructible<U>::value, "InplaceFunction: the callable must be copy constructible");
+
+		if(! inplacefunction_internal_::isNullFunction(func)) {
+			new (buffer) U(std::forward<F>(func));
+			functions = inplacefunction_internal_::getInplaceFunctionFunctions<U, RT, Args...>();
+		}
+	}
+
+	InplaceFunction(const InplaceFunction & other) : functions(other.functions) {
+		if(functions != nullptr) {
+			functions->copyConstruct(other.buffer, buffer);
+		}
+	}
+
+	InplaceFunction(InplaceFunction && other) noexcept : functions(other.functions) {
+		if(functions != nullptr) {
+			functions->moveConstruct(other.buffer, buffer);
+		}
+	}
+
+	~InplaceFunction() {
+		reset();
+	}
+
+	InplaceFunction & operator = (const InplaceFunction & other) {
+		if(this != &other) {
+			InplaceFunction copied(other);
+			*this = std::move(copied);
+		}
+		return *this;
+	}
+
+	InplaceFunction & operator = (InplaceFunction && other) noexcept {
+		if(this != &other) {
+			reset();
+			if(other.functions != nullptr) {
+				other.functions->moveConstruct(other.buffer, buffer);
+				functions = other.functions;
+			}
+		}
+		return *this;
+	}
+
+	InplaceFunction & operator = (std::nullptr_t) noexcept {
+		reset();
+		return *this;
+	}
+
+	RT operator() (Args ...args) const {
+		assert(functions != nullptr);
+
+		return functions->invoke(buffer, std::forward<Args>(args)...);
+	}
+
+	explicit operator bool () const noexcept {
+		return functions != nullptr;
+	}
+
+	void swap(InplaceFunction & other) noexcept {
+		InplaceFunction temp(std::move(other));
+		other = std::move(*this);
+		*this = std::move(temp);
+	}
+
+	// Two InplaceFunction are equal if both are empty, or both hold the same
+	// function pointer. Other callables never compare equal.
+	bool operator == (const InplaceFunction & other) const noexcept {
+		if(functions != other.functions) {
+			return false;
+		}
+		return functions == nullptr
+			|| (functions->equal != nullptr && functions->equal(buffer, other.buffer));
+	}
+
+	bool operator != (const InplaceFunction & other) const noexcept {
+		return ! (*this == other);
+	}
+
+	friend bool operator == (const InplaceFunction & func, std::nullptr_t) noexcept {
+		return ! func;
+	}
+
+	friend bool operator == (std::nullptr_t, const InplaceFunction & func) noexcept {
+		return ! func;
+	}
+
+	friend bool operator != (const InplaceFunction & func, std::nullptr_t) noexcept {
+		return !! func;
+	}
+
+	friend bool operator != (std::nullptr_t, const InplaceFunction & func) noexcept {
+		return !! func;
+	}
+
+private:
+	void reset() noexcept {
+		if(functions != nullptr) {
+			functions->free(buffer);
+			functions = nullptr;
+		}
+	}
+
+private:
+	const Functions * functions;
+	// mutable because operator() is const, same as std::function.
+	alignas(std::max_align_t) mutable unsigned char buffer[capacity];
+};
+
+template <typename Prototype, std::size_t capacity>
+void swap(InplaceFunction<Prototype, capacity> & first, InplaceFunction<Prototype, capacity> & second) noexcept
+{
+	first.swap(second);
+}
+
+
+} //namespace eventpp
+
+#endif
+
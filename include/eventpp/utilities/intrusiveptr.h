@@ -0,0 +1,258 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef INTRUSIVEPTR_H_604718293551
+#define INTRUSIVEPTR_H_604718293551
+
+#include "../internal/poolallocator_i.h"
+
+#include <atomic>
+#include <type_traits>
+#include <cstddef>
+#include <cassert>
+#include <new>
+#include <utility>
+
+namespace eventpp {
+
+// OPT-70: Base class of the intrusively reference counted events.
+// The count lives in the object, so IntrusivePtr is a single pointer and
+// copying it is one atomic increment, versus std::shared_ptr which is two
+// pointers and a separate control block (or one make_shared allocation).
+// The object remembers how to destroy itself (delete, or give the memory
+// back to the pool of its most derived type), so the base class doesn't
+// need a virtual destructor.
+class IntrusiveRefCounted
+{
+public:
+	using Destroyer = void (*)(IntrusiveRefCounted *);
+
+	IntrusiveRefCounted() noexcept : referenceCount(0), destroyer(nullptr) {
+	}
+
+	// Copying an event doesn't copy its count nor its owner.
+	IntrusiveRefCounted(const IntrusiveRefCounted &) noexcept : referenceCount(0), destroyer(nullptr) {
+	}
+
+	IntrusiveRefCounted & operator = (const IntrusiveRefCounted &) noexcept {
+		return *this;
+	}
+
+	std::size_t getReferenceCount() const noexcept {
+		return referenceCount.load(std::memory_order_relaxed);
+	}
+
+	void intrusiveAddReference() const noexcept {
+		referenceCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void intrusiveRelease() const noexcept {
+		if(referenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			assert(destroyer != nullptr);
+			destroyer(const_cast<IntrusiveRefCounted *>(this));
+		}
+	}
+
+	void intrusiveSetDestroyer(const Destroyer newDestroyer) noexcept {
+		destroyer = newDestroyer;
+	}
+
+protected:
+	~IntrusiveRefCounted() = default;
+
+private:
+	mutable std::atomic<std::size_t> referenceCount;
+	Destroyer destroyer;
+};
+
+struct IntrusiveAdoptTag {};
+
+template <typename T>
+class IntrusivePtr
+{
+public:
+	using element_type = T;
+
+	IntrusivePtr() noexcept : object(nullptr) {
+	}
+
+	IntrusivePtr(std::nullptr_t) noexcept : object(nullptr) {
+	}
+
+	explicit IntrusivePtr(T * object) noexcept : object(object) {
+		if(object != nullptr) {
+			object->intrusiveAddReference();
+		}
+	}
+
+	// Takes over a reference which is already counted, such as from detach().
+	IntrusivePtr(T * object, IntrusiveAdoptTag) noexcept : object(object) {
+	}
+
+	IntrusivePtr(const IntrusivePtr & other) noexcept : IntrusivePtr(other.object) {
+	}
+
+	IntrusivePtr(IntrusivePtr && other) noexcept : object(other.object) {
+		other.object = nullptr;
+	}
+
+	template <typename U, typename = typename std::enable_if<std::is_convertible<U *, T *>::value>::type>
+	IntrusivePtr(const IntrusivePtr<U> & other) noexcept : IntrusivePtr(other.get()) {
+	}
+
+	template <typename U, typename = typename std::enable_if<std::is_convertible<U *, T *>::value>::type>
+	IntrusivePtr(IntrusivePtr<U> && other) noexcept : object(other.detach()) {
+	}
+
+	~IntrusivePtr() {
+		if(object != nullptr) {
+			object->intrusiveRelease();
+		}
+	}
+
+	IntrusivePtr & operator = (IntrusivePtr other) noexcept {
+		swap(other);
+		return *this;
+	}
+
+	void reset() noexcept {
+		IntrusivePtr().swap(*this);
+	}
+
+	void reset(T * newObject) noexcept {
+		IntrusivePtr(newObject).swap(*this);
+	}
+
+	// Gives up the ownership without releasing the reference.
+	T * detach() noexcept {
+		T * result = object;
+		object = nullptr;
+		return result;
+	}
+
+	void swap(IntrusivePtr & other) noexcept {
+		std::swap(object, other.object);
+	}
+
+	T * get() const noexcept {
+		return object;
+	}
+
+	T & operator * () const noexcept {
+		return *object;
+	}
+
+	T * operator -> () const noexcept {
+		return object;
+	}
+
+	explicit operator bool() const noexcept {
+		return object != nullptr;
+	}
+
+private:
+	T * object;
+};
+
+template <typename T, typename U>
+bool operator == (const IntrusivePtr<T> & a, const IntrusivePtr<U> & b) noexcept
+{
+	return a.get() == b.get();
+}
+
+template <typename T, typename U>
+bool operator != (const IntrusivePtr<T> & a, const IntrusivePtr<U> & b) noexcept
+{
+	return a.get() != b.get();
+}
+
+template <typename T>
+bool operator == (const IntrusivePtr<T> & a, std::nullptr_t) noexcept
+{
+	return a.get() == nullptr;
+}
+
+template <typename T>
+bool operator != (const IntrusivePtr<T> & a, std::nullptr_t) noexcept
+{
+	return a.get() != nullptr;
+}
+
+template <typename T, typename U>
+IntrusivePtr<T> staticPointerCast(const IntrusivePtr<U> & ptr) noexcept
+{
+	return IntrusivePtr<T>(static_cast<T *>(ptr.get()));
+}
+
+template <typename T, typename U>
+IntrusivePtr<T> staticPointerCast(IntrusivePtr<U> && ptr) noexcept
+{
+	return IntrusivePtr<T>(static_cast<T *>(ptr.detach()), IntrusiveAdoptTag());
+}
+
+namespace intrusiveptr_internal_ {
+
+template <typename T>
+void destroyByDelete(IntrusiveRefCounted * object)
+{
+	delete static_cast<T *>(object);
+}
+
+template <typename T, std::size_t slabCapacity>
+void destroyToPool(IntrusiveRefCounted * object)
+{
+	T * t = static_cast<T *>(object);
+	t->~T();
+	internal_::NodePool<T, slabCapacity>::instance().deallocate(t);
+}
+
+} //namespace intrusiveptr_internal_
+
+template <typename T, typename ...A>
+IntrusivePtr<T> makeIntrusive(A && ...args)
+{
+	static_assert(std::is_base_of<IntrusiveRefCounted, T>::value, "makeIntrusive: T must derive from IntrusiveRefCounted.");
+
+	T * object = new T(std::forward<A>(args)...);
+	object->intrusiveSetDestroyer(&intrusiveptr_internal_::destroyByDelete<T>);
+	return IntrusivePtr<T>(object);
+}
+
+// Each type T has its own NodePool (OPT-9/20/22), so the events of the
+// same type are allocated from the same slabs and recycled through the
+// thread caches without touching the global heap.
+template <typename T, std::size_t slabCapacity = 256, typename ...A>
+IntrusivePtr<T> makePooled(A && ...args)
+{
+	static_assert(std::is_base_of<IntrusiveRefCounted, T>::value, "makePooled: T must derive from IntrusiveRefCounted.");
+
+	using Pool = internal_::NodePool<T, slabCapacity>;
+	T * memory = Pool::instance().allocate();
+	if(memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	T * object;
+	try {
+		object = new (memory) T(std::forward<A>(args)...);
+	}
+	catch(...) {
+		Pool::instance().deallocate(memory);
+		throw;
+	}
+	object->intrusiveSetDestroyer(&intrusiveptr_internal_::destroyToPool<T, slabCapacity>);
+	return IntrusivePtr<T>(object);
+}
+
+} //namespace eventpp
+
+#endif
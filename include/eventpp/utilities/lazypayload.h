@@ -0,0 +1,536 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LAZYPAYLOAD_H_EVENTPP
+#define LAZYPAYLOAD_H_EVENTPP
+
+#include "anydata.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace eventpp {
+
+enum : std::size_t {
+	// Returned by the getSize of a field which can't tell its size.
+	lazyBadSize = static_cast<std::size_t>(-1)
+};
+
+struct LazyByteView
+{
+	const std::uint8_t * data;
+	std::size_t size;
+};
+
+// OPT-80: The fields of a LazySchema. A field has
+//   Type, the decoded type,
+//   fixedSize, the size of the field, or 0 if it's variable,
+//   getSize(data, available), the size of the field at data, or lazyBadSize,
+//   decode(data, size), which decodes the field.
+// The values are in the byte order of the host.
+template <typename T>
+struct LazyValue
+{
+	static_assert(std::is_trivially_copyable<T>::value, "LazyValue: T must be trivially copyable.");
+
+	using Type = T;
+
+	enum : std::size_t { fixedSize = sizeof(T) };
+
+	static std::size_t getSize(const std::uint8_t * /*data*/, const std::size_t /*available*/) {
+		return sizeof(T);
+	}
+
+	static T decode(const std::uint8_t * data, const std::size_t /*size*/) {
+		T value;
+		std::memcpy(&value, data, sizeof(T));
+		return value;
+	}
+};
+
+// A std::uint32_t length followed by the bytes, decoded as a view of the
+// bytes, which lives as long as the payload.
+struct LazyBytes
+{
+	using Type = LazyByteView;
+
+	enum : std::size_t { fixedSize = 0 };
+
+	static std::size_t getSize(const std::uint8_t * data, const std::size_t available) {
+		if(available < sizeof(std::uint32_t)) {
+			return lazyBadSize;
+		}
+		std::uint32_t length;
+		std::memcpy(&length, data, sizeof(length));
+		return sizeof(length) + length;
+	}
+
+	static LazyByteView decode(const std::uint8_t * data, const std::size_t size) {
+		return LazyByteView { data + sizeof(std::uint32_t), size - sizeof(std::uint32_t) };
+	}
+};
+
+// As LazyBytes, decoded as std::string.
+struct LazyString : LazyBytes
+{
+	using Type = std::string;
+
+	static std::string decode(const std::uint8_t * data, const std::size_t size) {
+		return std::string(
+			reinterpret_cast<const char *>(data) + sizeof(std::uint32_t),
+			size - sizeof(std::uint32_t)
+		);
+	}
+};
+
+template <typename ...Fields>
+struct LazySchema
+{
+};
+
+namespace lazypayload_internal_ {
+
+enum : std::uint32_t {
+	badOffset = 0xffffffffu
+};
+
+// Followed by the bytes, and preceded by the offsets of the fields, which
+// are found on the first access. offsets[i] is the begin of field i, and
+// offsets[fieldCount] is the end of the last field. The first knownCount
+// offsets are found, a missing field and the fields after it are badOffset.
+struct alignas(std::max_align_t) Header
+{
+	std::atomic<std::size_t> referenceCount;
+	std::atomic<std::uint32_t> knownCount;
+	std::uint32_t blockOffset;
+	std::size_t blockSize;
+	const void * schemaKey;
+};
+
+using Offset = std::atomic<std::uint32_t>;
+
+// The blocks up to maxPooledBlockSize come from the pools of AnyData.
+enum : std::size_t {
+	maxPooledBlockSize = 4096
+};
+
+template <std::size_t size>
+void * allocatePooledBlock()
+{
+	return anydata_internal_::doAllocateLarge<size, maxPooledBlockSize>();
+}
+
+template <std::size_t size>
+void freePooledBlock(void * block)
+{
+	anydata_internal_::doFreeLarge<size, maxPooledBlockSize>(block);
+}
+
+struct BlockClass
+{
+	std::size_t size;
+	void * (*allocate)();
+	void (*free)(void *);
+};
+
+inline const BlockClass * findBlockClass(const std::size_t blockSize)
+{
+	static const BlockClass blockClassList[] = {
+		{ 64, &allocatePooledBlock<64>, &freePooledBlock<64> },
+		{ 128, &allocatePooledBlock<128>, &freePooledBlock<128> },
+		{ 256, &allocatePooledBlock<256>, &freePooledBlock<256> },
+		{ 512, &allocatePooledBlock<512>, &freePooledBlock<512> },
+		{ 1024, &allocatePooledBlock<1024>, &freePooledBlock<1024> },
+		{ 2048, &allocatePooledBlock<2048>, &freePooledBlock<2048> },
+		{ 4096, &allocatePooledBlock<4096>, &freePooledBlock<4096> },
+	};
+	for(const BlockClass & blockClass : blockClassList) {
+		if(blockSize <= blockClass.size) {
+			return &blockClass;
+		}
+	}
+	return nullptr;
+}
+
+inline std::size_t getBlockOffset(const std::size_t fieldCount)
+{
+	const std::size_t offsetsSize = sizeof(Offset) * (fieldCount + 1);
+	return (offsetsSize + alignof(Header) - 1) / alignof(Header) * alignof(Header);
+}
+
+inline Header * getHeader(const std::uint8_t * data)
+{
+	return reinterpret_cast<Header *>(const_cast<std::uint8_t *>(data)) - 1;
+}
+
+inline Offset * getOffsets(Header * header, const std::size_t fieldCount)
+{
+	return reinterpret_cast<Offset *>(header) - (fieldCount + 1);
+}
+
+// Returns the bytes of a new block with the reference count 1.
+inline std::uint8_t * allocatePayload(const std::size_t size, const std::size_t fieldCount, const void * schemaKey)
+{
+	assert(size < badOffset);
+
+	const std::size_t blockOffset = getBlockOffset(fieldCount);
+	const std::size_t blockSize = blockOffset + sizeof(Header) + size;
+	const BlockClass * blockClass = findBlockClass(blockSize);
+	void * block = (blockClass != nullptr ? blockClass->allocate() : ::operator new(blockSize));
+
+	Header * header = new (static_cast<char *>(block) + blockOffset) Header;
+	header->referenceCount.store(1, std::memory_order_relaxed);
+	header->knownCount.store(1, std::memory_order_relaxed);
+	header->blockOffset = static_cast<std::uint32_t>(blockOffset);
+	header->blockSize = blockSize;
+	header->schemaKey = schemaKey;
+
+	Offset * offsets = getOffsets(header, fieldCount);
+	for(std::size_t i = 0; i <= fieldCount; ++i) {
+		new (&offsets[i]) Offset(0);
+	}
+
+	return reinterpret_cast<std::uint8_t *>(header + 1);
+}
+
+inline void freePayload(Header * header)
+{
+	void * block = reinterpret_cast<char *>(header) - header->blockOffset;
+	const BlockClass * blockClass = findBlockClass(header->blockSize);
+	header->~Header();
+	if(blockClass != nullptr) {
+		blockClass->free(block);
+	}
+	else {
+		::operator delete(block);
+	}
+}
+
+constexpr std::size_t addFixedSize(const std::size_t fieldSize, const std::size_t offset)
+{
+	return (fieldSize == 0 || offset == lazyBadSize) ? lazyBadSize : fieldSize + offset;
+}
+
+// The offset of field index if all the fields before it are fixed size,
+// otherwise lazyBadSize.
+template <std::size_t index, typename ...Fields>
+struct FixedOffset
+{
+	enum : std::size_t { value = 0 };
+};
+
+template <std::size_t index, typename F, typename ...Fields>
+struct FixedOffset <index, F, Fields...>
+{
+	enum : std::size_t {
+		value = (index == 0
+			? 0
+			: addFixedSize(F::fixedSize, FixedOffset<(index == 0 ? 0 : index - 1), Fields...>::value)
+		)
+	};
+};
+
+struct BorrowTag {};
+
+} //namespace lazypayload_internal_
+
+// OPT-80: Holds the bytes of a payload, such as a network message, in a
+// pooled and reference counted block. It's one pointer and the size, so an
+// EventQueue stores it as cheaply as an int pair, and copying it is one
+// atomic increment. The fields are decoded by LazyPayload<Schema>.
+class LazyPayloadBase
+{
+public:
+	LazyPayloadBase() noexcept : data(nullptr), size(0)
+	{
+	}
+
+	LazyPayloadBase(const LazyPayloadBase & other) noexcept : data(other.data), size(other.size)
+	{
+		doShare();
+	}
+
+	LazyPayloadBase(LazyPayloadBase && other) noexcept : data(other.data), size(other.size)
+	{
+		other.detach();
+	}
+
+	~LazyPayloadBase()
+	{
+		doRelease();
+	}
+
+	LazyPayloadBase & operator = (const LazyPayloadBase & other) noexcept
+	{
+		LazyPayloadBase copied(other);
+		swap(copied);
+		return *this;
+	}
+
+	LazyPayloadBase & operator = (LazyPayloadBase && other) noexcept
+	{
+		LazyPayloadBase moved(std::move(other));
+		swap(moved);
+		return *this;
+	}
+
+	void swap(LazyPayloadBase & other) noexcept
+	{
+		std::swap(data, other.data);
+		std::swap(size, other.size);
+	}
+
+	const std::uint8_t * getData() const noexcept {
+		return data;
+	}
+
+	std::size_t getSize() const noexcept {
+		return size;
+	}
+
+	bool empty() const noexcept {
+		return data == nullptr;
+	}
+
+	std::size_t getReferenceCount() const noexcept {
+		return data == nullptr ? 0 : lazypayload_internal_::getHeader(data)->referenceCount.load(std::memory_order_relaxed);
+	}
+
+	// Whether the payload was made by LazyPayload<Schema>.
+	template <typename Schema>
+	bool isSchema() const noexcept {
+		return data != nullptr
+			&& lazypayload_internal_::getHeader(data)->schemaKey == &anydata_internal_::TypeKey<Schema>::key;
+	}
+
+protected:
+	// Takes over the reference of a new block.
+	LazyPayloadBase(const std::uint8_t * data, const std::size_t size) noexcept : data(data), size(size)
+	{
+	}
+
+	// Refers to the block without a reference, the borrower calls detach.
+	LazyPayloadBase(const LazyPayloadBase & other, lazypayload_internal_::BorrowTag) noexcept
+		: data(other.data), size(other.size)
+	{
+	}
+
+	void detach() noexcept
+	{
+		data = nullptr;
+		size = 0;
+	}
+
+private:
+	void doShare() noexcept
+	{
+		if(data != nullptr) {
+			lazypayload_internal_::getHeader(data)->referenceCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void doRelease() noexcept
+	{
+		if(data != nullptr) {
+			lazypayload_internal_::Header * header = lazypayload_internal_::getHeader(data);
+			if(header->referenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				lazypayload_internal_::freePayload(header);
+			}
+		}
+	}
+
+private:
+	const std::uint8_t * data;
+	std::size_t size;
+};
+
+template <typename Schema>
+class LazyPayload;
+
+// OPT-80: Decodes a field only when it's read. The offsets of the fields
+// after a variable size field are found on the first access and kept in
+// the block, so they are found once for all the copies and the threads.
+// The fields before the first variable size field have constant offsets.
+template <typename ...Fields>
+class LazyPayload <LazySchema<Fields...> > : public LazyPayloadBase
+{
+private:
+	using Schema = LazySchema<Fields...>;
+	using FieldTuple = std::tuple<Fields...>;
+	using Offset = lazypayload_internal_::Offset;
+	using GetSize = std::size_t (*)(const std::uint8_t *, std::size_t);
+
+	enum : std::size_t { fieldCount = sizeof...(Fields) };
+
+	template <std::size_t index>
+	using Field = typename std::tuple_element<index, FieldTuple>::type;
+
+	template <std::size_t index>
+	using HasFixedPlace = std::integral_constant<bool,
+		Field<index>::fixedSize != 0
+		&& static_cast<std::size_t>(lazypayload_internal_::FixedOffset<index, Fields...>::value) != lazyBadSize
+	>;
+
+public:
+	template <std::size_t index>
+	using FieldType = typename Field<index>::Type;
+
+	// The argument of a listener receiving `const LazyPayload &` through
+	// argumentAdapter, it doesn't touch the reference count.
+	class Borrow;
+
+public:
+	LazyPayload() noexcept : LazyPayloadBase()
+	{
+	}
+
+	// Shares the bytes of a payload made by LazyPayload<Schema>.
+	explicit LazyPayload(const LazyPayloadBase & other) noexcept : LazyPayloadBase(other)
+	{
+		assert(other.empty() || other.isSchema<Schema>());
+	}
+
+	static LazyPayload copyFrom(const void * bytes, const std::size_t size)
+	{
+		std::uint8_t * data = lazypayload_internal_::allocatePayload(
+			size, fieldCount, &anydata_internal_::TypeKey<Schema>::key);
+		if(size > 0) {
+			std::memcpy(data, bytes, size);
+		}
+		return LazyPayload(data, size);
+	}
+
+	// Whether field index is in the bytes.
+	template <std::size_t index>
+	bool has() const {
+		std::size_t begin;
+		std::size_t fieldSize;
+		return doFindField<index>(begin, fieldSize, HasFixedPlace<index>());
+	}
+
+	// Whether all the fields are in the bytes.
+	bool isValid() const {
+		return doGetOffset(fieldCount) != lazypayload_internal_::badOffset;
+	}
+
+	// Decodes field index, or returns a value initialized FieldType if the
+	// field is not in the bytes.
+	template <std::size_t index>
+	FieldType<index> get() const {
+		std::size_t begin;
+		std::size_t fieldSize;
+		if(! doFindField<index>(begin, fieldSize, HasFixedPlace<index>())) {
+			return FieldType<index>();
+		}
+		return Field<index>::decode(getData() + begin, fieldSize);
+	}
+
+private:
+	LazyPayload(const std::uint8_t * data, const std::size_t size) noexcept : LazyPayloadBase(data, size)
+	{
+	}
+
+	LazyPayload(const LazyPayloadBase & other, lazypayload_internal_::BorrowTag tag) noexcept
+		: LazyPayloadBase(other, tag)
+	{
+		assert(other.empty() || other.isSchema<Schema>());
+	}
+
+	template <std::size_t index>
+	bool doFindField(std::size_t & begin, std::size_t & fieldSize, std::true_type) const {
+		begin = lazypayload_internal_::FixedOffset<index, Fields...>::value;
+		fieldSize = Field<index>::fixedSize;
+		return begin + fieldSize <= getSize();
+	}
+
+	template <std::size_t index>
+	bool doFindField(std::size_t & begin, std::size_t & fieldSize, std::false_type) const {
+		const std::uint32_t offset = doGetOffset(index);
+		if(offset == lazypayload_internal_::badOffset) {
+			return false;
+		}
+		begin = offset;
+		if(Field<index>::fixedSize != 0) {
+			fieldSize = Field<index>::fixedSize;
+			return begin + fieldSize <= getSize();
+		}
+		const std::uint32_t end = doGetOffset(index + 1);
+		fieldSize = end - begin;
+		return end != lazypayload_internal_::badOffset;
+	}
+
+	// Finds the offsets from the last known one to index, and publishes
+	// them. Threads racing here find the same offsets.
+	std::uint32_t doGetOffset(const std::size_t index) const {
+		if(empty()) {
+			return lazypayload_internal_::badOffset;
+		}
+
+		lazypayload_internal_::Header * header = lazypayload_internal_::getHeader(getData());
+		Offset * offsets = lazypayload_internal_::getOffsets(header, fieldCount);
+		std::uint32_t knownCount = header->knownCount.load(std::memory_order_acquire);
+		if(index < knownCount) {
+			return offsets[index].load(std::memory_order_relaxed);
+		}
+
+		static const GetSize getSizeList[] = { &Fields::getSize... };
+		std::uint32_t offset = offsets[knownCount - 1].load(std::memory_order_relaxed);
+		for(std::size_t i = knownCount - 1; i < index; ++i) {
+			if(offset != lazypayload_internal_::badOffset) {
+				const std::size_t available = getSize() - offset;
+				const std::size_t fieldSize = getSizeList[i](getData() + offset, available);
+				offset = (fieldSize <= available
+					? static_cast<std::uint32_t>(offset + fieldSize)
+					: lazypayload_internal_::badOffset
+				);
+			}
+			offsets[i + 1].store(offset, std::memory_order_relaxed);
+		}
+
+		const std::uint32_t newKnownCount = static_cast<std::uint32_t>(index + 1);
+		while(knownCount < newKnownCount
+			&& ! header->knownCount.compare_exchange_weak(
+				knownCount, newKnownCount, std::memory_order_release, std::memory_order_acquire)) {
+		}
+		return offset;
+	}
+};
+
+template <typename ...Fields>
+class LazyPayload <LazySchema<Fields...> >::Borrow : public LazyPayload <LazySchema<Fields...> >
+{
+public:
+	explicit Borrow(const LazyPayloadBase & other) noexcept
+		: LazyPayload(other, lazypayload_internal_::BorrowTag())
+	{
+	}
+
+	Borrow(Borrow && other) noexcept = default;
+
+	~Borrow()
+	{
+		this->detach();
+	}
+};
+
+} //namespace eventpp
+
+#endif
@@ -0,0 +1,436 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LISTENERPROFILER_H_EVENTPP
+#define LISTENERPROFILER_H_EVENTPP
+
+#include "../internal/listenerprofiler_i.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+#endif
+
+namespace eventpp {
+
+// A slow listener kept by ListenerProfiler. handle can be compared with the
+// handle of the listener, as entry.handle.lock() == handle.lock().
+struct ListenerProfileEntry
+{
+	const void * callbackList;
+	const void * listener;
+	const char * tag;
+	std::weak_ptr<void> handle;
+	std::uint64_t ticks;
+	std::chrono::nanoseconds duration;
+};
+
+// A dispatch which is running longer than the budget of the watchdog.
+// listener and tag are the listener being called.
+struct ListenerWatchdogReport
+{
+	const void * callbackList;
+	const void * listener;
+	const char * tag;
+	std::thread::id threadId;
+	std::chrono::nanoseconds elapsed;
+};
+
+namespace internal_ {
+
+// The time stamp counter on x86 and ARM64, which costs a few nanoseconds,
+// else std::chrono::steady_clock in nanoseconds.
+inline std::uint64_t readProfileTicks()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	return static_cast<std::uint64_t>(__rdtsc());
+#elif defined(__aarch64__)
+	std::uint64_t value;
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(value));
+	return value;
+#else
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Measured once against steady_clock, it takes about 10 milliseconds.
+inline double getProfileTicksPerNanosecond()
+{
+	static const double ticksPerNanosecond = []() -> double {
+		const auto beginTime = std::chrono::steady_clock::now();
+		const std::uint64_t beginTicks = readProfileTicks();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		const std::uint64_t endTicks = readProfileTicks();
+		const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - beginTime).count();
+		return (nanoseconds > 0 && endTicks > beginTicks)
+			? static_cast<double>(endTicks - beginTicks) / static_cast<double>(nanoseconds)
+			: 1.0;
+	}();
+	return ticksPerNanosecond;
+}
+
+} //namespace internal_
+
+// OPT-75: A Profiler of CallbackList. Each listener call costs two reads of
+// the time stamp counter and a compare, the calls which are slower than the
+// fastest entry of the top list take the entry.
+// The top list keeps the slowest call of topCount listeners. An entry is
+// claimed by its sequence, a writer which finds it claimed drops its sample,
+// so the writers never wait, and the list is approximate under contention.
+// The watchdog thread scans the dispatches of all threads, and reports each
+// dispatch once when it has been running longer than the budget.
+// Tag separates the profilers which have the same topCount.
+// The counter must be in sync across the cores, as the invariant TSC is.
+template <std::size_t topCount = 16, typename Tag = void>
+class ListenerProfiler
+{
+private:
+	static_assert(topCount > 0, "ListenerProfiler: topCount must not be 0.");
+
+	struct Slot
+	{
+		Slot() : sequence(0), ticks(0), listener(nullptr), callbackList(nullptr), tag(nullptr), handle()
+		{
+		}
+
+		// Odd when the slot is claimed.
+		std::atomic<unsigned int> sequence;
+		std::atomic<std::uint64_t> ticks;
+		std::atomic<const void *> listener;
+		// Only touched by whom claims the slot.
+		const void * callbackList;
+		const char * tag;
+		std::weak_ptr<void> handle;
+	};
+
+	// The state of the dispatch in a thread. depth is only touched by the
+	// thread, reportedTicks only by the watchdog.
+	struct ThreadRecord
+	{
+		ThreadRecord()
+			:
+				threadId(std::this_thread::get_id()),
+				dispatchTicks(0),
+				callbackList(nullptr),
+				listener(nullptr),
+				tag(nullptr),
+				depth(0),
+				reportedTicks(0)
+		{
+		}
+
+		const std::thread::id threadId;
+		// When the dispatch began, 0 if there is no dispatch.
+		std::atomic<std::uint64_t> dispatchTicks;
+		std::atomic<const void *> callbackList;
+		std::atomic<const void *> listener;
+		std::atomic<const char *> tag;
+		unsigned int depth;
+		std::uint64_t reportedTicks;
+		char padding[EVENTPP_CACHELINE_SIZE];
+	};
+
+	struct State
+	{
+		State() : threshold(0), watchdogStopped(true)
+		{
+		}
+
+		Slot slotList[topCount];
+		// The ticks of the fastest entry, 0 if the list is not full.
+		std::atomic<std::uint64_t> threshold;
+
+		// The records are never freed, a thread which ends leaves an idle one.
+		std::mutex registryMutex;
+		std::vector<std::unique_ptr<ThreadRecord> > recordList;
+
+		std::mutex watchdogMutex;
+		std::condition_variable watchdogCondition;
+		bool watchdogStopped;
+		std::thread watchdogThread;
+	};
+
+public:
+	static void onDispatchBegin(const void * /*callbackList*/)
+	{
+		++doGetThreadRecord().depth;
+	}
+
+	static void onDispatchEnd(const void * /*callbackList*/)
+	{
+		ThreadRecord & record = doGetThreadRecord();
+		if(--record.depth == 0) {
+			record.dispatchTicks.store(0, std::memory_order_release);
+		}
+	}
+
+	// The dispatch begins with its first listener, which saves a read of
+	// the counter. The listeners called outside a dispatch, such as by
+	// invokeParallel on the executor, are not watched.
+	static std::uint64_t onListenerBegin(const void * callbackList, const void * listener, const char * tag)
+	{
+		ThreadRecord & record = doGetThreadRecord();
+		record.callbackList.store(callbackList, std::memory_order_relaxed);
+		record.listener.store(listener, std::memory_order_relaxed);
+		record.tag.store(tag, std::memory_order_relaxed);
+		const std::uint64_t ticks = internal_::readProfileTicks();
+		if(record.depth > 0 && record.dispatchTicks.load(std::memory_order_relaxed) == 0) {
+			record.dispatchTicks.store(ticks, std::memory_order_release);
+		}
+		return ticks;
+	}
+
+	template <typename Handle>
+	static void onListenerEnd(const void * callbackList, const void * listener, const char * tag,
+		const std::uint64_t beginTicks, const Handle & handle)
+	{
+		const std::uint64_t endTicks = internal_::readProfileTicks();
+		const std::uint64_t ticks = (endTicks > beginTicks ? endTicks - beginTicks : 1);
+		State & state = doGetState();
+		if(ticks > state.threshold.load(std::memory_order_relaxed)) {
+			doInsert(state, callbackList, listener, tag, ticks, handle);
+		}
+	}
+
+	// The slowest listeners, the slowest first.
+	static std::vector<ListenerProfileEntry> getSlowestListeners()
+	{
+		State & state = doGetState();
+		const double ticksPerNanosecond = internal_::getProfileTicksPerNanosecond();
+		std::vector<ListenerProfileEntry> entryList;
+		for(Slot & slot : state.slotList) {
+			const unsigned int sequence = doClaim(slot);
+			if(slot.ticks.load(std::memory_order_relaxed) != 0) {
+				const std::uint64_t ticks = slot.ticks.load(std::memory_order_relaxed);
+				const void * listener = slot.listener.load(std::memory_order_relaxed);
+				// Two writers may have taken two entries for the same listener.
+				auto it = std::find_if(entryList.begin(), entryList.end(), [listener](const ListenerProfileEntry & entry) {
+					return entry.listener == listener;
+				});
+				if(it == entryList.end()) {
+					entryList.push_back(ListenerProfileEntry {
+						slot.callbackList,
+						listener,
+						slot.tag,
+						slot.handle,
+						ticks,
+						std::chrono::nanoseconds(static_cast<std::int64_t>(static_cast<double>(ticks) / ticksPerNanosecond))
+					});
+				}
+				else if(it->ticks < ticks) {
+					it->ticks = ticks;
+					it->duration = std::chrono::nanoseconds(static_cast<std::int64_t>(static_cast<double>(ticks) / ticksPerNanosecond));
+				}
+			}
+			slot.sequence.store(sequence + 2, std::memory_order_release);
+		}
+		std::sort(entryList.begin(), entryList.end(), [](const ListenerProfileEntry & a, const ListenerProfileEntry & b) {
+			return a.ticks > b.ticks;
+		});
+		return entryList;
+	}
+
+	static void reset()
+	{
+		State & state = doGetState();
+		for(Slot & slot : state.slotList) {
+			const unsigned int sequence = doClaim(slot);
+			slot.ticks.store(0, std::memory_order_relaxed);
+			slot.listener.store(nullptr, std::memory_order_relaxed);
+			slot.callbackList = nullptr;
+			slot.tag = nullptr;
+			slot.handle.reset();
+			slot.sequence.store(sequence + 2, std::memory_order_release);
+		}
+		state.threshold.store(0, std::memory_order_relaxed);
+	}
+
+	// Starts the watchdog thread, which checks the dispatches every interval.
+	// callback is called on the watchdog thread. Returns false if the
+	// watchdog is already running.
+	static bool startWatchdog(
+		const std::chrono::nanoseconds budget,
+		std::function<void (const ListenerWatchdogReport &)> callback,
+		const std::chrono::nanoseconds interval = std::chrono::milliseconds(1)
+	)
+	{
+		State & state = doGetState();
+		std::lock_guard<std::mutex> lockGuard(state.watchdogMutex);
+		if(state.watchdogThread.joinable()) {
+			return false;
+		}
+		state.watchdogStopped = false;
+		state.watchdogThread = std::thread([&state, budget, callback, interval]() {
+			doWatch(state, budget, callback, interval);
+		});
+		return true;
+	}
+
+	static void stopWatchdog()
+	{
+		State & state = doGetState();
+		std::thread thread;
+		{
+			std::lock_guard<std::mutex> lockGuard(state.watchdogMutex);
+			state.watchdogStopped = true;
+			thread = std::move(state.watchdogThread);
+		}
+		state.watchdogCondition.notify_all();
+		if(thread.joinable()) {
+			thread.join();
+		}
+	}
+
+private:
+	static State & doGetState()
+	{
+		static State state;
+		return state;
+	}
+
+	static ThreadRecord & doGetThreadRecord()
+	{
+		static thread_local ThreadRecord * record = nullptr;
+		if(record == nullptr) {
+			State & state = doGetState();
+			std::lock_guard<std::mutex> lockGuard(state.registryMutex);
+			state.recordList.emplace_back(new ThreadRecord());
+			record = state.recordList.back().get();
+		}
+		return *record;
+	}
+
+	// Waits until the slot is claimed, for the readers. Returns the sequence
+	// before the claim.
+	static unsigned int doClaim(Slot & slot)
+	{
+		for(;;) {
+			unsigned int sequence = slot.sequence.load(std::memory_order_relaxed);
+			if((sequence & 1) == 0
+				&& slot.sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire)) {
+				return sequence;
+			}
+			std::this_thread::yield();
+		}
+	}
+
+	template <typename Handle>
+	static void doInsert(State & state, const void * callbackList, const void * listener, const char * tag,
+		const std::uint64_t ticks, const Handle & handle)
+	{
+		// The entry of the listener, else the fastest one.
+		Slot * target = nullptr;
+		std::uint64_t fastestTicks = (std::numeric_limits<std::uint64_t>::max)();
+		for(Slot & slot : state.slotList) {
+			if(slot.listener.load(std::memory_order_relaxed) == listener) {
+				target = &slot;
+				break;
+			}
+			const std::uint64_t slotTicks = slot.ticks.load(std::memory_order_relaxed);
+			if(slotTicks < fastestTicks) {
+				fastestTicks = slotTicks;
+				target = &slot;
+			}
+		}
+
+		unsigned int sequence = target->sequence.load(std::memory_order_relaxed);
+		if((sequence & 1) != 0
+			|| ! target->sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire)) {
+			return;
+		}
+		// Another writer may have taken the entry since it was found.
+		if(ticks > target->ticks.load(std::memory_order_relaxed)) {
+			if(target->listener.load(std::memory_order_relaxed) != listener) {
+				target->listener.store(listener, std::memory_order_relaxed);
+				target->handle = std::weak_ptr<void>(handle);
+			}
+			target->callbackList = callbackList;
+			target->tag = tag;
+			target->ticks.store(ticks, std::memory_order_relaxed);
+		}
+		target->sequence.store(sequence + 2, std::memory_order_release);
+
+		std::uint64_t threshold = (std::numeric_limits<std::uint64_t>::max)();
+		for(const Slot & slot : state.slotList) {
+			threshold = (std::min)(threshold, slot.ticks.load(std::memory_order_relaxed));
+		}
+		state.threshold.store(threshold, std::memory_order_relaxed);
+	}
+
+	static void doWatch(
+		State & state,
+		const std::chrono::nanoseconds budget,
+		const std::function<void (const ListenerWatchdogReport &)> & callback,
+		const std::chrono::nanoseconds interval
+	)
+	{
+		const double ticksPerNanosecond = internal_::getProfileTicksPerNanosecond();
+		const std::uint64_t budgetTicks = static_cast<std::uint64_t>(static_cast<double>(budget.count()) * ticksPerNanosecond);
+		std::vector<ListenerWatchdogReport> reportList;
+
+		std::unique_lock<std::mutex> watchdogLock(state.watchdogMutex);
+		while(! state.watchdogCondition.wait_for(watchdogLock, interval, [&state]() {
+			return state.watchdogStopped;
+		})) {
+			watchdogLock.unlock();
+
+			reportList.clear();
+			{
+				std::lock_guard<std::mutex> lockGuard(state.registryMutex);
+				const std::uint64_t now = internal_::readProfileTicks();
+				for(const auto & record : state.recordList) {
+					const std::uint64_t dispatchTicks = record->dispatchTicks.load(std::memory_order_acquire);
+					if(dispatchTicks == 0 || dispatchTicks == record->reportedTicks
+						|| now < dispatchTicks || now - dispatchTicks <= budgetTicks) {
+						continue;
+					}
+					record->reportedTicks = dispatchTicks;
+					reportList.push_back(ListenerWatchdogReport {
+						record->callbackList.load(std::memory_order_relaxed),
+						record->listener.load(std::memory_order_relaxed),
+						record->tag.load(std::memory_order_relaxed),
+						record->threadId,
+						std::chrono::nanoseconds(static_cast<std::int64_t>(static_cast<double>(now - dispatchTicks) / ticksPerNanosecond))
+					});
+				}
+			}
+			for(const ListenerWatchdogReport & report : reportList) {
+				callback(report);
+			}
+
+			watchdogLock.lock();
+		}
+	}
+};
+
+
+} //namespace eventpp
+
+#endif
+
@@ -0,0 +1,433 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MERGEDQUEUE_H_EVENTPP
+#define MERGEDQUEUE_H_EVENTPP
+
+#include "../eventdispatcher.h"
+#include "../internal/ringbuffer_i.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace eventpp {
+
+template <
+	typename Event_,
+	typename Prototype_,
+	typename Policies_ = DefaultPolicies
+>
+class MergedQueue;
+
+// OPT-85: Events from several producers, dispatched in the global order of
+// their enqueue time, with no lock shared by the producers.
+// Each producer has its own SPSC ring, enqueue stamps the event with the
+// Clock policy and pushes it to the ring of the producer. The consumer
+// keeps the oldest event of each ring in a heap, a k-way merge, and
+// dispatches the oldest event of all when no producer can still enqueue an
+// older one,
+// - the other producers have an event in the heap, which is newer, or
+// - their ring is empty and they are not in enqueue, so they stamp their
+//   next event later, or
+// - the event is older than the watermark, then a producer which is slow in
+//   enqueue, such as preempted between the stamp and the push, is not
+//   waited for. Its event comes late, and is dispatched when it arrives.
+template <
+	typename Event_,
+	typename Policies_,
+	typename ReturnType, typename ...Args
+>
+class MergedQueue <
+		Event_,
+		ReturnType (Args...),
+		Policies_
+	> : public EventDispatcher<Event_, ReturnType (Args...), Policies_>
+{
+private:
+	using super = EventDispatcher<Event_, ReturnType (Args...), Policies_>;
+	using Threading = typename internal_::SelectThreading<Policies_, internal_::HasTypeThreading<Policies_>::value>::Type;
+	using ConditionVariable = typename Threading::ConditionVariable;
+
+public:
+	using Clock = typename internal_::SelectClock<Policies_, internal_::HasTypeClock<Policies_>::value>::Type;
+	using Event = typename super::Event;
+	using Mutex = typename super::Mutex;
+
+	struct QueuedEvent
+	{
+		typename Clock::time_point stamp;
+		typename std::decay<Event>::type event;
+		std::tuple<typename std::decay<Args>::type...> arguments;
+	};
+
+private:
+	using Ring = internal_::RingBuffer<QueuedEvent, RingProducerSingle>;
+
+	struct Producer
+	{
+		explicit Producer(const std::size_t capacity)
+			: enqueuing(false), ring(capacity)
+		{
+		}
+
+		// Aligned in C++14 too, as ActiveObject.
+		static void * operator new(const std::size_t size)
+		{
+			constexpr std::size_t alignment = alignof(Producer);
+			void * raw = ::operator new(size + alignment + sizeof(void *));
+			const std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(raw) + sizeof(void *) + alignment - 1)
+				& ~static_cast<std::uintptr_t>(alignment - 1);
+			reinterpret_cast<void **>(aligned)[-1] = raw;
+			return reinterpret_cast<void *>(aligned);
+		}
+
+		static void operator delete(void * p)
+		{
+			if(p != nullptr) {
+				::operator delete(static_cast<void **>(p)[-1]);
+			}
+		}
+
+		// Set from before the stamp to after the push.
+		EVENTPP_ALIGN_CACHELINE std::atomic<bool> enqueuing;
+		Ring ring;
+	};
+
+public:
+	// Each producer index must be used by one thread at a time. The rings
+	// hold capacity events each, rounded up to a power of 2.
+	explicit MergedQueue(
+			const std::size_t producerCount,
+			const std::size_t capacity = 1024,
+			const std::chrono::nanoseconds watermark = std::chrono::milliseconds(1)
+		)
+		:
+			super(),
+			producerList(),
+			headList(producerCount, nullptr),
+			heap(),
+			stagedCount(0),
+			lastStamp(),
+			watermark(watermark),
+			lateEventCount(0),
+			waitingConsumerCount(0),
+			queueListConditionVariable(),
+			queueListMutex()
+	{
+		assert(producerCount > 0);
+
+		producerList.reserve(producerCount);
+		for(std::size_t i = 0; i < producerCount; ++i) {
+			producerList.emplace_back(new Producer(capacity));
+		}
+		heap.reserve(producerCount);
+	}
+
+	MergedQueue(const MergedQueue &) = delete;
+	MergedQueue & operator = (const MergedQueue &) = delete;
+
+	std::size_t getProducerCount() const
+	{
+		return producerList.size();
+	}
+
+	// Returns false if the ring of the producer is full, the event is not
+	// queued.
+	template <typename ...A>
+	auto enqueue(const std::size_t producerIndex, A && ...args)
+		-> typename std::enable_if<sizeof...(A) == sizeof...(Args), bool>::type
+	{
+		static_assert(super::ArgumentPassingMode::canIncludeEventType, "Enqueuing arguments count doesn't match required (Event type should be included).");
+
+		using GetEvent = typename internal_::SelectGetEvent<Policies_, Event_, internal_::HasFunctionGetEvent<Policies_, A...>::value>::Type;
+
+		Producer & producer = doBeginEnqueue(producerIndex);
+		return doEndEnqueue(producer, QueuedEvent {
+			Clock::now(),
+			GetEvent::getEvent(args...),
+			std::tuple<typename std::decay<Args>::type...>(std::forward<A>(args)...)
+		});
+	}
+
+	template <typename T, typename ...A>
+	auto enqueue(const std::size_t producerIndex, T && first, A && ...args)
+		-> typename std::enable_if<sizeof...(A) == sizeof...(Args), bool>::type
+	{
+		static_assert(super::ArgumentPassingMode::canExcludeEventType, "Enqueuing arguments count doesn't match required (Event type should NOT be included).");
+
+		using GetEvent = typename internal_::SelectGetEvent<Policies_, Event_, internal_::HasFunctionGetEvent<Policies_, T &&, A...>::value>::Type;
+
+		Producer & producer = doBeginEnqueue(producerIndex);
+		return doEndEnqueue(producer, QueuedEvent {
+			Clock::now(),
+			GetEvent::getEvent(std::forward<T>(first), args...),
+			std::tuple<typename std::decay<Args>::type...>(std::forward<A>(args)...)
+		});
+	}
+
+	// The functions below are called by one consumer thread at a time.
+
+	// Dispatches the events which are in order, returns true if any event
+	// is dispatched. The events which wait for a producer stay queued.
+	bool process()
+	{
+		return doMerge([this](QueuedEvent & item) {
+			doDispatchQueuedEvent(item, typename internal_::MakeIndexSequence<sizeof...(Args)>::Type());
+		});
+	}
+
+	// Same as process, visitor(event, args...) is called instead of the
+	// listeners, as EventQueue::processQueueWith.
+	template <typename Visitor>
+	bool processQueueWith(Visitor && visitor)
+	{
+		return doMerge([&visitor](QueuedEvent & item) {
+			doVisitQueuedEvent(visitor, item, typename internal_::MakeIndexSequence<sizeof...(Args)>::Type());
+		});
+	}
+
+	// False if any producer has a queued event. process may still dispatch
+	// nothing, while a producer which is in enqueue may put an older event,
+	// until it's done or the watermark passes.
+	bool emptyQueue() const
+	{
+		if(stagedCount > 0) {
+			return false;
+		}
+		for(const auto & producer : producerList) {
+			if(! producer->ring.empty()) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void wait() const
+	{
+		while(! waitFor(std::chrono::hours(1))) {
+		}
+	}
+
+	template <class Rep, class Period>
+	bool waitFor(const std::chrono::duration<Rep, Period> & duration) const
+	{
+		if(! emptyQueue()) {
+			return true;
+		}
+
+		for(int i = 0; i < 16; ++i) {
+			std::this_thread::yield();
+			if(! emptyQueue()) {
+				return true;
+			}
+		}
+
+		// The producers only take queueListMutex when a consumer waits. The
+		// fence pairs with the one in doEndEnqueue.
+		waitingConsumerCount.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		bool result;
+		{
+			std::unique_lock<Mutex> queueListLock(queueListMutex);
+			result = queueListConditionVariable.wait_for(queueListLock, duration, [this]() -> bool {
+				return ! emptyQueue();
+			});
+		}
+		waitingConsumerCount.fetch_sub(1, std::memory_order_relaxed);
+		return result;
+	}
+
+	// The events which were dispatched after a newer event, because their
+	// producer was slower than the watermark.
+	std::size_t getLateEventCount() const
+	{
+		return lateEventCount.load(std::memory_order_relaxed);
+	}
+
+	std::chrono::nanoseconds getWatermark() const
+	{
+		return watermark;
+	}
+
+	void setWatermark(const std::chrono::nanoseconds newWatermark)
+	{
+		watermark = newWatermark;
+	}
+
+private:
+	Producer & doBeginEnqueue(const std::size_t producerIndex)
+	{
+		assert(producerIndex < producerList.size());
+
+		Producer & producer = *producerList[producerIndex];
+		// Before the stamp is taken, pairs with the load in doCanRelease.
+		producer.enqueuing.store(true, std::memory_order_seq_cst);
+		return producer;
+	}
+
+	bool doEndEnqueue(Producer & producer, QueuedEvent && item)
+	{
+		const bool queued = producer.ring.tryPush(std::move(item));
+		producer.enqueuing.store(false, std::memory_order_release);
+		if(queued) {
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if(waitingConsumerCount.load(std::memory_order_relaxed) > 0) {
+				std::lock_guard<Mutex> queueListLock(queueListMutex);
+				queueListConditionVariable.notify_one();
+			}
+		}
+		return queued;
+	}
+
+	// The heap is ordered by the stamp, then by the producer index.
+	bool doIsLater(const std::size_t a, const std::size_t b) const
+	{
+		const auto & stampA = headList[a]->stamp;
+		const auto & stampB = headList[b]->stamp;
+		return stampA > stampB || (stampA == stampB && a > b);
+	}
+
+	// The oldest event of the producer joins the heap, it stays in the ring
+	// until it's dispatched.
+	bool doStage(const std::size_t index)
+	{
+		headList[index] = producerList[index]->ring.peek();
+		if(headList[index] == nullptr) {
+			return false;
+		}
+		++stagedCount;
+		heap.push_back(index);
+		std::push_heap(heap.begin(), heap.end(), [this](const std::size_t a, const std::size_t b) {
+			return doIsLater(a, b);
+		});
+		return true;
+	}
+
+	// Whether no producer can enqueue an event older than the event of
+	// index, which is at the top of the heap. False if an older event is
+	// staged.
+	bool doCanRelease(const std::size_t index)
+	{
+		if(stagedCount == producerList.size()) {
+			return true;
+		}
+
+		bool waiting = false;
+		for(std::size_t i = 0; i < producerList.size(); ++i) {
+			if(headList[i] != nullptr) {
+				continue;
+			}
+			// Pairs with the store in doBeginEnqueue. The event was pushed
+			// before this load, so a producer which is not in enqueue
+			// stamps its next event after it.
+			const bool enqueuing = producerList[i]->enqueuing.load(std::memory_order_seq_cst);
+			if(! doStage(i) && enqueuing) {
+				waiting = true;
+			}
+		}
+		if(heap.front() != index) {
+			return false;
+		}
+		return ! waiting || Clock::now() - headList[index]->stamp >= watermark;
+	}
+
+	template <typename F>
+	bool doMerge(F && func)
+	{
+		for(std::size_t i = 0; i < producerList.size(); ++i) {
+			if(headList[i] == nullptr) {
+				doStage(i);
+			}
+		}
+
+		// Bounded so busy producers can't keep the consumer here forever.
+		std::size_t count = 0;
+		for(const auto & producer : producerList) {
+			count += producer->ring.size();
+		}
+
+		const auto isLater = [this](const std::size_t a, const std::size_t b) {
+			return doIsLater(a, b);
+		};
+		bool processed = false;
+		while(count > 0 && ! heap.empty()) {
+			const std::size_t index = heap.front();
+			if(! doCanRelease(index)) {
+				if(heap.front() != index) {
+					continue;
+				}
+				break;
+			}
+
+			std::pop_heap(heap.begin(), heap.end(), isLater);
+			heap.pop_back();
+			headList[index] = nullptr;
+			--stagedCount;
+			--count;
+
+			producerList[index]->ring.tryPop([this, &func](QueuedEvent & item) {
+				if(item.stamp < lastStamp) {
+					lateEventCount.fetch_add(1, std::memory_order_relaxed);
+				}
+				else {
+					lastStamp = item.stamp;
+				}
+				func(item);
+			});
+			processed = true;
+			doStage(index);
+		}
+		return processed;
+	}
+
+	template <typename T, size_t ...Indexes>
+	void doDispatchQueuedEvent(T && item, internal_::IndexSequence<Indexes...>)
+	{
+		this->directDispatch(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+	template <typename V, typename T, size_t ...Indexes>
+	static void doVisitQueuedEvent(V && visitor, T && item, internal_::IndexSequence<Indexes...>)
+	{
+		visitor(item.event, std::get<Indexes>(item.arguments)...);
+	}
+
+private:
+	std::vector<std::unique_ptr<Producer> > producerList;
+	// Used by the consumer only. The oldest event of each producer, in its
+	// ring, or nullptr.
+	std::vector<QueuedEvent *> headList;
+	std::vector<std::size_t> heap;
+	std::size_t stagedCount;
+	typename Clock::time_point lastStamp;
+	std::chrono::nanoseconds watermark;
+	std::atomic<std::size_t> lateEventCount;
+	EVENTPP_ALIGN_CACHELINE mutable typename Threading::template Atomic<int> waitingConsumerCount;
+	mutable ConditionVariable queueListConditionVariable;
+	mutable Mutex queueListMutex;
+};
+
+
+} //namespace eventpp
+
+#endif
@@ -0,0 +1,348 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PRIORITYQUEUELIST_H_EVENTPP
+#define PRIORITYQUEUELIST_H_EVENTPP
+
+#include "../eventpolicies.h"
+#include "../internal/eventqueue_i.h"
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <tuple>
+#include <type_traits>
+
+namespace eventpp {
+
+namespace priorityqueuelist_internal_ {
+
+template <typename T>
+struct HasFunctionGetLaneWeight
+{
+	template <typename C> static std::true_type test(decltype(C::getLaneWeight(std::size_t())) *) ;
+	template <typename C> static std::false_type test(...);
+
+	enum { value = !! decltype(test<T>(0))() };
+};
+
+constexpr std::size_t unlimitedWeight = (std::numeric_limits<std::size_t>::max)();
+
+template <typename Policy>
+auto doGetLaneWeight(const std::size_t lane)
+	-> typename std::enable_if<HasFunctionGetLaneWeight<Policy>::value, std::size_t>::type
+{
+	const std::size_t weight = static_cast<std::size_t>(Policy::getLaneWeight(lane));
+	return weight > 0 ? weight : 1;
+}
+
+template <typename Policy>
+auto doGetLaneWeight(const std::size_t /*lane*/)
+	-> typename std::enable_if<! HasFunctionGetLaneWeight<Policy>::value, std::size_t>::type
+{
+	return unlimitedWeight;
+}
+
+template <typename Policy, typename QueuedEvent, std::size_t ...Indexes>
+std::size_t doGetPriority(const QueuedEvent & queuedEvent, internal_::IndexSequence<Indexes...>)
+{
+	return static_cast<std::size_t>(Policy::getPriority(queuedEvent.event, std::get<Indexes>(queuedEvent.arguments)...));
+}
+
+// Picks the lane the next item is taken from. It's the first lane which is
+// not at end and has credit. If all such lanes used up their credits, the
+// credits are refilled. Returns laneCount if all lanes are at end.
+template <typename Lanes, typename Positions, typename Credits, typename Weights>
+std::size_t selectLane(const Lanes & lanes, const Positions & positions, Credits & credits, const Weights & weights)
+{
+	const std::size_t laneCount = std::tuple_size<Lanes>::value;
+	std::size_t firstLane = laneCount;
+	for(std::size_t lane = 0; lane < laneCount; ++lane) {
+		if(positions[lane] != lanes[lane].end()) {
+			if(credits[lane] > 0) {
+				return lane;
+			}
+			if(firstLane == laneCount) {
+				firstLane = lane;
+			}
+		}
+	}
+	if(firstLane != laneCount) {
+		credits = weights;
+	}
+	return firstLane;
+}
+
+} //namespace priorityqueuelist_internal_
+
+// OPT-27: A QueueList of several FIFO lanes, for EventQueue.
+// The lane of an event is PriorityPolicy::getPriority(event, args...),
+// lane 0 is the highest priority, a value >= laneCount goes to the last lane.
+// The events are taken from the highest lane which is not empty, so an event
+// in a high lane overtakes any backlog in the lower lanes, and enqueue is
+// still O(1).
+// If PriorityPolicy has static getLaneWeight(lane), a lane can give at most
+// that many events in a row while the lower lanes are waiting, then the
+// lower lanes get their turn. Without it the priority is strict.
+// LaneList is the list type of each lane, it can be PoolQueueList.
+//   struct MyPolicies {
+//     static int getPriority(const int event, const Message &) { return event < 100 ? 0 : 1; }
+//     template <typename T>
+//     using QueueList = eventpp::PriorityQueueList<T, MyPolicies, 2>;
+//   };
+template <
+	typename T,
+	typename PriorityPolicy,
+	std::size_t laneCount = 2,
+	typename LaneList = std::list<T>
+>
+class PriorityQueueList
+{
+private:
+	static_assert(laneCount > 0, "PriorityQueueList: laneCount must be greater than 0");
+
+	// The extra last lane holds the items which are empty when they are put
+	// in the list, such as the free items. They are moved to their lanes when
+	// the list is spliced to another list.
+	static constexpr std::size_t pendingLane = laneCount;
+	static constexpr std::size_t totalLaneCount = laneCount + 1;
+
+	using Lanes = std::array<LaneList, totalLaneCount>;
+	using Credits = std::array<std::size_t, totalLaneCount>;
+
+	template <typename LaneIterator, typename Reference>
+	class Iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = typename std::remove_reference<Reference>::type *;
+		using reference = Reference;
+
+	public:
+		Iterator() : lanes(nullptr), positions(), credits(), lane(totalLaneCount)
+		{
+		}
+
+		// iterator to const_iterator
+		template <typename OtherLaneIterator, typename OtherReference,
+			typename std::enable_if<std::is_convertible<OtherLaneIterator, LaneIterator>::value>::type * = nullptr>
+		Iterator(const Iterator<OtherLaneIterator, OtherReference> & other)
+			: lanes(other.lanes), positions(), credits(other.credits), lane(other.lane)
+		{
+			for(std::size_t i = 0; i < totalLaneCount; ++i) {
+				positions[i] = other.positions[i];
+			}
+		}
+
+		reference operator * () const {
+			return *positions[lane];
+		}
+
+		pointer operator -> () const {
+			return &*positions[lane];
+		}
+
+		Iterator & operator ++ () {
+			++positions[lane];
+			if(credits[lane] != priorityqueuelist_internal_::unlimitedWeight) {
+				--credits[lane];
+			}
+			lane = priorityqueuelist_internal_::selectLane(*lanes, positions, credits, getWeights());
+			return *this;
+		}
+
+		Iterator operator ++ (int) {
+			Iterator result(*this);
+			++*this;
+			return result;
+		}
+
+		bool operator == (const Iterator & other) const {
+			return lane == other.lane && (lane == totalLaneCount || positions[lane] == other.positions[lane]);
+		}
+
+		bool operator != (const Iterator & other) const {
+			return ! (*this == other);
+		}
+
+	private:
+		Iterator(const Lanes * lanes, const Credits & credits)
+			: lanes(lanes), positions(), credits(credits), lane(totalLaneCount)
+		{
+		}
+
+	private:
+		const Lanes * lanes;
+		std::array<LaneIterator, totalLaneCount> positions;
+		Credits credits;
+		std::size_t lane;
+
+		template <typename, typename>
+		friend class Iterator;
+		friend class PriorityQueueList;
+	};
+
+public:
+	using value_type = T;
+	using reference = T &;
+	using const_reference = const T &;
+	using iterator = Iterator<typename LaneList::iterator, T &>;
+	using const_iterator = Iterator<typename LaneList::const_iterator, const T &>;
+
+public:
+	PriorityQueueList() : lanes(), credits(getWeights()), itemCount(0)
+	{
+	}
+
+	bool empty() const {
+		return itemCount == 0;
+	}
+
+	iterator begin() {
+		return doBegin<iterator>(lanes);
+	}
+
+	const_iterator begin() const {
+		return doBegin<const_iterator>(lanes);
+	}
+
+	iterator end() {
+		return iterator(&lanes, credits);
+	}
+
+	const_iterator end() const {
+		return const_iterator(&lanes, credits);
+	}
+
+	reference front() {
+		return *begin();
+	}
+
+	const_reference front() const {
+		return *begin();
+	}
+
+	void swap(PriorityQueueList & other) {
+		using std::swap;
+		swap(lanes, other.lanes);
+		swap(credits, other.credits);
+		swap(itemCount, other.itemCount);
+	}
+
+	void emplace_back() {
+		lanes[pendingLane].emplace_back();
+		++itemCount;
+	}
+
+	// The items are put at the front of their lanes if pos is not end(),
+	// otherwise at the back. The position within a lane is not used.
+	void splice(const const_iterator & pos, PriorityQueueList & other) {
+		other.doSortPending();
+		const bool atFront = (pos.lane != totalLaneCount);
+		for(std::size_t lane = 0; lane < totalLaneCount; ++lane) {
+			auto & laneList = lanes[lane];
+			laneList.splice(atFront ? laneList.begin() : laneList.end(), other.lanes[lane]);
+		}
+		itemCount += other.itemCount;
+		other.itemCount = 0;
+	}
+
+	// An item from the pending lane of other goes to its lane. An item which
+	// is already in a lane of other is taken by a consumer, such as
+	// processN, it goes to the pending lane so the items taken one by one
+	// keep the order they are taken.
+	void splice(const const_iterator & pos, PriorityQueueList & other, const const_iterator & it) {
+		const std::size_t fromLane = it.lane;
+		const auto node = it.positions[fromLane];
+		auto & laneList = lanes[fromLane == pendingLane ? getLane(*node) : pendingLane];
+		laneList.splice((pos.lane != totalLaneCount) ? laneList.begin() : laneList.end(), other.lanes[fromLane], node);
+		other.doConsumeCredit(fromLane);
+		--other.itemCount;
+		++itemCount;
+	}
+
+	// Returns the lane an item goes to.
+	static std::size_t getLane(const T & item) {
+		if(item.empty()) {
+			return pendingLane;
+		}
+		const auto & queuedEvent = item.get();
+		const std::size_t lane = priorityqueuelist_internal_::doGetPriority<PriorityPolicy>(
+			queuedEvent,
+			typename internal_::MakeIndexSequence<std::tuple_size<typename std::decay<decltype(queuedEvent.arguments)>::type>::value>::Type()
+		);
+		return lane < laneCount ? lane : laneCount - 1;
+	}
+
+private:
+	static const Credits & getWeights() {
+		static const Credits weights = doMakeWeights();
+		return weights;
+	}
+
+	static Credits doMakeWeights() {
+		Credits weights;
+		for(std::size_t lane = 0; lane < laneCount; ++lane) {
+			weights[lane] = priorityqueuelist_internal_::doGetLaneWeight<PriorityPolicy>(lane);
+		}
+		weights[pendingLane] = priorityqueuelist_internal_::unlimitedWeight;
+		return weights;
+	}
+
+	template <typename It, typename L>
+	It doBegin(L & laneArray) const {
+		It it(&lanes, credits);
+		for(std::size_t lane = 0; lane < totalLaneCount; ++lane) {
+			it.positions[lane] = laneArray[lane].begin();
+		}
+		it.lane = priorityqueuelist_internal_::selectLane(lanes, it.positions, it.credits, getWeights());
+		return it;
+	}
+
+	void doConsumeCredit(const std::size_t lane) {
+		if(credits[lane] == 0) {
+			credits = getWeights();
+		}
+		if(credits[lane] != priorityqueuelist_internal_::unlimitedWeight) {
+			--credits[lane];
+		}
+	}
+
+	// Moves the items in the pending lane which are not empty to their lanes.
+	void doSortPending() {
+		auto & pendingList = lanes[pendingLane];
+		for(auto it = pendingList.begin(); it != pendingList.end(); ) {
+			const auto node = it;
+			++it;
+			if(! node->empty()) {
+				auto & laneList = lanes[getLane(*node)];
+				laneList.splice(laneList.end(), pendingList, node);
+			}
+		}
+	}
+
+private:
+	Lanes lanes;
+	Credits credits;
+	std::size_t itemCount;
+};
+
+
+} //namespace eventpp
+
+#endif
+
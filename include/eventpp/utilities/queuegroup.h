@@ -0,0 +1,184 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef QUEUEGROUP_H_EVENTPP
+#define QUEUEGROUP_H_EVENTPP
+
+#include "queueset.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace eventpp {
+
+// OPT-83: Spreads the events of the producers over several EventQueues,
+// such as one queue per core.
+// enqueue picks two queues at random and puts the event in the one with
+// fewer events, the power of two choices, which keeps the longest queue
+// close to the average without reading all the depths. The depth is
+// EventQueue::getQueuedEventCount, one relaxed atomic load, so the queues
+// must have the QueueCapacity policy QueueCapacityLimited.
+// enqueueKeyed always puts the events of a key in the same queue, so they
+// are processed in order.
+// The consumers wait on all the queues with waitAny.
+template <typename Queue>
+class QueueGroup
+{
+public:
+	using ReadyMask = QueueSet::ReadyMask;
+
+	enum : std::size_t {
+		maxQueueCount = QueueSet::maxQueueCount
+	};
+
+public:
+	QueueGroup()
+		: queueList(), queueSet()
+	{
+	}
+
+	QueueGroup(const QueueGroup &) = delete;
+	QueueGroup & operator = (const QueueGroup &) = delete;
+
+	// Returns the index of the queue. The queues must be added before the
+	// producers and the consumers use the group, and outlive it. A queue
+	// joins the QueueSet of the group, so it can't be in another QueueSet.
+	std::size_t add(Queue & queue)
+	{
+		assert(queueList.size() < maxQueueCount);
+
+		queueSet.add(queue);
+		queueList.push_back(&queue);
+		return queueList.size() - 1;
+	}
+
+	std::size_t getQueueCount() const
+	{
+		return queueList.size();
+	}
+
+	Queue & getQueue(const std::size_t index)
+	{
+		return *queueList[index];
+	}
+
+	const Queue & getQueue(const std::size_t index) const
+	{
+		return *queueList[index];
+	}
+
+	// Returns the index of the queue which got the event.
+	template <typename ...A>
+	std::size_t enqueue(A && ...args)
+	{
+		const std::size_t index = pickQueue();
+		queueList[index]->enqueue(std::forward<A>(args)...);
+		return index;
+	}
+
+	template <typename Key, typename ...A>
+	std::size_t enqueueKeyed(const Key & key, A && ...args)
+	{
+		const std::size_t index = getKeyedIndex(key);
+		queueList[index]->enqueue(std::forward<A>(args)...);
+		return index;
+	}
+
+	// The shorter of two different queues picked at random.
+	std::size_t pickQueue() const
+	{
+		assert(! queueList.empty());
+
+		const std::size_t count = queueList.size();
+		if(count == 1) {
+			return 0;
+		}
+
+		const std::uint64_t random = doGetRandom();
+		const std::size_t first = doMapToRange(static_cast<std::uint32_t>(random), count);
+		const std::size_t second = (first + 1 + doMapToRange(static_cast<std::uint32_t>(random >> 32), count - 1)) % count;
+		return (queueList[second]->getQueuedEventCount() < queueList[first]->getQueuedEventCount() ? second : first);
+	}
+
+	// The queue of key, it doesn't change while the queues don't. The key
+	// is hashed by Hash.
+	template <typename Key, typename Hash = std::hash<Key> >
+	std::size_t getKeyedIndex(const Key & key) const
+	{
+		assert(! queueList.empty());
+
+		// std::hash of the integers is the identity, mix it so the close
+		// keys spread.
+		const std::uint64_t hash = static_cast<std::uint64_t>(Hash()(key)) * 0x9e3779b97f4a7c15ull;
+		return doMapToRange(static_cast<std::uint32_t>(hash >> 32), queueList.size());
+	}
+
+	// The queues which can be processed now, doesn't wait. Bit i is the
+	// queue of index i.
+	ReadyMask getReady() const
+	{
+		return queueSet.getReady();
+	}
+
+	ReadyMask waitAny() const
+	{
+		return queueSet.wait();
+	}
+
+	// Returns 0 if no queue is ready within duration.
+	template <class Rep, class Period>
+	ReadyMask waitAnyFor(const std::chrono::duration<Rep, Period> & duration) const
+	{
+		return queueSet.waitFor(duration);
+	}
+
+private:
+	// Lemire's multiply and shift, [0, count) without a division.
+	static std::size_t doMapToRange(const std::uint32_t value, const std::size_t count)
+	{
+		return static_cast<std::size_t>((static_cast<std::uint64_t>(value) * count) >> 32);
+	}
+
+	// xorshift64*, one state for each thread so the producers don't share
+	// a cache line.
+	static std::uint64_t doGetRandom()
+	{
+		static thread_local std::uint64_t state = doGetSeed();
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 0x2545f4914f6cdd1dull;
+	}
+
+	static std::uint64_t doGetSeed()
+	{
+		const std::uint64_t seed = static_cast<std::uint64_t>(std::hash<std::thread::id>()(std::this_thread::get_id()))
+			* 0x9e3779b97f4a7c15ull;
+		return (seed != 0 ? seed : 1);
+	}
+
+private:
+	std::vector<Queue *> queueList;
+	QueueSet queueSet;
+};
+
+
+} //namespace eventpp
+
+#endif
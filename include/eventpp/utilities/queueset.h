@@ -0,0 +1,191 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef QUEUESET_H_EVENTPP
+#define QUEUESET_H_EVENTPP
+
+#include "../eventqueue.h"
+#include "../internal/queueset_i.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace eventpp {
+
+// OPT-57: Waits on several EventQueues at once. All queues in the set
+// signal one shared wakeup object when they get an event, so a consumer
+// sleeps until any of them can be processed, without polling each queue
+// with short timeouts. The ready queues are returned as a bit mask, bit i
+// is the queue added i-th.
+// A queue can be in one set at a time, and must outlive the set.
+class QueueSet
+{
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Member
+	{
+		void * queue;
+		bool (*isReady)(const void * queue);
+		Clock::time_point (*getNextDueTime)(const void * queue);
+		void (*attach)(void * queue, internal_::QueueSetSignal * signal);
+	};
+
+public:
+	using ReadyMask = std::uint64_t;
+
+	enum : std::size_t {
+		maxQueueCount = 64
+	};
+
+public:
+	QueueSet()
+		: memberList(), signal(std::make_shared<internal_::QueueSetSignal>())
+	{
+	}
+
+	~QueueSet()
+	{
+		for(const Member & member : memberList) {
+			member.attach(member.queue, nullptr);
+		}
+		// A producer may still be signaling.
+		internal_::EpochReclaimer::retire(std::move(signal));
+	}
+
+	QueueSet(const QueueSet &) = delete;
+	QueueSet & operator = (const QueueSet &) = delete;
+
+	// Returns the bit index of the queue. Must not be called while another
+	// thread waits on the set.
+	template <typename E, typename P, typename Policies>
+	std::size_t add(internal_::EventQueueBase<E, P, Policies> & queue)
+	{
+		using Queue = internal_::EventQueueBase<E, P, Policies>;
+		static_assert(std::is_same<typename Queue::Clock, Clock>::value, "QueueSet: the queues must use the default Clock policy.");
+
+		assert(memberList.size() < maxQueueCount);
+
+		Member member;
+		member.queue = &queue;
+		member.isReady = [](const void * q) -> bool {
+			return static_cast<const Queue *>(q)->doIsReadyForQueueSet();
+		};
+		member.getNextDueTime = [](const void * q) -> Clock::time_point {
+			return static_cast<const Queue *>(q)->doGetNextDueTime(typename Queue::HasTimer());
+		};
+		member.attach = [](void * q, internal_::QueueSetSignal * s) {
+			static_cast<Queue *>(q)->doAttachQueueSet(s);
+		};
+		member.attach(member.queue, signal.get());
+		memberList.push_back(member);
+		return memberList.size() - 1;
+	}
+
+	std::size_t getQueueCount() const
+	{
+		return memberList.size();
+	}
+
+	// The queues which can be processed now, doesn't wait.
+	ReadyMask getReady() const
+	{
+		ReadyMask mask = 0;
+		for(std::size_t i = 0; i < memberList.size(); ++i) {
+			if(memberList[i].isReady(memberList[i].queue)) {
+				mask |= (ReadyMask(1) << i);
+			}
+		}
+		return mask;
+	}
+
+	ReadyMask wait() const
+	{
+		return doWaitUntil((Clock::time_point::max)());
+	}
+
+	// Returns 0 if no queue is ready within duration.
+	template <class Rep, class Period>
+	ReadyMask waitFor(const std::chrono::duration<Rep, Period> & duration) const
+	{
+		return doWaitUntil(Clock::now() + std::chrono::duration_cast<Clock::duration>(duration));
+	}
+
+private:
+	ReadyMask doWaitUntil(const Clock::time_point & deadline) const
+	{
+		struct WaiterGuard
+		{
+			explicit WaiterGuard(internal_::QueueSetSignal * signal) : signal(signal) {
+				signal->addWaiter();
+			}
+			~WaiterGuard() {
+				signal->removeWaiter();
+			}
+			internal_::QueueSetSignal * signal;
+		};
+		WaiterGuard waiterGuard(signal.get());
+
+		for(;;) {
+			const std::uint64_t sequence = signal->getSequence();
+			const ReadyMask mask = getReady();
+			if(mask != 0) {
+				return mask;
+			}
+
+			// A delayed event which gets due wakes the set without a signal.
+			Clock::time_point wakeTime = deadline;
+			for(const Member & member : memberList) {
+				const Clock::time_point dueTime = member.getNextDueTime(member.queue);
+				if(dueTime < wakeTime) {
+					wakeTime = dueTime;
+				}
+			}
+			const Clock::time_point now = Clock::now();
+			if(now >= deadline) {
+				return 0;
+			}
+			// Not ready though due, such as in DisableQueueNotify, so don't spin.
+			if(wakeTime <= now) {
+				wakeTime = (std::min)(deadline, now + std::chrono::milliseconds(1));
+			}
+			signal->waitUntil(sequence, wakeTime);
+		}
+	}
+
+private:
+	std::vector<Member> memberList;
+	std::shared_ptr<internal_::QueueSetSignal> signal;
+};
+
+// Waits at most duration for any of the queues, returns the mask of the
+// ready queues in the argument order, or 0 if none is ready in time.
+// The queues join a set for the call, so they must not be in a QueueSet.
+template <class Rep, class Period, typename ...Queues>
+QueueSet::ReadyMask waitAny(const std::chrono::duration<Rep, Period> & duration, Queues & ...queues)
+{
+	QueueSet queueSet;
+	using Expander = int[];
+	(void)Expander { 0, ((void)queueSet.add(queues), 0)... };
+	return queueSet.waitFor(duration);
+}
+
+
+} //namespace eventpp
+
+#endif
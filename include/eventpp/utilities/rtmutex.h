@@ -0,0 +1,224 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RTMUTEX_H_EVENTPP
+#define RTMUTEX_H_EVENTPP
+
+#include "../eventpolicies.h"
+#include "../internal/poolallocator_i.h"
+#include "../internal/spinwait_i.h"
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+	#include <pthread.h>
+	#include <unistd.h>
+	#if defined(_POSIX_THREAD_PRIO_INHERIT) && _POSIX_THREAD_PRIO_INHERIT >= 0
+		#define EVENTPP_HAS_PRIO_INHERIT 1
+	#endif
+#endif
+
+#if defined(__linux__)
+	#include <linux/futex.h>
+	#include <sys/syscall.h>
+#endif
+
+namespace eventpp {
+
+// OPT-59: Mutexes for the real time threads, the Mutex of GeneralThreading.
+// SpinLock is fast when the threads have the same priority, but under
+// SCHED_FIFO a spinning high priority thread never lets a low priority
+// holder on the same core run, which is priority inversion.
+
+#if defined(EVENTPP_HAS_PRIO_INHERIT)
+
+// A pthread mutex with PTHREAD_PRIO_INHERIT. A thread which holds the mutex
+// runs at the priority of the highest thread which waits for it, so a low
+// priority producer holding queueListMutex can't be preempted by the middle
+// priority threads while a high priority consumer waits.
+// On Linux, it's a PI futex, the uncontended lock and unlock don't enter the
+// kernel.
+class PIMutex
+{
+public:
+	PIMutex() noexcept
+	{
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init(&attr);
+		const int result = pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+		assert(result == 0);
+		(void)result;
+		pthread_mutex_init(&mutex, &attr);
+		pthread_mutexattr_destroy(&attr);
+	}
+
+	~PIMutex()
+	{
+		pthread_mutex_destroy(&mutex);
+	}
+
+	PIMutex(const PIMutex &) = delete;
+	PIMutex & operator = (const PIMutex &) = delete;
+
+	void lock() noexcept
+	{
+		const int result = pthread_mutex_lock(&mutex);
+		assert(result == 0);
+		(void)result;
+	}
+
+	bool try_lock() noexcept
+	{
+		return pthread_mutex_trylock(&mutex) == 0;
+	}
+
+	void unlock() noexcept
+	{
+		pthread_mutex_unlock(&mutex);
+	}
+
+private:
+	pthread_mutex_t mutex;
+};
+
+#endif
+
+// An adaptive mutex on a futex, 0 is unlocked, 1 is locked, 2 is locked and
+// maybe has waiters. lock spins spinCount times, then sleeps in FUTEX_WAIT,
+// unlock calls FUTEX_WAKE only if a thread may be sleeping. It's one word,
+// and lighter than std::mutex, but it doesn't inherit priority, use PIMutex
+// when the threads have different real time priorities.
+// Without futex (not Linux), the waiting thread yields instead of sleeping.
+template <unsigned int spinCount = 100>
+class FutexMutex
+{
+public:
+	FutexMutex() noexcept : state(0)
+	{
+	}
+
+	FutexMutex(const FutexMutex &) = delete;
+	FutexMutex & operator = (const FutexMutex &) = delete;
+
+	void lock() noexcept
+	{
+		int expected = 0;
+		if(state.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+			return;
+		}
+
+		for(unsigned int i = 0; i < spinCount; ++i) {
+			internal_::cpuRelax();
+			expected = 0;
+			if(state.load(std::memory_order_relaxed) == 0
+				&& state.compare_exchange_weak(expected, 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+				return;
+			}
+		}
+
+		// Marks the mutex as contended, so unlock wakes us.
+		while(state.exchange(2, std::memory_order_acquire) != 0) {
+			doWait();
+		}
+	}
+
+	bool try_lock() noexcept
+	{
+		int expected = 0;
+		return state.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	void unlock() noexcept
+	{
+		if(state.exchange(0, std::memory_order_release) == 2) {
+			doWake();
+		}
+	}
+
+private:
+	void doWait() noexcept
+	{
+#if defined(__linux__)
+		// Returns at once if the state is not 2 any more.
+		syscall(SYS_futex, reinterpret_cast<int *>(&state), FUTEX_WAIT_PRIVATE, 2, nullptr, nullptr, 0);
+#else
+		std::this_thread::yield();
+#endif
+	}
+
+	void doWake() noexcept
+	{
+#if defined(__linux__)
+		syscall(SYS_futex, reinterpret_cast<int *>(&state), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+	}
+
+private:
+	static_assert(sizeof(std::atomic<int>) == sizeof(int), "FutexMutex: std::atomic<int> must have the size of int.");
+
+	std::atomic<int> state;
+};
+
+// Makes a SharedMutex from an exclusive Mutex, the shared lock is the
+// exclusive lock. The pthread reader-writer locks don't inherit priority,
+// so the listener lock of EventDispatcher must be exclusive with PIMutex.
+template <typename Mutex_>
+class ExclusiveSharedMutex
+{
+public:
+	void lock() { mutex.lock(); }
+	bool try_lock() { return mutex.try_lock(); }
+	void unlock() { mutex.unlock(); }
+
+	void lock_shared() { mutex.lock(); }
+	bool try_lock_shared() { return mutex.try_lock(); }
+	void unlock_shared() { mutex.unlock(); }
+
+private:
+	Mutex_ mutex;
+};
+
+#if defined(EVENTPP_HAS_PRIO_INHERIT)
+
+// A policy preset for the SCHED_FIFO/SCHED_RR threads, the counterpart of
+// HighPerfPolicy. All the mutexes inherit priority. The queue and the
+// listener nodes come from the pools, so the hot path doesn't call malloc,
+// which may take a lock without priority inheritance.
+// ConditionVariable is std::condition_variable_any, so wait and waitFor work
+// with PIMutex. Its internal mutex doesn't inherit priority, but it's only
+// held during the wait and the notify.
+struct RealTimePolicy
+{
+	using Threading = GeneralThreading<
+		PIMutex,
+		std::atomic,
+		std::condition_variable_any,
+		ExclusiveSharedMutex<PIMutex>
+	>;
+
+	template <typename T>
+	using QueueList = PoolQueueList<T, 8192>;
+
+	template <typename T>
+	using NodeAllocator = PoolAllocator<T, 1024>;
+};
+
+#endif
+
+
+} //namespace eventpp
+
+#endif
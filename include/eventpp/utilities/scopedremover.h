@@ -15,37 +15,163 @@
 #define SCOPEDREMOVER_H_695291515513
 
 #include "../eventpolicies.h"
+#include "../internal/listenergroup_i.h"
 
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
 #include <vector>
-#include <algorithm>
 
 namespace eventpp {
 
 namespace internal_ {
 
-template <typename Item, typename Handle, typename Mutex>
-bool removeHandleFromScopedRemoverItemList(std::vector<Item> & itemList, Handle & handle, Mutex & mutex)
+// The heterogeneous handles hold the handle of the underlying list.
+template <typename Handle>
+auto lockScopedRemoverHandle(const Handle & handle, int) -> decltype(handle.homoHandle.lock())
 {
-	if(! handle) {
-		return false;
+	return handle.homoHandle.lock();
+}
+
+template <typename Handle>
+auto lockScopedRemoverHandle(const Handle & handle, long) -> decltype(handle.lock())
+{
+	return handle.lock();
+}
+
+// OPT-61: The slot map handles have the key already, it's not a pointer.
+template <typename Handle>
+auto getScopedRemoverHandleKey(const Handle & handle, int) -> decltype(std::uint64_t(handle.getKey()))
+{
+	return handle.getKey();
+}
+
+template <typename Handle>
+auto getScopedRemoverHandleKey(const Handle & handle, long)
+	-> decltype(lockScopedRemoverHandle(handle, 0).get(), std::uint64_t())
+{
+	return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(lockScopedRemoverHandle(handle, 0).get()));
+}
+
+// OPT-47: The items are in a vector, adding one is a push_back. The index
+// by the node of the handle is built by the first remove of a single handle,
+// and kept from then on, so removing one handle doesn't scan all items.
+template <typename Item>
+class ScopedRemoverItemList
+{
+private:
+	struct Entry
+	{
+		Item item;
+		// 0 until the index is built, and for an expired handle.
+		std::uint64_t key;
+	};
+
+public:
+	template <typename Handle>
+	void add(const Item & item, const Handle & handle)
+	{
+		entryList.push_back(Entry { item, 0 });
+		if(indexed) {
+			doIndex(entryList.size() - 1, handle);
+		}
 	}
-	auto handlePointer = handle.lock();
-	std::unique_lock<Mutex> lock(mutex);
-	auto it = std::find_if(itemList.begin(), itemList.end(), [&handlePointer](Item & item) {
-		return item.handle && item.handle.lock() == handlePointer;
-	});
-	if(it != itemList.end()) {
-		itemList.erase(it);
+
+	template <typename Handle>
+	bool remove(const Handle & handle)
+	{
+		if(! handle) {
+			return false;
+		}
+		if(! indexed) {
+			indexed = true;
+			for(std::size_t i = 0; i < entryList.size(); ++i) {
+				doIndex(i, entryList[i].item.handle);
+			}
+		}
+
+		const std::uint64_t key = doGetKey(handle);
+		auto it = indexMap.find(key);
+		if(it == indexMap.end()) {
+			return false;
+		}
+		const std::size_t position = it->second;
+		// The item of a freed node may be at the same key, its handle is expired now.
+		if(doGetKey(entryList[position].item.handle) != key) {
+			return false;
+		}
+		indexMap.erase(it);
+
+		const std::size_t last = entryList.size() - 1;
+		if(position != last) {
+			entryList[position] = std::move(entryList[last]);
+			auto movedIt = indexMap.find(entryList[position].key);
+			if(movedIt != indexMap.end() && movedIt->second == last) {
+				movedIt->second = position;
+			}
+		}
+		entryList.pop_back();
 		return true;
 	}
-	return false;
-}
+
+	template <typename F>
+	void forEach(F && f) const
+	{
+		for(const Entry & entry : entryList) {
+			f(entry.item);
+		}
+	}
+
+	void clear()
+	{
+		entryList.clear();
+		indexMap.clear();
+		indexed = false;
+	}
+
+	void swap(ScopedRemoverItemList & other) noexcept
+	{
+		using std::swap;
+
+		entryList.swap(other.entryList);
+		indexMap.swap(other.indexMap);
+		swap(indexed, other.indexed);
+	}
+
+private:
+	template <typename Handle>
+	void doIndex(const std::size_t position, const Handle & handle)
+	{
+		const std::uint64_t key = doGetKey(handle);
+		entryList[position].key = key;
+		// A node freed before may have the same address, its item is replaced.
+		if(key != 0) {
+			indexMap[key] = position;
+		}
+	}
+
+	template <typename Handle>
+	static std::uint64_t doGetKey(const Handle & handle)
+	{
+		return getScopedRemoverHandleKey(handle, 0);
+	}
+
+private:
+	std::vector<Entry> entryList;
+	std::unordered_map<std::uint64_t, std::size_t> indexMap;
+	bool indexed = false;
+};
 
 } //namespace internal_
 
 template <typename DispatcherType, typename Enabled = void>
 class ScopedRemover;
 
+// OPT-47: If the dispatcher has the ListenerGroupsEnabled policy, the
+// listeners are added with the group of the remover, and reset removes all
+// of them at once by group.removeAll(). Otherwise reset removes them one by one.
 template <typename DispatcherType>
 class ScopedRemover <
 		DispatcherType,
@@ -58,7 +184,9 @@ private:
 		typename DispatcherType::Event event;
 		typename DispatcherType::Handle handle;
 	};
-	
+
+	using HasListenerGroup = internal_::DispatcherHasListenerGroup<DispatcherType>;
+
 public:
 	ScopedRemover()
 		: dispatcher(nullptr)
@@ -71,7 +199,7 @@ public:
 	}
 
 	ScopedRemover(ScopedRemover && other) noexcept
-		: dispatcher(std::move(other.dispatcher)), itemList(std::move(other.itemList))
+		: dispatcher(std::move(other.dispatcher)), itemList(std::move(other.itemList)), listenerGroup(std::move(other.listenerGroup))
 	{
 		other.reset();
 	}
@@ -80,6 +208,7 @@ public:
 	{
 		dispatcher = std::move(other.dispatcher);
 		itemList = std::move(other.itemList);
+		listenerGroup = std::move(other.listenerGroup);
 		other.reset();
 		return *this;
 	}
@@ -93,16 +222,13 @@ public:
 		using std::swap;
 
 		swap(dispatcher, other.dispatcher);
-		swap(itemList, other.itemList);
+		itemList.swap(other.itemList);
+		listenerGroup.swap(other.listenerGroup);
 	}
 
 	void reset()
 	{
-		if(dispatcher != nullptr) {
-			for(const auto & item : itemList) {
-				dispatcher->removeListener(item.event, item.handle);
-			}
-		}
+		doRemoveAll(HasListenerGroup());
 		
 		std::unique_lock<typename DispatcherType::Mutex> lock(itemListMutex);
 		itemList.clear();
@@ -122,17 +248,10 @@ public:
 			const Callback & listener
 		)
 	{
-		Item item {
+		return doAddItem(Item {
 			event,
-			dispatcher->appendListener(event, listener)
-		};
-
-		{
-			std::unique_lock<typename DispatcherType::Mutex> lock(itemListMutex);
-			itemList.push_back(item);
-		}
-
-		return item.handle;
+			doAppendListener(event, listener, HasListenerGroup())
+		});
 	}
 
 	template <typename Callback>
@@ -141,17 +260,10 @@ public:
 			const Callback & listener
 		)
 	{
-		Item item {
+		return doAddItem(Item {
 			event,
-			dispatcher->prependListener(event, listener)
-		};
-		
-		{
-			std::unique_lock<typename DispatcherType::Mutex> lock(itemListMutex);
-			itemList.push_back(item);
-		}
-		
-		return item.handle;
+			doPrependListener(event, listener, HasListenerGroup())
+		});
 	}
 
 	template <typename Callback>
@@ -161,30 +273,98 @@ public:
 			const typename DispatcherType::Handle & before
 		)
 	{
-		Item item {
+		return doAddItem(Item {
 			event,
-			dispatcher->insertListener(event, listener, before)
-		};
-		
+			doInsertListener(event, listener, before, HasListenerGroup())
+		});
+	}
+
+	bool removeListener(const typename DispatcherType::Event & event, const typename DispatcherType::Handle handle)
+	{
+		bool removed;
 		{
 			std::unique_lock<typename DispatcherType::Mutex> lock(itemListMutex);
-			itemList.push_back(item);
+			removed = itemList.remove(handle);
 		}
-		
+		if(removed) {
+			return dispatcher->removeListener(event, handle);
+		}
+		return false;
+	}
+
+private:
+	typename DispatcherType::Handle doAddItem(const Item & item)
+	{
+		std::unique_lock<typename DispatcherType::Mutex> lock(itemListMutex);
+		itemList.add(item, item.handle);
+
 		return item.handle;
 	}
 
-	bool removeListener(const typename DispatcherType::Event & event, const typename DispatcherType::Handle handle)
+	template <typename Callback>
+	typename DispatcherType::Handle doAppendListener(const typename DispatcherType::Event & event, const Callback & listener, std::true_type)
 	{
-		if(internal_::removeHandleFromScopedRemoverItemList(itemList, handle, itemListMutex)) {
-			return dispatcher->removeListener(event, handle);
+		return dispatcher->appendListener(event, listener, listenerGroup);
+	}
+
+	template <typename Callback>
+	typename DispatcherType::Handle doAppendListener(const typename DispatcherType::Event & event, const Callback & listener, std::false_type)
+	{
+		return dispatcher->appendListener(event, listener);
+	}
+
+	template <typename Callback>
+	typename DispatcherType::Handle doPrependListener(const typename DispatcherType::Event & event, const Callback & listener, std::true_type)
+	{
+		return dispatcher->prependListener(event, listener, listenerGroup);
+	}
+
+	template <typename Callback>
+	typename DispatcherType::Handle doPrependListener(const typename DispatcherType::Event & event, const Callback & listener, std::false_type)
+	{
+		return dispatcher->prependListener(event, listener);
+	}
+
+	template <typename Callback>
+	typename DispatcherType::Handle doInsertListener(
+			const typename DispatcherType::Event & event,
+			const Callback & listener,
+			const typename DispatcherType::Handle & before,
+			std::true_type
+		)
+	{
+		return dispatcher->insertListener(event, listener, before, listenerGroup);
+	}
+
+	template <typename Callback>
+	typename DispatcherType::Handle doInsertListener(
+			const typename DispatcherType::Event & event,
+			const Callback & listener,
+			const typename DispatcherType::Handle & before,
+			std::false_type
+		)
+	{
+		return dispatcher->insertListener(event, listener, before);
+	}
+
+	void doRemoveAll(std::true_type)
+	{
+		listenerGroup.removeAll();
+	}
+
+	void doRemoveAll(std::false_type)
+	{
+		if(dispatcher != nullptr) {
+			itemList.forEach([this](const Item & item) {
+				dispatcher->removeListener(item.event, item.handle);
+			});
 		}
-		return false;
 	}
 
 private:
 	DispatcherType * dispatcher;
-	std::vector<Item> itemList;
+	internal_::ScopedRemoverItemList<Item> itemList;
+	ListenerGroup listenerGroup;
 	typename DispatcherType::Mutex itemListMutex;
 };
 
@@ -199,6 +379,8 @@ private:
 	{
 		typename CallbackListType::Handle handle;
 	};
+
+	using HasListenerGroup = internal_::CallbackListHasListenerGroup<CallbackListType>;
 	
 public:
 	ScopedRemover()
@@ -212,7 +394,7 @@ public:
 	}
 	
 	ScopedRemover(ScopedRemover && other) noexcept
-		: callbackList(std::move(other.callbackList)), itemList(std::move(other.itemList))
+		: callbackList(std::move(other.callbackList)), itemList(std::move(other.itemList)), listenerGroup(std::move(other.listenerGroup))
 	{
 		other.reset();
 	}
@@ -221,6 +403,7 @@ public:
 	{
 		callbackList = std::move(other.callbackList);
 		itemList = std::move(other.itemList);
+		listenerGroup = std::move(other.listenerGroup);
 		other.reset();
 		return *this;
 	}
@@ -234,16 +417,13 @@ public:
 		using std::swap;
 
 		swap(callbackList, other.callbackList);
-		swap(itemList, other.itemList);
+		itemList.swap(other.itemList);
+		listenerGroup.swap(other.listenerGroup);
 	}
 
 	void reset()
 	{
-		if(callbackList != nullptr) {
-			for(const auto & item : itemList) {
-				callbackList->remove(item.handle);
-			}
-		}
+		doRemoveAll(HasListenerGroup());
 
 		std::unique_lock<typename CallbackListType::Mutex> lock(itemListMutex);
 		itemList.clear();
@@ -262,16 +442,9 @@ public:
 			const Callback & callback
 		)
 	{
-		Item item {
-			callbackList->append(callback)
-		};
-
-		{
-			std::unique_lock<typename CallbackListType::Mutex> lock(itemListMutex);
-			itemList.push_back(item);
-		}
-
-		return item.handle;
+		return doAddItem(Item {
+			doAppend(callback, HasListenerGroup())
+		});
 	}
 
 	template <typename Callback>
@@ -279,16 +452,9 @@ public:
 			const Callback & callback
 		)
 	{
-		Item item {
-			callbackList->prepend(callback)
-		};
-
-		{
-			std::unique_lock<typename CallbackListType::Mutex> lock(itemListMutex);
-			itemList.push_back(item);
-		}
-
-		return item.handle;
+		return doAddItem(Item {
+			doPrepend(callback, HasListenerGroup())
+		});
 	}
 
 	template <typename Callback>
@@ -297,29 +463,87 @@ public:
 			const typename CallbackListType::Handle & before
 		)
 	{
-		Item item {
-			callbackList->insert(callback, before)
-		};
+		return doAddItem(Item {
+			doInsert(callback, before, HasListenerGroup())
+		});
+	}
 
+	bool remove(const typename CallbackListType::Handle handle)
+	{
+		bool removed;
 		{
 			std::unique_lock<typename CallbackListType::Mutex> lock(itemListMutex);
-			itemList.push_back(item);
+			removed = itemList.remove(handle);
+		}
+		if(removed) {
+			return callbackList->remove(handle);
 		}
+		return false;
+	}
+
+private:
+	typename CallbackListType::Handle doAddItem(const Item & item)
+	{
+		std::unique_lock<typename CallbackListType::Mutex> lock(itemListMutex);
+		itemList.add(item, item.handle);
 
 		return item.handle;
 	}
 
-	bool remove(const typename CallbackListType::Handle handle)
+	template <typename Callback>
+	typename CallbackListType::Handle doAppend(const Callback & callback, std::true_type)
 	{
-		if(internal_::removeHandleFromScopedRemoverItemList(itemList, handle, itemListMutex)) {
-			return callbackList->remove(handle);
+		return callbackList->append(callback, listenerGroup);
+	}
+
+	template <typename Callback>
+	typename CallbackListType::Handle doAppend(const Callback & callback, std::false_type)
+	{
+		return callbackList->append(callback);
+	}
+
+	template <typename Callback>
+	typename CallbackListType::Handle doPrepend(const Callback & callback, std::true_type)
+	{
+		return callbackList->prepend(callback, listenerGroup);
+	}
+
+	template <typename Callback>
+	typename CallbackListType::Handle doPrepend(const Callback & callback, std::false_type)
+	{
+		return callbackList->prepend(callback);
+	}
+
+	template <typename Callback>
+	typename CallbackListType::Handle doInsert(const Callback & callback, const typename CallbackListType::Handle & before, std::true_type)
+	{
+		return callbackList->insert(callback, before, listenerGroup);
+	}
+
+	template <typename Callback>
+	typename CallbackListType::Handle doInsert(const Callback & callback, const typename CallbackListType::Handle & before, std::false_type)
+	{
+		return callbackList->insert(callback, before);
+	}
+
+	void doRemoveAll(std::true_type)
+	{
+		listenerGroup.removeAll();
+	}
+
+	void doRemoveAll(std::false_type)
+	{
+		if(callbackList != nullptr) {
+			itemList.forEach([this](const Item & item) {
+				callbackList->remove(item.handle);
+			});
 		}
-		return false;
 	}
 
 private:
 	CallbackListType * callbackList;
-	std::vector<Item> itemList;
+	internal_::ScopedRemoverItemList<Item> itemList;
+	ListenerGroup listenerGroup;
 	typename CallbackListType::Mutex itemListMutex;
 };
 
@@ -327,4 +551,3 @@ private:
 } //namespace eventpp
 
 #endif
-
@@ -0,0 +1,144 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SHARDEDSHAREDMUTEX_H_EVENTPP
+#define SHARDEDSHAREDMUTEX_H_EVENTPP
+
+#include "../eventpolicies.h"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+namespace eventpp {
+
+namespace internal_ {
+
+// Each thread gets the next shard, so up to shardCount threads don't share
+// any shard.
+inline std::size_t getThreadShardIndex()
+{
+	static std::atomic<std::size_t> nextIndex(0);
+	static thread_local const std::size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+	return index;
+}
+
+} //namespace internal_
+
+// OPT-38: Distributed reader-writer lock (brlock), a SharedMutex for
+// GeneralThreading. A reader only writes the counter of its own shard, on
+// its own cache line, so the readers on different threads don't contend.
+// A writer blocks the new readers, then waits for the count of every shard
+// to be 0, so locking is slow and the mutex takes shardCount cache lines.
+// It suits the listener mutex of the dispatchers, which is mostly locked
+// shared by dispatch. Neither lock is recursive, and a shared lock must be
+// unlocked by the thread which locked it.
+template <std::size_t shardCount = 64>
+class ShardedSharedMutex
+{
+private:
+	struct EVENTPP_ALIGN_CACHELINE Shard
+	{
+		std::atomic<int> readerCount;
+	};
+
+	static_assert(shardCount > 0, "ShardedSharedMutex: shardCount must not be 0.");
+
+public:
+	ShardedSharedMutex()
+		: shardList(), writing(false), writerMutex()
+	{
+		for(auto & shard : shardList) {
+			shard.readerCount.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	ShardedSharedMutex(const ShardedSharedMutex &) = delete;
+	ShardedSharedMutex & operator = (const ShardedSharedMutex &) = delete;
+
+	void lock_shared() {
+		Shard & shard = doGetShard();
+		while(! doTryLockShared(shard)) {
+			while(writing.load(std::memory_order_relaxed)) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	bool try_lock_shared() {
+		return doTryLockShared(doGetShard());
+	}
+
+	void unlock_shared() {
+		doGetShard().readerCount.fetch_sub(1, std::memory_order_release);
+	}
+
+	void lock() {
+		writerMutex.lock();
+		writing.store(true, std::memory_order_seq_cst);
+		for(auto & shard : shardList) {
+			while(shard.readerCount.load(std::memory_order_seq_cst) != 0) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	bool try_lock() {
+		if(! writerMutex.try_lock()) {
+			return false;
+		}
+		writing.store(true, std::memory_order_seq_cst);
+		for(auto & shard : shardList) {
+			if(shard.readerCount.load(std::memory_order_seq_cst) != 0) {
+				writing.store(false, std::memory_order_release);
+				writerMutex.unlock();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void unlock() {
+		writing.store(false, std::memory_order_release);
+		writerMutex.unlock();
+	}
+
+private:
+	Shard & doGetShard() {
+		return shardList[internal_::getThreadShardIndex() % shardCount];
+	}
+
+	// The reader counts itself before it checks for a writer, and the
+	// writer sets writing before it checks the counts, both sequentially
+	// consistent, so at least one of them sees the other.
+	bool doTryLockShared(Shard & shard) {
+		shard.readerCount.fetch_add(1, std::memory_order_seq_cst);
+		if(! writing.load(std::memory_order_seq_cst)) {
+			return true;
+		}
+		shard.readerCount.fetch_sub(1, std::memory_order_release);
+		return false;
+	}
+
+private:
+	Shard shardList[shardCount];
+	EVENTPP_ALIGN_CACHELINE std::atomic<bool> writing;
+	std::mutex writerMutex;
+};
+
+
+} //namespace eventpp
+
+#endif
+
@@ -0,0 +1,78 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef STRIPEDMUTEX_H_EVENTPP
+#define STRIPEDMUTEX_H_EVENTPP
+
+#include "../eventpolicies.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace eventpp {
+
+// OPT-62: A Mutex of GeneralThreading which has no state. It locks one of
+// stripeCount mutexes shared by all StripedMutex objects of the type, picked
+// by its address. A CallbackList with it is a mutex smaller, which matters
+// when there are millions of lists, and the lists which share a stripe
+// contend a little.
+// A thread must not lock two StripedMutex objects at once, they may be the
+// same stripe. CallbackList never does.
+template <std::size_t stripeCount = 64, typename Mutex_ = std::mutex>
+class StripedMutex
+{
+private:
+	static_assert(stripeCount > 0 && (stripeCount & (stripeCount - 1)) == 0,
+		"StripedMutex: stripeCount must be a power of 2.");
+
+	struct EVENTPP_ALIGN_CACHELINE Stripe
+	{
+		Mutex_ mutex;
+	};
+
+public:
+	StripedMutex() noexcept {
+	}
+
+	StripedMutex(const StripedMutex &) = delete;
+	StripedMutex & operator = (const StripedMutex &) = delete;
+
+	void lock() {
+		doGetMutex().lock();
+	}
+
+	bool try_lock() {
+		return doGetMutex().try_lock();
+	}
+
+	void unlock() {
+		doGetMutex().unlock();
+	}
+
+private:
+	Mutex_ & doGetMutex() const {
+		static Stripe stripeList[stripeCount];
+
+		// The low bits of an address are mostly the same, mix the others in.
+		std::uintptr_t value = reinterpret_cast<std::uintptr_t>(this) >> 4;
+		value ^= value >> 7;
+		value ^= value >> 17;
+		return stripeList[value & (stripeCount - 1)].mutex;
+	}
+};
+
+
+} //namespace eventpp
+
+#endif
@@ -0,0 +1,257 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRACERS_H_EVENTPP
+#define TRACERS_H_EVENTPP
+
+#include "../internal/tracing_i.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#if defined(__has_include)
+	#if __has_include(<sys/sdt.h>)
+		#include <sys/sdt.h>
+		#define EVENTPP_HAS_USDT 1
+	#endif
+#endif
+#ifndef EVENTPP_HAS_USDT
+	#define EVENTPP_HAS_USDT 0
+#endif
+
+namespace eventpp {
+
+// OPT-34: Keeps the latest capacity records of each thread in a ring owned
+// by the thread, the writes don't take any lock. dump writes them in the
+// Chrome trace event format, which can be opened by chrome://tracing and
+// Perfetto. Each dispatch is a slice, connected by a flow arrow from the
+// slice which enqueued the event, if there is one.
+template <std::size_t capacity = 16384>
+class ChromeTracer
+{
+private:
+	struct Entry
+	{
+		TraceRecord record;
+		bool dispatched;
+	};
+
+	struct ThreadRing
+	{
+		explicit ThreadRing(const unsigned int threadIndex)
+			: threadIndex(threadIndex), writeCount(0), entryList(capacity)
+		{
+		}
+
+		const unsigned int threadIndex;
+		std::atomic<std::uint64_t> writeCount;
+		std::vector<Entry> entryList;
+	};
+
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ThreadRing> > ringList;
+	};
+
+	static_assert(capacity > 0, "ChromeTracer: capacity must not be 0.");
+
+public:
+	static void onEnqueue(const TraceRecord & record)
+	{
+		doWrite(record, false);
+	}
+
+	static void onDispatch(const TraceRecord & record)
+	{
+		doWrite(record, true);
+	}
+
+	// The records are not locked, call it when no thread is enqueuing to or
+	// dispatching the traced queues.
+	static void dump(std::ostream & stream)
+	{
+		Registry & registry = doGetRegistry();
+		std::lock_guard<std::mutex> lockGuard(registry.mutex);
+
+		stream << "{\"traceEvents\":[";
+		bool first = true;
+		for(const auto & ring : registry.ringList) {
+			const std::uint64_t writeCount = ring->writeCount.load(std::memory_order_acquire);
+			const std::uint64_t begin = (writeCount > capacity ? writeCount - capacity : 0);
+			for(std::uint64_t i = begin; i < writeCount; ++i) {
+				const Entry & entry = ring->entryList[static_cast<std::size_t>(i % capacity)];
+				if(! first) {
+					stream << ',';
+				}
+				first = false;
+				doDumpEntry(stream, entry, ring->threadIndex);
+			}
+		}
+		stream << "],\"displayTimeUnit\":\"ns\"}";
+	}
+
+	static void clear()
+	{
+		Registry & registry = doGetRegistry();
+		std::lock_guard<std::mutex> lockGuard(registry.mutex);
+		for(const auto & ring : registry.ringList) {
+			ring->writeCount.store(0, std::memory_order_release);
+		}
+	}
+
+	// The count of the records which dump writes.
+	static std::size_t getRecordCount()
+	{
+		Registry & registry = doGetRegistry();
+		std::lock_guard<std::mutex> lockGuard(registry.mutex);
+		std::size_t count = 0;
+		for(const auto & ring : registry.ringList) {
+			const std::uint64_t writeCount = ring->writeCount.load(std::memory_order_acquire);
+			count += static_cast<std::size_t>(writeCount > capacity ? capacity : writeCount);
+		}
+		return count;
+	}
+
+private:
+	static Registry & doGetRegistry()
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	// The rings are never freed, so the records of the finished threads can
+	// still be dumped.
+	static ThreadRing & doGetThreadRing()
+	{
+		static thread_local ThreadRing * ring = nullptr;
+		if(ring == nullptr) {
+			Registry & registry = doGetRegistry();
+			std::lock_guard<std::mutex> lockGuard(registry.mutex);
+			registry.ringList.emplace_back(new ThreadRing(static_cast<unsigned int>(registry.ringList.size() + 1)));
+			ring = registry.ringList.back().get();
+		}
+		return *ring;
+	}
+
+	static void doWrite(const TraceRecord & record, const bool dispatched)
+	{
+		ThreadRing & ring = doGetThreadRing();
+		const std::uint64_t writeCount = ring.writeCount.load(std::memory_order_relaxed);
+		ring.entryList[static_cast<std::size_t>(writeCount % capacity)] = Entry { record, dispatched };
+		ring.writeCount.store(writeCount + 1, std::memory_order_release);
+	}
+
+	// The same event has the same flow ID at enqueue and at dispatch.
+	static std::uint64_t doGetFlowId(const TraceRecord & record)
+	{
+		return (record.traceId * 0x9e3779b97f4a7c15ull) ^ static_cast<std::uint64_t>(record.enqueueTime.time_since_epoch().count());
+	}
+
+	static void doWriteMicroseconds(std::ostream & stream, const std::chrono::steady_clock::time_point & timePoint)
+	{
+		doWriteMicroseconds(stream, timePoint.time_since_epoch());
+	}
+
+	static void doWriteMicroseconds(std::ostream & stream, const std::chrono::steady_clock::duration & duration)
+	{
+		const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+		const auto fraction = nanoseconds % 1000;
+		stream << (nanoseconds / 1000) << '.' << (fraction < 100 ? "0" : "") << (fraction < 10 ? "0" : "") << fraction;
+	}
+
+	static void doDumpEntry(std::ostream & stream, const Entry & entry, const unsigned int threadIndex)
+	{
+		const TraceRecord & record = entry.record;
+
+		stream << "{\"cat\":\"eventpp\",\"pid\":1,\"tid\":" << threadIndex;
+		if(entry.dispatched) {
+			stream << ",\"name\":\"event " << record.eventId << "\",\"ph\":\"X\",\"ts\":";
+			doWriteMicroseconds(stream, record.beginTime);
+			stream << ",\"dur\":";
+			doWriteMicroseconds(stream, record.endTime - record.beginTime);
+			stream << ",\"args\":{\"traceId\":" << record.traceId
+				<< ",\"queue\":\"" << record.queue << "\""
+				<< ",\"residencyUs\":";
+			doWriteMicroseconds(stream, record.beginTime - record.enqueueTime);
+			stream << "}},";
+
+			stream << "{\"cat\":\"eventpp\",\"pid\":1,\"tid\":" << threadIndex
+				<< ",\"name\":\"queue\",\"ph\":\"f\",\"bp\":\"e\",\"id\":\"" << doGetFlowId(record) << "\",\"ts\":";
+			doWriteMicroseconds(stream, record.beginTime);
+			stream << '}';
+		}
+		else {
+			stream << ",\"name\":\"queue\",\"ph\":\"s\",\"id\":\"" << doGetFlowId(record) << "\",\"ts\":";
+			doWriteMicroseconds(stream, record.enqueueTime);
+			stream << '}';
+		}
+	}
+};
+
+// OPT-34: Fires the USDT probes eventpp:enqueue(traceId, eventId, queue) and
+// eventpp:dispatch(traceId, eventId, queue, residencyNs, durationNs), which
+// can be traced by bpftrace, perf, SystemTap or LTTng. A probe which is not
+// attached costs a nop. Without <sys/sdt.h> it does nothing.
+struct UsdtTracer
+{
+	static void onEnqueue(const TraceRecord & record)
+	{
+#if EVENTPP_HAS_USDT
+		DTRACE_PROBE3(eventpp, enqueue, record.traceId, record.eventId, record.queue);
+#else
+		(void)record;
+#endif
+	}
+
+	static void onDispatch(const TraceRecord & record)
+	{
+#if EVENTPP_HAS_USDT
+		const std::int64_t residency = std::chrono::duration_cast<std::chrono::nanoseconds>(record.beginTime - record.enqueueTime).count();
+		const std::int64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(record.endTime - record.beginTime).count();
+		DTRACE_PROBE5(eventpp, dispatch, record.traceId, record.eventId, record.queue, residency, duration);
+#else
+		(void)record;
+#endif
+	}
+};
+
+// OPT-34: Passes the records to all Tracers, in order.
+template <typename ...Tracers>
+struct TracerList
+{
+	static void onEnqueue(const TraceRecord & record)
+	{
+		const int dummy[] = { 0, (Tracers::onEnqueue(record), 0)... };
+		(void)dummy;
+	}
+
+	static void onDispatch(const TraceRecord & record)
+	{
+		const int dummy[] = { 0, (Tracers::onDispatch(record), 0)... };
+		(void)dummy;
+	}
+};
+
+
+} //namespace eventpp
+
+
+#endif
+
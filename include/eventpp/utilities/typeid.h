@@ -0,0 +1,257 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TYPEID_H_EVENTPP
+#define TYPEID_H_EVENTPP
+
+#include "../internal/eventconstant_i.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace eventpp {
+
+namespace internal_ {
+
+template <typename T>
+struct TypeIdHolder;
+
+inline std::atomic<std::uint32_t> & getTypeIdCounter()
+{
+	static std::atomic<std::uint32_t> counter(0);
+	return counter;
+}
+
+} //namespace internal_
+
+// OPT-79: A dense ID of a C++ type, used as the event type, so a type is an
+// event without std::type_index. The types get the IDs 0, 1, 2... in the
+// order getTypeId is first called for them, the IDs are stable within the
+// process, and are not the same in another process or run.
+class TypeId
+{
+public:
+	enum : std::uint32_t { noType = 0xffffffffu };
+
+	// No type.
+	constexpr TypeId() noexcept : index(noType)
+	{
+	}
+
+	constexpr std::uint32_t getIndex() const noexcept {
+		return index;
+	}
+
+	constexpr bool operator == (const TypeId & other) const noexcept {
+		return index == other.index;
+	}
+
+	constexpr bool operator != (const TypeId & other) const noexcept {
+		return index != other.index;
+	}
+
+	constexpr bool operator < (const TypeId & other) const noexcept {
+		return index < other.index;
+	}
+
+private:
+	constexpr explicit TypeId(const std::uint32_t index) noexcept : index(index)
+	{
+	}
+
+	template <typename T>
+	friend struct internal_::TypeIdHolder;
+
+private:
+	std::uint32_t index;
+};
+
+namespace internal_ {
+
+// The ID is assigned once, the later calls are a check of the guard.
+template <typename T>
+struct TypeIdHolder
+{
+	static TypeId get()
+	{
+		static const TypeId id(getTypeIdCounter().fetch_add(1, std::memory_order_relaxed));
+		return id;
+	}
+};
+
+// dispatch<T> of a dispatcher whose event type is TypeId dispatches the
+// event of type T.
+template <typename T>
+struct EventConstantValue <TypeId, T>
+{
+	static TypeId get()
+	{
+		return TypeIdHolder<typename std::remove_cv<typename std::remove_reference<T>::type>::type>::get();
+	}
+};
+
+} //namespace internal_
+
+// The cv and reference qualifiers are ignored, getTypeId<const A &>() is
+// getTypeId<A>().
+template <typename T>
+TypeId getTypeId()
+{
+	return internal_::EventConstantValue<TypeId, T>::get();
+}
+
+// The number of the types which have an ID.
+inline std::size_t getTypeIdCount()
+{
+	return internal_::getTypeIdCounter().load(std::memory_order_relaxed);
+}
+
+// OPT-79: Map policy for TypeId. The values are found by the index of
+// the ID in an array of pointers, which is sized to all the type IDs when
+// the first event is added, and grows when a later type is added. The
+// values are never moved, so the pointers held by the dispatchers stay
+// valid. Only the operations used by the dispatchers are supported.
+template <typename Key, typename T>
+class TypeIdMap
+{
+private:
+	static_assert(std::is_same<Key, TypeId>::value, "TypeIdMap: the key must be TypeId.");
+
+public:
+	using key_type = Key;
+	using mapped_type = T;
+	using value_type = std::pair<const Key, T>;
+	using size_type = std::size_t;
+	using iterator = value_type *;
+	using const_iterator = const value_type *;
+
+public:
+	TypeIdMap() : slotList(), valueList()
+	{
+	}
+
+	TypeIdMap(const TypeIdMap & other) : slotList(), valueList()
+	{
+		doCopyFrom(other);
+	}
+
+	// The deque keeps its elements when it's moved, so do the slots.
+	TypeIdMap(TypeIdMap && other) noexcept
+		: slotList(std::move(other.slotList)), valueList(std::move(other.valueList))
+	{
+	}
+
+	TypeIdMap & operator = (const TypeIdMap & other)
+	{
+		if(this != &other) {
+			TypeIdMap copied(other);
+			swap(copied);
+		}
+		return *this;
+	}
+
+	TypeIdMap & operator = (TypeIdMap && other) noexcept
+	{
+		swap(other);
+		return *this;
+	}
+
+	T & operator[] (const Key & key) {
+		assert(key != Key());
+		const std::size_t index = key.getIndex();
+		if(index >= slotList.size()) {
+			const std::size_t count = getTypeIdCount();
+			slotList.resize(index < count ? count : index + 1, nullptr);
+		}
+		value_type * & slot = slotList[index];
+		if(slot == nullptr) {
+			valueList.emplace_back(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple());
+			slot = &valueList.back();
+		}
+		return slot->second;
+	}
+
+	iterator find(const Key & key) {
+		const std::size_t index = key.getIndex();
+		return index < slotList.size() ? slotList[index] : end();
+	}
+
+	const_iterator find(const Key & key) const {
+		const std::size_t index = key.getIndex();
+		return index < slotList.size() ? slotList[index] : end();
+	}
+
+	iterator end() {
+		return nullptr;
+	}
+
+	const_iterator end() const {
+		return nullptr;
+	}
+
+	size_type size() const {
+		return valueList.size();
+	}
+
+	bool empty() const {
+		return valueList.empty();
+	}
+
+	void swap(TypeIdMap & other) noexcept {
+		slotList.swap(other.slotList);
+		valueList.swap(other.valueList);
+	}
+
+	friend void swap(TypeIdMap & first, TypeIdMap & second) noexcept {
+		first.swap(second);
+	}
+
+private:
+	void doCopyFrom(const TypeIdMap & other)
+	{
+		slotList.resize(other.slotList.size(), nullptr);
+		for(const value_type & value : other.valueList) {
+			valueList.push_back(value);
+			slotList[value.first.getIndex()] = &valueList.back();
+		}
+	}
+
+private:
+	std::vector<value_type *> slotList;
+	std::deque<value_type> valueList;
+};
+
+
+} //namespace eventpp
+
+namespace std {
+
+template <>
+struct hash<eventpp::TypeId>
+{
+	std::size_t operator() (const eventpp::TypeId & id) const noexcept {
+		return id.getIndex();
+	}
+};
+
+} //namespace std
+
+#endif
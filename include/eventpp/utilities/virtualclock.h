@@ -0,0 +1,75 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef VIRTUALCLOCK_H_EVENTPP
+#define VIRTUALCLOCK_H_EVENTPP
+
+#include <atomic>
+#include <chrono>
+
+namespace eventpp {
+
+// OPT-81: A clock which only moves when it's told, for the Clock policy of
+// EventQueue. The waits of the queue advance it to the next delayed event
+// instead of sleeping, so a replay of recorded events runs as fast as the
+// CPU can dispatch them. The time is global to the Tag, the simulations
+// which run at the same time use their own tags.
+template <typename Tag = void>
+class VirtualClock
+{
+public:
+	using duration = std::chrono::nanoseconds;
+	using rep = duration::rep;
+	using period = duration::period;
+	using time_point = std::chrono::time_point<VirtualClock, duration>;
+
+	static constexpr bool is_steady = true;
+
+	static time_point now() noexcept {
+		return time_point(duration(getTicks().load(std::memory_order_acquire)));
+	}
+
+	// Moves the clock to timePoint, the clock never goes back.
+	static void advanceTo(const time_point & timePoint) noexcept {
+		std::atomic<rep> & ticks = getTicks();
+		rep current = ticks.load(std::memory_order_relaxed);
+		const rep target = timePoint.time_since_epoch().count();
+		while(current < target
+			&& ! ticks.compare_exchange_weak(current, target, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+		}
+	}
+
+	template <class Rep, class Period>
+	static void advance(const std::chrono::duration<Rep, Period> & delta) noexcept {
+		advanceTo(now() + std::chrono::duration_cast<duration>(delta));
+	}
+
+	// Sets the clock, it may go back. Set it before the queues are made, a
+	// queue with TimerWheel counts the ticks from the time it's made.
+	static void reset(const time_point & timePoint = time_point()) noexcept {
+		getTicks().store(timePoint.time_since_epoch().count(), std::memory_order_release);
+	}
+
+private:
+	static std::atomic<rep> & getTicks() noexcept {
+		static std::atomic<rep> ticks(0);
+		return ticks;
+	}
+};
+
+template <typename Tag>
+constexpr bool VirtualClock<Tag>::is_steady;
+
+} //namespace eventpp
+
+#endif
@@ -0,0 +1,427 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef WINDOWAGGREGATOR_H_EVENTPP
+#define WINDOWAGGREGATOR_H_EVENTPP
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace eventpp {
+
+// OPT-78: The combiners of WindowAggregator. A combiner folds value into
+// total, and must also fold one total into another, so the panes of a
+// sliding window can be combined.
+struct WindowSum
+{
+	template <typename T>
+	void operator() (T & total, const T & value) const {
+		total += value;
+	}
+};
+
+struct WindowMin
+{
+	template <typename T>
+	void operator() (T & total, const T & value) const {
+		if(value < total) {
+			total = value;
+		}
+	}
+};
+
+struct WindowMax
+{
+	template <typename T>
+	void operator() (T & total, const T & value) const {
+		if(total < value) {
+			total = value;
+		}
+	}
+};
+
+struct WindowOptions
+{
+	// The length of a window.
+	std::chrono::nanoseconds windowSize = std::chrono::seconds(1);
+	// How far a window starts after the previous one. Zero is windowSize,
+	// the windows are tumbling. Otherwise windowSize must be a multiple
+	// of it, the windows are sliding.
+	std::chrono::nanoseconds slide = std::chrono::nanoseconds::zero();
+	// The keys each table has room for before it grows.
+	std::size_t keyCapacity = 64;
+};
+
+template <typename Key, typename Value>
+struct WindowResult
+{
+	Key key;
+	Value value;
+	// The number of values combined.
+	std::uint64_t count;
+	std::chrono::steady_clock::time_point windowBegin;
+	std::chrono::steady_clock::time_point windowEnd;
+};
+
+namespace internal_ {
+
+// An open addressing table with linear probing. clear only bumps the
+// generation, the slots are kept, so a table reused for each window only
+// allocates when it has more keys than any window before.
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+class WindowTable
+{
+private:
+	struct Slot
+	{
+		Key key;
+		Value value;
+		std::uint64_t count;
+		std::uint32_t generation;
+	};
+
+public:
+	explicit WindowTable(const std::size_t keyCapacity)
+		: slotList(),
+			usedList(),
+			mask(0),
+			shift(0),
+			generation(1)
+	{
+		doRehash(keyCapacity);
+	}
+
+	template <typename Combiner>
+	void add(const Key & key, const Value & value, const std::uint64_t count, const Combiner & combiner)
+	{
+		std::size_t index = doGetIndex(key);
+		for(;;) {
+			Slot & slot = slotList[index];
+			if(slot.generation != generation) {
+				break;
+			}
+			if(KeyEqual()(slot.key, key)) {
+				combiner(slot.value, value);
+				slot.count += count;
+				return;
+			}
+			index = (index + 1) & mask;
+		}
+
+		if((usedList.size() + 1) * 2 > slotList.size()) {
+			doRehash(slotList.size());
+			index = doGetIndex(key);
+			while(slotList[index].generation == generation) {
+				index = (index + 1) & mask;
+			}
+		}
+
+		Slot & slot = slotList[index];
+		slot.key = key;
+		slot.value = value;
+		slot.count = count;
+		slot.generation = generation;
+		usedList.push_back(static_cast<std::uint32_t>(index));
+	}
+
+	// func(key, value, count), in the order the keys are added.
+	template <typename F>
+	void forEach(F && func) const
+	{
+		for(const std::uint32_t index : usedList) {
+			const Slot & slot = slotList[index];
+			func(slot.key, slot.value, slot.count);
+		}
+	}
+
+	bool empty() const
+	{
+		return usedList.empty();
+	}
+
+	std::size_t size() const
+	{
+		return usedList.size();
+	}
+
+	void clear()
+	{
+		if(usedList.empty()) {
+			return;
+		}
+		usedList.clear();
+		if(++generation == 0) {
+			for(Slot & slot : slotList) {
+				slot.generation = 0;
+			}
+			generation = 1;
+		}
+	}
+
+private:
+	// Fibonacci hashing, so std::hash of an integer, which is the integer
+	// itself, spreads over the table.
+	std::size_t doGetIndex(const Key & key) const
+	{
+		const std::uint64_t hash = static_cast<std::uint64_t>(Hash()(key));
+		return static_cast<std::size_t>((hash * UINT64_C(0x9e3779b97f4a7c15)) >> shift);
+	}
+
+	// Doubles the slots until there are two for each of keyCapacity keys.
+	void doRehash(const std::size_t keyCapacity)
+	{
+		std::size_t slotCount = 8;
+		unsigned int bits = 3;
+		while(slotCount < keyCapacity * 2) {
+			slotCount <<= 1;
+			++bits;
+		}
+		if(slotCount <= slotList.size()) {
+			slotCount = slotList.size() << 1;
+			++bits;
+		}
+
+		std::vector<Slot> oldSlotList(slotCount);
+		oldSlotList.swap(slotList);
+		std::vector<std::uint32_t> oldUsedList;
+		oldUsedList.swap(usedList);
+		usedList.reserve(slotCount / 2);
+		mask = slotCount - 1;
+		shift = 64 - bits;
+		const std::uint32_t oldGeneration = generation;
+		generation = 1;
+
+		for(const std::uint32_t oldIndex : oldUsedList) {
+			Slot & oldSlot = oldSlotList[oldIndex];
+			assert(oldSlot.generation == oldGeneration);
+			(void)oldGeneration;
+			std::size_t index = doGetIndex(oldSlot.key);
+			while(slotList[index].generation == generation) {
+				index = (index + 1) & mask;
+			}
+			Slot & slot = slotList[index];
+			slot.key = std::move(oldSlot.key);
+			slot.value = std::move(oldSlot.value);
+			slot.count = oldSlot.count;
+			slot.generation = generation;
+			usedList.push_back(static_cast<std::uint32_t>(index));
+		}
+	}
+
+private:
+	std::vector<Slot> slotList;
+	std::vector<std::uint32_t> usedList;
+	std::size_t mask;
+	unsigned int shift;
+	std::uint32_t generation;
+};
+
+} //namespace internal_
+
+// OPT-78: Combines the values of each key over time windows, and emits one
+// result for each key at the close of each window. A window is split into
+// panes of the slide, each pane has its own table, a sliding window
+// combines the tables of its panes when it closes. The tables are cleared
+// and reused, no memory is allocated for a window once the tables have
+// grown to the number of keys.
+// Not thread safe, it's fed by one consumer, such as in processQueueWith.
+template <
+	typename Key,
+	typename Value,
+	typename Combiner = WindowSum,
+	typename Hash = std::hash<Key>,
+	typename KeyEqual = std::equal_to<Key>
+>
+class WindowAggregator
+{
+private:
+	using Table = internal_::WindowTable<Key, Value, Hash, KeyEqual>;
+
+public:
+	using Clock = std::chrono::steady_clock;
+	using Result = WindowResult<Key, Value>;
+	using Callback = std::function<void (const Result &)>;
+
+public:
+	WindowAggregator(const WindowOptions & options, Callback callback)
+		:
+			slide(options.slide > std::chrono::nanoseconds::zero() ? options.slide.count() : options.windowSize.count()),
+			paneCount(static_cast<std::size_t>(options.windowSize.count() / slide)),
+			paneList(),
+			mergedTable(options.keyCapacity),
+			callback(std::move(callback)),
+			combiner(),
+			nextClosePane(0),
+			started(false),
+			lateEventCount(0)
+	{
+		assert(slide > 0 && options.windowSize.count() % slide == 0);
+		paneList.reserve(paneCount);
+		for(std::size_t i = 0; i < paneCount; ++i) {
+			paneList.emplace_back(options.keyCapacity);
+		}
+	}
+
+	// The results are enqueued to queue as queue.enqueue(event, result).
+	template <typename Queue, typename Event>
+	WindowAggregator(const WindowOptions & options, Queue & queue, const Event & event)
+		: WindowAggregator(options, Callback([&queue, event](const Result & result) {
+			queue.enqueue(event, result);
+		}))
+	{
+	}
+
+	WindowAggregator(const WindowAggregator &) = delete;
+	WindowAggregator & operator = (const WindowAggregator &) = delete;
+
+	// Adds value to the window which is open at the time of the last
+	// advance, without reading the clock for each event.
+	void add(const Key & key, const Value & value)
+	{
+		assert(started);
+		doGetPane(nextClosePane).add(key, value, 1, combiner);
+	}
+
+	// Adds value to the windows which contain time. If the windows are
+	// closed, the value is dropped and false is returned. If time is after
+	// the open windows, the windows before it are closed first.
+	bool add(const Clock::time_point & time, const Key & key, const Value & value)
+	{
+		const std::int64_t pane = doGetPaneIndex(time);
+		if(! started) {
+			doStart(pane);
+		}
+		if(pane + static_cast<std::int64_t>(paneCount) <= nextClosePane) {
+			++lateEventCount;
+			return false;
+		}
+		if(pane > nextClosePane) {
+			doCloseUntil(pane);
+		}
+		doGetPane(pane).add(key, value, 1, combiner);
+		return true;
+	}
+
+	// Closes the windows which end at or before now, and emits their
+	// results, the earliest window first. Returns the number of results.
+	std::size_t advance(const Clock::time_point & now)
+	{
+		const std::int64_t pane = doGetPaneIndex(now);
+		if(! started) {
+			doStart(pane);
+			return 0;
+		}
+		return doCloseUntil(pane);
+	}
+
+	std::uint64_t getLateEventCount() const
+	{
+		return lateEventCount;
+	}
+
+private:
+	std::int64_t doGetPaneIndex(const Clock::time_point & time) const
+	{
+		const std::int64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+		return nanoseconds >= 0 ? nanoseconds / slide : -((-nanoseconds - 1) / slide) - 1;
+	}
+
+	void doStart(const std::int64_t pane)
+	{
+		started = true;
+		nextClosePane = pane;
+	}
+
+	Table & doGetPane(const std::int64_t pane)
+	{
+		const std::int64_t count = static_cast<std::int64_t>(paneCount);
+		return paneList[static_cast<std::size_t>(((pane % count) + count) % count)];
+	}
+
+	// The window ending at pane is closed when pane starts.
+	std::size_t doCloseUntil(const std::int64_t pane)
+	{
+		std::size_t resultCount = 0;
+		while(nextClosePane < pane) {
+			if(doAllPanesEmpty()) {
+				nextClosePane = pane;
+				break;
+			}
+			resultCount += doCloseWindow(nextClosePane);
+			++nextClosePane;
+			// The oldest pane of the window is in no more windows.
+			doGetPane(nextClosePane - static_cast<std::int64_t>(paneCount)).clear();
+		}
+		return resultCount;
+	}
+
+	std::size_t doCloseWindow(const std::int64_t lastPane)
+	{
+		const std::int64_t firstPane = lastPane - static_cast<std::int64_t>(paneCount) + 1;
+		Result result;
+		result.windowBegin = Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(firstPane * slide)));
+		result.windowEnd = Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds((lastPane + 1) * slide)));
+
+		const Table * table = &doGetPane(lastPane);
+		if(paneCount > 1) {
+			mergedTable.clear();
+			for(std::int64_t pane = firstPane; pane <= lastPane; ++pane) {
+				doGetPane(pane).forEach([this](const Key & key, const Value & value, const std::uint64_t count) {
+					mergedTable.add(key, value, count, combiner);
+				});
+			}
+			table = &mergedTable;
+		}
+
+		table->forEach([this, &result](const Key & key, const Value & value, const std::uint64_t count) {
+			result.key = key;
+			result.value = value;
+			result.count = count;
+			callback(result);
+		});
+		return table->size();
+	}
+
+	bool doAllPanesEmpty() const
+	{
+		for(const Table & table : paneList) {
+			if(! table.empty()) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	const std::int64_t slide;
+	const std::size_t paneCount;
+	std::vector<Table> paneList;
+	Table mergedTable;
+	Callback callback;
+	Combiner combiner;
+	// The last pane of the next window to close, and the pane add puts the
+	// values without time in.
+	std::int64_t nextClosePane;
+	bool started;
+	std::uint64_t lateEventCount;
+};
+
+
+} //namespace eventpp
+
+#endif
@@ -5,6 +5,10 @@
  * OPT-15: Zero-overhead visitor dispatch benchmark.
  * Compares the full dispatch chain (process: map + CallbackList + std::function)
  * against direct visitor dispatch (processQueueWith: visitor(event, args...)).
+ * OPT-65: And the per-event listeners against a batch listener, on runs of
+ * the same event ID.
+ * OPT-67: And process()/processQueueWith() on nodes scattered in memory,
+ * with the prefetch distance 0 (off), 4 and 8.
  *
  * Build:
  *   cd tests/build && cmake .. -DCMAKE_BUILD_TYPE=Release
@@ -22,6 +26,7 @@
 #include <cstdint>
 #include <cstdio>
 #include <numeric>
+#include <type_traits>
 #include <vector>
 
 using namespace std::chrono;
@@ -35,6 +40,8 @@ constexpr uint32_t WARMUP_ROUNDS = 3U;
 constexpr uint32_t TEST_ROUNDS = 10U;
 constexpr uint32_t QUEUE_SIZE = 100000U;
 constexpr uint32_t EVENT_COUNT = 10U;
+// OPT-65: The count of the consecutive messages of the same event ID.
+constexpr uint32_t RUN_LENGTH = 64U;
 }  // namespace config
 
 // ============================================================================
@@ -150,6 +157,161 @@ static double bench_process_queue_with(uint32_t queue_size,
       / static_cast<double>(queue_size);
 }
 
+// ============================================================================
+// Benchmark: process() with runs of the same event ID (OPT-65)
+// ============================================================================
+
+static double bench_process_runs(uint32_t queue_size, uint32_t event_count) {
+  using EQ = eventpp::EventQueue<uint32_t, void(const TestMessage&)>;
+  EQ queue;
+
+  volatile uint64_t sink = 0;
+
+  for (uint32_t e = 0; e < event_count; ++e) {
+    queue.appendListener(e, [&sink](const TestMessage& msg) {
+      sink += msg.id;
+    });
+  }
+
+  // Enqueue
+  for (uint32_t i = 0; i < queue_size; ++i) {
+    TestMessage msg{};
+    msg.id = i;
+    queue.enqueue((i / config::RUN_LENGTH) % event_count, msg);
+  }
+
+  // Measure dispatch
+  auto t0 = steady_clock::now();
+  queue.process();
+  auto t1 = steady_clock::now();
+
+  return duration_cast<nanoseconds>(t1 - t0).count()
+      / static_cast<double>(queue_size);
+}
+
+// ============================================================================
+// Benchmark: process() with a batch listener -- one call per run (OPT-65)
+// ============================================================================
+
+static double bench_process_batch(uint32_t queue_size, uint32_t event_count) {
+  using EQ = eventpp::EventQueue<uint32_t, void(const TestMessage&)>;
+  EQ queue;
+
+  volatile uint64_t sink = 0;
+
+  for (uint32_t e = 0; e < event_count; ++e) {
+    queue.appendBatchListener(
+        e, [&sink](const eventpp::BatchSpan<TestMessage>& messages) {
+          uint64_t sum = 0;
+          for (const TestMessage& msg : messages) {
+            sum += msg.id;
+          }
+          sink += sum;
+        });
+  }
+
+  // Enqueue
+  for (uint32_t i = 0; i < queue_size; ++i) {
+    TestMessage msg{};
+    msg.id = i;
+    queue.enqueue((i / config::RUN_LENGTH) % event_count, msg);
+  }
+
+  // Measure dispatch
+  auto t0 = steady_clock::now();
+  queue.process();
+  auto t1 = steady_clock::now();
+
+  return duration_cast<nanoseconds>(t1 - t0).count()
+      / static_cast<double>(queue_size);
+}
+
+// ============================================================================
+// Benchmark: nodes scattered in memory, QueuePrefetchDistance (OPT-67)
+// ============================================================================
+
+template <std::size_t distance>
+struct PrefetchPolicies {
+  using QueuePrefetchDistance = std::integral_constant<std::size_t, distance>;
+};
+
+// Takes about half of the events at random and enqueues them again, a few
+// times, so the order of the queue doesn't follow the order of the nodes
+// in memory, as in a queue which has been running for a while.
+template <typename EQ>
+static void enqueue_scattered(EQ& queue, uint32_t queue_size,
+                              uint32_t event_count) {
+  for (uint32_t i = 0; i < queue_size; ++i) {
+    TestMessage msg{};
+    msg.id = i;
+    queue.enqueue(i % event_count, msg);
+  }
+
+  uint32_t state = 2463534242U;
+  for (int round = 0; round < 4; ++round) {
+    uint32_t taken = 0;
+    queue.processIf([&state, &taken]() {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      const bool take = (state & 1U) != 0;
+      taken += take ? 1U : 0U;
+      return take;
+    });
+    for (uint32_t i = 0; i < taken; ++i) {
+      TestMessage msg{};
+      msg.id = i;
+      queue.enqueue(i % event_count, msg);
+    }
+  }
+}
+
+template <std::size_t distance>
+static double bench_process_scattered(uint32_t queue_size,
+                                      uint32_t event_count) {
+  using EQ = eventpp::EventQueue<uint32_t, void(const TestMessage&),
+                                 PrefetchPolicies<distance>>;
+  EQ queue;
+
+  volatile uint64_t sink = 0;
+
+  for (uint32_t e = 0; e < event_count; ++e) {
+    queue.appendListener(e, [&sink](const TestMessage& msg) {
+      sink += msg.id;
+    });
+  }
+
+  enqueue_scattered(queue, queue_size, event_count);
+
+  auto t0 = steady_clock::now();
+  queue.process();
+  auto t1 = steady_clock::now();
+
+  return duration_cast<nanoseconds>(t1 - t0).count()
+      / static_cast<double>(queue_size);
+}
+
+template <std::size_t distance>
+static double bench_visit_scattered(uint32_t queue_size,
+                                    uint32_t event_count) {
+  using EQ = eventpp::EventQueue<uint32_t, void(const TestMessage&),
+                                 PrefetchPolicies<distance>>;
+  EQ queue;
+
+  volatile uint64_t sink = 0;
+
+  enqueue_scattered(queue, queue_size, event_count);
+
+  auto t0 = steady_clock::now();
+  queue.processQueueWith([&sink](uint32_t /*event*/, const TestMessage& msg) {
+    sink += msg.id;
+  });
+  auto t1 = steady_clock::now();
+
+  return duration_cast<nanoseconds>(t1 - t0).count()
+      / static_cast<double>(queue_size);
+}
+
 // ============================================================================
 // Run Benchmark Suite
 // ============================================================================
@@ -203,12 +365,38 @@ int main() {
                 bench_process_queue_with, config::QUEUE_SIZE,
                 config::EVENT_COUNT);
 
+  std::printf("\n--- %u event IDs, runs of %u messages ---\n",
+              config::EVENT_COUNT, config::RUN_LENGTH);
+  run_benchmark("process() [runs]",
+                bench_process_runs, config::QUEUE_SIZE, config::EVENT_COUNT);
+  run_benchmark("process() batch listener [runs]",
+                bench_process_batch, config::QUEUE_SIZE,
+                config::EVENT_COUNT);
+
   std::printf("\n--- Large queue (1M messages) ---\n");
   run_benchmark("process() [1M, 10 events]",
                 bench_process, 1000000U, config::EVENT_COUNT);
   run_benchmark("processQueueWith() [1M, 10 events]",
                 bench_process_queue_with, 1000000U, config::EVENT_COUNT);
 
+  const uint32_t scattered_size_list[] = { 1000U, 10000U, 100000U, 1000000U };
+  for (const uint32_t queue_size : scattered_size_list) {
+    std::printf("\n--- Scattered nodes, %u messages, prefetch distance ---\n",
+                queue_size);
+    run_benchmark("process() [distance 0]",
+                  bench_process_scattered<0>, queue_size, config::EVENT_COUNT);
+    run_benchmark("process() [distance 4]",
+                  bench_process_scattered<4>, queue_size, config::EVENT_COUNT);
+    run_benchmark("process() [distance 8]",
+                  bench_process_scattered<8>, queue_size, config::EVENT_COUNT);
+    run_benchmark("processQueueWith() [distance 0]",
+                  bench_visit_scattered<0>, queue_size, config::EVENT_COUNT);
+    run_benchmark("processQueueWith() [distance 4]",
+                  bench_visit_scattered<4>, queue_size, config::EVENT_COUNT);
+    run_benchmark("processQueueWith() [distance 8]",
+                  bench_visit_scattered<8>, queue_size, config::EVENT_COUNT);
+  }
+
   std::printf("\n================================================================\n");
   std::printf("Done.\n");
 
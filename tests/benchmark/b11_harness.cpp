@@ -0,0 +1,342 @@
+/**
+ * @file b11_harness.cpp
+ * @brief Unified EventQueue benchmark suite with latency percentiles and JSON output
+ *
+ * Runs the scenarios of b3_b5, b9 and b10 on bench_harness.hpp:
+ * - enqueue:  per-call enqueue latency, one thread (b3, b9)
+ * - process:  per-event process() cost, in batches of 256 events (b3, b10)
+ * - visit:    per-event processQueueWith() cost, in batches of 256 events (b10)
+ * - dispatch: per-call EventDispatcher::dispatch latency, 10 event IDs
+ * - enqueue_mt / e2e: 1~4 producers and 1~2 consumers, the producer-side
+ *   enqueue latency at full speed, and the enqueue-to-listener latency at
+ *   a fixed offered load of 2M messages per second (b4, b5, b9)
+ * Payload sizes 8, 64 and 256 bytes; EventQueue with DefaultPolicies and
+ * HighPerfPolicy, and RingEventQueue where it applies.
+ *
+ * Each case runs warmup rounds and is repeated until its throughput is
+ * stable, see bench_harness.hpp. The throughput of the one-thread cases is
+ * operations / the time spent in the measured calls; of the multi-thread
+ * cases it's messages / wall time until the consumers have processed all.
+ *
+ * Build:
+ *   cd tests/build && cmake .. -DCMAKE_BUILD_TYPE=Release
+ *   cmake --build . --target b11_harness
+ *   ./benchmark/b11_harness --json current.json
+ *   ./benchmark/b11_harness --json current.json --compare baseline.json
+ */
+
+#include "bench_harness.hpp"
+#include "bench_utils.hpp"
+
+#include <eventpp/eventdispatcher.h>
+#include <eventpp/eventqueue.h>
+#include <eventpp/ringeventqueue.h>
+#include <eventpp/internal/poolallocator_i.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using bench::Clock;
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+namespace config {
+constexpr uint32_t CHUNK = 4096U;
+constexpr uint32_t BATCH = 256U;
+constexpr uint32_t EVENT_COUNT = 10U;
+constexpr uint32_t OPERATIONS = 64U * CHUNK;
+constexpr uint32_t QUICK_OPERATIONS = 8U * CHUNK;
+// e2e offers one message every 500 ns in total, 2M messages per second.
+constexpr uint32_t E2E_INTERVAL_NS = 500U;
+}  // namespace config
+
+// ============================================================================
+// Payload and Queues
+// ============================================================================
+
+// The first word carries the enqueue time for the e2e cases.
+template <uint32_t bytes>
+struct Payload {
+  static_assert(bytes >= 8 && bytes % 8 == 0, "Payload size must be a multiple of 8");
+  uint64_t words[bytes / 8];
+};
+
+struct RingQueuePolicies {
+  using RingCapacity = std::integral_constant<std::size_t, 65536>;
+};
+
+template <typename P>
+using DefaultQueue = eventpp::EventQueue<int, void(const P&)>;
+template <typename P>
+using HighPerfQueue = eventpp::EventQueue<int, void(const P&), eventpp::HighPerfPolicy>;
+template <typename P>
+using RingQueue = eventpp::RingEventQueue<int, void(const P&), RingQueuePolicies>;
+
+// RingEventQueue returns false when it's full, the producers retry.
+template <typename Q, typename P>
+static auto enqueue_until_accepted(Q& queue, const P& payload) -> decltype(queue.enqueue(1, payload), void()) {
+  enqueue_until_accepted(queue, payload, std::is_same<decltype(queue.enqueue(1, payload)), bool>());
+}
+
+template <typename Q, typename P>
+static void enqueue_until_accepted(Q& queue, const P& payload, std::false_type) {
+  queue.enqueue(1, payload);
+}
+
+template <typename Q, typename P>
+static void enqueue_until_accepted(Q& queue, const P& payload, std::true_type) {
+  while (!queue.enqueue(1, payload)) {
+    std::this_thread::yield();
+  }
+}
+
+static uint64_t now_ticks() {
+  return static_cast<uint64_t>(Clock::now().time_since_epoch().count());
+}
+
+// ============================================================================
+// One-thread rounds
+// ============================================================================
+
+template <template <typename> class Queue, typename P>
+static bench::RoundResult round_enqueue(uint32_t operations) {
+  Queue<P> queue;
+  queue.appendListener(1, [](const P&) {});
+
+  bench::RoundResult round;
+  round.samples.reserve(operations);
+  const P payload{};
+  for (uint32_t done = 0; done < operations; done += config::CHUNK) {
+    for (uint32_t i = 0; i < config::CHUNK; ++i) {
+      const auto t0 = Clock::now();
+      queue.enqueue(1, payload);
+      const auto t1 = Clock::now();
+      round.samples.add_timed(t0, t1);
+      round.elapsed_ns += bench::elapsed_ns(t0, t1);
+    }
+    queue.process();
+  }
+  round.operations = operations;
+  return round;
+}
+
+template <template <typename> class Queue, typename P, bool visit>
+static bench::RoundResult round_process(uint32_t operations) {
+  Queue<P> queue;
+  volatile uint64_t sink = 0;
+  for (uint32_t e = 0; e < config::EVENT_COUNT; ++e) {
+    queue.appendListener(static_cast<int>(e), [&sink](const P& payload) { sink = sink + payload.words[0]; });
+  }
+
+  bench::RoundResult round;
+  round.samples.reserve(operations / config::BATCH);
+  P payload{};
+  for (uint32_t done = 0; done < operations; done += config::BATCH) {
+    for (uint32_t i = 0; i < config::BATCH; ++i) {
+      payload.words[0] = i;
+      queue.enqueue(static_cast<int>(i % config::EVENT_COUNT), payload);
+    }
+
+    const auto t0 = Clock::now();
+    if (visit) {
+      queue.processQueueWith([&sink](int, const P& item) { sink = sink + item.words[0]; });
+    } else {
+      queue.process();
+    }
+    const auto t1 = Clock::now();
+    round.samples.add(bench::elapsed_ns(t0, t1) / config::BATCH);
+    round.elapsed_ns += bench::elapsed_ns(t0, t1);
+  }
+  round.operations = operations;
+  return round;
+}
+
+template <typename P>
+static bench::RoundResult round_dispatch(uint32_t operations) {
+  eventpp::EventDispatcher<int, void(const P&)> dispatcher;
+  volatile uint64_t sink = 0;
+  for (uint32_t e = 0; e < config::EVENT_COUNT; ++e) {
+    dispatcher.appendListener(static_cast<int>(e), [&sink](const P& payload) { sink = sink + payload.words[0]; });
+  }
+
+  bench::RoundResult round;
+  round.samples.reserve(operations);
+  const P payload{};
+  for (uint32_t i = 0; i < operations; ++i) {
+    const auto t0 = Clock::now();
+    dispatcher.dispatch(static_cast<int>(i % config::EVENT_COUNT), payload);
+    const auto t1 = Clock::now();
+    round.samples.add_timed(t0, t1);
+    round.elapsed_ns += bench::elapsed_ns(t0, t1);
+  }
+  round.operations = operations;
+  return round;
+}
+
+// ============================================================================
+// Multi-thread rounds
+// ============================================================================
+
+// The samples of the consumer thread which runs the listener.
+static thread_local bench::LatencySamples* consumer_samples = nullptr;
+
+// e2e is false: the enqueue latency of the producers, true: the latency
+// from enqueue to the listener.
+template <template <typename> class Queue, typename P, bool e2e>
+static bench::RoundResult round_multi_thread(uint32_t producer_count, uint32_t consumer_count, uint32_t operations) {
+  Queue<P> queue;
+  const uint32_t per_producer = operations / producer_count;
+  const uint64_t total = static_cast<uint64_t>(per_producer) * producer_count;
+  const uint32_t core_count = std::max(1U, std::thread::hardware_concurrency());
+  std::atomic<uint64_t> processed{0};
+  std::atomic<bool> go{false};
+
+  queue.appendListener(1, [&processed](const P& payload) {
+    if (e2e) {
+      consumer_samples->add(std::max(0.0, static_cast<double>(now_ticks() - payload.words[0])));
+    }
+    processed.fetch_add(1, std::memory_order_relaxed);
+  });
+
+  std::vector<bench::LatencySamples> samples(producer_count + consumer_count);
+  std::vector<std::thread> threads;
+  for (uint32_t c = 0U; c < consumer_count; ++c) {
+    threads.emplace_back([&, c]() {
+      bench::pin_thread_to_core(c % core_count);
+      consumer_samples = &samples[producer_count + c];
+      consumer_samples->reserve(e2e ? total / consumer_count : 0);
+      while (processed.load(std::memory_order_relaxed) < total) {
+        // Polls, waitFor doesn't work with the SpinLock of HighPerfPolicy.
+        if (!queue.process()) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (uint32_t p = 0U; p < producer_count; ++p) {
+    threads.emplace_back([&, p]() {
+      bench::pin_thread_to_core((consumer_count + p) % core_count);
+      bench::LatencySamples& enqueue_samples = samples[p];
+      enqueue_samples.reserve(e2e ? 0 : per_producer);
+      P payload{};
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      // For e2e the producers share a fixed offered load below what one
+      // consumer can take, otherwise the latency is only the backlog.
+      const auto interval = std::chrono::nanoseconds(config::E2E_INTERVAL_NS * producer_count);
+      auto next_send = Clock::now();
+      for (uint32_t i = 0; i < per_producer; ++i) {
+        if (e2e) {
+          next_send += interval;
+          while (Clock::now() < next_send) {
+            std::this_thread::yield();
+          }
+        }
+        const auto t0 = Clock::now();
+        payload.words[0] = static_cast<uint64_t>(t0.time_since_epoch().count());
+        enqueue_until_accepted(queue, payload);
+        if (!e2e) {
+          enqueue_samples.add_timed(t0, Clock::now());
+        }
+      }
+    });
+  }
+
+  const auto start = Clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const auto end = Clock::now();
+
+  bench::RoundResult round;
+  for (const auto& item : samples) {
+    round.samples.append(item);
+  }
+  round.operations = total;
+  round.elapsed_ns = bench::elapsed_ns(start, end);
+  return round;
+}
+
+// ============================================================================
+// Cases
+// ============================================================================
+
+static std::string case_name(const char* operation, const char* queue, uint32_t producers, uint32_t consumers,
+                             uint32_t bytes) {
+  return std::string(operation) + "/" + queue + "/p" + std::to_string(producers) + "c" + std::to_string(consumers) +
+         "/" + std::to_string(bytes) + "B";
+}
+
+template <template <typename> class Queue, uint32_t bytes>
+static void run_one_thread(bench::Harness& harness, const char* queue, uint32_t operations) {
+  using P = Payload<bytes>;
+  harness.run(bench::Case{case_name("enqueue", queue, 1, 0, bytes), "enqueue", queue, 1, 0, bytes},
+              [operations] { return round_enqueue<Queue, P>(operations); });
+  harness.run(bench::Case{case_name("process", queue, 0, 1, bytes), "process", queue, 0, 1, bytes},
+              [operations] { return round_process<Queue, P, false>(operations); });
+  harness.run(bench::Case{case_name("visit", queue, 0, 1, bytes), "visit", queue, 0, 1, bytes},
+              [operations] { return round_process<Queue, P, true>(operations); });
+}
+
+template <template <typename> class Queue, uint32_t bytes>
+static void run_multi_thread(bench::Harness& harness, const char* queue, uint32_t producers, uint32_t consumers,
+                             uint32_t operations) {
+  using P = Payload<bytes>;
+  harness.run(bench::Case{case_name("enqueue_mt", queue, producers, consumers, bytes), "enqueue", queue, producers,
+                          consumers, bytes},
+              [=] { return round_multi_thread<Queue, P, false>(producers, consumers, operations); });
+  harness.run(
+      bench::Case{case_name("e2e", queue, producers, consumers, bytes), "e2e", queue, producers, consumers, bytes},
+      [=] { return round_multi_thread<Queue, P, true>(producers, consumers, operations); });
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main(int argc, char** argv) {
+  bench::Harness harness(bench::parse_options(argc, argv));
+  const uint32_t operations = harness.options().quick ? config::QUICK_OPERATIONS : config::OPERATIONS;
+
+  std::printf("================================================================\n");
+  std::printf("eventpp benchmark harness: %u operations per round, %u-%u rounds\n", operations,
+              harness.options().min_rounds, harness.options().max_rounds);
+  std::printf("================================================================\n");
+
+  std::printf("\n--- One thread ---\n");
+  {
+    bench::pin_thread_to_core(0);
+    run_one_thread<DefaultQueue, 8>(harness, "EventQueue", operations);
+    run_one_thread<DefaultQueue, 64>(harness, "EventQueue", operations);
+    run_one_thread<DefaultQueue, 256>(harness, "EventQueue", operations);
+    run_one_thread<HighPerfQueue, 64>(harness, "HighPerf", operations);
+    run_one_thread<RingQueue, 64>(harness, "Ring", operations);
+
+    harness.run(bench::Case{case_name("dispatch", "EventDispatcher", 1, 0, 8), "dispatch", "EventDispatcher", 1, 0, 8},
+                [operations] { return round_dispatch<Payload<8>>(operations); });
+    harness.run(
+        bench::Case{case_name("dispatch", "EventDispatcher", 1, 0, 64), "dispatch", "EventDispatcher", 1, 0, 64},
+        [operations] { return round_dispatch<Payload<64>>(operations); });
+  }
+
+  std::printf("\n--- Producers x consumers ---\n");
+  for (const uint32_t producers : {1U, 2U, 4U}) {
+    for (const uint32_t consumers : {1U, 2U}) {
+      run_multi_thread<DefaultQueue, 64>(harness, "EventQueue", producers, consumers, operations);
+      run_multi_thread<HighPerfQueue, 64>(harness, "HighPerf", producers, consumers, operations);
+    }
+    run_multi_thread<RingQueue, 64>(harness, "Ring", producers, 1, operations);
+  }
+
+  return harness.finish();
+}
@@ -0,0 +1,234 @@
+/**
+ * @file b12_shared_mutex_benchmark.cpp
+ * @brief Read scaling of the listener SharedMutex, 1 to 64 threads
+ *
+ * Validates OPT-38: ShardedSharedMutex (distributed reader-writer lock)
+ * against std::shared_timed_mutex, the SharedMutex of MultipleThreading.
+ *
+ * Scenarios, each thread count runs for both locks:
+ * - lock_shared: every thread locks and unlocks shared in a loop
+ * - dispatch:    every thread calls EventDispatcher::dispatch on events
+ *                which have one listener, the dispatcher uses the lock as
+ *                Threading::SharedMutex
+ * - subscribe:   OPT-63, every thread calls appendListener, dispatch and
+ *                removeListener on its own events, EventDispatcher against
+ *                ShardedEventDispatcher with 16 shards; every append and
+ *                remove locks the listener mutex exclusively
+ * - replicated:  OPT-73, the dispatch scenario, EventDispatcher with
+ *                ShardedSharedMutex against ReplicatedEventDispatcher, where
+ *                each thread dispatches on its own copy of the listeners
+ *
+ * Throughput = total operations / wall time of the slowest thread.
+ * Scaling = throughput / throughput of 1 thread with the same lock. With
+ * std::shared_timed_mutex every reader writes the same reader count, so the
+ * cache line bounces between the cores and the scaling stays flat. Thread
+ * counts above the core count are oversubscribed and don't scale.
+ *
+ * Statistical method:
+ * - Warmup rounds are discarded
+ * - Reports the median of the rounds
+ *
+ * Build:
+ *   cd tests/build && cmake .. -DCMAKE_BUILD_TYPE=Release
+ *   cmake --build . --target b12_shared_mutex_benchmark
+ *   ./benchmark/b12_shared_mutex_benchmark
+ */
+
+#include "bench_utils.hpp"
+
+#include <eventpp/eventdispatcher.h>
+#include <eventpp/replicatedeventdispatcher.h>
+#include <eventpp/shardedeventdispatcher.h>
+#include <eventpp/utilities/shardedsharedmutex.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+namespace config {
+constexpr uint32_t WARMUP_ROUNDS = 1U;
+constexpr uint32_t TEST_ROUNDS = 5U;
+constexpr uint32_t OPS_PER_THREAD = 200000U;
+constexpr int EVENT_COUNT = 64;
+const uint32_t THREAD_COUNTS[] = {1U, 2U, 4U, 8U, 16U, 32U, 64U};
+}  // namespace config
+
+// ============================================================================
+// Locks and dispatchers
+// ============================================================================
+
+using ShardedMutex = eventpp::ShardedSharedMutex<64>;
+
+template <typename SharedMutex>
+struct LockPolicies {
+  using Threading =
+      eventpp::GeneralThreading<std::mutex, std::atomic, std::condition_variable, SharedMutex>;
+};
+
+template <typename SharedMutex>
+using Dispatcher = eventpp::EventDispatcher<int, void(int), LockPolicies<SharedMutex>>;
+
+using ShardedDispatcher = eventpp::ShardedEventDispatcher<int, void(int), eventpp::DefaultPolicies, 16>;
+
+using ReplicatedDispatcher = eventpp::ReplicatedEventDispatcher<int, void(int)>;
+
+// ============================================================================
+// Runner
+// ============================================================================
+
+// Starts thread_count threads together and returns the operations per
+// second, each thread runs body(thread_index).
+template <typename Body>
+double run_threads(const uint32_t thread_count, Body body) {
+  const uint32_t cores = std::max(1U, std::thread::hardware_concurrency());
+  std::atomic<uint32_t> ready_count(0);
+  std::atomic<bool> go(false);
+  std::vector<std::thread> threads;
+
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    threads.emplace_back([i, cores, &ready_count, &go, &body]() {
+      bench::pin_thread_to_core(i % cores);
+      ready_count.fetch_add(1, std::memory_order_acq_rel);
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      body(i);
+    });
+  }
+  while (ready_count.load(std::memory_order_acquire) < thread_count) {
+    std::this_thread::yield();
+  }
+
+  const auto start = steady_clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const double seconds = duration<double>(steady_clock::now() - start).count();
+
+  return static_cast<double>(thread_count) * config::OPS_PER_THREAD / seconds;
+}
+
+template <typename Round>
+double median_of_rounds(Round round) {
+  std::vector<double> results;
+  for (uint32_t r = 0; r < config::WARMUP_ROUNDS + config::TEST_ROUNDS; ++r) {
+    const double result = round();
+    if (r >= config::WARMUP_ROUNDS) {
+      results.push_back(result);
+    }
+  }
+  std::sort(results.begin(), results.end());
+  return results[results.size() / 2];
+}
+
+template <typename SharedMutex>
+double bench_lock_shared(const uint32_t thread_count) {
+  SharedMutex mutex;
+  return median_of_rounds([&]() {
+    return run_threads(thread_count, [&mutex](uint32_t) {
+      for (uint32_t k = 0; k < config::OPS_PER_THREAD; ++k) {
+        std::shared_lock<SharedMutex> lock(mutex);
+      }
+    });
+  });
+}
+
+template <typename ED>
+double bench_dispatch_with(const uint32_t thread_count) {
+  ED dispatcher;
+  for (int e = 0; e < config::EVENT_COUNT; ++e) {
+    dispatcher.appendListener(e, [](int) {});
+  }
+  return median_of_rounds([&]() {
+    return run_threads(thread_count, [&dispatcher](uint32_t index) {
+      int e = static_cast<int>(index) % config::EVENT_COUNT;
+      for (uint32_t k = 0; k < config::OPS_PER_THREAD; ++k) {
+        dispatcher.dispatch(e);
+        e = (e + 1) % config::EVENT_COUNT;
+      }
+    });
+  });
+}
+
+template <typename SharedMutex>
+double bench_dispatch(const uint32_t thread_count) {
+  return bench_dispatch_with<Dispatcher<SharedMutex>>(thread_count);
+}
+
+// Each thread subscribes to its own events, and dispatches them.
+template <typename ED>
+double bench_subscribe(const uint32_t thread_count) {
+  ED dispatcher;
+  return median_of_rounds([&]() {
+    return run_threads(thread_count, [&dispatcher](uint32_t index) {
+      const int first = static_cast<int>(index) * config::EVENT_COUNT;
+      for (uint32_t k = 0; k < config::OPS_PER_THREAD; ++k) {
+        const int e = first + static_cast<int>(k % config::EVENT_COUNT);
+        auto handle = dispatcher.appendListener(e, [](int) {});
+        dispatcher.dispatch(e);
+        dispatcher.removeListener(e, handle);
+      }
+    });
+  });
+}
+
+// ============================================================================
+// Report
+// ============================================================================
+
+template <typename Bench>
+void report(const char* scenario, Bench std_bench, Bench sharded_bench,
+            const char* std_name = "shared_timed_mutex", const char* sharded_name = "ShardedSharedMutex") {
+  std::printf("\n--- %s ---\n", scenario);
+  std::printf("%8s | %22s | %22s\n", "threads", std_name, sharded_name);
+  std::printf("%8s | %12s %9s | %12s %9s\n", "", "Mops/s", "scaling", "Mops/s", "scaling");
+
+  double std_base = 0.0;
+  double sharded_base = 0.0;
+  for (const uint32_t thread_count : config::THREAD_COUNTS) {
+    const double std_ops = std_bench(thread_count);
+    const double sharded_ops = sharded_bench(thread_count);
+    if (thread_count == 1U) {
+      std_base = std_ops;
+      sharded_base = sharded_ops;
+    }
+    std::printf("%8u | %12.2f %8.2fx | %12.2f %8.2fx\n", thread_count, std_ops / 1e6,
+                std_ops / std_base, sharded_ops / 1e6, sharded_ops / sharded_base);
+  }
+}
+
+int main() {
+  std::printf("========================================\n");
+  std::printf("  SharedMutex Read Scaling (OPT-38)\n");
+  std::printf("========================================\n");
+  std::printf("Hardware threads: %u, operations per thread: %u\n",
+              std::thread::hardware_concurrency(), config::OPS_PER_THREAD);
+
+  report<double (*)(uint32_t)>("lock_shared + unlock_shared", &bench_lock_shared<std::shared_timed_mutex>,
+                               &bench_lock_shared<ShardedMutex>);
+  report<double (*)(uint32_t)>("EventDispatcher::dispatch", &bench_dispatch<std::shared_timed_mutex>,
+                               &bench_dispatch<ShardedMutex>);
+  report<double (*)(uint32_t)>("appendListener + dispatch + removeListener",
+                               &bench_subscribe<Dispatcher<std::shared_timed_mutex>>,
+                               &bench_subscribe<ShardedDispatcher>, "EventDispatcher",
+                               "ShardedEventDispatcher");
+  report<double (*)(uint32_t)>("EventDispatcher::dispatch, replicated listeners",
+                               &bench_dispatch_with<Dispatcher<ShardedMutex>>,
+                               &bench_dispatch_with<ReplicatedDispatcher>, "ShardedSharedMutex",
+                               "ReplicatedEventDispatcher");
+
+  return 0;
+}
@@ -0,0 +1,255 @@
+/**
+ * @file b13_heter_queue_benchmark.cpp
+ * @brief HeterEventQueue vs EventQueue, process() and processQueueWith()
+ *
+ * OPT-4, OPT-8, OPT-10, OPT-15 for HeterEventQueue.
+ * Measures the enqueue and the dispatch of a heterogeneous queue with two
+ * prototypes against a homogeneous queue with the same event rate, through
+ * the full dispatch chain (process) and the visitor (processQueueWith).
+ *
+ * Build:
+ *   cd tests/build && cmake .. -DCMAKE_BUILD_TYPE=Release
+ *   cmake --build . --target b13_heter_queue_benchmark
+ *   ./benchmark/b13_heter_queue_benchmark
+ */
+
+#include "bench_utils.hpp"
+
+#include <eventpp/eventqueue.h>
+#include <eventpp/hetereventqueue.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <vector>
+
+using namespace std::chrono;
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+namespace config {
+constexpr uint32_t WARMUP_ROUNDS = 3U;
+constexpr uint32_t TEST_ROUNDS = 10U;
+constexpr uint32_t QUEUE_SIZE = 100000U;
+constexpr uint32_t EVENT_COUNT = 10U;
+}  // namespace config
+
+// ============================================================================
+// Statistical Functions
+// ============================================================================
+
+struct Statistics {
+  double mean;
+  double std_dev;
+  double min_val;
+  double max_val;
+  double p50;
+  double p95;
+};
+
+static Statistics calculate_statistics(const std::vector<double>& data) {
+  Statistics stats{};
+
+  if (data.empty()) {
+    return stats;
+  }
+
+  double sum = std::accumulate(data.begin(), data.end(), 0.0);
+  stats.mean = sum / static_cast<double>(data.size());
+
+  double sq_sum = 0.0;
+  for (const auto& val : data) {
+    sq_sum += (val - stats.mean) * (val - stats.mean);
+  }
+  stats.std_dev = std::sqrt(sq_sum / static_cast<double>(data.size()));
+
+  auto minmax = std::minmax_element(data.begin(), data.end());
+  stats.min_val = *minmax.first;
+  stats.max_val = *minmax.second;
+
+  std::vector<double> sorted_data = data;
+  std::sort(sorted_data.begin(), sorted_data.end());
+
+  size_t n = sorted_data.size();
+  stats.p50 = sorted_data[n * 50 / 100];
+  stats.p95 = sorted_data[std::min(n * 95 / 100, n - 1)];
+
+  return stats;
+}
+
+// ============================================================================
+// Test Messages
+// ============================================================================
+
+struct TestMessage {
+  uint64_t id;
+  float data[4];
+};
+
+struct Timing {
+  double enqueue_ns;
+  double dispatch_ns;
+};
+
+using HomoQueue = eventpp::EventQueue<uint32_t, void(const TestMessage&)>;
+using HeterQueue = eventpp::HeterEventQueue<
+    uint32_t, eventpp::HeterTuple<void(const TestMessage&), void(uint64_t)> >;
+
+// The heterogeneous queue gets the same count of events, half of them with
+// each prototype.
+static void enqueue_homo(HomoQueue& queue, uint32_t i, uint32_t event_count) {
+  TestMessage msg{};
+  msg.id = i;
+  queue.enqueue(i % event_count, msg);
+}
+
+static void enqueue_heter(HeterQueue& queue, uint32_t i,
+                          uint32_t event_count) {
+  if (i & 1U) {
+    queue.enqueue(i % event_count, static_cast<uint64_t>(i));
+  } else {
+    TestMessage msg{};
+    msg.id = i;
+    queue.enqueue(i % event_count, msg);
+  }
+}
+
+template <typename Queue, typename Enqueue, typename Process>
+static double bench_queue(Queue& queue, Enqueue enqueue, Process process,
+                          uint32_t queue_size, uint32_t event_count,
+                          bool measure_enqueue) {
+  auto t0 = steady_clock::now();
+  for (uint32_t i = 0; i < queue_size; ++i) {
+    enqueue(queue, i, event_count);
+  }
+  auto t1 = steady_clock::now();
+  process(queue);
+  auto t2 = steady_clock::now();
+
+  const auto elapsed = measure_enqueue ? (t1 - t0) : (t2 - t1);
+  return duration_cast<nanoseconds>(elapsed).count()
+      / static_cast<double>(queue_size);
+}
+
+// ============================================================================
+// Benchmarks
+// ============================================================================
+
+static volatile uint64_t sink = 0;
+
+struct SinkVisitor {
+  void operator()(uint32_t /*event*/, const TestMessage& msg) const {
+    sink += msg.id;
+  }
+
+  void operator()(uint32_t /*event*/, uint64_t id) const {
+    sink += id;
+  }
+};
+
+static double run_homo(uint32_t queue_size, uint32_t event_count,
+                       bool visitor, bool measure_enqueue) {
+  HomoQueue queue;
+  for (uint32_t e = 0; e < event_count; ++e) {
+    queue.appendListener(e, [](const TestMessage& msg) { sink += msg.id; });
+  }
+  return bench_queue(queue, enqueue_homo, [visitor](HomoQueue& q) {
+    if (visitor) {
+      q.processQueueWith(SinkVisitor());
+    } else {
+      q.process();
+    }
+  }, queue_size, event_count, measure_enqueue);
+}
+
+static double run_heter(uint32_t queue_size, uint32_t event_count,
+                        bool visitor, bool measure_enqueue) {
+  HeterQueue queue;
+  for (uint32_t e = 0; e < event_count; ++e) {
+    queue.appendListener(e, [](const TestMessage& msg) { sink += msg.id; });
+    queue.appendListener(e, [](uint64_t id) { sink += id; });
+  }
+  return bench_queue(queue, enqueue_heter, [visitor](HeterQueue& q) {
+    if (visitor) {
+      q.processQueueWith(SinkVisitor());
+    } else {
+      q.process();
+    }
+  }, queue_size, event_count, measure_enqueue);
+}
+
+static double bench_homo_enqueue(uint32_t n, uint32_t e) { return run_homo(n, e, false, true); }
+static double bench_heter_enqueue(uint32_t n, uint32_t e) { return run_heter(n, e, false, true); }
+static double bench_homo_process(uint32_t n, uint32_t e) { return run_homo(n, e, false, false); }
+static double bench_heter_process(uint32_t n, uint32_t e) { return run_heter(n, e, false, false); }
+static double bench_homo_visitor(uint32_t n, uint32_t e) { return run_homo(n, e, true, false); }
+static double bench_heter_visitor(uint32_t n, uint32_t e) { return run_heter(n, e, true, false); }
+
+// ============================================================================
+// Run Benchmark Suite
+// ============================================================================
+
+static void run_benchmark(const char* label,
+                          double (*bench_fn)(uint32_t, uint32_t),
+                          uint32_t queue_size, uint32_t event_count) {
+  // Warmup
+  for (uint32_t i = 0; i < config::WARMUP_ROUNDS; ++i) {
+    bench_fn(queue_size, event_count);
+  }
+
+  // Test rounds
+  std::vector<double> results;
+  results.reserve(config::TEST_ROUNDS);
+  for (uint32_t i = 0; i < config::TEST_ROUNDS; ++i) {
+    results.push_back(bench_fn(queue_size, event_count));
+  }
+
+  Statistics stats = calculate_statistics(results);
+
+  std::printf("  %-35s  mean=%7.1f ns/msg  std=%5.1f  "
+              "min=%7.1f  max=%7.1f  P50=%7.1f  P95=%7.1f\n",
+              label, stats.mean, stats.std_dev,
+              stats.min_val, stats.max_val, stats.p50, stats.p95);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main() {
+  bench::pin_thread_to_core(1);
+
+  std::printf("================================================================\n");
+  std::printf("HeterEventQueue vs EventQueue Benchmark\n");
+  std::printf("================================================================\n");
+  std::printf("Queue size: %u messages, %u event IDs, Test rounds: %u\n\n",
+              config::QUEUE_SIZE, config::EVENT_COUNT, config::TEST_ROUNDS);
+
+  std::printf("--- enqueue ---\n");
+  run_benchmark("EventQueue::enqueue", bench_homo_enqueue,
+                config::QUEUE_SIZE, config::EVENT_COUNT);
+  run_benchmark("HeterEventQueue::enqueue", bench_heter_enqueue,
+                config::QUEUE_SIZE, config::EVENT_COUNT);
+
+  std::printf("\n--- process() ---\n");
+  run_benchmark("EventQueue::process", bench_homo_process,
+                config::QUEUE_SIZE, config::EVENT_COUNT);
+  run_benchmark("HeterEventQueue::process", bench_heter_process,
+                config::QUEUE_SIZE, config::EVENT_COUNT);
+
+  std::printf("\n--- processQueueWith() ---\n");
+  run_benchmark("EventQueue::processQueueWith", bench_homo_visitor,
+                config::QUEUE_SIZE, config::EVENT_COUNT);
+  run_benchmark("HeterEventQueue::processQueueWith", bench_heter_visitor,
+                config::QUEUE_SIZE, config::EVENT_COUNT);
+
+  std::printf("\n================================================================\n");
+  std::printf("Done.\n");
+
+  return 0;
+}
@@ -0,0 +1,193 @@
+/**
+ * @file b14_rt_mutex_benchmark.cpp
+ * @brief Lock hand-off latency under mixed thread priorities
+ *
+ * Validates OPT-59: PIMutex and FutexMutex against SpinLock and std::mutex.
+ *
+ * Three SCHED_FIFO threads, the classic priority inversion:
+ * - holder (priority 10): locks, works holdTime, unlocks, in a loop
+ * - middle (priority 20): busy for 1 ms, sleeps for 1 ms, never locks;
+ *                         it runs on the core of the holder and preempts it
+ * - waiter (priority 30): sleeps, then measures how long lock() takes
+ *
+ * Without priority inheritance, the waiter waits until the middle thread
+ * gives the core back to the holder, up to 1 ms. With PIMutex the holder
+ * runs at priority 30 while the waiter waits, so the latency stays near
+ * holdTime.
+ * SCHED_FIFO needs CAP_SYS_NICE (or root). Without it the threads run
+ * with the normal policy, there is no priority inversion to measure, and
+ * the numbers only compare the uncontended hand-off costs.
+ * SpinLock is skipped on a single core with SCHED_FIFO, the waiter would
+ * spin forever on the core which the holder needs.
+ *
+ * Build:
+ *   cd tests/build && cmake .. -DCMAKE_BUILD_TYPE=Release
+ *   cmake --build . --target b14_rt_mutex_benchmark
+ *   sudo ./benchmark/b14_rt_mutex_benchmark
+ */
+
+#include "bench_utils.hpp"
+
+#include <eventpp/eventpolicies.h>
+#include <eventpp/utilities/rtmutex.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+namespace config {
+constexpr uint32_t SAMPLE_COUNT = 500U;
+constexpr auto HOLD_TIME = microseconds(2);
+constexpr auto WAITER_SLEEP = microseconds(200);
+constexpr auto MIDDLE_BUSY = milliseconds(1);
+constexpr int HOLDER_PRIORITY = 10;
+constexpr int MIDDLE_PRIORITY = 20;
+constexpr int WAITER_PRIORITY = 30;
+}  // namespace config
+
+// ============================================================================
+// Helpers
+// ============================================================================
+
+bool set_fifo_priority(const int priority) {
+  sched_param param{};
+  param.sched_priority = priority;
+  return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+bool can_use_fifo() {
+  bool result = false;
+  std::thread([&result]() { result = set_fifo_priority(1); }).join();
+  return result;
+}
+
+void busy_for(const nanoseconds duration) {
+  const auto end = steady_clock::now() + duration;
+  while (steady_clock::now() < end) {
+  }
+}
+
+struct Result {
+  double avg_us;
+  double p50_us;
+  double p99_us;
+  double max_us;
+};
+
+// ============================================================================
+// Runner
+// ============================================================================
+
+template <typename Mutex>
+Result bench_hand_off(const bool fifo, const uint32_t waiter_core) {
+  Mutex mutex;
+  std::atomic<bool> stopped(false);
+  std::vector<double> samples;
+  samples.reserve(config::SAMPLE_COUNT);
+
+  std::thread holder([&]() {
+    bench::pin_thread_to_core(0);
+    if (fifo) {
+      set_fifo_priority(config::HOLDER_PRIORITY);
+    }
+    while (!stopped.load(std::memory_order_relaxed)) {
+      {
+        std::lock_guard<Mutex> lock(mutex);
+        busy_for(config::HOLD_TIME);
+      }
+      busy_for(config::HOLD_TIME);
+    }
+  });
+
+  std::thread middle([&]() {
+    bench::pin_thread_to_core(0);
+    if (fifo) {
+      set_fifo_priority(config::MIDDLE_PRIORITY);
+    }
+    while (!stopped.load(std::memory_order_relaxed)) {
+      busy_for(config::MIDDLE_BUSY);
+      std::this_thread::sleep_for(config::MIDDLE_BUSY);
+    }
+  });
+
+  std::thread waiter([&]() {
+    bench::pin_thread_to_core(waiter_core);
+    if (fifo) {
+      set_fifo_priority(config::WAITER_PRIORITY);
+    }
+    for (uint32_t i = 0; i < config::SAMPLE_COUNT; ++i) {
+      std::this_thread::sleep_for(config::WAITER_SLEEP);
+      const auto start = steady_clock::now();
+      mutex.lock();
+      const auto end = steady_clock::now();
+      mutex.unlock();
+      samples.push_back(duration<double, std::micro>(end - start).count());
+    }
+  });
+
+  waiter.join();
+  stopped.store(true);
+  holder.join();
+  middle.join();
+
+  std::sort(samples.begin(), samples.end());
+  double sum = 0.0;
+  for (const double sample : samples) {
+    sum += sample;
+  }
+  return Result{
+    sum / samples.size(),
+    samples[samples.size() / 2],
+    samples[samples.size() * 99 / 100],
+    samples.back()
+  };
+}
+
+void report(const char* name, const Result& result) {
+  std::printf("%-16s | %10.2f | %10.2f | %10.2f | %10.2f\n", name, result.avg_us, result.p50_us,
+              result.p99_us, result.max_us);
+}
+
+int main() {
+  const uint32_t cores = std::max(1U, std::thread::hardware_concurrency());
+  const bool fifo = can_use_fifo();
+  // The waiter runs on another core if there is one, so a spinning waiter
+  // doesn't take the core of the holder.
+  const uint32_t waiter_core = cores > 1 ? 1U : 0U;
+
+  std::printf("========================================\n");
+  std::printf("  Lock Hand-off Latency (OPT-59)\n");
+  std::printf("========================================\n");
+  std::printf("Hardware threads: %u, samples: %u, hold time: %lld us\n", cores, config::SAMPLE_COUNT,
+              static_cast<long long>(config::HOLD_TIME.count()));
+  std::printf("Scheduling: %s\n", fifo ? "SCHED_FIFO, holder 10 / middle 20 / waiter 30"
+                                       : "normal (no CAP_SYS_NICE), no priority inversion");
+
+  std::printf("\n%-16s | %10s | %10s | %10s | %10s\n", "mutex", "avg us", "p50 us", "p99 us", "max us");
+  if (fifo && cores < 2) {
+    std::printf("%-16s | skipped, spins forever on a single core with SCHED_FIFO\n", "SpinLock");
+  } else {
+    report("SpinLock", bench_hand_off<eventpp::SpinLock>(fifo, waiter_core));
+  }
+  report("std::mutex", bench_hand_off<std::mutex>(fifo, waiter_core));
+  report("FutexMutex", bench_hand_off<eventpp::FutexMutex<>>(fifo, waiter_core));
+#if defined(EVENTPP_HAS_PRIO_INHERIT)
+  report("PIMutex", bench_hand_off<eventpp::PIMutex>(fifo, waiter_core));
+#endif
+
+  return 0;
+}
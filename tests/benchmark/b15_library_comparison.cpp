@@ -0,0 +1,337 @@
+/**
+ * @file b15_library_comparison.cpp
+ * @brief eventpp against other event and signal libraries, same workloads
+ *
+ * Libraries, optional and found by CMake:
+ * - Boost.Signals2              EVENTPP_BENCH_HAS_BOOST_SIGNALS2
+ * eventpp always runs, with DefaultPolicies and HighPerfPolicy.
+ *
+ * Scenarios, for payloads of 8, 64, 256 and 1024 bytes:
+ * - invoke:   one signal with 1/10/100 listeners, called in a loop.
+ *             CallbackList, Boost.Signals2
+ * - dispatch: 16 events with 1/10/100 listeners each, dispatched in turn.
+ *             EventDispatcher, an unordered_map of Boost.Signals2
+ *             signals
+ * - queue:    1/2/4/8/16 producer threads enqueue, one consumer thread
+ *             dispatches to 1 listener. EventQueue
+ *
+ * ns/op is the wall time / operations, an operation is one call of the
+ * signal, one dispatch, or one event through the queue. It's the average
+ * cost, see b11_harness for the latency percentiles of eventpp.
+ *
+ * Statistical method:
+ * - Warmup rounds are discarded
+ * - Reports the median of the rounds
+ *
+ * Build:
+ *   cd tests/build && cmake .. -DCMAKE_BUILD_TYPE=Release
+ *   cmake --build . --target b15_library_comparison
+ *   ./benchmark/b15_library_comparison
+ */
+
+#include <eventpp/callbacklist.h>
+#include <eventpp/eventdispatcher.h>
+#include <eventpp/eventqueue.h>
+#include <eventpp/internal/poolallocator_i.h>
+
+#ifndef EVENTPP_BENCH_HAS_BOOST_SIGNALS2
+#define EVENTPP_BENCH_HAS_BOOST_SIGNALS2 0
+#endif
+
+#if EVENTPP_BENCH_HAS_BOOST_SIGNALS2
+#include <boost/signals2.hpp>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std::chrono;
+
+// ============================================================================
+// Configuration
+// ============================================================================
+
+namespace config {
+constexpr uint32_t WARMUP_ROUNDS = 1U;
+constexpr uint32_t TEST_ROUNDS = 3U;
+// Listener calls of each invoke and dispatch round.
+constexpr uint32_t LISTENER_CALLS = 2000000U;
+// Events of each queue round, split among the producers.
+constexpr uint32_t QUEUE_EVENTS = 200000U;
+constexpr int EVENT_COUNT = 16;
+const int LISTENER_COUNTS[] = {1, 10, 100};
+const uint32_t PRODUCER_COUNTS[] = {1U, 2U, 4U, 8U, 16U};
+}  // namespace config
+
+// ============================================================================
+// Payload and results
+// ============================================================================
+
+template <std::size_t N>
+struct Payload {
+  unsigned char data[N];
+};
+
+template <std::size_t N>
+Payload<N> make_payload(const uint32_t seed) {
+  Payload<N> payload;
+  for (std::size_t i = 0; i < N; ++i) {
+    payload.data[i] = static_cast<unsigned char>(seed + i);
+  }
+  return payload;
+}
+
+// Written by the listeners, so the calls are not optimized away.
+uint64_t g_sink = 0;
+
+template <std::size_t N>
+void on_payload(const Payload<N>& payload) {
+  g_sink += payload.data[0] + payload.data[N - 1];
+}
+
+struct Row {
+  const char* scenario;
+  const char* library;
+  int listeners;
+  uint32_t producers;
+  std::size_t payload;
+  double ns_per_op;
+};
+
+std::vector<Row> g_rows;
+
+template <typename Round>
+double median_of_rounds(Round round) {
+  std::vector<double> results;
+  for (uint32_t r = 0; r < config::WARMUP_ROUNDS + config::TEST_ROUNDS; ++r) {
+    const double result = round();
+    if (r >= config::WARMUP_ROUNDS) {
+      results.push_back(result);
+    }
+  }
+  std::sort(results.begin(), results.end());
+  return results[results.size() / 2];
+}
+
+// Returns the nanoseconds of each of the ops calls of body().
+template <typename Body>
+double measure_ns(const uint32_t ops, Body body) {
+  return median_of_rounds([&]() {
+    const auto start = steady_clock::now();
+    for (uint32_t k = 0; k < ops; ++k) {
+      body(k);
+    }
+    return duration<double, std::nano>(steady_clock::now() - start).count() / ops;
+  });
+}
+
+void add_row(const char* scenario, const char* library, const int listeners, const uint32_t producers,
+             const std::size_t payload, const double ns_per_op) {
+  g_rows.push_back(Row{scenario, library, listeners, producers, payload, ns_per_op});
+}
+
+// ============================================================================
+// invoke
+// ============================================================================
+
+template <std::size_t N, typename Policies>
+double bench_callbacklist(const int listeners, const uint32_t ops) {
+  eventpp::CallbackList<void(const Payload<N>&), Policies> list;
+  for (int i = 0; i < listeners; ++i) {
+    list.append(&on_payload<N>);
+  }
+  const Payload<N> payload = make_payload<N>(1);
+  return measure_ns(ops, [&](uint32_t) { list(payload); });
+}
+
+template <std::size_t N>
+void run_invoke(const int listeners) {
+  const uint32_t ops = config::LISTENER_CALLS / static_cast<uint32_t>(listeners);
+  const Payload<N> payload = make_payload<N>(1);
+
+  add_row("invoke", "eventpp CallbackList", listeners, 1U, N,
+          bench_callbacklist<N, eventpp::DefaultPolicies>(listeners, ops));
+  add_row("invoke", "eventpp CallbackList HighPerf", listeners, 1U, N,
+          bench_callbacklist<N, eventpp::HighPerfPolicy>(listeners, ops));
+
+#if EVENTPP_BENCH_HAS_BOOST_SIGNALS2
+  {
+    boost::signals2::signal<void(const Payload<N>&)> signal;
+    for (int i = 0; i < listeners; ++i) {
+      signal.connect(&on_payload<N>);
+    }
+    add_row("invoke", "Boost.Signals2", listeners, 1U, N,
+            measure_ns(ops, [&](uint32_t) { signal(payload); }));
+  }
+#endif
+  (void)payload;
+}
+
+// ============================================================================
+// dispatch
+// ============================================================================
+
+template <std::size_t N, typename Policies>
+double bench_eventdispatcher(const int listeners, const uint32_t ops) {
+  eventpp::EventDispatcher<int, void(const Payload<N>&), Policies> dispatcher;
+  for (int e = 0; e < config::EVENT_COUNT; ++e) {
+    for (int i = 0; i < listeners; ++i) {
+      dispatcher.appendListener(e, &on_payload<N>);
+    }
+  }
+  const Payload<N> payload = make_payload<N>(2);
+  return measure_ns(ops, [&](uint32_t k) {
+    dispatcher.dispatch(static_cast<int>(k % config::EVENT_COUNT), payload);
+  });
+}
+
+template <std::size_t N>
+void run_dispatch(const int listeners) {
+  const uint32_t ops = config::LISTENER_CALLS / static_cast<uint32_t>(listeners);
+  const Payload<N> payload = make_payload<N>(2);
+
+  add_row("dispatch", "eventpp EventDispatcher", listeners, 1U, N,
+          bench_eventdispatcher<N, eventpp::DefaultPolicies>(listeners, ops));
+  add_row("dispatch", "eventpp EventDispatcher HighPerf", listeners, 1U, N,
+          bench_eventdispatcher<N, eventpp::HighPerfPolicy>(listeners, ops));
+
+#if EVENTPP_BENCH_HAS_BOOST_SIGNALS2
+  {
+    std::unordered_map<int, boost::signals2::signal<void(const Payload<N>&)>> signals;
+    for (int e = 0; e < config::EVENT_COUNT; ++e) {
+      for (int i = 0; i < listeners; ++i) {
+        signals[e].connect(&on_payload<N>);
+      }
+    }
+    add_row("dispatch", "Boost.Signals2 + unordered_map", listeners, 1U, N,
+            measure_ns(ops, [&](uint32_t k) { signals[static_cast<int>(k % config::EVENT_COUNT)](payload); }));
+  }
+#endif
+  (void)payload;
+}
+
+// ============================================================================
+// queue
+// ============================================================================
+
+// Starts the producers and the consumer together, returns the nanoseconds
+// of each event. produce(producer_index, event_count) enqueues the events,
+// consume(total) returns after it has dispatched total events.
+template <typename Produce, typename Consume>
+double run_queue_threads(const uint32_t producers, Produce produce, Consume consume) {
+  return median_of_rounds([&]() {
+    const uint32_t per_producer = config::QUEUE_EVENTS / producers;
+    const uint32_t total = per_producer * producers;
+    std::atomic<uint32_t> ready_count(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+
+    for (uint32_t p = 0; p < producers; ++p) {
+      threads.emplace_back([p, per_producer, &ready_count, &go, &produce]() {
+        ready_count.fetch_add(1, std::memory_order_acq_rel);
+        while (!go.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+        }
+        produce(p, per_producer);
+      });
+    }
+    while (ready_count.load(std::memory_order_acquire) < producers) {
+      std::this_thread::yield();
+    }
+
+    const auto start = steady_clock::now();
+    go.store(true, std::memory_order_release);
+    consume(total);
+    const double ns = duration<double, std::nano>(steady_clock::now() - start).count();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    return ns / total;
+  });
+}
+
+template <std::size_t N, typename Policies>
+double bench_eventqueue(const uint32_t producers) {
+  eventpp::EventQueue<int, void(const Payload<N>&), Policies> queue;
+  uint32_t consumed = 0;
+  queue.appendListener(1, [&consumed](const Payload<N>& payload) {
+    on_payload<N>(payload);
+    ++consumed;
+  });
+  return run_queue_threads(
+      producers,
+      [&queue](uint32_t p, uint32_t count) {
+        const Payload<N> payload = make_payload<N>(p);
+        for (uint32_t k = 0; k < count; ++k) {
+          queue.enqueue(1, payload);
+        }
+      },
+      [&queue, &consumed](uint32_t total) {
+        consumed = 0;
+        while (consumed < total) {
+          if (!queue.process()) {
+            std::this_thread::yield();
+          }
+        }
+      });
+}
+
+template <std::size_t N>
+void run_queue(const uint32_t producers) {
+  add_row("queue", "eventpp EventQueue", 1, producers, N,
+          bench_eventqueue<N, eventpp::DefaultPolicies>(producers));
+  add_row("queue", "eventpp EventQueue HighPerf", 1, producers, N,
+          bench_eventqueue<N, eventpp::HighPerfPolicy>(producers));
+}
+
+// ============================================================================
+// Report
+// ============================================================================
+
+template <std::size_t N>
+void run_payload() {
+  for (const int listeners : config::LISTENER_COUNTS) {
+    run_invoke<N>(listeners);
+  }
+  for (const int listeners : config::LISTENER_COUNTS) {
+    run_dispatch<N>(listeners);
+  }
+  for (const uint32_t producers : config::PRODUCER_COUNTS) {
+    run_queue<N>(producers);
+  }
+}
+
+void print_table() {
+  std::printf("\n%-9s | %-34s | %9s | %9s | %7s | %10s | %10s\n", "scenario", "library", "listeners",
+              "producers", "payload", "ns/op", "Mops/s");
+  std::printf("----------+------------------------------------+-----------+-----------+---------+------------+-----------\n");
+  for (const Row& row : g_rows) {
+    std::printf("%-9s | %-34s | %9d | %9u | %7zu | %10.1f | %10.2f\n", row.scenario, row.library,
+                row.listeners, row.producers, row.payload, row.ns_per_op, 1e3 / row.ns_per_op);
+  }
+}
+
+int main() {
+  std::printf("========================================\n");
+  std::printf("  eventpp vs other libraries\n");
+  std::printf("========================================\n");
+  std::printf("Hardware threads: %u\n", std::thread::hardware_concurrency());
+  std::printf("Boost.Signals2: %s\n", EVENTPP_BENCH_HAS_BOOST_SIGNALS2 ? "yes" : "no");
+
+  run_payload<8>();
+  run_payload<64>();
+  run_payload<256>();
+  run_payload<1024>();
+
+  print_table();
+  std::printf("(sink %llu)\n", static_cast<unsigned long long>(g_sink));
+
+  return 0;
+}
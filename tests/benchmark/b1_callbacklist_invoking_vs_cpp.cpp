@@ -13,6 +13,7 @@
 
 #include "test.h"
 #include "eventpp/callbacklist.h"
+#include "eventpp/utilities/listenerprofiler.h"
 
 #if defined(_MSC_VER)
 #define NON_INLINE __declspec(noinline)
@@ -395,3 +396,45 @@ TEST_CASE("b1, CallbackList invoking vs C++ invoking")
 	}
 }
 
+TEST_CASE("b1, CallbackList invoking, ListenerProfiler overhead")
+{
+	std::cout << std::endl << "b1, CallbackList invoking, ListenerProfiler overhead" << std::endl;
+
+	constexpr int iterateCount = 1000 * 1000 * 10;
+	constexpr int callbackCount = 10;
+
+	struct PlainPolicies {
+	};
+	eventpp::CallbackList<void (int, int), PlainPolicies> plainList;
+	for(int c = 0; c < callbackCount; ++c) {
+		plainList.append(&nonInlineGlobalFunction);
+	}
+	const uint64_t plainTime = measureElapsedTime([iterateCount, &plainList]() {
+		for(int i = 0; i < iterateCount; ++i) {
+			plainList(i, i);
+		}
+	});
+
+	struct ProfiledPolicies {
+		using Profiler = eventpp::ListenerProfiler<>;
+	};
+	eventpp::CallbackList<void (int, int), ProfiledPolicies> profiledList;
+	for(int c = 0; c < callbackCount; ++c) {
+		profiledList.append(&nonInlineGlobalFunction);
+	}
+	const uint64_t profiledTime = measureElapsedTime([iterateCount, &profiledList]() {
+		for(int i = 0; i < iterateCount; ++i) {
+			profiledList(i, i);
+		}
+	});
+
+	eventpp::ListenerProfiler<>::startWatchdog(std::chrono::milliseconds(10), [](const eventpp::ListenerWatchdogReport &) {});
+	const uint64_t watchedTime = measureElapsedTime([iterateCount, &profiledList]() {
+		for(int i = 0; i < iterateCount; ++i) {
+			profiledList(i, i);
+		}
+	});
+	eventpp::ListenerProfiler<>::stopWatchdog();
+
+	std::cout << "No profiler: " << plainTime << " ListenerProfiler: " << profiledTime << " With watchdog: " << watchedTime << std::endl;
+}
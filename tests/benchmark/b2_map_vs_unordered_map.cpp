@@ -12,11 +12,19 @@
 // limitations under the License.
 
 #include "test.h"
+#include "eventpp/eventdispatcher.h"
+#include "eventpp/mixins/mixinfilter.h"
+#include "eventpp/mixins/mixinratelimit.h"
+#include "eventpp/utilities/flatarraymap.h"
+#include "eventpp/utilities/eventname.h"
+#include "eventpp/utilities/typeid.h"
 
+#include <atomic>
 #include <map>
 #include <unordered_map>
 #include <random>
 #include <string>
+#include <typeindex>
 
 namespace {
 
@@ -50,6 +58,12 @@ std::string generateRandomString(const int length){
 	return result;
 }
 
+struct FlatPolicies
+{
+	template <typename Key, typename T>
+	using Map = eventpp::FlatArrayMap<Key, T, 512>;
+};
+
 } //unnamed namespace
 
 TEST_CASE("b2, std::map vs std::unordered_map")
@@ -105,3 +119,364 @@ TEST_CASE("b2, std::map vs std::unordered_map")
 	std::cout << "UnordereMap: insert " << unorderedMapInsertTime << " lookup " << unorderedMapLookupTime << std::endl;
 }
 
+
+TEST_CASE("b2, EventDispatcher, unordered_map vs FlatArrayMap vs sealed")
+{
+	std::cout << std::endl << "b2, EventDispatcher, unordered_map vs FlatArrayMap vs sealed" << std::endl;
+
+	constexpr int eventCount = 512;
+	constexpr int iterateCount = 1000 * 1000 * 10;
+
+	std::vector<int> eventList(iterateCount);
+	for(auto & e : eventList) {
+		e = getRandomeInt(eventCount);
+	}
+
+	auto measureDispatch = [&eventList](auto & dispatcher, const bool seal) -> uint64_t {
+		int count = 0;
+		for(int i = 0; i < eventCount; ++i) {
+			dispatcher.appendListener(i, [&count](int) { ++count; });
+		}
+		if(seal) {
+			dispatcher.seal();
+		}
+		const uint64_t time = measureElapsedTime([&dispatcher, &eventList]() {
+			for(const int e : eventList) {
+				dispatcher.dispatch(e);
+			}
+		});
+		REQUIRE(count == (int)eventList.size());
+		return time;
+	};
+
+	eventpp::EventDispatcher<int, void (int)> unorderedMapDispatcher;
+	const uint64_t unorderedMapTime = measureDispatch(unorderedMapDispatcher, false);
+
+	eventpp::EventDispatcher<int, void (int)> sealedUnorderedMapDispatcher;
+	const uint64_t sealedUnorderedMapTime = measureDispatch(sealedUnorderedMapDispatcher, true);
+
+	eventpp::EventDispatcher<int, void (int), FlatPolicies> flatDispatcher;
+	const uint64_t flatTime = measureDispatch(flatDispatcher, false);
+
+	eventpp::EventDispatcher<int, void (int), FlatPolicies> sealedDispatcher;
+	const uint64_t sealedTime = measureDispatch(sealedDispatcher, true);
+
+	std::cout << "unordered_map: " << unorderedMapTime << std::endl;
+	std::cout << "sealed unordered_map: " << sealedUnorderedMapTime << std::endl;
+	std::cout << "FlatArrayMap: " << flatTime << std::endl;
+	std::cout << "sealed FlatArrayMap: " << sealedTime << std::endl;
+}
+
+TEST_CASE("b2, EventDispatcher, filters for all events vs filters for some events")
+{
+	std::cout << std::endl << "b2, EventDispatcher, filters for all events vs filters for some events" << std::endl;
+
+	struct FilterPolicies {
+		using Mixins = eventpp::MixinList<eventpp::MixinFilter>;
+	};
+	using ED = eventpp::EventDispatcher<int, void (int), FilterPolicies>;
+
+	constexpr int eventCount = 512;
+	constexpr int filterCount = 20;
+	constexpr int iterateCount = 1000 * 1000 * 10;
+
+	std::vector<int> eventList(iterateCount);
+	for(auto & e : eventList) {
+		e = getRandomeInt(eventCount);
+	}
+
+	// Each filter of the masked dispatcher is for 1/filterCount of the events.
+	auto measureDispatch = [&eventList](ED & dispatcher, const bool masked) -> uint64_t {
+		int count = 0;
+		for(int i = 0; i < eventCount; ++i) {
+			dispatcher.appendListener(i, [&count](int) { ++count; });
+		}
+		int filterCalledCount = 0;
+		for(int i = 0; i < filterCount; ++i) {
+			auto filter = [&filterCalledCount](int) -> bool {
+				++filterCalledCount;
+				return true;
+			};
+			if(masked) {
+				std::vector<int> filterEventList;
+				for(int e = i; e < eventCount; e += filterCount) {
+					filterEventList.push_back(e);
+				}
+				dispatcher.appendFilter(filterEventList, filter);
+			}
+			else {
+				dispatcher.appendFilter(filter);
+			}
+		}
+		const uint64_t time = measureElapsedTime([&dispatcher, &eventList]() {
+			for(const int e : eventList) {
+				dispatcher.dispatch(e);
+			}
+		});
+		REQUIRE(count == (int)eventList.size());
+		REQUIRE(filterCalledCount == (int)eventList.size() * (masked ? 1 : filterCount));
+		return time;
+	};
+
+	ED allEventsDispatcher;
+	const uint64_t allEventsTime = measureDispatch(allEventsDispatcher, false);
+
+	ED maskedDispatcher;
+	const uint64_t maskedTime = measureDispatch(maskedDispatcher, true);
+
+	std::cout << filterCount << " filters for all events: " << allEventsTime << std::endl;
+	std::cout << filterCount << " filters for some events: " << maskedTime << std::endl;
+}
+
+TEST_CASE("b2, EventDispatcher, sampling by MixinFilter vs MixinRateLimit")
+{
+	std::cout << std::endl << "b2, EventDispatcher, sampling by MixinFilter vs MixinRateLimit" << std::endl;
+
+	struct FilterPolicies {
+		using Mixins = eventpp::MixinList<eventpp::MixinFilter>;
+	};
+	struct RateLimitPolicies {
+		using Mixins = eventpp::MixinList<eventpp::MixinRateLimit>;
+	};
+
+	constexpr int eventCount = 512;
+	// 1 in 2 of the events 0, 20, 40... are dispatched.
+	constexpr int sampledStep = 20;
+	constexpr int iterateCount = 1000 * 1000 * 10;
+
+	std::vector<int> eventList(iterateCount);
+	int sampledEventCount = 0;
+	for(auto & e : eventList) {
+		e = getRandomeInt(eventCount);
+		if(e % sampledStep == 0) {
+			++sampledEventCount;
+		}
+	}
+
+	auto measureDispatch = [&eventList](auto & dispatcher) -> std::pair<uint64_t, int> {
+		int count = 0;
+		for(int i = 0; i < eventCount; ++i) {
+			dispatcher.appendListener(i, [&count](int) { ++count; });
+		}
+		const uint64_t time = measureElapsedTime([&dispatcher, &eventList]() {
+			for(const int e : eventList) {
+				dispatcher.dispatch(e);
+			}
+		});
+		return std::make_pair(time, count);
+	};
+
+	eventpp::EventDispatcher<int, void (int), RateLimitPolicies> noLimitDispatcher;
+	const auto noLimitResult = measureDispatch(noLimitDispatcher);
+	REQUIRE(noLimitResult.second == (int)eventList.size());
+
+	// The counters must be atomic as the buckets, the filter may be called by
+	// several threads.
+	std::vector<std::atomic<unsigned int> > counterList(eventCount);
+	eventpp::EventDispatcher<int, void (int), FilterPolicies> filterDispatcher;
+	std::vector<int> sampledList;
+	for(int e = 0; e < eventCount; e += sampledStep) {
+		sampledList.push_back(e);
+	}
+	filterDispatcher.appendFilter(sampledList, [&counterList](const int e) -> bool {
+		return counterList[e].fetch_add(1, std::memory_order_relaxed) % 2 == 0;
+	});
+	const auto filterResult = measureDispatch(filterDispatcher);
+
+	eventpp::EventDispatcher<int, void (int), RateLimitPolicies> rateLimitDispatcher;
+	decltype(rateLimitDispatcher)::RateLimit limit;
+	limit.sampleEvery = 2;
+	for(const int e : sampledList) {
+		rateLimitDispatcher.setRateLimit(e, limit);
+	}
+	const auto rateLimitResult = measureDispatch(rateLimitDispatcher);
+	REQUIRE(filterResult.second == rateLimitResult.second);
+	REQUIRE(eventList.size() - rateLimitResult.second <= (size_t)sampledEventCount / 2 + sampledList.size());
+
+	std::cout << "No limit: " << noLimitResult.first << std::endl;
+	std::cout << "MixinFilter: " << filterResult.first << std::endl;
+	std::cout << "MixinRateLimit: " << rateLimitResult.first << std::endl;
+}
+
+TEST_CASE("b2, EventDispatcher, std::string vs EventName")
+{
+	std::cout << std::endl << "b2, EventDispatcher, std::string vs EventName" << std::endl;
+
+	constexpr int eventCount = 512;
+	constexpr int iterateCount = 1000 * 1000 * 10;
+
+	// Names of a typical length, which share a long prefix.
+	std::vector<std::string> nameList;
+	std::vector<eventpp::EventName> eventNameList;
+	for(int i = 0; i < eventCount; ++i) {
+		nameList.push_back("market.order.update." + std::to_string(i));
+		eventNameList.push_back(eventpp::EventName::intern(nameList.back()));
+	}
+
+	std::vector<int> indexList(iterateCount);
+	for(auto & index : indexList) {
+		index = getRandomeInt(eventCount);
+	}
+
+	auto measureDispatch = [&indexList](auto & dispatcher, const auto & eventList) -> uint64_t {
+		int count = 0;
+		for(const auto & e : eventList) {
+			dispatcher.appendListener(e, [&count]() { ++count; });
+		}
+		const uint64_t time = measureElapsedTime([&dispatcher, &eventList, &indexList]() {
+			for(const int index : indexList) {
+				dispatcher.dispatch(eventList[index]);
+			}
+		});
+		REQUIRE(count == (int)indexList.size());
+		return time;
+	};
+
+	eventpp::EventDispatcher<std::string, void ()> stringDispatcher;
+	const uint64_t stringTime = measureDispatch(stringDispatcher, nameList);
+
+	eventpp::EventDispatcher<eventpp::EventName, void ()> eventNameDispatcher;
+	const uint64_t eventNameTime = measureDispatch(eventNameDispatcher, eventNameList);
+
+	std::cout << "std::string: " << stringTime << std::endl;
+	std::cout << "EventName: " << eventNameTime << std::endl;
+}
+
+TEST_CASE("b2, EventDispatcher, dispatch(e) vs dispatch<E>() vs ListenerRef")
+{
+	std::cout << std::endl << "b2, EventDispatcher, dispatch(e) vs dispatch<E>() vs ListenerRef" << std::endl;
+
+	constexpr int eventCount = 256;
+	constexpr int iterateCount = 1000 * 1000 * 20;
+	using Event7 = std::integral_constant<int, 7>;
+
+	eventpp::EventDispatcher<int, void ()> dispatcher;
+	int count = 0;
+	for(int i = 0; i < eventCount; ++i) {
+		dispatcher.appendListener(i, [&count]() { ++count; });
+	}
+
+	// The event is read from a volatile, so the compiler can't fold it.
+	volatile int event = Event7::value;
+	const uint64_t runtimeTime = measureElapsedTime([&dispatcher, &event]() {
+		for(int i = 0; i < iterateCount; ++i) {
+			dispatcher.dispatch(event);
+		}
+	});
+
+	// OPT-72
+	const uint64_t constantTime = measureElapsedTime([&dispatcher]() {
+		for(int i = 0; i < iterateCount; ++i) {
+			dispatcher.dispatch<Event7>();
+		}
+	});
+
+	const auto ref = dispatcher.getListenerRef<Event7>();
+	const uint64_t refTime = measureElapsedTime([&ref]() {
+		for(int i = 0; i < iterateCount; ++i) {
+			ref.dispatch();
+		}
+	});
+	REQUIRE(count == iterateCount * 3);
+
+	std::cout << "dispatch(e): " << runtimeTime << std::endl;
+	std::cout << "dispatch<E>(): " << constantTime << std::endl;
+	std::cout << "ListenerRef::dispatch(): " << refTime << std::endl;
+}
+
+namespace {
+
+struct B2KeyEvent {};
+struct B2MouseEvent {};
+struct B2ResizeEvent {};
+struct B2CloseEvent {};
+
+struct TypeIdMapPolicies
+{
+	template <typename Key, typename T>
+	using Map = eventpp::TypeIdMap<Key, T>;
+};
+
+// Dispatches the four event types in turn, get(Type *) is the event.
+template <typename Dispatcher, typename GetEvent>
+uint64_t measureTypeDispatch(Dispatcher & dispatcher, GetEvent && getEvent, const int iterateCount, const bool seal = false)
+{
+	int count = 0;
+	dispatcher.appendListener(getEvent((B2KeyEvent *)nullptr), [&count](int) { ++count; });
+	dispatcher.appendListener(getEvent((B2MouseEvent *)nullptr), [&count](int) { ++count; });
+	dispatcher.appendListener(getEvent((B2ResizeEvent *)nullptr), [&count](int) { ++count; });
+	dispatcher.appendListener(getEvent((B2CloseEvent *)nullptr), [&count](int) { ++count; });
+	if(seal) {
+		dispatcher.seal();
+	}
+	const uint64_t time = measureElapsedTime([&dispatcher, &getEvent, iterateCount]() {
+		for(int i = 0; i < iterateCount; i += 4) {
+			dispatcher.dispatch(getEvent((B2KeyEvent *)nullptr), i);
+			dispatcher.dispatch(getEvent((B2MouseEvent *)nullptr), i);
+			dispatcher.dispatch(getEvent((B2ResizeEvent *)nullptr), i);
+			dispatcher.dispatch(getEvent((B2CloseEvent *)nullptr), i);
+		}
+	});
+	REQUIRE(count == iterateCount);
+	return time;
+}
+
+} //unnamed namespace
+
+TEST_CASE("b2, EventDispatcher, std::type_index vs TypeId vs dispatch<T>")
+{
+	std::cout << std::endl << "b2, EventDispatcher, std::type_index vs TypeId vs dispatch<T>" << std::endl;
+
+	constexpr int iterateCount = 1000 * 1000 * 10;
+
+	{
+		eventpp::EventDispatcher<std::type_index, void (int)> dispatcher;
+		const uint64_t time = measureTypeDispatch(dispatcher, [](auto * type) {
+			return std::type_index(typeid(*type));
+		}, iterateCount);
+		std::cout << "std::type_index, unordered_map: " << time << " ms" << std::endl;
+	}
+
+	{
+		eventpp::EventDispatcher<eventpp::TypeId, void (int)> dispatcher;
+		const uint64_t time = measureTypeDispatch(dispatcher, [](auto * type) {
+			return eventpp::getTypeId<decltype(*type)>();
+		}, iterateCount);
+		std::cout << "TypeId, unordered_map: " << time << " ms" << std::endl;
+	}
+
+	{
+		eventpp::EventDispatcher<eventpp::TypeId, void (int), TypeIdMapPolicies> dispatcher;
+		const uint64_t time = measureTypeDispatch(dispatcher, [](auto * type) {
+			return eventpp::getTypeId<decltype(*type)>();
+		}, iterateCount);
+		std::cout << "TypeId, TypeIdMap: " << time << " ms" << std::endl;
+	}
+
+	{
+		eventpp::EventDispatcher<eventpp::TypeId, void (int), TypeIdMapPolicies> dispatcher;
+		const uint64_t time = measureTypeDispatch(dispatcher, [](auto * type) {
+			return eventpp::getTypeId<decltype(*type)>();
+		}, iterateCount, true);
+		std::cout << "TypeId, sealed TypeIdMap: " << time << " ms" << std::endl;
+	}
+
+	{
+		eventpp::EventDispatcher<eventpp::TypeId, void (int), TypeIdMapPolicies> dispatcher;
+		int count = 0;
+		dispatcher.appendListener(eventpp::getTypeId<B2KeyEvent>(), [&count](int) { ++count; });
+		dispatcher.appendListener(eventpp::getTypeId<B2MouseEvent>(), [&count](int) { ++count; });
+		dispatcher.appendListener(eventpp::getTypeId<B2ResizeEvent>(), [&count](int) { ++count; });
+		dispatcher.appendListener(eventpp::getTypeId<B2CloseEvent>(), [&count](int) { ++count; });
+		const uint64_t time = measureElapsedTime([&dispatcher, iterateCount]() {
+			for(int i = 0; i < iterateCount; i += 4) {
+				dispatcher.dispatch<B2KeyEvent>(i);
+				dispatcher.dispatch<B2MouseEvent>(i);
+				dispatcher.dispatch<B2ResizeEvent>(i);
+				dispatcher.dispatch<B2CloseEvent>(i);
+			}
+		});
+		REQUIRE(count == iterateCount);
+		std::cout << "TypeId, TypeIdMap, dispatch<T>: " << time << " ms" << std::endl;
+	}
+}
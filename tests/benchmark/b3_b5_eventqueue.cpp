@@ -13,10 +13,35 @@
 
 #include "test.h"
 #include "eventpp/eventqueue.h"
+#include "eventpp/coalescingeventqueue.h"
+#include "eventpp/indexedeventqueue.h"
+#include "eventpp/broadcasteventqueue.h"
+#include "eventpp/columneventqueue.h"
+#include "eventpp/utilities/orderedqueuelist.h"
+#include "eventpp/utilities/priorityqueuelist.h"
+#include "eventpp/utilities/activeobject.h"
+#include "eventpp/utilities/consumerpool.h"
+#include "eventpp/utilities/queueset.h"
+#include "eventpp/utilities/queuegroup.h"
+#include "eventpp/utilities/mergedqueue.h"
+#include "eventpp/utilities/windowaggregator.h"
+#include "eventpp/mixins/mixinaffinity.h"
+#if defined(__linux__)
+#include "eventpp/net/netbridge.h"
+#endif
 
+#include <ctime>
+#include <future>
+#include <memory>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
 namespace {
 
 template <typename Policies>
@@ -65,6 +90,55 @@ void doExecuteEventQueue(
 	;
 }
 
+template <typename Policies>
+void doExecuteEventQueueBulk(
+		const std::string & message,
+		const size_t batchSize,
+		const size_t totalEventCount,
+		const size_t eventCount,
+		const bool useBulk
+	)
+{
+	using EQ = eventpp::EventQueue<size_t, void (size_t), Policies>;
+	EQ eventQueue;
+
+	for(size_t i = 0; i < eventCount; ++i) {
+		eventQueue.appendListener(i, [](size_t) {});
+	}
+
+	const size_t iterateCount = totalEventCount / batchSize;
+	const uint64_t time = measureElapsedTime([
+			batchSize,
+			iterateCount,
+			eventCount,
+			useBulk,
+			&eventQueue
+		]{
+		for(size_t iterate = 0; iterate < iterateCount; ++iterate) {
+			if(useBulk) {
+				eventQueue.enqueueBulk(batchSize, [eventCount](const size_t i) {
+					return i % eventCount;
+				});
+			}
+			else {
+				for(size_t i = 0; i < batchSize; ++i) {
+					eventQueue.enqueue(i % eventCount);
+				}
+			}
+			eventQueue.process();
+		}
+	});
+
+	std::cout
+		<< message
+		<< " batchSize: " << batchSize
+		<< " totalEventCount: " << totalEventCount
+		<< " eventCount: " << eventCount
+		<< " Time: " << time
+		<< std::endl;
+	;
+}
+
 template <typename Policies>
 void doMultiThreadingExecuteEventQueue(
 		const std::string & message,
@@ -152,6 +226,121 @@ void doMultiThreadingExecuteEventQueue(
 }
 
 
+// Tick data like queue, runLength consecutive events have the same type.
+// useRuns false dispatches each event with directDispatch, which looks up
+// the map for every event, as process did before OPT-25.
+template <typename Policies>
+void doExecuteEventQueueRuns(
+		const std::string & message,
+		const size_t runLength,
+		const bool useRuns
+	)
+{
+	using EQ = eventpp::EventQueue<size_t, void (size_t), Policies>;
+	EQ eventQueue;
+	constexpr size_t eventCount = 3;
+	constexpr size_t queueSize = 10000;
+	constexpr size_t iterateCount = 300;
+
+	for(size_t i = 0; i < eventCount; ++i) {
+		eventQueue.appendListener(i, [](size_t) {});
+	}
+
+	const uint64_t time = measureElapsedTime([runLength, useRuns, &eventQueue]{
+		for(size_t iterate = 0; iterate < iterateCount; ++iterate) {
+			for(size_t i = 0; i < queueSize; ++i) {
+				eventQueue.enqueue((i / runLength) % eventCount);
+			}
+			if(useRuns) {
+				eventQueue.process();
+			}
+			else {
+				eventQueue.processQueueWith([&eventQueue](const size_t event, const size_t value) {
+					eventQueue.directDispatch(event, value);
+				});
+			}
+		}
+	});
+
+	std::cout
+		<< message
+		<< " runLength: " << runLength
+		<< " Time: " << time
+		<< std::endl;
+	;
+}
+
+// Every 100th event is a control event (event 0), the others are data.
+// With an ordering QueueList the control events are processed first.
+template <typename Policies>
+void doExecuteEventQueuePriority(
+		const std::string & message,
+		const size_t queueSize,
+		const size_t iterateCount
+	)
+{
+	using EQ = eventpp::EventQueue<size_t, void (size_t), Policies>;
+	EQ eventQueue;
+
+	eventQueue.appendListener(0, [](size_t) {});
+	eventQueue.appendListener(1, [](size_t) {});
+
+	const uint64_t time = measureElapsedTime([queueSize, iterateCount, &eventQueue]{
+		for(size_t iterate = 0; iterate < iterateCount; ++iterate) {
+			for(size_t i = 0; i < queueSize; ++i) {
+				eventQueue.enqueue(i % 100 == 0 ? 0 : 1, i);
+			}
+			eventQueue.process();
+		}
+	});
+
+	std::cout
+		<< message
+		<< " queueSize: " << queueSize
+		<< " iterateCount: " << iterateCount
+		<< " Time: " << time
+		<< std::endl;
+	;
+}
+
+// A burst of updates of sensorCount sensors, event 1 with (sensorId, value).
+// Only the last value of each sensor is needed.
+template <typename EQ>
+void doExecuteEventQueueCoalescing(
+		const std::string & message,
+		const size_t sensorCount,
+		const size_t burstSize,
+		const size_t iterateCount
+	)
+{
+	EQ eventQueue;
+
+	std::vector<size_t> values(sensorCount);
+	size_t dispatchCount = 0;
+	eventQueue.appendListener(1, [&values, &dispatchCount](const size_t sensorId, const size_t value) {
+		values[sensorId] = value;
+		++dispatchCount;
+	});
+
+	const uint64_t time = measureElapsedTime([sensorCount, burstSize, iterateCount, &eventQueue]{
+		for(size_t iterate = 0; iterate < iterateCount; ++iterate) {
+			for(size_t i = 0; i < burstSize; ++i) {
+				eventQueue.enqueue(1, i % sensorCount, i);
+			}
+			eventQueue.process();
+		}
+	});
+
+	std::cout
+		<< message
+		<< " sensorCount: " << sensorCount
+		<< " burstSize: " << burstSize
+		<< " dispatched: " << dispatchCount
+		<< " Time: " << time
+		<< std::endl;
+	;
+}
+
 } //unnamed namespace
 
 // To avoid warning "typedef locally defined but not used" in GCC,
@@ -177,10 +366,1012 @@ TEST_CASE("b3, EventQueue, one thread")
 	doExecuteEventQueue<B3PoliciesSingleThreading>("Single threading", 1000, 1000 * 100, 1000);
 }
 
+TEST_CASE("b3, EventQueue, enqueue vs enqueueBulk")
+{
+	std::cout << std::endl << "b3, EventQueue, enqueue vs enqueueBulk" << std::endl;
+
+	const size_t batchSizeList[] = { 1, 16, 256 };
+	for(const size_t batchSize : batchSizeList) {
+		doExecuteEventQueueBulk<B3PoliciesMultiThreading>("enqueue", batchSize, 1000 * 1000 * 5, 100, false);
+		doExecuteEventQueueBulk<B3PoliciesMultiThreading>("enqueueBulk", batchSize, 1000 * 1000 * 5, 100, true);
+	}
+}
+
+TEST_CASE("b3, EventQueue, runs of the same event")
+{
+	std::cout << std::endl << "b3, EventQueue, runs of the same event" << std::endl;
+
+	const size_t runLengthList[] = { 1, 16, 1000 };
+	for(const size_t runLength : runLengthList) {
+		doExecuteEventQueueRuns<B3PoliciesMultiThreading>("Lookup per event", runLength, false);
+		doExecuteEventQueueRuns<B3PoliciesMultiThreading>("Lookup per run", runLength, true);
+	}
+}
+
+struct B3PoliciesOrderedList {
+	template <typename T>
+	using QueueList = eventpp::OrderedQueueList<T>;
+};
+struct B3PoliciesPriorityList {
+	static size_t getPriority(const size_t event, size_t) {
+		return event == 0 ? 0 : 1;
+	}
+
+	template <typename T>
+	using QueueList = eventpp::PriorityQueueList<T, B3PoliciesPriorityList, 2>;
+};
+
+TEST_CASE("b3, EventQueue, priority lanes vs OrderedQueueList")
+{
+	std::cout << std::endl << "b3, EventQueue, priority lanes vs OrderedQueueList" << std::endl;
+
+	const size_t queueSizeList[] = { 100, 1000 };
+	for(const size_t queueSize : queueSizeList) {
+		const size_t iterateCount = 1000 * 100 / queueSize;
+		doExecuteEventQueuePriority<B3PoliciesMultiThreading>("std::list, FIFO", queueSize, iterateCount);
+		doExecuteEventQueuePriority<B3PoliciesOrderedList>("OrderedQueueList", queueSize, iterateCount);
+		doExecuteEventQueuePriority<B3PoliciesPriorityList>("PriorityQueueList", queueSize, iterateCount);
+	}
+}
+
+struct B3PoliciesCoalescing {
+	static size_t coalesceKey(const size_t /*event*/, const size_t sensorId, const size_t /*value*/) {
+		return sensorId;
+	}
+};
+
+TEST_CASE("b3, EventQueue, coalescing updates")
+{
+	std::cout << std::endl << "b3, EventQueue, coalescing updates" << std::endl;
+
+	const size_t sensorCountList[] = { 10, 1000 };
+	for(const size_t sensorCount : sensorCountList) {
+		doExecuteEventQueueCoalescing<eventpp::EventQueue<size_t, void (size_t, size_t)> >(
+			"EventQueue", sensorCount, 1000 * 10, 100);
+		doExecuteEventQueueCoalescing<eventpp::CoalescingEventQueue<size_t, void (size_t, size_t), B3PoliciesCoalescing> >(
+			"CoalescingEventQueue", sensorCount, 1000 * 10, 100);
+	}
+}
+
+// One consumer takes event 0 on each round, the other events are processed
+// every 100 rounds, so they pile up in the queue between.
+TEST_CASE("b3, EventQueue, one consumer per event, processIf vs processEvent")
+{
+	std::cout << std::endl << "b3, EventQueue, one consumer per event, processIf vs processEvent" << std::endl;
+
+	constexpr size_t eventCount = 32;
+	constexpr size_t batchSize = 100;
+	constexpr size_t iterateCount = 1000 * 10;
+
+	{
+		eventpp::EventQueue<size_t, void (size_t)> eventQueue;
+		size_t dispatchCount = 0;
+		for(size_t e = 0; e < eventCount; ++e) {
+			eventQueue.appendListener(e, [&dispatchCount](size_t) {
+				++dispatchCount;
+			});
+		}
+		const uint64_t time = measureElapsedTime([&eventQueue]() {
+			for(size_t i = 0; i < iterateCount; ++i) {
+				for(size_t k = 0; k < batchSize; ++k) {
+					eventQueue.enqueue(k % eventCount, k);
+				}
+				// The predicate gets the arguments only, the value tells the event.
+				eventQueue.processIf([](const size_t value) {
+					return value % eventCount == 0;
+				});
+				if(i % 100 == 99) {
+					eventQueue.process();
+				}
+			}
+		});
+		std::cout << "EventQueue::processIf: " << time << " ms (" << dispatchCount << ")" << std::endl;
+	}
+
+	{
+		eventpp::IndexedEventQueue<size_t, void (size_t)> eventQueue;
+		size_t dispatchCount = 0;
+		for(size_t e = 0; e < eventCount; ++e) {
+			eventQueue.appendListener(e, [&dispatchCount](size_t) {
+				++dispatchCount;
+			});
+		}
+		const uint64_t time = measureElapsedTime([&eventQueue]() {
+			for(size_t i = 0; i < iterateCount; ++i) {
+				for(size_t k = 0; k < batchSize; ++k) {
+					eventQueue.enqueue(k % eventCount, k);
+				}
+				eventQueue.processEvent(0);
+				if(i % 100 == 99) {
+					eventQueue.process();
+				}
+			}
+		});
+		std::cout << "IndexedEventQueue::processEvent: " << time << " ms (" << dispatchCount << ")" << std::endl;
+	}
+}
+
+// Every event goes to 4 subsystems, each one has its own EventQueue, or its
+// own consumer of one BroadcastEventQueue.
+TEST_CASE("b3, EventQueue, fan-out, EventQueue per consumer vs BroadcastEventQueue")
+{
+	std::cout << std::endl << "b3, EventQueue, fan-out, EventQueue per consumer vs BroadcastEventQueue" << std::endl;
+
+	constexpr size_t consumerCount = 4;
+	constexpr size_t batchSize = 1000;
+	constexpr size_t iterateCount = 1000;
+
+	{
+		using EQ = eventpp::EventQueue<size_t, void (size_t)>;
+		std::vector<EQ> queueList(consumerCount);
+		size_t sum = 0;
+		const uint64_t time = measureElapsedTime([&queueList, &sum]() {
+			for(size_t i = 0; i < iterateCount; ++i) {
+				for(size_t k = 0; k < batchSize; ++k) {
+					for(auto & queue : queueList) {
+						queue.enqueue(1, k);
+					}
+				}
+				for(auto & queue : queueList) {
+					queue.processQueueWith([&sum](size_t, const size_t value) {
+						sum += value;
+					});
+				}
+			}
+		});
+		std::cout << "EventQueue per consumer: " << time << " ms (" << sum << ")" << std::endl;
+	}
+
+	{
+		struct Policies {
+			using RingCapacity = std::integral_constant<size_t, batchSize>;
+		};
+		using EQ = eventpp::BroadcastEventQueue<size_t, void (size_t), Policies>;
+		EQ queue;
+		std::vector<EQ::Consumer> consumerList;
+		for(size_t c = 0; c < consumerCount; ++c) {
+			consumerList.push_back(queue.addConsumer());
+		}
+		size_t sum = 0;
+		const uint64_t time = measureElapsedTime([&queue, &consumerList, &sum]() {
+			for(size_t i = 0; i < iterateCount; ++i) {
+				for(size_t k = 0; k < batchSize; ++k) {
+					queue.enqueue(1, k);
+				}
+				for(auto & consumer : consumerList) {
+					consumer.processQueueWith([&sum](size_t, const size_t value) {
+						sum += value;
+					});
+				}
+			}
+		});
+		std::cout << "BroadcastEventQueue: " << time << " ms (" << sum << ")" << std::endl;
+	}
+}
+
+struct B3PoliciesReply {
+	using QueueReply = eventpp::QueueReplyPooled;
+};
+
+// Each request is enqueued, the consumer processes the batch, then the
+// requester reads all the results.
+TEST_CASE("b3, EventQueue, enqueueWithReply vs std::promise")
+{
+	std::cout << std::endl << "b3, EventQueue, enqueueWithReply vs std::promise" << std::endl;
+
+	constexpr size_t batchSize = 100;
+	constexpr size_t iterateCount = 1000 * 10;
+
+	{
+		using EQ = eventpp::EventQueue<size_t, size_t (size_t), B3PoliciesReply>;
+		EQ eventQueue;
+		eventQueue.appendListener(1, [](const size_t n) {
+			return n + 1;
+		});
+		std::vector<EQ::Reply> replyList(batchSize);
+		size_t sum = 0;
+		const uint64_t time = measureElapsedTime([&eventQueue, &replyList, &sum]() {
+			for(size_t i = 0; i < iterateCount; ++i) {
+				for(size_t k = 0; k < batchSize; ++k) {
+					replyList[k] = eventQueue.enqueueWithReply(1, k);
+				}
+				eventQueue.process();
+				for(auto & reply : replyList) {
+					sum += reply.get();
+				}
+			}
+		});
+		std::cout << "enqueueWithReply: " << time << " ms (" << sum << ")" << std::endl;
+	}
+
+	{
+		using EQ = eventpp::EventQueue<size_t, void (size_t, std::shared_ptr<std::promise<size_t> >)>;
+		EQ eventQueue;
+		eventQueue.appendListener(1, [](const size_t n, const std::shared_ptr<std::promise<size_t> > & promise) {
+			promise->set_value(n + 1);
+		});
+		std::vector<std::future<size_t> > futureList(batchSize);
+		size_t sum = 0;
+		const uint64_t time = measureElapsedTime([&eventQueue, &futureList, &sum]() {
+			for(size_t i = 0; i < iterateCount; ++i) {
+				for(size_t k = 0; k < batchSize; ++k) {
+					auto promise = std::make_shared<std::promise<size_t> >();
+					futureList[k] = promise->get_future();
+					eventQueue.enqueue(1, k, std::move(promise));
+				}
+				eventQueue.process();
+				for(auto & future : futureList) {
+					sum += future.get();
+				}
+			}
+		});
+		std::cout << "std::promise: " << time << " ms (" << sum << ")" << std::endl;
+	}
+}
+
+struct B3PoliciesCapacity {
+	using QueueCapacity = eventpp::QueueCapacityLimited;
+};
+
+TEST_CASE("b3, EventQueue, unbounded vs QueueCapacityLimited")
+{
+	std::cout << std::endl << "b3, EventQueue, unbounded vs QueueCapacityLimited" << std::endl;
+
+	constexpr size_t batchSize = 100;
+	constexpr size_t iterateCount = 1000 * 100;
+
+	{
+		eventpp::EventQueue<size_t, void (size_t)> eventQueue;
+		size_t sum = 0;
+		eventQueue.appendListener(1, [&sum](const size_t n) {
+			sum += n;
+		});
+		const uint64_t time = measureElapsedTime([&eventQueue]() {
+			for(size_t i = 0; i < iterateCount; ++i) {
+				for(size_t k = 0; k < batchSize; ++k) {
+					eventQueue.enqueue(1, k);
+				}
+				eventQueue.process();
+			}
+		});
+		std::cout << "Unbounded: " << time << " ms (" << sum << ")" << std::endl;
+	}
+
+	{
+		using EQ = eventpp::EventQueue<size_t, void (size_t), B3PoliciesCapacity>;
+		EQ eventQueue;
+		EQ::QueueLimits limits;
+		limits.maxEventCount = batchSize;
+		limits.highWatermark = batchSize;
+		limits.lowWatermark = batchSize / 2;
+		limits.maxFreeCount = batchSize;
+		eventQueue.setQueueLimits(limits);
+		size_t sum = 0;
+		eventQueue.appendListener(1, [&sum](const size_t n) {
+			sum += n;
+		});
+		const uint64_t time = measureElapsedTime([&eventQueue]() {
+			for(size_t i = 0; i < iterateCount; ++i) {
+				for(size_t k = 0; k < batchSize; ++k) {
+					eventQueue.enqueue(1, k);
+				}
+				eventQueue.process();
+			}
+		});
+		std::cout << "QueueCapacityLimited: " << time << " ms (" << sum << ")" << std::endl;
+	}
+}
+
+struct B3PoliciesDeadline {
+	using QueueDeadline = eventpp::QueueDeadlineSteady;
+};
+
+// Half of the events are stale when they are processed.
+struct B3PoliciesTimeToLive {
+	using QueueDeadline = eventpp::QueueDeadlineSteady;
+
+	static std::chrono::nanoseconds getTimeToLive(const size_t /*event*/, const size_t n) {
+		return (n & 1) != 0 ? std::chrono::nanoseconds(1) : std::chrono::nanoseconds(0);
+	}
+};
+
+template <typename Policies>
+void doExecuteDeadlineQueue(const std::string & message, const size_t batchSize, const size_t iterateCount)
+{
+	eventpp::EventQueue<size_t, void (size_t), Policies> eventQueue;
+	size_t sum = 0;
+	eventQueue.appendListener(1, [&sum](const size_t n) {
+		sum += n;
+	});
+	const uint64_t time = measureElapsedTime([&eventQueue, batchSize, iterateCount]() {
+		for(size_t i = 0; i < iterateCount; ++i) {
+			for(size_t k = 0; k < batchSize; ++k) {
+				eventQueue.enqueue(1, k);
+			}
+			eventQueue.process();
+		}
+	});
+	std::cout << message << ": " << time << " ms (" << sum << ")" << std::endl;
+}
+
+TEST_CASE("b3, EventQueue, no deadline vs QueueDeadlineSteady")
+{
+	std::cout << std::endl << "b3, EventQueue, no deadline vs QueueDeadlineSteady" << std::endl;
+
+	constexpr size_t batchSize = 100;
+	constexpr size_t iterateCount = 1000 * 100;
+
+	doExecuteDeadlineQueue<eventpp::DefaultPolicies>("No deadline", batchSize, iterateCount);
+	doExecuteDeadlineQueue<B3PoliciesDeadline>("QueueDeadlineSteady, no event has a deadline", batchSize, iterateCount);
+	doExecuteDeadlineQueue<B3PoliciesTimeToLive>("QueueDeadlineSteady, half of the events expired", batchSize, iterateCount);
+}
+
+template <typename EQ>
+void doExecuteColumnQueue(const std::string & message, const size_t queueSize, const size_t iterateCount)
+{
+	EQ eventQueue;
+	size_t sum = 0;
+	eventQueue.appendListener(1, [&sum](const size_t, const size_t n) {
+		sum += n;
+	});
+	const uint64_t processTime = measureElapsedTime([&eventQueue, queueSize, iterateCount]() {
+		for(size_t i = 0; i < iterateCount; ++i) {
+			for(size_t k = 0; k < queueSize; ++k) {
+				eventQueue.enqueue(k & 1, k);
+			}
+			eventQueue.process();
+		}
+	});
+	const uint64_t clearTime = measureElapsedTime([&eventQueue, queueSize, iterateCount]() {
+		for(size_t i = 0; i < iterateCount; ++i) {
+			for(size_t k = 0; k < queueSize; ++k) {
+				eventQueue.enqueue(k & 1, k);
+			}
+			eventQueue.clearEvents();
+		}
+	});
+	std::cout << message << ", queue size " << queueSize
+		<< ": process " << processTime << " ms, enqueue and clearEvents " << clearTime << " ms (" << sum << ")" << std::endl;
+}
+
+TEST_CASE("b3, EventQueue vs ColumnEventQueue")
+{
+	std::cout << std::endl << "b3, EventQueue vs ColumnEventQueue" << std::endl;
+
+	using EQ = eventpp::EventQueue<size_t, void (size_t, size_t)>;
+	using CEQ = eventpp::ColumnEventQueue<size_t, void (size_t, size_t)>;
+
+	const size_t queueSizeList[] = { 100, 10000 };
+	for(const size_t queueSize : queueSizeList) {
+		const size_t iterateCount = 1000 * 1000 * 10 / queueSize;
+		doExecuteColumnQueue<EQ>("EventQueue", queueSize, iterateCount);
+		doExecuteColumnQueue<CEQ>("ColumnEventQueue", queueSize, iterateCount);
+	}
+
+	// Counting the events of one type, processQueueWith visits each event,
+	// processColumnsWith scans the event column of each chunk.
+	constexpr size_t queueSize = 10000;
+	constexpr size_t iterateCount = 1000;
+	{
+		EQ eventQueue;
+		size_t count = 0;
+		const uint64_t time = measureElapsedTime([&eventQueue, &count]() {
+			for(size_t i = 0; i < iterateCount; ++i) {
+				for(size_t k = 0; k < queueSize; ++k) {
+					eventQueue.enqueue(k & 3, k);
+				}
+				eventQueue.processQueueWith([&count](const size_t event, size_t, size_t) {
+					count += (event == 1);
+				});
+			}
+		});
+		std::cout << "EventQueue, processQueueWith: " << time << " ms (" << count << ")" << std::endl;
+	}
+	{
+		CEQ eventQueue;
+		size_t count = 0;
+		const uint64_t time = measureElapsedTime([&eventQueue, &count]() {
+			for(size_t i = 0; i < iterateCount; ++i) {
+				for(size_t k = 0; k < queueSize; ++k) {
+					eventQueue.enqueue(k & 3, k);
+				}
+				eventQueue.processColumnsWith([&count](const size_t * events, const size_t *, const size_t *, const size_t n) {
+					for(size_t e = 0; e < n; ++e) {
+						count += (events[e] == 1);
+					}
+				});
+			}
+		});
+		std::cout << "ColumnEventQueue, processColumnsWith: " << time << " ms (" << count << ")" << std::endl;
+	}
+}
+
+TEST_CASE("b3, EventQueue, Pipeline hand-off per event vs per batch")
+{
+	std::cout << std::endl << "b3, EventQueue, Pipeline hand-off per event vs per batch" << std::endl;
+
+	using EQ = eventpp::EventQueue<size_t, void (size_t)>;
+	constexpr size_t eventCount = 1000 * 1000 * 2;
+
+	auto doExecute = [](const char * message, const size_t outputBatchSize) {
+		std::atomic<size_t> sum(0);
+		const uint64_t time = measureElapsedTime([&sum, outputBatchSize]() {
+			eventpp::Pipeline pipeline;
+			auto & first = pipeline.addStage<EQ>();
+			auto & second = pipeline.addStage<EQ>();
+			auto & third = pipeline.addStage<EQ>();
+			auto & firstOutput = pipeline.connect(first, second, outputBatchSize);
+			auto & secondOutput = pipeline.connect(second, third, outputBatchSize);
+			first.getQueue().appendListener(1, [&firstOutput](const size_t n) {
+				firstOutput.enqueue(1, n);
+			});
+			second.getQueue().appendListener(1, [&secondOutput](const size_t n) {
+				secondOutput.enqueue(1, n);
+			});
+			third.getQueue().appendListener(1, [&sum](const size_t n) {
+				sum.fetch_add(n, std::memory_order_relaxed);
+			});
+			pipeline.start();
+			for(size_t i = 0; i < eventCount; ++i) {
+				first.getQueue().enqueue(1, i);
+			}
+			pipeline.stop();
+		});
+		std::cout << message << ": " << time << " ms (" << sum.load() << ")" << std::endl;
+	};
+	doExecute("Per event", 1);
+	doExecute("Per batch of 64", 64);
+}
+
+TEST_CASE("b3, EventQueue, two queues polled by waitFor vs QueueSet")
+{
+	std::cout << std::endl << "b3, EventQueue, two queues polled by waitFor vs QueueSet" << std::endl;
+
+	using EQ = eventpp::EventQueue<int, void (std::chrono::steady_clock::time_point)>;
+	constexpr int roundCount = 1000;
+
+	// The events go to the data queue, the consumer also serves the idle
+	// control queue. Returns the average latency in microseconds.
+	auto doExecute = [](const char * message, const bool useQueueSet) {
+		EQ controlQueue;
+		EQ dataQueue;
+		std::atomic<int> doneCount(0);
+		std::atomic<int64_t> latencySum(0);
+		dataQueue.appendListener(1, [&doneCount, &latencySum](const std::chrono::steady_clock::time_point time) {
+			latencySum += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - time).count();
+			++doneCount;
+		});
+
+		std::atomic<bool> stopped(false);
+		std::thread consumer([&]() {
+			eventpp::QueueSet queueSet;
+			if(useQueueSet) {
+				queueSet.add(controlQueue);
+				queueSet.add(dataQueue);
+			}
+			while(! stopped.load()) {
+				if(useQueueSet) {
+					if(queueSet.waitFor(std::chrono::milliseconds(10)) != 0) {
+						controlQueue.process();
+						dataQueue.process();
+					}
+				}
+				else {
+					if(controlQueue.waitFor(std::chrono::milliseconds(1))) {
+						controlQueue.process();
+					}
+					if(dataQueue.waitFor(std::chrono::milliseconds(1))) {
+						dataQueue.process();
+					}
+				}
+			}
+		});
+
+		for(int i = 0; i < roundCount; ++i) {
+			std::this_thread::sleep_for(std::chrono::microseconds(200 + 37 * (i % 20)));
+			dataQueue.enqueue(1, std::chrono::steady_clock::now());
+			while(doneCount.load() <= i) {
+				std::this_thread::yield();
+			}
+		}
+		stopped = true;
+		consumer.join();
+		std::cout << message << ": " << latencySum.load() / roundCount << " us average latency" << std::endl;
+	};
+	doExecute("Alternating waitFor of 1 ms", false);
+	doExecute("QueueSet", true);
+}
+
+template <typename Strategy>
+struct B3WaitPolicies {
+	using WaitStrategy = Strategy;
+};
+
+TEST_CASE("b3, EventQueue, wake latency of the wait strategies")
+{
+	std::cout << std::endl << "b3, EventQueue, wake latency of the wait strategies" << std::endl;
+
+	constexpr int roundCount = 2000;
+
+	// The producer sleeps 20 to 100 us between the events. The CPU time is
+	// of the process, the producer only sleeps and enqueues.
+	auto doExecute = [](const char * message, auto queue) {
+		std::atomic<int> doneCount(0);
+		std::atomic<int64_t> latencySum(0);
+		queue->appendListener(1, [&doneCount, &latencySum](int, const std::chrono::steady_clock::time_point time) {
+			latencySum += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - time).count();
+			++doneCount;
+		});
+
+		const std::clock_t cpuStart = std::clock();
+		std::thread consumer([&]() {
+			while(doneCount.load() < roundCount) {
+				if(queue->waitFor(std::chrono::milliseconds(10))) {
+					queue->process();
+				}
+			}
+		});
+		for(int i = 0; i < roundCount; ++i) {
+			std::this_thread::sleep_for(std::chrono::microseconds(20 + 4 * (i % 20)));
+			queue->enqueue(1, std::chrono::steady_clock::now());
+			while(doneCount.load() <= i) {
+				std::this_thread::yield();
+			}
+		}
+		consumer.join();
+		const double cpuMs = 1000.0 * (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+		const auto stats = queue->getWaitStats();
+		std::cout << message << ": " << latencySum.load() / roundCount << " ns average latency, "
+			<< cpuMs << " ms CPU, " << stats.spinWakeCount << " spin wakes, "
+			<< stats.parkCount << " parks" << std::endl;
+	};
+	doExecute("WaitSpinThenPark<>", std::make_unique<eventpp::EventQueue<int, void (int, std::chrono::steady_clock::time_point), B3WaitPolicies<eventpp::WaitSpinThenPark<> > > >());
+	doExecute("WaitBlocking", std::make_unique<eventpp::EventQueue<int, void (int, std::chrono::steady_clock::time_point), B3WaitPolicies<eventpp::WaitBlocking> > >());
+	doExecute("WaitMonitorThenPark<>", std::make_unique<eventpp::EventQueue<int, void (int, std::chrono::steady_clock::time_point), B3WaitPolicies<eventpp::WaitMonitorThenPark<> > > >());
+}
+
 struct B4PoliciesMultiThreading {
 	using Threading = eventpp::GeneralThreading<std::mutex>;
 };
 
+// OPT-71: 4 listeners of one event run on a home thread. The home queue is
+// processed on this thread, so only the cost of the hand-off is measured.
+TEST_CASE("b3, EventQueue, re-enqueue listeners vs MixinAffinity")
+{
+	std::cout << std::endl << "b3, EventQueue, re-enqueue listeners vs MixinAffinity" << std::endl;
+
+	constexpr size_t dispatchCount = 1000 * 500;
+	constexpr int listenerCount = 4;
+	const std::string text(64, 'a');
+
+	{
+		eventpp::EventDispatcher<int, void (const std::string &, size_t)> dispatcher;
+		eventpp::EventQueue<int, void (const std::string &, size_t)> homeQueue;
+		size_t sum = 0;
+		for(int i = 0; i < listenerCount; ++i) {
+			homeQueue.appendListener(i, [&sum](const std::string & s, const size_t n) {
+				sum += s.size() + n;
+			});
+			dispatcher.appendListener(1, [&homeQueue, i](const std::string & s, const size_t n) {
+				homeQueue.enqueue(i, s, n);
+			});
+		}
+		const uint64_t time = measureElapsedTime([&dispatcher, &homeQueue, &text]() {
+			for(size_t i = 0; i < dispatchCount; ++i) {
+				dispatcher.dispatch(1, text, i);
+				if((i & 63) == 63) {
+					homeQueue.process();
+				}
+			}
+			homeQueue.process();
+		});
+		std::cout << "Re-enqueue listeners: " << time << " ms (" << sum << ")" << std::endl;
+	}
+
+	{
+		struct AffinityPolicies {
+			using Mixins = eventpp::MixinList<eventpp::MixinAffinity>;
+		};
+		eventpp::EventDispatcher<int, void (const std::string &, size_t), AffinityPolicies> dispatcher;
+		eventpp::AffinityQueue homeQueue;
+		size_t sum = 0;
+		for(int i = 0; i < listenerCount; ++i) {
+			dispatcher.appendListener(1, [&sum](const std::string & s, const size_t n) {
+				sum += s.size() + n;
+			}, homeQueue);
+		}
+		const uint64_t time = measureElapsedTime([&dispatcher, &homeQueue, &text]() {
+			for(size_t i = 0; i < dispatchCount; ++i) {
+				dispatcher.dispatch(1, text, i);
+				if((i & 63) == 63) {
+					homeQueue.process();
+				}
+			}
+			homeQueue.process();
+		});
+		std::cout << "MixinAffinity: " << time << " ms (" << sum << ")" << std::endl;
+	}
+}
+
+#if defined(__linux__)
+TEST_CASE("b3, EventQueue, per datagram enqueue vs NetSender and NetReceiver")
+{
+	std::cout << std::endl << "b3, EventQueue, per datagram enqueue vs NetSender and NetReceiver" << std::endl;
+
+	struct Order
+	{
+		std::int64_t price;
+		std::int64_t quantity;
+	};
+	using Queue = eventpp::EventQueue<int, void (const Order &)>;
+
+	constexpr size_t batchCount = 1000 * 5;
+	constexpr size_t batchSize = 64;
+
+	{
+		int fds[2];
+		REQUIRE(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) == 0);
+		Queue queue;
+		std::int64_t sum = 0;
+		queue.appendListener(1, [&sum](const Order & order) {
+			sum += order.price * order.quantity;
+		});
+		const uint64_t time = measureElapsedTime([&fds, &queue]() {
+			for(size_t b = 0; b < batchCount; ++b) {
+				for(size_t i = 0; i < batchSize; ++i) {
+					const std::pair<int, Order> message { 1, Order{ static_cast<std::int64_t>(i), 2 } };
+					send(fds[0], &message, sizeof(message), 0);
+				}
+				for(size_t i = 0; i < batchSize; ++i) {
+					std::pair<int, Order> message;
+					recv(fds[1], &message, sizeof(message), 0);
+					queue.enqueue(message.first, message.second);
+				}
+				queue.process();
+			}
+		});
+		std::cout << "One datagram and one enqueue per event: " << time << " ms (" << sum << ")" << std::endl;
+		close(fds[0]);
+		close(fds[1]);
+	}
+
+	{
+		int fds[2];
+		REQUIRE(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) == 0);
+		Queue queue;
+		std::int64_t sum = 0;
+		queue.appendListener(1, [&sum](const Order & order) {
+			sum += order.price * order.quantity;
+		});
+		eventpp::NetSender<int, void (const Order &)> sender(fds[0]);
+		eventpp::NetReceiver<int, void (const Order &)> receiver(fds[1]);
+		const uint64_t time = measureElapsedTime([&sender, &receiver, &queue]() {
+			for(size_t b = 0; b < batchCount; ++b) {
+				for(size_t i = 0; i < batchSize; ++i) {
+					sender.send(1, Order{ static_cast<std::int64_t>(i), 2 });
+				}
+				sender.flush();
+				receiver.receive(queue);
+				queue.process();
+			}
+		});
+		std::cout << "NetSender and NetReceiver: " << time << " ms (" << sum << ")" << std::endl;
+		close(fds[0]);
+		close(fds[1]);
+	}
+}
+#endif
+
+TEST_CASE("b3, EventQueue, takeEvent and enqueue vs moveEventsTo")
+{
+	std::cout << std::endl << "b3, EventQueue, takeEvent and enqueue vs moveEventsTo" << std::endl;
+
+	using Queue = eventpp::EventQueue<int, void (int, int)>;
+
+	constexpr int eventCount = 1000;
+	constexpr int iterations = 1000 * 5;
+
+	{
+		Queue source;
+		Queue target;
+		for(int i = 0; i < eventCount; ++i) {
+			source.enqueue(i % 10, i);
+		}
+		Queue * from = &source;
+		Queue * to = &target;
+		const uint64_t time = measureElapsedTime([&from, &to]() {
+			Queue::QueuedEvent queuedEvent;
+			for(int i = 0; i < iterations; ++i) {
+				while(from->takeEvent(&queuedEvent)) {
+					to->enqueue(queuedEvent.event, std::get<0>(queuedEvent.arguments), std::get<1>(queuedEvent.arguments));
+				}
+				std::swap(from, to);
+			}
+		});
+		std::cout << "takeEvent and enqueue: " << time << " ms" << std::endl;
+	}
+
+	{
+		Queue source;
+		Queue target;
+		for(int i = 0; i < eventCount; ++i) {
+			source.enqueue(i % 10, i);
+		}
+		Queue * from = &source;
+		Queue * to = &target;
+		const uint64_t time = measureElapsedTime([&from, &to]() {
+			for(int i = 0; i < iterations; ++i) {
+				from->moveEventsTo(*to);
+				std::swap(from, to);
+			}
+		});
+		std::cout << "moveEventsTo: " << time << " ms" << std::endl;
+	}
+
+	{
+		Queue source;
+		Queue target;
+		for(int i = 0; i < eventCount; ++i) {
+			source.enqueue(i % 10, i);
+		}
+		Queue * from = &source;
+		Queue * to = &target;
+		const uint64_t time = measureElapsedTime([&from, &to]() {
+			for(int i = 0; i < iterations; ++i) {
+				from->moveEventsIf(*to, [](const int event, int) {
+					return event < 5;
+				});
+				std::swap(from, to);
+			}
+		});
+		std::cout << "moveEventsIf, half of the events: " << time << " ms" << std::endl;
+	}
+}
+
+TEST_CASE("b3, EventQueue, std::unordered_map listener vs WindowAggregator")
+{
+	std::cout << std::endl << "b3, EventQueue, std::unordered_map listener vs WindowAggregator" << std::endl;
+
+	struct Trade
+	{
+		int symbol;
+		std::int64_t quantity;
+	};
+	using Aggregator = eventpp::WindowAggregator<int, std::int64_t>;
+	using TradeQueue = eventpp::EventQueue<int, void (const Trade &)>;
+	using ResultQueue = eventpp::EventQueue<int, void (const Aggregator::Result &)>;
+
+	constexpr int windowCount = 20;
+	constexpr int eventCount = 1000 * 100;
+	constexpr int keyCount = 1000;
+
+	{
+		TradeQueue tradeQueue;
+		ResultQueue resultQueue;
+		std::unordered_map<int, Aggregator::Result> resultMap;
+		tradeQueue.appendListener(1, [&resultMap](const Trade & trade) {
+			Aggregator::Result & result = resultMap[trade.symbol];
+			result.value += trade.quantity;
+			++result.count;
+		});
+		std::int64_t total = 0;
+		resultQueue.appendListener(1, [&total](const Aggregator::Result & result) {
+			total += result.value;
+		});
+		const uint64_t time = measureElapsedTime([&]() {
+			for(int w = 0; w < windowCount; ++w) {
+				for(int i = 0; i < eventCount; ++i) {
+					tradeQueue.enqueue(1, Trade{ (i * 7) % keyCount, 1 });
+				}
+				tradeQueue.process();
+				for(const auto & item : resultMap) {
+					resultQueue.enqueue(1, item.second);
+				}
+				// A new map for each window.
+				std::unordered_map<int, Aggregator::Result>().swap(resultMap);
+				resultQueue.process();
+			}
+		});
+		std::cout << "std::unordered_map in listener: " << time << " ms (" << total << ")" << std::endl;
+	}
+
+	{
+		TradeQueue tradeQueue;
+		ResultQueue resultQueue;
+		eventpp::WindowOptions options;
+		options.windowSize = std::chrono::seconds(1);
+		Aggregator aggregator(options, resultQueue, 1);
+		std::int64_t total = 0;
+		resultQueue.appendListener(1, [&total](const Aggregator::Result & result) {
+			total += result.value;
+		});
+		const uint64_t time = measureElapsedTime([&]() {
+			for(int w = 0; w < windowCount; ++w) {
+				aggregator.advance(std::chrono::steady_clock::time_point(std::chrono::seconds(w)));
+				for(int i = 0; i < eventCount; ++i) {
+					tradeQueue.enqueue(1, Trade{ (i * 7) % keyCount, 1 });
+				}
+				tradeQueue.processQueueWith([&aggregator](int, const Trade & trade) {
+					aggregator.add(trade.symbol, trade.quantity);
+				});
+				aggregator.advance(std::chrono::steady_clock::time_point(std::chrono::seconds(w + 1)));
+				resultQueue.process();
+			}
+		});
+		std::cout << "WindowAggregator with processQueueWith: " << time << " ms (" << total << ")" << std::endl;
+	}
+}
+
+TEST_CASE("b3, EventQueue, fixed consumers vs ConsumerPool")
+{
+	std::cout << std::endl << "b3, EventQueue, fixed consumers vs ConsumerPool" << std::endl;
+
+	struct CountedPolicies {
+		using QueueCapacity = eventpp::QueueCapacityLimited;
+	};
+	using EQ = eventpp::EventQueue<int, void (int), CountedPolicies>;
+	constexpr int burstCount = 10;
+	constexpr int burstSize = 400;
+
+	// The listener waits as for I/O, the bursts come every 20 ms.
+	auto doExecute = [](const char * message, const std::size_t minConsumerCount, const std::size_t maxConsumerCount) {
+		EQ queue;
+		std::atomic<int> count(0);
+		queue.appendListener(1, [&count](int) {
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+			count.fetch_add(1, std::memory_order_relaxed);
+		});
+		eventpp::ConsumerPoolOptions options;
+		options.minConsumerCount = minConsumerCount;
+		options.maxConsumerCount = maxConsumerCount;
+		options.controlInterval = std::chrono::milliseconds(2);
+		options.scaleUpDepth = 32;
+		eventpp::ConsumerPool<EQ> pool(queue, options);
+		pool.start();
+		const uint64_t time = measureElapsedTime([&queue, &count]() {
+			for(int burst = 0; burst < burstCount; ++burst) {
+				for(int i = 0; i < burstSize; ++i) {
+					queue.enqueue(1, i);
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			}
+			while(count.load(std::memory_order_relaxed) < burstCount * burstSize) {
+				std::this_thread::yield();
+			}
+		});
+		pool.stop();
+		const eventpp::ConsumerPoolStats stats = pool.getStats();
+		std::cout << message << ": " << time << " ms, scaled up " << stats.scaleUpCount
+			<< " times, scaled down " << stats.scaleDownCount << " times" << std::endl;
+	};
+	doExecute("1 fixed consumer", 1, 1);
+	doExecute("ConsumerPool, 1 to 8 consumers", 1, 8);
+}
+
+TEST_CASE("b3, EventQueue, hashed producers vs QueueGroup")
+{
+	std::cout << std::endl << "b3, EventQueue, hashed producers vs QueueGroup" << std::endl;
+
+	struct CountedPolicies {
+		using QueueCapacity = eventpp::QueueCapacityLimited;
+	};
+	using EQ = eventpp::EventQueue<int, void (int), CountedPolicies>;
+	constexpr int queueCount = 4;
+	constexpr int roundCount = 1000 * 200;
+	constexpr int eventCountPerRound = 4;
+
+	// Each round the producer enqueues 4 events, a quarter of them of one
+	// hot source, and each consumer processes one event of its queue.
+	auto doExecute = [](const char * message, const bool useGroup) {
+		EQ queueList[queueCount];
+		eventpp::QueueGroup<EQ> group;
+		for(EQ & queue : queueList) {
+			group.add(queue);
+			queue.appendListener(1, [](int) {});
+		}
+		std::size_t maxDepth = 0;
+		int drainRoundCount = 0;
+		const uint64_t time = measureElapsedTime([&]() {
+			for(int round = 0; round < roundCount; ++round) {
+				for(int i = 0; i < eventCountPerRound; ++i) {
+					const int source = (i == 0 ? 0 : round * eventCountPerRound + i);
+					if(useGroup) {
+						group.enqueue(1, source);
+					}
+					else {
+						group.getQueue(group.getKeyedIndex(source)).enqueue(1, source);
+					}
+				}
+				for(EQ & queue : queueList) {
+					queue.processOne();
+				}
+			}
+			for(EQ & queue : queueList) {
+				maxDepth = (std::max)(maxDepth, queue.getQueuedEventCount());
+			}
+			for(;;) {
+				bool processed = false;
+				for(EQ & queue : queueList) {
+					processed = queue.processOne() || processed;
+				}
+				if(! processed) {
+					break;
+				}
+				++drainRoundCount;
+			}
+		});
+		std::cout << message << ": " << time << " ms, deepest queue " << maxDepth
+			<< ", " << drainRoundCount << " rounds to drain" << std::endl;
+	};
+	doExecute("Hashed", false);
+	doExecute("QueueGroup, power of two choices", true);
+}
+
+TEST_CASE("b3, EventQueue, producers into one locked queue vs MergedQueue")
+{
+	std::cout << std::endl << "b3, EventQueue, producers into one locked queue vs MergedQueue" << std::endl;
+
+	using EQ = eventpp::EventQueue<int, void (int, int)>;
+	using MQ = eventpp::MergedQueue<int, void (int, int)>;
+	constexpr int producerCount = 4;
+	constexpr int eventCountPerProducer = 1000 * 250;
+	constexpr int totalCount = producerCount * eventCountPerProducer;
+
+	// Both dispatch the events of all the producers in one global order,
+	// the order of the lock or of the stamps.
+	auto doExecute = [](const char * message, const bool useMerged) {
+		EQ queue;
+		MQ mergedQueue(producerCount, 4096);
+		int dispatchedCount = 0;
+		queue.appendListener(1, [&dispatchedCount](int, int) {
+			++dispatchedCount;
+		});
+		mergedQueue.appendListener(1, [&dispatchedCount](int, int) {
+			++dispatchedCount;
+		});
+
+		const uint64_t time = measureElapsedTime([&]() {
+			std::vector<std::thread> threadList;
+			for(int producer = 0; producer < producerCount; ++producer) {
+				threadList.emplace_back([&, producer]() {
+					for(int i = 0; i < eventCountPerProducer; ++i) {
+						if(useMerged) {
+							while(! mergedQueue.enqueue(producer, 1, i)) {
+								std::this_thread::yield();
+							}
+						}
+						else {
+							queue.enqueue(1, i);
+						}
+					}
+				});
+			}
+			while(dispatchedCount < totalCount) {
+				if(useMerged) {
+					if(mergedQueue.waitFor(std::chrono::milliseconds(10))) {
+						mergedQueue.process();
+					}
+				}
+				else {
+					queue.waitFor(std::chrono::milliseconds(10));
+					queue.process();
+				}
+			}
+			for(auto & thread : threadList) {
+				thread.join();
+			}
+		});
+		std::cout << message << ": " << time << " ms";
+		if(useMerged) {
+			std::cout << ", " << mergedQueue.getLateEventCount() << " late events";
+		}
+		std::cout << std::endl;
+	};
+	doExecute("One EventQueue", false);
+	doExecute("MergedQueue", true);
+}
+
 TEST_CASE("b4, EventQueue, multi threads, mutex")
 {
 	std::cout << std::endl << "b4, EventQueue, multi threads, mutex" << std::endl;
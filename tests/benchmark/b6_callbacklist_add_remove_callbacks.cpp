@@ -13,16 +13,47 @@
 
 #include "test.h"
 #include "eventpp/callbacklist.h"
+#include "eventpp/internal/poolallocator_i.h"
+#include "eventpp/eventdispatcher.h"
+#include "eventpp/compacteventdispatcher.h"
+#include "eventpp/utilities/scopedremover.h"
+#include "eventpp/utilities/counterremover.h"
 
-TEST_CASE("b6, CallbackList add/remove callbacks")
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct PoolNodePolicies
 {
-	std::cout << std::endl << "b6, CallbackList add/remove callbacks" << std::endl;
+	template <typename T>
+	using NodeAllocator = eventpp::PoolAllocator<T, 4096>;
+};
+
+struct SlotMapPolicies
+{
+	using ListenerStorage = eventpp::ListenerStorageSlotMap;
+};
+
+struct ListenerGroupPolicies
+{
+	using ListenerGroups = eventpp::ListenerGroupsEnabled;
+};
 
-	using CL = eventpp::CallbackList<void ()>;
+struct SnapshotPolicies
+{
+	using ListenerStorage = eventpp::ListenerStorageSnapshot;
+};
+
+template <typename CL>
+void doAddRemoveCallbacks(const std::string & message)
+{
 	constexpr size_t callbackCount = 1000;
 	constexpr size_t iterateCount = 1000 * 100;
 	CL callbackList;
-	std::vector<CL::Handle> handleList(callbackCount);
+	std::vector<typename CL::Handle> handleList(callbackCount);
 	const uint64_t time = measureElapsedTime(
 		[callbackCount, iterateCount, &callbackList, &handleList]() {
 		for(size_t iterate = 0; iterate < iterateCount; ++iterate) {
@@ -36,10 +67,301 @@ TEST_CASE("b6, CallbackList add/remove callbacks")
 	});
 
 	std::cout
-		<< "CallbackList add/remove callbacks,"
+		<< message << ","
 		<< " callbackCount: " << callbackCount
 		<< " iterateCount: " << iterateCount
+		<< " handle size: " << sizeof(typename CL::Handle)
+		<< " time: " << time
+		<< std::endl;
+}
+
+// Each session has its listeners on several events, and removes all of them
+// when it ends, one by one, or by ScopedRemover, which uses a ListenerGroup
+// if the policies have ListenerGroupsEnabled.
+template <typename Policies, bool useRemover>
+void doRemoveSessionListeners(const std::string & message)
+{
+	using ED = eventpp::EventDispatcher<int, void (), Policies>;
+	constexpr int eventCount = 20;
+	constexpr int listenerCountPerEvent = 10;
+	constexpr size_t iterateCount = 1000 * 10;
+	ED dispatcher;
+	std::vector<typename ED::Handle> handleList(eventCount * listenerCountPerEvent);
+	uint64_t removeTime = 0;
+	const uint64_t time = measureElapsedTime(
+		[&dispatcher, &handleList, &removeTime]() {
+		for(size_t iterate = 0; iterate < iterateCount; ++iterate) {
+			eventpp::ScopedRemover<ED> remover(dispatcher);
+			for(int e = 0; e < eventCount; ++e) {
+				for(int i = 0; i < listenerCountPerEvent; ++i) {
+					if(useRemover) {
+						remover.appendListener(e, []() {});
+					}
+					else {
+						handleList[e * listenerCountPerEvent + i] = dispatcher.appendListener(e, []() {});
+					}
+				}
+			}
+			const auto removeStart = std::chrono::steady_clock::now();
+			if(useRemover) {
+				remover.reset();
+			}
+			else {
+				for(int e = 0; e < eventCount; ++e) {
+					for(int i = 0; i < listenerCountPerEvent; ++i) {
+						dispatcher.removeListener(e, handleList[e * listenerCountPerEvent + i]);
+					}
+				}
+			}
+			removeTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - removeStart).count();
+			// The group unlinks its nodes here.
+			for(int e = 0; e < eventCount; ++e) {
+				dispatcher.dispatch(e);
+			}
+		}
+	});
+
+	std::cout
+		<< message << ","
+		<< " listenerCount: " << eventCount * listenerCountPerEvent
+		<< " iterateCount: " << iterateCount
+		<< " remove time (us): " << removeTime
+		<< " total time: " << time
+		<< std::endl;
+}
+
+// A listener for each request, which is called by the reply and removed.
+template <typename Policies, bool useCounterRemover>
+void doOneShotListeners(const std::string & message)
+{
+	using ED = eventpp::EventDispatcher<int, void (int), Policies>;
+	constexpr int listenerCount = 100;
+	constexpr size_t iterateCount = 1000 * 10;
+	ED dispatcher;
+	std::vector<typename ED::Handle> handleList(listenerCount);
+	const uint64_t time = measureElapsedTime(
+		[&dispatcher, &handleList]() {
+		for(size_t iterate = 0; iterate < iterateCount; ++iterate) {
+			for(int i = 0; i < listenerCount; ++i) {
+				if(useCounterRemover) {
+					eventpp::counterRemover(dispatcher).appendListener(i, [](int) {});
+				}
+				else {
+					handleList[i] = dispatcher.appendListener(i, [](int) {});
+				}
+			}
+			for(int i = 0; i < listenerCount; ++i) {
+				dispatcher.dispatch(i, i);
+				if(! useCounterRemover) {
+					dispatcher.removeListener(i, handleList[i]);
+				}
+			}
+		}
+	});
+
+	std::cout
+		<< message << ","
+		<< " listenerCount: " << listenerCount
+		<< " iterateCount: " << iterateCount
+		<< " time: " << time
+		<< std::endl;
+}
+
+template <typename ED>
+auto doGetEventCount(const ED & dispatcher, int) -> decltype(dispatcher.getEventCount())
+{
+	return dispatcher.getEventCount();
+}
+
+// EventDispatcher never erases an event.
+template <typename ED>
+std::size_t doGetEventCount(const ED &, const long orderCount)
+{
+	return static_cast<std::size_t>(orderCount);
+}
+
+template <typename P>
+std::size_t doGetMapValueSize(const eventpp::EventDispatcher<int, void (int), P> &)
+{
+	return sizeof(eventpp::CallbackList<void (int), P>);
+}
+
+template <typename ED>
+std::size_t doGetMapValueSize(const ED &)
+{
+	return sizeof(std::shared_ptr<void>);
+}
+
+// Each order ID is an event with one listener, removed when the order is
+// done. EventDispatcher keeps a CallbackList for each ID ever seen.
+template <typename ED>
+void doOrderListeners(const std::string & message)
+{
+	constexpr int orderCount = 1000 * 100;
+	constexpr int liveCount = 100;
+	ED dispatcher;
+	std::vector<typename ED::Handle> handleList(orderCount);
+	const uint64_t time = measureElapsedTime(
+		[&dispatcher, &handleList]() {
+		for(int order = 0; order < orderCount; ++order) {
+			handleList[order] = dispatcher.appendListener(order, [](int) {});
+			dispatcher.dispatch(order, order);
+			if(order >= liveCount) {
+				dispatcher.removeListener(order - liveCount, handleList[order - liveCount]);
+			}
+		}
+	});
+
+	std::cout
+		<< message << ","
+		<< " orderCount: " << orderCount
+		<< " live listeners: " << liveCount
+		<< " map value size: " << doGetMapValueSize(dispatcher)
+		<< " events in the map: " << doGetEventCount(dispatcher, orderCount)
+		<< " time: " << time
+		<< std::endl;
+}
+
+// Registers the plugins with priorities at startup. Without the priority
+// index, each one walks the list with forEachIf to find the first listener
+// of a lower priority, then inserts before it.
+template <bool usePriority>
+void doPrioritizedListeners(const std::string & message)
+{
+	constexpr int listenerCount = 1000 * 5;
+	using CL = eventpp::CallbackList<void (int)>;
+	CL callbackList;
+	// The priorities of the listeners in the list order, for the walk.
+	std::vector<int> priorityList;
+	const uint64_t time = measureElapsedTime(
+		[&callbackList, &priorityList]() {
+		for(int i = 0; i < listenerCount; ++i) {
+			const int priority = (i * 7919) % 101;
+			if(usePriority) {
+				callbackList.append([](int) {}, priority);
+			}
+			else {
+				CL::Handle before;
+				std::size_t index = 0;
+				callbackList.forEachIf([&before, &index, &priorityList, priority](const CL::Handle & handle, CL::Callback &) -> bool {
+					if(priorityList[index] < priority) {
+						before = handle;
+						return false;
+					}
+					++index;
+					return true;
+				});
+				priorityList.insert(priorityList.begin() + static_cast<std::ptrdiff_t>(index), priority);
+				callbackList.insert([](int) {}, before);
+			}
+		}
+	});
+
+	std::cout
+		<< message << ","
+		<< " listenerCount: " << listenerCount
+		<< " time: " << time
+		<< std::endl;
+}
+
+// Registers the listeners of the plugins at startup, listenerCount
+// listeners over eventCount events, the listeners of an event together.
+template <typename ED, bool useBulk>
+void doStartupListeners(const std::string & message)
+{
+	constexpr int eventCount = 1000;
+	constexpr int listenerCount = 1000 * 300;
+	std::vector<std::pair<int, typename ED::Callback> > itemList;
+	itemList.reserve(listenerCount);
+	for(int i = 0; i < listenerCount; ++i) {
+		itemList.emplace_back(i / (listenerCount / eventCount), [](int) {});
+	}
+
+	ED dispatcher;
+	std::vector<typename ED::Handle> handleList;
+	handleList.reserve(listenerCount);
+	const uint64_t time = measureElapsedTime(
+		[&dispatcher, &itemList, &handleList]() {
+		if(useBulk) {
+			dispatcher.appendListeners(itemList.begin(), itemList.end(), std::back_inserter(handleList));
+		}
+		else {
+			for(const auto & item : itemList) {
+				handleList.push_back(dispatcher.appendListener(item.first, item.second));
+			}
+		}
+	});
+
+	std::cout
+		<< message << ","
+		<< " listenerCount: " << listenerCount
+		<< " eventCount: " << eventCount
 		<< " time: " << time
 		<< std::endl;
 }
 
+} //unnamed namespace
+
+TEST_CASE("b6, CallbackList add/remove callbacks")
+{
+	std::cout << std::endl << "b6, CallbackList add/remove callbacks" << std::endl;
+
+	doAddRemoveCallbacks<eventpp::CallbackList<void ()> >("CallbackList add/remove callbacks");
+	// OPT-40: the nodes and their control blocks come from a pool.
+	doAddRemoveCallbacks<eventpp::CallbackList<void (), PoolNodePolicies> >("CallbackList add/remove callbacks, PoolAllocator nodes");
+	// OPT-61: the slots are reused, a handle is an index and a generation.
+	doAddRemoveCallbacks<eventpp::CallbackList<void (), SlotMapPolicies> >("CallbackList add/remove callbacks, slot map");
+}
+
+
+TEST_CASE("b6, remove the listeners of a session")
+{
+	std::cout << std::endl << "b6, remove the listeners of a session" << std::endl;
+
+	doRemoveSessionListeners<eventpp::DefaultPolicies, false>("removeListener for each handle");
+	doRemoveSessionListeners<eventpp::DefaultPolicies, true>("ScopedRemover, removes each handle");
+	// OPT-47: one store to the ListenerGroup.
+	doRemoveSessionListeners<ListenerGroupPolicies, true>("ScopedRemover with ListenerGroup");
+}
+
+TEST_CASE("b6, one shot listeners")
+{
+	std::cout << std::endl << "b6, one shot listeners" << std::endl;
+
+	doOneShotListeners<eventpp::DefaultPolicies, false>("appendListener, dispatch, removeListener");
+	doOneShotListeners<eventpp::DefaultPolicies, true>("CounterRemover, triggerCount 1");
+	// OPT-48: disarmed with one exchange, removed by its group.
+	doOneShotListeners<ListenerGroupPolicies, true>("CounterRemover, triggerCount 1, ListenerGroup");
+}
+
+TEST_CASE("b6, one event for each order ID")
+{
+	std::cout << std::endl << "b6, one event for each order ID" << std::endl;
+
+	doOrderListeners<eventpp::EventDispatcher<int, void (int)> >("EventDispatcher");
+	// OPT-62: the empty events are erased, the lists have no mutex of their own.
+	doOrderListeners<eventpp::CompactEventDispatcher<int, void (int)> >("CompactEventDispatcher");
+}
+
+TEST_CASE("b6, prioritized listeners")
+{
+	std::cout << std::endl << "b6, prioritized listeners" << std::endl;
+
+	doPrioritizedListeners<false>("forEachIf to find the place, then insert");
+	// OPT-76: the place is found in the priority index.
+	doPrioritizedListeners<true>("append with priority");
+}
+
+TEST_CASE("b6, startup listeners")
+{
+	std::cout << std::endl << "b6, startup listeners" << std::endl;
+
+	using ED = eventpp::EventDispatcher<int, void (int)>;
+	using SnapshotED = eventpp::EventDispatcher<int, void (int), SnapshotPolicies>;
+	doStartupListeners<ED, false>("appendListener for each listener");
+	// OPT-87: one lock and one lookup for the listeners of an event.
+	doStartupListeners<ED, true>("appendListeners");
+	doStartupListeners<SnapshotED, false>("appendListener for each listener, snapshot");
+	// OPT-87: one snapshot for the listeners of an event, instead of one for each.
+	doStartupListeners<SnapshotED, true>("appendListeners, snapshot");
+}
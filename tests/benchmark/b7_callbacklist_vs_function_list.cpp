@@ -13,8 +13,10 @@
 
 #include "test.h"
 #include "eventpp/callbacklist.h"
+#include "eventpp/utilities/inplacefunction.h"
 
 #include <functional>
+#include <string>
 #include <vector>
 
 namespace {
@@ -173,3 +175,169 @@ TEST_CASE("b7, CallbackList vs vector of functions")
 	}
 	
 }
+
+TEST_CASE("b7, CallbackList, std::function vs InplaceFunction")
+{
+	std::cout << std::endl << "b7, CallbackList, std::function vs InplaceFunction" << std::endl;
+
+	struct PoliciesStdFunction {
+		using Threading = eventpp::SingleThreading;
+	};
+	struct PoliciesInplaceFunction {
+		using Threading = eventpp::SingleThreading;
+		using Callback = eventpp::InplaceFunction<void (int, int), 48>;
+	};
+
+	// 32 bytes of captures, larger than the small buffer of std::function.
+	struct Captured {
+		int64_t a, b, c, d;
+	};
+	const Captured captured { 1, 2, 3, 4 };
+	auto makeCallback = [captured]() {
+		return [captured](int a, const int b) {
+			globalValue += a + b + static_cast<int>(captured.a + captured.d);
+		};
+	};
+
+	constexpr int callbackCount = 100;
+	constexpr int appendCount = 1000;
+	constexpr int iterateCount = 1000 * 1000;
+
+	CLT<PoliciesStdFunction> stdFunctionList;
+	CLT<PoliciesInplaceFunction> inplaceFunctionList;
+	const uint64_t timeAppendStd = measureElapsedTime([&stdFunctionList, &makeCallback]() {
+		for(int i = 0; i < appendCount; ++i) {
+			CLT<PoliciesStdFunction> callbackList;
+			for(int k = 0; k < callbackCount; ++k) {
+				callbackList.append(makeCallback());
+			}
+			if(i == 0) {
+				stdFunctionList = callbackList;
+			}
+		}
+	});
+	const uint64_t timeAppendInplace = measureElapsedTime([&inplaceFunctionList, &makeCallback]() {
+		for(int i = 0; i < appendCount; ++i) {
+			CLT<PoliciesInplaceFunction> callbackList;
+			for(int k = 0; k < callbackCount; ++k) {
+				callbackList.append(makeCallback());
+			}
+			if(i == 0) {
+				inplaceFunctionList = callbackList;
+			}
+		}
+	});
+
+	const uint64_t timeInvokeStd = measureElapsedTime([&stdFunctionList]() {
+		for(int iterate = 0; iterate < iterateCount; ++iterate) {
+			stdFunctionList(iterate, iterate);
+		}
+	});
+	const uint64_t timeInvokeInplace = measureElapsedTime([&inplaceFunctionList]() {
+		for(int iterate = 0; iterate < iterateCount; ++iterate) {
+			inplaceFunctionList(iterate, iterate);
+		}
+	});
+
+	std::cout << "Append, std::function " << timeAppendStd << std::endl;
+	std::cout << "Append, InplaceFunction " << timeAppendInplace << std::endl;
+	std::cout << "Invoke, std::function " << timeInvokeStd << std::endl;
+	std::cout << "Invoke, InplaceFunction " << timeInvokeInplace << std::endl;
+}
+
+TEST_CASE("b7, CallbackList, Reentrancy")
+{
+	std::cout << std::endl << "b7, CallbackList, Reentrancy" << std::endl;
+
+	struct PoliciesFull {
+	};
+	struct PoliciesAppendOnlyOutsideDispatch {
+		using Reentrancy = eventpp::ReentrancyAppendOnlyOutsideDispatch;
+	};
+	struct PoliciesNone {
+		using Reentrancy = eventpp::ReentrancyNone;
+	};
+
+	constexpr int callbackCount = 100;
+	constexpr int iterateCount = 1000 * 1000;
+
+	CLT<PoliciesFull> fullList;
+	CLT<PoliciesAppendOnlyOutsideDispatch> appendOnlyList;
+	CLT<PoliciesNone> noneList;
+	for(int i = 0; i < callbackCount; ++i) {
+		fullList.append(&globalFunction);
+		appendOnlyList.append(&globalFunction);
+		noneList.append(&globalFunction);
+	}
+
+	const uint64_t timeFull = measureElapsedTime([&fullList]() {
+		for(int iterate = 0; iterate < iterateCount; ++iterate) {
+			fullList(iterate, iterate);
+		}
+	});
+	const uint64_t timeAppendOnly = measureElapsedTime([&appendOnlyList]() {
+		for(int iterate = 0; iterate < iterateCount; ++iterate) {
+			appendOnlyList(iterate, iterate);
+		}
+	});
+	const uint64_t timeNone = measureElapsedTime([&noneList]() {
+		for(int iterate = 0; iterate < iterateCount; ++iterate) {
+			noneList(iterate, iterate);
+		}
+	});
+
+	std::cout << "Invoke, ReentrancyFull " << timeFull << std::endl;
+	std::cout << "Invoke, ReentrancyAppendOnlyOutsideDispatch " << timeAppendOnly << std::endl;
+	std::cout << "Invoke, ReentrancyNone " << timeNone << std::endl;
+}
+
+TEST_CASE("b7, CallbackList, ArgumentFanOut")
+{
+	std::cout << std::endl << "b7, CallbackList, ArgumentFanOut" << std::endl;
+
+	struct PoliciesShared {
+		using ArgumentFanOut = eventpp::ArgumentFanOutShared;
+	};
+	struct PoliciesMoveLast {
+		using ArgumentFanOut = eventpp::ArgumentFanOutMoveLast;
+	};
+
+	using Prototype = void (std::string, std::vector<int>);
+	constexpr int callbackCount = 8;
+	constexpr int iterateCount = 1000 * 200;
+
+	const auto callback = [](const std::string & text, const std::vector<int> & valueList) {
+		globalValue += static_cast<int>(text.size() + valueList.size());
+	};
+	eventpp::CallbackList<Prototype> copyList;
+	eventpp::CallbackList<Prototype, PoliciesShared> sharedList;
+	eventpp::CallbackList<Prototype, PoliciesMoveLast> moveLastList;
+	for(int i = 0; i < callbackCount; ++i) {
+		copyList.append(callback);
+		sharedList.append(callback);
+		moveLastList.append(callback);
+	}
+
+	// Too long for the small string optimization.
+	const std::string text(64, 'a');
+	const std::vector<int> valueList(16);
+	const uint64_t timeCopy = measureElapsedTime([&]() {
+		for(int iterate = 0; iterate < iterateCount; ++iterate) {
+			copyList(text, valueList);
+		}
+	});
+	const uint64_t timeShared = measureElapsedTime([&]() {
+		for(int iterate = 0; iterate < iterateCount; ++iterate) {
+			sharedList(text, valueList);
+		}
+	});
+	const uint64_t timeMoveLast = measureElapsedTime([&]() {
+		for(int iterate = 0; iterate < iterateCount; ++iterate) {
+			moveLastList(text, valueList);
+		}
+	});
+
+	std::cout << "Invoke 8 listeners by const reference, ArgumentFanOutCopy " << timeCopy << std::endl;
+	std::cout << "Invoke 8 listeners by const reference, ArgumentFanOutShared " << timeShared << std::endl;
+	std::cout << "Invoke 8 listeners by const reference, ArgumentFanOutMoveLast " << timeMoveLast << std::endl;
+}
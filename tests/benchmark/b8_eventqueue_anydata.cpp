@@ -14,8 +14,15 @@
 #include "test.h"
 #include "eventpp/eventqueue.h"
 #include "eventpp/utilities/anydata.h"
+#include "eventpp/utilities/argumentadapter.h"
+#include "eventpp/utilities/intrusiveptr.h"
+#include "eventpp/utilities/lazypayload.h"
+#include "eventpp/mixins/mixinfilter.h"
 
+#include <cstring>
+#include <string>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
 namespace {
@@ -92,7 +99,7 @@ void doExecuteEventQueue(
 	;
 }
 
-template <typename A, typename B>
+template <typename A, typename B, typename LargeStorage = eventpp::AnyDataLargeHeap>
 void doExecuteEventQueueWithAnyData(
 		const std::string & message,
 		const size_t queueSize,
@@ -102,7 +109,7 @@ void doExecuteEventQueueWithAnyData(
 	)
 {
 	constexpr std::size_t maxSize = sizeof(EventB) * 2;
-	using Data = eventpp::AnyData<maxSize>;
+	using Data = eventpp::AnyData<maxSize, LargeStorage>;
 	using EQ = eventpp::EventQueue<size_t, void (const Data &)>;
 	EQ eventQueue;
 	
@@ -141,6 +148,311 @@ void doExecuteEventQueueWithAnyData(
 	;
 }
 
+template <typename A, typename Data, typename QueueList>
+void doFanOut(QueueList & queueList, std::true_type)
+{
+	const Data data { A() };
+	for(auto & eventQueue : queueList) {
+		eventQueue.enqueue(0, data);
+	}
+}
+
+template <typename A, typename Data, typename QueueList>
+void doFanOut(QueueList & queueList, std::false_type)
+{
+	const A a {};
+	for(auto & eventQueue : queueList) {
+		eventQueue.enqueue(0, a);
+	}
+}
+
+// Each event is enqueued to queueCount queues. Without sharing, each
+// queue gets its own copy of the payload, with AnyDataLargeSharedPool the
+// queues share one payload.
+template <typename A, bool share>
+void doExecuteFanOutWithAnyData(
+		const std::string & message,
+		const size_t queueSize,
+		const size_t iterateCount,
+		const size_t queueCount
+	)
+{
+	constexpr std::size_t maxSize = sizeof(EventB) * 2;
+	using Data = eventpp::AnyData<maxSize, typename std::conditional<share,
+		eventpp::AnyDataLargeSharedPool<>, eventpp::AnyDataLargePool<> >::type>;
+	using EQ = eventpp::EventQueue<size_t, void (const Data &)>;
+	std::vector<EQ> queueList(queueCount);
+	for(auto & eventQueue : queueList) {
+		eventQueue.appendListener(0, [](const Event &) {});
+	}
+
+	const uint64_t time = measureElapsedTime([
+			queueSize,
+			iterateCount,
+			&queueList
+		]{
+		for(size_t iterate = 0; iterate < iterateCount; ++iterate) {
+			for(size_t i = 0; i < queueSize; ++i) {
+				doFanOut<A, Data>(queueList, std::integral_constant<bool, share>());
+			}
+			for(auto & eventQueue : queueList) {
+				eventQueue.process();
+			}
+		}
+	});
+
+	std::cout
+		<< message
+		<< " queueSize: " << queueSize
+		<< " iterateCount: " << iterateCount
+		<< " queueCount: " << queueCount
+		<< " Time: " << time
+		<< std::endl;
+	;
+}
+
+struct IntrusiveEvent : eventpp::IntrusiveRefCounted {
+	int type;
+};
+
+struct IntrusiveEventA : IntrusiveEvent {
+	int a;
+};
+
+template <typename A>
+eventpp::IntrusivePtr<A> doMakeEvent(std::true_type)
+{
+	return eventpp::makePooled<A>();
+}
+
+template <typename A>
+std::shared_ptr<A> doMakeEvent(std::false_type)
+{
+	return std::make_shared<A>();
+}
+
+// Each event is dispatched to listenerCount listeners which receive the
+// derived event type through argumentAdapter.
+// shared_ptr: make_shared per event, static_pointer_cast per listener.
+// IntrusivePtr: makePooled per event, the listeners borrow the reference.
+template <bool intrusive>
+void doExecuteEventQueueDerivedPointer(
+		const std::string & message,
+		const size_t queueSize,
+		const size_t iterateCount,
+		const size_t listenerCount
+	)
+{
+	using SP = typename std::conditional<intrusive,
+		eventpp::IntrusivePtr<IntrusiveEvent>, std::shared_ptr<IntrusiveEvent> >::type;
+	using Derived = typename std::conditional<intrusive,
+		const eventpp::IntrusivePtr<IntrusiveEventA> &, std::shared_ptr<IntrusiveEventA> >::type;
+	using EQ = eventpp::EventQueue<size_t, void (const SP &)>;
+	EQ eventQueue;
+
+	for(size_t i = 0; i < listenerCount; ++i) {
+		eventQueue.appendListener(0, eventpp::argumentAdapter<void (Derived)>([](Derived e) {
+			if(e->a < 0) {
+				std::cout << e->a;
+			}
+		}));
+	}
+
+	const uint64_t time = measureElapsedTime([
+			queueSize,
+			iterateCount,
+			&eventQueue
+		]{
+		for(size_t iterate = 0; iterate < iterateCount; ++iterate) {
+			for(size_t i = 0; i < queueSize; ++i) {
+				eventQueue.enqueue(0, doMakeEvent<IntrusiveEventA>(std::integral_constant<bool, intrusive>()));
+			}
+			eventQueue.process();
+		}
+	});
+
+	std::cout
+		<< message
+		<< " queueSize: " << queueSize
+		<< " iterateCount: " << iterateCount
+		<< " listenerCount: " << listenerCount
+		<< " Time: " << time
+		<< std::endl;
+	;
+}
+
+// A network message of 8 fields, the values in the byte order of the host,
+// each string is a std::uint32_t length followed by the bytes.
+struct DecodedMessage
+{
+	std::int32_t symbol;
+	double price;
+	std::int64_t quantity;
+	std::string venue;
+	std::string trader;
+	std::string comment;
+	std::int64_t timestamp;
+	std::int32_t flags;
+};
+
+using MessageSchema = eventpp::LazySchema<
+	eventpp::LazyValue<std::int32_t>,
+	eventpp::LazyValue<double>,
+	eventpp::LazyValue<std::int64_t>,
+	eventpp::LazyString,
+	eventpp::LazyString,
+	eventpp::LazyString,
+	eventpp::LazyValue<std::int64_t>,
+	eventpp::LazyValue<std::int32_t>
+>;
+using MessagePayload = eventpp::LazyPayload<MessageSchema>;
+
+template <typename T>
+void encodeValue(std::vector<std::uint8_t> & buffer, const T & value)
+{
+	const std::size_t offset = buffer.size();
+	buffer.resize(offset + sizeof(value));
+	std::memcpy(&buffer[offset], &value, sizeof(value));
+}
+
+void encodeString(std::vector<std::uint8_t> & buffer, const std::string & s)
+{
+	encodeValue(buffer, static_cast<std::uint32_t>(s.size()));
+	buffer.insert(buffer.end(), s.begin(), s.end());
+}
+
+std::vector<std::uint8_t> encodeMessage(const std::int32_t symbol)
+{
+	std::vector<std::uint8_t> buffer;
+	encodeValue(buffer, symbol);
+	encodeValue(buffer, 100.5);
+	encodeValue(buffer, std::int64_t(300));
+	encodeString(buffer, "EXCHANGE-A");
+	encodeString(buffer, "trader-account-000042");
+	encodeString(buffer, "a free text comment which is rarely read by anyone");
+	encodeValue(buffer, std::int64_t(1234567890));
+	encodeValue(buffer, std::int32_t(7));
+	return buffer;
+}
+
+// The decoding a producer does before enqueuing DecodedMessage.
+DecodedMessage decodeMessage(const std::vector<std::uint8_t> & buffer)
+{
+	DecodedMessage message;
+	std::size_t offset = 0;
+	const auto readValue = [&buffer, &offset](void * value, const std::size_t size) {
+		std::memcpy(value, &buffer[offset], size);
+		offset += size;
+	};
+	const auto readString = [&buffer, &offset, &readValue](std::string & s) {
+		std::uint32_t length;
+		readValue(&length, sizeof(length));
+		s.assign(reinterpret_cast<const char *>(&buffer[offset]), length);
+		offset += length;
+	};
+	readValue(&message.symbol, sizeof(message.symbol));
+	readValue(&message.price, sizeof(message.price));
+	readValue(&message.quantity, sizeof(message.quantity));
+	readString(message.venue);
+	readString(message.trader);
+	readString(message.comment);
+	readValue(&message.timestamp, sizeof(message.timestamp));
+	readValue(&message.flags, sizeof(message.flags));
+	return message;
+}
+
+DecodedMessage makeMessageData(const std::vector<std::uint8_t> & buffer, std::false_type)
+{
+	return decodeMessage(buffer);
+}
+
+MessagePayload makeMessageData(const std::vector<std::uint8_t> & buffer, std::true_type)
+{
+	return MessagePayload::copyFrom(buffer.data(), buffer.size());
+}
+
+std::int32_t getSymbol(const DecodedMessage & message)
+{
+	return message.symbol;
+}
+
+std::int32_t getSymbol(const MessagePayload & payload)
+{
+	return payload.get<0>();
+}
+
+double getPrice(const DecodedMessage & message)
+{
+	return message.price;
+}
+
+double getPrice(const MessagePayload & payload)
+{
+	return payload.get<1>();
+}
+
+std::int64_t getTimestamp(const DecodedMessage & message)
+{
+	return message.timestamp;
+}
+
+std::int64_t getTimestamp(const MessagePayload & payload)
+{
+	return payload.get<6>();
+}
+
+struct FilterPolicies
+{
+	using Mixins = eventpp::MixinList<eventpp::MixinFilter>;
+};
+
+// Half of the messages are dropped by a filter which reads the symbol, the
+// listener reads the price and the timestamp.
+template <bool lazy>
+void doExecuteLazyPayload(
+		const std::string & message,
+		const size_t queueSize,
+		const size_t iterateCount
+	)
+{
+	using Data = typename std::conditional<lazy, MessagePayload, DecodedMessage>::type;
+	eventpp::EventQueue<size_t, void (const Data &), FilterPolicies> eventQueue;
+
+	eventQueue.appendFilter([](const Data & data) -> bool {
+		return getSymbol(data) % 2 == 0;
+	});
+	double total = 0;
+	eventQueue.appendListener(0, [&total](const Data & data) {
+		total += getPrice(data) + static_cast<double>(getTimestamp(data));
+	});
+
+	std::vector<std::vector<std::uint8_t> > bufferList;
+	for(size_t i = 0; i < queueSize; ++i) {
+		bufferList.push_back(encodeMessage(static_cast<std::int32_t>(i)));
+	}
+
+	const uint64_t time = measureElapsedTime([
+			iterateCount,
+			&eventQueue,
+			&bufferList
+		]{
+		for(size_t iterate = 0; iterate < iterateCount; ++iterate) {
+			for(const auto & buffer : bufferList) {
+				eventQueue.enqueue(0, makeMessageData(buffer, std::integral_constant<bool, lazy>()));
+			}
+			eventQueue.process();
+		}
+	});
+
+	std::cout
+		<< message
+		<< " queueSize: " << queueSize
+		<< " iterateCount: " << iterateCount
+		<< " Time: " << time
+		<< (total < 0 ? " " : "")
+		<< std::endl;
+	;
+}
 
 } //unnamed namespace
 
@@ -152,5 +464,27 @@ TEST_CASE("b8, EventQueue, AnyData")
 	doExecuteEventQueueWithAnyData<EventA, EventB>("With AnyData, small data", 100, 1000 * 100, 100);
 	doExecuteEventQueue<LargeEventA, LargeEventB>("Without AnyData, large data", 100, 1000 * 100, 100);
 	doExecuteEventQueueWithAnyData<LargeEventA, LargeEventB>("With AnyData, large data", 100, 1000 * 100, 100);
+	// OPT-41: the large data comes from the size class pools.
+	doExecuteEventQueueWithAnyData<LargeEventA, LargeEventB, eventpp::AnyDataLargePool<> >("With AnyData, large data, AnyDataLargePool", 100, 1000 * 100, 100);
+	doExecuteFanOutWithAnyData<LargeEventA, false>("With AnyData, large data to 4 queues, copied", 100, 1000 * 25, 4);
+	doExecuteFanOutWithAnyData<LargeEventA, true>("With AnyData, large data to 4 queues, AnyDataLargeSharedPool", 100, 1000 * 25, 4);
+}
+
+
+TEST_CASE("b8, EventQueue, IntrusivePtr")
+{
+	std::cout << std::endl << "b8, EventQueue, IntrusivePtr" << std::endl;
+
+	// OPT-70
+	doExecuteEventQueueDerivedPointer<false>("std::shared_ptr, make_shared", 100, 1000 * 20, 4);
+	doExecuteEventQueueDerivedPointer<true>("IntrusivePtr, makePooled", 100, 1000 * 20, 4);
 }
 
+TEST_CASE("b8, EventQueue, decoded message vs LazyPayload")
+{
+	std::cout << std::endl << "b8, EventQueue, decoded message vs LazyPayload" << std::endl;
+
+	// OPT-80
+	doExecuteLazyPayload<false>("Decoded by the producer", 100, 1000 * 20);
+	doExecuteLazyPayload<true>("LazyPayload", 100, 1000 * 20);
+}
@@ -11,11 +11,19 @@
  * - OPT-6: Cache-line alignment
  * - OPT-7: Memory order optimization (seq_cst -> acq_rel)
  * - OPT-8: waitFor adaptive spin (Spin -> Yield -> Sleep)
+ * - OPT-17: RingEventQueue lock-free ring buffer vs std::list backends
+ * - OPT-20: NodePool per-thread magazines vs shared free list only
+ * - OPT-84: Many EventQueue instantiations, code size and i-cache misses
  *
  * Measurement methodology:
  * - Throughput: messages / publish_time (producer-side only)
  * - Latency: publish_time / messages (average per-message enqueue time)
  * - Does NOT include consumer processing time
+ * - Multi-producer section (OPT-17): 1~16 producers + 1 consumer thread,
+ *   throughput = messages / time until the consumer has processed all of them
+ * - Many-instantiation section (OPT-84): the same events dispatched through
+ *   32 queues of one type or of 32 types, enqueue + process per event, with
+ *   the L1 instruction cache misses per event when perf is available
  *
  * Statistical method:
  * - Multiple rounds per scenario
@@ -27,9 +35,11 @@
  *   ./benchmark/b9_raw_benchmark
  */
 
+#include "bench_perf_counters.hpp"
 #include "bench_utils.hpp"
 
 #include <eventpp/eventqueue.h>
+#include <eventpp/ringeventqueue.h>
 #include <eventpp/internal/poolallocator_i.h>
 
 #include <algorithm>
@@ -41,6 +51,8 @@
 #include <new>
 #include <numeric>
 #include <thread>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 using namespace std::chrono;
@@ -132,6 +144,13 @@ struct PoolQueueListPolicies {
   using QueueList = eventpp::PoolQueueList<T, 8192>;
 };
 
+// OPT-20: Same pool without thread magazines, every allocate/deallocate
+// goes to the shared tagged free list.
+struct SharedPoolQueueListPolicies {
+  template <typename T>
+  using QueueList = eventpp::PoolQueueList<T, 8192, 0>;
+};
+
 // ============================================================================
 // Generic Benchmark Function (works with any EventQueue policy)
 // ============================================================================
@@ -173,6 +192,7 @@ BenchmarkResult benchmark_eventpp_queue(uint32_t message_count) {
 // Queue type aliases
 using RawQueue = eventpp::EventQueue<int, void(const TestMessage&)>;
 using PoolQueue = eventpp::EventQueue<int, void(const TestMessage&), PoolQueueListPolicies>;
+using SharedPoolQueue = eventpp::EventQueue<int, void(const TestMessage&), SharedPoolQueueListPolicies>;
 
 // ============================================================================
 // Active Object style benchmark (with shared_ptr overhead)
@@ -221,6 +241,219 @@ BenchmarkResult benchmark_eventpp_with_shared_ptr(uint32_t message_count) {
   return result;
 }
 
+// ============================================================================
+// Multi-Producer Benchmark (OPT-17)
+// ============================================================================
+
+struct RingQueuePolicies {
+  using RingCapacity = std::integral_constant<std::size_t, 65536>;
+};
+
+struct SpscRingQueuePolicies {
+  using RingCapacity = std::integral_constant<std::size_t, 65536>;
+  using RingProducer = eventpp::RingProducerSingle;
+};
+
+using RingQueue = eventpp::RingEventQueue<int, void(const TestMessage&), RingQueuePolicies>;
+using SpscRingQueue = eventpp::RingEventQueue<int, void(const TestMessage&), SpscRingQueuePolicies>;
+
+template <typename QueueType>
+BenchmarkResult benchmark_multi_producer(uint32_t producer_count, uint32_t messages_per_producer) {
+  QueueType queue;
+
+  const uint64_t total = static_cast<uint64_t>(producer_count) * messages_per_producer;
+  const uint32_t core_count = std::max(1U, std::thread::hardware_concurrency());
+  std::atomic<uint64_t> processed{0};
+  std::atomic<bool> go{false};
+
+  queue.appendListener(1, [&processed](const TestMessage& msg) {
+    processed.fetch_add(1, std::memory_order_relaxed);
+    (void)msg;
+  });
+
+  std::thread consumer([&]() {
+    bench::pin_thread_to_core(0);
+    while (processed.load(std::memory_order_relaxed) < total) {
+      if (queue.waitFor(milliseconds(10))) {
+        queue.process();
+      }
+    }
+  });
+
+  std::vector<std::thread> producers;
+  producers.reserve(producer_count);
+  for (uint32_t p = 0U; p < producer_count; ++p) {
+    producers.emplace_back([&, p]() {
+      bench::pin_thread_to_core((p + 1U) % core_count);
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      for (uint32_t i = 0; i < messages_per_producer; ++i) {
+        float fi = static_cast<float>(i);
+        queue.enqueue(1, TestMessage(i, fi, fi * 2, fi * 3, fi * 4));
+      }
+    });
+  }
+
+  auto start = high_resolution_clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& t : producers) {
+    t.join();
+  }
+  consumer.join();
+  auto end = high_resolution_clock::now();
+
+  auto duration = duration_cast<nanoseconds>(end - start);
+
+  BenchmarkResult result;
+  result.messages_sent = total;
+  result.messages_processed = processed.load();
+  result.total_time_us = static_cast<double>(duration.count()) / 1000.0;
+  result.throughput_mps = (static_cast<double>(total) / static_cast<double>(duration.count())) * 1000.0;
+  result.avg_latency_ns = static_cast<double>(duration.count()) / static_cast<double>(total);
+
+  return result;
+}
+
+template <typename QueueType>
+void run_multi_producer_with_stats(const char* name, uint32_t producer_count, uint32_t messages_per_producer,
+                                   uint32_t rounds) {
+  std::vector<double> throughputs;
+  throughputs.reserve(rounds);
+
+  for (uint32_t r = 0U; r < rounds; ++r) {
+    throughputs.push_back(benchmark_multi_producer<QueueType>(producer_count, messages_per_producer).throughput_mps);
+  }
+
+  Statistics tp_stats = calculate_statistics(throughputs);
+  std::printf("  %-11s %2u producers: mean %7.2f  P50 %7.2f  min %7.2f  max %7.2f M msg/s\n", name, producer_count,
+              tp_stats.mean, tp_stats.p50, tp_stats.min_val, tp_stats.max_val);
+}
+
+// ============================================================================
+// Many Instantiations (OPT-84)
+// ============================================================================
+
+// Each N is its own EventQueue type, with its own process and CallbackList
+// code, as a firmware with one queue type for each message.
+template <int N>
+struct TypedMessage {
+  uint64_t id;
+};
+
+class TypedQueueRunner {
+ public:
+  virtual ~TypedQueueRunner() {}
+  virtual void run(uint32_t count) = 0;
+  virtual uint64_t processed() const = 0;
+};
+
+template <int N>
+class TypedQueueRunnerImpl : public TypedQueueRunner {
+ public:
+  TypedQueueRunnerImpl() : queue_(), processed_(0) {
+    queue_.appendListener(1, [this](const TypedMessage<N>& msg) { processed_ += msg.id; });
+  }
+
+  void run(uint32_t count) override {
+    for (uint32_t i = 0; i < count; ++i) {
+      queue_.enqueue(1, TypedMessage<N>{1});
+    }
+    queue_.process();
+  }
+
+  uint64_t processed() const override { return processed_; }
+
+ private:
+  eventpp::EventQueue<int, void(const TypedMessage<N>&)> queue_;
+  uint64_t processed_;
+};
+
+constexpr int kTypedQueueCount = 32;
+
+// The queues have cache line aligned members, they are not allocated by
+// the global new of C++14.
+template <typename Seq>
+struct TypedRunnerSet;
+
+template <int... N>
+struct TypedRunnerSet<std::integer_sequence<int, N...>> {
+  std::tuple<TypedQueueRunnerImpl<N>...> runners;
+
+  std::vector<TypedQueueRunner*> list() {
+    return {&std::get<TypedQueueRunnerImpl<N>>(runners)...};
+  }
+};
+
+struct SameTypeRunnerSet {
+  TypedQueueRunnerImpl<0> runners[kTypedQueueCount];
+
+  std::vector<TypedQueueRunner*> list() {
+    std::vector<TypedQueueRunner*> result;
+    for (auto& runner : runners) {
+      result.push_back(&runner);
+    }
+    return result;
+  }
+};
+
+#if defined(__linux__) && defined(__GNUC__)
+// Set by the GNU linker around the code of the executable.
+extern "C" char __executable_start;
+extern "C" char etext;
+#endif
+
+void print_text_size() {
+#if defined(__linux__) && defined(__GNUC__)
+  std::printf("  Text segment of b9_raw_benchmark: %lu bytes\n",
+              static_cast<unsigned long>(&etext - &__executable_start));
+#else
+  std::printf("  Text segment: not available, use `size b9_raw_benchmark`\n");
+#endif
+}
+
+// The queues are used in turn, a few events each, so the code of all the
+// types is in the hot path of each round.
+void run_many_instantiations(const char* name, const std::vector<TypedQueueRunner*>& runners,
+                             uint32_t events_per_turn, uint32_t turns, uint32_t rounds) {
+  std::vector<bench::PerfCounterSpec> specs;
+  for (const auto& spec : bench::default_perf_counters({})) {
+    if (spec.name == "l1i-misses") {
+      specs.push_back(spec);
+    }
+  }
+  bench::PerfCounters counters(specs);
+
+  const double events = static_cast<double>(runners.size()) * events_per_turn * turns;
+  std::vector<double> latencies;
+  std::vector<double> misses;
+  for (uint32_t r = 0U; r < rounds; ++r) {
+    counters.start();
+    auto start = high_resolution_clock::now();
+    for (uint32_t t = 0U; t < turns; ++t) {
+      for (TypedQueueRunner* runner : runners) {
+        runner->run(events_per_turn);
+      }
+    }
+    auto end = high_resolution_clock::now();
+    counters.stop();
+    latencies.push_back(static_cast<double>(duration_cast<nanoseconds>(end - start).count()) / events);
+    const std::vector<double> values = counters.read();
+    if (!values.empty() && values[0] >= 0.0) {
+      misses.push_back(values[0] / events);
+    }
+  }
+
+  Statistics lat_stats = calculate_statistics(latencies);
+  std::printf("  %-9s enqueue + process: mean %6.1f  P50 %6.1f  min %6.1f ns/event", name, lat_stats.mean,
+              lat_stats.p50, lat_stats.min_val);
+  if (misses.empty()) {
+    std::printf("  l1i-misses: n/a\n");
+  } else {
+    std::printf("  l1i-misses: %.3f /event\n", calculate_statistics(misses).p50);
+  }
+}
+
 // ============================================================================
 // Multi-Round Benchmark with Statistics
 // ============================================================================
@@ -290,6 +523,9 @@ int main() {
   std::printf("  6. Cache-line alignment (anti false sharing)\n");
   std::printf("  7. Memory order acq_rel (barrier reduction)\n");
   std::printf("  8. waitFor adaptive spin (Spin -> Yield -> Sleep)\n");
+  std::printf(" 17. RingEventQueue lock-free MPSC/SPSC ring buffer\n");
+  std::printf(" 20. NodePool tagged free list + per-thread magazines\n");
+  std::printf(" 84. Batch listener code only in the queues which use it\n");
   std::printf("\nMeasurement: enqueue-only throughput & latency\n");
   std::printf("Warmup: %u rounds | Test: %u rounds\n", config::WARMUP_ROUNDS, config::TEST_ROUNDS);
 
@@ -344,6 +580,43 @@ int main() {
   run_benchmark_with_stats("SharedPtr Large", 100000U, config::TEST_ROUNDS, BenchMode::kSharedPtr);
   run_benchmark_with_stats("SharedPtr VeryLarge", 1000000U, config::TEST_ROUNDS, BenchMode::kSharedPtr);
 
+  // ========== Section 4: Multi-producer, std::list vs ring buffer ==========
+  std::printf("\n================================================================================\n");
+  std::printf("  MULTI-PRODUCER (1 consumer): std::list vs PoolQueueList (shared / magazines) vs Ring\n");
+  std::printf("================================================================================\n");
+
+  constexpr uint32_t kMessagesPerProducer = 100000U;
+  const uint32_t producer_counts[] = {1U, 2U, 4U, 8U, 16U};
+  for (uint32_t producer_count : producer_counts) {
+    run_multi_producer_with_stats<RawQueue>("List", producer_count, kMessagesPerProducer, config::TEST_ROUNDS);
+    run_multi_producer_with_stats<SharedPoolQueue>("Pool Shared", producer_count, kMessagesPerProducer,
+                                                   config::TEST_ROUNDS);
+    run_multi_producer_with_stats<PoolQueue>("Pool", producer_count, kMessagesPerProducer, config::TEST_ROUNDS);
+    run_multi_producer_with_stats<RingQueue>("Ring", producer_count, kMessagesPerProducer, config::TEST_ROUNDS);
+    if (producer_count == 1U) {
+      run_multi_producer_with_stats<SpscRingQueue>("Ring SPSC", producer_count, kMessagesPerProducer,
+                                                   config::TEST_ROUNDS);
+    }
+  }
+
+  // ========== Section 5: Many instantiations, code size and i-cache ==========
+  std::printf("\n================================================================================\n");
+  std::printf("  MANY INSTANTIATIONS (OPT-84): %d queues of one type vs %d types\n", kTypedQueueCount,
+              kTypedQueueCount);
+  std::printf("================================================================================\n");
+
+  print_text_size();
+  {
+    SameTypeRunnerSet same_set;
+    TypedRunnerSet<std::make_integer_sequence<int, kTypedQueueCount>> typed_set;
+    const std::vector<TypedQueueRunner*> same_runners = same_set.list();
+    const std::vector<TypedQueueRunner*> typed_runners = typed_set.list();
+    run_many_instantiations("1 type", same_runners, 4U, 2000U, 1U);
+    run_many_instantiations("32 types", typed_runners, 4U, 2000U, 1U);
+    run_many_instantiations("1 type", same_runners, 4U, 2000U, config::TEST_ROUNDS);
+    run_many_instantiations("32 types", typed_runners, 4U, 2000U, config::TEST_ROUNDS);
+  }
+
   std::printf("\n========================================\n");
   std::printf("   Benchmark Completed!\n");
   std::printf("========================================\n");
@@ -0,0 +1,490 @@
+/**
+ * @file bench_harness.hpp
+ * @brief Benchmark harness: warmup, repeat until stable, latency percentiles, JSON
+ *
+ * A benchmark case is a function which runs one round and returns a
+ * RoundResult, the per-operation latency samples and the wall time of the
+ * round. The harness:
+ * - Runs warmup rounds, which are discarded
+ * - Repeats the round until the relative standard deviation of the round
+ *   throughput over the last min_rounds rounds is below target_rsd,
+ *   or max_rounds is reached (the case is then reported as not stable)
+ * - Reports mean, P50, P99, P99.9 and max latency of all kept samples
+ * - Writes the results as JSON, one case per line, and compares them with
+ *   a baseline JSON written by an earlier run
+ *
+ * The per-operation samples are taken with steady_clock around each
+ * operation, the cost of the clock reads is measured once and subtracted.
+ *
+ * With --perf, the counters of bench_perf_counters.hpp are read around each
+ * measured round and reported per million operations.
+ *
+ * Usage:
+ *   bench::Harness harness(bench::parse_options(argc, argv));
+ *   harness.run(bench::Case{"enqueue/EventQueue/p1/64B", "enqueue", "EventQueue", 1, 0, 64}, [] {
+ *     bench::RoundResult round;
+ *     // ... round.samples.add(ns) for each operation ...
+ *     return round;
+ *   });
+ *   return harness.finish();
+ */
+
+#ifndef BENCH_HARNESS_HPP
+#define BENCH_HARNESS_HPP
+
+#include "bench_perf_counters.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+inline double elapsed_ns(const Clock::time_point& begin, const Clock::time_point& end) {
+  return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+}
+
+/**
+ * @brief Cost of the two clock reads around an operation, the minimum of many tries.
+ */
+inline double timer_overhead_ns() {
+  static const double overhead = [] {
+    double best = 1e9;
+    for (int i = 0; i < 10000; ++i) {
+      const auto t0 = Clock::now();
+      const auto t1 = Clock::now();
+      best = std::min(best, elapsed_ns(t0, t1));
+    }
+    return best;
+  }();
+  return overhead;
+}
+
+struct Percentiles {
+  uint64_t count;
+  double mean;
+  double p50;
+  double p99;
+  double p999;
+  double max_val;
+};
+
+/**
+ * @brief Per-operation latencies in nanoseconds.
+ */
+class LatencySamples {
+ public:
+  void reserve(size_t count) { samples_.reserve(count); }
+
+  void add(double ns) { samples_.push_back(ns); }
+
+  // Adds a sample measured with two clock reads, without the cost of the reads.
+  void add_timed(const Clock::time_point& begin, const Clock::time_point& end) {
+    samples_.push_back(std::max(0.0, elapsed_ns(begin, end) - timer_overhead_ns()));
+  }
+
+  void append(const LatencySamples& other) {
+    samples_.insert(samples_.end(), other.samples_.begin(), other.samples_.end());
+  }
+
+  size_t size() const { return samples_.size(); }
+
+  Percentiles compute() const {
+    Percentiles result{};
+    if (samples_.empty()) {
+      return result;
+    }
+
+    std::vector<double> sorted = samples_;
+    std::sort(sorted.begin(), sorted.end());
+    const size_t n = sorted.size();
+    const auto at = [&sorted, n](double fraction) {
+      return sorted[std::min(static_cast<size_t>(static_cast<double>(n) * fraction), n - 1)];
+    };
+
+    result.count = n;
+    result.mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / static_cast<double>(n);
+    result.p50 = at(0.50);
+    result.p99 = at(0.99);
+    result.p999 = at(0.999);
+    result.max_val = sorted.back();
+    return result;
+  }
+
+ private:
+  std::vector<double> samples_;
+};
+
+struct RoundResult {
+  LatencySamples samples;
+  uint64_t operations = 0;
+  double elapsed_ns = 0;
+};
+
+struct Case {
+  std::string name;
+  std::string operation;
+  std::string queue;
+  uint32_t producers;
+  uint32_t consumers;
+  uint32_t payload_bytes;
+};
+
+struct Result {
+  Case bench_case;
+  uint32_t rounds;
+  bool stable;
+  double rsd;
+  double throughput_mops;
+  Percentiles latency;
+  // Per million operations, negative if the counter is not available.
+  std::vector<double> perf_per_million;
+};
+
+struct Options {
+  uint32_t warmup_rounds = 2U;
+  uint32_t min_rounds = 5U;
+  uint32_t max_rounds = 30U;
+  double target_rsd = 0.03;
+  bool quick = false;
+  bool gate_tail = false;
+  bool perf = false;
+  std::vector<PerfCounterSpec> perf_raw;
+  double threshold = 0.10;
+  std::string filter;
+  std::string json_path;
+  std::string compare_path;
+};
+
+inline void print_usage(const char* program) {
+  std::printf(
+      "Usage: %s [options]\n"
+      "  --quick              fewer operations and rounds, for a smoke run\n"
+      "  --filter <text>      only run the cases whose name contains text\n"
+      "  --json <file>        write the results to file\n"
+      "  --compare <file>     compare with the results in file, exit with 1 on a regression\n"
+      "  --threshold <ratio>  allowed slowdown for --compare, default 0.10\n"
+      "  --gate-tail          --compare also checks P99\n"
+      "  --perf               count cache misses, HITM, branch misses and context switches\n"
+      "  --perf-raw <n=0xHEX> --perf with one more raw PMU event, can be repeated\n"
+      "  --min-rounds <n>     default 5\n"
+      "  --max-rounds <n>     default 30\n"
+      "  --rsd <ratio>        stop when the throughput RSD is below ratio, default 0.03\n",
+      program);
+}
+
+inline Options parse_options(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--quick") {
+      options.quick = true;
+      options.warmup_rounds = 1U;
+      options.min_rounds = 3U;
+      options.max_rounds = 5U;
+    } else if (arg == "--gate-tail") {
+      options.gate_tail = true;
+    } else if (arg == "--perf") {
+      options.perf = true;
+    } else if (arg == "--perf-raw" && has_value) {
+      PerfCounterSpec spec;
+      if (!parse_perf_raw(argv[++i], &spec)) {
+        std::fprintf(stderr, "Bad raw event %s, the format is name=0xHEX\n", argv[i]);
+        std::exit(2);
+      }
+      options.perf = true;
+      options.perf_raw.push_back(spec);
+    } else if (arg == "--filter" && has_value) {
+      options.filter = argv[++i];
+    } else if (arg == "--json" && has_value) {
+      options.json_path = argv[++i];
+    } else if (arg == "--compare" && has_value) {
+      options.compare_path = argv[++i];
+    } else if (arg == "--threshold" && has_value) {
+      options.threshold = std::atof(argv[++i]);
+    } else if (arg == "--min-rounds" && has_value) {
+      options.min_rounds = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+    } else if (arg == "--max-rounds" && has_value) {
+      options.max_rounds = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+    } else if (arg == "--rsd" && has_value) {
+      options.target_rsd = std::atof(argv[++i]);
+    } else {
+      print_usage(argv[0]);
+      std::exit(arg == "--help" || arg == "-h" ? 0 : 2);
+    }
+  }
+  options.max_rounds = std::max(options.max_rounds, options.min_rounds);
+  return options;
+}
+
+class Harness {
+ public:
+  explicit Harness(const Options& options) : options_(options) {
+    timer_overhead_ns();
+    if (options_.perf) {
+      perf_specs_ = default_perf_counters(options_.perf_raw);
+    }
+  }
+
+  const Options& options() const { return options_; }
+
+  template <typename RoundFn>
+  void run(const Case& bench_case, RoundFn&& round_fn) {
+    if (!options_.filter.empty() && bench_case.name.find(options_.filter) == std::string::npos) {
+      return;
+    }
+
+    for (uint32_t i = 0; i < options_.warmup_rounds; ++i) {
+      round_fn();
+    }
+
+    // Opened before the round starts its threads, so the counters follow them.
+    std::unique_ptr<PerfCounters> counters;
+    std::vector<double> perf_totals(perf_specs_.size(), 0.0);
+    uint64_t operations = 0;
+    if (options_.perf) {
+      counters.reset(new PerfCounters(perf_specs_));
+    }
+
+    LatencySamples samples;
+    std::vector<double> throughputs;
+    bool stable = false;
+    double rsd = 0;
+    while (throughputs.size() < options_.max_rounds) {
+      if (counters) {
+        counters->start();
+      }
+      RoundResult round = round_fn();
+      if (counters) {
+        counters->stop();
+        const std::vector<double> values = counters->read();
+        for (size_t i = 0; i < values.size(); ++i) {
+          perf_totals[i] = (values[i] < 0 || perf_totals[i] < 0) ? -1.0 : perf_totals[i] + values[i];
+        }
+      }
+      operations += round.operations;
+      samples.append(round.samples);
+      throughputs.push_back(round.elapsed_ns > 0
+                                ? static_cast<double>(round.operations) / round.elapsed_ns * 1000.0
+                                : 0.0);
+      if (throughputs.size() >= options_.min_rounds) {
+        rsd = relative_std_dev(throughputs.end() - options_.min_rounds, throughputs.end());
+        if (rsd <= options_.target_rsd) {
+          stable = true;
+          break;
+        }
+      }
+    }
+
+    // The median round, the rounds disturbed by the system don't move it much.
+    std::vector<double> sorted = throughputs;
+    std::sort(sorted.begin(), sorted.end());
+
+    Result result{bench_case, static_cast<uint32_t>(throughputs.size()), stable, rsd, sorted[sorted.size() / 2],
+                  samples.compute(), std::vector<double>()};
+    for (const double total : perf_totals) {
+      result.perf_per_million.push_back(total < 0 || operations == 0
+                                            ? -1.0
+                                            : total * 1e6 / static_cast<double>(operations));
+    }
+    print(result);
+    results_.push_back(result);
+  }
+
+  // Writes and compares the results, returns the exit code of the program.
+  int finish() const {
+    if (!options_.json_path.empty() && !write_json(options_.json_path)) {
+      std::fprintf(stderr, "Can't write %s\n", options_.json_path.c_str());
+      return 2;
+    }
+    if (!options_.compare_path.empty()) {
+      return compare(options_.compare_path);
+    }
+    return 0;
+  }
+
+ private:
+  template <typename Iterator>
+  static double relative_std_dev(Iterator begin, Iterator end) {
+    const double n = static_cast<double>(end - begin);
+    const double mean = std::accumulate(begin, end, 0.0) / n;
+    if (mean <= 0) {
+      return 0;
+    }
+    double sq_sum = 0.0;
+    for (Iterator it = begin; it != end; ++it) {
+      sq_sum += (*it - mean) * (*it - mean);
+    }
+    return std::sqrt(sq_sum / n) / mean;
+  }
+
+  void print(const Result& result) const {
+    std::printf("  %-44s %8.2f M op/s  P50 %8.1f  P99 %8.1f  P99.9 %9.1f  max %10.1f ns  %2u rounds%s\n",
+                result.bench_case.name.c_str(), result.throughput_mops, result.latency.p50, result.latency.p99,
+                result.latency.p999, result.latency.max_val, result.rounds, result.stable ? "" : " (unstable)");
+    if (!perf_specs_.empty()) {
+      std::printf("  %-44s per 1M op:", "");
+      for (size_t i = 0; i < perf_specs_.size(); ++i) {
+        if (result.perf_per_million[i] < 0) {
+          std::printf("  %s n/a", perf_specs_[i].name.c_str());
+        } else {
+          std::printf("  %s %.0f", perf_specs_[i].name.c_str(), result.perf_per_million[i]);
+        }
+      }
+      std::printf("\n");
+    }
+  }
+
+  static std::string compiler() {
+#if defined(__clang__)
+    return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+    return std::string("gcc ") + __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc " + std::to_string(_MSC_VER);
+#else
+    return "unknown";
+#endif
+  }
+
+  static std::string escape(const std::string& text) {
+    std::string escaped;
+    for (const char c : text) {
+      if (c == '"' || c == '\\') {
+        escaped.push_back('\\');
+      }
+      escaped.push_back(c);
+    }
+    return escaped;
+  }
+
+  bool write_json(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file) {
+      return false;
+    }
+
+    file << "{\n  \"schema\": 1,\n  \"context\": {\"compiler\": \"" << escape(compiler()) << "\", \"cplusplus\": "
+         << __cplusplus << ", \"optimized\": "
+#ifdef NDEBUG
+         << "true"
+#else
+         << "false"
+#endif
+         << ", \"hardware_concurrency\": " << std::thread::hardware_concurrency()
+         << ", \"quick\": " << (options_.quick ? "true" : "false") << "},\n  \"benchmarks\": [\n";
+
+    // One case per line, so the files can be diffed and read back without a JSON parser.
+    for (size_t i = 0; i < results_.size(); ++i) {
+      const Result& result = results_[i];
+      char numbers[512];
+      std::snprintf(numbers, sizeof(numbers),
+                    "\"rounds\": %u, \"stable\": %s, \"rsd\": %.4f, \"throughput_mops\": %.3f, \"samples\": %llu, "
+                    "\"mean_ns\": %.1f, \"p50_ns\": %.1f, \"p99_ns\": %.1f, \"p999_ns\": %.1f, \"max_ns\": %.1f",
+                    result.rounds, result.stable ? "true" : "false", result.rsd, result.throughput_mops,
+                    static_cast<unsigned long long>(result.latency.count), result.latency.mean, result.latency.p50,
+                    result.latency.p99, result.latency.p999, result.latency.max_val);
+      file << "    {\"name\": \"" << escape(result.bench_case.name) << "\", \"operation\": \""
+           << escape(result.bench_case.operation) << "\", \"queue\": \"" << escape(result.bench_case.queue)
+           << "\", \"producers\": " << result.bench_case.producers << ", \"consumers\": "
+           << result.bench_case.consumers << ", \"payload_bytes\": " << result.bench_case.payload_bytes << ", "
+           << numbers;
+      if (!perf_specs_.empty()) {
+        file << ", \"perf_per_million\": {";
+        for (size_t k = 0; k < perf_specs_.size(); ++k) {
+          file << (k > 0 ? ", " : "") << "\"" << escape(perf_specs_[k].name) << "\": ";
+          if (result.perf_per_million[k] < 0) {
+            file << "null";
+          } else {
+            file << static_cast<uint64_t>(result.perf_per_million[k] + 0.5);
+          }
+        }
+        file << "}";
+      }
+      file << "}" << (i + 1 < results_.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return static_cast<bool>(file);
+  }
+
+  static bool read_string(const std::string& line, const char* key, std::string* value) {
+    const std::string prefix = std::string("\"") + key + "\": \"";
+    const size_t begin = line.find(prefix);
+    if (begin == std::string::npos) {
+      return false;
+    }
+    const size_t end = line.find('"', begin + prefix.size());
+    *value = line.substr(begin + prefix.size(), end - begin - prefix.size());
+    return true;
+  }
+
+  static double read_number(const std::string& line, const char* key) {
+    const std::string prefix = std::string("\"") + key + "\": ";
+    const size_t begin = line.find(prefix);
+    return begin == std::string::npos ? 0.0 : std::atof(line.c_str() + begin + prefix.size());
+  }
+
+  // A regression is a lower throughput or a higher latency by more than the threshold.
+  int compare(const std::string& path) const {
+    std::ifstream file(path);
+    if (!file) {
+      std::fprintf(stderr, "Can't read %s\n", path.c_str());
+      return 2;
+    }
+
+    std::printf("\nCompared with %s (threshold %.0f%%)\n", path.c_str(), options_.threshold * 100.0);
+    int regression_count = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+      std::string name;
+      if (!read_string(line, "name", &name)) {
+        continue;
+      }
+      const auto it = std::find_if(results_.begin(), results_.end(),
+                                   [&name](const Result& result) { return result.bench_case.name == name; });
+      if (it == results_.end()) {
+        continue;
+      }
+
+      const double base_throughput = read_number(line, "throughput_mops");
+      const double base_p50 = read_number(line, "p50_ns");
+      const double base_p99 = read_number(line, "p99_ns");
+      const double throughput_change = base_throughput > 0 ? it->throughput_mops / base_throughput - 1.0 : 0.0;
+      const double p50_change = base_p50 > 0 ? it->latency.p50 / base_p50 - 1.0 : 0.0;
+      const double p99_change = base_p99 > 0 ? it->latency.p99 / base_p99 - 1.0 : 0.0;
+
+      const bool regressed = throughput_change < -options_.threshold || p50_change > options_.threshold ||
+                             (options_.gate_tail && p99_change > options_.threshold);
+      if (regressed) {
+        ++regression_count;
+      }
+      std::printf("  %-44s throughput %+6.1f%%  P50 %+6.1f%%  P99 %+6.1f%%%s\n", name.c_str(),
+                  throughput_change * 100.0, p50_change * 100.0, p99_change * 100.0,
+                  regressed ? "  REGRESSION" : "");
+    }
+    std::printf("%d regression(s)\n", regression_count);
+    return regression_count > 0 ? 1 : 0;
+  }
+
+  Options options_;
+  std::vector<PerfCounterSpec> perf_specs_;
+  std::vector<Result> results_;
+};
+
+}  // namespace bench
+
+#endif  // BENCH_HARNESS_HPP
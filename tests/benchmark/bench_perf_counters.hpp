@@ -0,0 +1,224 @@
+/**
+ * @file bench_perf_counters.hpp
+ * @brief Hardware and software counters around benchmark rounds, Linux perf_event_open
+ *
+ * Counts, for the calling thread and every thread it starts while counting:
+ * - cache-misses:     last level cache misses
+ * - l1d-misses:       L1 data cache read misses
+ * - l1i-misses:       L1 instruction cache read misses, they go up with the
+ *                     code of the hot path, such as many template instances
+ * - branch-misses
+ * - context-switches
+ * - hitm:             x86 Intel only, loads which hit a line modified in
+ *                     another core's cache, the sign of false sharing. It's
+ *                     MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM (raw 0x04d2, Skylake
+ *                     and later), other generations need --perf-raw.
+ * - bus-access:       AArch64 only, the PMUv3 common event BUS_ACCESS (0x19).
+ *                     ARM has no architectural HITM event, the bus accesses
+ *                     go up with the cache line transfers between the cores.
+ *                     The snoop events of the core, listed in its TRM (such
+ *                     as Cortex-A or Neoverse), can be given with --perf-raw.
+ *
+ * More raw events can be added as "name=0xHEX", the value is the raw config
+ * of the core's PMU (`perf list --details` shows them).
+ * A counter which can't be opened, such as without permission
+ * (/proc/sys/kernel/perf_event_paranoid) or in a VM, is reported as
+ * unavailable, the benchmark still runs. On the other systems no counter is
+ * available.
+ */
+
+#ifndef BENCH_PERF_COUNTERS_HPP
+#define BENCH_PERF_COUNTERS_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/perf_event.h>)
+#define BENCH_HAS_PERF_EVENT 1
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+#ifndef BENCH_HAS_PERF_EVENT
+#define BENCH_HAS_PERF_EVENT 0
+#endif
+
+namespace bench {
+
+struct PerfCounterSpec {
+  std::string name;
+  uint32_t type;
+  uint64_t config;
+};
+
+#if BENCH_HAS_PERF_EVENT
+constexpr uint32_t PERF_TYPE_FOR_RAW = PERF_TYPE_RAW;
+#else
+constexpr uint32_t PERF_TYPE_FOR_RAW = 4U;
+#endif
+
+/**
+ * @brief Parses "name=0xHEX" into a raw counter.
+ */
+inline bool parse_perf_raw(const std::string& text, PerfCounterSpec* spec) {
+  const size_t pos = text.find('=');
+  if (pos == 0 || pos == std::string::npos || pos + 1 == text.size()) {
+    return false;
+  }
+  char* end = nullptr;
+  const uint64_t config = std::strtoull(text.c_str() + pos + 1, &end, 0);
+  if (end == nullptr || *end != '\0') {
+    return false;
+  }
+  *spec = PerfCounterSpec{text.substr(0, pos), PERF_TYPE_FOR_RAW, config};
+  return true;
+}
+
+inline bool is_intel_cpu() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 9, "vendor_id") == 0) {
+      return line.find("GenuineIntel") != std::string::npos;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief The counters of this machine, plus the raw ones.
+ */
+inline std::vector<PerfCounterSpec> default_perf_counters(const std::vector<PerfCounterSpec>& raw) {
+  std::vector<PerfCounterSpec> specs;
+#if BENCH_HAS_PERF_EVENT
+  specs.push_back({"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES});
+  specs.push_back({"l1d-misses", PERF_TYPE_HW_CACHE,
+                   PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)});
+  specs.push_back({"l1i-misses", PERF_TYPE_HW_CACHE,
+                   PERF_COUNT_HW_CACHE_L1I | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)});
+  specs.push_back({"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES});
+  specs.push_back({"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES});
+#if defined(__x86_64__) || defined(__i386__)
+  bool has_hitm = false;
+  for (const auto& spec : raw) {
+    has_hitm = has_hitm || spec.name == "hitm";
+  }
+  if (!has_hitm && is_intel_cpu()) {
+    specs.push_back({"hitm", PERF_TYPE_RAW, 0x04d2});
+  }
+#elif defined(__aarch64__)
+  specs.push_back({"bus-access", PERF_TYPE_RAW, 0x19});
+#endif
+#endif
+  specs.insert(specs.end(), raw.begin(), raw.end());
+  return specs;
+}
+
+/**
+ * @brief A set of counters, each opened on its own because the counters
+ * which follow the new threads (inherit) can't be read as a group.
+ */
+class PerfCounters {
+ public:
+  explicit PerfCounters(const std::vector<PerfCounterSpec>& specs) : specs_(specs), fds_(specs.size(), -1) {
+#if BENCH_HAS_PERF_EVENT
+    for (size_t i = 0; i < specs_.size(); ++i) {
+      // The software events such as the context switches happen in the
+      // kernel, counting them needs perf_event_paranoid < 2.
+      const bool software = specs_[i].type == PERF_TYPE_SOFTWARE;
+      fds_[i] = open(specs_[i], !software);
+      if (fds_[i] < 0 && software) {
+        fds_[i] = open(specs_[i], true);
+      }
+    }
+#endif
+  }
+
+  ~PerfCounters() {
+#if BENCH_HAS_PERF_EVENT
+    for (const int fd : fds_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  const std::vector<PerfCounterSpec>& specs() const { return specs_; }
+
+  void start() {
+#if BENCH_HAS_PERF_EVENT
+    for (const int fd : fds_) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  void stop() {
+#if BENCH_HAS_PERF_EVENT
+    for (const int fd : fds_) {
+      if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+#endif
+  }
+
+  /**
+   * @brief The counts since start, scaled up if the PMU was multiplexed.
+   * A counter which is not available is negative.
+   */
+  std::vector<double> read() const {
+    std::vector<double> values(fds_.size(), -1.0);
+#if BENCH_HAS_PERF_EVENT
+    for (size_t i = 0; i < fds_.size(); ++i) {
+      uint64_t data[3] = {0, 0, 0};
+      if (fds_[i] < 0 || ::read(fds_[i], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) {
+        continue;
+      }
+      // data is value, time enabled, time running.
+      values[i] = data[2] == 0 ? 0.0
+                               : static_cast<double>(data[0]) * static_cast<double>(data[1]) /
+                                     static_cast<double>(data[2]);
+    }
+#endif
+    return values;
+  }
+
+ private:
+#if BENCH_HAS_PERF_EVENT
+  static int open(const PerfCounterSpec& spec, bool exclude_kernel) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = spec.type;
+    attr.config = spec.config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = exclude_kernel ? 1 : 0;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+#endif
+
+  std::vector<PerfCounterSpec> specs_;
+  std::vector<int> fds_;
+};
+
+}  // namespace bench
+
+#endif  // BENCH_PERF_COUNTERS_HPP
@@ -16,10 +16,7 @@
 
 #include <cstdint>
 
-#ifdef __linux__
-#include <pthread.h>
-#include <sched.h>
-#endif
+#include "eventpp/utilities/activeobject.h"
 
 namespace bench {
 
@@ -29,15 +26,7 @@ namespace bench {
  * @return true if successful, false if unsupported or failed
  */
 inline bool pin_thread_to_core(uint32_t core_id) {
-#ifdef __linux__
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(core_id, &cpuset);
-    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) == 0;
-#else
-    (void)core_id;
-    return false;
-#endif
+    return eventpp::pinCurrentThread({ static_cast<int>(core_id) });
 }
 
 /**
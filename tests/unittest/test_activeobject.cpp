@@ -0,0 +1,216 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/utilities/activeobject.h"
+#include "eventpp/eventqueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct BoundedPolicies
+{
+	using QueueCapacity = eventpp::QueueCapacityLimited;
+};
+
+} //unnamed namespace
+
+TEST_CASE("EventQueue, processN with processed count")
+{
+	eventpp::EventQueue<int, void (int)> queue;
+	int sum = 0;
+	queue.appendListener(1, [&sum](const int value) {
+		sum += value;
+	});
+	for(int i = 1; i <= 5; ++i) {
+		queue.enqueue(1, i);
+	}
+
+	size_t count = 99;
+	REQUIRE(queue.processN(3, &count));
+	REQUIRE(count == 3);
+	REQUIRE(sum == 6);
+	REQUIRE(queue.processN(3, &count));
+	REQUIRE(count == 2);
+	REQUIRE(! queue.processN(3, &count));
+	REQUIRE(count == 0);
+}
+
+TEST_CASE("EventQueue, waitNotFull")
+{
+	eventpp::EventQueue<int, void (int)> unbounded;
+	unbounded.enqueue(1, 1);
+	unbounded.waitNotFull();
+	REQUIRE(unbounded.waitNotFullFor(std::chrono::milliseconds(0)));
+
+	using EQ = eventpp::EventQueue<int, void (int), BoundedPolicies>;
+	EQ queue;
+	EQ::QueueLimits limits;
+	limits.maxEventCount = 2;
+	queue.setQueueLimits(limits);
+
+	queue.enqueue(1, 1);
+	REQUIRE(queue.waitNotFullFor(std::chrono::milliseconds(0)));
+	queue.enqueue(1, 2);
+	REQUIRE(! queue.waitNotFullFor(std::chrono::milliseconds(1)));
+
+	std::thread consumer([&queue]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		queue.processOne();
+	});
+	queue.waitNotFull();
+	REQUIRE(queue.getQueuedEventCount() < 2);
+	consumer.join();
+}
+
+TEST_CASE("ActiveObject, stop drains the queue")
+{
+	using EQ = eventpp::EventQueue<int, void (int)>;
+	eventpp::ActiveObjectOptions options;
+	options.batchSize = 4;
+	eventpp::ActiveObject<EQ> activeObject(options);
+
+	std::atomic<int> sum(0);
+	activeObject.getQueue().appendListener(1, [&sum](const int value) {
+		sum += value;
+	});
+
+	// The events enqueued before start are dispatched too.
+	activeObject.getQueue().enqueue(1, 1000);
+	activeObject.start();
+	REQUIRE(activeObject.isRunning());
+	for(int i = 1; i <= 100; ++i) {
+		activeObject.getQueue().enqueue(1, i);
+	}
+	activeObject.stop();
+	REQUIRE(! activeObject.isRunning());
+	REQUIRE(sum.load() == 1000 + 5050);
+	REQUIRE(activeObject.getQueue().emptyQueue());
+
+	const eventpp::ActiveObjectStats stats = activeObject.getStats();
+	REQUIRE(stats.eventCount == 101);
+	REQUIRE(stats.maxBatchSize <= 4);
+	REQUIRE(stats.batchCount >= 101 / 4);
+
+	// stop is idempotent, and the object can run again.
+	activeObject.stop();
+	activeObject.start();
+	activeObject.getQueue().enqueue(1, 1);
+	activeObject.stop();
+	REQUIRE(sum.load() == 1000 + 5050 + 1);
+}
+
+TEST_CASE("Pipeline, three stages")
+{
+	using EQ = eventpp::EventQueue<int, void (int)>;
+	eventpp::Pipeline pipeline;
+	auto & parse = pipeline.addStage<EQ>();
+	auto & transform = pipeline.addStage<EQ>();
+	auto & sink = pipeline.addStage<EQ>();
+
+	auto & parseOutput = pipeline.connect(parse, transform, 16);
+	auto & transformOutput = pipeline.connect(transform, sink);
+
+	parse.getQueue().appendListener(1, [&parseOutput](const int value) {
+		parseOutput.enqueue(1, value);
+	});
+	transform.getQueue().appendListener(1, [&transformOutput](const int value) {
+		transformOutput.enqueue(1, value * 2);
+	});
+	std::atomic<int> sum(0);
+	std::atomic<int> count(0);
+	sink.getQueue().appendListener(1, [&sum, &count](const int value) {
+		sum += value;
+		++count;
+	});
+
+	pipeline.start();
+	constexpr int eventCount = 10000;
+	for(int i = 1; i <= eventCount; ++i) {
+		parse.getQueue().enqueue(1, i);
+	}
+	pipeline.stop();
+
+	REQUIRE(count.load() == eventCount);
+	REQUIRE(sum.load() == eventCount * (eventCount + 1));
+	REQUIRE(parse.getStats().eventCount == eventCount);
+	REQUIRE(transform.getStats().eventCount == eventCount);
+	REQUIRE(sink.getStats().eventCount == eventCount);
+}
+
+TEST_CASE("Pipeline, bounded queue between stages")
+{
+	using EQ = eventpp::EventQueue<int, void (int)>;
+	using BoundedEQ = eventpp::EventQueue<int, void (int), BoundedPolicies>;
+	constexpr size_t limit = 8;
+	constexpr size_t outputBatchSize = 4;
+
+	eventpp::Pipeline pipeline;
+	eventpp::ActiveObjectOptions options;
+	options.batchSize = 2;
+	auto & fast = pipeline.addStage<EQ>(options);
+	auto & slow = pipeline.addStage<BoundedEQ>();
+
+	BoundedEQ::QueueLimits limits;
+	limits.maxEventCount = limit;
+	slow.getQueue().setQueueLimits(limits);
+
+	auto & output = pipeline.connect(fast, slow, outputBatchSize);
+	fast.getQueue().appendListener(1, [&output](const int value) {
+		output.enqueue(1, value);
+	});
+	std::atomic<int> count(0);
+	std::atomic<size_t> maxQueued(0);
+	slow.getQueue().appendListener(1, [&](int) {
+		const size_t queued = slow.getQueue().getQueuedEventCount();
+		if(queued > maxQueued.load()) {
+			maxQueued = queued;
+		}
+		++count;
+		std::this_thread::sleep_for(std::chrono::microseconds(20));
+	});
+
+	pipeline.start();
+	constexpr int eventCount = 500;
+	for(int i = 0; i < eventCount; ++i) {
+		fast.getQueue().enqueue(1, i);
+	}
+	pipeline.stop();
+
+	REQUIRE(count.load() == eventCount);
+	// The bound is checked once a batch, so it's over by at most one batch.
+	REQUIRE(maxQueued.load() <= limit + options.batchSize);
+	REQUIRE(fast.getStats().backpressureTime > 0);
+}
+
+TEST_CASE("ActiveObject, pinCurrentThread")
+{
+	REQUIRE(! eventpp::pinCurrentThread({}));
+	REQUIRE(! eventpp::pinCurrentThread({ -1 }));
+
+	eventpp::ActiveObjectOptions options;
+	options.cpuList = { 0 };
+	eventpp::ActiveObject<eventpp::EventQueue<int, void ()> > activeObject(options);
+	std::atomic<int> count(0);
+	activeObject.getQueue().appendListener(1, [&count]() {
+		++count;
+	});
+	activeObject.start();
+	activeObject.getQueue().enqueue(1);
+	activeObject.stop();
+	REQUIRE(count.load() == 1);
+}
@@ -263,4 +263,96 @@ TEST_CASE("AnyData, use Event as callback argument")
 	queue.process();
 }
 
+TEMPLATE_TEST_CASE("AnyData, AnyDataLargePool", "", DataLifeCounter, LargeDataLifeCounter)
+{
+	using Type = TestType;
+	using MyAnyData = eventpp::AnyData<sizeof(DataLifeCounter), eventpp::AnyDataLargePool<> >;
+	LifeCounter lifeCounter {};
+	{
+		MyAnyData anyData { Type { &lifeCounter } };
+		REQUIRE(anyData.isType<Type>());
+		REQUIRE(! anyData.isType<LargeDataBase>());
+		REQUIRE(lifeCounter.ctors == 1);
+		REQUIRE(isLargeAnyData(anyData) == isLargeDataBase<Type>());
+
+		MyAnyData moved(std::move(anyData));
+		REQUIRE(moved.isType<Type>());
+		REQUIRE(lifeCounter.ctors == 1 + (isLargeDataBase<Type>() ? 0 : 1));
+	}
+	REQUIRE(lifeCounter.ctors == 0);
+}
+
+TEST_CASE("AnyData, AnyDataLargePool, larger than maxPooledSize")
+{
+	struct HugeData
+	{
+		std::array<char, 8192> data;
+	};
+
+	using MyAnyData = eventpp::AnyData<sizeof(DataLifeCounter), eventpp::AnyDataLargePool<4096> >;
+	HugeData huge;
+	huge.data.fill('a');
+	huge.data[8191] = 'b';
+	MyAnyData anyData { huge };
+	REQUIRE(anyData.isType<HugeData>());
+	REQUIRE(anyData.get<HugeData>().data[0] == 'a');
+	REQUIRE(anyData.get<HugeData>().data[8191] == 'b');
+}
+
+TEMPLATE_TEST_CASE("AnyData, AnyDataLargeSharedPool", "", DataLifeCounter, LargeDataLifeCounter)
+{
+	using Type = TestType;
+	using MyAnyData = eventpp::AnyData<sizeof(DataLifeCounter), eventpp::AnyDataLargeSharedPool<> >;
+	LifeCounter lifeCounter {};
+	{
+		MyAnyData anyData { Type { &lifeCounter } };
+		REQUIRE(lifeCounter.ctors == 1);
+		{
+			MyAnyData copied(anyData);
+			REQUIRE(copied.isType<Type>());
+			REQUIRE(copied.get<Type>().counter == &lifeCounter);
+			if(isLargeDataBase<Type>()) {
+				// Shared, not copied.
+				REQUIRE(lifeCounter.ctors == 1);
+				REQUIRE(copied.getAddress() == anyData.getAddress());
+			}
+			else {
+				REQUIRE(lifeCounter.ctors == 2);
+				REQUIRE(copied.getAddress() != anyData.getAddress());
+			}
+		}
+		REQUIRE(lifeCounter.ctors == 1);
+	}
+	REQUIRE(lifeCounter.ctors == 0);
+}
+
+TEST_CASE("AnyData, AnyDataLargeSharedPool, enqueue to several queues")
+{
+	using Data = eventpp::AnyData<eventMaxSize, eventpp::AnyDataLargeSharedPool<> >;
+	using Queue = eventpp::EventQueue<EventType, void (const Data &)>;
+	static_assert(! std::is_copy_constructible<eventpp::AnyData<eventMaxSize> >::value, "");
+	static_assert(std::is_copy_constructible<Data>::value, "");
+
+	Queue queue1;
+	Queue queue2;
+	std::vector<const void *> addressList;
+	const auto listener = [&addressList](const Data & value) {
+		REQUIRE(value.isType<LargeEventKey>());
+		REQUIRE(value.get<LargeEventKey>().key == 5);
+		addressList.push_back(value.getAddress());
+	};
+	queue1.appendListener(EventType::key, listener);
+	queue2.appendListener(EventType::key, listener);
+
+	{
+		const Data data { LargeEventKey(5) };
+		queue1.enqueue(EventType::key, data);
+		queue2.enqueue(EventType::key, data);
+	}
+	queue1.process();
+	queue2.process();
+	REQUIRE(addressList.size() == 2);
+	REQUIRE(addressList[0] == addressList[1]);
+}
+
 } // unnamed namespace
@@ -0,0 +1,158 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/utilities/anydataregistry.h"
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum class EventType {
+	key = 1,
+	mouse = 2,
+	text = 3,
+	unknown = 4
+};
+
+struct EventKey {
+	int key;
+};
+
+struct EventMouse {
+	int x;
+	int y;
+	std::array<int, 64> history;
+};
+
+struct EventUnknown {
+	int value;
+};
+
+constexpr std::size_t eventMaxSize = eventpp::maxSizeOf<EventKey, std::string>();
+using Data = eventpp::AnyData<eventMaxSize>;
+using Registry = eventpp::AnyDataRegistry<Data>;
+
+void registerTypes(Registry & registry)
+{
+	REQUIRE(registry.registerType<EventKey>(1));
+	REQUIRE(registry.registerType<EventMouse>(2));
+	REQUIRE(registry.registerType<std::string>(3));
+}
+
+} //unnamed namespace
+
+TEST_CASE("AnyDataRegistry, registerType")
+{
+	Registry registry;
+	registerTypes(registry);
+	// The ID or the type is used.
+	REQUIRE(! registry.registerType<EventUnknown>(1));
+	REQUIRE(! registry.registerType<EventKey>(5));
+
+	REQUIRE(registry.isRegistered(Data(EventKey { 5 })));
+	REQUIRE(registry.isRegistered(Data(EventMouse())));
+	REQUIRE(! registry.isRegistered(Data(EventUnknown { 5 })));
+	REQUIRE(registry.getSerializedSize(Data(EventUnknown { 5 })) == 0);
+}
+
+TEST_CASE("AnyDataRegistry, serialize and deserialize")
+{
+	Registry registry;
+	registerTypes(registry);
+
+	std::vector<unsigned char> buffer;
+	REQUIRE(registry.serialize(Data(EventKey { 5 }), buffer) == 8 + sizeof(EventKey));
+	EventMouse mouse {};
+	mouse.x = 12;
+	mouse.y = 34;
+	mouse.history[63] = 56;
+	// EventMouse is larger than eventMaxSize, it's on the heap.
+	REQUIRE(registry.serialize(Data(mouse), buffer) > 0);
+	REQUIRE(registry.serialize(Data(std::string("Hello")), buffer) == 8 + 5);
+	REQUIRE(registry.serialize(Data(EventUnknown { 5 }), buffer) == 0);
+
+	std::size_t offset = 0;
+	std::size_t size = registry.deserialize(buffer.data() + offset, buffer.size() - offset, [](Data && data) {
+		REQUIRE(data.isType<EventKey>());
+		REQUIRE(data.get<EventKey>().key == 5);
+	});
+	REQUIRE(size == 8 + sizeof(EventKey));
+	offset += size;
+	size = registry.deserialize(buffer.data() + offset, buffer.size() - offset, [](Data && data) {
+		REQUIRE(data.isType<EventMouse>());
+		REQUIRE(data.get<EventMouse>().x == 12);
+		REQUIRE(data.get<EventMouse>().y == 34);
+		REQUIRE(data.get<EventMouse>().history[63] == 56);
+	});
+	REQUIRE(size > 0);
+	offset += size;
+	size = registry.deserialize(buffer.data() + offset, buffer.size() - offset, [](Data && data) {
+		REQUIRE(data.isType<std::string>());
+		REQUIRE(data.get<std::string>() == "Hello");
+	});
+	REQUIRE(offset + size == buffer.size());
+
+	SECTION("truncated buffer") {
+		int callCount = 0;
+		REQUIRE(registry.deserialize(buffer.data(), 8 + sizeof(EventKey) - 1, [&callCount](Data &&) {
+			++callCount;
+		}) == 0);
+		REQUIRE(callCount == 0);
+	}
+
+	SECTION("the bytes can be read by another registry with the same IDs") {
+		Registry other;
+		REQUIRE(other.registerType<std::string>(3));
+		REQUIRE(other.registerType<EventKey>(1));
+		REQUIRE(other.deserialize(buffer.data(), buffer.size(), [](Data && data) {
+			REQUIRE(data.isType<EventKey>());
+		}) > 0);
+	}
+}
+
+TEST_CASE("AnyDataRegistry, dumpQueue and replayQueue")
+{
+	Registry registry;
+	registerTypes(registry);
+
+	using Queue = eventpp::EventQueue<EventType, void (const Data &)>;
+	Queue queue;
+	queue.enqueue(EventType::key, EventKey { 1 });
+	queue.enqueue(EventType::text, std::string("abc"));
+	queue.enqueue(EventType::unknown, EventUnknown { 2 });
+	queue.enqueue(EventType::key, EventKey { 3 });
+
+	std::vector<unsigned char> log;
+	REQUIRE(registry.dumpQueue(queue, log) == 3);
+	REQUIRE(queue.emptyQueue());
+
+	Queue replayedQueue;
+	std::vector<std::string> dataList;
+	replayedQueue.appendListener(EventType::key, [&dataList](const EventKey & e) {
+		dataList.push_back(std::to_string(e.key));
+	});
+	replayedQueue.appendListener(EventType::text, [&dataList](const std::string & s) {
+		dataList.push_back(s);
+	});
+	REQUIRE(registry.replayQueue(replayedQueue, log.data(), log.size()) == 3);
+	replayedQueue.process();
+	REQUIRE(dataList == std::vector<std::string>{ "1", "abc", "3" });
+
+	SECTION("a truncated log stops at the last complete event") {
+		REQUIRE(registry.replayQueue(replayedQueue, log.data(), log.size() - 1) == 2);
+	}
+}
@@ -0,0 +1,230 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/broadcasteventqueue.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct SmallRingPolicies
+{
+	using RingCapacity = std::integral_constant<std::size_t, 4>;
+	using RingOverflow = eventpp::RingOverflowDropNewest;
+};
+
+struct BlockingPolicies
+{
+	using RingCapacity = std::integral_constant<std::size_t, 64>;
+};
+
+} //namespace
+
+TEST_CASE("BroadcastEventQueue, every consumer gets every event")
+{
+	eventpp::BroadcastEventQueue<int, void (int)> queue;
+	auto consumer1 = queue.addConsumer();
+	auto consumer2 = queue.addConsumer();
+	REQUIRE(consumer1);
+	REQUIRE(consumer1.emptyQueue());
+
+	std::vector<int> listenerList;
+	queue.appendListener(1, [&listenerList](const int value) {
+		listenerList.push_back(value);
+	});
+
+	for(int i = 0; i < 5; ++i) {
+		REQUIRE(queue.enqueue(1, i));
+	}
+	REQUIRE(! consumer1.emptyQueue());
+
+	REQUIRE(consumer1.processOne());
+	REQUIRE(listenerList == std::vector<int>{ 0 });
+	REQUIRE(consumer1.process());
+	REQUIRE(listenerList == std::vector<int>{ 0, 1, 2, 3, 4 });
+	REQUIRE(consumer1.emptyQueue());
+	REQUIRE(! consumer1.process());
+
+	// consumer2 still sees all the events.
+	std::vector<int> visitedList;
+	REQUIRE(! consumer2.emptyQueue());
+	REQUIRE(consumer2.processOneWith([&visitedList](const int e, const int value) {
+		REQUIRE(e == 1);
+		visitedList.push_back(value);
+	}));
+	REQUIRE(consumer2.processQueueWith([&visitedList](int, const int value) {
+		visitedList.push_back(value);
+	}));
+	REQUIRE(visitedList == std::vector<int>{ 0, 1, 2, 3, 4 });
+	REQUIRE(consumer2.emptyQueue());
+}
+
+TEST_CASE("BroadcastEventQueue, a consumer doesn't pass its dependencies")
+{
+	eventpp::BroadcastEventQueue<int, void (int)> queue;
+	auto journal = queue.addConsumer();
+	auto replicator = queue.addConsumer();
+	auto business = queue.addConsumer({ journal, replicator });
+
+	std::vector<int> dataList;
+	auto record = [&dataList](int, const int value) {
+		dataList.push_back(value);
+	};
+
+	for(int i = 0; i < 4; ++i) {
+		queue.enqueue(1, i);
+	}
+	REQUIRE(business.emptyQueue());
+	REQUIRE(! business.process());
+
+	REQUIRE(journal.processQueueWith([](int, int) {}));
+	REQUIRE(replicator.processOneWith([](int, int) {}));
+	REQUIRE(business.processQueueWith(record));
+	REQUIRE(dataList == std::vector<int>{ 0 });
+
+	REQUIRE(replicator.processQueueWith([](int, int) {}));
+	REQUIRE(business.processQueueWith(record));
+	REQUIRE(dataList == std::vector<int>{ 0, 1, 2, 3 });
+}
+
+TEST_CASE("BroadcastEventQueue, the slowest consumer bounds the queue")
+{
+	eventpp::BroadcastEventQueue<int, void (int), SmallRingPolicies> queue;
+	auto fast = queue.addConsumer();
+	auto slow = queue.addConsumer();
+	REQUIRE(queue.getQueueCapacity() == 4);
+
+	for(int i = 0; i < 4; ++i) {
+		REQUIRE(queue.enqueue(1, i));
+	}
+	REQUIRE(fast.processQueueWith([](int, int) {}));
+	REQUIRE(! queue.enqueue(1, 4));
+	REQUIRE(queue.getDroppedEventCount() == 1);
+
+	REQUIRE(slow.processOneWith([](int, int) {}));
+	REQUIRE(queue.enqueue(1, 5));
+
+	std::vector<int> dataList;
+	REQUIRE(slow.processQueueWith([&dataList](int, const int value) {
+		dataList.push_back(value);
+	}));
+	REQUIRE(dataList == std::vector<int>{ 1, 2, 3, 5 });
+}
+
+TEST_CASE("BroadcastEventQueue, the arguments are destroyed when the slot is reused")
+{
+	eventpp::BroadcastEventQueue<int, void (std::shared_ptr<int>), SmallRingPolicies> queue;
+	auto consumer = queue.addConsumer();
+
+	std::weak_ptr<int> first;
+	{
+		auto value = std::make_shared<int>(1);
+		first = value;
+		queue.enqueue(1, std::move(value));
+	}
+	REQUIRE(consumer.processQueueWith([](int, const std::shared_ptr<int> & value) {
+		REQUIRE(*value == 1);
+	}));
+	// The consumers have seen it, but it stays in the ring until the slot is reused.
+	REQUIRE(! first.expired());
+	for(int i = 0; i < 4; ++i) {
+		queue.enqueue(1, std::make_shared<int>(i));
+		consumer.processOneWith([](int, const std::shared_ptr<int> &) {});
+	}
+	REQUIRE(first.expired());
+}
+
+TEST_CASE("BroadcastEventQueue, multiple threading, chained consumers")
+{
+	using EQ = eventpp::BroadcastEventQueue<int, void (int), BlockingPolicies>;
+	EQ queue;
+
+	constexpr int producerCount = 4;
+	constexpr int eventCountPerProducer = 5000;
+	constexpr int totalCount = producerCount * eventCountPerProducer;
+
+	std::vector<EQ::Consumer> consumerList;
+	consumerList.push_back(queue.addConsumer());
+	consumerList.push_back(queue.addConsumer());
+	consumerList.push_back(queue.addConsumer({ consumerList[0], consumerList[1] }));
+
+	struct Result
+	{
+		int count = 0;
+		long long sum = 0;
+		bool ordered = true;
+		std::vector<int> lastValues = std::vector<int>(producerCount, -1);
+	};
+	std::vector<Result> resultList(consumerList.size());
+	// The last consumer checks that both dependencies have seen each event.
+	std::vector<std::atomic<int> > seenCounts(totalCount);
+	for(auto & seen : seenCounts) {
+		seen = 0;
+	}
+
+	std::vector<std::thread> threadList;
+	for(std::size_t c = 0; c < consumerList.size(); ++c) {
+		threadList.emplace_back([&consumerList, &resultList, &seenCounts, c]() {
+			Result & result = resultList[c];
+			while(result.count < totalCount) {
+				if(! consumerList[c].waitFor(std::chrono::milliseconds(10))) {
+					continue;
+				}
+				consumerList[c].processQueueWith([&result, &seenCounts, c](int, const int value) {
+					const int producer = value % producerCount;
+					if(value <= result.lastValues[producer]) {
+						result.ordered = false;
+					}
+					result.lastValues[producer] = value;
+					if(c < 2) {
+						++seenCounts[value];
+					}
+					else if(seenCounts[value].load() != 2) {
+						result.ordered = false;
+					}
+					++result.count;
+					result.sum += value;
+				});
+			}
+		});
+	}
+
+	std::atomic<int> enqueuedCount(0);
+	for(int t = 0; t < producerCount; ++t) {
+		threadList.emplace_back([&queue, &enqueuedCount, t]() {
+			for(int i = 0; i < eventCountPerProducer; ++i) {
+				if(queue.enqueue(1, i * producerCount + t)) {
+					++enqueuedCount;
+				}
+			}
+		});
+	}
+
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	REQUIRE(enqueuedCount.load() == totalCount);
+	for(const Result & result : resultList) {
+		REQUIRE(result.ordered);
+		REQUIRE(result.count == totalCount);
+		REQUIRE(result.sum == (long long)totalCount * (totalCount - 1) / 2);
+	}
+	for(const EQ::Consumer & consumer : consumerList) {
+		REQUIRE(consumer.emptyQueue());
+	}
+}
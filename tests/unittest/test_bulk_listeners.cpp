@@ -0,0 +1,220 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventdispatcher.h"
+
+#include <functional>
+#include <iterator>
+#include <list>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct SnapshotPolicies
+{
+	using ListenerStorage = eventpp::ListenerStorageSnapshot;
+};
+
+struct SlotMapPolicies
+{
+	using ListenerStorage = eventpp::ListenerStorageSlotMap;
+};
+
+template <typename Policies>
+void testAppendBulk()
+{
+	using CL = eventpp::CallbackList<void (), Policies>;
+	CL callbackList;
+
+	std::vector<int> dataList;
+	callbackList.append([&dataList]() {
+		dataList.push_back(0);
+	});
+
+	std::vector<std::function<void ()> > funcList;
+	for(int i = 1; i <= 5; ++i) {
+		funcList.push_back([&dataList, i]() {
+			dataList.push_back(i);
+		});
+	}
+	std::vector<typename CL::Handle> handleList;
+	callbackList.appendBulk(funcList.begin(), funcList.end(), std::back_inserter(handleList));
+	REQUIRE(handleList.size() == 5);
+
+	callbackList();
+	REQUIRE(dataList == std::vector<int>{ 0, 1, 2, 3, 4, 5 });
+
+	// The handles are the listeners, in order.
+	REQUIRE(callbackList.remove(handleList[1]));
+	REQUIRE(callbackList.remove(handleList[4]));
+	REQUIRE(! callbackList.remove(handleList[4]));
+	dataList.clear();
+	callbackList();
+	REQUIRE(dataList == std::vector<int>{ 0, 1, 3, 4 });
+
+	// Appended after the listeners which are there.
+	callbackList.appendBulk(funcList.begin(), funcList.begin() + 2);
+	callbackList.append([&dataList]() {
+		dataList.push_back(9);
+	});
+	dataList.clear();
+	callbackList();
+	REQUIRE(dataList == std::vector<int>{ 0, 1, 3, 4, 1, 2, 9 });
+
+	// Nothing to append.
+	callbackList.appendBulk(funcList.end(), funcList.end(), std::back_inserter(handleList));
+	REQUIRE(handleList.size() == 5);
+
+	// An empty list.
+	CL emptyList;
+	emptyList.appendBulk(funcList.begin() + 2, funcList.end());
+	dataList.clear();
+	emptyList();
+	REQUIRE(dataList == std::vector<int>{ 3, 4, 5 });
+}
+
+} //unnamed namespace
+
+TEST_CASE("CallbackList, appendBulk")
+{
+	testAppendBulk<eventpp::DefaultPolicies>();
+}
+
+TEST_CASE("CallbackList, appendBulk, ListenerStorageSnapshot")
+{
+	testAppendBulk<SnapshotPolicies>();
+}
+
+TEST_CASE("CallbackList, appendBulk, ListenerStorageSlotMap")
+{
+	testAppendBulk<SlotMapPolicies>();
+}
+
+TEST_CASE("CallbackList, appendBulk while invoking")
+{
+	using CL = eventpp::CallbackList<void ()>;
+	CL callbackList;
+
+	std::vector<int> dataList;
+	const std::vector<std::function<void ()> > funcList {
+		[&dataList]() { dataList.push_back(2); },
+		[&dataList]() { dataList.push_back(3); }
+	};
+	callbackList.append([&]() {
+		dataList.push_back(1);
+		if(dataList.size() == 1) {
+			callbackList.appendBulk(funcList.begin(), funcList.end());
+		}
+	});
+
+	// The listeners appended by a listener are not called in the same invoking.
+	callbackList();
+	REQUIRE(dataList == std::vector<int>{ 1 });
+	callbackList();
+	REQUIRE(dataList == std::vector<int>{ 1, 1, 2, 3 });
+}
+
+TEST_CASE("EventDispatcher, appendListeners")
+{
+	using ED = eventpp::EventDispatcher<int, void (int)>;
+	ED dispatcher;
+
+	std::vector<int> dataList;
+	auto makeListener = [&dataList](const int value) {
+		return ED::Callback([&dataList, value](int) {
+			dataList.push_back(value);
+		});
+	};
+
+	// The items of an event don't need to be next to each other.
+	const std::vector<std::pair<int, ED::Callback> > itemList {
+		{ 1, makeListener(10) },
+		{ 1, makeListener(11) },
+		{ 2, makeListener(20) },
+		{ 1, makeListener(12) },
+		{ 3, makeListener(30) },
+		{ 3, makeListener(31) }
+	};
+	std::vector<ED::Handle> handleList;
+	dispatcher.appendListeners(itemList.begin(), itemList.end(), std::back_inserter(handleList));
+	REQUIRE(handleList.size() == itemList.size());
+
+	dispatcher.dispatch(1);
+	REQUIRE(dataList == std::vector<int>{ 10, 11, 12 });
+	dataList.clear();
+	dispatcher.dispatch(2);
+	dispatcher.dispatch(3);
+	REQUIRE(dataList == std::vector<int>{ 20, 30, 31 });
+
+	// The handles are in the order of the items.
+	REQUIRE(dispatcher.removeListener(1, handleList[3]));
+	REQUIRE(dispatcher.removeListener(3, handleList[4]));
+	dataList.clear();
+	dispatcher.dispatch(1);
+	dispatcher.dispatch(3);
+	REQUIRE(dataList == std::vector<int>{ 10, 11, 31 });
+}
+
+TEST_CASE("EventDispatcher, appendListeners with tuples and a list")
+{
+	using ED = eventpp::EventDispatcher<std::string, void (const std::string &, int)>;
+	ED dispatcher;
+
+	std::vector<std::string> dataList;
+	std::list<std::tuple<std::string, ED::Callback> > itemList;
+	itemList.emplace_back("a", [&dataList](const std::string & e, int) {
+		dataList.push_back(e + "1");
+	});
+	itemList.emplace_back("a", [&dataList](const std::string & e, int) {
+		dataList.push_back(e + "2");
+	});
+	itemList.emplace_back("b", [&dataList](const std::string & e, int) {
+		dataList.push_back(e + "1");
+	});
+	dispatcher.appendListeners(itemList.begin(), itemList.end());
+
+	dispatcher.dispatch("a", 0);
+	dispatcher.dispatch("b", 0);
+	REQUIRE(dataList == std::vector<std::string>{ "a1", "a2", "b1" });
+}
+
+TEST_CASE("EventDispatcher, appendListeners after seal")
+{
+	using ED = eventpp::EventDispatcher<int, void (int)>;
+	ED dispatcher;
+
+	std::vector<int> dataList;
+	dispatcher.appendListener(1, [&dataList](int) {
+		dataList.push_back(10);
+	});
+	dispatcher.seal();
+
+	const std::vector<std::pair<int, ED::Callback> > itemList {
+		{ 1, [&dataList](int) { dataList.push_back(11); } },
+		{ 2, [&dataList](int) { dataList.push_back(20); } }
+	};
+	std::vector<ED::Handle> handleList;
+	dispatcher.appendListeners(itemList.begin(), itemList.end(), std::back_inserter(handleList));
+	REQUIRE(handleList.size() == 2);
+
+	// The event which is not in the map gets an empty handle, as appendListener.
+	REQUIRE(handleList[0]);
+	REQUIRE(! handleList[1]);
+	dispatcher.dispatch(1);
+	dispatcher.dispatch(2);
+	REQUIRE(dataList == std::vector<int>{ 10, 11 });
+}
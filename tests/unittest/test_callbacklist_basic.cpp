@@ -561,6 +561,16 @@ TEST_CASE("CallbackList, prototype convert")
 	REQUIRE(dataList == std::vector<int>{ 2, 2 });
 }
 
+namespace {
+
+template <typename Reentrancy_>
+struct ReentrancyPolicies
+{
+	using Reentrancy = Reentrancy_;
+};
+
+} //unnamed namespace
+
 TEST_CASE("CallbackList, internal counter overflow")
 {
 	eventpp::CallbackList<void()> callbackList;
@@ -607,3 +617,464 @@ TEST_CASE("CallbackList, no crash when doFreeNode(head)")
 		REQUIRE(false);
 	}
 }
+
+TEST_CASE("CallbackList, single node fast path")
+{
+	using CL = eventpp::CallbackList<void(int)>;
+	CL callbackList;
+	std::vector<int> dataList;
+	const auto data = std::make_shared<int>(0);
+
+	REQUIRE(callbackList.singleNode.load() == nullptr);
+	auto h1 = callbackList.append([&dataList, data](const int n) {
+		dataList.push_back(n);
+	});
+	REQUIRE(callbackList.singleNode.load() == callbackList.head.get());
+	callbackList(1);
+	REQUIRE(dataList == std::vector<int>{ 1 });
+
+	SECTION("a second node falls back to the general path") {
+		auto h2 = callbackList.prepend([&dataList](const int n) {
+			dataList.push_back(n * 10);
+		});
+		REQUIRE(callbackList.singleNode.load() == nullptr);
+		callbackList(2);
+		REQUIRE(dataList == std::vector<int>{ 1, 20, 2 });
+
+		REQUIRE(callbackList.remove(h2));
+		REQUIRE(callbackList.singleNode.load() == callbackList.head.get());
+		callbackList(3);
+		REQUIRE(dataList == std::vector<int>{ 1, 20, 2, 3 });
+	}
+
+	SECTION("the removed node is freed when no one is calling it") {
+		REQUIRE(data.use_count() == 2);
+		REQUIRE(callbackList.remove(h1));
+		REQUIRE(callbackList.singleNode.load() == nullptr);
+		REQUIRE(data.use_count() == 1);
+		callbackList(2);
+		REQUIRE(dataList == std::vector<int>{ 1 });
+	}
+
+	SECTION("remove itself, and append inside the callback") {
+		CL::Handle handle;
+		handle = callbackList.append([&callbackList, &dataList, &handle, data](const int n) {
+			dataList.push_back(n * 100);
+			callbackList.remove(handle);
+			// Still alive while it's being called.
+			REQUIRE(data.use_count() >= 2);
+			callbackList.append([&dataList](const int n) {
+				dataList.push_back(n * 1000);
+			});
+		});
+		REQUIRE(callbackList.remove(h1));
+		REQUIRE(data.use_count() == 2);
+		callbackList(2);
+		REQUIRE(dataList == std::vector<int>{ 1, 200 });
+		REQUIRE(data.use_count() == 1);
+		callbackList(3);
+		REQUIRE(dataList == std::vector<int>{ 1, 200, 3000 });
+	}
+
+	SECTION("copy, move and swap") {
+		CL copied(callbackList);
+		REQUIRE(copied.singleNode.load() == copied.head.get());
+		copied(2);
+		CL moved(std::move(copied));
+		REQUIRE(copied.singleNode.load() == nullptr);
+		copied(3);
+		moved(4);
+		CL other;
+		other.swap(moved);
+		REQUIRE(moved.singleNode.load() == nullptr);
+		other(5);
+		REQUIRE(dataList == std::vector<int>{ 1, 2, 4, 5 });
+	}
+}
+
+namespace {
+
+int allocatedNodeCount = 0;
+
+template <typename T>
+struct CountingNodeAllocator
+{
+	using value_type = T;
+
+	CountingNodeAllocator() = default;
+
+	template <typename U>
+	CountingNodeAllocator(const CountingNodeAllocator<U> &) {
+	}
+
+	T * allocate(const std::size_t n) {
+		++allocatedNodeCount;
+		return std::allocator<T>().allocate(n);
+	}
+
+	void deallocate(T * p, const std::size_t n) {
+		--allocatedNodeCount;
+		std::allocator<T>().deallocate(p, n);
+	}
+};
+
+template <typename T, typename U>
+bool operator == (const CountingNodeAllocator<T> &, const CountingNodeAllocator<U> &) {
+	return true;
+}
+
+template <typename T, typename U>
+bool operator != (const CountingNodeAllocator<T> &, const CountingNodeAllocator<U> &) {
+	return false;
+}
+
+struct CountingNodeAllocatorPolicies
+{
+	template <typename T>
+	using NodeAllocator = CountingNodeAllocator<T>;
+};
+
+struct CountingNodeAllocatorSnapshotPolicies
+{
+	using ListenerStorage = eventpp::ListenerStorageSnapshot;
+
+	template <typename T>
+	using NodeAllocator = CountingNodeAllocator<T>;
+};
+
+template <typename CL>
+void testNodeAllocator()
+{
+	allocatedNodeCount = 0;
+	{
+		CL callbackList;
+		std::vector<int> dataList;
+		auto h1 = callbackList.append([&dataList]() { dataList.push_back(1); });
+		callbackList.append([&dataList]() { dataList.push_back(2); });
+		callbackList.prepend([&dataList]() { dataList.push_back(3); });
+		REQUIRE(allocatedNodeCount == 3);
+
+		callbackList();
+		REQUIRE(dataList == std::vector<int>{ 3, 1, 2 });
+
+		CL copied(callbackList);
+		REQUIRE(allocatedNodeCount == 6);
+
+		callbackList.remove(h1);
+		dataList.clear();
+		callbackList();
+		REQUIRE(dataList == std::vector<int>{ 3, 2 });
+	}
+	REQUIRE(allocatedNodeCount == 0);
+}
+
+} //unnamed namespace
+
+TEST_CASE("CallbackList, NodeAllocator")
+{
+	SECTION("linked list") {
+		testNodeAllocator<eventpp::CallbackList<void (), CountingNodeAllocatorPolicies> >();
+	}
+	SECTION("snapshot") {
+		testNodeAllocator<eventpp::CallbackList<void (), CountingNodeAllocatorSnapshotPolicies> >();
+	}
+}
+
+struct SnapshotStoragePolicies
+{
+	using ListenerStorage = eventpp::ListenerStorageSnapshot;
+};
+
+struct ListenerGroupPolicies
+{
+	using ListenerGroups = eventpp::ListenerGroupsEnabled;
+};
+
+struct ListenerGroupSnapshotPolicies
+{
+	using ListenerStorage = eventpp::ListenerStorageSnapshot;
+	using ListenerGroups = eventpp::ListenerGroupsEnabled;
+};
+
+struct ListenerGroupReentrancyNonePolicies
+{
+	using Reentrancy = eventpp::ReentrancyNone;
+	using ListenerGroups = eventpp::ListenerGroupsEnabled;
+};
+
+template <typename CL>
+void testListenerGroup()
+{
+	CL callbackList;
+	eventpp::ListenerGroup group;
+	std::vector<int> dataList(4);
+
+	callbackList.append([&dataList]() {
+		++dataList[0];
+	});
+	auto h1 = callbackList.append([&dataList]() {
+		++dataList[1];
+	}, group);
+	callbackList.prepend([&dataList]() {
+		++dataList[2];
+	}, group);
+	callbackList.insert([&dataList]() {
+		++dataList[3];
+	}, h1, group);
+
+	callbackList();
+	REQUIRE(dataList == std::vector<int> { 1, 1, 1, 1 });
+
+	group.removeAll();
+	callbackList();
+	REQUIRE(dataList == std::vector<int> { 2, 1, 1, 1 });
+
+	// The listeners added after removeAll are in a new group.
+	callbackList.append([&dataList]() {
+		++dataList[1];
+	}, group);
+	callbackList();
+	REQUIRE(dataList == std::vector<int> { 3, 2, 1, 1 });
+	// The nodes of the removed group are unlinked by now.
+	REQUIRE(! h1);
+
+	// The copy doesn't belong to the group.
+	CL copied(callbackList);
+	group.removeAll();
+	callbackList();
+	REQUIRE(dataList == std::vector<int> { 4, 2, 1, 1 });
+	copied();
+	REQUIRE(dataList == std::vector<int> { 5, 3, 1, 1 });
+
+	SECTION("removeAll inside a callback") {
+		eventpp::ListenerGroup innerGroup;
+		std::vector<int> innerList(3);
+		CL list;
+		list.append([&innerList, &innerGroup]() {
+			++innerList[0];
+			innerGroup.removeAll();
+		}, innerGroup);
+		list.append([&innerList]() {
+			++innerList[1];
+		}, innerGroup);
+		list.append([&innerList]() {
+			++innerList[2];
+		});
+		list();
+		REQUIRE(innerList == std::vector<int> { 1, 0, 1 });
+		list();
+		REQUIRE(innerList == std::vector<int> { 1, 0, 2 });
+	}
+
+	SECTION("the group is alive as long as its nodes") {
+		CL list;
+		{
+			eventpp::ListenerGroup innerGroup;
+			list.append([]() {}, innerGroup);
+		}
+		list();
+		REQUIRE(! list.empty());
+	}
+}
+
+TEST_CASE("CallbackList, ListenerGroup")
+{
+	SECTION("linked list") {
+		testListenerGroup<eventpp::CallbackList<void (), ListenerGroupPolicies> >();
+	}
+	SECTION("snapshot") {
+		testListenerGroup<eventpp::CallbackList<void (), ListenerGroupSnapshotPolicies> >();
+	}
+	SECTION("linked list, ReentrancyNone") {
+		testListenerGroup<eventpp::CallbackList<void (), ListenerGroupReentrancyNonePolicies> >();
+	}
+}
+
+TEST_CASE("CallbackList, no ListenerGroup by default")
+{
+	// The functions taking a group don't exist, so the utilities remove by handle.
+	static_assert(! eventpp::internal_::CallbackListHasListenerGroup<eventpp::CallbackList<void ()> >::value, "");
+	static_assert(! eventpp::internal_::CallbackListHasListenerGroup<eventpp::CallbackList<void (), SnapshotStoragePolicies> >::value, "");
+	static_assert(eventpp::internal_::CallbackListHasListenerGroup<eventpp::CallbackList<void (), ListenerGroupPolicies> >::value, "");
+	static_assert(eventpp::internal_::CallbackListHasListenerGroup<eventpp::CallbackList<void (), ListenerGroupSnapshotPolicies> >::value, "");
+}
+
+TEST_CASE("CallbackList, Reentrancy")
+{
+	SECTION("ReentrancyAppendOnlyOutsideDispatch") {
+		using CL = eventpp::CallbackList<void (), ReentrancyPolicies<eventpp::ReentrancyAppendOnlyOutsideDispatch> >;
+		CL callbackList;
+		std::vector<int> dataList(3);
+		CL::Handle h2;
+		callbackList.append([&dataList, &callbackList, &h2]() {
+			++dataList[0];
+			// Removing while invoking is fine.
+			callbackList.remove(h2);
+		});
+		h2 = callbackList.append([&dataList]() {
+			++dataList[1];
+		});
+		callbackList.append([&dataList]() {
+			++dataList[2];
+		});
+		// The counter is never advanced.
+		REQUIRE(callbackList.currentCounter.load() == 0);
+		REQUIRE(callbackList.head->counter.load() == 1);
+
+		callbackList();
+		REQUIRE(dataList == std::vector<int>{ 1, 0, 1 });
+		callbackList();
+		REQUIRE(dataList == std::vector<int>{ 2, 0, 2 });
+	}
+
+	SECTION("ReentrancyNone") {
+		using CL = eventpp::CallbackList<int (int), ReentrancyPolicies<eventpp::ReentrancyNone> >;
+		CL callbackList;
+		std::vector<CL::Handle> handleList;
+		for(int i = 0; i < 20; ++i) {
+			handleList.push_back(callbackList.append([i](int n) { return i + n; }));
+		}
+		int sum = 0;
+		callbackList.forEach([&sum](CL::Callback & callback) {
+			sum += callback(1);
+		});
+		REQUIRE(sum == 210);
+
+		for(int i = 0; i < 20; i += 2) {
+			REQUIRE(callbackList.remove(handleList[i]));
+		}
+		std::vector<int> resultList;
+		REQUIRE(! callbackList.forEachIf([&resultList](const CL::Handle & handle, CL::Callback & callback) {
+			REQUIRE(handle);
+			resultList.push_back(callback(0));
+			return resultList.size() < 5;
+		}));
+		REQUIRE(resultList == std::vector<int>{ 1, 3, 5, 7, 9 });
+	}
+
+	SECTION("ReentrancyNone, change the list in a listener") {
+		using CL = eventpp::CallbackList<void (), ReentrancyPolicies<eventpp::ReentrancyNone> >;
+		CL callbackList;
+		std::vector<int> dataList(4);
+		CL::Handle h1;
+		CL::Handle h2;
+		h1 = callbackList.append([&dataList, &callbackList, &h1, &h2]() {
+			++dataList[0];
+			// Neither removing, appending nor invoking again deadlocks.
+			callbackList.remove(h1);
+			callbackList.remove(h2);
+			callbackList.append([&dataList]() {
+				++dataList[3];
+			});
+			callbackList();
+		});
+		h2 = callbackList.append([&dataList]() {
+			++dataList[1];
+		});
+		callbackList.append([&dataList]() {
+			++dataList[2];
+		});
+
+		// The inner invoking calls the listeners 3 and 4, the outer one
+		// skips the removed listener 2 and doesn't call the listener 4 it
+		// didn't take.
+		callbackList();
+		REQUIRE(dataList == std::vector<int>{ 1, 0, 2, 1 });
+		callbackList();
+		REQUIRE(dataList == std::vector<int>{ 1, 0, 3, 2 });
+	}
+}
+
+TEST_CASE("CallbackList, append with priority")
+{
+	using CL = eventpp::CallbackList<void (std::vector<int> &), ListenerGroupPolicies>;
+	CL callbackList;
+	auto makeCallback = [](const int id) {
+		return [id](std::vector<int> & idList) {
+			idList.push_back(id);
+		};
+	};
+	auto getIdList = [&callbackList]() {
+		std::vector<int> idList;
+		callbackList(idList);
+		return idList;
+	};
+
+	// The greater priority first, the same priority in the order added.
+	CL::Handle h1 = callbackList.append(makeCallback(1), 0);
+	CL::Handle h2 = callbackList.append(makeCallback(2), 10);
+	CL::Handle h3 = callbackList.append(makeCallback(3), -5);
+	CL::Handle h4 = callbackList.append(makeCallback(4), 10);
+	CL::Handle h5 = callbackList.append(makeCallback(5), 0);
+	REQUIRE(getIdList() == std::vector<int>{ 2, 4, 1, 5, 3 });
+	REQUIRE(callbackList.priorityIndex->size() == 3);
+
+	// The listeners without priority stay where they are put.
+	callbackList.prepend(makeCallback(6));
+	callbackList.append(makeCallback(7));
+	callbackList.append(makeCallback(8), 20);
+	callbackList.append(makeCallback(9), -10);
+	REQUIRE(getIdList() == std::vector<int>{ 6, 8, 2, 4, 1, 5, 3, 9, 7 });
+
+	// Removing the first, the last, and the only node of a priority.
+	REQUIRE(callbackList.remove(h2));
+	REQUIRE(callbackList.remove(h5));
+	REQUIRE(callbackList.remove(h3));
+	REQUIRE(callbackList.priorityIndex->size() == 4);
+	callbackList.append(makeCallback(10), 10);
+	callbackList.append(makeCallback(11), 0);
+	callbackList.append(makeCallback(12), -5);
+	REQUIRE(getIdList() == std::vector<int>{ 6, 8, 4, 10, 1, 11, 12, 9, 7 });
+	REQUIRE(h4);
+	REQUIRE(h1);
+
+	// The copy has its own index.
+	CL copiedList(callbackList);
+	copiedList.append(makeCallback(13), 0);
+	std::vector<int> idList;
+	copiedList(idList);
+	REQUIRE(idList == std::vector<int>{ 6, 8, 4, 10, 1, 11, 13, 12, 9, 7 });
+	REQUIRE(getIdList() == std::vector<int>{ 6, 8, 4, 10, 1, 11, 12, 9, 7 });
+
+	// The nodes of a removed group are unlinked by the traversal.
+	eventpp::ListenerGroup group;
+	callbackList.append(makeCallback(14), 10, group);
+	callbackList.append(makeCallback(15), 0, group);
+	REQUIRE(getIdList() == std::vector<int>{ 6, 8, 4, 10, 14, 1, 11, 15, 12, 9, 7 });
+	group.removeAll();
+	REQUIRE(getIdList() == std::vector<int>{ 6, 8, 4, 10, 1, 11, 12, 9, 7 });
+	callbackList.append(makeCallback(16), 10);
+	REQUIRE(getIdList() == std::vector<int>{ 6, 8, 4, 10, 16, 1, 11, 12, 9, 7 });
+}
+
+TEST_CASE("CallbackList, append with priority, many listeners")
+{
+	using CL = eventpp::CallbackList<void (std::vector<int> &)>;
+	CL callbackList;
+	std::vector<std::pair<int, int> > expectedList;
+	std::vector<CL::Handle> handleList;
+	for(int i = 0; i < 2000; ++i) {
+		const int priority = (i * 7919) % 61 - 30;
+		expectedList.emplace_back(priority, i);
+		handleList.push_back(callbackList.append([i](std::vector<int> & idList) {
+			idList.push_back(i);
+		}, priority));
+	}
+	// Remove every third listener.
+	for(int i = 0; i < 2000; i += 3) {
+		REQUIRE(callbackList.remove(handleList[i]));
+	}
+	expectedList.erase(std::remove_if(expectedList.begin(), expectedList.end(), [](const std::pair<int, int> & item) {
+		return item.second % 3 == 0;
+	}), expectedList.end());
+	std::stable_sort(expectedList.begin(), expectedList.end(), [](const std::pair<int, int> & a, const std::pair<int, int> & b) {
+		return a.first > b.first;
+	});
+
+	std::vector<int> idList;
+	callbackList(idList);
+	REQUIRE(idList.size() == expectedList.size());
+	for(std::size_t i = 0; i < idList.size(); ++i) {
+		REQUIRE(idList[i] == expectedList[i].second);
+	}
+}
@@ -12,7 +12,10 @@
 // limitations under the License.
 
 #include "test_callbacklist_util.h"
+#include "eventpp/utilities/counterremover.h"
 
+#include <atomic>
+#include <memory>
 #include <thread>
 #include <random>
 
@@ -228,3 +231,196 @@ TEST_CASE("CallbackList, multi threading, insert")
 	verifyDisorderedLinkedList(callbackList, compareList);
 }
 
+
+TEST_CASE("CallbackList, multi threading, single node fast path")
+{
+	using CL = eventpp::CallbackList<void()>;
+	CL callbackList;
+
+	constexpr int threadCount = 8;
+	constexpr int replaceCount = 1024 * 4;
+
+	const auto data = std::make_shared<std::atomic<int> >(0);
+	std::atomic<bool> stopped(false);
+
+	auto handle = callbackList.append([data]() {
+		++*data;
+	});
+
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < threadCount; ++i) {
+		threadList.emplace_back([&callbackList, &stopped]() {
+			while(! stopped.load(std::memory_order_acquire)) {
+				callbackList();
+			}
+		});
+	}
+	// Replace the only node while the other threads are calling it, the
+	// removed nodes must stay alive until the threads leave them.
+	for(int i = 0; i < replaceCount; ++i) {
+		auto next = callbackList.append([data]() {
+			++*data;
+		});
+		REQUIRE(callbackList.remove(handle));
+		handle = next;
+	}
+	stopped.store(true, std::memory_order_release);
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	REQUIRE(callbackList.remove(handle));
+	callbackList();
+	REQUIRE(eventpp::internal_::EpochReclaimer::getRetiredCount() == 0);
+	REQUIRE(data.use_count() == 1);
+}
+
+TEST_CASE("CallbackList, multi threading, assign while the single node is called")
+{
+	using CL = eventpp::CallbackList<void()>;
+	CL callbackList;
+
+	constexpr int threadCount = 8;
+	constexpr int assignCount = 1024 * 2;
+
+	const auto data = std::make_shared<std::atomic<int> >(0);
+	std::atomic<bool> stopped(false);
+
+	CL source;
+	source.append([data]() {
+		++*data;
+	});
+	callbackList = source;
+
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < threadCount; ++i) {
+		threadList.emplace_back([&callbackList, &stopped]() {
+			while(! stopped.load(std::memory_order_acquire)) {
+				callbackList();
+			}
+		});
+	}
+	// The old single node must stay alive until the threads leave it.
+	for(int i = 0; i < assignCount; ++i) {
+		if(i % 2 == 0) {
+			callbackList = source;
+		}
+		else {
+			CL other;
+			other.append([data]() {
+				++*data;
+			});
+			callbackList = std::move(other);
+		}
+	}
+	stopped.store(true, std::memory_order_release);
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	callbackList = CL();
+	source = CL();
+	callbackList();
+	REQUIRE(eventpp::internal_::EpochReclaimer::getRetiredCount() == 0);
+	REQUIRE(data.use_count() == 1);
+}
+
+TEST_CASE("CallbackList, multi threading, ReentrancyNone")
+{
+	struct Policies
+	{
+		using Reentrancy = eventpp::ReentrancyNone;
+	};
+	using CL = eventpp::CallbackList<void(), Policies>;
+	CL callbackList;
+
+	constexpr int threadCount = 4;
+	constexpr int listenerCount = 1024 * 2;
+
+	const auto data = std::make_shared<std::atomic<int> >(0);
+	std::atomic<bool> stopped(false);
+
+	// Keep 2 nodes in the list so the single node fast path is not used.
+	callbackList.append([]() {});
+	callbackList.append([]() {});
+
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < threadCount; ++i) {
+		threadList.emplace_back([&callbackList, &stopped]() {
+			while(! stopped.load(std::memory_order_acquire)) {
+				callbackList();
+			}
+		});
+	}
+	// The listeners remove themselves while the other threads invoke the
+	// list, neither the removing nor the invoking waits for a whole walk.
+	for(int i = 0; i < listenerCount; ++i) {
+		eventpp::counterRemover(callbackList).append([data]() {
+			++*data;
+		}, 1);
+	}
+	while(data->load() < listenerCount) {
+		std::this_thread::yield();
+	}
+	stopped.store(true, std::memory_order_release);
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	int nodeCount = 0;
+	callbackList.forEach([&nodeCount](CL::Callback &) {
+		++nodeCount;
+	});
+	REQUIRE(nodeCount == 2);
+	REQUIRE(data->load() == listenerCount);
+	callbackList();
+	REQUIRE(eventpp::internal_::EpochReclaimer::getRetiredCount() == 0);
+	REQUIRE(data.use_count() == 1);
+}
+
+TEST_CASE("CallbackList, multi threading, ListenerGroup removeAll")
+{
+	struct Policies
+	{
+		using ListenerGroups = eventpp::ListenerGroupsEnabled;
+	};
+	using CL = eventpp::CallbackList<void(), Policies>;
+	CL callbackList;
+
+	constexpr int threadCount = 8;
+	constexpr int roundCount = 1024;
+	constexpr int listenerCountPerRound = 20;
+
+	const auto data = std::make_shared<std::atomic<int> >(0);
+	std::atomic<bool> stopped(false);
+
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < threadCount; ++i) {
+		threadList.emplace_back([&callbackList, &stopped]() {
+			while(! stopped.load(std::memory_order_acquire)) {
+				callbackList();
+			}
+		});
+	}
+	// The nodes of the removed groups are unlinked by the invoking threads.
+	eventpp::ListenerGroup group;
+	for(int i = 0; i < roundCount; ++i) {
+		for(int k = 0; k < listenerCountPerRound; ++k) {
+			callbackList.append([data]() {
+				++*data;
+			}, group);
+		}
+		group.removeAll();
+	}
+	stopped.store(true, std::memory_order_release);
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	const int count = data->load();
+	callbackList();
+	REQUIRE(data->load() == count);
+	REQUIRE(callbackList.empty());
+	REQUIRE(eventpp::internal_::EpochReclaimer::getRetiredCount() == 0);
+	REQUIRE(data.use_count() == 1);
+}
@@ -0,0 +1,351 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// OPT-61: Tests for CallbackList with ListenerStorageSlotMap
+
+#include "test.h"
+#include "eventpp/callbacklist.h"
+#include "eventpp/eventdispatcher.h"
+#include "eventpp/utilities/scopedremover.h"
+#include "eventpp/utilities/eventutil.h"
+
+#include <vector>
+#include <numeric>
+#include <thread>
+#include <atomic>
+
+namespace {
+
+struct SlotMapPolicies
+{
+	using ListenerStorage = eventpp::ListenerStorageSlotMap;
+};
+
+} //unnamed namespace
+
+TEST_CASE("CallbackList slot map, append/prepend/insert order")
+{
+	using CL = eventpp::CallbackList<void(std::vector<int> &), SlotMapPolicies>;
+	CL callbackList;
+
+	REQUIRE(callbackList.empty());
+	REQUIRE(sizeof(CL::Handle) == 8);
+
+	auto h1 = callbackList.append([](std::vector<int> & v) { v.push_back(1); });
+	callbackList.append([](std::vector<int> & v) { v.push_back(2); });
+	callbackList.prepend([](std::vector<int> & v) { v.push_back(3); });
+	callbackList.insert([](std::vector<int> & v) { v.push_back(4); }, h1);
+
+	REQUIRE(! callbackList.empty());
+
+	std::vector<int> dataList;
+	callbackList(dataList);
+	REQUIRE(dataList == std::vector<int>{ 3, 4, 1, 2 });
+}
+
+TEST_CASE("CallbackList slot map, remove and handle")
+{
+	using CL = eventpp::CallbackList<void(std::vector<int> &), SlotMapPolicies>;
+	CL callbackList;
+	CL otherList;
+
+	REQUIRE(! CL::Handle());
+
+	auto h1 = callbackList.append([](std::vector<int> & v) { v.push_back(1); });
+	auto h2 = callbackList.append([](std::vector<int> & v) { v.push_back(2); });
+	auto h3 = callbackList.append([](std::vector<int> & v) { v.push_back(3); });
+	// Same index in another list, a different generation.
+	auto otherHandle = otherList.append([](std::vector<int> &) {});
+
+	REQUIRE(h2);
+	REQUIRE(h1 != h2);
+	REQUIRE(callbackList.ownsHandle(h2));
+	REQUIRE(! callbackList.ownsHandle(otherHandle));
+	REQUIRE(! callbackList.remove(otherHandle));
+	REQUIRE(callbackList.remove(h2));
+	// The handle is not empty, but it's not owned any more.
+	REQUIRE(h2);
+	REQUIRE(! callbackList.remove(h2));
+	REQUIRE(! callbackList.ownsHandle(h2));
+
+	// The slot of h2 is reused, h2 stays stale.
+	auto h4 = callbackList.append([](std::vector<int> & v) { v.push_back(4); });
+	REQUIRE(h4 != h2);
+	REQUIRE(! callbackList.ownsHandle(h2));
+	REQUIRE(callbackList.ownsHandle(h4));
+
+	std::vector<int> dataList;
+	callbackList(dataList);
+	REQUIRE(dataList == std::vector<int>{ 1, 3, 4 });
+
+	REQUIRE(callbackList.remove(h1));
+	REQUIRE(callbackList.remove(h3));
+	REQUIRE(callbackList.remove(h4));
+	REQUIRE(callbackList.empty());
+
+	dataList.clear();
+	callbackList(dataList);
+	REQUIRE(dataList.empty());
+}
+
+TEST_CASE("CallbackList slot map, nested append is not invoked in current dispatch")
+{
+	using CL = eventpp::CallbackList<void(), SlotMapPolicies>;
+	CL callbackList;
+	int a = 0, b = 0;
+
+	callbackList.append([&callbackList, &a, &b]() {
+		++a;
+		callbackList.append([&b]() {
+			++b;
+		});
+	});
+
+	callbackList();
+	REQUIRE(a == 1);
+	REQUIRE(b == 0);
+
+	callbackList();
+	REQUIRE(a == 2);
+	REQUIRE(b == 1);
+}
+
+TEST_CASE("CallbackList slot map, remove inside callback")
+{
+	using CL = eventpp::CallbackList<void(), SlotMapPolicies>;
+
+	// More than one traversal batch.
+	constexpr int callbackCount = 19;
+	for(int removerIndex = 0; removerIndex < callbackCount; ++removerIndex) {
+		for(int removeIndex = 0; removeIndex < callbackCount; ++removeIndex) {
+			CL callbackList;
+			std::vector<CL::Handle> handleList(callbackCount);
+			std::vector<int> dataList(callbackCount);
+
+			for(int i = 0; i < callbackCount; ++i) {
+				if(i == removerIndex) {
+					handleList[i] = callbackList.append([&dataList, &handleList, &callbackList, i, removeIndex]() {
+						dataList[i] = i + 1;
+						callbackList.remove(handleList[removeIndex]);
+					});
+				}
+				else {
+					handleList[i] = callbackList.append([&dataList, i]() {
+						dataList[i] = i + 1;
+					});
+				}
+			}
+
+			callbackList();
+
+			std::vector<int> compareList(callbackCount);
+			std::iota(compareList.begin(), compareList.end(), 1);
+			if(removeIndex > removerIndex) {
+				compareList[removeIndex] = 0;
+			}
+			REQUIRE(dataList == compareList);
+
+			callbackList();
+			REQUIRE(! callbackList.ownsHandle(handleList[removeIndex]));
+		}
+	}
+}
+
+TEST_CASE("CallbackList slot map, forEach and forEachIf")
+{
+	using CL = eventpp::CallbackList<int(), SlotMapPolicies>;
+	CL callbackList;
+
+	callbackList.append([]() { return 1; });
+	callbackList.append([]() { return 2; });
+	callbackList.append([]() { return 3; });
+
+	std::vector<int> dataList;
+	callbackList.forEach([&dataList, &callbackList](const CL::Handle & handle, const CL::Callback & callback) {
+		dataList.push_back(callback());
+		REQUIRE(callbackList.ownsHandle(handle));
+	});
+	REQUIRE(dataList == std::vector<int>{ 1, 2, 3 });
+
+	dataList.clear();
+	const bool result = callbackList.forEachIf([&dataList](const CL::Callback & callback) -> bool {
+		dataList.push_back(callback());
+		return dataList.size() < 2;
+	});
+	REQUIRE(! result);
+	REQUIRE(dataList == std::vector<int>{ 1, 2 });
+}
+
+TEST_CASE("CallbackList slot map, eventutil removeListener")
+{
+	struct Policies
+	{
+		using ListenerStorage = eventpp::ListenerStorageSlotMap;
+		using Callback = void (*)(int &);
+	};
+
+	struct Local
+	{
+		static void addOne(int & value) { value += 1; }
+		static void addTen(int & value) { value += 10; }
+	};
+
+	eventpp::CallbackList<void(int &), Policies> callbackList;
+	callbackList.append(&Local::addOne);
+	callbackList.append(&Local::addTen);
+
+	REQUIRE(eventpp::removeListener(callbackList, &Local::addOne));
+	REQUIRE(! eventpp::removeListener(callbackList, &Local::addOne));
+
+	int value = 0;
+	callbackList(value);
+	REQUIRE(value == 10);
+}
+
+TEST_CASE("CallbackList slot map, copy, move and swap")
+{
+	using CL = eventpp::CallbackList<void(std::vector<int> &), SlotMapPolicies>;
+	CL callbackList;
+	callbackList.append([](std::vector<int> & v) { v.push_back(1); });
+	auto handle = callbackList.append([](std::vector<int> & v) { v.push_back(2); });
+
+	CL copied(callbackList);
+	REQUIRE(! copied.ownsHandle(handle));
+	std::vector<int> dataList;
+	copied(dataList);
+	REQUIRE(dataList == std::vector<int>{ 1, 2 });
+
+	CL moved(std::move(copied));
+	REQUIRE(copied.empty());
+	dataList.clear();
+	moved(dataList);
+	REQUIRE(dataList == std::vector<int>{ 1, 2 });
+
+	CL other;
+	other.append([](std::vector<int> & v) { v.push_back(3); });
+	swap(other, moved);
+	dataList.clear();
+	other(dataList);
+	moved(dataList);
+	REQUIRE(dataList == std::vector<int>{ 1, 2, 3 });
+
+	CL assigned;
+	assigned = callbackList;
+	dataList.clear();
+	assigned(dataList);
+	REQUIRE(dataList == std::vector<int>{ 1, 2 });
+}
+
+TEST_CASE("CallbackList slot map, ListenerGroup")
+{
+	struct Policies
+	{
+		using ListenerStorage = eventpp::ListenerStorageSlotMap;
+		using ListenerGroups = eventpp::ListenerGroupsEnabled;
+	};
+	using CL = eventpp::CallbackList<void(std::vector<int> &), Policies>;
+	CL callbackList;
+	eventpp::ListenerGroup group;
+
+	auto h1 = callbackList.append([](std::vector<int> & v) { v.push_back(1); }, group);
+	callbackList.append([](std::vector<int> & v) { v.push_back(2); });
+	callbackList.prepend([](std::vector<int> & v) { v.push_back(3); }, group);
+
+	std::vector<int> dataList;
+	callbackList(dataList);
+	REQUIRE(dataList == std::vector<int>{ 3, 1, 2 });
+
+	group.removeAll();
+	dataList.clear();
+	callbackList(dataList);
+	REQUIRE(dataList == std::vector<int>{ 2 });
+	REQUIRE(! callbackList.ownsHandle(h1));
+}
+
+TEST_CASE("CallbackList slot map, EventDispatcher and ScopedRemover")
+{
+	using ED = eventpp::EventDispatcher<int, void(int &), SlotMapPolicies>;
+	ED dispatcher;
+
+	auto handle = dispatcher.appendListener(3, [](int & value) { value += 1; });
+	dispatcher.appendListener(3, [](int & value) { value += 10; });
+
+	int value = 0;
+	dispatcher.dispatch(3, value);
+	REQUIRE(value == 11);
+
+	REQUIRE(dispatcher.removeListener(3, handle));
+	REQUIRE(! dispatcher.removeListener(3, handle));
+	value = 0;
+	dispatcher.dispatch(3, value);
+	REQUIRE(value == 10);
+
+	{
+		eventpp::ScopedRemover<ED> remover(dispatcher);
+		auto scopedHandle = remover.appendListener(3, [](int & value) { value += 100; });
+		remover.appendListener(3, [](int & value) { value += 1000; });
+
+		value = 0;
+		dispatcher.dispatch(3, value);
+		REQUIRE(value == 1110);
+
+		REQUIRE(remover.removeListener(3, scopedHandle));
+		REQUIRE(! remover.removeListener(3, scopedHandle));
+		value = 0;
+		dispatcher.dispatch(3, value);
+		REQUIRE(value == 1010);
+	}
+
+	value = 0;
+	dispatcher.dispatch(3, value);
+	REQUIRE(value == 10);
+}
+
+TEST_CASE("CallbackList slot map, multi threading, invoke while append/remove")
+{
+	using CL = eventpp::CallbackList<void(std::atomic<int> &), SlotMapPolicies>;
+	CL callbackList;
+
+	callbackList.append([](std::atomic<int> & value) { ++value; });
+
+	constexpr int writerIterations = 2000;
+	std::atomic<bool> stop(false);
+	std::atomic<int> value(0);
+
+	std::vector<std::thread> readerList;
+	for(int i = 0; i < 4; ++i) {
+		readerList.emplace_back([&callbackList, &stop, &value]() {
+			while(! stop.load()) {
+				callbackList(value);
+			}
+		});
+	}
+
+	std::thread writer([&callbackList]() {
+		for(int i = 0; i < writerIterations; ++i) {
+			auto handle = callbackList.append([](std::atomic<int> & value) { ++value; });
+			callbackList.prepend([](std::atomic<int> &) {});
+			callbackList.remove(handle);
+		}
+	});
+
+	writer.join();
+	stop = true;
+	for(auto & thread : readerList) {
+		thread.join();
+	}
+
+	value = 0;
+	callbackList(value);
+	REQUIRE(value.load() == 1);
+}
@@ -0,0 +1,273 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// OPT-16: Tests for CallbackList with ListenerStorageSnapshot
+
+#include "test.h"
+#include "eventpp/callbacklist.h"
+#include "eventpp/eventdispatcher.h"
+
+#include <vector>
+#include <numeric>
+#include <thread>
+#include <atomic>
+
+namespace {
+
+struct SnapshotPolicies
+{
+	using ListenerStorage = eventpp::ListenerStorageSnapshot;
+};
+
+} //unnamed namespace
+
+TEST_CASE("CallbackList snapshot, append/prepend/insert order")
+{
+	using CL = eventpp::CallbackList<void(std::vector<int> &), SnapshotPolicies>;
+	CL callbackList;
+
+	REQUIRE(callbackList.empty());
+
+	auto h1 = callbackList.append([](std::vector<int> & v) { v.push_back(1); });
+	callbackList.append([](std::vector<int> & v) { v.push_back(2); });
+	callbackList.prepend([](std::vector<int> & v) { v.push_back(3); });
+	callbackList.insert([](std::vector<int> & v) { v.push_back(4); }, h1);
+
+	REQUIRE(! callbackList.empty());
+
+	std::vector<int> dataList;
+	callbackList(dataList);
+	REQUIRE(dataList == std::vector<int>{ 3, 4, 1, 2 });
+}
+
+TEST_CASE("CallbackList snapshot, remove and handle")
+{
+	using CL = eventpp::CallbackList<void(std::vector<int> &), SnapshotPolicies>;
+	CL callbackList;
+
+	auto h1 = callbackList.append([](std::vector<int> & v) { v.push_back(1); });
+	auto h2 = callbackList.append([](std::vector<int> & v) { v.push_back(2); });
+	auto h3 = callbackList.append([](std::vector<int> & v) { v.push_back(3); });
+
+	REQUIRE(h2);
+	REQUIRE(callbackList.ownsHandle(h2));
+	REQUIRE(callbackList.remove(h2));
+	REQUIRE(! h2);
+	REQUIRE(! callbackList.remove(h2));
+	REQUIRE(! callbackList.ownsHandle(h2));
+
+	std::vector<int> dataList;
+	callbackList(dataList);
+	REQUIRE(dataList == std::vector<int>{ 1, 3 });
+
+	REQUIRE(callbackList.remove(h1));
+	REQUIRE(callbackList.remove(h3));
+	REQUIRE(callbackList.empty());
+
+	dataList.clear();
+	callbackList(dataList);
+	REQUIRE(dataList.empty());
+}
+
+TEST_CASE("CallbackList snapshot, nested append is not invoked in current dispatch")
+{
+	using CL = eventpp::CallbackList<void(), SnapshotPolicies>;
+	CL callbackList;
+	int a = 0, b = 0;
+
+	callbackList.append([&callbackList, &a, &b]() {
+		++a;
+		callbackList.append([&b]() {
+			++b;
+		});
+	});
+
+	callbackList();
+	REQUIRE(a == 1);
+	REQUIRE(b == 0);
+
+	callbackList();
+	REQUIRE(a == 2);
+	REQUIRE(b == 1);
+}
+
+TEST_CASE("CallbackList snapshot, remove inside callback")
+{
+	using CL = eventpp::CallbackList<void(), SnapshotPolicies>;
+
+	constexpr int callbackCount = 7;
+	for(int removerIndex = 0; removerIndex < callbackCount; ++removerIndex) {
+		for(int removeIndex = 0; removeIndex < callbackCount; ++removeIndex) {
+			CL callbackList;
+			std::vector<CL::Handle> handleList(callbackCount);
+			std::vector<int> dataList(callbackCount);
+
+			for(int i = 0; i < callbackCount; ++i) {
+				if(i == removerIndex) {
+					handleList[i] = callbackList.append([&dataList, &handleList, &callbackList, i, removeIndex]() {
+						dataList[i] = i + 1;
+						callbackList.remove(handleList[removeIndex]);
+					});
+				}
+				else {
+					handleList[i] = callbackList.append([&dataList, i]() {
+						dataList[i] = i + 1;
+					});
+				}
+			}
+
+			callbackList();
+
+			std::vector<int> compareList(callbackCount);
+			std::iota(compareList.begin(), compareList.end(), 1);
+			if(removeIndex > removerIndex) {
+				compareList[removeIndex] = 0;
+			}
+			REQUIRE(dataList == compareList);
+		}
+	}
+}
+
+TEST_CASE("CallbackList snapshot, forEach and forEachIf")
+{
+	using CL = eventpp::CallbackList<int(), SnapshotPolicies>;
+	CL callbackList;
+
+	callbackList.append([]() { return 1; });
+	callbackList.append([]() { return 2; });
+	callbackList.append([]() { return 3; });
+
+	std::vector<int> dataList;
+	callbackList.forEach([&dataList, &callbackList](const CL::Handle & handle, const CL::Callback & callback) {
+		dataList.push_back(callback());
+		REQUIRE(callbackList.ownsHandle(handle));
+	});
+	REQUIRE(dataList == std::vector<int>{ 1, 2, 3 });
+
+	dataList.clear();
+	const bool result = callbackList.forEachIf([&dataList](const CL::Callback & callback) -> bool {
+		dataList.push_back(callback());
+		return dataList.size() < 2;
+	});
+	REQUIRE(! result);
+	REQUIRE(dataList == std::vector<int>{ 1, 2 });
+}
+
+TEST_CASE("CallbackList snapshot, copy, move and swap")
+{
+	using CL = eventpp::CallbackList<void(std::vector<int> &), SnapshotPolicies>;
+	CL callbackList;
+	callbackList.append([](std::vector<int> & v) { v.push_back(1); });
+	callbackList.append([](std::vector<int> & v) { v.push_back(2); });
+
+	CL copied(callbackList);
+	std::vector<int> dataList;
+	copied(dataList);
+	REQUIRE(dataList == std::vector<int>{ 1, 2 });
+
+	CL moved(std::move(copied));
+	REQUIRE(copied.empty());
+	dataList.clear();
+	moved(dataList);
+	REQUIRE(dataList == std::vector<int>{ 1, 2 });
+
+	CL other;
+	other.append([](std::vector<int> & v) { v.push_back(3); });
+	swap(other, moved);
+	dataList.clear();
+	other(dataList);
+	moved(dataList);
+	REQUIRE(dataList == std::vector<int>{ 1, 2, 3 });
+
+	CL assigned;
+	assigned = callbackList;
+	dataList.clear();
+	assigned(dataList);
+	REQUIRE(dataList == std::vector<int>{ 1, 2 });
+}
+
+TEST_CASE("CallbackList snapshot, canContinueInvoking")
+{
+	struct Policies
+	{
+		using ListenerStorage = eventpp::ListenerStorageSnapshot;
+
+		static bool canContinueInvoking(int & value) {
+			return value < 2;
+		}
+	};
+
+	eventpp::CallbackList<void(int &), Policies> callbackList;
+	callbackList.append([](int & value) { ++value; });
+	callbackList.append([](int & value) { ++value; });
+	callbackList.append([](int & value) { ++value; });
+
+	int value = 0;
+	callbackList(value);
+	REQUIRE(value == 2);
+}
+
+TEST_CASE("CallbackList snapshot, EventDispatcher")
+{
+	eventpp::EventDispatcher<int, void(int &), SnapshotPolicies> dispatcher;
+
+	auto handle = dispatcher.appendListener(3, [](int & value) { value += 1; });
+	dispatcher.appendListener(3, [](int & value) { value += 10; });
+
+	int value = 0;
+	dispatcher.dispatch(3, value);
+	REQUIRE(value == 11);
+
+	REQUIRE(dispatcher.removeListener(3, handle));
+	value = 0;
+	dispatcher.dispatch(3, value);
+	REQUIRE(value == 10);
+}
+
+TEST_CASE("CallbackList snapshot, multi threading, invoke while append/remove")
+{
+	using CL = eventpp::CallbackList<void(std::atomic<int> &), SnapshotPolicies>;
+	CL callbackList;
+
+	callbackList.append([](std::atomic<int> & value) { ++value; });
+
+	constexpr int writerIterations = 2000;
+	std::atomic<bool> stop(false);
+	std::atomic<int> value(0);
+
+	std::vector<std::thread> readerList;
+	for(int i = 0; i < 4; ++i) {
+		readerList.emplace_back([&callbackList, &stop, &value]() {
+			while(! stop.load()) {
+				callbackList(value);
+			}
+		});
+	}
+
+	std::thread writer([&callbackList]() {
+		for(int i = 0; i < writerIterations; ++i) {
+			auto handle = callbackList.append([](std::atomic<int> & value) { ++value; });
+			callbackList.remove(handle);
+		}
+	});
+
+	writer.join();
+	stop = true;
+	for(auto & thread : readerList) {
+		thread.join();
+	}
+
+	value = 0;
+	callbackList(value);
+	REQUIRE(value.load() == 1);
+}
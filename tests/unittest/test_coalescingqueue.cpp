@@ -0,0 +1,187 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/coalescingeventqueue.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Event 1 is a sensor update, the arguments are the sensor id and the value.
+// The event is not passed to the listeners.
+struct SensorPolicies
+{
+	static int coalesceKey(const int /*event*/, const int sensorId, const int /*value*/) {
+		return sensorId;
+	}
+};
+
+} //namespace
+
+TEST_CASE("CoalescingEventQueue, the event is the key by default")
+{
+	eventpp::CoalescingEventQueue<int, void (int, int)> queue;
+	std::vector<std::pair<int, int> > dataList;
+	for(int e = 1; e <= 3; ++e) {
+		queue.appendListener(e, [&dataList](const int e, const int value) {
+			dataList.emplace_back(e, value);
+		});
+	}
+
+	REQUIRE(queue.enqueue(2, 1));
+	REQUIRE(queue.enqueue(1, 2));
+	REQUIRE(! queue.enqueue(2, 3));
+	REQUIRE(queue.enqueue(3, 4));
+	REQUIRE(! queue.enqueue(2, 5));
+	REQUIRE(queue.getCoalescedEventCount() == 2);
+
+	REQUIRE(queue.process());
+	REQUIRE(dataList == std::vector<std::pair<int, int> >{ { 2, 5 }, { 1, 2 }, { 3, 4 } });
+	REQUIRE(queue.emptyQueue());
+
+	// The dispatched events are not pending any more.
+	dataList.clear();
+	REQUIRE(queue.enqueue(2, 6));
+	REQUIRE(queue.process());
+	REQUIRE(dataList == std::vector<std::pair<int, int> >{ { 2, 6 } });
+}
+
+TEST_CASE("CoalescingEventQueue, coalesceKey policy")
+{
+	eventpp::CoalescingEventQueue<int, void (int, int), SensorPolicies> queue;
+	std::vector<std::pair<int, int> > dataList;
+	queue.appendListener(1, [&dataList](const int sensorId, const int value) {
+		dataList.emplace_back(sensorId, value);
+	});
+
+	for(int value = 0; value < 1000; ++value) {
+		for(int sensorId = 0; sensorId < 3; ++sensorId) {
+			queue.enqueue(1, sensorId, value);
+		}
+	}
+	REQUIRE(queue.getCoalescedEventCount() == 2997);
+
+	SECTION("process") {
+		REQUIRE(queue.process());
+		REQUIRE(dataList == std::vector<std::pair<int, int> >{ { 0, 999 }, { 1, 999 }, { 2, 999 } });
+	}
+
+	SECTION("processOne removes the key") {
+		REQUIRE(queue.processOne());
+		REQUIRE(queue.enqueue(1, 0, 1000));
+		REQUIRE(! queue.enqueue(1, 1, 1000));
+		REQUIRE(queue.process());
+		REQUIRE(dataList == std::vector<std::pair<int, int> >{ { 0, 999 }, { 1, 1000 }, { 2, 999 }, { 0, 1000 } });
+	}
+
+	SECTION("peekEvent and takeEvent") {
+		decltype(queue)::QueuedEvent queuedEvent;
+		REQUIRE(queue.peekEvent(&queuedEvent));
+		REQUIRE(queuedEvent.getArgument<0>() == 0);
+		REQUIRE(queue.takeEvent(&queuedEvent));
+		REQUIRE(queuedEvent.getArgument<0>() == 0);
+		REQUIRE(queuedEvent.getArgument<1>() == 999);
+		REQUIRE(queue.enqueue(1, 0, 1000));
+	}
+
+	SECTION("clearEvents") {
+		queue.clearEvents();
+		REQUIRE(queue.emptyQueue());
+		REQUIRE(queue.enqueue(1, 2, 5));
+		REQUIRE(queue.process());
+		REQUIRE(dataList == std::vector<std::pair<int, int> >{ { 2, 5 } });
+	}
+
+	SECTION("processQueueWith") {
+		REQUIRE(queue.processQueueWith([&dataList](int, const int sensorId, const int value) {
+			dataList.emplace_back(sensorId, -value);
+		}));
+		REQUIRE(dataList == std::vector<std::pair<int, int> >{ { 0, -999 }, { 1, -999 }, { 2, -999 } });
+	}
+}
+
+TEST_CASE("CoalescingEventQueue, the replaced arguments are destroyed")
+{
+	eventpp::CoalescingEventQueue<std::string, void (const std::string &, std::shared_ptr<int>)> queue;
+	std::vector<int> dataList;
+	queue.appendListener("a", [&dataList](const std::string &, const std::shared_ptr<int> & value) {
+		dataList.push_back(*value);
+	});
+
+	std::weak_ptr<int> first;
+	{
+		auto value = std::make_shared<int>(1);
+		first = value;
+		queue.enqueue("a", std::move(value));
+	}
+	REQUIRE(! first.expired());
+	queue.enqueue("a", std::make_shared<int>(2));
+	REQUIRE(first.expired());
+
+	REQUIRE(queue.process());
+	REQUIRE(dataList == std::vector<int>{ 2 });
+}
+
+TEST_CASE("CoalescingEventQueue, multiple threading")
+{
+	using EQ = eventpp::CoalescingEventQueue<int, void (int, int), SensorPolicies>;
+	EQ queue;
+
+	constexpr int threadCount = 4;
+	constexpr int sensorCount = 16;
+	constexpr int updateCount = 2000;
+
+	std::vector<int> lastValues(sensorCount, -1);
+	std::atomic<int> finalCount(0);
+	queue.appendListener(1, [&lastValues, &finalCount](const int sensorId, const int value) {
+		// Each sensor is updated by one thread, with increasing values.
+		REQUIRE(value > lastValues[sensorId]);
+		lastValues[sensorId] = value;
+		if(value == updateCount - 1) {
+			++finalCount;
+		}
+	});
+
+	std::vector<std::thread> threadList;
+	for(int t = 0; t < threadCount; ++t) {
+		threadList.emplace_back([&queue, t]() {
+			for(int value = 0; value < updateCount; ++value) {
+				for(int sensorId = t; sensorId < sensorCount; sensorId += threadCount) {
+					queue.enqueue(1, sensorId, value);
+				}
+			}
+		});
+	}
+
+	std::thread consumer([&queue, &finalCount]() {
+		while(finalCount.load() < sensorCount) {
+			if(queue.waitFor(std::chrono::milliseconds(10))) {
+				queue.process();
+			}
+		}
+	});
+
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+	consumer.join();
+
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(lastValues == std::vector<int>(sensorCount, updateCount - 1));
+}
@@ -0,0 +1,225 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// OPT-66: Tests for ColumnEventQueue
+
+#include "test.h"
+#include "eventpp/columneventqueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Point
+{
+	int x;
+	int y;
+};
+
+} //unnamed namespace
+
+TEST_CASE("ColumnEventQueue, process in order across chunks")
+{
+	using EQ = eventpp::ColumnEventQueue<int, void (int, int), eventpp::DefaultPolicies, 4>;
+	EQ queue;
+
+	std::vector<int> valueList;
+	queue.appendListener(1, [&valueList](int, int n) { valueList.push_back(n); });
+	queue.appendListener(2, [&valueList](int, int n) { valueList.push_back(-n); });
+
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(! queue.process());
+
+	for(int i = 0; i < 10; ++i) {
+		queue.enqueue(i % 2 == 0 ? 1 : 2, i);
+	}
+	REQUIRE(queue.getQueuedEventCount() == 10);
+	REQUIRE(! queue.emptyQueue());
+
+	REQUIRE(queue.process());
+	REQUIRE(valueList == std::vector<int> { 0, -1, 2, -3, 4, -5, 6, -7, 8, -9 });
+	REQUIRE(queue.emptyQueue());
+
+	// The chunks are reused.
+	queue.enqueue(1, 100);
+	queue.process();
+	REQUIRE(valueList.back() == 100);
+}
+
+TEST_CASE("ColumnEventQueue, event is excluded from the arguments")
+{
+	struct Policies
+	{
+		static int getEvent(const Point & point) {
+			return point.x;
+		}
+	};
+	using EQ = eventpp::ColumnEventQueue<int, void (const Point &), Policies>;
+	EQ queue;
+
+	int sum = 0;
+	queue.appendListener(3, [&sum](const Point & point) { sum += point.y; });
+	queue.enqueue(Point { 3, 5 });
+	queue.enqueue(Point { 4, 100 });
+	queue.enqueue(Point { 3, 7 });
+	queue.process();
+	REQUIRE(sum == 12);
+}
+
+TEST_CASE("ColumnEventQueue, clearEvents")
+{
+	using EQ = eventpp::ColumnEventQueue<int, void (int, double), eventpp::DefaultPolicies, 8>;
+	EQ queue;
+
+	int count = 0;
+	queue.appendListener(1, [&count](int, double) { ++count; });
+	for(int i = 0; i < 100; ++i) {
+		queue.enqueue(1, 1.5);
+	}
+	queue.clearEvents();
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(! queue.process());
+	REQUIRE(count == 0);
+
+	queue.enqueue(1, 1.5);
+	queue.process();
+	REQUIRE(count == 1);
+}
+
+TEST_CASE("ColumnEventQueue, processIf keeps the other events in order")
+{
+	using EQ = eventpp::ColumnEventQueue<int, void (int, int), eventpp::DefaultPolicies, 2>;
+	EQ queue;
+
+	std::vector<int> valueList;
+	queue.appendListener(1, [&valueList](int, int n) { valueList.push_back(n); });
+
+	for(int i = 0; i < 7; ++i) {
+		queue.enqueue(1, i);
+	}
+	REQUIRE(queue.processIf([](int, int n) { return n % 3 == 0; }));
+	REQUIRE(valueList == std::vector<int> { 0, 3, 6 });
+	REQUIRE(queue.getQueuedEventCount() == 4);
+
+	queue.enqueue(1, 7);
+	REQUIRE(! queue.processIf([]() { return false; }));
+	REQUIRE(queue.getQueuedEventCount() == 5);
+
+	queue.process();
+	REQUIRE(valueList == std::vector<int> { 0, 3, 6, 1, 2, 4, 5, 7 });
+}
+
+TEST_CASE("ColumnEventQueue, processQueueWith and processColumnsWith")
+{
+	using EQ = eventpp::ColumnEventQueue<int, void (int, float), eventpp::DefaultPolicies, 16>;
+	EQ queue;
+
+	for(int i = 0; i < 40; ++i) {
+		queue.enqueue(i % 4, static_cast<float>(i));
+	}
+	float sum = 0;
+	REQUIRE(queue.processQueueWith([&sum](const int event, int, const float value) {
+		if(event == 0) {
+			sum += value;
+		}
+	}));
+	REQUIRE(sum == 180.0f);
+
+	for(int i = 0; i < 40; ++i) {
+		queue.enqueue(i % 4, static_cast<float>(i));
+	}
+	std::vector<std::size_t> countList;
+	int matchedCount = 0;
+	REQUIRE(queue.processColumnsWith([&countList, &matchedCount](const int * events, const int *, const float * values, const std::size_t count) {
+		countList.push_back(count);
+		for(std::size_t i = 0; i < count; ++i) {
+			if(events[i] == 1) {
+				REQUIRE(static_cast<int>(values[i]) % 4 == 1);
+				++matchedCount;
+			}
+		}
+	}));
+	REQUIRE(countList == std::vector<std::size_t> { 16, 16, 8 });
+	REQUIRE(matchedCount == 10);
+	REQUIRE(! queue.processColumnsWith([](const int *, const int *, const float *, std::size_t) {}));
+}
+
+TEST_CASE("ColumnEventQueue, copy and move only the listeners")
+{
+	using EQ = eventpp::ColumnEventQueue<int, void (int)>;
+	EQ queue;
+
+	int count = 0;
+	queue.appendListener(1, [&count](int) { ++count; });
+	queue.enqueue(1);
+
+	EQ copied(queue);
+	REQUIRE(copied.emptyQueue());
+	copied.enqueue(1);
+	copied.process();
+	REQUIRE(count == 1);
+
+	EQ moved(std::move(copied));
+	moved.enqueue(1);
+	moved.process();
+	REQUIRE(count == 2);
+
+	queue.process();
+	REQUIRE(count == 3);
+}
+
+TEST_CASE("ColumnEventQueue, multiple producers and one consumer")
+{
+	using EQ = eventpp::ColumnEventQueue<int, void (int, int), eventpp::DefaultPolicies, 32>;
+	EQ queue;
+
+	constexpr int threadCount = 4;
+	constexpr int eventCountPerThread = 1000;
+	std::atomic<int> sum(0);
+	std::atomic<int> processedCount(0);
+	queue.appendListener(1, [&sum, &processedCount](int, int n) {
+		sum += n;
+		++processedCount;
+	});
+
+	std::atomic<bool> stopped(false);
+	std::thread consumer([&queue, &stopped]() {
+		while(! stopped.load()) {
+			if(queue.waitFor(std::chrono::milliseconds(10))) {
+				queue.process();
+			}
+		}
+		queue.process();
+	});
+
+	std::vector<std::thread> producerList;
+	for(int t = 0; t < threadCount; ++t) {
+		producerList.emplace_back([&queue]() {
+			for(int i = 0; i < eventCountPerThread; ++i) {
+				queue.enqueue(1, 1);
+			}
+		});
+	}
+	for(auto & thread : producerList) {
+		thread.join();
+	}
+	stopped = true;
+	consumer.join();
+
+	REQUIRE(processedCount.load() == threadCount * eventCountPerThread);
+	REQUIRE(sum.load() == threadCount * eventCountPerThread);
+}
@@ -0,0 +1,200 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// OPT-62: Tests for CompactEventDispatcher and StripedMutex
+
+#include "test.h"
+#include "eventpp/compacteventdispatcher.h"
+#include "eventpp/eventdispatcher.h"
+#include "eventpp/utilities/scopedremover.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST_CASE("CompactEventDispatcher, append, dispatch and remove")
+{
+	using ED = eventpp::CompactEventDispatcher<int, void (std::vector<int> &)>;
+	ED dispatcher;
+
+	auto h1 = dispatcher.appendListener(3, [](std::vector<int> & v) { v.push_back(1); });
+	dispatcher.appendListener(3, [](std::vector<int> & v) { v.push_back(2); });
+	dispatcher.prependListener(3, [](std::vector<int> & v) { v.push_back(3); });
+	dispatcher.insertListener(3, [](std::vector<int> & v) { v.push_back(4); }, h1);
+	auto h5 = dispatcher.appendListener(5, [](std::vector<int> & v) { v.push_back(5); });
+
+	REQUIRE(dispatcher.getEventCount() == 2);
+	REQUIRE(dispatcher.hasAnyListener(3));
+	REQUIRE(dispatcher.ownsHandle(3, h1));
+	REQUIRE(! dispatcher.ownsHandle(5, h1));
+
+	std::vector<int> dataList;
+	dispatcher.dispatch(3, dataList);
+	dispatcher.dispatch(5, dataList);
+	dispatcher.dispatch(6, dataList);
+	REQUIRE(dataList == std::vector<int>{ 3, 4, 1, 2, 5 });
+
+	// The last listener of 5 erases the event.
+	REQUIRE(dispatcher.removeListener(5, h5));
+	REQUIRE(! dispatcher.removeListener(5, h5));
+	REQUIRE(dispatcher.getEventCount() == 1);
+	REQUIRE(! dispatcher.hasAnyListener(5));
+
+	REQUIRE(dispatcher.removeListener(3, h1));
+	REQUIRE(dispatcher.getEventCount() == 1);
+
+	// Added again after it's erased.
+	dispatcher.appendListener(5, [](std::vector<int> & v) { v.push_back(6); });
+	dataList.clear();
+	dispatcher.dispatch(5, dataList);
+	REQUIRE(dataList == std::vector<int>{ 6 });
+}
+
+TEST_CASE("CompactEventDispatcher, the listener removes itself in dispatching")
+{
+	using ED = eventpp::CompactEventDispatcher<int, void ()>;
+	ED dispatcher;
+	ED::Handle handle;
+	int count = 0;
+
+	handle = dispatcher.appendListener(1, [&dispatcher, &handle, &count]() {
+		++count;
+		// The list is erased from the map, it's alive until dispatch returns.
+		dispatcher.removeListener(1, handle);
+		dispatcher.appendListener(1, [&count]() {
+			count += 10;
+		});
+	});
+
+	dispatcher.dispatch(1);
+	REQUIRE(count == 1);
+	dispatcher.dispatch(1);
+	REQUIRE(count == 11);
+}
+
+TEST_CASE("CompactEventDispatcher, compact, ListenerGroup and ScopedRemover")
+{
+	struct Policies
+	{
+		using ListenerGroups = eventpp::ListenerGroupsEnabled;
+	};
+	using ED = eventpp::CompactEventDispatcher<int, void (int &), Policies>;
+	ED dispatcher;
+
+	{
+		eventpp::ScopedRemover<ED> remover(dispatcher);
+		for(int i = 0; i < 100; ++i) {
+			remover.appendListener(i, [](int & value) { ++value; });
+		}
+		dispatcher.appendListener(0, [](int & value) { value += 10; });
+		REQUIRE(dispatcher.getEventCount() == 100);
+
+		int value = 0;
+		dispatcher.dispatch(7, value);
+		REQUIRE(value == 1);
+	}
+
+	// The group unlinks its listeners lazily, compact walks the lists.
+	REQUIRE(dispatcher.compact() == 99);
+	REQUIRE(dispatcher.getEventCount() == 1);
+	REQUIRE(dispatcher.compact() == 0);
+
+	int value = 0;
+	dispatcher.dispatch(0, value);
+	REQUIRE(value == 10);
+}
+
+TEST_CASE("CompactEventDispatcher, copy, move and swap")
+{
+	using ED = eventpp::CompactEventDispatcher<int, void (int &)>;
+	ED dispatcher;
+	dispatcher.appendListener(1, [](int & value) { value += 1; });
+	dispatcher.appendListener(2, [](int & value) { value += 2; });
+
+	ED copied(dispatcher);
+	dispatcher.appendListener(1, [](int & value) { value += 100; });
+	int value = 0;
+	copied.dispatch(1, value);
+	copied.dispatch(2, value);
+	REQUIRE(value == 3);
+
+	ED moved(std::move(copied));
+	REQUIRE(copied.getEventCount() == 0);
+	value = 0;
+	moved.dispatch(1, value);
+	REQUIRE(value == 1);
+
+	ED other;
+	swap(other, moved);
+	REQUIRE(moved.getEventCount() == 0);
+	REQUIRE(other.getEventCount() == 2);
+
+	ED assigned;
+	assigned = dispatcher;
+	value = 0;
+	assigned.dispatch(1, value);
+	REQUIRE(value == 101);
+}
+
+TEST_CASE("CompactEventDispatcher, the list is smaller than the list of EventDispatcher")
+{
+	using Compact = eventpp::CompactEventDispatcher<int, void ()>;
+	using CompactList = eventpp::CallbackList<void (), eventpp::internal_::CompactCallbackListPolicies<eventpp::DefaultPolicies, 64> >;
+
+	REQUIRE(sizeof(eventpp::StripedMutex<>) < sizeof(std::mutex));
+	REQUIRE(sizeof(CompactList) + sizeof(std::mutex) <= sizeof(eventpp::CallbackList<void ()>) + sizeof(int));
+	REQUIRE(sizeof(std::shared_ptr<CompactList>) <= 16);
+	REQUIRE(sizeof(Compact::Handle) == sizeof(eventpp::EventDispatcher<int, void ()>::Handle));
+}
+
+TEST_CASE("CompactEventDispatcher, multi threading, dispatch while add and remove")
+{
+	using ED = eventpp::CompactEventDispatcher<int, void (std::atomic<int> &)>;
+	ED dispatcher;
+	constexpr int eventCount = 64;
+	constexpr int iterateCount = 2000;
+
+	dispatcher.appendListener(0, [](std::atomic<int> & value) { ++value; });
+
+	std::atomic<bool> stop(false);
+	std::atomic<int> value(0);
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < 2; ++i) {
+		threadList.emplace_back([&dispatcher, &stop, &value]() {
+			int event = 0;
+			while(! stop.load()) {
+				dispatcher.dispatch(event, value);
+				event = (event + 1) % eventCount;
+			}
+		});
+	}
+	for(int i = 0; i < 2; ++i) {
+		threadList.emplace_back([&dispatcher, i]() {
+			for(int k = 0; k < iterateCount; ++k) {
+				const int event = 1 + (k * 2 + i) % (eventCount - 1);
+				auto handle = dispatcher.appendListener(event, [](std::atomic<int> & value) { ++value; });
+				dispatcher.removeListener(event, handle);
+			}
+		});
+	}
+	threadList[2].join();
+	threadList[3].join();
+	stop = true;
+	threadList[0].join();
+	threadList[1].join();
+
+	REQUIRE(dispatcher.getEventCount() == 1);
+	value = 0;
+	dispatcher.dispatch(0, value);
+	REQUIRE(value.load() == 1);
+}
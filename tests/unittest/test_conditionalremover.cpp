@@ -16,6 +16,10 @@
 #include "eventpp/eventqueue.h"
 #include "eventpp/hetereventqueue.h"
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 TEST_CASE("ConditionalRemover, EventQueue")
 {
 	eventpp::EventQueue<int, void ()> dispatcher;
@@ -353,3 +357,62 @@ TEST_CASE("ConditionalRemover, HeterEventQueue")
 	REQUIRE(dataList == std::vector<int> { 5, 2, 3, 4 });
 }
 
+namespace {
+
+struct ListenerGroupPolicies
+{
+	using ListenerGroups = eventpp::ListenerGroupsEnabled;
+};
+
+template <typename Policies>
+void testCalledOnceAfterConditionIsMet()
+{
+	eventpp::CallbackList<void (int), Policies> callbackList;
+	constexpr int threadCount = 8;
+	constexpr int callCountPerThread = 1000;
+
+	std::atomic<int> callCount(0);
+	std::atomic<int> lastCallCount(0);
+	eventpp::conditionalRemover(callbackList).append([&callCount](int) {
+		++callCount;
+	}, [&lastCallCount](int n) -> bool {
+		if(n == callCountPerThread / 2) {
+			++lastCallCount;
+			return true;
+		}
+		return false;
+	});
+
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < threadCount; ++i) {
+		threadList.emplace_back([&callbackList]() {
+			for(int k = 0; k < callCountPerThread; ++k) {
+				callbackList(k);
+			}
+		});
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	// Each call before the removal calls the listener, except the calls
+	// which meet the condition after another one did.
+	REQUIRE(lastCallCount.load() >= 1);
+	REQUIRE(callCount.load() <= threadCount * (callCountPerThread / 2) + 1);
+	REQUIRE(callCount.load() >= callCountPerThread / 2 + 1);
+	callbackList(0);
+	REQUIRE(callbackList.empty());
+}
+
+} //unnamed namespace
+
+TEST_CASE("ConditionalRemover, multi threading, the listener is called once after the condition is met")
+{
+	testCalledOnceAfterConditionIsMet<eventpp::DefaultPolicies>();
+}
+
+TEST_CASE("ConditionalRemover, multi threading, ListenerGroupsEnabled")
+{
+	// The listener is removed by its group, not by its handle.
+	testCalledOnceAfterConditionIsMet<ListenerGroupPolicies>();
+}
@@ -0,0 +1,172 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/utilities/consumerpool.h"
+#include "eventpp/eventqueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct CountedPolicies
+{
+	using QueueCapacity = eventpp::QueueCapacityLimited;
+};
+
+using EQ = eventpp::EventQueue<int, void (int), CountedPolicies>;
+
+template <typename Predicate>
+bool waitUntil(Predicate predicate)
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(20);
+	while(! predicate()) {
+		if(std::chrono::steady_clock::now() > deadline) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+} //unnamed namespace
+
+TEST_CASE("ConsumerPool, scales up on a backlog and down when idle")
+{
+	EQ queue;
+	std::atomic<int> sum(0);
+	queue.appendListener(1, [&sum](const int value) {
+		// As a listener which waits for I/O.
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+		sum += value;
+	});
+
+	eventpp::ConsumerPoolOptions options;
+	options.minConsumerCount = 1;
+	options.maxConsumerCount = 4;
+	options.controlInterval = std::chrono::milliseconds(2);
+	options.scaleUpDepth = 8;
+	options.scaleDownDepth = 0;
+	options.scaleDownIntervalCount = 3;
+	options.stopCheckInterval = std::chrono::milliseconds(2);
+	eventpp::ConsumerPool<EQ> pool(queue, options);
+
+	std::mutex decisionMutex;
+	std::vector<eventpp::ConsumerPoolStats> decisionList;
+	pool.setDecisionCallback([&decisionMutex, &decisionList](const eventpp::ConsumerPoolStats & stats) {
+		std::lock_guard<std::mutex> lockGuard(decisionMutex);
+		decisionList.push_back(stats);
+	});
+
+	const int eventCount = 2000;
+	for(int i = 1; i <= eventCount; ++i) {
+		queue.enqueue(1, i);
+	}
+	pool.start();
+	REQUIRE(pool.isRunning());
+
+	REQUIRE(waitUntil([&pool, eventCount]() {
+		return pool.getStats().eventCount == static_cast<std::uint64_t>(eventCount);
+	}));
+	REQUIRE(sum == eventCount * (eventCount + 1) / 2);
+	REQUIRE(pool.getStats().scaleUpCount > 0);
+
+	// Parked one by one after the queue is empty.
+	REQUIRE(waitUntil([&pool]() {
+		const eventpp::ConsumerPoolStats stats = pool.getStats();
+		return stats.consumerCount == 1 && stats.scaleDownCount == stats.scaleUpCount;
+	}));
+	const eventpp::ConsumerPoolStats stats = pool.getStats();
+	REQUIRE(stats.queueDepth == 0);
+	REQUIRE(stats.residency == 0);
+	REQUIRE(stats.batchSize == options.minBatchSize);
+
+	pool.stop();
+	REQUIRE(! pool.isRunning());
+
+	std::size_t maxConsumerCount = 0;
+	std::size_t maxBatchSize = 0;
+	for(const auto & decision : decisionList) {
+		maxConsumerCount = (std::max)(maxConsumerCount, decision.consumerCount);
+		maxBatchSize = (std::max)(maxBatchSize, decision.batchSize);
+		REQUIRE(decision.consumerCount >= options.minConsumerCount);
+		REQUIRE(decision.consumerCount <= options.maxConsumerCount);
+		REQUIRE(decision.batchSize >= options.minBatchSize);
+		REQUIRE(decision.batchSize <= options.maxBatchSize);
+	}
+	REQUIRE(maxConsumerCount > 1);
+	// Large batches while the queue was deep.
+	REQUIRE(maxBatchSize > options.minBatchSize);
+}
+
+TEST_CASE("ConsumerPool, residency scales up a shallow but slow queue")
+{
+	EQ queue;
+	std::atomic<int> count(0);
+	queue.appendListener(1, [&count](int) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		++count;
+	});
+
+	eventpp::ConsumerPoolOptions options;
+	options.maxConsumerCount = 2;
+	options.controlInterval = std::chrono::milliseconds(5);
+	// The depth never scales up, only the residency does.
+	options.scaleUpDepth = 1000;
+	options.scaleUpResidency = std::chrono::milliseconds(10);
+	options.scaleDownIntervalCount = 1000;
+	eventpp::ConsumerPool<EQ> pool(queue, options);
+
+	for(int i = 0; i < 100; ++i) {
+		queue.enqueue(1, i);
+	}
+	pool.start();
+	REQUIRE(waitUntil([&pool]() {
+		return pool.getStats().consumerCount == 2;
+	}));
+	pool.stop();
+	REQUIRE(count == 100);
+}
+
+TEST_CASE("ConsumerPool, stop drains the queue")
+{
+	EQ queue;
+	std::atomic<int> count(0);
+	queue.appendListener(1, [&count](int) {
+		++count;
+	});
+
+	eventpp::ConsumerPoolOptions options;
+	options.minConsumerCount = 2;
+	options.maxConsumerCount = 2;
+	eventpp::ConsumerPool<EQ> pool(queue, options);
+	pool.start();
+	for(int i = 0; i < 1000; ++i) {
+		queue.enqueue(1, i);
+	}
+	pool.stop();
+	REQUIRE(count == 1000);
+	REQUIRE(queue.getQueuedEventCount() == 0);
+
+	// It can be started again.
+	pool.start();
+	queue.enqueue(1, 0);
+	pool.stop();
+	REQUIRE(count == 1001);
+	REQUIRE(pool.getStats().eventCount == 1001);
+}
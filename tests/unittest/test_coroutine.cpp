@@ -0,0 +1,265 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/eventdispatcher.h"
+#include "eventpp/utilities/coroutine.h"
+
+#if EVENTPP_HAS_COROUTINE
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// A coroutine which is kept when it's done, so the test can destroy it.
+struct KeptTask
+{
+	struct promise_type
+	{
+		KeptTask get_return_object() noexcept {
+			return KeptTask { std::coroutine_handle<promise_type>::from_promise(*this) };
+		}
+
+		std::suspend_never initial_suspend() noexcept {
+			return {};
+		}
+
+		std::suspend_always final_suspend() noexcept {
+			return {};
+		}
+
+		void return_void() noexcept {
+		}
+
+		void unhandled_exception() noexcept {
+			std::terminate();
+		}
+	};
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+using EQ = eventpp::EventQueue<int, void (int)>;
+
+eventpp::EventTask takeNext(EQ & queue, std::vector<int> & dataList)
+{
+	auto item = co_await queue.next();
+	dataList.push_back(item ? item->getArgument<0>() : -1);
+}
+
+} //unnamed namespace
+
+TEST_CASE("Coroutine, next takes an event in the queue without suspending")
+{
+	EQ queue;
+	std::vector<int> dataList;
+
+	queue.enqueue(1, 5);
+	takeNext(queue, dataList);
+	REQUIRE(dataList == std::vector<int> { 5 });
+	REQUIRE(queue.emptyQueue());
+}
+
+TEST_CASE("Coroutine, next is resumed by enqueue")
+{
+	EQ queue;
+	std::vector<int> dataList;
+
+	takeNext(queue, dataList);
+	takeNext(queue, dataList);
+	REQUIRE(dataList.empty());
+
+	queue.enqueue(1, 5);
+	REQUIRE(dataList == std::vector<int> { 5 });
+	queue.enqueue(1, 6);
+	REQUIRE(dataList == std::vector<int> { 5, 6 });
+	REQUIRE(queue.emptyQueue());
+}
+
+TEST_CASE("Coroutine, next is resumed by the executor")
+{
+	EQ queue;
+	eventpp::CoroutineExecutor executor;
+	std::vector<int> dataList;
+
+	[](EQ & queue, eventpp::CoroutineExecutor & executor, std::vector<int> & dataList) -> eventpp::EventTask {
+		auto item = co_await queue.next(executor);
+		dataList.push_back(item->getArgument<0>());
+	}(queue, executor, dataList);
+
+	queue.enqueue(1, 5);
+	REQUIRE(dataList.empty());
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(executor.poll() == 1);
+	REQUIRE(dataList == std::vector<int> { 5 });
+}
+
+TEST_CASE("Coroutine, batch")
+{
+	EQ queue;
+	std::vector<int> dataList;
+
+	auto consume = [](EQ & queue, std::vector<int> & dataList) -> eventpp::EventTask {
+		auto events = co_await queue.batch(3);
+		for(const auto & item : events) {
+			dataList.push_back(item.getArgument<0>());
+		}
+	};
+
+	consume(queue, dataList);
+	queue.enqueue(1, 1);
+	REQUIRE(dataList == std::vector<int> { 1 });
+
+	dataList.clear();
+	{
+		EQ::DisableQueueNotify disableNotify(&queue);
+		consume(queue, dataList);
+		for(int i = 2; i <= 6; ++i) {
+			queue.enqueue(1, i);
+		}
+		REQUIRE(dataList.empty());
+	}
+	REQUIRE(dataList == std::vector<int> { 2, 3, 4 });
+	REQUIRE(queue.processOne());
+	REQUIRE(! queue.emptyQueue());
+}
+
+TEST_CASE("Coroutine, cancelAwaiters")
+{
+	EQ queue;
+	std::vector<int> dataList;
+
+	takeNext(queue, dataList);
+	takeNext(queue, dataList);
+	queue.cancelAwaiters();
+	REQUIRE(dataList == std::vector<int> { -1, -1 });
+
+	queue.enqueue(1, 5);
+	REQUIRE(dataList.size() == 2);
+	REQUIRE(! queue.emptyQueue());
+}
+
+TEST_CASE("Coroutine, a destroyed coroutine is not resumed")
+{
+	EQ queue;
+	std::vector<int> dataList;
+
+	auto consume = [](EQ & queue, std::vector<int> & dataList) -> KeptTask {
+		auto item = co_await queue.next();
+		dataList.push_back(item->getArgument<0>());
+	};
+
+	KeptTask task1 = consume(queue, dataList);
+	KeptTask task2 = consume(queue, dataList);
+	KeptTask task3 = consume(queue, dataList);
+	task2.handle.destroy();
+
+	queue.enqueue(1, 1);
+	queue.enqueue(1, 3);
+	REQUIRE(dataList == std::vector<int> { 1, 3 });
+	REQUIRE(task1.handle.done());
+	REQUIRE(task3.handle.done());
+	task1.handle.destroy();
+	task3.handle.destroy();
+}
+
+TEST_CASE("Coroutine, coroutine listeners")
+{
+	eventpp::EventDispatcher<int, void (int)> dispatcher;
+	eventpp::CoroutineExecutor executor;
+	std::vector<int> dataList;
+
+	dispatcher.appendListener(1, [&executor, &dataList](const int n) -> eventpp::EventTask {
+		dataList.push_back(n);
+		co_await executor.schedule();
+		dataList.push_back(n * 10);
+	});
+
+	dispatcher.dispatch(1, 2);
+	dispatcher.dispatch(1, 3);
+	REQUIRE(dataList == std::vector<int> { 2, 3 });
+	REQUIRE(executor.poll() == 2);
+	REQUIRE(dataList == std::vector<int> { 2, 3, 20, 30 });
+}
+
+TEST_CASE("Coroutine, multi threading, many coroutines on a few threads")
+{
+	EQ queue;
+	eventpp::CoroutineExecutor executor;
+
+	constexpr int consumerCount = 200;
+	constexpr int producerCount = 4;
+	constexpr int eventCountPerProducer = 5000;
+
+	std::atomic<int> eventCount(0);
+	std::atomic<long long> sum(0);
+	std::atomic<int> doneCount(0);
+
+	auto consume = [](EQ & queue, eventpp::CoroutineExecutor & executor,
+		std::atomic<int> & eventCount, std::atomic<long long> & sum, std::atomic<int> & doneCount) -> eventpp::EventTask {
+		for(;;) {
+			auto item = co_await queue.next(executor);
+			if(! item) {
+				break;
+			}
+			sum += item->getArgument<0>();
+			++eventCount;
+		}
+		++doneCount;
+	};
+	for(int i = 0; i < consumerCount; ++i) {
+		consume(queue, executor, eventCount, sum, doneCount);
+	}
+
+	std::vector<std::thread> runnerList;
+	for(int i = 0; i < 2; ++i) {
+		runnerList.emplace_back([&executor]() {
+			executor.run();
+		});
+	}
+
+	std::vector<std::thread> producerList;
+	for(int t = 0; t < producerCount; ++t) {
+		producerList.emplace_back([&queue]() {
+			for(int i = 1; i <= eventCountPerProducer; ++i) {
+				queue.enqueue(1, i);
+			}
+		});
+	}
+	for(auto & thread : producerList) {
+		thread.join();
+	}
+
+	while(eventCount.load() < producerCount * eventCountPerProducer) {
+		std::this_thread::yield();
+	}
+	queue.cancelAwaiters();
+	while(doneCount.load() < consumerCount) {
+		std::this_thread::yield();
+		// A consumer which is running while the awaiters are cancelled waits again.
+		queue.cancelAwaiters();
+	}
+	executor.stop();
+	for(auto & thread : runnerList) {
+		thread.join();
+	}
+
+	REQUIRE(eventCount.load() == producerCount * eventCountPerProducer);
+	REQUIRE(sum.load() == (long long)producerCount * eventCountPerProducer * (eventCountPerProducer + 1) / 2);
+	REQUIRE(queue.emptyQueue());
+}
+
+#endif
@@ -16,6 +16,10 @@
 #include "eventpp/eventdispatcher.h"
 #include "eventpp/hetereventdispatcher.h"
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 TEST_CASE("CounterRemover, EventDispatcher")
 {
 	eventpp::EventDispatcher<int, void ()> dispatcher;
@@ -241,3 +245,136 @@ TEST_CASE("CounterRemover, HeterCallbackList")
 	REQUIRE(dataList == std::vector<int> { 4, 1, 2, 3 });
 }
 
+namespace {
+
+struct ListenerGroupPolicies
+{
+	using ListenerGroups = eventpp::ListenerGroupsEnabled;
+};
+
+template <typename Policies>
+void testCalledTriggerCountTimes()
+{
+	eventpp::CallbackList<void (), Policies> callbackList;
+	constexpr int threadCount = 8;
+	constexpr int triggerCount = 1000;
+
+	std::atomic<int> callCount(0);
+	eventpp::counterRemover(callbackList).append([&callCount]() {
+		++callCount;
+	}, triggerCount);
+
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < threadCount; ++i) {
+		threadList.emplace_back([&callbackList]() {
+			for(int k = 0; k < triggerCount; ++k) {
+				callbackList();
+			}
+		});
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	REQUIRE(callCount.load() == triggerCount);
+	// The node is unlinked by the next call.
+	callbackList();
+	REQUIRE(callbackList.empty());
+}
+
+template <typename Policies>
+void testOneShotListenersCalledOnce()
+{
+	eventpp::EventDispatcher<int, void (int), Policies> dispatcher;
+	constexpr int threadCount = 8;
+	constexpr int listenerCount = 1000;
+	const int event = 3;
+
+	std::vector<std::atomic<int> > callCountList(listenerCount);
+	for(int i = 0; i < listenerCount; ++i) {
+		callCountList[i] = 0;
+		eventpp::counterRemover(dispatcher).appendListener(event, [i, &callCountList](int) {
+			++callCountList[i];
+		});
+	}
+
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < threadCount; ++i) {
+		threadList.emplace_back([&dispatcher, event]() {
+			for(int k = 0; k < 10; ++k) {
+				dispatcher.dispatch(event, k);
+			}
+		});
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	for(int i = 0; i < listenerCount; ++i) {
+		REQUIRE(callCountList[i].load() == 1);
+	}
+	dispatcher.dispatch(event, 0);
+	REQUIRE(! dispatcher.hasAnyListener(event));
+}
+
+} //unnamed namespace
+
+TEST_CASE("CounterRemover, multi threading, a listener is called triggerCount times")
+{
+	testCalledTriggerCountTimes<eventpp::DefaultPolicies>();
+}
+
+TEST_CASE("CounterRemover, multi threading, one shot listeners are called once")
+{
+	testOneShotListenersCalledOnce<eventpp::DefaultPolicies>();
+}
+
+TEST_CASE("CounterRemover, multi threading, ListenerGroupsEnabled")
+{
+	// The listeners are removed by their groups, not by their handles.
+	testCalledTriggerCountTimes<ListenerGroupPolicies>();
+	testOneShotListenersCalledOnce<ListenerGroupPolicies>();
+}
+
+TEST_CASE("CounterRemover, multi threading, listeners added while dispatching are removed")
+{
+	// The listeners may be called by the dispatching threads before their
+	// handles are set.
+	eventpp::EventDispatcher<int, void (int)> dispatcher;
+	eventpp::CallbackList<void ()> callbackList;
+	constexpr int threadCount = 4;
+	constexpr int listenerCount = 2000;
+	const int event = 3;
+
+	std::atomic<bool> stopped(false);
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < threadCount; ++i) {
+		threadList.emplace_back([&dispatcher, &callbackList, &stopped, event]() {
+			while(! stopped.load()) {
+				dispatcher.dispatch(event, 0);
+				callbackList();
+			}
+		});
+	}
+
+	std::atomic<int> callCount(0);
+	for(int i = 0; i < listenerCount; ++i) {
+		eventpp::counterRemover(dispatcher).appendListener(event, [&callCount](int) {
+			++callCount;
+		});
+		eventpp::counterRemover(callbackList).append([&callCount]() {
+			++callCount;
+		});
+	}
+	stopped = true;
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	// The listeners which were added after the last dispatching are left.
+	dispatcher.dispatch(event, 0);
+	callbackList();
+	REQUIRE(callCount.load() == listenerCount * 2);
+	REQUIRE(! dispatcher.hasAnyListener(event));
+	REQUIRE(callbackList.empty());
+}
@@ -14,10 +14,29 @@
 #include "test.h"
 #include "eventpp/eventdispatcher.h"
 #include "eventpp/mixins/mixinfilter.h"
+#include "eventpp/utilities/concurrentlistenermap.h"
+#include "eventpp/utilities/flatarraymap.h"
 
 #include <numeric>
 #include <random>
 
+namespace {
+
+template <std::size_t size>
+struct FlatArrayMapPolicies
+{
+	template <typename Key, typename T>
+	using Map = eventpp::FlatArrayMap<Key, T, size>;
+};
+
+struct ConcurrentListenerMapPolicies
+{
+	template <typename Key, typename T>
+	using Map = eventpp::ConcurrentListenerMap<Key, T>;
+};
+
+} //unnamed namespace
+
 TEST_CASE("EventDispatcher, std::string, void (const std::string &)")
 {
 	eventpp::EventDispatcher<std::string, void (const std::string &)> dispatcher;
@@ -512,6 +531,128 @@ TEST_CASE("EventDispatcher, event filter")
 	}
 }
 
+TEST_CASE("EventDispatcher, event filter with events")
+{
+	struct MyPolicies {
+		using Mixins = eventpp::MixinList<eventpp::MixinFilter>;
+		using ArgumentPassingMode = eventpp::ArgumentPassingExcludeEvent;
+	};
+	using ED = eventpp::EventDispatcher<int, void (std::vector<int> &), MyPolicies>;
+	ED dispatcher;
+
+	// The filters don't receive the event, they log their index.
+	auto makeFilter = [](const int index) {
+		return [index](std::vector<int> & log) -> bool {
+			log.push_back(index);
+			return true;
+		};
+	};
+
+	SECTION("Filters are called in the order they were appended") {
+		dispatcher.appendFilter(makeFilter(0));
+		dispatcher.appendFilter({ 1, 2 }, makeFilter(1));
+		dispatcher.appendFilter(makeFilter(2));
+		dispatcher.appendFilter(std::vector<int> { 2 }, makeFilter(3));
+
+		std::vector<int> log;
+		dispatcher.dispatch(1, log);
+		REQUIRE(log == std::vector<int> { 0, 1, 2 });
+
+		log.clear();
+		dispatcher.dispatch(2, log);
+		REQUIRE(log == std::vector<int> { 0, 1, 2, 3 });
+
+		log.clear();
+		dispatcher.dispatch(3, log);
+		REQUIRE(log == std::vector<int> { 0, 2 });
+	}
+
+	SECTION("A filter for some events blocks only them") {
+		dispatcher.appendFilter({ 5 }, [](std::vector<int> &) -> bool {
+			return false;
+		});
+		int count = 0;
+		dispatcher.appendListener(5, [&count](std::vector<int> &) {
+			++count;
+		});
+		dispatcher.appendListener(6, [&count](std::vector<int> &) {
+			++count;
+		});
+
+		std::vector<int> log;
+		dispatcher.dispatch(5, log);
+		REQUIRE(count == 0);
+		dispatcher.dispatch(6, log);
+		REQUIRE(count == 1);
+	}
+
+	SECTION("removeFilter") {
+		auto handle1 = dispatcher.appendFilter(makeFilter(1));
+		auto handle2 = dispatcher.appendFilter({ 1 }, makeFilter(2));
+		REQUIRE(handle1);
+		REQUIRE(handle2);
+
+		REQUIRE(dispatcher.removeFilter(handle2));
+		REQUIRE(! dispatcher.removeFilter(handle2));
+		std::vector<int> log;
+		dispatcher.dispatch(1, log);
+		REQUIRE(log == std::vector<int> { 1 });
+
+		REQUIRE(dispatcher.removeFilter(handle1));
+		REQUIRE(! dispatcher.removeFilter(ED::FilterHandle()));
+		log.clear();
+		dispatcher.dispatch(1, log);
+		REQUIRE(log.empty());
+	}
+
+	SECTION("More than 64 filters") {
+		constexpr int filterCount = 150;
+		std::vector<int> expectedList;
+		for(int i = 0; i < filterCount; ++i) {
+			if(i % 3 == 0) {
+				dispatcher.appendFilter({ 1 }, makeFilter(i));
+				expectedList.push_back(i);
+			}
+			else {
+				dispatcher.appendFilter({ 2 }, makeFilter(i));
+			}
+		}
+		std::vector<int> log;
+		dispatcher.dispatch(1, log);
+		REQUIRE(log == expectedList);
+	}
+
+	SECTION("A filter appends a filter") {
+		dispatcher.appendFilter([&dispatcher, &makeFilter](std::vector<int> & log) -> bool {
+			log.push_back(0);
+			if(log.size() == 1) {
+				dispatcher.appendFilter(makeFilter(1));
+			}
+			return true;
+		});
+		std::vector<int> log;
+		dispatcher.dispatch(1, log);
+		// The new filter is called from the next dispatch.
+		REQUIRE(log == std::vector<int> { 0 });
+		log.clear();
+		dispatcher.dispatch(1, log);
+		REQUIRE(log == std::vector<int> { 0, 1 });
+	}
+
+	SECTION("Copy") {
+		dispatcher.appendFilter({ 1 }, makeFilter(1));
+		ED copied(dispatcher);
+		dispatcher.appendFilter(makeFilter(2));
+
+		std::vector<int> log;
+		copied.dispatch(1, log);
+		REQUIRE(log == std::vector<int> { 1 });
+		log.clear();
+		dispatcher.dispatch(1, log);
+		REQUIRE(log == std::vector<int> { 1, 2 });
+	}
+}
+
 TEST_CASE("EventDispatcher, explicit single threading, int, void (int)")
 {
 	struct MyEventPolicies
@@ -543,3 +684,225 @@ TEST_CASE("EventDispatcher, explicit single threading, int, void (int)")
 	REQUIRE(b == 10);
 }
 
+
+TEST_CASE("EventDispatcher, FlatArrayMap, int, void (int)")
+{
+	eventpp::EventDispatcher<int, void (int), FlatArrayMapPolicies<16> > dispatcher;
+
+	std::vector<int> dataList(3);
+	dispatcher.appendListener(0, [&dataList](int value) { dataList[0] += value; });
+	dispatcher.appendListener(15, [&dataList](int value) { dataList[1] += value; });
+	auto handle = dispatcher.appendListener(15, [&dataList](int value) { dataList[2] += value; });
+
+	REQUIRE(dispatcher.hasAnyListener(0));
+	REQUIRE(! dispatcher.hasAnyListener(1));
+	REQUIRE(! dispatcher.hasAnyListener(16));
+	REQUIRE(! dispatcher.hasAnyListener(-1));
+
+	dispatcher.dispatch(0);
+	dispatcher.dispatch(15);
+	// Out of range events are ignored as the events which have no listener.
+	dispatcher.dispatch(16);
+	dispatcher.dispatch(-1);
+	REQUIRE(dataList == std::vector<int>{ 0, 15, 15 });
+
+	REQUIRE(dispatcher.removeListener(15, handle));
+	dispatcher.dispatch(15);
+	REQUIRE(dataList == std::vector<int>{ 0, 30, 15 });
+
+	decltype(dispatcher) copied(dispatcher);
+	copied.dispatch(15);
+	REQUIRE(dataList == std::vector<int>{ 0, 45, 15 });
+}
+
+TEST_CASE("EventDispatcher, ConcurrentListenerMap, std::string, void (const std::string &)")
+{
+	eventpp::EventDispatcher<std::string, void (const std::string &), ConcurrentListenerMapPolicies> dispatcher;
+
+	std::vector<std::string> eventList;
+	std::vector<std::string> dispatchedList;
+	for(int i = 0; i < 100; ++i) {
+		eventList.push_back("event" + std::to_string(i));
+		dispatcher.appendListener(eventList.back(), [&dispatchedList](const std::string & e) {
+			dispatchedList.push_back(e);
+		});
+	}
+	auto handle = dispatcher.prependListener("event0", [&dispatchedList](const std::string &) {
+		dispatchedList.push_back("first");
+	});
+
+	REQUIRE(dispatcher.hasAnyListener("event99"));
+	REQUIRE(! dispatcher.hasAnyListener("event100"));
+
+	for(const auto & e : eventList) {
+		dispatcher.dispatch(e);
+	}
+	dispatcher.dispatch("event100");
+	REQUIRE(dispatchedList.size() == 101);
+	REQUIRE(dispatchedList[0] == "first");
+	REQUIRE(dispatchedList[1] == "event0");
+	REQUIRE(dispatchedList.back() == "event99");
+
+	REQUIRE(dispatcher.removeListener("event0", handle));
+	dispatchedList.clear();
+	decltype(dispatcher) copied(dispatcher);
+	copied.dispatch("event0");
+	copied.appendListener("event100", [&dispatchedList](const std::string & e) {
+		dispatchedList.push_back(e);
+	});
+	copied.dispatch("event100");
+	dispatcher.dispatch("event100");
+	REQUIRE(dispatchedList == std::vector<std::string>{ "event0", "event100" });
+
+	decltype(dispatcher) moved(std::move(copied));
+	moved.dispatch("event50");
+	dispatcher = moved;
+	dispatcher.dispatch("event100");
+	REQUIRE(dispatchedList == std::vector<std::string>{ "event0", "event100", "event50", "event100" });
+}
+
+TEST_CASE("EventDispatcher, seal")
+{
+	eventpp::EventDispatcher<int, void (int)> dispatcher;
+
+	std::vector<int> dataList(3);
+	dispatcher.appendListener(1, [&dataList](int value) { dataList[0] += value; });
+	dispatcher.appendListener(2, [&dataList](int value) { dataList[1] += value; });
+
+	REQUIRE(! dispatcher.isSealed());
+	dispatcher.seal();
+	REQUIRE(dispatcher.isSealed());
+
+	dispatcher.dispatch(1);
+	dispatcher.dispatch(2);
+	dispatcher.dispatch(3);
+	REQUIRE(dataList == std::vector<int>{ 1, 2, 0 });
+
+	// Existing events can still get new listeners, new events can't.
+	auto handle = dispatcher.appendListener(1, [&dataList](int value) { dataList[2] += value; });
+	REQUIRE(handle);
+	REQUIRE(! dispatcher.appendListener(3, [&dataList](int value) { dataList[2] += value; }));
+	REQUIRE(! dispatcher.prependListener(3, [&dataList](int value) { dataList[2] += value; }));
+	REQUIRE(! dispatcher.hasAnyListener(3));
+
+	dispatcher.dispatch(1);
+	dispatcher.dispatch(3);
+	REQUIRE(dataList == std::vector<int>{ 2, 2, 1 });
+
+	REQUIRE(dispatcher.removeListener(1, handle));
+	dispatcher.dispatch(1);
+	REQUIRE(dataList == std::vector<int>{ 3, 2, 1 });
+}
+
+TEST_CASE("EventDispatcher, seal, FlatArrayMap accepts any event in range")
+{
+	eventpp::EventDispatcher<int, void (int), FlatArrayMapPolicies<8> > dispatcher;
+	dispatcher.seal();
+
+	int value = 0;
+	REQUIRE(dispatcher.appendListener(7, [&value](int v) { value += v; }));
+	REQUIRE(! dispatcher.appendListener(8, [&value](int v) { value += v; }));
+	dispatcher.dispatch(7);
+	dispatcher.dispatch(8);
+	REQUIRE(value == 7);
+}
+
+TEST_CASE("EventDispatcher, reserveEvents")
+{
+	eventpp::EventDispatcher<int, void (int)> dispatcher;
+	dispatcher.reserveEvents(100);
+
+	int value = 0;
+	for(int i = 0; i < 100; ++i) {
+		dispatcher.appendListener(i, [&value](int v) { value += v; });
+	}
+	for(int i = 0; i < 100; ++i) {
+		dispatcher.dispatch(i);
+	}
+	REQUIRE(value == 4950);
+
+	// std::map and FlatArrayMap have no reserve, it does nothing.
+	eventpp::EventDispatcher<int, void (int), FlatArrayMapPolicies<8> > flatDispatcher;
+	flatDispatcher.reserveEvents(100);
+	REQUIRE(flatDispatcher.appendListener(7, [&value](int v) { value += v; }));
+	flatDispatcher.dispatch(7);
+	REQUIRE(value == 4957);
+}
+
+TEST_CASE("EventDispatcher, dispatch with compile-time event")
+{
+	using Event3 = std::integral_constant<int, 3>;
+	using ED = eventpp::EventDispatcher<int, void (int)>;
+	ED dispatcher;
+	std::vector<int> dataList(3);
+
+	// Not found, not cached, the listener added later is seen.
+	dispatcher.dispatch<Event3>(1);
+	dispatcher.appendListener(3, [&dataList](int value) { dataList[0] += value; });
+	dispatcher.dispatch<Event3>(2);
+	dispatcher.appendListener(3, [&dataList](int value) { dataList[1] += value; });
+	dispatcher.dispatch<Event3>(3);
+	REQUIRE(dataList == std::vector<int>{ 5, 3, 0 });
+
+	// Another dispatcher of the same type in the same thread.
+	ED other;
+	other.appendListener(3, [&dataList](int value) { dataList[2] += value; });
+	other.dispatch<Event3>(10);
+	dispatcher.dispatch<Event3>(1);
+	REQUIRE(dataList == std::vector<int>{ 6, 4, 10 });
+
+	// After assignment the cached list of the old map is not used.
+	dispatcher = other;
+	other = ED();
+	dispatcher.dispatch<Event3>(100);
+	other.dispatch<Event3>(1000);
+	REQUIRE(dataList == std::vector<int>{ 6, 4, 110 });
+
+	ED::ListenerRef ref = dispatcher.getListenerRef<Event3>();
+	REQUIRE(ref);
+	REQUIRE(ref.hasAnyListener());
+	ref.dispatch(5);
+	REQUIRE(dataList == std::vector<int>{ 6, 4, 115 });
+
+	// getListenerRef adds the event, so the ref sees the later listeners.
+	ED::ListenerRef ref5 = dispatcher.getListenerRef(5);
+	REQUIRE(ref5);
+	REQUIRE(! ref5.hasAnyListener());
+	dispatcher.appendListener(5, [&dataList](int value) { dataList[0] += value; });
+	ref5.dispatch(4);
+	REQUIRE(dataList == std::vector<int>{ 10, 4, 115 });
+
+	dispatcher.seal();
+	REQUIRE(! dispatcher.getListenerRef(6));
+	REQUIRE(dispatcher.getListenerRef(5));
+}
+
+TEST_CASE("EventDispatcher, appendListener with priority")
+{
+	struct Policies
+	{
+		using ListenerGroups = eventpp::ListenerGroupsEnabled;
+	};
+	eventpp::EventDispatcher<int, void (std::vector<int> &), Policies> dispatcher;
+	auto makeCallback = [](const int id) {
+		return [id](std::vector<int> & idList) {
+			idList.push_back(id);
+		};
+	};
+
+	dispatcher.appendListener(1, makeCallback(1), 1);
+	dispatcher.appendListener(1, makeCallback(2), 3);
+	dispatcher.appendListener(2, makeCallback(3), 0);
+	dispatcher.appendListener(1, makeCallback(4), 2);
+	eventpp::ListenerGroup group;
+	dispatcher.appendListener(1, makeCallback(5), 3, group);
+
+	std::vector<int> idList;
+	dispatcher.dispatch(1, idList);
+	REQUIRE(idList == std::vector<int>{ 2, 5, 4, 1 });
+
+	group.removeAll();
+	idList.clear();
+	dispatcher.dispatch(1, idList);
+	REQUIRE(idList == std::vector<int>{ 2, 4, 1 });
+}
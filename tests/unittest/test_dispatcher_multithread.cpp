@@ -13,11 +13,36 @@
 
 #include "test.h"
 #include "eventpp/eventdispatcher.h"
+#include "eventpp/mixins/mixinfilter.h"
+#include "eventpp/utilities/concurrentlistenermap.h"
+#include "eventpp/utilities/shardedsharedmutex.h"
 
 #include <thread>
+#include <atomic>
 #include <numeric>
 #include <random>
 #include <algorithm>
+#include <shared_mutex>
+
+namespace {
+
+struct ConcurrentListenerMapPolicies
+{
+	template <typename Key, typename T>
+	using Map = eventpp::ConcurrentListenerMap<Key, T>;
+};
+
+struct ShardedSharedMutexPolicies
+{
+	using Threading = eventpp::GeneralThreading<
+		std::mutex,
+		std::atomic,
+		std::condition_variable,
+		eventpp::ShardedSharedMutex<8>
+	>;
+};
+
+} //unnamed namespace
 
 TEST_CASE("EventDispatcher, multi threading, int, void (int)")
 {
@@ -69,3 +94,189 @@ TEST_CASE("EventDispatcher, multi threading, int, void (int)")
 	REQUIRE(eventList == dataList);
 }
 
+
+TEST_CASE("EventDispatcher, multi threading, ConcurrentListenerMap, dispatch while adding events")
+{
+	using ED = eventpp::EventDispatcher<int, void (int), ConcurrentListenerMapPolicies>;
+	ED dispatcher;
+
+	constexpr int eventCount = 1024 * 4;
+	constexpr int dispatchThreadCount = 4;
+
+	std::vector<std::atomic<int> > dataList(eventCount);
+	for(auto & data : dataList) {
+		data.store(0);
+	}
+	std::atomic<int> addedCount(0);
+
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < dispatchThreadCount; ++i) {
+		threadList.emplace_back([&dispatcher, &addedCount]() {
+			// The map grows several times while the events are dispatched.
+			while(addedCount.load(std::memory_order_acquire) < eventCount) {
+				const int count = addedCount.load(std::memory_order_acquire);
+				for(int e = 0; e < count; ++e) {
+					dispatcher.dispatch(e);
+				}
+				dispatcher.dispatch(eventCount + 1);
+			}
+		});
+	}
+	for(int e = 0; e < eventCount; ++e) {
+		dispatcher.appendListener(e, [&dataList](const int value) {
+			++dataList[value];
+		});
+		addedCount.store(e + 1, std::memory_order_release);
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	for(int e = 0; e < eventCount; ++e) {
+		dispatcher.dispatch(e);
+	}
+	for(int e = 0; e < eventCount; ++e) {
+		REQUIRE(dataList[e].load() > 0);
+	}
+}
+
+TEST_CASE("ShardedSharedMutex, multi threading")
+{
+	// Less shards than threads, so some threads share a shard.
+	eventpp::ShardedSharedMutex<4> mutex;
+	constexpr int threadCount = 8;
+	constexpr int iterateCount = 1024 * 4;
+
+	int first = 0;
+	int second = 0;
+	std::atomic<int> mismatchCount(0);
+
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < threadCount; ++i) {
+		threadList.emplace_back([i, &mutex, &first, &second, &mismatchCount]() {
+			for(int k = 0; k < iterateCount; ++k) {
+				if(k % 16 == i % 2) {
+					std::unique_lock<eventpp::ShardedSharedMutex<4> > lockGuard(mutex);
+					++first;
+					++second;
+				}
+				else {
+					std::shared_lock<eventpp::ShardedSharedMutex<4> > lockGuard(mutex);
+					if(first != second) {
+						++mismatchCount;
+					}
+				}
+			}
+		});
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	REQUIRE(mismatchCount.load() == 0);
+	REQUIRE(first == threadCount * iterateCount / 16);
+	REQUIRE(second == first);
+
+	REQUIRE(mutex.try_lock());
+	REQUIRE(! mutex.try_lock_shared());
+	mutex.unlock();
+	REQUIRE(mutex.try_lock_shared());
+	REQUIRE(! mutex.try_lock());
+	mutex.unlock_shared();
+}
+
+TEST_CASE("EventDispatcher, multi threading, ShardedSharedMutex, dispatch while adding listeners")
+{
+	using ED = eventpp::EventDispatcher<int, void (int), ShardedSharedMutexPolicies>;
+	ED dispatcher;
+
+	constexpr int eventCount = 1024;
+	constexpr int dispatchThreadCount = 4;
+
+	std::vector<std::atomic<int> > dataList(eventCount);
+	for(auto & data : dataList) {
+		data.store(0);
+	}
+	std::atomic<int> addedCount(0);
+
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < dispatchThreadCount; ++i) {
+		threadList.emplace_back([&dispatcher, &addedCount]() {
+			while(addedCount.load(std::memory_order_acquire) < eventCount) {
+				const int count = addedCount.load(std::memory_order_acquire);
+				for(int e = 0; e < count; ++e) {
+					dispatcher.dispatch(e);
+				}
+			}
+		});
+	}
+	for(int e = 0; e < eventCount; ++e) {
+		dispatcher.appendListener(e, [&dataList](const int value) {
+			++dataList[value];
+		});
+		addedCount.store(e + 1, std::memory_order_release);
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	for(int e = 0; e < eventCount; ++e) {
+		dispatcher.dispatch(e);
+		REQUIRE(dataList[e].load() > 0);
+	}
+}
+
+TEST_CASE("EventDispatcher, multi threading, MixinFilter, dispatch while changing filters")
+{
+	struct MyPolicies {
+		using Mixins = eventpp::MixinList<eventpp::MixinFilter>;
+	};
+	using ED = eventpp::EventDispatcher<int, void (int), MyPolicies>;
+	ED dispatcher;
+
+	constexpr int eventCount = 16;
+	constexpr int dispatchThreadCount = 4;
+	constexpr int roundCount = 2000;
+
+	std::atomic<int> blockedCount(0);
+	std::atomic<int> passedCount(0);
+	std::atomic<bool> stopped(false);
+	for(int e = 0; e < eventCount; ++e) {
+		dispatcher.appendListener(e, [&passedCount](int) {
+			++passedCount;
+		});
+	}
+	// Event 0 is always blocked, whatever the other filters are.
+	dispatcher.appendFilter({ 0 }, [&blockedCount](int) -> bool {
+		++blockedCount;
+		return false;
+	});
+
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < dispatchThreadCount; ++i) {
+		threadList.emplace_back([&dispatcher, &stopped]() {
+			while(! stopped.load(std::memory_order_acquire)) {
+				for(int e = 0; e < eventCount; ++e) {
+					dispatcher.dispatch(e);
+				}
+			}
+		});
+	}
+	for(int i = 0; i < roundCount; ++i) {
+		const int e = i % eventCount;
+		auto handle = dispatcher.appendFilter({ e }, [](int) -> bool {
+			return true;
+		});
+		dispatcher.removeFilter(handle);
+	}
+	stopped.store(true, std::memory_order_release);
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	const int passed = passedCount.load();
+	dispatcher.dispatch(0);
+	dispatcher.dispatch(1);
+	REQUIRE(passedCount.load() == passed + 1);
+	REQUIRE(blockedCount.load() > 0);
+}
@@ -13,6 +13,7 @@
 
 #include "test.h"
 #include "eventpp/utilities/eventmaker.h"
+#include "eventpp/utilities/intrusiveptr.h"
 
 enum class EventType
 {
@@ -127,3 +128,34 @@ TEST_CASE("eventmake, EventDrawGS with auto getter/setter")
 	REQUIRE(e.getText() == "world");
 }
 
+
+class PooledEvent : public eventpp::IntrusiveRefCounted
+{
+public:
+	explicit PooledEvent(const EventType type) : type(type) {}
+
+	EventType getType() const {
+		return type;
+	}
+
+private:
+	EventType type;
+};
+
+EVENTPP_MAKE_POOLED_EVENT(PooledEventDraw, PooledEvent, EventType::draw, (std::string, getText, setText), (int, getX));
+EVENTPP_MAKE_POOLED_EMPTY_EVENT(PooledEventUpdate, PooledEvent, EventType::update);
+
+TEST_CASE("eventmake, pooled events")
+{
+	eventpp::IntrusivePtr<PooledEventDraw> draw = PooledEventDraw::create("Hello", 5);
+	REQUIRE(draw->getType() == EventType::draw);
+	REQUIRE(draw->getText() == "Hello");
+	REQUIRE(draw->getX() == 5);
+	REQUIRE(draw->getReferenceCount() == 1);
+
+	eventpp::IntrusivePtr<PooledEvent> base = draw;
+	REQUIRE(draw->getReferenceCount() == 2);
+
+	eventpp::IntrusivePtr<PooledEvent> update = PooledEventUpdate::create();
+	REQUIRE(update->getType() == EventType::update);
+}
@@ -0,0 +1,138 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/utilities/eventname.h"
+#include "eventpp/utilities/anyid.h"
+#include "eventpp/eventdispatcher.h"
+#include "eventpp/eventqueue.h"
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace eventpp::literals;
+
+namespace {
+
+// The hash is computed by the compiler.
+constexpr eventpp::EventName orderFilled = "order.filled"_evt;
+static_assert(orderFilled.getHash() == eventpp::eventname_internal_::getNameHash("order.filled", 12), "");
+static_assert(orderFilled.getSize() == 12, "");
+static_assert(orderFilled == "order.filled"_evt, "");
+static_assert(orderFilled != "order.cancelled"_evt, "");
+static_assert(eventpp::EventName() == ""_evt, "");
+
+struct EventNameMapPolicies
+{
+	template <typename Key, typename T>
+	using Map = std::map<Key, T>;
+};
+
+} //namespace
+
+TEST_CASE("EventName, compare")
+{
+	const char buffer[] = "order.filled";
+	// Same characters at another address.
+	const eventpp::EventName copied(buffer, 12);
+	REQUIRE(copied.getData() != orderFilled.getData());
+	REQUIRE(copied == orderFilled);
+	REQUIRE(std::hash<eventpp::EventName>()(copied) == std::hash<eventpp::EventName>()(orderFilled));
+
+	REQUIRE(orderFilled != eventpp::EventName(buffer, 11));
+	REQUIRE(orderFilled.toString() == "order.filled");
+
+	REQUIRE(! (orderFilled < orderFilled));
+	const eventpp::EventName other = "order.new"_evt;
+	REQUIRE((orderFilled < other) != (other < orderFilled));
+}
+
+TEST_CASE("EventName, intern")
+{
+	std::string name = "runtime.";
+	name += "name";
+	const eventpp::EventName a = eventpp::EventName::intern(name);
+	name = "something else";
+	const eventpp::EventName b = eventpp::EventName::intern(std::string("runtime.name"));
+
+	// The interned characters are kept, and shared by the same names.
+	REQUIRE(a.toString() == "runtime.name");
+	REQUIRE(a.getData() == b.getData());
+	REQUIRE(a == "runtime.name"_evt);
+
+	std::vector<std::thread> threadList;
+	std::vector<const char *> dataList(8);
+	for(std::size_t i = 0; i < dataList.size(); ++i) {
+		threadList.emplace_back([i, &dataList]() {
+			dataList[i] = eventpp::EventName::intern("threaded.name").getData();
+		});
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+	REQUIRE(std::vector<const char *>(dataList.size(), dataList.front()) == dataList);
+}
+
+TEST_CASE("EventName, EventDispatcher, unordered_map and map")
+{
+	std::vector<int> dataList(3);
+	auto test = [&dataList](auto & dispatcher) {
+		dispatcher.appendListener("order.filled"_evt, [&dataList]() {
+			++dataList[0];
+		});
+		dispatcher.appendListener("order.cancelled"_evt, [&dataList]() {
+			++dataList[1];
+		});
+		dispatcher.appendListener(eventpp::EventName::intern("order.new"), [&dataList]() {
+			++dataList[2];
+		});
+
+		dispatcher.dispatch(orderFilled);
+		dispatcher.dispatch("order.cancelled"_evt);
+		dispatcher.dispatch("order.new"_evt);
+		dispatcher.dispatch("order.unknown"_evt);
+	};
+
+	SECTION("unordered_map") {
+		eventpp::EventDispatcher<eventpp::EventName, void ()> dispatcher;
+		test(dispatcher);
+	}
+	SECTION("map") {
+		eventpp::EventDispatcher<eventpp::EventName, void (), EventNameMapPolicies> dispatcher;
+		test(dispatcher);
+	}
+	REQUIRE(dataList == std::vector<int> { 1, 1, 1 });
+}
+
+TEST_CASE("EventName, AnyId")
+{
+	using Id = eventpp::AnyId<std::hash, eventpp::EventName>;
+	eventpp::EventQueue<Id, void (int)> queue;
+
+	int sum = 0;
+	queue.appendListener("order.filled"_evt, [&sum](const int n) {
+		sum += n;
+	});
+	queue.appendListener("order.cancelled"_evt, [&sum](const int n) {
+		sum -= n;
+	});
+
+	REQUIRE(Id("order.filled"_evt).getDigest() == std::hash<eventpp::EventName>()(orderFilled));
+	queue.enqueue(orderFilled, 5);
+	queue.enqueue("order.cancelled"_evt, 2);
+	queue.enqueue("order.unknown"_evt, 100);
+	queue.process();
+	REQUIRE(sum == 3);
+}
@@ -0,0 +1,87 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/mixins/mixinfilter.h"
+
+#include <string>
+#include <vector>
+
+// The types are used by other translation units, so they aren't in an
+// unnamed namespace.
+namespace instantiationtest {
+
+struct FilterPolicies
+{
+	using Mixins = eventpp::MixinList<eventpp::MixinFilter>;
+};
+
+using InstantiatedQueue = eventpp::EventQueue<int, void (const std::string &)>;
+using InstantiatedMixinQueue = eventpp::EventQueue<int, void (int), FilterPolicies>;
+
+} //namespace instantiationtest
+
+using instantiationtest::InstantiatedQueue;
+using instantiationtest::InstantiatedMixinQueue;
+
+// As in the header which declares the queue types.
+EVENTPP_EXTERN_TEMPLATE_EVENTQUEUE(InstantiatedQueue);
+EVENTPP_EXTERN_TEMPLATE_EVENTQUEUE(InstantiatedMixinQueue);
+
+TEST_CASE("EventQueue, extern template instantiation")
+{
+	InstantiatedQueue queue;
+	std::vector<std::string> textList;
+	queue.appendListener(1, [&textList](const std::string & text) {
+		textList.push_back(text);
+	});
+
+	queue.enqueue(1, "a");
+	queue.enqueue(1, "b");
+	queue.enqueue(1, "c");
+	REQUIRE(! queue.emptyQueue());
+	queue.wait();
+	REQUIRE(queue.processOne());
+	REQUIRE(queue.processN(1));
+	std::size_t count = 0;
+	REQUIRE(queue.processN(5, &count));
+	REQUIRE(count == 1);
+	REQUIRE(textList == std::vector<std::string>{ "a", "b", "c" });
+
+	queue.enqueue(1, "d");
+	queue.clearEvents();
+	REQUIRE(! queue.process());
+	REQUIRE(queue.emptyQueue());
+}
+
+TEST_CASE("EventQueue, extern template instantiation with mixins")
+{
+	InstantiatedMixinQueue queue;
+	int sum = 0;
+	queue.appendListener(1, [&sum](const int value) {
+		sum += value;
+	});
+	queue.appendFilter([](int & value) -> bool {
+		return value > 0;
+	});
+
+	queue.enqueue(1, 5);
+	queue.enqueue(1, -1);
+	REQUIRE(queue.process());
+	REQUIRE(sum == 5);
+}
+
+// As in the one source file.
+EVENTPP_INSTANTIATE_EVENTQUEUE(InstantiatedQueue);
+EVENTPP_INSTANTIATE_EVENTQUEUE(InstantiatedMixinQueue);
@@ -215,6 +215,47 @@ TEST_CASE("HeterCallbackList, remove")
 	REQUIRE(dataList == std::vector<int>{ 5, 1, 3, 6, 4 });
 }
 
+TEST_CASE("HeterCallbackList, handles after swap and move")
+{
+	using CL = eventpp::HeterCallbackList<eventpp::HeterTuple<void (), void (int), void (int, int)> >;
+	CL callbackList;
+
+	std::vector<int> dataList(3);
+	auto h1 = callbackList.append([&dataList]() {
+		++dataList[0];
+	});
+	auto h2 = callbackList.append([&dataList](int) {
+		++dataList[1];
+	});
+	callbackList.append([&dataList](int, int) {
+		++dataList[2];
+	});
+
+	// The list of each prototype is moved with its nodes, the handles stay valid.
+	CL other;
+	other.swap(callbackList);
+	REQUIRE(callbackList.empty());
+
+	CL moved(std::move(other));
+	moved();
+	moved(1);
+	moved(1, 2);
+	REQUIRE(dataList == std::vector<int>{ 1, 1, 1 });
+
+	REQUIRE(moved.remove(h2));
+	REQUIRE(moved.remove(h1));
+	REQUIRE(! moved.empty());
+	moved();
+	moved(1);
+	moved(1, 2);
+	REQUIRE(dataList == std::vector<int>{ 1, 1, 2 });
+
+	// The copy has its own nodes, the handles of the original don't remove them.
+	CL copied(moved);
+	copied(1, 2);
+	REQUIRE(dataList == std::vector<int>{ 1, 1, 3 });
+}
+
 TEST_CASE("HeterCallbackList, forEach")
 {
 	using CL = eventpp::HeterCallbackList<eventpp::HeterTuple<int (), int(int)> >;
@@ -595,3 +595,25 @@ TEST_CASE("HeterEventDispatcher, event filter")
 
 }
 
+
+TEST_CASE("HeterEventDispatcher, dispatch with compile-time event")
+{
+	using Event3 = std::integral_constant<int, 3>;
+	using ED = eventpp::HeterEventDispatcher<int, eventpp::HeterTuple<void (), void (int)> >;
+	ED dispatcher;
+	std::vector<int> dataList(3);
+
+	dispatcher.dispatch<Event3>(1);
+	dispatcher.appendListener(3, [&dataList]() { ++dataList[0]; });
+	dispatcher.appendListener(3, [&dataList](int value) { dataList[1] += value; });
+	dispatcher.dispatch<Event3>();
+	dispatcher.dispatch<Event3>(5);
+	dispatcher.dispatch<Event3>(6);
+	REQUIRE(dataList == std::vector<int>{ 1, 11, 0 });
+
+	ED other(dispatcher);
+	other.appendListener(3, [&dataList](int value) { dataList[2] += value; });
+	other.dispatch<Event3>(2);
+	dispatcher.dispatch<Event3>(1);
+	REQUIRE(dataList == std::vector<int>{ 1, 14, 2 });
+}
@@ -15,6 +15,8 @@
 #include "eventpp/hetereventdispatcher.h"
 
 #include <thread>
+#include <atomic>
+#include <string>
 #include <numeric>
 #include <random>
 #include <algorithm>
@@ -78,3 +80,55 @@ TEST_CASE("HeterEventDispatcher, multi threading")
 	REQUIRE(eventList == dataList);
 }
 
+TEST_CASE("HeterEventDispatcher, multi threading, dispatch while appending listeners of other prototypes")
+{
+	using ED = eventpp::HeterEventDispatcher<int, eventpp::HeterTuple<void (int), void (int, int), void (const std::string &)> >;
+	ED dispatcher;
+
+	constexpr int eventCount = 64;
+	constexpr int dispatchThreadCount = 4;
+
+	std::atomic<int> intCount(0);
+	std::atomic<int> otherCount(0);
+	for(int e = 0; e < eventCount; ++e) {
+		dispatcher.appendListener(e, [&intCount](int) {
+			++intCount;
+		});
+	}
+
+	std::atomic<bool> stopped(false);
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < dispatchThreadCount; ++i) {
+		threadList.emplace_back([&dispatcher, &stopped]() {
+			while(! stopped.load(std::memory_order_acquire)) {
+				for(int e = 0; e < eventCount; ++e) {
+					dispatcher.dispatch(e, e);
+					dispatcher.dispatch(e, e, e);
+					dispatcher.dispatch(e, std::string("a"));
+				}
+			}
+		});
+	}
+	// The lists of the other prototypes get their first listeners while
+	// the dispatching threads read them.
+	for(int e = 0; e < eventCount; ++e) {
+		dispatcher.appendListener(e, [&otherCount](int, int) {
+			++otherCount;
+		});
+		dispatcher.appendListener(e, [&otherCount](const std::string &) {
+			++otherCount;
+		});
+	}
+	stopped.store(true, std::memory_order_release);
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	const int count = otherCount.load();
+	for(int e = 0; e < eventCount; ++e) {
+		dispatcher.dispatch(e, e, e);
+		dispatcher.dispatch(e, std::string("b"));
+	}
+	REQUIRE(otherCount.load() == count + eventCount * 2);
+	REQUIRE(intCount.load() > 0);
+}
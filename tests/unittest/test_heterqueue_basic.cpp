@@ -14,6 +14,13 @@
 #include "test.h"
 #include "eventpp/hetereventqueue.h"
 
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
 TEST_CASE("HeterEventQueue, clearEvents")
 {
 	eventpp::HeterEventQueue<int, eventpp::HeterTuple<void (), void (int)> > queue;
@@ -223,3 +230,297 @@ TEST_CASE("HeterEventQueue, processIf")
 	REQUIRE(dataList == std::vector<int>{ 4, 4, 4 });
 }
 
+
+TEST_CASE("HeterEventQueue, enqueueBulk")
+{
+	eventpp::HeterEventQueue<int, eventpp::HeterTuple<void (), void (int)> > queue;
+
+	std::vector<int> dataList(2);
+	queue.appendListener(5, [&dataList]() {
+		++dataList[0];
+	});
+	queue.appendListener(7, [&dataList](int n) {
+		dataList[1] += n;
+	});
+
+	SECTION("iterator range, void ()") {
+		const std::vector<int> eventList { 5, 5, 5 };
+		queue.enqueueBulk(eventList.begin(), eventList.end());
+		queue.process();
+		REQUIRE(dataList == std::vector<int>{ 3, 0 });
+	}
+
+	SECTION("iterator range, void (int)") {
+		const std::vector<std::tuple<int, int> > itemList {
+			std::make_tuple(7, 1),
+			std::make_tuple(7, 2)
+		};
+		queue.enqueue(5);
+		queue.enqueueBulk(itemList.begin(), itemList.end());
+		queue.process();
+		REQUIRE(dataList == std::vector<int>{ 1, 3 });
+	}
+
+	SECTION("generator") {
+		queue.enqueueBulk(4, [](const size_t index) {
+			return std::make_tuple(7, (int)index);
+		});
+		REQUIRE(! queue.emptyQueue());
+		queue.process();
+		REQUIRE(dataList == std::vector<int>{ 0, 6 });
+	}
+}
+
+namespace {
+
+struct HeterPackedPolicies
+{
+	using QueueStorage = eventpp::QueueStoragePacked;
+};
+
+struct HeterPoolListPolicies
+{
+	template <typename T>
+	using QueueList = eventpp::PoolQueueList<T, 64>;
+};
+
+} //namespace
+
+TEST_CASE("HeterEventQueue, QueueStoragePacked")
+{
+	using Large = std::array<char, 200>;
+	eventpp::HeterEventQueue<int, eventpp::HeterTuple<void (), void (int), void (const std::string &), void (const Large &)>, HeterPackedPolicies> queue;
+
+	std::vector<int> dataList;
+	queue.appendListener(1, [&dataList]() {
+		dataList.push_back(0);
+	});
+	queue.appendListener(1, [&dataList](int n) {
+		dataList.push_back(n);
+	});
+	queue.appendListener(1, [&dataList](const std::string & s) {
+		dataList.push_back((int)s.size());
+	});
+	queue.appendListener(1, [&dataList](const Large & large) {
+		dataList.push_back(large[0]);
+	});
+
+	SECTION("process keeps the order of different prototypes") {
+		// Enough events to grow the buffer more than once.
+		std::vector<int> expected;
+		for(int i = 0; i < 100; ++i) {
+			queue.enqueue(1);
+			expected.push_back(0);
+			queue.enqueue(1, i);
+			expected.push_back(i);
+			queue.enqueue(1, std::string(i, 'a'));
+			expected.push_back(i);
+			Large large {};
+			large[0] = (char)(i % 100);
+			queue.enqueue(1, large);
+			expected.push_back(i % 100);
+		}
+		REQUIRE(! queue.emptyQueue());
+		REQUIRE(queue.process());
+		REQUIRE(queue.emptyQueue());
+		REQUIRE(dataList == expected);
+
+		REQUIRE(! queue.process());
+
+		// The buffers are reused.
+		dataList.clear();
+		queue.enqueue(1, 5);
+		queue.enqueue(1, std::string("abc"));
+		REQUIRE(queue.process());
+		REQUIRE(dataList == std::vector<int>{ 5, 3 });
+	}
+
+	SECTION("processOne") {
+		queue.enqueue(1, 5);
+		queue.enqueue(1, std::string("ab"));
+		queue.enqueue(1);
+		REQUIRE(queue.processOne());
+		REQUIRE(dataList == std::vector<int>{ 5 });
+		queue.enqueue(1, 7);
+		REQUIRE(queue.processOne());
+		REQUIRE(queue.processOne());
+		REQUIRE(queue.processOne());
+		REQUIRE(dataList == std::vector<int>{ 5, 2, 0, 7 });
+		REQUIRE(! queue.processOne());
+		REQUIRE(queue.emptyQueue());
+	}
+
+	SECTION("processIf") {
+		queue.enqueue(1, 5);
+		queue.enqueue(1, std::string("ab"));
+		queue.enqueue(1, 6);
+		queue.enqueue(1, std::string("abc"));
+		REQUIRE(queue.processIf([](const std::string & s) -> bool { return s.size() == 3; }));
+		REQUIRE(dataList == std::vector<int>{ 3 });
+		REQUIRE(queue.processIf([](const int n) -> bool { return n == 6; }));
+		REQUIRE(dataList == std::vector<int>{ 3, 6 });
+		REQUIRE(! queue.processIf([](const int n) -> bool { return n == 8; }));
+		REQUIRE(queue.process());
+		REQUIRE(dataList == std::vector<int>{ 3, 6, 5, 2 });
+	}
+
+	SECTION("enqueueBulk") {
+		queue.enqueue(1, 9);
+		queue.enqueueBulk(3, [](const size_t index) {
+			return std::make_tuple(1, std::string(index, 'a'));
+		});
+		const std::vector<std::tuple<int, int> > itemList {
+			std::make_tuple(1, 10),
+			std::make_tuple(1, 11)
+		};
+		queue.enqueueBulk(itemList.begin(), itemList.end());
+		REQUIRE(queue.process());
+		REQUIRE(dataList == std::vector<int>{ 9, 0, 1, 2, 10, 11 });
+	}
+}
+
+TEST_CASE("HeterEventQueue, QueueStoragePacked destroys the events")
+{
+	eventpp::HeterEventQueue<int, eventpp::HeterTuple<void (std::shared_ptr<int>), void (int)>, HeterPackedPolicies> queue;
+	queue.appendListener(1, [](std::shared_ptr<int>) {});
+
+	std::shared_ptr<int> data = std::make_shared<int>(5);
+	for(int i = 0; i < 50; ++i) {
+		queue.enqueue(1, data);
+		queue.enqueue(1, i);
+	}
+	REQUIRE(data.use_count() == 51);
+
+	SECTION("process") {
+		queue.process();
+		REQUIRE(data.use_count() == 1);
+	}
+
+	SECTION("processOne") {
+		queue.processOne();
+		REQUIRE(data.use_count() == 50);
+	}
+
+	SECTION("processIf") {
+		queue.processIf([](int) -> bool { return true; });
+		REQUIRE(data.use_count() == 51);
+		queue.processIf([](std::shared_ptr<int>) -> bool { return true; });
+		REQUIRE(data.use_count() == 1);
+	}
+
+	SECTION("clearEvents") {
+		queue.clearEvents();
+		REQUIRE(queue.emptyQueue());
+		REQUIRE(data.use_count() == 1);
+	}
+
+	SECTION("destructor") {
+		{
+			eventpp::HeterEventQueue<int, eventpp::HeterTuple<void (std::shared_ptr<int>)>, HeterPackedPolicies> other;
+			other.enqueue(1, data);
+			other.enqueue(1, data);
+			REQUIRE(data.use_count() == 53);
+		}
+		REQUIRE(data.use_count() == 51);
+	}
+}
+
+TEST_CASE("HeterEventQueue, QueueList policy")
+{
+	eventpp::HeterEventQueue<int, eventpp::HeterTuple<void (), void (int)>, HeterPoolListPolicies> queue;
+
+	std::vector<int> dataList(2);
+	queue.appendListener(3, [&dataList]() {
+		++dataList[0];
+	});
+	queue.appendListener(3, [&dataList](int n) {
+		dataList[1] += n;
+	});
+
+	for(int i = 0; i < 3; ++i) {
+		queue.enqueue(3);
+		queue.enqueue(3, 2);
+		queue.process();
+	}
+	queue.enqueue(3, 5);
+	queue.processOne();
+	REQUIRE(dataList == std::vector<int>{ 3, 11 });
+	REQUIRE(queue.emptyQueue());
+}
+
+namespace {
+
+struct HeterRecordingVisitor
+{
+	void operator() (const int event) {
+		dataList.push_back(event * 100);
+	}
+
+	void operator() (const int event, const int n) {
+		dataList.push_back(event * 100 + n);
+	}
+
+	void operator() (const int event, const std::string & s) {
+		dataList.push_back(event * 100 + (int)s.size());
+	}
+
+	std::vector<int> dataList;
+};
+
+template <typename Queue>
+void doTestHeterProcessQueueWith()
+{
+	Queue queue;
+	int listenerCount = 0;
+	queue.appendListener(1, [&listenerCount](int) {
+		++listenerCount;
+	});
+
+	queue.enqueue(1);
+	queue.enqueue(2, 5);
+	queue.enqueue(3, std::string("abc"));
+	queue.enqueue(4, 6);
+
+	HeterRecordingVisitor visitor;
+	REQUIRE(queue.processOneWith(visitor));
+	REQUIRE(visitor.dataList == std::vector<int> { 100 });
+	REQUIRE(queue.processQueueWith(visitor));
+	REQUIRE(visitor.dataList == std::vector<int> { 100, 205, 303, 406 });
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(! queue.processQueueWith(visitor));
+	REQUIRE(! queue.processOneWith(visitor));
+	// The listeners are not called.
+	REQUIRE(listenerCount == 0);
+}
+
+} //unnamed namespace
+
+TEST_CASE("HeterEventQueue, processQueueWith and processOneWith")
+{
+	using Prototypes = eventpp::HeterTuple<void (), void (int), void (const std::string &)>;
+
+	SECTION("ListStorage") {
+		doTestHeterProcessQueueWith<eventpp::HeterEventQueue<int, Prototypes> >();
+	}
+
+	SECTION("QueueStoragePacked") {
+		doTestHeterProcessQueueWith<eventpp::HeterEventQueue<int, Prototypes, HeterPackedPolicies> >();
+	}
+}
+
+TEST_CASE("HeterEventQueue, waitFor")
+{
+	eventpp::HeterEventQueue<int, eventpp::HeterTuple<void (), void (int)> > queue;
+
+	REQUIRE(! queue.waitFor(std::chrono::milliseconds(1)));
+	queue.enqueue(1, 2);
+	REQUIRE(queue.waitFor(std::chrono::milliseconds(1)));
+
+	std::thread thread([&queue]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		queue.enqueue(1);
+	});
+	queue.process();
+	REQUIRE(queue.waitFor(std::chrono::seconds(10)));
+	thread.join();
+}
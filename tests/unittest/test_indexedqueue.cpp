@@ -0,0 +1,218 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/indexedeventqueue.h"
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Events 1 to 9 are orders, 10 and above are quotes, a consumer takes a class.
+// The event is passed to the listeners, so it's in the arguments too.
+struct ClassPolicies
+{
+	static int indexKey(const int event, const int /*event*/, const int /*value*/) {
+		return event < 10 ? 0 : 1;
+	}
+};
+
+using EQ = eventpp::IndexedEventQueue<int, void (int, int)>;
+
+void appendRecorders(EQ & queue, std::vector<std::pair<int, int> > & dataList)
+{
+	for(int e = 1; e <= 3; ++e) {
+		queue.appendListener(e, [&dataList](const int e, const int value) {
+			dataList.emplace_back(e, value);
+		});
+	}
+}
+
+} //namespace
+
+TEST_CASE("IndexedEventQueue, process keeps the global order")
+{
+	EQ queue;
+	std::vector<std::pair<int, int> > dataList;
+	appendRecorders(queue, dataList);
+
+	queue.enqueue(2, 1);
+	queue.enqueue(1, 2);
+	queue.enqueue(2, 3);
+	queue.enqueue(3, 4);
+	queue.enqueue(1, 5);
+	REQUIRE(queue.getQueuedEventCount(2) == 2);
+
+	SECTION("process") {
+		REQUIRE(queue.process());
+		REQUIRE(dataList == std::vector<std::pair<int, int> >{ { 2, 1 }, { 1, 2 }, { 2, 3 }, { 3, 4 }, { 1, 5 } });
+	}
+
+	SECTION("processOne") {
+		while(queue.processOne()) {
+		}
+		REQUIRE(dataList == std::vector<std::pair<int, int> >{ { 2, 1 }, { 1, 2 }, { 2, 3 }, { 3, 4 }, { 1, 5 } });
+	}
+
+	SECTION("processQueueWith") {
+		REQUIRE(queue.processQueueWith([&dataList](int, const int e, const int value) {
+			dataList.emplace_back(e, -value);
+		}));
+		REQUIRE(dataList == std::vector<std::pair<int, int> >{ { 2, -1 }, { 1, -2 }, { 2, -3 }, { 3, -4 }, { 1, -5 } });
+	}
+
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(! queue.process());
+}
+
+TEST_CASE("IndexedEventQueue, processEvent and processEvents")
+{
+	EQ queue;
+	std::vector<std::pair<int, int> > dataList;
+	appendRecorders(queue, dataList);
+
+	for(int i = 0; i < 9; ++i) {
+		queue.enqueue(i % 3 + 1, i);
+	}
+
+	REQUIRE(queue.processEvent(2));
+	REQUIRE(dataList == std::vector<std::pair<int, int> >{ { 2, 1 }, { 2, 4 }, { 2, 7 } });
+	REQUIRE(! queue.processEvent(2));
+	REQUIRE(! queue.processEvent(5));
+
+	dataList.clear();
+	REQUIRE(queue.processOneEvent(3));
+	REQUIRE(dataList == std::vector<std::pair<int, int> >{ { 3, 2 } });
+
+	// An event enqueued later is behind the queued ones.
+	queue.enqueue(1, 9);
+
+	dataList.clear();
+	SECTION("processEvents, initializer_list") {
+		REQUIRE(queue.processEvents({ 3, 1, 3 }));
+		REQUIRE(dataList == std::vector<std::pair<int, int> >{ { 1, 0 }, { 1, 3 }, { 3, 5 }, { 1, 6 }, { 3, 8 }, { 1, 9 } });
+	}
+
+	SECTION("processEvents, iterators") {
+		const std::set<int> keys { 1, 3 };
+		REQUIRE(queue.processEvents(keys.begin(), keys.end()));
+		REQUIRE(dataList == std::vector<std::pair<int, int> >{ { 1, 0 }, { 1, 3 }, { 3, 5 }, { 1, 6 }, { 3, 8 }, { 1, 9 } });
+	}
+
+	REQUIRE(queue.emptyQueue());
+}
+
+TEST_CASE("IndexedEventQueue, indexKey policy")
+{
+	eventpp::IndexedEventQueue<int, void (int, int), ClassPolicies> queue;
+	std::vector<std::pair<int, int> > dataList;
+	for(const int e : { 1, 2, 11 }) {
+		queue.appendListener(e, [&dataList](const int e, const int value) {
+			dataList.emplace_back(e, value);
+		});
+	}
+
+	queue.enqueue(11, 1);
+	queue.enqueue(1, 2);
+	queue.enqueue(2, 3);
+	queue.enqueue(11, 4);
+	REQUIRE(queue.getQueuedEventCount(0) == 2);
+
+	REQUIRE(queue.processEvent(0));
+	REQUIRE(dataList == std::vector<std::pair<int, int> >{ { 1, 2 }, { 2, 3 } });
+
+	decltype(queue)::QueuedEvent queuedEvent;
+	REQUIRE(! queue.takeEvent(0, &queuedEvent));
+	REQUIRE(queue.peekEvent(&queuedEvent));
+	REQUIRE(queuedEvent.getArgument<1>() == 1);
+	REQUIRE(queue.takeEvent(1, &queuedEvent));
+	REQUIRE(queuedEvent.getArgument<1>() == 1);
+	REQUIRE(queue.takeEvent(&queuedEvent));
+	REQUIRE(queuedEvent.getArgument<1>() == 4);
+	REQUIRE(queue.emptyQueue());
+}
+
+TEST_CASE("IndexedEventQueue, clearEvents destroys the arguments")
+{
+	eventpp::IndexedEventQueue<std::string, void (const std::string &, std::shared_ptr<int>)> queue;
+	std::weak_ptr<int> value;
+	{
+		auto pointer = std::make_shared<int>(1);
+		value = pointer;
+		queue.enqueue("a", std::move(pointer));
+	}
+	queue.enqueue("b", std::make_shared<int>(2));
+	REQUIRE(! value.expired());
+
+	queue.clearEvents();
+	REQUIRE(value.expired());
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(queue.getQueuedEventCount("a") == 0);
+}
+
+TEST_CASE("IndexedEventQueue, multiple threading, one consumer per event")
+{
+	EQ queue;
+
+	constexpr int producerCount = 4;
+	constexpr int consumerCount = 3;
+	constexpr int eventCountPerProducer = 3000;
+
+	std::vector<std::vector<int> > lastValues(consumerCount + 1, std::vector<int>(producerCount, -1));
+	std::atomic<int> processedCount(0);
+	std::atomic<bool> ordered(true);
+	for(int e = 1; e <= consumerCount; ++e) {
+		queue.appendListener(e, [&lastValues, &processedCount, &ordered](const int e, const int value) {
+			// The values from one producer are increasing in each consumer.
+			const int producer = value % producerCount;
+			if(value <= lastValues[e][producer]) {
+				ordered = false;
+			}
+			lastValues[e][producer] = value;
+			++processedCount;
+		});
+	}
+
+	std::vector<std::thread> threadList;
+	for(int t = 0; t < producerCount; ++t) {
+		threadList.emplace_back([&queue, t]() {
+			for(int i = 0; i < eventCountPerProducer; ++i) {
+				queue.enqueue(i % consumerCount + 1, i * producerCount + t);
+			}
+		});
+	}
+
+	for(int e = 1; e <= consumerCount; ++e) {
+		threadList.emplace_back([&queue, &processedCount, e]() {
+			while(processedCount.load() < producerCount * eventCountPerProducer) {
+				if(! queue.processEvent(e)) {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	REQUIRE(ordered.load());
+	REQUIRE(processedCount.load() == producerCount * eventCountPerProducer);
+	REQUIRE(queue.emptyQueue());
+}
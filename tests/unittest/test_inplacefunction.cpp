@@ -0,0 +1,175 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/utilities/inplacefunction.h"
+#include "eventpp/utilities/eventutil.h"
+#include "eventpp/eventdispatcher.h"
+#include "eventpp/callbacklist.h"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace {
+
+void addOne(std::vector<int> * dataList)
+{
+	++(*dataList)[0];
+}
+
+void addTwo(std::vector<int> * dataList)
+{
+	(*dataList)[1] += 2;
+}
+
+int square(const int value)
+{
+	return value * value;
+}
+
+struct InplacePolicies
+{
+	using Callback = eventpp::InplaceFunction<void (std::vector<int> *), 48>;
+};
+
+struct LiveCounter
+{
+	explicit LiveCounter(int * liveCount) : liveCount(liveCount) {
+		++*liveCount;
+	}
+
+	LiveCounter(const LiveCounter & other) : liveCount(other.liveCount) {
+		++*liveCount;
+	}
+
+	~LiveCounter() {
+		--*liveCount;
+	}
+
+	int operator() (const int value) const {
+		return value + 1;
+	}
+
+	int * liveCount;
+};
+
+} //unnamed namespace
+
+TEST_CASE("InplaceFunction, invoke")
+{
+	eventpp::InplaceFunction<int (int)> f;
+	REQUIRE(! f);
+	REQUIRE(f == nullptr);
+
+	f = &square;
+	REQUIRE(f);
+	REQUIRE(f(5) == 25);
+
+	const std::array<int, 6> captured {{ 1, 2, 3, 4, 5, 6 }};
+	eventpp::InplaceFunction<int (int), 32> g([captured](const int index) {
+		return captured[index];
+	});
+	REQUIRE(g(3) == 4);
+
+	// The return value is discarded.
+	eventpp::InplaceFunction<void (int)> h(&square);
+	h(1);
+
+	int (*nullFunc)(int) = nullptr;
+	eventpp::InplaceFunction<int (int)> empty(nullFunc);
+	REQUIRE(! empty);
+}
+
+TEST_CASE("InplaceFunction, copy, move, and destroy")
+{
+	int liveCount = 0;
+	{
+		eventpp::InplaceFunction<int (int)> f { LiveCounter(&liveCount) };
+		REQUIRE(liveCount == 1);
+
+		eventpp::InplaceFunction<int (int)> g(f);
+		REQUIRE(liveCount == 2);
+		REQUIRE(g(1) == 2);
+
+		eventpp::InplaceFunction<int (int)> h(std::move(g));
+		REQUIRE(h(2) == 3);
+
+		h = &square;
+		REQUIRE(h(3) == 9);
+		REQUIRE(liveCount == 2);
+
+		h = f;
+		REQUIRE(h(4) == 5);
+		f = nullptr;
+		REQUIRE(! f);
+		f.swap(h);
+		REQUIRE(f(5) == 6);
+		REQUIRE(! h);
+	}
+	REQUIRE(liveCount == 0);
+}
+
+TEST_CASE("InplaceFunction, compare function pointers")
+{
+	using F = eventpp::InplaceFunction<void (std::vector<int> *)>;
+	REQUIRE(F(&addOne) == F(&addOne));
+	REQUIRE(F(&addOne) != F(&addTwo));
+	REQUIRE(F() == F());
+	REQUIRE(F() != F(&addOne));
+
+	// Other callables are never equal, same as they can't be found.
+	auto lambda = [](std::vector<int> *) {};
+	REQUIRE(F(lambda) != F(lambda));
+}
+
+TEST_CASE("InplaceFunction, as Callback policy of CallbackList")
+{
+	eventpp::CallbackList<void (std::vector<int> *), InplacePolicies> callbackList;
+	std::vector<int> dataList(3);
+	const std::shared_ptr<int> captured = std::make_shared<int>(5);
+
+	callbackList.append(&addOne);
+	callbackList.append(&addTwo);
+	callbackList.append([captured](std::vector<int> * dataList) {
+		(*dataList)[2] += *captured;
+	});
+	callbackList(&dataList);
+	REQUIRE(dataList == std::vector<int>{ 1, 2, 5 });
+
+	REQUIRE(eventpp::removeListener(callbackList, &addOne));
+	REQUIRE(! eventpp::removeListener(callbackList, &addOne));
+	callbackList(&dataList);
+	REQUIRE(dataList == std::vector<int>{ 1, 4, 10 });
+
+	callbackList = {};
+	REQUIRE(captured.use_count() == 1);
+}
+
+TEST_CASE("InplaceFunction, as Callback policy of EventDispatcher")
+{
+	eventpp::EventDispatcher<int, void (std::vector<int> *), InplacePolicies> dispatcher;
+	std::vector<int> dataList(3);
+
+	dispatcher.appendListener(1, &addOne);
+	dispatcher.appendListener(1, &addTwo);
+	dispatcher.appendListener(2, &addTwo);
+	dispatcher.dispatch(1, &dataList);
+	REQUIRE(dataList == std::vector<int>{ 1, 2, 0 });
+
+	REQUIRE(eventpp::removeListener(dispatcher, 1, &addTwo));
+	REQUIRE(eventpp::hasListener(dispatcher, 2, &addTwo));
+	dispatcher.dispatch(1, &dataList);
+	dispatcher.dispatch(2, &dataList);
+	REQUIRE(dataList == std::vector<int>{ 2, 4, 0 });
+}
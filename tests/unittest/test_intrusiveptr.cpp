@@ -0,0 +1,176 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/utilities/intrusiveptr.h"
+#include "eventpp/utilities/argumentadapter.h"
+#include "eventpp/eventdispatcher.h"
+#include "eventpp/eventqueue.h"
+
+#include <vector>
+
+namespace {
+
+int liveEventCount = 0;
+
+class IntrusiveEvent : public eventpp::IntrusiveRefCounted
+{
+public:
+	explicit IntrusiveEvent(const int type) : type(type) {
+		++liveEventCount;
+	}
+
+	~IntrusiveEvent() {
+		--liveEventCount;
+	}
+
+	int getType() const {
+		return type;
+	}
+
+private:
+	int type;
+};
+
+class IntrusiveMouseEvent : public IntrusiveEvent
+{
+public:
+	IntrusiveMouseEvent(const int x, const int y) : IntrusiveEvent(1), x(x), y(y) {
+	}
+
+	int getX() const {
+		return x;
+	}
+
+	int getY() const {
+		return y;
+	}
+
+private:
+	int x;
+	int y;
+};
+
+class ThrowingEvent : public IntrusiveEvent
+{
+public:
+	ThrowingEvent() : IntrusiveEvent(2) {
+		throw std::runtime_error("ThrowingEvent");
+	}
+};
+
+} //unnamed namespace
+
+TEST_CASE("IntrusivePtr, reference count")
+{
+	{
+		eventpp::IntrusivePtr<IntrusiveEvent> a = eventpp::makeIntrusive<IntrusiveEvent>(5);
+		REQUIRE(liveEventCount == 1);
+		REQUIRE(a->getReferenceCount() == 1);
+
+		eventpp::IntrusivePtr<IntrusiveEvent> b = a;
+		REQUIRE(a->getReferenceCount() == 2);
+		REQUIRE(a == b);
+
+		eventpp::IntrusivePtr<IntrusiveEvent> c = std::move(b);
+		REQUIRE(a->getReferenceCount() == 2);
+		REQUIRE(! b);
+		REQUIRE(b == nullptr);
+
+		c.reset();
+		REQUIRE(a->getReferenceCount() == 1);
+		REQUIRE(liveEventCount == 1);
+	}
+	REQUIRE(liveEventCount == 0);
+}
+
+TEST_CASE("IntrusivePtr, makePooled and casts")
+{
+	{
+		eventpp::IntrusivePtr<IntrusiveMouseEvent> mouse = eventpp::makePooled<IntrusiveMouseEvent>(3, 8);
+		REQUIRE(liveEventCount == 1);
+
+		eventpp::IntrusivePtr<IntrusiveEvent> base = mouse;
+		REQUIRE(mouse->getReferenceCount() == 2);
+		REQUIRE(base->getType() == 1);
+
+		eventpp::IntrusivePtr<IntrusiveMouseEvent> back = eventpp::staticPointerCast<IntrusiveMouseEvent>(base);
+		REQUIRE(back->getX() == 3);
+		REQUIRE(back->getY() == 8);
+		REQUIRE(mouse->getReferenceCount() == 3);
+
+		IntrusiveMouseEvent * raw = mouse.get();
+		mouse.reset();
+		back.reset();
+		base.reset();
+		REQUIRE(liveEventCount == 0);
+
+		// The slot goes back to the thread cache of the pool and is reused.
+		eventpp::IntrusivePtr<IntrusiveMouseEvent> next = eventpp::makePooled<IntrusiveMouseEvent>(1, 2);
+		REQUIRE(next.get() == raw);
+	}
+	REQUIRE(liveEventCount == 0);
+
+	REQUIRE_THROWS(eventpp::makePooled<ThrowingEvent>());
+	REQUIRE(liveEventCount == 0);
+}
+
+TEST_CASE("IntrusivePtr, argumentAdapter")
+{
+	eventpp::EventDispatcher<int, void (const eventpp::IntrusivePtr<IntrusiveEvent> &)> dispatcher;
+	std::vector<std::size_t> referenceCounts;
+	std::vector<int> xs;
+
+	dispatcher.appendListener(1, eventpp::argumentAdapter<void (const eventpp::IntrusivePtr<IntrusiveMouseEvent> &)>(
+		[&referenceCounts, &xs](const eventpp::IntrusivePtr<IntrusiveMouseEvent> & e) {
+			referenceCounts.push_back(e->getReferenceCount());
+			xs.push_back(e->getX());
+		}
+	));
+	dispatcher.appendListener(1, eventpp::argumentAdapter<void (eventpp::IntrusivePtr<IntrusiveMouseEvent>)>(
+		[&referenceCounts, &xs](eventpp::IntrusivePtr<IntrusiveMouseEvent> e) {
+			referenceCounts.push_back(e->getReferenceCount());
+			xs.push_back(e->getY());
+		}
+	));
+
+	{
+		eventpp::IntrusivePtr<IntrusiveEvent> e = eventpp::makePooled<IntrusiveMouseEvent>(6, 9);
+		dispatcher.dispatch(1, e);
+		REQUIRE(e->getReferenceCount() == 1);
+	}
+	REQUIRE(liveEventCount == 0);
+	// The const reference listener borrows the reference, the by value listener holds one more.
+	REQUIRE(referenceCounts == std::vector<std::size_t>{ 1, 2 });
+	REQUIRE(xs == std::vector<int>{ 6, 9 });
+}
+
+TEST_CASE("IntrusivePtr, EventQueue")
+{
+	eventpp::EventQueue<int, void (const eventpp::IntrusivePtr<IntrusiveEvent> &)> queue;
+	int sum = 0;
+
+	queue.appendListener(1, eventpp::argumentAdapter<void (const eventpp::IntrusivePtr<IntrusiveMouseEvent> &)>(
+		[&sum](const eventpp::IntrusivePtr<IntrusiveMouseEvent> & e) {
+			sum += e->getX() + e->getY();
+		}
+	));
+
+	for(int i = 0; i < 10; ++i) {
+		queue.enqueue(1, eventpp::makePooled<IntrusiveMouseEvent>(i, 1));
+	}
+	REQUIRE(liveEventCount == 10);
+	queue.process();
+	REQUIRE(liveEventCount == 0);
+	REQUIRE(sum == 55);
+}
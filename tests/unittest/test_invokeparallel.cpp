@@ -0,0 +1,270 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// OPT-64: Tests for CallbackList::invokeParallel and EventDispatcher::dispatchParallel
+
+#include "test.h"
+#include "eventpp/callbacklist.h"
+#include "eventpp/eventdispatcher.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+class TestThreadPool
+{
+public:
+	explicit TestThreadPool(const int threadCount)
+		: taskList(), mutex(), condition(), stopped(false), threadList(), postedCount(0)
+	{
+		for(int i = 0; i < threadCount; ++i) {
+			threadList.emplace_back([this]() {
+				for(;;) {
+					std::function<void ()> task;
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						condition.wait(lock, [this]() { return stopped || ! taskList.empty(); });
+						if(taskList.empty()) {
+							return;
+						}
+						task = std::move(taskList.front());
+						taskList.pop_front();
+					}
+					task();
+				}
+			});
+		}
+	}
+
+	~TestThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lockGuard(mutex);
+			stopped = true;
+		}
+		condition.notify_all();
+		for(auto & thread : threadList) {
+			thread.join();
+		}
+	}
+
+	void post(std::function<void ()> task)
+	{
+		++postedCount;
+		{
+			std::lock_guard<std::mutex> lockGuard(mutex);
+			taskList.push_back(std::move(task));
+		}
+		condition.notify_one();
+	}
+
+	int getThreadCount() const {
+		return static_cast<int>(threadList.size());
+	}
+
+	int getPostedCount() const {
+		return postedCount.load();
+	}
+
+private:
+	std::deque<std::function<void ()> > taskList;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopped;
+	std::vector<std::thread> threadList;
+	std::atomic<int> postedCount;
+};
+
+// Runs the task on the calling thread, so the first task does all the work
+// before invokeParallel works on the calling thread.
+struct InlineExecutor
+{
+	int getThreadCount() const {
+		return 2;
+	}
+
+	void post(const std::function<void ()> & task) {
+		task();
+	}
+};
+
+template <typename Policies>
+void doTestInvokeParallelAll()
+{
+	using CL = eventpp::CallbackList<void (std::vector<std::atomic<int> > &, int), Policies>;
+	CL callbackList;
+
+	constexpr int listenerCount = 100;
+	for(int i = 0; i < listenerCount; ++i) {
+		callbackList.append([i](std::vector<std::atomic<int> > & counterList, const int n) {
+			counterList[i] += n;
+		});
+	}
+
+	TestThreadPool threadPool(4);
+	std::vector<std::atomic<int> > counterList(listenerCount);
+	for(int round = 0; round < 10; ++round) {
+		callbackList.invokeParallel(threadPool, counterList, 2);
+	}
+
+	for(int i = 0; i < listenerCount; ++i) {
+		REQUIRE(counterList[i].load() == 20);
+	}
+	// One helper task for each thread of the pool in each round.
+	REQUIRE(threadPool.getPostedCount() == 40);
+
+	InlineExecutor inlineExecutor;
+	callbackList.invokeParallel(inlineExecutor, counterList, 1);
+	for(int i = 0; i < listenerCount; ++i) {
+		REQUIRE(counterList[i].load() == 21);
+	}
+}
+
+struct PoliciesSnapshot
+{
+	using ListenerStorage = eventpp::ListenerStorageSnapshot;
+};
+
+struct PoliciesSlotMap
+{
+	using ListenerStorage = eventpp::ListenerStorageSlotMap;
+};
+
+} //unnamed namespace
+
+TEST_CASE("CallbackList, invokeParallel, all listeners are called once")
+{
+	doTestInvokeParallelAll<eventpp::DefaultPolicies>();
+}
+
+TEST_CASE("CallbackList, invokeParallel, ListenerStorageSnapshot")
+{
+	doTestInvokeParallelAll<PoliciesSnapshot>();
+}
+
+TEST_CASE("CallbackList, invokeParallel, ListenerStorageSlotMap")
+{
+	doTestInvokeParallelAll<PoliciesSlotMap>();
+}
+
+TEST_CASE("CallbackList, invokeParallel, empty and one listener")
+{
+	using CL = eventpp::CallbackList<void (int &)>;
+	CL callbackList;
+	TestThreadPool threadPool(2);
+
+	int value = 0;
+	callbackList.invokeParallel(threadPool, value);
+	REQUIRE(value == 0);
+
+	callbackList.append([](int & n) { n += 5; });
+	callbackList.invokeParallel(threadPool, value);
+	REQUIRE(value == 5);
+	// One listener is called on the calling thread, nothing is posted.
+	REQUIRE(threadPool.getPostedCount() == 0);
+}
+
+TEST_CASE("CallbackList, invokeParallel, removed group and removed listener are not called")
+{
+	struct Policies
+	{
+		using ListenerGroups = eventpp::ListenerGroupsEnabled;
+	};
+	using CL = eventpp::CallbackList<void (std::atomic<int> &), Policies>;
+	CL callbackList;
+	eventpp::ListenerGroup group;
+
+	callbackList.append([](std::atomic<int> & n) { n += 1; });
+	auto handle = callbackList.append([](std::atomic<int> & n) { n += 10; });
+	callbackList.append([](std::atomic<int> & n) { n += 100; }, group);
+	callbackList.append([](std::atomic<int> & n) { n += 1000; });
+
+	REQUIRE(callbackList.remove(handle));
+	group.removeAll();
+
+	TestThreadPool threadPool(3);
+	std::atomic<int> value(0);
+	callbackList.invokeParallel(threadPool, value);
+	REQUIRE(value.load() == 1001);
+}
+
+TEST_CASE("CallbackList, invokeParallel, canContinueInvoking falls back to operator()")
+{
+	struct Policies
+	{
+		static bool canContinueInvoking(std::vector<int> & list) {
+			return list.size() < 2;
+		}
+	};
+
+	using CL = eventpp::CallbackList<void (std::vector<int> &), Policies>;
+	CL callbackList;
+	for(int i = 0; i < 5; ++i) {
+		callbackList.append([i](std::vector<int> & list) { list.push_back(i); });
+	}
+
+	TestThreadPool threadPool(4);
+	std::vector<int> list;
+	callbackList.invokeParallel(threadPool, list);
+	REQUIRE(list == std::vector<int> { 0, 1 });
+	REQUIRE(threadPool.getPostedCount() == 0);
+}
+
+TEST_CASE("EventDispatcher, dispatchParallel")
+{
+	using ED = eventpp::EventDispatcher<int, void (int, std::atomic<int> &)>;
+	ED dispatcher;
+
+	for(int i = 0; i < 20; ++i) {
+		dispatcher.appendListener(3, [i](int, std::atomic<int> & n) { n += i; });
+	}
+	dispatcher.appendListener(4, [](int, std::atomic<int> & n) { n += 1000; });
+
+	TestThreadPool threadPool(4);
+	std::atomic<int> value(0);
+	dispatcher.dispatchParallel(threadPool, 3, value);
+	REQUIRE(value.load() == 190);
+
+	dispatcher.dispatchParallel(threadPool, 5, value);
+	REQUIRE(value.load() == 190);
+
+	dispatcher.directDispatchParallel(threadPool, 4, 0, value);
+	REQUIRE(value.load() == 1190);
+}
+
+TEST_CASE("EventDispatcher, dispatchParallel, event is excluded from the arguments")
+{
+	struct Policies
+	{
+		static int getEvent(const int e, std::atomic<int> &) {
+			return e;
+		}
+	};
+
+	using ED = eventpp::EventDispatcher<int, void (std::atomic<int> &), Policies>;
+	ED dispatcher;
+	for(int i = 0; i < 10; ++i) {
+		dispatcher.appendListener(1, [](std::atomic<int> & n) { ++n; });
+	}
+
+	TestThreadPool threadPool(2);
+	std::atomic<int> value(0);
+	dispatcher.dispatchParallel(threadPool, 1, value);
+	REQUIRE(value.load() == 10);
+}
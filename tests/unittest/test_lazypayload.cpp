@@ -0,0 +1,262 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/utilities/lazypayload.h"
+#include "eventpp/utilities/argumentadapter.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/mixins/mixinfilter.h"
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+class Encoder
+{
+public:
+	template <typename T>
+	Encoder & value(const T & v) {
+		const std::size_t offset = buffer.size();
+		buffer.resize(offset + sizeof(v));
+		std::memcpy(&buffer[offset], &v, sizeof(v));
+		return *this;
+	}
+
+	Encoder & string(const std::string & s) {
+		value(static_cast<std::uint32_t>(s.size()));
+		buffer.insert(buffer.end(), s.begin(), s.end());
+		return *this;
+	}
+
+	template <typename Payload>
+	Payload make(const std::size_t size) const {
+		return Payload::copyFrom(buffer.data(), size);
+	}
+
+	template <typename Payload>
+	Payload make() const {
+		return make<Payload>(buffer.size());
+	}
+
+	std::size_t getSize() const {
+		return buffer.size();
+	}
+
+private:
+	std::vector<std::uint8_t> buffer;
+};
+
+// A string field which counts how many times its size is found.
+std::atomic<int> countedGetSizeCount(0);
+
+struct CountedString : eventpp::LazyString
+{
+	static std::size_t getSize(const std::uint8_t * data, const std::size_t available) {
+		++countedGetSizeCount;
+		return eventpp::LazyString::getSize(data, available);
+	}
+};
+
+using TradeSchema = eventpp::LazySchema<
+	eventpp::LazyValue<std::int32_t>,
+	eventpp::LazyValue<double>,
+	eventpp::LazyString,
+	eventpp::LazyValue<std::int64_t>,
+	eventpp::LazyBytes
+>;
+using TradePayload = eventpp::LazyPayload<TradeSchema>;
+
+Encoder makeTrade(const std::int32_t symbol, const double price, const std::string & venue, const std::int64_t quantity)
+{
+	Encoder encoder;
+	encoder.value(symbol).value(price).string(venue).value(quantity).string("xyz");
+	return encoder;
+}
+
+} //unnamed namespace
+
+TEST_CASE("LazyPayload, fields")
+{
+	const Encoder encoder = makeTrade(5, 1.5, "venue", 300);
+	const TradePayload payload = encoder.make<TradePayload>();
+
+	REQUIRE(sizeof(payload) == sizeof(void *) + sizeof(std::size_t));
+	REQUIRE(payload.getSize() == encoder.getSize());
+	REQUIRE(payload.isSchema<TradeSchema>());
+	REQUIRE(! payload.isSchema<eventpp::LazySchema<> >());
+	REQUIRE(payload.isValid());
+
+	REQUIRE(payload.get<3>() == 300);
+	REQUIRE(payload.get<0>() == 5);
+	REQUIRE(payload.get<1>() == 1.5);
+	REQUIRE(payload.get<2>() == "venue");
+	const eventpp::LazyByteView bytes = payload.get<4>();
+	REQUIRE(std::string(reinterpret_cast<const char *>(bytes.data), bytes.size) == "xyz");
+
+	// The copies share the bytes.
+	{
+		TradePayload copied(payload);
+		REQUIRE(copied.getData() == payload.getData());
+		REQUIRE(payload.getReferenceCount() == 2);
+		TradePayload moved(std::move(copied));
+		REQUIRE(copied.empty());
+		REQUIRE(payload.getReferenceCount() == 2);
+	}
+	REQUIRE(payload.getReferenceCount() == 1);
+
+	const TradePayload empty;
+	REQUIRE(empty.empty());
+	REQUIRE(! empty.isValid());
+	REQUIRE(! empty.has<0>());
+	REQUIRE(empty.get<2>() == "");
+}
+
+TEST_CASE("LazyPayload, truncated")
+{
+	const Encoder encoder = makeTrade(5, 1.5, "venue", 300);
+
+	// Cut in the string.
+	const TradePayload payload = encoder.make<TradePayload>(sizeof(std::int32_t) + sizeof(double) + 6);
+	REQUIRE(payload.has<0>());
+	REQUIRE(payload.has<1>());
+	REQUIRE(! payload.has<2>());
+	REQUIRE(! payload.has<3>());
+	REQUIRE(! payload.isValid());
+	REQUIRE(payload.get<1>() == 1.5);
+	REQUIRE(payload.get<2>() == "");
+	REQUIRE(payload.get<3>() == 0);
+
+	// Cut in the fixed fields.
+	const TradePayload shortPayload = encoder.make<TradePayload>(6);
+	REQUIRE(shortPayload.has<0>());
+	REQUIRE(! shortPayload.has<1>());
+	REQUIRE(shortPayload.get<1>() == 0.0);
+
+	// A string longer than the bytes.
+	Encoder badLength;
+	badLength.value(std::int32_t(1)).value(2.0).value(std::uint32_t(1000)).value(std::int64_t(3));
+	REQUIRE(! badLength.make<TradePayload>().has<2>());
+
+	// Large payloads are not pooled.
+	Encoder large;
+	large.value(std::int32_t(1)).value(2.0).string(std::string(10000, 'a')).value(std::int64_t(7)).string("");
+	const TradePayload largePayload = large.make<TradePayload>();
+	REQUIRE(largePayload.get<2>().size() == 10000);
+	REQUIRE(largePayload.get<3>() == 7);
+}
+
+TEST_CASE("LazyPayload, offsets are found once")
+{
+	using Schema = eventpp::LazySchema<
+		eventpp::LazyValue<int>,
+		CountedString,
+		CountedString,
+		eventpp::LazyValue<int>
+	>;
+	using Payload = eventpp::LazyPayload<Schema>;
+
+	Encoder encoder;
+	encoder.value(1).string("first").string("second").value(4);
+	const Payload payload = encoder.make<Payload>();
+
+	countedGetSizeCount = 0;
+	// The fields before the first string don't need the offsets.
+	REQUIRE(payload.get<0>() == 1);
+	REQUIRE(countedGetSizeCount == 0);
+
+	REQUIRE(payload.get<1>() == "first");
+	REQUIRE(countedGetSizeCount == 1);
+	REQUIRE(payload.get<3>() == 4);
+	REQUIRE(countedGetSizeCount == 2);
+
+	// The copies and the threads see the same offsets.
+	const Payload copied(payload);
+	std::vector<std::thread> threadList;
+	std::atomic<int> mismatchCount(0);
+	for(int i = 0; i < 4; ++i) {
+		threadList.emplace_back([&copied, &mismatchCount]() {
+			for(int k = 0; k < 1000; ++k) {
+				if(copied.get<2>() != "second" || copied.get<3>() != 4) {
+					++mismatchCount;
+				}
+			}
+		});
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+	REQUIRE(mismatchCount == 0);
+	REQUIRE(countedGetSizeCount == 2);
+}
+
+TEST_CASE("LazyPayload, EventQueue with argumentAdapter and filter")
+{
+	using OtherSchema = eventpp::LazySchema<eventpp::LazyString>;
+	using OtherPayload = eventpp::LazyPayload<OtherSchema>;
+
+	enum { trade = 1, other = 2 };
+
+	struct MyPolicies {
+		using Mixins = eventpp::MixinList<eventpp::MixinFilter>;
+	};
+	eventpp::EventQueue<int, void (const eventpp::LazyPayloadBase &), MyPolicies> queue;
+
+	// Drops the trades of symbol 0, reading one field.
+	queue.appendFilter([](const eventpp::LazyPayloadBase & payload) -> bool {
+		return ! payload.isSchema<TradeSchema>() || TradePayload(payload).get<0>() != 0;
+	});
+
+	std::vector<std::string> dataList;
+	std::size_t referenceCount = 0;
+	queue.appendListener(trade, eventpp::argumentAdapter<void (const TradePayload &)>(
+		[&dataList, &referenceCount](const TradePayload & payload) {
+			referenceCount = payload.getReferenceCount();
+			dataList.push_back(std::to_string(payload.get<0>()) + payload.get<2>());
+		}
+	));
+	queue.appendListener(other, eventpp::argumentAdapter<void (OtherPayload)>(
+		[&dataList](OtherPayload payload) {
+			dataList.push_back(payload.get<0>());
+		}
+	));
+
+	queue.enqueue(trade, makeTrade(0, 1.0, "a", 1).make<TradePayload>());
+	queue.enqueue(trade, makeTrade(1, 1.0, "b", 1).make<TradePayload>());
+	Encoder encoder;
+	encoder.string("c");
+	queue.enqueue(other, encoder.make<OtherPayload>());
+	queue.process();
+
+	REQUIRE(dataList == std::vector<std::string>{ "1b", "c" });
+	// The listener borrows the queued payload.
+	REQUIRE(referenceCount == 1);
+}
+
+TEST_CASE("LazyPayload, EventQueue of one schema")
+{
+	eventpp::EventQueue<int, void (const TradePayload &)> queue;
+	std::int64_t total = 0;
+	queue.appendListener(1, [&total](const TradePayload & payload) {
+		total += payload.get<3>();
+	});
+
+	for(int i = 1; i <= 10; ++i) {
+		queue.enqueue(1, makeTrade(i, 1.0, "venue", i).make<TradePayload>());
+	}
+	queue.process();
+	REQUIRE(total == 55);
+}
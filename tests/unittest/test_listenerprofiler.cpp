@@ -0,0 +1,195 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/callbacklist.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/utilities/listenerprofiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct TopTag {};
+struct WatchdogTag {};
+struct QueueTag {};
+
+using TopProfiler = eventpp::ListenerProfiler<3, TopTag>;
+using WatchdogProfiler = eventpp::ListenerProfiler<4, WatchdogTag>;
+using QueueProfiler = eventpp::ListenerProfiler<4, QueueTag>;
+
+struct TopPolicies
+{
+	using Profiler = TopProfiler;
+};
+
+struct WatchdogPolicies
+{
+	using Profiler = WatchdogProfiler;
+};
+
+struct QueuePolicies
+{
+	using Profiler = QueueProfiler;
+};
+
+void sleepMilliseconds(const int milliseconds)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+} //unnamed namespace
+
+TEST_CASE("ListenerProfiler, slowest listeners")
+{
+	TopProfiler::reset();
+
+	using CL = eventpp::CallbackList<void (int), TopPolicies>;
+	CL callbackList;
+	std::vector<CL::Handle> handleList;
+	for(int i = 0; i < 5; ++i) {
+		handleList.push_back(callbackList.append([i](int) {
+			sleepMilliseconds(i * 4);
+		}));
+	}
+	REQUIRE(CL::setProfileTag(handleList[4], "slowest"));
+	REQUIRE(CL::setProfileTag(handleList[3], "second"));
+
+	callbackList(1);
+	callbackList(2);
+
+	const std::vector<eventpp::ListenerProfileEntry> entryList = TopProfiler::getSlowestListeners();
+	// Only topCount entries, one for each listener.
+	REQUIRE(entryList.size() == 3);
+	REQUIRE(entryList[0].handle.lock() == handleList[4].lock());
+	REQUIRE(std::string(entryList[0].tag) == "slowest");
+	REQUIRE(entryList[0].callbackList == &callbackList);
+	REQUIRE(entryList[0].duration >= std::chrono::milliseconds(10));
+	REQUIRE(entryList[1].handle.lock() == handleList[3].lock());
+	REQUIRE(std::string(entryList[1].tag) == "second");
+	REQUIRE(entryList[2].handle.lock() == handleList[2].lock());
+	REQUIRE(entryList[2].tag == nullptr);
+	REQUIRE(entryList[0].ticks >= entryList[1].ticks);
+	REQUIRE(entryList[1].ticks >= entryList[2].ticks);
+
+	TopProfiler::reset();
+	REQUIRE(TopProfiler::getSlowestListeners().empty());
+}
+
+TEST_CASE("ListenerProfiler, single listener and copied list")
+{
+	TopProfiler::reset();
+
+	using CL = eventpp::CallbackList<void (), TopPolicies>;
+	CL callbackList;
+	CL::Handle handle = callbackList.append([]() {
+		sleepMilliseconds(2);
+	});
+	CL::setProfileTag(handle, "single");
+
+	callbackList();
+	std::vector<eventpp::ListenerProfileEntry> entryList = TopProfiler::getSlowestListeners();
+	REQUIRE(entryList.size() == 1);
+	REQUIRE(entryList[0].handle.lock() == handle.lock());
+	REQUIRE(std::string(entryList[0].tag) == "single");
+
+	// The copy has its own nodes, with the same tags.
+	const CL copiedList(callbackList);
+	copiedList();
+	entryList = TopProfiler::getSlowestListeners();
+	REQUIRE(entryList.size() == 2);
+	REQUIRE(std::string(entryList[0].tag) == "single");
+	REQUIRE(std::string(entryList[1].tag) == "single");
+	REQUIRE(entryList[0].listener != entryList[1].listener);
+
+	callbackList.remove(handle);
+	REQUIRE(! CL::setProfileTag(handle, "removed"));
+
+	TopProfiler::reset();
+}
+
+TEST_CASE("ListenerProfiler, watchdog")
+{
+	using CL = eventpp::CallbackList<void (int), WatchdogPolicies>;
+	CL callbackList;
+	CL::Handle fastHandle = callbackList.append([](int) {
+	});
+	CL::Handle slowHandle = callbackList.append([](const int milliseconds) {
+		sleepMilliseconds(milliseconds);
+	});
+	CL::setProfileTag(slowHandle, "slow");
+
+	std::mutex mutex;
+	std::vector<eventpp::ListenerWatchdogReport> reportList;
+	REQUIRE(WatchdogProfiler::startWatchdog(std::chrono::milliseconds(20), [&mutex, &reportList](const eventpp::ListenerWatchdogReport & report) {
+		std::lock_guard<std::mutex> lockGuard(mutex);
+		reportList.push_back(report);
+	}));
+	REQUIRE(! WatchdogProfiler::startWatchdog(std::chrono::milliseconds(20), [](const eventpp::ListenerWatchdogReport &) {}));
+
+	// Under the budget.
+	callbackList(1);
+	sleepMilliseconds(30);
+	{
+		std::lock_guard<std::mutex> lockGuard(mutex);
+		REQUIRE(reportList.empty());
+	}
+
+	// Reported once, while the slow listener is running.
+	callbackList(200);
+	WatchdogProfiler::stopWatchdog();
+
+	REQUIRE(reportList.size() == 1);
+	REQUIRE(reportList[0].callbackList == &callbackList);
+	REQUIRE(reportList[0].listener == slowHandle.lock().get());
+	REQUIRE(std::string(reportList[0].tag) == "slow");
+	REQUIRE(reportList[0].threadId == std::this_thread::get_id());
+	REQUIRE(reportList[0].elapsed >= std::chrono::milliseconds(20));
+	REQUIRE(fastHandle);
+}
+
+TEST_CASE("ListenerProfiler, EventQueue")
+{
+	QueueProfiler::reset();
+
+	using EQ = eventpp::EventQueue<int, void (int), QueuePolicies>;
+	EQ queue;
+	std::atomic<int> count(0);
+	queue.appendListener(1, [&count](int) {
+		++count;
+	});
+	EQ::Handle handle = queue.appendListener(2, [&count](int) {
+		sleepMilliseconds(5);
+		++count;
+	});
+	REQUIRE(EQ::setProfileTag(handle, "event 2"));
+
+	queue.enqueue(1, 0);
+	queue.enqueue(2, 0);
+	queue.enqueue(1, 0);
+	queue.process();
+	REQUIRE(count == 3);
+
+	const std::vector<eventpp::ListenerProfileEntry> entryList = QueueProfiler::getSlowestListeners();
+	REQUIRE(entryList.size() == 2);
+	REQUIRE(std::string(entryList[0].tag) == "event 2");
+	REQUIRE(entryList[0].handle.lock() == handle.lock());
+
+	QueueProfiler::reset();
+}
+
@@ -0,0 +1,200 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/utilities/mergedqueue.h"
+#include "eventpp/utilities/virtualclock.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct MergeTag {};
+struct WatermarkTag {};
+
+template <typename Tag>
+struct VirtualClockPolicies
+{
+	using Clock = eventpp::VirtualClock<Tag>;
+};
+
+// Its copy waits for open, as a producer which is preempted in enqueue,
+// after the stamp and before the push. With no open it's a usual value.
+struct StallingValue
+{
+	StallingValue(std::atomic<bool> * open, std::atomic<bool> * copying)
+		: open(open), copying(copying)
+	{
+	}
+
+	StallingValue(const StallingValue & other)
+		: open(other.open), copying(other.copying)
+	{
+		if(open == nullptr) {
+			return;
+		}
+		copying->store(true);
+		while(! open->load()) {
+			std::this_thread::yield();
+		}
+	}
+
+	StallingValue & operator = (const StallingValue &) = default;
+
+	std::atomic<bool> * open;
+	std::atomic<bool> * copying;
+};
+
+} //unnamed namespace
+
+TEST_CASE("MergedQueue, events of the producers in the order of the stamps")
+{
+	using Clock = eventpp::VirtualClock<MergeTag>;
+	using MQ = eventpp::MergedQueue<int, void (int, int), VirtualClockPolicies<MergeTag> >;
+
+	Clock::reset();
+	MQ queue(3, 16);
+	REQUIRE(queue.getProducerCount() == 3);
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(! queue.process());
+
+	std::vector<int> valueList;
+	queue.appendListener(1, [&valueList](int, const int value) {
+		valueList.push_back(value);
+	});
+
+	// The producer index is not the order.
+	const int producerOfValue[] = { 2, 0, 0, 1, 2, 1, 0, 2 };
+	for(int value = 0; value < 8; ++value) {
+		Clock::advance(std::chrono::microseconds(1));
+		REQUIRE(queue.enqueue(producerOfValue[value], 1, value));
+	}
+	REQUIRE(! queue.emptyQueue());
+	REQUIRE(queue.process());
+	REQUIRE(valueList == std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7 });
+	REQUIRE(queue.emptyQueue());
+
+	// The same stamp is ordered by the producer index.
+	valueList.clear();
+	queue.enqueue(2, 1, 2);
+	queue.enqueue(0, 1, 0);
+	queue.enqueue(1, 1, 1);
+	std::vector<std::pair<int, int> > visitedList;
+	// The event is an argument of the prototype, so it's also the first
+	// argument of the visitor.
+	REQUIRE(queue.processQueueWith([&visitedList](const int event, int, const int value) {
+		visitedList.emplace_back(event, value);
+	}));
+	REQUIRE(visitedList == std::vector<std::pair<int, int> >{ { 1, 0 }, { 1, 1 }, { 1, 2 } });
+	REQUIRE(valueList.empty());
+
+	// The ring of a producer is full.
+	for(int i = 0; i < 16; ++i) {
+		REQUIRE(queue.enqueue(0, 1, i));
+	}
+	REQUIRE(! queue.enqueue(0, 1, 16));
+	REQUIRE(queue.enqueue(1, 1, 16));
+	REQUIRE(queue.process());
+	REQUIRE(queue.getLateEventCount() == 0);
+}
+
+TEST_CASE("MergedQueue, waits for a producer in enqueue until the watermark")
+{
+	using Clock = eventpp::VirtualClock<WatermarkTag>;
+	using MQ = eventpp::MergedQueue<int, void (int, const StallingValue &), VirtualClockPolicies<WatermarkTag> >;
+
+	Clock::reset();
+	MQ queue(2, 16, std::chrono::milliseconds(5));
+	REQUIRE(queue.getWatermark() == std::chrono::milliseconds(5));
+
+	std::vector<int> producerList;
+	queue.appendListener(1, [&producerList](int, const StallingValue & value) {
+		producerList.push_back(value.open == nullptr ? 1 : 0);
+	});
+
+	std::atomic<bool> open(false);
+	std::atomic<bool> copying(false);
+	StallingValue stalling(&open, &copying);
+	std::thread slowProducer([&queue, &stalling]() {
+		queue.enqueue(0, 1, stalling);
+	});
+	while(! copying.load()) {
+		std::this_thread::yield();
+	}
+
+	// Newer than the stamp of the slow producer, it waits.
+	Clock::advance(std::chrono::milliseconds(1));
+	queue.enqueue(1, 1, StallingValue(nullptr, nullptr));
+	REQUIRE(! queue.emptyQueue());
+	REQUIRE(! queue.process());
+	Clock::advance(std::chrono::milliseconds(3));
+	REQUIRE(! queue.process());
+
+	// Past the watermark it's dispatched, the slow event comes late.
+	Clock::advance(std::chrono::milliseconds(2));
+	REQUIRE(queue.process());
+	REQUIRE(producerList == std::vector<int>{ 1 });
+
+	open.store(true);
+	slowProducer.join();
+	REQUIRE(queue.process());
+	REQUIRE(producerList == std::vector<int>{ 1, 0 });
+	REQUIRE(queue.getLateEventCount() == 1);
+}
+
+TEST_CASE("MergedQueue, multi threads")
+{
+	using MQ = eventpp::MergedQueue<int, void (int, int, int)>;
+
+	const int producerCount = 4;
+	const int eventCount = 20000;
+	// A producer is never this slow, so no event comes late.
+	MQ queue(producerCount, 256, std::chrono::seconds(10));
+
+	std::vector<int> lastValueList(producerCount, -1);
+	int dispatchedCount = 0;
+	bool inOrder = true;
+	queue.appendListener(1, [&](int, const int producer, const int value) {
+		inOrder = inOrder && (value == lastValueList[producer] + 1);
+		lastValueList[producer] = value;
+		++dispatchedCount;
+	});
+
+	std::vector<std::thread> threadList;
+	for(int producer = 0; producer < producerCount; ++producer) {
+		threadList.emplace_back([&queue, producer, eventCount]() {
+			for(int value = 0; value < eventCount; ++value) {
+				while(! queue.enqueue(producer, 1, producer, value)) {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	while(dispatchedCount < producerCount * eventCount) {
+		if(queue.waitFor(std::chrono::milliseconds(10))) {
+			queue.process();
+		}
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	REQUIRE(inOrder);
+	REQUIRE(queue.getLateEventCount() == 0);
+	REQUIRE(queue.emptyQueue());
+}
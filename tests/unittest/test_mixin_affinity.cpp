@@ -0,0 +1,143 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventdispatcher.h"
+#include "eventpp/mixins/mixinaffinity.h"
+#include "eventpp/utilities/activeobject.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct AffinityPolicies
+{
+	using Mixins = eventpp::MixinList<eventpp::MixinAffinity>;
+};
+
+} //unnamed namespace
+
+TEST_CASE("MixinAffinity, deliver on the target queue")
+{
+	using ED = eventpp::EventDispatcher<int, void (const std::string &, int), AffinityPolicies>;
+	ED dispatcher;
+	eventpp::AffinityQueue queueA;
+	eventpp::AffinityQueue queueB;
+	std::vector<std::string> dataList;
+
+	dispatcher.appendListener(1, [&dataList](const std::string & s, int n) {
+		dataList.push_back("direct " + s + std::to_string(n));
+	});
+	dispatcher.appendListener(1, [&dataList](const std::string & s, int n) {
+		dataList.push_back("a1 " + s + std::to_string(n));
+	}, queueA);
+	dispatcher.appendListener(1, [&dataList](const std::string & s, int n) {
+		dataList.push_back("a2 " + s + std::to_string(n));
+	}, queueA);
+	dispatcher.appendListener(1, [&dataList](const std::string & s, int n) {
+		dataList.push_back("b " + s + std::to_string(n));
+	}, queueB);
+
+	// Counts the tasks, the listeners of a target queue are in one task.
+	int taskCountA = 0;
+	queueA.appendListener(0, [&taskCountA](const eventpp::AffinityTask &) {
+		++taskCountA;
+	});
+
+	std::string text = "x";
+	dispatcher.dispatch(1, text, 5);
+	text = "changed";
+	REQUIRE(dataList == std::vector<std::string>{ "direct x5" });
+
+	queueA.process();
+	REQUIRE(taskCountA == 1);
+	REQUIRE(dataList == std::vector<std::string>{ "direct x5", "a1 x5", "a2 x5" });
+
+	queueB.process();
+	REQUIRE(dataList == std::vector<std::string>{ "direct x5", "a1 x5", "a2 x5", "b x5" });
+
+	dispatcher.dispatch(2, text, 6);
+	REQUIRE(queueA.emptyQueue());
+	REQUIRE(queueB.emptyQueue());
+}
+
+TEST_CASE("MixinAffinity, removeListener")
+{
+	using ED = eventpp::EventDispatcher<int, void (int), AffinityPolicies>;
+	ED dispatcher;
+	eventpp::AffinityQueue queue;
+	std::vector<int> dataList;
+
+	ED::AffinityHandle handle1 = dispatcher.appendListener(1, [&dataList](int n) {
+		dataList.push_back(n);
+	}, queue);
+	ED::AffinityHandle handle2 = dispatcher.appendListener(1, [&dataList](int n) {
+		dataList.push_back(n * 10);
+	}, queue);
+	ED::Handle directHandle = dispatcher.appendListener(1, [&dataList](int n) {
+		dataList.push_back(-n);
+	});
+
+	dispatcher.dispatch(1, 3);
+	// Removed before the task runs, so it's not called.
+	REQUIRE(dispatcher.removeListener(1, handle1));
+	REQUIRE(! dispatcher.removeListener(1, handle1));
+	REQUIRE(! dispatcher.removeListener(2, handle2));
+	queue.process();
+	REQUIRE(dataList == std::vector<int>{ -3, 30 });
+
+	ED copy(dispatcher);
+	REQUIRE(dispatcher.removeListener(1, handle2));
+	REQUIRE(dispatcher.removeListener(1, directHandle));
+	dataList.clear();
+	dispatcher.dispatch(1, 4);
+	REQUIRE(queue.emptyQueue());
+
+	// The copy keeps its own listeners.
+	copy.dispatch(1, 5);
+	queue.process();
+	REQUIRE(dataList == std::vector<int>{ -5, 50 });
+}
+
+TEST_CASE("MixinAffinity, ActiveObject home thread")
+{
+	using ED = eventpp::EventDispatcher<int, void (int), AffinityPolicies>;
+	ED dispatcher;
+	eventpp::ActiveObject<eventpp::AffinityQueue> home;
+	std::atomic<int> sum(0);
+	std::atomic<bool> onHomeThread(true);
+	std::thread::id homeThreadId;
+
+	home.getQueue().post([&homeThreadId]() {
+		homeThreadId = std::this_thread::get_id();
+	});
+	dispatcher.appendListener(1, [&sum, &onHomeThread, &homeThreadId](int n) {
+		if(std::this_thread::get_id() != homeThreadId) {
+			onHomeThread = false;
+		}
+		sum += n;
+	}, home.getQueue());
+
+	home.start();
+	for(int i = 1; i <= 100; ++i) {
+		dispatcher.dispatch(1, i);
+	}
+	home.stop();
+
+	REQUIRE(sum == 5050);
+	REQUIRE(onHomeThread);
+	REQUIRE(homeThreadId != std::this_thread::get_id());
+}
@@ -0,0 +1,291 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/mixins/mixinfilter.h"
+#include "eventpp/mixins/mixinmetrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct MetricsPolicies
+{
+	using Mixins = eventpp::MixinList<eventpp::MixinMetrics>;
+};
+
+struct StampedMetricsPolicies
+{
+	using Mixins = eventpp::MixinList<eventpp::MixinMetrics>;
+	using QueueTimestamp = eventpp::QueueTimestampSteady;
+};
+
+struct FilterMetricsPolicies
+{
+	using Mixins = eventpp::MixinList<eventpp::MixinFilter, eventpp::MixinMetrics>;
+};
+
+template <typename Snapshot>
+auto findEvent(const Snapshot & snapshot, const int event) -> decltype(&snapshot.eventList.front())
+{
+	auto it = std::find_if(snapshot.eventList.begin(), snapshot.eventList.end(), [event](decltype(snapshot.eventList.front()) & item) {
+		return item.event == event;
+	});
+	return it == snapshot.eventList.end() ? nullptr : &*it;
+}
+
+std::vector<std::string> * hookLog = nullptr;
+
+template <typename Base>
+class MixinHookLog : public Base
+{
+public:
+	template <typename ...A>
+	bool mixinBeforeDispatch(A && .../*args*/) const {
+		hookLog->push_back("before");
+		return true;
+	}
+
+	void mixinAfterDispatch(const int e) const {
+		hookLog->push_back("after" + std::to_string(e));
+	}
+};
+
+template <typename Base>
+class MixinEmpty : public Base
+{
+};
+
+struct HookLogPolicies
+{
+	using Mixins = eventpp::MixinList<MixinHookLog, eventpp::MixinFilter>;
+};
+
+struct InheritedHookPolicies
+{
+	using Mixins = eventpp::MixinList<MixinEmpty, MixinHookLog>;
+};
+
+} //namespace
+
+TEST_CASE("MixinMetrics, EventDispatcher")
+{
+	eventpp::EventDispatcher<int, void (int), MetricsPolicies> dispatcher;
+	dispatcher.appendListener(1, [&dispatcher](const int value) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		if(value > 0) {
+			// The nested dispatch is measured by itself.
+			dispatcher.dispatch(2, 0);
+		}
+	});
+	dispatcher.appendListener(2, [](int) {
+	});
+
+	dispatcher.dispatch(1, 1);
+	dispatcher.dispatch(1, 0);
+	dispatcher.dispatch(3, 0);
+
+	const auto snapshot = dispatcher.getMetricsSnapshot();
+	REQUIRE(snapshot.eventList.size() == 3);
+	REQUIRE(snapshot.queueDepth == 0);
+
+	const auto * event1 = findEvent(snapshot, 1);
+	REQUIRE(event1 != nullptr);
+	REQUIRE(event1->enqueueCount == 0);
+	REQUIRE(event1->execution.count == 2);
+	REQUIRE(event1->execution.sum >= 4000000);
+	REQUIRE(event1->execution.max >= 2000000);
+	REQUIRE(event1->execution.getValueAtPercentile(50) >= 2000000);
+	REQUIRE(event1->residency.count == 0);
+
+	const auto * event2 = findEvent(snapshot, 2);
+	REQUIRE(event2 != nullptr);
+	REQUIRE(event2->execution.count == 1);
+	REQUIRE(event2->execution.max < event1->execution.max);
+
+	// The events without listeners are counted too.
+	REQUIRE(findEvent(snapshot, 3)->execution.count == 1);
+}
+
+TEST_CASE("MixinMetrics, filtered events are not measured")
+{
+	eventpp::EventDispatcher<int, void (int), FilterMetricsPolicies> dispatcher;
+	dispatcher.appendFilter([](const int e) {
+		return e != 2;
+	});
+
+	dispatcher.dispatch(1);
+	dispatcher.dispatch(2);
+	dispatcher.dispatch(1);
+
+	const auto snapshot = dispatcher.getMetricsSnapshot();
+	REQUIRE(snapshot.eventList.size() == 1);
+	REQUIRE(findEvent(snapshot, 1)->execution.count == 2);
+}
+
+TEST_CASE("MixinMetrics, mixinAfterDispatch is called for the mixins which let the dispatch go")
+{
+	std::vector<std::string> log;
+	hookLog = &log;
+
+	eventpp::EventDispatcher<int, void (int), HookLogPolicies> dispatcher;
+	dispatcher.appendFilter([](const int e) {
+		return e != 2;
+	});
+	dispatcher.appendListener(1, [&log](int) {
+		log.push_back("listener");
+	});
+	dispatcher.appendListener(2, [&log](int) {
+		log.push_back("listener");
+	});
+
+	dispatcher.dispatch(1);
+	// MixinFilter stops it after MixinHookLog has let it go.
+	dispatcher.dispatch(2);
+	REQUIRE(log == std::vector<std::string>{ "before", "listener", "after1", "before", "after2" });
+
+	hookLog = nullptr;
+}
+
+TEST_CASE("MixinMetrics, the hooks inherited by the mixins above are called once")
+{
+	std::vector<std::string> log;
+	hookLog = &log;
+
+	eventpp::EventDispatcher<int, void (int), InheritedHookPolicies> dispatcher;
+	dispatcher.dispatch(1);
+	REQUIRE(log == std::vector<std::string>{ "before", "after1" });
+
+	hookLog = nullptr;
+}
+
+TEST_CASE("MixinMetrics, EventQueue")
+{
+	using EQ = eventpp::EventQueue<int, void (int), StampedMetricsPolicies>;
+	EQ queue;
+	queue.appendListener(1, [](int) {
+	});
+
+	queue.enqueue(1);
+	queue.enqueue(1);
+	queue.enqueue(2);
+	std::this_thread::sleep_for(std::chrono::milliseconds(2));
+
+	auto snapshot = queue.getMetricsSnapshot();
+	REQUIRE(snapshot.queueDepth == 3);
+	REQUIRE(snapshot.queueHighWatermark == 3);
+
+	REQUIRE(queue.processOne());
+	REQUIRE(queue.process());
+	queue.enqueue(2);
+	queue.clearEvents();
+
+	snapshot = queue.getMetricsSnapshot();
+	REQUIRE(snapshot.queueDepth == 0);
+	REQUIRE(snapshot.queueHighWatermark == 3);
+
+	const auto * event1 = findEvent(snapshot, 1);
+	REQUIRE(event1->enqueueCount == 2);
+	REQUIRE(event1->dequeueCount == 2);
+	REQUIRE(event1->residency.count == 2);
+	REQUIRE(event1->residency.bucketList.front().upperBound >= 2000000);
+	REQUIRE(event1->execution.count == 2);
+
+	const auto * event2 = findEvent(snapshot, 2);
+	REQUIRE(event2->enqueueCount == 2);
+	// One is dispatched, one is cleared.
+	REQUIRE(event2->dequeueCount == 2);
+	REQUIRE(event2->execution.count == 1);
+
+	SECTION("takeEvent and the visitor") {
+		queue.enqueue(1);
+		queue.enqueue(1);
+		EQ::QueuedEvent queuedEvent;
+		REQUIRE(queue.takeEvent(&queuedEvent));
+		REQUIRE(queue.getMetricsSnapshot().queueDepth == 1);
+		// The event is out of the queue, dispatching it doesn't count it again.
+		queue.dispatch(queuedEvent);
+		REQUIRE(queue.processQueueWith([](int, int) {}));
+
+		snapshot = queue.getMetricsSnapshot();
+		REQUIRE(snapshot.queueDepth == 0);
+		REQUIRE(findEvent(snapshot, 1)->dequeueCount == 4);
+		REQUIRE(findEvent(snapshot, 1)->execution.count == 3);
+	}
+}
+
+TEST_CASE("MixinMetrics, EventQueue without QueueTimestamp")
+{
+	eventpp::EventQueue<int, void (int), MetricsPolicies> queue;
+	REQUIRE(sizeof(decltype(queue)::QueuedEvent) == sizeof(eventpp::EventQueue<int, void (int)>::QueuedEvent));
+
+	queue.enqueue(1);
+	queue.process();
+
+	const auto snapshot = queue.getMetricsSnapshot();
+	REQUIRE(findEvent(snapshot, 1)->dequeueCount == 1);
+	REQUIRE(findEvent(snapshot, 1)->residency.count == 0);
+}
+
+TEST_CASE("MixinMetrics, multiple threading")
+{
+	using EQ = eventpp::EventQueue<int, void (int), StampedMetricsPolicies>;
+	EQ queue;
+
+	constexpr int threadCount = 4;
+	constexpr int itemCount = 10000;
+
+	std::vector<std::thread> threadList;
+	for(int t = 0; t < threadCount; ++t) {
+		threadList.emplace_back([&queue, t]() {
+			for(int i = 0; i < itemCount; ++i) {
+				queue.enqueue(t);
+			}
+		});
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	std::vector<std::thread> consumerList;
+	for(int t = 0; t < 2; ++t) {
+		consumerList.emplace_back([&queue]() {
+			while(queue.processOne()) {
+			}
+		});
+	}
+	for(auto & thread : consumerList) {
+		thread.join();
+	}
+
+	const auto snapshot = queue.getMetricsSnapshot();
+	REQUIRE(snapshot.eventList.size() == threadCount);
+	REQUIRE(snapshot.queueDepth == 0);
+	REQUIRE(snapshot.queueHighWatermark == threadCount * itemCount);
+	for(const auto & item : snapshot.eventList) {
+		REQUIRE(item.enqueueCount == itemCount);
+		REQUIRE(item.dequeueCount == itemCount);
+		REQUIRE(item.execution.count == itemCount);
+
+		std::uint64_t count = 0;
+		for(const auto & bucket : item.residency.bucketList) {
+			count += bucket.count;
+		}
+		REQUIRE(count == itemCount);
+	}
+}
@@ -0,0 +1,214 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventdispatcher.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/mixins/mixinratelimit.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct RateLimitPolicies
+{
+	using Mixins = eventpp::MixinList<eventpp::MixinRateLimit>;
+};
+
+template <typename SnapshotList>
+auto findEvent(const SnapshotList & snapshotList, const int event) -> decltype(&snapshotList.front())
+{
+	auto it = std::find_if(snapshotList.begin(), snapshotList.end(), [event](decltype(snapshotList.front()) & item) {
+		return item.event == event;
+	});
+	return it == snapshotList.end() ? nullptr : &*it;
+}
+
+} //unnamed namespace
+
+TEST_CASE("MixinRateLimit, burst and sampling in EventDispatcher")
+{
+	using ED = eventpp::EventDispatcher<int, void (int), RateLimitPolicies>;
+	ED dispatcher;
+	std::vector<int> dataList(4);
+	for(int e = 0; e < 4; ++e) {
+		dispatcher.appendListener(e, [&dataList, e](int) {
+			++dataList[e];
+		});
+	}
+
+	ED::RateLimit limit;
+	// So slow that no token is added in the test.
+	limit.eventsPerSecond = 0.001;
+	limit.burst = 3;
+	dispatcher.setRateLimit(1, limit);
+
+	ED::RateLimit sampling;
+	sampling.sampleEvery = 4;
+	dispatcher.setRateLimit(2, sampling);
+
+	for(int i = 0; i < 10; ++i) {
+		for(int e = 0; e < 4; ++e) {
+			dispatcher.dispatch(e, i);
+		}
+	}
+	REQUIRE(dataList == std::vector<int> { 10, 3, 3, 10 });
+
+	const auto snapshotList = dispatcher.getRateLimitSnapshot();
+	REQUIRE(snapshotList.size() == 2);
+	REQUIRE(findEvent(snapshotList, 1)->passedCount == 3);
+	REQUIRE(findEvent(snapshotList, 1)->droppedCount == 7);
+	REQUIRE(findEvent(snapshotList, 2)->passedCount == 3);
+	REQUIRE(findEvent(snapshotList, 2)->droppedCount == 7);
+
+	// Setting the limit again fills the bucket.
+	dispatcher.setRateLimit(1, limit);
+	dispatcher.dispatch(1, 0);
+	REQUIRE(dataList[1] == 4);
+
+	REQUIRE(dispatcher.removeRateLimit(1));
+	REQUIRE(! dispatcher.removeRateLimit(3));
+	for(int i = 0; i < 10; ++i) {
+		dispatcher.dispatch(1, i);
+	}
+	REQUIRE(dataList[1] == 14);
+
+	// The copy has the limits but not the counts.
+	ED copied(dispatcher);
+	const auto copiedList = copied.getRateLimitSnapshot();
+	REQUIRE(copiedList.size() == 2);
+	REQUIRE(findEvent(copiedList, 2)->passedCount == 0);
+	for(int i = 0; i < 4; ++i) {
+		copied.dispatch(2, i);
+	}
+	REQUIRE(findEvent(copied.getRateLimitSnapshot(), 2)->passedCount == 1);
+}
+
+TEST_CASE("MixinRateLimit, the tokens are refilled over time")
+{
+	using ED = eventpp::EventDispatcher<int, void (), RateLimitPolicies>;
+	ED dispatcher;
+	int count = 0;
+	dispatcher.appendListener(1, [&count]() {
+		++count;
+	});
+
+	ED::RateLimit limit;
+	limit.eventsPerSecond = 100;
+	dispatcher.setRateLimit(1, limit);
+
+	dispatcher.dispatch(1);
+	dispatcher.dispatch(1);
+	REQUIRE(count == 1);
+	std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	dispatcher.dispatch(1);
+	REQUIRE(count == 2);
+}
+
+TEST_CASE("MixinRateLimit, non integral events")
+{
+	using ED = eventpp::EventDispatcher<std::string, void (), RateLimitPolicies>;
+	ED dispatcher;
+	int count = 0;
+	dispatcher.appendListener("a", [&count]() {
+		++count;
+	});
+	dispatcher.appendListener("b", [&count]() {
+		count += 100;
+	});
+
+	ED::RateLimit sampling;
+	sampling.sampleEvery = 2;
+	dispatcher.setRateLimit("a", sampling);
+	for(int i = 0; i < 4; ++i) {
+		dispatcher.dispatch("a");
+		dispatcher.dispatch("b");
+	}
+	REQUIRE(count == 402);
+}
+
+TEST_CASE("MixinRateLimit, EventQueue drops on dispatch or on enqueue")
+{
+	using EQ = eventpp::EventQueue<int, void (int), RateLimitPolicies>;
+	EQ queue;
+	std::vector<int> dataList;
+	queue.appendListener(1, [&dataList](const int value) {
+		dataList.push_back(value);
+	});
+	queue.appendListener(2, [&dataList](const int value) {
+		dataList.push_back(value);
+	});
+
+	EQ::RateLimit limit;
+	limit.eventsPerSecond = 0.001;
+	limit.burst = 2;
+	queue.setRateLimit(1, limit);
+	limit.onEnqueue = true;
+	queue.setRateLimit(2, limit);
+
+	for(int i = 0; i < 5; ++i) {
+		queue.enqueue(1, 10 + i);
+		queue.enqueue(2, 20 + i);
+	}
+	// The events 2 over the limit are never queued.
+	auto snapshotList = queue.getRateLimitSnapshot();
+	REQUIRE(findEvent(snapshotList, 1)->droppedCount == 0);
+	REQUIRE(findEvent(snapshotList, 2)->droppedCount == 3);
+
+	queue.process();
+	REQUIRE(dataList == std::vector<int> { 10, 20, 11, 21 });
+	snapshotList = queue.getRateLimitSnapshot();
+	REQUIRE(findEvent(snapshotList, 1)->droppedCount == 3);
+	REQUIRE(findEvent(snapshotList, 2)->droppedCount == 3);
+}
+
+TEST_CASE("MixinRateLimit, multiple threads")
+{
+	using ED = eventpp::EventDispatcher<int, void (), RateLimitPolicies>;
+	ED dispatcher;
+	std::atomic<int> count(0);
+	dispatcher.appendListener(1, [&count]() {
+		++count;
+	});
+
+	ED::RateLimit limit;
+	limit.eventsPerSecond = 0.001;
+	limit.burst = 100;
+	dispatcher.setRateLimit(1, limit);
+
+	constexpr int threadCount = 4;
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < threadCount; ++i) {
+		threadList.emplace_back([&dispatcher]() {
+			for(int k = 0; k < 1000; ++k) {
+				dispatcher.dispatch(1);
+			}
+		});
+	}
+	// Set the limits of the other events while the threads dispatch.
+	for(int e = 2; e < 50; ++e) {
+		dispatcher.setRateLimit(e, limit);
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+
+	REQUIRE(count == 100);
+	const auto snapshotList = dispatcher.getRateLimitSnapshot();
+	REQUIRE(findEvent(snapshotList, 1)->passedCount == 100);
+	REQUIRE(findEvent(snapshotList, 1)->droppedCount == threadCount * 1000 - 100);
+}
@@ -0,0 +1,225 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if defined(__unix__) || defined(__unix) || defined(__APPLE__)
+
+#include "test.h"
+#include "eventpp/net/netbridge.h"
+#include "eventpp/eventqueue.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+struct Tick
+{
+	std::int32_t price;
+	std::int32_t volume;
+	double time;
+};
+
+using TickQueue = eventpp::EventQueue<int, void (const Tick &, std::uint64_t)>;
+using TickSender = eventpp::NetSender<int, void (const Tick &, std::uint64_t)>;
+using TickReceiver = eventpp::NetReceiver<int, void (const Tick &, std::uint64_t)>;
+
+struct SocketPair
+{
+	explicit SocketPair(const int type) {
+		fds[0] = -1;
+		fds[1] = -1;
+		socketpair(AF_UNIX, type, 0, fds);
+	}
+
+	~SocketPair() {
+		if(fds[0] >= 0) {
+			close(fds[0]);
+		}
+		if(fds[1] >= 0) {
+			close(fds[1]);
+		}
+	}
+
+	int fds[2];
+};
+
+void appendTickListener(TickQueue & queue, std::vector<std::uint64_t> & dataList)
+{
+	queue.appendListener(1, [&dataList](const Tick & tick, const std::uint64_t sequence) {
+		if(tick.price == static_cast<std::int32_t>(sequence) * 2 && tick.volume == 7 && tick.time == 0.5) {
+			dataList.push_back(sequence);
+		}
+	});
+}
+
+// Receives until count events are enqueued, or nothing is left.
+void receiveAll(TickReceiver & receiver, TickQueue & queue, const std::size_t count)
+{
+	std::size_t received = 0;
+	while(received < count) {
+		const int result = receiver.receive(queue, false);
+		if(result <= 0) {
+			break;
+		}
+		received += static_cast<std::size_t>(result);
+	}
+}
+
+} //unnamed namespace
+
+TEST_CASE("NetBridge, datagram batches")
+{
+	SocketPair socketPair(SOCK_DGRAM);
+	REQUIRE(socketPair.fds[0] >= 0);
+
+	TickQueue queue;
+	std::vector<std::uint64_t> dataList;
+	appendTickListener(queue, dataList);
+
+	// Several frames in each datagram of 256 bytes.
+	TickSender sender(socketPair.fds[0], 256, 16);
+	TickReceiver receiver(socketPair.fds[1], 256, 16);
+
+	for(std::uint64_t i = 0; i < 50; ++i) {
+		REQUIRE(sender.send(1, Tick{ static_cast<std::int32_t>(i) * 2, 7, 0.5 }, i));
+	}
+	REQUIRE(sender.getPendingCount() == 50);
+	REQUIRE(receiver.receive(queue, false) == 0);
+	REQUIRE(sender.flush());
+	REQUIRE(sender.getPendingCount() == 0);
+
+	// All the datagrams in one receive.
+	REQUIRE(receiver.receive(queue, true) == 50);
+	queue.process();
+	REQUIRE(dataList.size() == 50);
+	for(std::uint64_t i = 0; i < 50; ++i) {
+		REQUIRE(dataList[i] == i);
+	}
+
+	// The buffer fills up, send flushes it.
+	dataList.clear();
+	for(std::uint64_t i = 0; i < 200; ++i) {
+		REQUIRE(sender.send(1, Tick{ static_cast<std::int32_t>(i) * 2, 7, 0.5 }, i));
+	}
+	REQUIRE(sender.flush());
+	receiveAll(receiver, queue, 200);
+	queue.process();
+	REQUIRE(dataList.size() == 200);
+	REQUIRE(dataList.back() == 199);
+	REQUIRE(receiver.getDroppedFrameCount() == 0);
+}
+
+TEST_CASE("NetBridge, malformed datagram")
+{
+	SocketPair socketPair(SOCK_DGRAM);
+	REQUIRE(socketPair.fds[0] >= 0);
+
+	TickQueue queue;
+	std::vector<std::uint64_t> dataList;
+	appendTickListener(queue, dataList);
+	TickReceiver receiver(socketPair.fds[1]);
+
+	const char garbage[64] = { 1, 2, 3 };
+	REQUIRE(send(socketPair.fds[0], garbage, sizeof(garbage), 0) == sizeof(garbage));
+	{
+		TickSender sender(socketPair.fds[0]);
+		sender.send(1, Tick{ 6, 7, 0.5 }, 3);
+		// The destructor flushes.
+	}
+
+	REQUIRE(receiver.receive(queue) == 1);
+	REQUIRE(receiver.getDroppedFrameCount() == 1);
+	queue.process();
+	REQUIRE(dataList == std::vector<std::uint64_t>{ 3 });
+}
+
+TEST_CASE("NetBridge, stream with split frames")
+{
+	SocketPair socketPair(SOCK_STREAM);
+	REQUIRE(socketPair.fds[0] >= 0);
+
+	TickQueue queue;
+	std::vector<std::uint64_t> dataList;
+	appendTickListener(queue, dataList);
+
+	// The receive buffer of 100 bytes doesn't end at a frame boundary.
+	TickSender sender(socketPair.fds[0], 256, 4);
+	TickReceiver receiver(socketPair.fds[1], 100, 1);
+
+	for(std::uint64_t i = 0; i < 30; ++i) {
+		REQUIRE(sender.send(1, Tick{ static_cast<std::int32_t>(i) * 2, 7, 0.5 }, i));
+	}
+	REQUIRE(sender.flush());
+	receiveAll(receiver, queue, 30);
+	queue.process();
+	REQUIRE(dataList.size() == 30);
+	for(std::uint64_t i = 0; i < 30; ++i) {
+		REQUIRE(dataList[i] == i);
+	}
+
+	const char garbage[64] = { 1, 2, 3 };
+	REQUIRE(send(socketPair.fds[0], garbage, sizeof(garbage), 0) == sizeof(garbage));
+	REQUIRE(receiver.receive(queue) == -1);
+	REQUIRE(errno == EPROTO);
+
+	close(socketPair.fds[0]);
+	socketPair.fds[0] = -1;
+	REQUIRE(receiver.receive(queue) == -1);
+	REQUIRE(errno == ENOTCONN);
+}
+
+TEST_CASE("NetBridge, UDP loopback")
+{
+	const int receiveFd = socket(AF_INET, SOCK_DGRAM, 0);
+	const int sendFd = socket(AF_INET, SOCK_DGRAM, 0);
+	REQUIRE(receiveFd >= 0);
+	REQUIRE(sendFd >= 0);
+
+	sockaddr_in address {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = 0;
+	socklen_t addressLength = sizeof(address);
+	REQUIRE(bind(receiveFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+	REQUIRE(getsockname(receiveFd, reinterpret_cast<sockaddr *>(&address), &addressLength) == 0);
+	REQUIRE(connect(sendFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0);
+
+	TickQueue queue;
+	std::vector<std::uint64_t> dataList;
+	appendTickListener(queue, dataList);
+	{
+		TickSender sender(sendFd);
+		TickReceiver receiver(receiveFd);
+
+		for(std::uint64_t i = 0; i < 100; ++i) {
+			sender.send(1, Tick{ static_cast<std::int32_t>(i) * 2, 7, 0.5 }, i);
+		}
+		REQUIRE(sender.flush());
+		REQUIRE(receiver.receive(queue) > 0);
+		receiveAll(receiver, queue, 100);
+	}
+	queue.process();
+	REQUIRE(dataList.size() == 100);
+	REQUIRE(dataList.back() == 99);
+
+	close(sendFd);
+	close(receiveFd);
+}
+
+#endif
@@ -13,6 +13,10 @@
 
 #include "test.h"
 #include "eventpp/eventdispatcher.h"
+#include "eventpp/eventqueue.h"
+
+#include <tuple>
+#include <vector>
 
 class CopyMoveCounter
 {
@@ -349,3 +353,296 @@ TEST_CASE("copymove, EventDispatcher<void(const &)>, callback(value)")
 	}
 }
 
+
+namespace {
+
+struct EmplacedPayload
+{
+	static int copied;
+	static int moved;
+
+	EmplacedPayload(const int a, const int b) : a(a), b(b) {
+	}
+
+	EmplacedPayload(const EmplacedPayload & other) : a(other.a), b(other.b) {
+		++copied;
+	}
+
+	EmplacedPayload(EmplacedPayload && other) : a(other.a), b(other.b) {
+		++moved;
+	}
+
+	int a;
+	int b;
+};
+
+int EmplacedPayload::copied = 0;
+int EmplacedPayload::moved = 0;
+
+} //namespace
+
+TEST_CASE("copymove, EventQueue<void(const &)>, enqueue, emplace and reserve")
+{
+	using EQ = eventpp::EventQueue<int, void(const CopyMoveCounter &)>;
+	EQ queue;
+
+	int expectedCopied = 0;
+	int expectedMoved = 0;
+	int calledCount = 0;
+	queue.appendListener(1, [&](const CopyMoveCounter & obj) {
+		REQUIRE(obj.getCounter().copied == expectedCopied);
+		REQUIRE(obj.getCounter().moved == expectedMoved);
+		++calledCount;
+	});
+
+	SECTION("enqueue: temporary object is moved once") {
+		expectedMoved = 1;
+		queue.enqueue(1, CopyMoveCounter());
+	}
+	SECTION("enqueue: object variable is copied once") {
+		expectedCopied = 1;
+		CopyMoveCounter obj1;
+		queue.enqueue(1, obj1);
+	}
+	SECTION("emplace: constructed in the queue") {
+		queue.emplace(1);
+	}
+	SECTION("emplace: object variable is copied once") {
+		expectedCopied = 1;
+		CopyMoveCounter obj1;
+		queue.emplace(1, obj1);
+	}
+	SECTION("reserve and commit") {
+		auto slot = queue.reserve(1);
+		REQUIRE(slot.isActive());
+		slot.getArgument<0>().called();
+		slot.commit();
+		REQUIRE(! slot.isActive());
+	}
+	SECTION("ProducerBuffer: temporary object is moved once") {
+		expectedMoved = 1;
+		EQ::ProducerBuffer buffer(&queue);
+		buffer.enqueue(1, CopyMoveCounter());
+	}
+	SECTION("enqueueBulk: tuple elements are copied once") {
+		expectedCopied = 1;
+		std::vector<std::tuple<int, CopyMoveCounter> > eventList(1);
+		std::get<0>(eventList.front()) = 1;
+		queue.enqueueBulk(eventList.begin(), eventList.end());
+	}
+
+	queue.process();
+	REQUIRE(calledCount == 1);
+}
+
+TEST_CASE("copymove, EventQueue, emplace from constructor arguments")
+{
+	EmplacedPayload::copied = 0;
+	EmplacedPayload::moved = 0;
+
+	eventpp::EventQueue<int, void(const EmplacedPayload &)> queue;
+	int sum = 0;
+	queue.appendListener(1, [&sum](const EmplacedPayload & payload) {
+		sum += payload.a * 10 + payload.b;
+	});
+
+	queue.emplace(1, 3, 4);
+	queue.enqueue(1, EmplacedPayload(5, 6));
+	REQUIRE(EmplacedPayload::copied == 0);
+	REQUIRE(EmplacedPayload::moved == 1);
+
+	queue.process();
+	REQUIRE(sum == 34 + 56);
+	REQUIRE(EmplacedPayload::copied == 0);
+	REQUIRE(EmplacedPayload::moved == 1);
+}
+
+TEST_CASE("copymove, EventQueue, reserve without commit")
+{
+	eventpp::EventQueue<int, void(int)> queue;
+	queue.appendListener(1, [](int) {
+		REQUIRE(false);
+	});
+
+	{
+		auto slot = queue.reserve(1);
+		slot.getArgument<0>() = 5;
+	}
+	{
+		auto slot = queue.reserve(1);
+		auto moved = std::move(slot);
+		REQUIRE(! slot.isActive());
+		REQUIRE(moved.isActive());
+		moved.cancel();
+		REQUIRE(! moved.isActive());
+	}
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(! queue.process());
+
+	int value = 0;
+	queue.appendListener(2, [&value](const int n) {
+		value = n;
+	});
+	auto slot = queue.reserve(2);
+	slot.getArgument<0>() = 8;
+	slot.commit();
+	REQUIRE(queue.process());
+	REQUIRE(value == 8);
+}
+
+TEST_CASE("copymove, EventQueue, borrowEvents")
+{
+	EmplacedPayload::copied = 0;
+	EmplacedPayload::moved = 0;
+
+	using EQ = eventpp::EventQueue<int, void(const EmplacedPayload &)>;
+	EQ queue;
+	queue.emplace(1, 3, 4);
+	queue.emplace(2, 5, 6);
+
+	int sum = 0;
+	{
+		auto borrowed = queue.borrowEvents();
+		REQUIRE(borrowed.size() == 2);
+		for(const EQ::QueuedEvent & item : borrowed) {
+			sum += item.getArgument<0>().a * 10 + item.getArgument<0>().b;
+		}
+	}
+	REQUIRE(sum == 34 + 56);
+	REQUIRE(EmplacedPayload::copied == 0);
+	REQUIRE(EmplacedPayload::moved == 0);
+}
+
+namespace {
+
+struct FanOutMoveLastPolicies
+{
+	using ArgumentFanOut = eventpp::ArgumentFanOutMoveLast;
+};
+
+struct FanOutSharedPolicies
+{
+	using ArgumentFanOut = eventpp::ArgumentFanOutShared;
+};
+
+} //namespace
+
+TEST_CASE("copymove, CallbackList<void(value)>, ArgumentFanOutMoveLast")
+{
+	using CL = eventpp::CallbackList<void(CopyMoveCounter, int), FanOutMoveLastPolicies>;
+	CL callbackList;
+
+	std::vector<std::pair<int, int> > seenList;
+	auto byReference = [&seenList](const CopyMoveCounter & obj, int) {
+		seenList.emplace_back(obj.getCounter().copied, obj.getCounter().moved);
+	};
+	auto byValue = [&seenList](CopyMoveCounter obj, int) {
+		seenList.emplace_back(obj.getCounter().copied, obj.getCounter().moved);
+	};
+
+	SECTION("One listener gets the argument moved") {
+		callbackList.append(byValue);
+		callbackList(CopyMoveCounter(), 0);
+		REQUIRE(seenList == std::vector<std::pair<int, int> >{ { 0, 1 } });
+	}
+	SECTION("The listeners by reference share the argument, the last one gets it moved") {
+		callbackList.append(byReference);
+		callbackList.append(byReference);
+		callbackList.append(byValue);
+		callbackList(CopyMoveCounter(), 0);
+		REQUIRE(seenList == std::vector<std::pair<int, int> >{ { 0, 0 }, { 0, 0 }, { 0, 1 } });
+	}
+	SECTION("A listener by value which is not the last gets a copy") {
+		callbackList.append(byValue);
+		callbackList.append(byReference);
+		callbackList.append(byValue);
+		CopyMoveCounter obj;
+		callbackList(obj, 0);
+		// One copy to call the list, one for the first listener.
+		REQUIRE(seenList == std::vector<std::pair<int, int> >{ { 2, 0 }, { 2, 0 }, { 2, 1 } });
+	}
+	SECTION("A listener by rvalue reference which is not the last gets a copy") {
+		callbackList.append([&seenList](CopyMoveCounter && obj, int) {
+			CopyMoveCounter taken(std::move(obj));
+			seenList.emplace_back(taken.getCounter().copied, taken.getCounter().moved);
+		});
+		callbackList.append(byReference);
+		callbackList(CopyMoveCounter(), 0);
+		REQUIRE(seenList == std::vector<std::pair<int, int> >{ { 1, 1 }, { 1, 1 } });
+	}
+	SECTION("A listener removes the next one") {
+		CL::Handle second;
+		callbackList.append([&callbackList, &second, &seenList](const CopyMoveCounter &, int) {
+			callbackList.remove(second);
+			seenList.emplace_back(1, 0);
+		});
+		second = callbackList.append([&seenList](const CopyMoveCounter &, int) {
+			seenList.emplace_back(2, 0);
+		});
+		callbackList(CopyMoveCounter(), 0);
+		REQUIRE(seenList == std::vector<std::pair<int, int> >{ { 1, 0 } });
+	}
+}
+
+TEST_CASE("copymove, CallbackList<void(value)>, ArgumentFanOutShared")
+{
+	using CL = eventpp::CallbackList<void(CopyMoveCounter), FanOutSharedPolicies>;
+	CL callbackList;
+
+	std::vector<std::pair<int, int> > seenList;
+	for(int i = 0; i < 3; ++i) {
+		callbackList.append([&seenList](const CopyMoveCounter & obj) {
+			seenList.emplace_back(obj.getCounter().copied, obj.getCounter().moved);
+		});
+	}
+	CopyMoveCounter obj;
+	callbackList.invokeShared(obj);
+	REQUIRE(seenList == std::vector<std::pair<int, int> >{ { 0, 0 }, { 0, 0 }, { 0, 0 } });
+
+	// A copy of a FanOutCallback still shares.
+	CL copied(callbackList);
+	seenList.clear();
+	copied(CopyMoveCounter());
+	REQUIRE(seenList == std::vector<std::pair<int, int> >{ { 0, 0 }, { 0, 0 }, { 0, 0 } });
+}
+
+TEST_CASE("copymove, EventDispatcher<void(value)>, ArgumentFanOutMoveLast")
+{
+	using ED = eventpp::EventDispatcher<int, void(CopyMoveCounter), FanOutMoveLastPolicies>;
+	ED dispatcher;
+
+	std::vector<std::pair<int, int> > seenList;
+	dispatcher.appendListener(1, [&seenList](const CopyMoveCounter & obj) {
+		seenList.emplace_back(obj.getCounter().copied, obj.getCounter().moved);
+	});
+	dispatcher.appendListener(1, [&seenList](CopyMoveCounter obj) {
+		seenList.emplace_back(obj.getCounter().copied, obj.getCounter().moved);
+	});
+	dispatcher.dispatch(1, CopyMoveCounter());
+	// Moved to directDispatch, to the list, and to the last listener.
+	REQUIRE(seenList == std::vector<std::pair<int, int> >{ { 0, 2 }, { 0, 3 } });
+}
+
+TEST_CASE("copymove, EventQueue<void(value)>, ArgumentFanOutShared")
+{
+	using EQ = eventpp::EventQueue<int, void(CopyMoveCounter), FanOutSharedPolicies>;
+	EQ queue;
+
+	std::vector<std::pair<int, int> > seenList;
+	for(int i = 0; i < 2; ++i) {
+		queue.appendListener(1, [&seenList](const CopyMoveCounter & obj) {
+			seenList.emplace_back(obj.getCounter().copied, obj.getCounter().moved);
+		});
+	}
+
+	SECTION("process") {
+		queue.enqueue(1, CopyMoveCounter());
+		queue.process();
+	}
+	SECTION("processOne") {
+		queue.enqueue(1, CopyMoveCounter());
+		queue.processOne();
+	}
+	// Only moved into the queue, the listeners get the queued one.
+	REQUIRE(seenList == std::vector<std::pair<int, int> >{ { 0, 1 }, { 0, 1 } });
+}
@@ -0,0 +1,184 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// OPT-18: Tests for ParallelEventQueue
+
+#include "test.h"
+#include "eventpp/paralleleventqueue.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// The first argument is the shard key.
+struct KeyPolicies
+{
+	static std::size_t shardKey(const int /*event*/, const int key, const int /*sequence*/) {
+		return static_cast<std::size_t>(key);
+	}
+};
+
+} //unnamed namespace
+
+TEST_CASE("ParallelEventQueue, enqueue and process")
+{
+	eventpp::ParallelEventQueue<int, void (int, int)> queue(2);
+	REQUIRE(queue.getWorkerCount() == 2);
+	REQUIRE(queue.getShardCount() == 64);
+
+	std::vector<int> dataList(3);
+	queue.appendListener(1, [&dataList](int, int value) { dataList[0] += value; });
+	queue.appendListener(2, [&dataList](int, int value) { dataList[1] += value; });
+
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(! queue.process());
+	REQUIRE(! queue.waitFor(std::chrono::milliseconds(1)));
+
+	queue.enqueue(1, 5);
+	queue.enqueue(2, 6);
+	queue.enqueue(3, 7);
+	REQUIRE(! queue.emptyQueue());
+	REQUIRE(queue.waitFor(std::chrono::milliseconds(1)));
+	REQUIRE(dataList == std::vector<int>{ 0, 0, 0 });
+
+	REQUIRE(queue.process());
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(dataList == std::vector<int>{ 5, 6, 0 });
+
+	queue.enqueue(1, 1);
+	queue.clearEvents();
+	REQUIRE(queue.emptyQueue());
+	queue.process();
+	REQUIRE(dataList == std::vector<int>{ 5, 6, 0 });
+}
+
+TEST_CASE("ParallelEventQueue, same shard key keeps order")
+{
+	eventpp::ParallelEventQueue<int, void (int, int), KeyPolicies> queue(1);
+
+	std::vector<int> sequenceList;
+	queue.enqueue(0, 3, 0);
+	queue.enqueue(0, 5, 1);
+	queue.enqueue(0, 3, 2);
+	queue.enqueue(0, 3, 3);
+	queue.enqueue(0, 5, 4);
+
+	queue.processQueueWith([&sequenceList](int, int key, int sequence) {
+		if(key == 3) {
+			sequenceList.push_back(sequence);
+		}
+	});
+	REQUIRE(sequenceList == std::vector<int>{ 0, 2, 3 });
+}
+
+TEST_CASE("ParallelEventQueue, idle worker steals shards")
+{
+	eventpp::ParallelEventQueue<int, void (int, int), KeyPolicies> queue(4);
+
+	// Shard 0, 4, 8... are all in the deque of worker 0.
+	std::vector<int> sequenceList;
+	for(int i = 0; i < 10; ++i) {
+		queue.enqueue(0, (i % 2) * 4, i);
+	}
+
+	REQUIRE(queue.processQueueWith(3, [&sequenceList](int, int, int sequence) {
+		sequenceList.push_back(sequence);
+	}));
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(sequenceList.size() == 10);
+}
+
+TEST_CASE("ParallelEventQueue, listener throws")
+{
+	eventpp::ParallelEventQueue<int, void (int, int), KeyPolicies> queue(1);
+
+	std::vector<int> sequenceList;
+	queue.appendListener(0, [&sequenceList](int, int sequence) {
+		if(sequence == 1) {
+			throw std::runtime_error("test");
+		}
+		sequenceList.push_back(sequence);
+	});
+
+	for(int i = 0; i < 4; ++i) {
+		queue.enqueue(0, 7, i);
+	}
+
+	REQUIRE_THROWS(queue.process());
+	REQUIRE(sequenceList == std::vector<int>{ 0 });
+	REQUIRE(! queue.emptyQueue());
+
+	// The event which throws is counted as processed, the rest are kept in order.
+	REQUIRE(queue.process());
+	REQUIRE(sequenceList == std::vector<int>{ 0, 2, 3 });
+	REQUIRE(queue.emptyQueue());
+}
+
+TEST_CASE("ParallelEventQueue, multi threading, per key order")
+{
+	constexpr int workerCount = 4;
+	constexpr int producerCount = 4;
+	constexpr int keyCount = 32;
+	constexpr int itemCountPerProducer = 4000;
+	constexpr int itemCount = producerCount * itemCountPerProducer;
+
+	eventpp::ParallelEventQueue<int, void (int, int), KeyPolicies> queue(workerCount);
+
+	// Each producer owns its own keys, so for every key the sequence must grow.
+	std::vector<int> lastSequenceList(keyCount, -1);
+	std::atomic<int> processedCount(0);
+	std::atomic<int> outOfOrderCount(0);
+
+	std::vector<std::thread> workerList;
+	for(int w = 0; w < workerCount; ++w) {
+		workerList.emplace_back([&, w]() {
+			while(processedCount.load() < itemCount) {
+				if(queue.waitFor(std::chrono::milliseconds(10))) {
+					queue.processQueueWith(w, [&](int, int key, int sequence) {
+						if(sequence <= lastSequenceList[key]) {
+							++outOfOrderCount;
+						}
+						lastSequenceList[key] = sequence;
+						++processedCount;
+					});
+				}
+			}
+		});
+	}
+
+	std::vector<std::thread> producerList;
+	for(int p = 0; p < producerCount; ++p) {
+		producerList.emplace_back([&queue, p]() {
+			for(int i = 0; i < itemCountPerProducer; ++i) {
+				const int key = (i % (keyCount / producerCount)) * producerCount + p;
+				queue.enqueue(0, key, i);
+			}
+		});
+	}
+
+	for(auto & thread : producerList) {
+		thread.join();
+	}
+	for(auto & thread : workerList) {
+		thread.join();
+	}
+
+	REQUIRE(processedCount.load() == itemCount);
+	REQUIRE(outOfOrderCount.load() == 0);
+	REQUIRE(queue.emptyQueue());
+}
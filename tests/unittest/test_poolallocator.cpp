@@ -0,0 +1,466 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// OPT-20: Stress tests for NodePool
+// OPT-22: Stats and trim
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/internal/poolallocator_i.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <numeric>
+#include <algorithm>
+
+namespace {
+
+// Each test uses its own slot type, so it gets its own static pool.
+template <int tag>
+struct Slot
+{
+	uint64_t owner[4];
+};
+
+// Every thread fills the slots it holds with its own id and checks the
+// id is intact before freeing. If the pool hands out the same slot to two
+// threads, for example because of ABA, one of them sees a foreign id.
+template <typename Pool, typename T>
+int stressPool(const int threadCount, const int roundCount)
+{
+	std::atomic<int> corruptedCount(0);
+	std::vector<std::thread> threadList;
+	for(int t = 0; t < threadCount; ++t) {
+		threadList.emplace_back([t, roundCount, &corruptedCount]() {
+			const uint64_t id = static_cast<uint64_t>(t) + 1;
+			std::vector<T *> slotList;
+			for(int r = 0; r < roundCount; ++r) {
+				const int count = (r * 7 + t) % 64 + 1;
+				for(int i = 0; i < count; ++i) {
+					T * slot = Pool::instance().allocate();
+					std::fill(std::begin(slot->owner), std::end(slot->owner), id);
+					slotList.push_back(slot);
+				}
+				for(T * slot : slotList) {
+					if(std::any_of(std::begin(slot->owner), std::end(slot->owner), [id](uint64_t v) { return v != id; })) {
+						++corruptedCount;
+					}
+					Pool::instance().deallocate(slot);
+				}
+				slotList.clear();
+			}
+		});
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+	return corruptedCount.load();
+}
+
+struct MagazinePolicies
+{
+	template <typename T>
+	using QueueList = eventpp::PoolQueueList<T, 256, 16>;
+};
+
+struct MmapPolicies
+{
+	template <typename T>
+	using QueueList = eventpp::PoolQueueList<T, 1024, 32, eventpp::SlabSourceMmap<> >;
+};
+
+// A user supplied arena which hands out slabs from a static buffer.
+struct ArenaSlabSource
+{
+	static void * allocate(const std::size_t size, const std::size_t alignment) {
+		const std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(buffer);
+		const std::uintptr_t aligned = (begin + used + alignment - 1) & ~static_cast<std::uintptr_t>(alignment - 1);
+		if(aligned + size > begin + sizeof(buffer)) {
+			return nullptr;
+		}
+		used = static_cast<std::size_t>(aligned + size - begin);
+		++allocateCount;
+		return reinterpret_cast<void *>(aligned);
+	}
+
+	static void deallocate(void * /*p*/, const std::size_t /*size*/) {
+	}
+
+	alignas(64) static unsigned char buffer[64 * 1024];
+	static std::size_t used;
+	static int allocateCount;
+};
+
+alignas(64) unsigned char ArenaSlabSource::buffer[64 * 1024];
+std::size_t ArenaSlabSource::used = 0;
+int ArenaSlabSource::allocateCount = 0;
+
+template <typename Pool, typename T>
+bool allocateAndFree(const int count)
+{
+	std::vector<T *> slotList;
+	for(int i = 0; i < count; ++i) {
+		T * slot = Pool::instance().allocate();
+		if(slot == nullptr) {
+			break;
+		}
+		slot->owner[0] = static_cast<uint64_t>(i);
+		slot->owner[3] = static_cast<uint64_t>(i);
+		slotList.push_back(slot);
+	}
+	bool intact = (static_cast<int>(slotList.size()) == count);
+	for(std::size_t i = 0; i < slotList.size(); ++i) {
+		intact = intact && slotList[i]->owner[0] == i && slotList[i]->owner[3] == i;
+		Pool::instance().deallocate(slotList[i]);
+	}
+	return intact;
+}
+
+struct PoolNodePolicies
+{
+	template <typename T>
+	using NodeAllocator = eventpp::PoolAllocator<T, 64, 0>;
+};
+
+struct ReservePolicies
+{
+	template <typename T>
+	using QueueList = eventpp::PoolQueueList<T, 64, 0>;
+};
+
+} //unnamed namespace
+
+TEST_CASE("NodePool, stress, shared free list only")
+{
+	using T = Slot<1>;
+	using Pool = eventpp::internal_::NodePool<T, 256, 0>;
+	REQUIRE(stressPool<Pool, T>(16, 2000) == 0);
+}
+
+TEST_CASE("NodePool, stress, magazines")
+{
+	using T = Slot<2>;
+	using Pool = eventpp::internal_::NodePool<T, 256, 8>;
+	REQUIRE(stressPool<Pool, T>(16, 2000) == 0);
+}
+
+TEST_CASE("NodePool, nodes allocated in one thread and freed in another")
+{
+	using T = Slot<3>;
+	using Pool = eventpp::internal_::NodePool<T, 128, 8>;
+
+	constexpr int producerCount = 8;
+	constexpr int itemCountPerProducer = 20000;
+	constexpr int itemCount = producerCount * itemCountPerProducer;
+
+	eventpp::EventQueue<int, void (T *)> queue;
+	int freedCount = 0;
+	int corruptedCount = 0;
+	queue.appendListener(0, [&freedCount, &corruptedCount](T * slot) {
+		if(slot->owner[0] != slot->owner[3]) {
+			++corruptedCount;
+		}
+		Pool::instance().deallocate(slot);
+		++freedCount;
+	});
+
+	std::thread consumer([&queue, &freedCount]() {
+		while(freedCount < itemCount) {
+			if(queue.waitFor(std::chrono::milliseconds(10))) {
+				queue.process();
+			}
+		}
+	});
+
+	std::vector<std::thread> producerList;
+	for(int p = 0; p < producerCount; ++p) {
+		producerList.emplace_back([&queue, p]() {
+			for(int i = 0; i < itemCountPerProducer; ++i) {
+				T * slot = Pool::instance().allocate();
+				const uint64_t value = static_cast<uint64_t>(p) * itemCountPerProducer + i;
+				std::fill(std::begin(slot->owner), std::end(slot->owner), value);
+				queue.enqueue(0, slot);
+			}
+		});
+	}
+	for(auto & thread : producerList) {
+		thread.join();
+	}
+	consumer.join();
+
+	REQUIRE(freedCount == itemCount);
+	REQUIRE(corruptedCount == 0);
+}
+
+TEST_CASE("NodePool, PoolQueueList with magazines, multi producers")
+{
+	constexpr int producerCount = 8;
+	constexpr int itemCountPerProducer = 10000;
+	constexpr int itemCount = producerCount * itemCountPerProducer;
+
+	eventpp::EventQueue<int, void (int, int), MagazinePolicies> queue;
+	std::vector<int> dataList(itemCount);
+	int processedCount = 0;
+	queue.appendListener(0, [&dataList, &processedCount](int, int value) {
+		++dataList[value];
+		++processedCount;
+	});
+
+	std::thread consumer([&queue, &processedCount]() {
+		while(processedCount < itemCount) {
+			if(queue.waitFor(std::chrono::milliseconds(10))) {
+				queue.process();
+			}
+		}
+	});
+
+	std::vector<std::thread> producerList;
+	for(int p = 0; p < producerCount; ++p) {
+		producerList.emplace_back([&queue, p]() {
+			for(int i = 0; i < itemCountPerProducer; ++i) {
+				queue.enqueue(0, p * itemCountPerProducer + i);
+			}
+		});
+	}
+	for(auto & thread : producerList) {
+		thread.join();
+	}
+	consumer.join();
+
+	REQUIRE(std::all_of(dataList.begin(), dataList.end(), [](int value) { return value == 1; }));
+}
+
+TEST_CASE("NodePool, SlabSourceMmap")
+{
+	using T = Slot<4>;
+	REQUIRE(allocateAndFree<eventpp::internal_::NodePool<T, 1000, 8, eventpp::SlabSourceMmap<false> >, T>(5000));
+
+	using U = Slot<5>;
+	// Falls back to normal pages if no huge page is reserved, the NUMA node
+	// is only a preference.
+	REQUIRE(allocateAndFree<eventpp::internal_::NodePool<U, 1000, 8, eventpp::SlabSourceMmap<true, 0, true> >, U>(5000));
+}
+
+TEST_CASE("NodePool, user arena slab source")
+{
+	using T = Slot<6>;
+	using Pool = eventpp::internal_::NodePool<T, 64, 0, ArenaSlabSource>;
+
+	REQUIRE(allocateAndFree<Pool, T>(64));
+	REQUIRE(ArenaSlabSource::allocateCount == 1);
+	REQUIRE(allocateAndFree<Pool, T>(200));
+	REQUIRE(ArenaSlabSource::allocateCount == 4);
+
+	// The arena is exhausted, allocate returns nullptr instead of using the heap.
+	REQUIRE(! allocateAndFree<Pool, T>(100000));
+}
+
+TEST_CASE("NodePool, PoolQueueList with SlabSourceMmap")
+{
+	eventpp::EventQueue<int, void (int), MmapPolicies> queue;
+	int sum = 0;
+	queue.appendListener(1, [&sum](int value) { sum += value; });
+	for(int i = 0; i < 10000; ++i) {
+		queue.enqueue(1, i);
+	}
+	queue.process();
+	REQUIRE(sum == 10000 * 9999 / 2);
+}
+
+TEST_CASE("NodePool, stats and trim")
+{
+	using T = Slot<7>;
+	using Pool = eventpp::internal_::NodePool<T, 64, 0>;
+	Pool & pool = Pool::instance();
+
+	eventpp::PoolStats stats = pool.getStats();
+	REQUIRE(stats.slabCount == 1);
+	REQUIRE(stats.slotCount == 64);
+	REQUIRE(stats.usedSlotCount == 0);
+	REQUIRE(stats.growCount == 1);
+
+	std::vector<T *> slotList;
+	for(int i = 0; i < 640; ++i) {
+		slotList.push_back(pool.allocate());
+	}
+	stats = pool.getStats();
+	REQUIRE(stats.slabCount == 10);
+	REQUIRE(stats.usedSlotCount == 640);
+	REQUIRE(stats.freeSlotCount == 0);
+	REQUIRE(stats.peakUsedSlotCount == 640);
+	REQUIRE(stats.growCount == 10);
+
+	// A slab with any slot in use is not released.
+	for(std::size_t i = 1; i < slotList.size(); ++i) {
+		pool.deallocate(slotList[i]);
+	}
+	REQUIRE(pool.trim(0) == 9);
+	stats = pool.getStats();
+	REQUIRE(stats.slabCount == 1);
+	REQUIRE(stats.usedSlotCount == 1);
+	REQUIRE(stats.trimmedSlabCount == 9);
+	pool.deallocate(slotList[0]);
+	slotList.clear();
+
+	// The burst again, then keep 3 free slabs.
+	for(int i = 0; i < 640; ++i) {
+		slotList.push_back(pool.allocate());
+	}
+	REQUIRE(pool.getStats().growCount == 19);
+	for(T * slot : slotList) {
+		pool.deallocate(slot);
+	}
+	slotList.clear();
+	REQUIRE(pool.trim(3) == 7);
+	stats = pool.getStats();
+	REQUIRE(stats.slabCount == 3);
+	REQUIRE(stats.freeSlotCount == 3 * 64);
+	REQUIRE(stats.usedSlotCount == 0);
+	REQUIRE(stats.peakUsedSlotCount == 640);
+
+	REQUIRE(pool.trim(0) == 3);
+	REQUIRE(pool.getStats().slabCount == 0);
+	// The pool grows again from empty.
+	REQUIRE(allocateAndFree<Pool, T>(100));
+	REQUIRE(pool.getStats().slabCount == 2);
+}
+
+TEST_CASE("NodePool, trim with magazines")
+{
+	using T = Slot<8>;
+	using Pool = eventpp::internal_::NodePool<T, 64, 8>;
+	Pool & pool = Pool::instance();
+
+	REQUIRE(allocateAndFree<Pool, T>(640));
+	const eventpp::PoolStats stats = pool.getStats();
+	REQUIRE(stats.slabCount == 10);
+	// The magazine of this thread keeps up to 2 * 8 slots, which keep up to 2 slabs.
+	REQUIRE(stats.usedSlotCount <= 16);
+	REQUIRE(pool.trim(0) >= 8);
+	REQUIRE(pool.getStats().slabCount <= 2);
+	REQUIRE(allocateAndFree<Pool, T>(640));
+
+	const eventpp::PoolStats total = eventpp::getPoolStats();
+	REQUIRE(total.slabCount >= pool.getStats().slabCount);
+	REQUIRE(total.slabBytes >= pool.getStats().slabBytes);
+	REQUIRE(eventpp::trimPools(0) >= 8);
+}
+
+TEST_CASE("NodePool, trim while other threads allocate")
+{
+	using T = Slot<9>;
+	using Pool = eventpp::internal_::NodePool<T, 64, 4>;
+
+	std::atomic<bool> stopped(false);
+	std::thread trimmer([&stopped]() {
+		while(! stopped.load()) {
+			Pool::instance().trim(0);
+			std::this_thread::yield();
+		}
+	});
+	const int corruptedCount = stressPool<Pool, T>(8, 2000);
+	stopped = true;
+	trimmer.join();
+	REQUIRE(corruptedCount == 0);
+	REQUIRE(allocateAndFree<Pool, T>(1000));
+}
+
+TEST_CASE("NodePool, CallbackList nodes from NodeAllocator")
+{
+	using CL = eventpp::CallbackList<void (int), PoolNodePolicies>;
+	CL callbackList;
+	std::vector<CL::Handle> handleList;
+	int sum = 0;
+
+	const std::size_t usedSlotCount = eventpp::getPoolStats().usedSlotCount;
+	for(int i = 0; i < 100; ++i) {
+		handleList.push_back(callbackList.append([&sum](int value) { sum += value; }));
+	}
+	REQUIRE(eventpp::getPoolStats().usedSlotCount == usedSlotCount + 100);
+	callbackList(1);
+	REQUIRE(sum == 100);
+
+	for(auto & handle : handleList) {
+		callbackList.remove(handle);
+	}
+	handleList.clear();
+	REQUIRE(eventpp::getPoolStats().usedSlotCount == usedSlotCount);
+
+	// The freed slots are reused, the pool doesn't grow.
+	const std::size_t growCount = eventpp::getPoolStats().growCount;
+	for(int i = 0; i < 100; ++i) {
+		handleList.push_back(callbackList.append([&sum](int value) { sum += value; }));
+	}
+	REQUIRE(eventpp::getPoolStats().growCount == growCount);
+}
+
+TEST_CASE("NodePool, reserve and lockMemory")
+{
+	using T = Slot<10>;
+	using Pool = eventpp::internal_::NodePool<T, 64, 0>;
+	Pool & pool = Pool::instance();
+
+	REQUIRE(eventpp::PoolAllocator<T, 64, 0>::reserve(300));
+	eventpp::PoolStats stats = pool.getStats();
+	REQUIRE(stats.slabCount == 5);
+	REQUIRE(stats.freeSlotCount == 320);
+
+	// Already has enough free slots.
+	REQUIRE(pool.reserve(100));
+	REQUIRE(pool.getStats().growCount == 5);
+
+	// The slabs may not be locked over RLIMIT_MEMLOCK, the pool still works.
+	pool.lockMemory();
+	eventpp::lockPoolMemory();
+	REQUIRE(allocateAndFree<Pool, T>(320));
+	REQUIRE(pool.getStats().growCount == 5);
+}
+
+TEST_CASE("NodePool, CallbackList::reserveNodes")
+{
+	using CL = eventpp::CallbackList<void (int), PoolNodePolicies>;
+	CL callbackList;
+	callbackList.reserveNodes(200);
+	REQUIRE(callbackList.empty());
+
+	const std::size_t growCount = eventpp::getPoolStats().growCount;
+	int sum = 0;
+	for(int i = 0; i < 200; ++i) {
+		callbackList.append([&sum](int value) { sum += value; });
+	}
+	REQUIRE(eventpp::getPoolStats().growCount == growCount);
+	callbackList(1);
+	REQUIRE(sum == 200);
+}
+
+TEST_CASE("NodePool, EventQueue::reserveNodes")
+{
+	using EQ = eventpp::EventQueue<int, void (int), ReservePolicies>;
+	EQ queue;
+	queue.reserveNodes(500);
+	queue.reserveNodes(100);
+
+	const std::size_t growCount = eventpp::getPoolStats().growCount;
+	const std::size_t usedSlotCount = eventpp::getPoolStats().usedSlotCount;
+	int sum = 0;
+	queue.appendListener(1, [&sum](int value) { sum += value; });
+	for(int i = 0; i < 500; ++i) {
+		queue.enqueue(1, 1);
+	}
+	// The nodes come from the free list of the queue, not from the pool.
+	REQUIRE(eventpp::getPoolStats().growCount == growCount);
+	REQUIRE(eventpp::getPoolStats().usedSlotCount == usedSlotCount);
+	queue.process();
+	REQUIRE(sum == 500);
+}
@@ -14,6 +14,11 @@
 #include "test.h"
 #include "eventpp/eventqueue.h"
 
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+
 TEST_CASE("EventQueue, std::string, void (const std::string &)")
 {
 	eventpp::EventQueue<std::string, void (const std::string &)> queue;
@@ -828,3 +833,452 @@ TEST_CASE("EventQueue, processUntil")
 	REQUIRE(! queue.processUntil([]() -> bool { return true; }));
 }
 
+
+TEST_CASE("EventQueue, enqueueBulk")
+{
+	eventpp::EventQueue<int, void (int, const std::string &)> queue;
+
+	std::vector<int> eventList;
+	std::string text;
+	queue.appendListener(1, [&eventList, &text](int event, const std::string & s) {
+		eventList.push_back(event);
+		text += s;
+	});
+	queue.appendListener(2, [&eventList, &text](int event, const std::string & s) {
+		eventList.push_back(event);
+		text += s;
+	});
+
+	SECTION("iterator range") {
+		const std::vector<std::tuple<int, std::string> > itemList {
+			std::make_tuple(1, "a"),
+			std::make_tuple(2, "b"),
+			std::make_tuple(1, "c")
+		};
+		queue.enqueue(2, "x");
+		queue.enqueueBulk(itemList.begin(), itemList.end());
+		REQUIRE(! queue.emptyQueue());
+
+		queue.process();
+		REQUIRE(eventList == std::vector<int>{ 2, 1, 2, 1 });
+		REQUIRE(text == "xabc");
+	}
+
+	SECTION("empty range") {
+		const std::vector<std::tuple<int, std::string> > itemList;
+		queue.enqueueBulk(itemList.begin(), itemList.end());
+		REQUIRE(queue.emptyQueue());
+	}
+
+	SECTION("generator") {
+		queue.enqueueBulk(4, [](const size_t index) {
+			return std::make_tuple((int)(index % 2) + 1, std::string(1, (char)('a' + index)));
+		});
+
+		queue.process();
+		REQUIRE(eventList == std::vector<int>{ 1, 2, 1, 2 });
+		REQUIRE(text == "abcd");
+	}
+
+	SECTION("recycled items are reused") {
+		queue.enqueue(1, "a");
+		queue.enqueue(1, "b");
+		queue.process();
+
+		queue.enqueueBulk(3, [](const size_t index) {
+			return std::make_tuple(2, std::to_string(index));
+		});
+		queue.process();
+		REQUIRE(eventList == std::vector<int>{ 1, 1, 2, 2, 2 });
+		REQUIRE(text == "ab012");
+	}
+}
+
+TEST_CASE("EventQueue, enqueueBulk, single argument element")
+{
+	struct Policies
+	{
+		static int getEvent(const int e) {
+			return e;
+		}
+	};
+
+	eventpp::EventQueue<int, void (int), Policies> queue;
+
+	std::vector<int> eventList;
+	queue.appendListener(3, [&eventList](int e) {
+		eventList.push_back(e);
+	});
+	queue.appendListener(5, [&eventList](int e) {
+		eventList.push_back(e);
+	});
+
+	const std::vector<int> itemList { 3, 5, 3 };
+	queue.enqueueBulk(itemList.begin(), itemList.end());
+	queue.process();
+	REQUIRE(eventList == itemList);
+}
+
+TEST_CASE("EventQueue, enqueueBulk, movable only arguments")
+{
+	eventpp::EventQueue<int, void (std::unique_ptr<int> &)> queue;
+
+	int sum = 0;
+	queue.appendListener(1, [&sum](std::unique_ptr<int> & p) {
+		sum += *p;
+	});
+
+	std::vector<std::tuple<int, std::unique_ptr<int> > > itemList;
+	itemList.emplace_back(1, std::unique_ptr<int>(new int(3)));
+	itemList.emplace_back(1, std::unique_ptr<int>(new int(5)));
+	queue.enqueueBulk(std::make_move_iterator(itemList.begin()), std::make_move_iterator(itemList.end()));
+	REQUIRE(! std::get<1>(itemList[0]));
+
+	queue.process();
+	REQUIRE(sum == 8);
+}
+
+TEST_CASE("EventQueue, processN")
+{
+	eventpp::EventQueue<int, void (int)> queue;
+
+	std::vector<int> eventList;
+	for(int i = 0; i < 5; ++i) {
+		queue.appendListener(i, [&eventList](int e) {
+			eventList.push_back(e);
+		});
+	}
+
+	REQUIRE(! queue.processN(3));
+
+	for(int i = 0; i < 5; ++i) {
+		queue.enqueue(i);
+	}
+
+	REQUIRE(! queue.processN(0));
+	REQUIRE(eventList.empty());
+
+	REQUIRE(queue.processN(2));
+	REQUIRE(eventList == std::vector<int>{ 0, 1 });
+
+	queue.enqueue(0);
+	REQUIRE(queue.processN(2));
+	REQUIRE(eventList == std::vector<int>{ 0, 1, 2, 3 });
+
+	REQUIRE(queue.processN(10));
+	REQUIRE(eventList == std::vector<int>{ 0, 1, 2, 3, 4, 0 });
+	REQUIRE(queue.emptyQueue());
+}
+
+TEST_CASE("EventQueue, processFor")
+{
+	eventpp::EventQueue<int, void (int)> queue;
+
+	std::vector<int> eventList;
+	queue.appendListener(1, [&eventList](int e) {
+		eventList.push_back(e);
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	});
+	queue.appendListener(2, [&eventList](int e) {
+		eventList.push_back(e);
+	});
+
+	REQUIRE(! queue.processFor(std::chrono::milliseconds(1)));
+
+	SECTION("budget runs out") {
+		queue.enqueue(1);
+		queue.enqueue(2);
+		queue.enqueue(1);
+		queue.enqueue(2);
+
+		// At least one event is processed even if the budget is zero.
+		REQUIRE(queue.processFor(std::chrono::milliseconds(0)));
+		REQUIRE(eventList == std::vector<int>{ 1 });
+
+		queue.enqueue(1);
+		REQUIRE(queue.processFor(std::chrono::milliseconds(2)));
+		REQUIRE(eventList == std::vector<int>{ 1, 2, 1 });
+
+		queue.process();
+		REQUIRE(eventList == std::vector<int>{ 1, 2, 1, 2, 1 });
+	}
+
+	SECTION("enough budget") {
+		queue.enqueue(2);
+		queue.enqueue(2);
+		queue.enqueue(2);
+		REQUIRE(queue.processFor(std::chrono::seconds(10)));
+		REQUIRE(eventList == std::vector<int>{ 2, 2, 2 });
+		REQUIRE(queue.emptyQueue());
+	}
+}
+
+TEST_CASE("EventQueue, processNWith and processForWith")
+{
+	eventpp::EventQueue<int, void (int, const std::string &)> queue;
+
+	std::vector<int> eventList;
+	std::string text;
+	auto visitor = [&eventList, &text](const int event, int, const std::string & s) {
+		eventList.push_back(event);
+		text += s;
+	};
+
+	queue.enqueue(1, "a");
+	queue.enqueue(2, "b");
+	queue.enqueue(3, "c");
+
+	REQUIRE(queue.processNWith(2, visitor));
+	REQUIRE(eventList == std::vector<int>{ 1, 2 });
+	REQUIRE(text == "ab");
+
+	REQUIRE(queue.processForWith(std::chrono::seconds(10), visitor));
+	REQUIRE(eventList == std::vector<int>{ 1, 2, 3 });
+	REQUIRE(text == "abc");
+
+	REQUIRE(! queue.processNWith(2, visitor));
+	REQUIRE(! queue.processForWith(std::chrono::seconds(10), visitor));
+}
+
+TEST_CASE("EventQueue, ProducerBuffer")
+{
+	using EQ = eventpp::EventQueue<int, void (int, int)>;
+	EQ queue;
+
+	std::vector<int> dataList;
+	queue.appendListener(1, [&dataList](int, int value) {
+		dataList.push_back(value);
+	});
+
+	SECTION("flush on threshold") {
+		EQ::ProducerBuffer buffer(&queue, 3);
+		buffer.enqueue(1, 1);
+		buffer.enqueue(1, 2);
+		REQUIRE(queue.emptyQueue());
+		buffer.enqueue(1, 3);
+		REQUIRE(! queue.emptyQueue());
+
+		buffer.enqueue(1, 4);
+		queue.process();
+		REQUIRE(dataList == std::vector<int>{ 1, 2, 3, 4 });
+	}
+
+	SECTION("explicit flush") {
+		EQ::ProducerBuffer buffer(&queue);
+		buffer.enqueue(1, 1);
+		REQUIRE(queue.emptyQueue());
+		buffer.flush();
+		REQUIRE(! queue.emptyQueue());
+		buffer.flush();
+		queue.process();
+		REQUIRE(dataList == std::vector<int>{ 1 });
+	}
+
+	SECTION("flush on destroy") {
+		{
+			EQ::ProducerBuffer buffer(&queue);
+			buffer.enqueue(1, 1);
+			buffer.enqueue(1, 2);
+		}
+		REQUIRE(! queue.emptyQueue());
+		queue.process();
+		REQUIRE(dataList == std::vector<int>{ 1, 2 });
+	}
+
+	SECTION("flush on process") {
+		EQ::ProducerBuffer buffer1(&queue);
+		EQ::ProducerBuffer buffer2(&queue);
+		buffer1.enqueue(1, 1);
+		buffer2.enqueue(1, 10);
+		buffer1.enqueue(1, 2);
+		REQUIRE(queue.process());
+		std::sort(dataList.begin(), dataList.end());
+		REQUIRE(dataList == std::vector<int>{ 1, 2, 10 });
+
+		dataList.clear();
+		buffer2.enqueue(1, 11);
+		REQUIRE(queue.processOne());
+		REQUIRE(dataList == std::vector<int>{ 11 });
+	}
+}
+
+TEST_CASE("EventQueue, process runs of the same event")
+{
+	using EQ = eventpp::EventQueue<int, void (int, int)>;
+	EQ queue;
+	std::vector<int> dataList;
+
+	queue.appendListener(1, [&dataList](int, int value) {
+		dataList.push_back(value);
+	});
+	queue.appendListener(2, [&dataList](int, int value) {
+		dataList.push_back(-value);
+	});
+
+	SECTION("the order is kept") {
+		for(int i = 0; i < 10; ++i) {
+			queue.enqueue(i % 4 < 3 ? 1 : 2, i);
+		}
+		queue.enqueue(3, 100);
+		queue.enqueue(1, 10);
+		queue.process();
+		REQUIRE(dataList == std::vector<int>{ 0, 1, 2, -3, 4, 5, 6, -7, 8, 9, 10 });
+	}
+
+	SECTION("a listener added during the run is called for the next events") {
+		EQ::Handle handle;
+		queue.appendListener(1, [&queue, &dataList, &handle](int, int value) {
+			if(value == 1) {
+				queue.appendListener(3, [&dataList](int, int value) {
+					dataList.push_back(value * 100);
+				});
+				handle = queue.appendListener(1, [&dataList](int, int value) {
+					dataList.push_back(value * 10);
+				});
+			}
+			if(value == 2) {
+				queue.removeListener(1, handle);
+			}
+		});
+		queue.enqueue(3, 0);
+		queue.enqueue(1, 1);
+		queue.enqueue(3, 2);
+		queue.enqueue(1, 2);
+		queue.enqueue(1, 3);
+		queue.process();
+		REQUIRE(dataList == std::vector<int>{ 1, 200, 2, 3 });
+	}
+
+	SECTION("processN and processFor") {
+		for(int i = 0; i < 6; ++i) {
+			queue.enqueue(i < 3 ? 1 : 2, i);
+		}
+		queue.processN(4);
+		REQUIRE(dataList == std::vector<int>{ 0, 1, 2, -3 });
+		queue.processFor(std::chrono::seconds(10));
+		REQUIRE(dataList == std::vector<int>{ 0, 1, 2, -3, -4, -5 });
+	}
+}
+
+TEST_CASE("EventQueue, borrowEvents")
+{
+	using EQ = eventpp::EventQueue<int, void (std::shared_ptr<int>)>;
+	EQ queue;
+	int dispatchedCount = 0;
+	queue.appendListener(1, [&dispatchedCount](std::shared_ptr<int>) {
+		++dispatchedCount;
+	});
+
+	auto data = std::make_shared<int>(0);
+	for(int i = 0; i < 5; ++i) {
+		queue.enqueue(1, data);
+	}
+
+	SECTION("the events are read in place and destroyed at release") {
+		auto borrowed = queue.borrowEvents();
+		REQUIRE(borrowed.size() == 5);
+		REQUIRE(queue.emptyQueue());
+		REQUIRE(data.use_count() == 6);
+		int count = 0;
+		for(auto it = borrowed.begin(); it != borrowed.end(); ++it) {
+			REQUIRE(it->event == 1);
+			REQUIRE(it->getArgument<0>() == data);
+			++count;
+		}
+		REQUIRE(count == 5);
+		REQUIRE(! queue.process());
+		REQUIRE(dispatchedCount == 0);
+
+		borrowed.release();
+		REQUIRE(borrowed.empty());
+		REQUIRE(data.use_count() == 1);
+	}
+
+	SECTION("maxCount") {
+		{
+			auto borrowed = queue.borrowEvents(3);
+			REQUIRE(borrowed.size() == 3);
+			REQUIRE(! queue.emptyQueue());
+		}
+		REQUIRE(data.use_count() == 3);
+		REQUIRE(queue.borrowEvents(0).empty());
+		REQUIRE(queue.process());
+		REQUIRE(dispatchedCount == 2);
+		REQUIRE(queue.borrowEvents().empty());
+	}
+
+	SECTION("the batch can be moved") {
+		EQ::BorrowedEvents moved;
+		{
+			auto borrowed = queue.borrowEvents();
+			moved = std::move(borrowed);
+			REQUIRE(borrowed.empty());
+		}
+		REQUIRE(moved.size() == 5);
+		REQUIRE(data.use_count() == 6);
+		EQ::BorrowedEvents other(std::move(moved));
+		REQUIRE(other.front().getArgument<0>() == data);
+		other.release();
+		REQUIRE(data.use_count() == 1);
+	}
+
+	SECTION("the nodes are reused") {
+		queue.borrowEvents();
+		queue.enqueue(1, data);
+		REQUIRE(queue.process());
+		REQUIRE(dispatchedCount == 1);
+	}
+}
+
+namespace {
+
+template <std::size_t distance>
+struct PrefetchPolicies
+{
+	using QueuePrefetchDistance = std::integral_constant<std::size_t, distance>;
+};
+
+template <std::size_t distance>
+void doTestPrefetchDistance()
+{
+	using EQ = eventpp::EventQueue<int, void (const std::shared_ptr<int> &, int *), PrefetchPolicies<distance> >;
+	EQ queue;
+
+	int value = 0;
+	std::vector<int> dataList;
+	queue.appendListener(1, [&dataList](const std::shared_ptr<int> & data, int * p) {
+		dataList.push_back(*data + *p);
+	});
+
+	const std::size_t countList[] = { 0, 1, distance, distance + 1, 100 };
+	for(const std::size_t count : countList) {
+		dataList.clear();
+		for(std::size_t i = 0; i < count; ++i) {
+			queue.enqueue(1, std::make_shared<int>((int)i), &value);
+		}
+		REQUIRE(queue.process() == (count > 0));
+		REQUIRE(dataList.size() == count);
+		for(std::size_t i = 0; i < count; ++i) {
+			REQUIRE(dataList[i] == (int)i);
+		}
+
+		int sum = 0;
+		for(std::size_t i = 0; i < count; ++i) {
+			queue.enqueue(1, std::make_shared<int>(1), nullptr);
+		}
+		queue.processQueueWith([&sum](const int, const std::shared_ptr<int> & data, int * p) {
+			sum += *data + (p == nullptr ? 0 : 1);
+		});
+		REQUIRE(sum == (int)count);
+	}
+}
+
+} //unnamed namespace
+
+TEST_CASE("EventQueue, QueuePrefetchDistance")
+{
+	doTestPrefetchDistance<0>();
+	doTestPrefetchDistance<1>();
+	doTestPrefetchDistance<4>();
+	doTestPrefetchDistance<16>();
+}
@@ -0,0 +1,246 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// OPT-65: Tests for the batch listeners of EventQueue
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct SensorData
+{
+	int id;
+	double value;
+};
+
+struct DeadlinePolicies
+{
+	using QueueDeadline = eventpp::QueueDeadlineSteady;
+};
+
+struct Run
+{
+	int event;
+	std::vector<int> valueList;
+};
+
+} //unnamed namespace
+
+TEST_CASE("EventQueue, batch listener gets the runs of the same event")
+{
+	using EQ = eventpp::EventQueue<int, void (int, int)>;
+	EQ queue;
+
+	std::vector<std::string> callList;
+	std::vector<Run> runList;
+	queue.appendListener(1, [&callList](int, int n) { callList.push_back("1:" + std::to_string(n)); });
+	queue.appendListener(2, [&callList](int, int n) { callList.push_back("2:" + std::to_string(n)); });
+	queue.appendBatchListener(1, [&callList, &runList](const eventpp::BatchSpan<int> & events, const eventpp::BatchSpan<int> & values) {
+		REQUIRE(events.size() == values.size());
+		for(const int e : events) {
+			REQUIRE(e == 1);
+		}
+		callList.push_back("batch");
+		runList.push_back(Run { 1, std::vector<int>(values.begin(), values.end()) });
+	});
+	REQUIRE(queue.hasAnyBatchListener(1));
+	REQUIRE(! queue.hasAnyBatchListener(2));
+
+	queue.enqueue(1, 10);
+	queue.enqueue(1, 11);
+	queue.enqueue(1, 12);
+	queue.enqueue(2, 20);
+	queue.enqueue(1, 13);
+	queue.process();
+
+	REQUIRE(callList == std::vector<std::string> { "1:10", "1:11", "1:12", "batch", "2:20", "1:13", "batch" });
+	REQUIRE(runList.size() == 2);
+	REQUIRE(runList[0].valueList == std::vector<int> { 10, 11, 12 });
+	REQUIRE(runList[1].valueList == std::vector<int> { 13 });
+}
+
+TEST_CASE("EventQueue, batch listener, columns of a struct argument")
+{
+	struct Policies
+	{
+		static int getEvent(const SensorData & data) {
+			return data.id;
+		}
+	};
+	using EQ = eventpp::EventQueue<int, void (const SensorData &), Policies>;
+	EQ queue;
+	double sum = 0;
+	std::size_t callCount = 0;
+	queue.appendBatchListener(5, [&sum, &callCount](const eventpp::BatchSpan<SensorData> & dataList) {
+		++callCount;
+		const SensorData * data = dataList.data();
+		for(std::size_t i = 0; i < dataList.size(); ++i) {
+			sum += data[i].value;
+		}
+	});
+
+	for(int i = 0; i < 100; ++i) {
+		queue.enqueue(SensorData { 5, 0.5 });
+	}
+	queue.process();
+	REQUIRE(callCount == 1);
+	REQUIRE(sum == 50.0);
+}
+
+TEST_CASE("EventQueue, batch listener, processN and processFor")
+{
+	using EQ = eventpp::EventQueue<int, void (int, int)>;
+	EQ queue;
+
+	std::vector<std::size_t> sizeList;
+	queue.appendBatchListener(3, [&sizeList](const eventpp::BatchSpan<int> &, const eventpp::BatchSpan<int> & values) {
+		sizeList.push_back(values.size());
+	});
+
+	for(int i = 0; i < 10; ++i) {
+		queue.enqueue(3, i);
+	}
+	queue.processN(4);
+	REQUIRE(sizeList == std::vector<std::size_t> { 4 });
+
+	size_t processedCount = 0;
+	queue.processN(2, &processedCount);
+	REQUIRE(processedCount == 2);
+	REQUIRE(sizeList == std::vector<std::size_t> { 4, 2 });
+
+	queue.processFor(std::chrono::seconds(10));
+	REQUIRE(sizeList == std::vector<std::size_t> { 4, 2, 4 });
+
+	// processOne doesn't call the batch listeners.
+	queue.enqueue(3, 0);
+	queue.processOne();
+	REQUIRE(sizeList.size() == 3);
+}
+
+TEST_CASE("EventQueue, removeBatchListener")
+{
+	using EQ = eventpp::EventQueue<int, void (int, int)>;
+	EQ queue;
+
+	int batchCount = 0;
+	int count = 0;
+	queue.appendListener(1, [&count](int, int) { ++count; });
+	auto handle = queue.appendBatchListener(1, [&batchCount](const eventpp::BatchSpan<int> &, const eventpp::BatchSpan<int> &) {
+		++batchCount;
+	});
+
+	queue.enqueue(1, 1);
+	queue.process();
+	REQUIRE(batchCount == 1);
+
+	REQUIRE(queue.removeBatchListener(1, handle));
+	REQUIRE(! queue.removeBatchListener(1, handle));
+	REQUIRE(! queue.hasAnyBatchListener(1));
+
+	queue.enqueue(1, 1);
+	queue.process();
+	REQUIRE(batchCount == 1);
+	REQUIRE(count == 2);
+}
+
+TEST_CASE("EventQueue, batch listener, expired events are not in the run")
+{
+	using EQ = eventpp::EventQueue<int, void (int, int), DeadlinePolicies>;
+	EQ queue;
+
+	Run run { 0, {} };
+	queue.appendBatchListener(1, [&run](const eventpp::BatchSpan<int> &, const eventpp::BatchSpan<int> & values) {
+		run.valueList.assign(values.begin(), values.end());
+	});
+
+	queue.enqueue(1, 1);
+	queue.enqueueWithDeadline(std::chrono::steady_clock::now() + std::chrono::microseconds(1), 1, 2);
+	queue.enqueue(1, 3);
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	queue.process();
+	REQUIRE(run.valueList == std::vector<int> { 1, 3 });
+}
+
+TEST_CASE("EventQueue, batch listener, copy and move the queue")
+{
+	using EQ = eventpp::EventQueue<int, void (int, int)>;
+	EQ queue;
+
+	int batchCount = 0;
+	queue.appendBatchListener(1, [&batchCount](const eventpp::BatchSpan<int> &, const eventpp::BatchSpan<int> &) {
+		++batchCount;
+	});
+
+	EQ copied(queue);
+	copied.enqueue(1, 1);
+	copied.process();
+	REQUIRE(batchCount == 1);
+
+	EQ moved(std::move(copied));
+	moved.enqueue(1, 1);
+	moved.process();
+	REQUIRE(batchCount == 2);
+}
+
+TEST_CASE("EventQueue, batch listener, assign the queue")
+{
+	using EQ = eventpp::EventQueue<int, void (int, int)>;
+	EQ queue;
+	EQ empty;
+	REQUIRE(! queue.hasAnyBatchListener(1));
+	REQUIRE(! queue.removeBatchListener(1, EQ::BatchHandle()));
+
+	int batchCount = 0;
+	queue.appendBatchListener(1, [&batchCount](const eventpp::BatchSpan<int> &, const eventpp::BatchSpan<int> &) {
+		++batchCount;
+	});
+	REQUIRE(queue.hasAnyBatchListener(1));
+
+	EQ assigned;
+	assigned = queue;
+	assigned.enqueue(1, 1);
+	assigned.process();
+	REQUIRE(batchCount == 1);
+
+	// The queue with no batch listener replaces them.
+	assigned = empty;
+	REQUIRE(! assigned.hasAnyBatchListener(1));
+	assigned.enqueue(1, 1);
+	assigned.process();
+	REQUIRE(batchCount == 1);
+
+	assigned = std::move(queue);
+	REQUIRE(assigned.hasAnyBatchListener(1));
+	assigned.enqueue(1, 1);
+	assigned.process();
+	REQUIRE(batchCount == 2);
+}
+
+TEST_CASE("EventQueue, move only arguments without batch listener")
+{
+	using EQ = eventpp::EventQueue<int, void (int, std::unique_ptr<int> &)>;
+	EQ queue;
+
+	int value = 0;
+	queue.appendListener(1, [&value](int, std::unique_ptr<int> & p) { value = *p; });
+	queue.enqueue(1, std::unique_ptr<int>(new int(8)));
+	queue.process();
+	REQUIRE(value == 8);
+}
@@ -0,0 +1,270 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+int checkedCount = 0;
+int liveNodeCount = 0;
+
+// Drops the odd events.
+template <typename Base>
+class MixinDropOdd : public Base
+{
+public:
+	bool mixinBeforeEnqueue(const int & e) const
+	{
+		++checkedCount;
+		return e % 2 == 0;
+	}
+};
+
+template <typename T>
+struct CountedAllocator : std::allocator<T>
+{
+	template <typename U>
+	struct rebind
+	{
+		using other = CountedAllocator<U>;
+	};
+
+	CountedAllocator() = default;
+
+	template <typename U>
+	CountedAllocator(const CountedAllocator<U> &)
+	{
+	}
+
+	T * allocate(const std::size_t n)
+	{
+		liveNodeCount += static_cast<int>(n);
+		return std::allocator<T>::allocate(n);
+	}
+
+	void deallocate(T * p, const std::size_t n)
+	{
+		liveNodeCount -= static_cast<int>(n);
+		std::allocator<T>::deallocate(p, n);
+	}
+};
+
+struct DropOddPolicies
+{
+	using Mixins = eventpp::MixinList<MixinDropOdd>;
+
+	template <typename Item>
+	using QueueList = std::list<Item, CountedAllocator<Item> >;
+};
+
+struct DropOddCapacityPolicies
+{
+	using Mixins = eventpp::MixinList<MixinDropOdd>;
+	using QueueCapacity = eventpp::QueueCapacityLimited;
+	using QueueOverflow = eventpp::QueueOverflowDropNewest;
+};
+
+struct DropOddReplyPolicies
+{
+	using Mixins = eventpp::MixinList<MixinDropOdd>;
+	using QueueReply = eventpp::QueueReplyPooled;
+};
+
+struct DropOddDeadlinePolicies
+{
+	using Mixins = eventpp::MixinList<MixinDropOdd>;
+	using QueueDeadline = eventpp::QueueDeadlineSteady;
+};
+
+struct DropOddTimerPolicies
+{
+	using Mixins = eventpp::MixinList<MixinDropOdd>;
+	using Timer = eventpp::TimerWheel;
+};
+
+} //unnamed namespace
+
+TEST_CASE("EventQueue, mixinBeforeEnqueue, enqueue, emplace, reserve and ProducerBuffer")
+{
+	using EQ = eventpp::EventQueue<int, void (int), DropOddPolicies>;
+	checkedCount = 0;
+	liveNodeCount = 0;
+	{
+		EQ queue;
+		std::vector<int> dataList;
+		for(int e = 0; e < 8; ++e) {
+			queue.appendListener(e, [&dataList](const int value) {
+				dataList.push_back(value);
+			});
+		}
+
+		queue.enqueue(1, 10);
+		queue.enqueue(2, 20);
+		queue.emplace(3, 30);
+		queue.emplace(4, 40);
+		REQUIRE(checkedCount == 4);
+		REQUIRE(liveNodeCount == 2);
+
+		auto slot = queue.reserve(5);
+		REQUIRE(! slot.isActive());
+		slot = queue.reserve(6);
+		REQUIRE(slot.isActive());
+		slot.getArgument<0>() = 60;
+		slot.commit();
+		REQUIRE(checkedCount == 6);
+		REQUIRE(liveNodeCount == 3);
+
+		{
+			EQ::ProducerBuffer buffer(&queue);
+			buffer.enqueue(7, 70);
+			buffer.enqueue(0, 0);
+		}
+		REQUIRE(checkedCount == 8);
+
+		queue.process();
+		REQUIRE(dataList == std::vector<int> { 20, 40, 60, 0 });
+	}
+	REQUIRE(liveNodeCount == 0);
+}
+
+TEST_CASE("EventQueue, mixinBeforeEnqueue, enqueueBulk takes the nodes for the passed events only")
+{
+	using EQ = eventpp::EventQueue<int, void (int), DropOddPolicies>;
+	checkedCount = 0;
+	liveNodeCount = 0;
+	{
+		EQ queue;
+		std::vector<int> dataList;
+		for(int e = 0; e < 10; ++e) {
+			queue.appendListener(e, [&dataList](const int value) {
+				dataList.push_back(value);
+			});
+		}
+
+		const std::vector<std::tuple<int, int> > itemList {
+			std::make_tuple(1, 10), std::make_tuple(2, 20), std::make_tuple(3, 30), std::make_tuple(4, 40)
+		};
+		queue.enqueueBulk(itemList.begin(), itemList.end());
+		REQUIRE(checkedCount == 4);
+		REQUIRE(liveNodeCount == 2);
+
+		int generatedCount = 0;
+		queue.enqueueBulk(6, [&generatedCount](const std::size_t index) {
+			++generatedCount;
+			return std::make_tuple(static_cast<int>(index) + 4, static_cast<int>(index) * 10 + 40);
+		});
+		// The generator is still invoked once for each element.
+		REQUIRE(generatedCount == 6);
+		REQUIRE(checkedCount == 10);
+		REQUIRE(liveNodeCount == 5);
+
+		// All dropped.
+		const std::vector<std::tuple<int, int> > oddList {
+			std::make_tuple(1, 10), std::make_tuple(3, 30)
+		};
+		queue.enqueueBulk(oddList.begin(), oddList.end());
+		REQUIRE(liveNodeCount == 5);
+
+		queue.process();
+		REQUIRE(dataList == std::vector<int> { 20, 40, 40, 60, 80 });
+	}
+	REQUIRE(liveNodeCount == 0);
+}
+
+TEST_CASE("EventQueue, mixinBeforeEnqueue, tryEnqueue doesn't take the capacity")
+{
+	using EQ = eventpp::EventQueue<int, void (int), DropOddCapacityPolicies>;
+	checkedCount = 0;
+	EQ queue;
+	EQ::QueueLimits limits;
+	limits.maxEventCount = 1;
+	queue.setQueueLimits(limits);
+
+	// A dropped event returns true, the caller doesn't try it again.
+	REQUIRE(queue.tryEnqueue(1, 10));
+	REQUIRE(queue.tryEnqueueFor(std::chrono::milliseconds(1), 3, 30));
+	REQUIRE(queue.getQueuedEventCount() == 0);
+	REQUIRE(queue.tryEnqueue(2, 20));
+	REQUIRE(! queue.tryEnqueue(4, 40));
+	REQUIRE(! queue.tryEnqueueFor(std::chrono::milliseconds(1), 4, 40));
+	REQUIRE(queue.getQueuedEventCount() == 1);
+	REQUIRE(queue.getDroppedEventCount() == 0);
+	REQUIRE(checkedCount == 5);
+}
+
+TEST_CASE("EventQueue, mixinBeforeEnqueue, enqueueWithReply")
+{
+	using EQ = eventpp::EventQueue<int, int (int), DropOddReplyPolicies>;
+	checkedCount = 0;
+	EQ queue;
+	queue.appendListener(1, [](const int value) {
+		return value + 1;
+	});
+	queue.appendListener(2, [](const int value) {
+		return value + 2;
+	});
+
+	auto reply1 = queue.enqueueWithReply(1, 10);
+	auto reply2 = queue.enqueueWithReply(2, 20);
+	REQUIRE(checkedCount == 2);
+	// The reply of a dropped event is ready with no value.
+	REQUIRE(reply1.isReady());
+	REQUIRE(! reply1.hasValue());
+	REQUIRE(! reply2.isReady());
+
+	queue.process();
+	REQUIRE(reply2.isReady());
+	REQUIRE(reply2.get() == 22);
+}
+
+TEST_CASE("EventQueue, mixinBeforeEnqueue, enqueueWithDeadline")
+{
+	using EQ = eventpp::EventQueue<int, void (int), DropOddDeadlinePolicies>;
+	checkedCount = 0;
+	EQ queue;
+	std::vector<int> dataList;
+	for(int e = 0; e < 4; ++e) {
+		queue.appendListener(e, [&dataList](const int value) {
+			dataList.push_back(value);
+		});
+	}
+
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::hours(1);
+	queue.enqueueWithDeadline(deadline, 1, 10);
+	queue.enqueueWithDeadline(deadline, 2, 20);
+	REQUIRE(checkedCount == 2);
+	queue.process();
+	REQUIRE(dataList == std::vector<int> { 20 });
+}
+
+TEST_CASE("EventQueue, mixinBeforeEnqueue, enqueueAt and enqueueAfter")
+{
+	using EQ = eventpp::EventQueue<int, void (int), DropOddTimerPolicies>;
+	checkedCount = 0;
+	EQ queue;
+
+	queue.enqueueAt(std::chrono::steady_clock::now(), 1, 10);
+	queue.enqueueAt(std::chrono::steady_clock::now(), 2, 20);
+	queue.enqueueAfter(std::chrono::milliseconds(0), 3, 30);
+	queue.enqueueAfter(std::chrono::milliseconds(0), 4, 40);
+	// Checked when the events are added, not when they are due.
+	REQUIRE(checkedCount == 4);
+	REQUIRE(queue.getDelayedEventCount() == 2);
+}
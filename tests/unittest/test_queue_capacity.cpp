@@ -0,0 +1,322 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct BlockPolicies
+{
+	using QueueCapacity = eventpp::QueueCapacityLimited;
+};
+
+struct DropNewestPolicies
+{
+	using QueueCapacity = eventpp::QueueCapacityLimited;
+	using QueueOverflow = eventpp::QueueOverflowDropNewest;
+};
+
+struct DropOldestPolicies
+{
+	using QueueCapacity = eventpp::QueueCapacityLimited;
+	using QueueOverflow = eventpp::QueueOverflowDropOldest;
+};
+
+int liveNodeCount = 0;
+
+// Counts the nodes of the queue list.
+template <typename T>
+struct CountedAllocator : std::allocator<T>
+{
+	template <typename U>
+	struct rebind
+	{
+		using other = CountedAllocator<U>;
+	};
+
+	CountedAllocator() = default;
+
+	template <typename U>
+	CountedAllocator(const CountedAllocator<U> &)
+	{
+	}
+
+	T * allocate(const std::size_t n)
+	{
+		liveNodeCount += static_cast<int>(n);
+		return std::allocator<T>::allocate(n);
+	}
+
+	void deallocate(T * p, const std::size_t n)
+	{
+		liveNodeCount -= static_cast<int>(n);
+		std::allocator<T>::deallocate(p, n);
+	}
+};
+
+struct CountedNodePolicies
+{
+	using QueueCapacity = eventpp::QueueCapacityLimited;
+
+	template <typename Item>
+	using QueueList = std::list<Item, CountedAllocator<Item> >;
+};
+
+} //unnamed namespace
+
+TEST_CASE("QueueCapacity, tryEnqueue fails when the queue is full")
+{
+	using EQ = eventpp::EventQueue<int, void (int, int), BlockPolicies>;
+	EQ queue;
+	EQ::QueueLimits limits;
+	limits.maxEventCount = 3;
+	queue.setQueueLimits(limits);
+	REQUIRE(queue.getQueueLimits().maxEventCount == 3);
+
+	std::vector<int> dataList;
+	queue.appendListener(1, [&dataList](int, const int value) {
+		dataList.push_back(value);
+	});
+
+	REQUIRE(queue.tryEnqueue(1, 1));
+	REQUIRE(queue.tryEnqueue(1, 2));
+	REQUIRE(queue.tryEnqueue(1, 3));
+	REQUIRE(! queue.tryEnqueue(1, 4));
+	REQUIRE(! queue.tryEnqueueFor(std::chrono::milliseconds(1), 1, 5));
+	REQUIRE(queue.getQueuedEventCount() == 3);
+
+	REQUIRE(queue.processOne());
+	REQUIRE(queue.getQueuedEventCount() == 2);
+	REQUIRE(queue.tryEnqueue(1, 6));
+
+	queue.process();
+	REQUIRE(dataList == std::vector<int> { 1, 2, 3, 6 });
+	REQUIRE(queue.getQueuedEventCount() == 0);
+
+	// The events counted in are counted out by every way of taking them.
+	queue.enqueue(1, 7);
+	queue.enqueue(1, 8);
+	queue.clearEvents();
+	REQUIRE(queue.getQueuedEventCount() == 0);
+	queue.enqueue(1, 9);
+	EQ::QueuedEvent item;
+	REQUIRE(queue.takeEvent(&item));
+	REQUIRE(queue.getQueuedEventCount() == 0);
+	queue.enqueue(1, 10);
+	{
+		auto events = queue.borrowEvents();
+		REQUIRE(queue.getQueuedEventCount() == 1);
+	}
+	REQUIRE(queue.getQueuedEventCount() == 0);
+}
+
+TEST_CASE("QueueCapacity, enqueue blocks until the queue has room")
+{
+	using EQ = eventpp::EventQueue<int, void (int), BlockPolicies>;
+	EQ queue;
+	EQ::QueueLimits limits;
+	limits.maxEventCount = 2;
+	queue.setQueueLimits(limits);
+
+	std::atomic<int> sum(0);
+	queue.appendListener(1, [&sum](const int value) {
+		sum += value;
+	});
+
+	constexpr int producerCount = 4;
+	constexpr int eventCountPerProducer = 2000;
+	std::vector<std::thread> producerList;
+	for(int t = 0; t < producerCount; ++t) {
+		producerList.emplace_back([&queue]() {
+			for(int i = 1; i <= eventCountPerProducer; ++i) {
+				queue.enqueue(1, i);
+			}
+		});
+	}
+
+	std::atomic<bool> overLimit(false);
+	std::atomic<int> joinedCount(0);
+	std::thread consumer([&]() {
+		while(joinedCount.load() < producerCount || ! queue.emptyQueue()) {
+			if(queue.getQueuedEventCount() > 2) {
+				overLimit = true;
+			}
+			queue.processOne();
+		}
+	});
+	for(auto & thread : producerList) {
+		thread.join();
+		++joinedCount;
+	}
+	consumer.join();
+
+	REQUIRE(! overLimit.load());
+	REQUIRE(sum.load() == producerCount * eventCountPerProducer * (eventCountPerProducer + 1) / 2);
+	REQUIRE(queue.getQueuedEventCount() == 0);
+}
+
+TEST_CASE("QueueCapacity, QueueOverflowDropNewest and the overflow callback")
+{
+	using EQ = eventpp::EventQueue<int, void (int), DropNewestPolicies>;
+	EQ queue;
+	EQ::QueueLimits limits;
+	limits.maxEventCount = 2;
+	queue.setQueueLimits(limits);
+
+	std::vector<int> droppedList;
+	queue.setOverflowCallback([&droppedList](const EQ::QueuedEvent & item) {
+		droppedList.push_back(item.getArgument<0>());
+	});
+	std::vector<int> dataList;
+	queue.appendListener(1, [&dataList](const int value) {
+		dataList.push_back(value);
+	});
+
+	for(int i = 1; i <= 4; ++i) {
+		queue.enqueue(1, i);
+	}
+	auto slot = queue.reserve(1);
+	slot.getArgument<0>() = 5;
+	slot.commit();
+
+	REQUIRE(droppedList == std::vector<int> { 3, 4, 5 });
+	REQUIRE(queue.getDroppedEventCount() == 3);
+	queue.process();
+	REQUIRE(dataList == std::vector<int> { 1, 2 });
+}
+
+TEST_CASE("QueueCapacity, QueueOverflowDropOldest")
+{
+	using EQ = eventpp::EventQueue<int, void (int), DropOldestPolicies>;
+	EQ queue;
+	EQ::QueueLimits limits;
+	limits.maxEventCount = 2;
+	queue.setQueueLimits(limits);
+
+	std::vector<int> droppedList;
+	queue.setOverflowCallback([&droppedList](const EQ::QueuedEvent & item) {
+		droppedList.push_back(item.getArgument<0>());
+	});
+	std::vector<int> dataList;
+	queue.appendListener(1, [&dataList](const int value) {
+		dataList.push_back(value);
+	});
+
+	for(int i = 1; i <= 5; ++i) {
+		queue.enqueue(1, i);
+	}
+	REQUIRE(droppedList == std::vector<int> { 1, 2, 3 });
+	REQUIRE(queue.getQueuedEventCount() == 2);
+	queue.process();
+	REQUIRE(dataList == std::vector<int> { 4, 5 });
+
+	// The bulk events are counted but never dropped.
+	const std::vector<int> bulk { 6, 7, 8 };
+	queue.enqueueBulk(bulk.size(), [&bulk](const size_t index) {
+		return std::make_tuple(1, bulk[index]);
+	});
+	REQUIRE(queue.getQueuedEventCount() == 3);
+	REQUIRE(queue.getDroppedEventCount() == 3);
+}
+
+TEST_CASE("QueueCapacity, maxByteCount")
+{
+	using EQ = eventpp::EventQueue<int, void (int), DropNewestPolicies>;
+	EQ queue;
+	EQ::QueueLimits limits;
+	limits.maxByteCount = EQ::getQueueItemSize() * 3 + 1;
+	queue.setQueueLimits(limits);
+
+	for(int i = 0; i < 5; ++i) {
+		queue.enqueue(1, i);
+	}
+	REQUIRE(queue.getQueuedEventCount() == 3);
+	REQUIRE(queue.getDroppedEventCount() == 2);
+}
+
+TEST_CASE("QueueCapacity, watermarks")
+{
+	using EQ = eventpp::EventQueue<int, void (int), BlockPolicies>;
+	EQ queue;
+	EQ::QueueLimits limits;
+	limits.highWatermark = 4;
+	limits.lowWatermark = 1;
+	queue.setQueueLimits(limits);
+
+	std::vector<bool> stateList;
+	queue.setWatermarkCallback([&stateList](const bool high) {
+		stateList.push_back(high);
+	});
+
+	for(int i = 0; i < 3; ++i) {
+		queue.enqueue(1, i);
+	}
+	REQUIRE(stateList.empty());
+	queue.enqueue(1, 3);
+	queue.enqueue(1, 4);
+	REQUIRE(stateList == std::vector<bool> { true });
+
+	queue.processOne();
+	queue.processOne();
+	queue.processOne();
+	REQUIRE(stateList == std::vector<bool> { true });
+	queue.processOne();
+	REQUIRE(stateList == std::vector<bool> { true, false });
+	queue.process();
+	REQUIRE(stateList == std::vector<bool> { true, false });
+
+	queue.enqueueBulk(5, [](const size_t index) {
+		return std::make_tuple(1, (int)index);
+	});
+	REQUIRE(stateList == std::vector<bool> { true, false, true });
+}
+
+TEST_CASE("QueueCapacity, maxFreeCount")
+{
+	using EQ = eventpp::EventQueue<int, void (int), CountedNodePolicies>;
+	liveNodeCount = 0;
+	{
+		EQ queue;
+		EQ::QueueLimits limits;
+		limits.maxFreeCount = 2;
+		queue.setQueueLimits(limits);
+
+		queue.enqueueBulk(5, [](const size_t index) {
+			return std::make_tuple(1, (int)index);
+		});
+		REQUIRE(liveNodeCount == 5);
+		queue.process();
+		REQUIRE(liveNodeCount == 2);
+
+		queue.enqueue(1, 1);
+		REQUIRE(liveNodeCount == 2);
+		queue.enqueue(1, 2);
+		queue.enqueue(1, 3);
+		REQUIRE(liveNodeCount == 3);
+		queue.process();
+		REQUIRE(liveNodeCount == 2);
+
+		limits.maxFreeCount = 1;
+		queue.setQueueLimits(limits);
+		REQUIRE(liveNodeCount == 1);
+	}
+	REQUIRE(liveNodeCount == 0);
+}
@@ -0,0 +1,179 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/utilities/deadlinequeuelist.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct DeadlinePolicies
+{
+	using QueueDeadline = eventpp::QueueDeadlineSteady;
+};
+
+// Event 1 is stale after 1 millisecond, the other events never expire.
+// The prototype includes the event, so it's in the arguments too.
+struct TimeToLivePolicies
+{
+	using QueueDeadline = eventpp::QueueDeadlineSteady;
+
+	static std::chrono::microseconds getTimeToLive(const int event, const int /*event*/, const int /*value*/) {
+		return event == 1 ? std::chrono::microseconds(1000) : std::chrono::microseconds(0);
+	}
+};
+
+struct EdfPolicies
+{
+	using QueueDeadline = eventpp::QueueDeadlineSteady;
+
+	template <typename T>
+	using QueueList = eventpp::DeadlineQueueList<T>;
+};
+
+struct DeadlineReplyPolicies
+{
+	using QueueDeadline = eventpp::QueueDeadlineSteady;
+	using QueueReply = eventpp::QueueReplyPooled;
+
+	static std::chrono::milliseconds getTimeToLive(const int /*event*/, const int /*value*/) {
+		return std::chrono::milliseconds(1);
+	}
+};
+
+} //unnamed namespace
+
+TEST_CASE("QueueDeadline, the events past their deadline are dropped")
+{
+	using EQ = eventpp::EventQueue<int, void (int, int), DeadlinePolicies>;
+	EQ queue;
+	std::vector<int> dataList;
+	queue.appendListener(1, [&dataList](int, const int value) {
+		dataList.push_back(value);
+	});
+
+	const Clock::time_point now = Clock::now();
+	queue.enqueueWithDeadline(now - std::chrono::milliseconds(1), 1, 1);
+	queue.enqueueWithDeadline(now + std::chrono::hours(1), 1, 2);
+	queue.enqueue(1, 3);
+	queue.enqueueWithDeadline(now, 1, 4);
+
+	EQ::QueuedEvent item;
+	REQUIRE(queue.peekEvent(&item));
+	REQUIRE(item.getDeadline() == now - std::chrono::milliseconds(1));
+
+	queue.process();
+	REQUIRE(dataList == std::vector<int> { 2, 3 });
+	REQUIRE(queue.getExpiredEventCount() == 2);
+
+	queue.enqueueWithDeadline(now, 1, 5);
+	queue.enqueue(1, 6);
+	REQUIRE(queue.processOne());
+	REQUIRE(queue.processOne());
+	REQUIRE(dataList == std::vector<int> { 2, 3, 6 });
+	REQUIRE(queue.getExpiredEventCount() == 3);
+
+	queue.enqueueWithDeadline(now, 1, 7);
+	queue.enqueue(1, 8);
+	std::vector<int> visitedList;
+	queue.processQueueWith([&visitedList](int, int, const int value) {
+		visitedList.push_back(value);
+	});
+	REQUIRE(visitedList == std::vector<int> { 8 });
+	REQUIRE(queue.getExpiredEventCount() == 4);
+}
+
+TEST_CASE("QueueDeadline, time to live of the policies")
+{
+	using EQ = eventpp::EventQueue<int, void (int, int), TimeToLivePolicies>;
+	EQ queue;
+	std::vector<int> dataList;
+	queue.appendListener(1, [&dataList](int, const int value) {
+		dataList.push_back(value);
+	});
+	queue.appendListener(2, [&dataList](int, const int value) {
+		dataList.push_back(value);
+	});
+
+	queue.enqueue(1, 1);
+	queue.enqueue(2, 2);
+	// enqueueWithDeadline overrides the time to live.
+	queue.enqueueWithDeadline(Clock::now() + std::chrono::hours(1), 1, 3);
+	queue.enqueueBulk(2, [](const size_t index) {
+		return std::make_tuple((int)index + 1, (int)index + 4);
+	});
+
+	EQ::QueuedEvent item;
+	REQUIRE(queue.peekEvent(&item));
+	REQUIRE(item.getDeadline() <= Clock::now() + std::chrono::milliseconds(1));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	// An event which is processed early enough is dispatched.
+	queue.enqueue(1, 6);
+	queue.process();
+	REQUIRE(dataList == std::vector<int> { 2, 3, 5, 6 });
+	REQUIRE(queue.getExpiredEventCount() == 2);
+}
+
+TEST_CASE("QueueDeadline, DeadlineQueueList processes the earliest deadline first")
+{
+	using EQ = eventpp::EventQueue<int, void (int, int), EdfPolicies>;
+	EQ queue;
+	std::vector<int> dataList;
+	queue.appendListener(1, [&dataList](int, const int value) {
+		dataList.push_back(value);
+	});
+
+	const Clock::time_point now = Clock::now() + std::chrono::hours(1);
+	queue.enqueue(1, 100);
+	queue.enqueueWithDeadline(now + std::chrono::seconds(3), 1, 3);
+	queue.enqueueWithDeadline(now + std::chrono::seconds(1), 1, 1);
+	queue.enqueueWithDeadline(now + std::chrono::seconds(2), 1, 2);
+	queue.enqueueWithDeadline(now + std::chrono::seconds(1), 1, 11);
+	queue.enqueue(1, 101);
+
+	REQUIRE(queue.processN(2));
+	REQUIRE(dataList == std::vector<int> { 1, 11 });
+
+	EQ::ProducerBuffer buffer(&queue);
+	buffer.enqueue(1, 102);
+	buffer.flush();
+	queue.enqueueWithDeadline(now, 1, 0);
+
+	queue.process();
+	REQUIRE(dataList == std::vector<int> { 1, 11, 0, 2, 3, 100, 101, 102 });
+}
+
+TEST_CASE("QueueDeadline, an expired reply event has no value")
+{
+	eventpp::EventQueue<int, int (int), DeadlineReplyPolicies> queue;
+	queue.appendListener(1, [](const int n) {
+		return n;
+	});
+
+	auto reply = queue.enqueueWithReply(1, 5);
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	auto freshReply = queue.enqueueWithReply(1, 6);
+	queue.process();
+	REQUIRE(reply.isReady());
+	REQUIRE(! reply.hasValue());
+	REQUIRE(freshReply.hasValue());
+	REQUIRE(freshReply.get() == 6);
+	REQUIRE(queue.getExpiredEventCount() == 1);
+}
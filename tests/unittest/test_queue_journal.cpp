@@ -0,0 +1,312 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/mixins/mixinjournal.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+struct JournalPolicies
+{
+	using Mixins = eventpp::MixinList<eventpp::MixinJournal>;
+};
+
+// Removes the directory and the segments in it, before and after the test.
+struct DirectoryGuard
+{
+	explicit DirectoryGuard(const std::string & tag)
+		: path(std::string("/tmp/eventpp_test_journal_") + tag + "_" + std::to_string(getpid()))
+	{
+		remove();
+	}
+
+	~DirectoryGuard() {
+		remove();
+	}
+
+	void remove() const {
+		for(const std::string & name : getFileNameList()) {
+			::unlink((path + "/" + name).c_str());
+		}
+		::rmdir(path.c_str());
+	}
+
+	std::vector<std::string> getFileNameList() const {
+		std::vector<std::string> nameList;
+		DIR * dir = ::opendir(path.c_str());
+		if(dir != nullptr) {
+			while(const dirent * entry = ::readdir(dir)) {
+				if(entry->d_name[0] != '.') {
+					nameList.push_back(entry->d_name);
+				}
+			}
+			::closedir(dir);
+		}
+		return nameList;
+	}
+
+	std::string path;
+};
+
+std::vector<std::string> readAll(const eventpp::EventJournal & journal, const std::uint64_t fromOffset = 0)
+{
+	std::vector<std::string> recordList;
+	journal.replay(fromOffset, [&recordList](const void * data, const std::size_t size, std::uint64_t) {
+		recordList.push_back(std::string(static_cast<const char *>(data), size));
+	});
+	return recordList;
+}
+
+} //namespace
+
+TEST_CASE("EventJournal, append and replay")
+{
+	DirectoryGuard directory("append");
+	eventpp::EventJournal journal;
+	REQUIRE(journal.open(directory.path));
+	REQUIRE(journal.isOpen());
+
+	const std::uint64_t offset1 = journal.append("abc", 3);
+	const std::uint64_t offset2 = journal.append("", 0);
+	const std::uint64_t offset3 = journal.append("hello", 5);
+	REQUIRE(offset1 != eventpp::EventJournal::invalidOffset);
+	REQUIRE(offset1 < offset2);
+	REQUIRE(offset2 < offset3);
+	REQUIRE(journal.commit());
+
+	REQUIRE(readAll(journal) == std::vector<std::string> { "abc", "", "hello" });
+	REQUIRE(readAll(journal, offset2) == std::vector<std::string> { "", "hello" });
+
+	std::vector<std::uint64_t> offsetList;
+	const std::uint64_t endOffset = journal.replay(0, [&offsetList](const void *, std::size_t, const std::uint64_t offset) {
+		offsetList.push_back(offset);
+	});
+	REQUIRE(offsetList == std::vector<std::uint64_t> { offset1, offset2, offset3 });
+	REQUIRE(endOffset == journal.getEndOffset());
+
+	// Replaying from the returned offset reads only the new records.
+	journal.append("x", 1);
+	REQUIRE(readAll(journal, endOffset) == std::vector<std::string> { "x" });
+}
+
+TEST_CASE("EventJournal, not open")
+{
+	eventpp::EventJournal journal;
+	REQUIRE(! journal.isOpen());
+	REQUIRE(journal.append("abc", 3) == eventpp::EventJournal::invalidOffset);
+	REQUIRE(! journal.commit());
+	REQUIRE(readAll(journal).empty());
+}
+
+TEST_CASE("EventJournal, segments rotate")
+{
+	DirectoryGuard directory("rotate");
+	eventpp::EventJournalOptions options;
+	options.segmentSize = 4096;
+	eventpp::EventJournal journal;
+	REQUIRE(journal.open(directory.path, options));
+
+	const std::string data(1000, 'a');
+	std::vector<std::string> expectedList;
+	for(int i = 0; i < 20; ++i) {
+		expectedList.push_back(std::to_string(i) + data);
+		REQUIRE(journal.append(expectedList.back().data(), expectedList.back().size()) != eventpp::EventJournal::invalidOffset);
+	}
+	REQUIRE(directory.getFileNameList().size() > 4);
+	REQUIRE(readAll(journal) == expectedList);
+
+	// A record larger than a segment is refused.
+	const std::string hugeData(4096, 'b');
+	REQUIRE(journal.append(hugeData.data(), hugeData.size()) == eventpp::EventJournal::invalidOffset);
+
+	SECTION("removeSegmentsBefore") {
+		std::uint64_t offset10 = 0;
+		int index = 0;
+		journal.replay(0, [&offset10, &index](const void *, std::size_t, const std::uint64_t offset) {
+			if(index++ == 10) {
+				offset10 = offset;
+			}
+		});
+		const std::size_t fileCount = directory.getFileNameList().size();
+		REQUIRE(journal.removeSegmentsBefore(offset10) > 0);
+		REQUIRE(directory.getFileNameList().size() < fileCount);
+		REQUIRE(journal.getBeginOffset() <= offset10);
+
+		const std::vector<std::string> recordList = readAll(journal, journal.getBeginOffset());
+		REQUIRE(recordList.size() >= 10);
+		REQUIRE(recordList.back() == expectedList.back());
+		REQUIRE(readAll(journal, offset10).front() == expectedList[10]);
+	}
+}
+
+TEST_CASE("EventJournal, reopen")
+{
+	DirectoryGuard directory("reopen");
+	eventpp::EventJournalOptions options;
+	options.segmentSize = 4096;
+	{
+		eventpp::EventJournal journal;
+		REQUIRE(journal.open(directory.path, options));
+		journal.append("first", 5);
+		journal.append("second", 6);
+	}
+
+	eventpp::EventJournal journal;
+	REQUIRE(journal.open(directory.path, options));
+	journal.append("third", 5);
+	REQUIRE(readAll(journal) == std::vector<std::string> { "first", "second", "third" });
+}
+
+TEST_CASE("EventJournal, torn record at the tail")
+{
+	DirectoryGuard directory("torn");
+	std::uint64_t tornOffset;
+	{
+		eventpp::EventJournal journal;
+		REQUIRE(journal.open(directory.path));
+		journal.append("good", 4);
+		tornOffset = journal.append("torn", 4);
+	}
+
+	// Simulates a crash while the second record was written.
+	const std::vector<std::string> nameList = directory.getFileNameList();
+	REQUIRE(nameList.size() == 1);
+	const int fd = ::open((directory.path + "/" + nameList.front()).c_str(), O_RDWR);
+	REQUIRE(fd >= 0);
+	const char garbage = 'X';
+	REQUIRE(::pwrite(fd, &garbage, 1, static_cast<off_t>(tornOffset + 9)) == 1);
+	::close(fd);
+
+	eventpp::EventJournal journal;
+	REQUIRE(journal.open(directory.path));
+	REQUIRE(readAll(journal) == std::vector<std::string> { "good" });
+	journal.append("after", 5);
+	REQUIRE(readAll(journal) == std::vector<std::string> { "good", "after" });
+}
+
+TEST_CASE("EventJournal, sync thread")
+{
+	DirectoryGuard directory("sync");
+	eventpp::EventJournalOptions options;
+	options.syncInterval = std::chrono::milliseconds(1);
+	eventpp::EventJournal journal;
+	REQUIRE(journal.open(directory.path, options));
+	for(int i = 0; i < 100; ++i) {
+		journal.append(&i, sizeof(i));
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	journal.close();
+	REQUIRE(! journal.isOpen());
+}
+
+TEST_CASE("MixinJournal, replay the enqueued events")
+{
+	DirectoryGuard directory("mixin");
+	using EQ = eventpp::EventQueue<int, void (const std::string &, int), JournalPolicies>;
+
+	{
+		EQ queue;
+		REQUIRE(queue.openJournal(directory.path));
+		queue.enqueue(1, "a", 10);
+		queue.enqueue(2, "bc", 20);
+		queue.enqueue(3, std::string(), 30);
+		REQUIRE(queue.commitJournal());
+		// The events are journaled when they are enqueued, not when they are processed.
+		queue.process();
+	}
+
+	EQ queue;
+	REQUIRE(queue.openJournal(directory.path));
+	std::vector<std::string> dataList;
+	queue.appendListener(1, [&dataList](const std::string & s, int n) {
+		dataList.push_back("1:" + s + ":" + std::to_string(n));
+	});
+	queue.appendListener(2, [&dataList](const std::string & s, int n) {
+		dataList.push_back("2:" + s + ":" + std::to_string(n));
+	});
+	queue.appendListener(3, [&dataList](const std::string & s, int n) {
+		dataList.push_back("3:" + s + ":" + std::to_string(n));
+	});
+
+	const std::uint64_t offset = queue.replayJournal();
+	REQUIRE(dataList == std::vector<std::string> { "1:a:10", "2:bc:20", "3::30" });
+	// Replay doesn't enqueue, and doesn't journal the events again.
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(offset == queue.getJournal().getEndOffset());
+
+	SECTION("replay the events after the offset") {
+		queue.enqueue(2, "new", 40);
+		dataList.clear();
+		REQUIRE(queue.replayJournal(offset) == queue.getJournal().getEndOffset());
+		REQUIRE(dataList == std::vector<std::string> { "2:new:40" });
+	}
+
+	SECTION("replayJournalWith") {
+		std::vector<int> eventList;
+		queue.replayJournalWith(0, [&eventList](const int e, const std::string & s, const int n) {
+			eventList.push_back(e);
+			eventList.push_back(static_cast<int>(s.size()));
+			eventList.push_back(n);
+		});
+		REQUIRE(eventList == std::vector<int> { 1, 1, 10, 2, 2, 20, 3, 0, 30 });
+	}
+}
+
+TEST_CASE("MixinJournal, multiple threads")
+{
+	DirectoryGuard directory("multithread");
+	using EQ = eventpp::EventQueue<int, void (int), JournalPolicies>;
+	EQ queue;
+	eventpp::EventJournalOptions options;
+	options.segmentSize = 64 * 1024;
+	REQUIRE(queue.openJournal(directory.path, options));
+
+	constexpr int threadCount = 8;
+	constexpr int eventCountPerThread = 2000;
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < threadCount; ++i) {
+		threadList.emplace_back([i, &queue]() {
+			for(int k = 0; k < eventCountPerThread; ++k) {
+				queue.enqueue(i, k);
+			}
+		});
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+	REQUIRE(directory.getFileNameList().size() > 1);
+
+	// The events of each producer are journaled in order.
+	std::vector<int> nextList(threadCount, 0);
+	bool inOrder = true;
+	queue.replayJournalWith(0, [&nextList, &inOrder](const int e, const int n) {
+		if(n != nextList[e]++) {
+			inOrder = false;
+		}
+	});
+	REQUIRE(inOrder);
+	REQUIRE(nextList == std::vector<int>(threadCount, eventCountPerThread));
+}
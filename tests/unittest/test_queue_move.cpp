@@ -0,0 +1,202 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct CapacityPolicies
+{
+	using QueueCapacity = eventpp::QueueCapacityLimited;
+};
+
+} //unnamed namespace
+
+TEST_CASE("EventQueue, moveEventsTo")
+{
+	using EQ = eventpp::EventQueue<int, void (const std::string &, std::unique_ptr<int> &)>;
+	EQ source;
+	EQ target;
+
+	std::vector<std::string> dataList;
+	target.appendListener(1, [&dataList](const std::string & s, std::unique_ptr<int> & n) {
+		dataList.push_back(s + std::to_string(*n));
+	});
+	target.appendListener(2, [&dataList](const std::string & s, std::unique_ptr<int> & n) {
+		dataList.push_back(s + std::to_string(*n));
+	});
+
+	REQUIRE(! source.moveEventsTo(target));
+
+	target.enqueue(1, "t", std::unique_ptr<int>(new int(0)));
+	source.enqueue(1, "a", std::unique_ptr<int>(new int(1)));
+	source.enqueue(2, "b", std::unique_ptr<int>(new int(2)));
+	source.enqueue(1, "c", std::unique_ptr<int>(new int(3)));
+
+	// The arguments can't be copied, the events are moved with their nodes.
+	REQUIRE(source.moveEventsTo(target));
+	REQUIRE(source.emptyQueue());
+	REQUIRE(! source.process());
+
+	// Moving to itself does nothing.
+	REQUIRE(! target.moveEventsTo(target));
+
+	REQUIRE(target.process());
+	REQUIRE(dataList == std::vector<std::string>{ "t0", "a1", "b2", "c3" });
+}
+
+TEST_CASE("EventQueue, moveEventsIf")
+{
+	using EQ = eventpp::EventQueue<int, void (int, int)>;
+	EQ source;
+	EQ target;
+
+	std::vector<int> sourceList;
+	std::vector<int> targetList;
+	source.appendListener(1, [&sourceList](int, const int n) {
+		sourceList.push_back(n);
+	});
+	target.appendListener(1, [&targetList](int, const int n) {
+		targetList.push_back(n);
+	});
+
+	for(int i = 0; i < 10; ++i) {
+		source.enqueue(1, i);
+	}
+
+	REQUIRE(! source.moveEventsIf(target, [](int, const int n) {
+		return n > 100;
+	}));
+	REQUIRE(target.emptyQueue());
+
+	REQUIRE(source.moveEventsIf(target, [](int, const int n) {
+		return n % 3 == 0;
+	}));
+
+	// Both keep the order of the events.
+	REQUIRE(source.process());
+	REQUIRE(target.process());
+	REQUIRE(sourceList == std::vector<int>{ 1, 2, 4, 5, 7, 8 });
+	REQUIRE(targetList == std::vector<int>{ 0, 3, 6, 9 });
+}
+
+TEST_CASE("EventQueue, moveEventsTo, capacity")
+{
+	using EQ = eventpp::EventQueue<int, void (int), CapacityPolicies>;
+	EQ source;
+	EQ target;
+	EQ::QueueLimits limits;
+	limits.maxEventCount = 4;
+	source.setQueueLimits(limits);
+	target.setQueueLimits(limits);
+
+	for(int i = 0; i < 4; ++i) {
+		source.enqueue(i, i);
+	}
+	target.enqueue(9, 9);
+	REQUIRE(source.getQueuedEventCount() == 4);
+
+	REQUIRE(source.moveEventsIf(target, [](const int n) {
+		return n < 2;
+	}));
+	REQUIRE(source.getQueuedEventCount() == 2);
+	REQUIRE(target.getQueuedEventCount() == 3);
+
+	// The moved events are counted, even over the limit, as in enqueueBulk.
+	REQUIRE(source.moveEventsTo(target));
+	REQUIRE(source.getQueuedEventCount() == 0);
+	REQUIRE(target.getQueuedEventCount() == 5);
+
+	target.process();
+	REQUIRE(target.getQueuedEventCount() == 0);
+}
+
+TEST_CASE("EventQueue, moveEventsTo, wakes the consumer of the target")
+{
+	using EQ = eventpp::EventQueue<int, void (int)>;
+	EQ source;
+	EQ target;
+
+	std::atomic<int> sum(0);
+	target.appendListener(1, [&sum](const int n) {
+		sum += n;
+	});
+
+	std::atomic<bool> stopped(false);
+	std::thread consumer([&target, &stopped]() {
+		while(! stopped.load()) {
+			target.waitFor(std::chrono::milliseconds(10));
+			target.process();
+		}
+	});
+
+	for(int i = 1; i <= 10; ++i) {
+		source.enqueue(1, i);
+	}
+	source.moveEventsTo(target);
+
+	for(int i = 0; i < 500 && sum.load() != 55; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	stopped = true;
+	consumer.join();
+	REQUIRE(sum == 55);
+}
+
+TEST_CASE("EventQueue, moveEventsTo, two queues moving to each other")
+{
+	using EQ = eventpp::EventQueue<int, void (int)>;
+	EQ queueA;
+	EQ queueB;
+
+	constexpr int eventCount = 1000;
+	for(int i = 0; i < eventCount; ++i) {
+		queueA.enqueue(1, i);
+		queueB.enqueue(1, i);
+	}
+
+	constexpr int iterations = 2000;
+	std::thread threadA([&queueA, &queueB]() {
+		for(int i = 0; i < iterations; ++i) {
+			queueA.moveEventsIf(queueB, [i](const int n) {
+				return (n + i) % 2 == 0;
+			});
+		}
+	});
+	std::thread threadB([&queueA, &queueB]() {
+		for(int i = 0; i < iterations; ++i) {
+			queueB.moveEventsTo(queueA);
+		}
+	});
+	threadA.join();
+	threadB.join();
+
+	int count = 0;
+	queueA.appendListener(1, [&count](int) {
+		++count;
+	});
+	queueB.appendListener(1, [&count](int) {
+		++count;
+	});
+	queueA.process();
+	queueB.process();
+	REQUIRE(count == eventCount * 2);
+}
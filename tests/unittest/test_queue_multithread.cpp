@@ -212,3 +212,48 @@ TEST_CASE("EventQueue, multi threading, many threads wait")
 	REQUIRE(std::accumulate(dataList.begin(), dataList.end(), 0) == itemCount * 2);
 }
 
+
+TEST_CASE("EventQueue, multi threading, ProducerBuffer keeps per producer order")
+{
+	using EQ = eventpp::EventQueue<int, void (int, int)>;
+	EQ queue;
+
+	constexpr int threadCount = 16;
+	constexpr int dataCountPerThread = 1024 * 4;
+
+	std::vector<std::vector<int> > dataList(threadCount);
+	queue.appendListener(0, [&dataList](int, int value) {
+		dataList[value / dataCountPerThread].push_back(value);
+	});
+
+	std::atomic<int> finishedCount(0);
+	std::thread consumer([&queue, &finishedCount, threadCount]() {
+		while(finishedCount.load() < threadCount) {
+			queue.waitFor(std::chrono::milliseconds(1));
+			queue.process();
+		}
+		queue.process();
+	});
+
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < threadCount; ++i) {
+		threadList.emplace_back([i, dataCountPerThread, &queue, &finishedCount]() {
+			EQ::ProducerBuffer buffer(&queue, 32);
+			for(int k = i * dataCountPerThread; k < (i + 1) * dataCountPerThread; ++k) {
+				buffer.enqueue(0, k);
+			}
+			buffer.flush();
+			++finishedCount;
+		});
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+	consumer.join();
+
+	for(int i = 0; i < threadCount; ++i) {
+		std::vector<int> compareList(dataCountPerThread);
+		std::iota(compareList.begin(), compareList.end(), i * dataCountPerThread);
+		REQUIRE(dataList[i] == compareList);
+	}
+}
@@ -0,0 +1,157 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+
+#if EVENTPP_HAS_FD_NOTIFIER
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
+
+namespace {
+
+struct NotifierPolicies
+{
+	using QueueNotifier = eventpp::QueueNotifierFd;
+};
+
+bool isReadable(const int fd, const int timeoutMilliseconds = 0)
+{
+	pollfd item {};
+	item.fd = fd;
+	item.events = POLLIN;
+	return poll(&item, 1, timeoutMilliseconds) == 1 && (item.revents & POLLIN) != 0;
+}
+
+} //namespace
+
+TEST_CASE("EventQueue, QueueNotifierFd is readable when the queue is not empty")
+{
+	eventpp::EventQueue<int, void (int), NotifierPolicies> queue;
+	std::vector<int> dataList;
+	queue.appendListener(1, [&dataList](const int n) {
+		dataList.push_back(n);
+	});
+
+	const int fd = queue.getNotifierFd();
+	REQUIRE(fd >= 0);
+	REQUIRE(! isReadable(fd));
+
+	queue.enqueue(1, 1);
+	REQUIRE(isReadable(fd));
+	queue.enqueue(1, 2);
+	queue.enqueue(1, 3);
+	REQUIRE(queue.process());
+	REQUIRE(dataList == std::vector<int>{ 1, 2, 3 });
+	REQUIRE(! isReadable(fd));
+
+	// Nothing is signaled, processing doesn't touch the descriptor.
+	REQUIRE(! queue.process());
+	REQUIRE(! isReadable(fd));
+
+	SECTION("processOne") {
+		queue.enqueue(1, 4);
+		queue.enqueue(1, 5);
+		REQUIRE(queue.processOne());
+		REQUIRE(! isReadable(fd));
+		REQUIRE(queue.processOne());
+		queue.enqueue(1, 6);
+		REQUIRE(isReadable(fd));
+	}
+
+	SECTION("enqueueBulk") {
+		const std::vector<int> events{ 1, 1 };
+		queue.enqueueBulk(events.begin(), events.end());
+		REQUIRE(isReadable(fd));
+	}
+
+	SECTION("ProducerBuffer") {
+		decltype(queue)::ProducerBuffer buffer(&queue, 2);
+		buffer.enqueue(1, 4);
+		REQUIRE(! isReadable(fd));
+		buffer.enqueue(1, 5);
+		REQUIRE(isReadable(fd));
+	}
+
+	SECTION("DisableQueueNotify") {
+		{
+			decltype(queue)::DisableQueueNotify disableNotify(&queue);
+			queue.enqueue(1, 4);
+			REQUIRE(! isReadable(fd));
+		}
+		REQUIRE(isReadable(fd));
+	}
+}
+
+#if defined(__linux__)
+TEST_CASE("EventQueue, QueueNotifierFd signals once per transition")
+{
+	eventpp::EventQueue<int, void (int), NotifierPolicies> queue;
+	for(int i = 0; i < 100; ++i) {
+		queue.enqueue(1, i);
+	}
+
+	// The eventfd counter is the count of the writes.
+	std::uint64_t value = 0;
+	REQUIRE(read(queue.getNotifierFd(), &value, sizeof(value)) == sizeof(value));
+	REQUIRE(value == 1);
+}
+#endif
+
+TEST_CASE("EventQueue, QueueNotifierFd multiple threading")
+{
+	using EQ = eventpp::EventQueue<int, void (int), NotifierPolicies>;
+	EQ queue;
+
+	constexpr int threadCount = 4;
+	constexpr int itemCount = 20000;
+
+	std::atomic<int> processedCount(0);
+	queue.appendListener(1, [&processedCount](int) {
+		++processedCount;
+	});
+
+	std::thread consumer([&queue, &processedCount]() {
+		while(processedCount.load() < threadCount * itemCount) {
+			// A lost wakeup fails here instead of hanging.
+			REQUIRE(isReadable(queue.getNotifierFd(), 10000));
+			queue.process();
+		}
+	});
+
+	std::vector<std::thread> threadList;
+	for(int t = 0; t < threadCount; ++t) {
+		threadList.emplace_back([&queue]() {
+			for(int i = 0; i < itemCount; ++i) {
+				queue.enqueue(1, i);
+			}
+		});
+	}
+
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+	consumer.join();
+
+	REQUIRE(processedCount.load() == threadCount * itemCount);
+	REQUIRE(queue.emptyQueue());
+}
+
+#endif
+
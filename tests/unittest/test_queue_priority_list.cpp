@@ -0,0 +1,223 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/utilities/priorityqueuelist.h"
+
+#include <chrono>
+#include <vector>
+
+namespace {
+
+// Event 1 is the control event in lane 0, event 2 is the data event in lane 1.
+// The argument is the sequence number of the event.
+struct PriorityStrictPolicies
+{
+	static int getPriority(const int event, int) {
+		return event == 1 ? 0 : 1;
+	}
+
+	template <typename T>
+	using QueueList = eventpp::PriorityQueueList<T, PriorityStrictPolicies, 2>;
+};
+
+struct PriorityWeightedPolicies
+{
+	static int getPriority(const int event, int) {
+		return event == 1 ? 0 : 1;
+	}
+
+	static std::size_t getLaneWeight(const std::size_t lane) {
+		return lane == 0 ? 3 : 1;
+	}
+
+	template <typename T>
+	using QueueList = eventpp::PriorityQueueList<T, PriorityWeightedPolicies, 2>;
+};
+
+struct PriorityPoolPolicies
+{
+	static int getPriority(const int event, int) {
+		// Out of range, goes to the last lane.
+		return event == 1 ? 0 : 100;
+	}
+
+	template <typename T>
+	using QueueList = eventpp::PriorityQueueList<T, PriorityPoolPolicies, 3, eventpp::PoolQueueList<T, 64> >;
+};
+
+template <typename Queue>
+void addPriorityListeners(Queue & queue, std::vector<int> & dataList)
+{
+	queue.appendListener(1, [&dataList](int n) {
+		dataList.push_back(n);
+	});
+	queue.appendListener(2, [&dataList](int n) {
+		dataList.push_back(n);
+	});
+}
+
+} //namespace
+
+TEST_CASE("PriorityQueueList, control events overtake the data backlog")
+{
+	eventpp::EventQueue<int, void (int), PriorityStrictPolicies> queue;
+	std::vector<int> dataList;
+	addPriorityListeners(queue, dataList);
+
+	for(int i = 0; i < 1000; ++i) {
+		queue.enqueue(2, 100 + i);
+	}
+	queue.enqueue(1, 1);
+	queue.enqueue(2, 1100);
+	queue.enqueue(1, 2);
+
+	SECTION("process") {
+		REQUIRE(queue.process());
+		REQUIRE(dataList.size() == 1003);
+		REQUIRE(dataList[0] == 1);
+		REQUIRE(dataList[1] == 2);
+		for(int i = 0; i <= 1000; ++i) {
+			REQUIRE(dataList[i + 2] == 100 + i);
+		}
+	}
+
+	SECTION("processOne") {
+		REQUIRE(queue.processOne());
+		REQUIRE(queue.processOne());
+		REQUIRE(queue.processOne());
+		REQUIRE(dataList == std::vector<int>{ 1, 2, 100 });
+
+		queue.enqueue(1, 3);
+		REQUIRE(queue.processOne());
+		REQUIRE(dataList == std::vector<int>{ 1, 2, 100, 3 });
+	}
+
+	SECTION("processN") {
+		REQUIRE(queue.processN(4));
+		REQUIRE(dataList == std::vector<int>{ 1, 2, 100, 101 });
+	}
+
+	SECTION("processIf keeps the order in each lane") {
+		REQUIRE(queue.processIf([](const int n) { return n % 2 == 0; }));
+		REQUIRE(dataList.front() == 2);
+		dataList.clear();
+
+		queue.enqueue(1, 3);
+		REQUIRE(queue.process());
+		REQUIRE(dataList.size() == 502);
+		REQUIRE(dataList[0] == 1);
+		REQUIRE(dataList[1] == 3);
+		for(int i = 0; i < 500; ++i) {
+			REQUIRE(dataList[i + 2] == 101 + i * 2);
+		}
+	}
+
+	SECTION("processFor") {
+		REQUIRE(queue.processFor(std::chrono::nanoseconds(0)));
+		REQUIRE(dataList == std::vector<int>{ 1 });
+		queue.enqueue(1, 3);
+		REQUIRE(queue.processFor(std::chrono::nanoseconds(0)));
+		REQUIRE(queue.processFor(std::chrono::nanoseconds(0)));
+		REQUIRE(dataList == std::vector<int>{ 1, 2, 3 });
+	}
+
+	SECTION("peekEvent and takeEvent") {
+		decltype(queue)::QueuedEvent queuedEvent;
+		REQUIRE(queue.peekEvent(&queuedEvent));
+		REQUIRE(queuedEvent.getArgument<0>() == 1);
+		REQUIRE(queue.takeEvent(&queuedEvent));
+		REQUIRE(queue.takeEvent(&queuedEvent));
+		REQUIRE(queuedEvent.getArgument<0>() == 2);
+		REQUIRE(queue.takeEvent(&queuedEvent));
+		REQUIRE(queuedEvent.getArgument<0>() == 100);
+	}
+}
+
+TEST_CASE("PriorityQueueList, enqueueBulk and ProducerBuffer")
+{
+	using EQ = eventpp::EventQueue<int, void (int), PriorityStrictPolicies>;
+	EQ queue;
+	std::vector<int> dataList;
+	addPriorityListeners(queue, dataList);
+
+	// Recycle some nodes so the free list is used.
+	queue.enqueue(2, 0);
+	queue.enqueue(1, 0);
+	queue.process();
+	dataList.clear();
+
+	queue.enqueueBulk(6, [](const size_t index) {
+		return std::make_tuple(index % 2 == 0 ? 2 : 1, (int)index);
+	});
+	{
+		EQ::ProducerBuffer buffer(&queue, 2);
+		buffer.enqueue(2, 10);
+		buffer.enqueue(1, 11);
+		buffer.enqueue(2, 12);
+	}
+	REQUIRE(queue.process());
+	REQUIRE(dataList == std::vector<int>{ 1, 3, 5, 11, 0, 2, 4, 10, 12 });
+}
+
+TEST_CASE("PriorityQueueList, lane weights")
+{
+	eventpp::EventQueue<int, void (int), PriorityWeightedPolicies> queue;
+	std::vector<int> dataList;
+	addPriorityListeners(queue, dataList);
+
+	for(int i = 0; i < 8; ++i) {
+		queue.enqueue(1, i);
+	}
+	for(int i = 0; i < 3; ++i) {
+		queue.enqueue(2, 100 + i);
+	}
+
+	const std::vector<int> expected { 0, 1, 2, 100, 3, 4, 5, 101, 6, 7, 102 };
+
+	SECTION("processOne") {
+		while(queue.processOne()) {
+		}
+		REQUIRE(dataList == expected);
+	}
+
+	SECTION("processN") {
+		REQUIRE(queue.processN(2));
+		REQUIRE(queue.processN(3));
+		REQUIRE(queue.processN(100));
+		REQUIRE(dataList == expected);
+	}
+
+	SECTION("process") {
+		REQUIRE(queue.process());
+		REQUIRE(dataList == expected);
+	}
+}
+
+TEST_CASE("PriorityQueueList, PoolQueueList lanes")
+{
+	eventpp::EventQueue<int, void (int), PriorityPoolPolicies> queue;
+	std::vector<int> dataList;
+	addPriorityListeners(queue, dataList);
+
+	for(int round = 0; round < 3; ++round) {
+		dataList.clear();
+		queue.enqueue(2, 5);
+		queue.enqueue(2, 6);
+		queue.enqueue(1, 7);
+		REQUIRE(queue.process());
+		REQUIRE(dataList == std::vector<int>{ 7, 5, 6 });
+	}
+	REQUIRE(queue.emptyQueue());
+}
@@ -0,0 +1,181 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct ReplyPolicies
+{
+	using QueueReply = eventpp::QueueReplyPooled;
+};
+
+struct ReplyTimestampPolicies
+{
+	using QueueReply = eventpp::QueueReplyPooled;
+	using QueueTimestamp = eventpp::QueueTimestampSteady;
+};
+
+} //unnamed namespace
+
+TEST_CASE("QueueReply, the reply has the value of the last listener")
+{
+	eventpp::EventQueue<int, std::string (int), ReplyPolicies> queue;
+	queue.appendListener(1, [](const int n) {
+		return std::to_string(n);
+	});
+	queue.appendListener(1, [](const int n) {
+		return std::to_string(n * 2);
+	});
+
+	auto reply = queue.enqueueWithReply(1, 5);
+	REQUIRE(reply.valid());
+	REQUIRE(! reply.isReady());
+	REQUIRE(! reply.waitFor(std::chrono::milliseconds(1)));
+
+	// An event enqueued without reply is dispatched as usual.
+	queue.enqueue(1, 3);
+
+	queue.process();
+	REQUIRE(reply.isReady());
+	REQUIRE(reply.hasValue());
+	REQUIRE(reply.get() == "10");
+	REQUIRE(queue.emptyQueue());
+}
+
+TEST_CASE("QueueReply, the reply has no value if no listener is called")
+{
+	eventpp::EventQueue<int, int (int), ReplyPolicies> queue;
+	queue.appendListener(1, [](const int n) {
+		return n;
+	});
+
+	auto reply = queue.enqueueWithReply(2, 5);
+	queue.process();
+	REQUIRE(reply.isReady());
+	REQUIRE(! reply.hasValue());
+}
+
+TEST_CASE("QueueReply, void prototype")
+{
+	eventpp::EventQueue<int, void (int &), ReplyPolicies> queue;
+	int value = 0;
+	queue.appendListener(1, [](int & n) {
+		n += 3;
+	});
+
+	auto reply = queue.enqueueWithReply(1, value);
+	queue.process();
+	reply.get();
+	REQUIRE(reply.hasValue());
+}
+
+TEST_CASE("QueueReply, the reply of an abandoned event is ready with no value")
+{
+	eventpp::EventQueue<int, int (int), ReplyPolicies> queue;
+	queue.appendListener(1, [](const int n) {
+		return n;
+	});
+
+	auto reply1 = queue.enqueueWithReply(1, 5);
+	auto reply2 = queue.enqueueWithReply(1, 6);
+	queue.clearEvents();
+	REQUIRE(reply1.isReady());
+	REQUIRE(! reply1.hasValue());
+	REQUIRE(reply2.isReady());
+	REQUIRE(! reply2.hasValue());
+
+	auto reply3 = queue.enqueueWithReply(1, 7);
+	queue.processQueueWith([](const int, const int) {});
+	REQUIRE(reply3.isReady());
+	REQUIRE(! reply3.hasValue());
+}
+
+TEST_CASE("QueueReply, the reply outlives the queue")
+{
+	eventpp::EventQueue<int, int (int), ReplyPolicies>::Reply reply;
+	REQUIRE(! reply.valid());
+	{
+		eventpp::EventQueue<int, int (int), ReplyPolicies> queue;
+		queue.appendListener(1, [](const int n) {
+			return n + 1;
+		});
+		reply = queue.enqueueWithReply(1, 5);
+		queue.process();
+	}
+	REQUIRE(reply.get() == 6);
+}
+
+TEST_CASE("QueueReply, with QueueTimestamp")
+{
+	eventpp::EventQueue<int, int (int), ReplyTimestampPolicies> queue;
+	queue.appendListener(1, [](const int n) {
+		return n + 1;
+	});
+
+	auto reply = queue.enqueueWithReply(1, 5);
+	queue.processQueueWith([](const int, const int) {});
+	REQUIRE(reply.isReady());
+
+	reply = queue.enqueueWithReply(1, 8);
+	queue.processOne();
+	REQUIRE(reply.get() == 9);
+}
+
+TEST_CASE("QueueReply, multi threading, many requesters and one consumer")
+{
+	using EQ = eventpp::EventQueue<int, int (int), ReplyPolicies>;
+	EQ queue;
+	queue.appendListener(1, [](const int n) {
+		return n * 2;
+	});
+
+	constexpr int threadCount = 4;
+	constexpr int requestCount = 2000;
+
+	std::atomic<bool> stopped(false);
+	std::thread consumer([&queue, &stopped]() {
+		while(! stopped.load()) {
+			queue.waitFor(std::chrono::milliseconds(10));
+			queue.process();
+		}
+	});
+
+	std::atomic<int> matchedCount(0);
+	std::vector<std::thread> threadList;
+	for(int t = 0; t < threadCount; ++t) {
+		threadList.emplace_back([&queue, &matchedCount, t]() {
+			for(int i = 0; i < requestCount; ++i) {
+				const int n = t * requestCount + i;
+				EQ::Reply reply = queue.enqueueWithReply(1, n);
+				if(reply.get() == n * 2) {
+					++matchedCount;
+				}
+			}
+		});
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+	stopped.store(true);
+	consumer.join();
+
+	REQUIRE(matchedCount.load() == threadCount * requestCount);
+}
@@ -0,0 +1,194 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct TimerPolicies
+{
+	using Timer = eventpp::TimerWheel;
+};
+
+struct TimerMillisecondPolicies
+{
+	using Timer = eventpp::TimerWheel;
+	using TimerResolution = std::chrono::milliseconds;
+};
+
+using Clock = std::chrono::steady_clock;
+
+} //namespace
+
+TEST_CASE("TimingWheel, items expire at their ticks")
+{
+	// 4 slots per level and 2 levels, so the wheel covers 16 ticks and
+	// cascading and the overflow list are used a lot.
+	using Wheel = eventpp::internal_::TimingWheel<int, 2, 2>;
+	Wheel wheel;
+	REQUIRE(wheel.getNextTick() == Wheel::noTick);
+
+	std::mt19937 engine(1);
+	std::uniform_int_distribution<int> distribution(0, 200);
+	std::vector<std::pair<Wheel::Tick, int> > expected;
+	for(int i = 0; i < 500; ++i) {
+		const Wheel::Tick tick = static_cast<Wheel::Tick>(distribution(engine));
+		wheel.insert(tick, int(i));
+		expected.emplace_back(tick, i);
+	}
+	REQUIRE(wheel.size() == 500);
+	// Ordered by tick, then by insertion.
+	std::stable_sort(expected.begin(), expected.end(), [](const std::pair<Wheel::Tick, int> & a, const std::pair<Wheel::Tick, int> & b) {
+		return a.first < b.first;
+	});
+
+	std::vector<std::pair<Wheel::Tick, int> > expired;
+	SECTION("one tick a time") {
+		for(Wheel::Tick tick = 0; tick <= 200; ++tick) {
+			REQUIRE(wheel.getNextTick() >= tick);
+			wheel.advance(tick, [&expired, tick](int && value) {
+				expired.emplace_back(tick, value);
+			});
+		}
+	}
+
+	SECTION("jump to the next tick") {
+		while(! wheel.empty()) {
+			const Wheel::Tick tick = wheel.getNextTick();
+			wheel.advance(tick, [&expired, tick](int && value) {
+				expired.emplace_back(tick, value);
+			});
+		}
+	}
+
+	REQUIRE(expired == expected);
+	REQUIRE(wheel.empty());
+}
+
+TEST_CASE("TimingWheel, late insert and big jumps")
+{
+	using Wheel = eventpp::internal_::TimingWheel<int, 2, 2>;
+	Wheel wheel;
+	std::vector<int> expired;
+	auto collect = [&expired](int && value) {
+		expired.push_back(value);
+	};
+
+	wheel.advance(100, collect);
+	REQUIRE(wheel.getCurrentTick() == 100);
+
+	// Before the current tick, due now.
+	wheel.insert(3, 1);
+	REQUIRE(wheel.getNextTick() == 100);
+	wheel.insert(1000000, 2);
+	wheel.insert(101, 3);
+	wheel.advance(100, collect);
+	REQUIRE(expired == std::vector<int>{ 1 });
+
+	wheel.advance(999999, collect);
+	REQUIRE(expired == std::vector<int>{ 1, 3 });
+	wheel.advance(1000000, collect);
+	REQUIRE(expired == std::vector<int>{ 1, 3, 2 });
+	REQUIRE(wheel.empty());
+}
+
+TEST_CASE("EventQueue, enqueueAfter")
+{
+	eventpp::EventQueue<int, void (int), TimerPolicies> queue;
+	std::vector<int> dataList;
+	queue.appendListener(1, [&dataList](const int n) {
+		dataList.push_back(n);
+	});
+
+	const auto start = Clock::now();
+	queue.enqueueAt(start + std::chrono::milliseconds(40), 1, 3);
+	queue.enqueueAfter(std::chrono::milliseconds(20), 1, 2);
+	queue.enqueueAt(start + std::chrono::milliseconds(40), 1, 4);
+	queue.enqueue(1, 1);
+	REQUIRE(queue.getDelayedEventCount() == 3);
+
+	REQUIRE(queue.process());
+	REQUIRE(dataList == std::vector<int>{ 1 });
+	REQUIRE(queue.emptyQueue());
+
+	while(dataList.size() < 4) {
+		REQUIRE(queue.waitFor(std::chrono::seconds(10)));
+		REQUIRE(queue.process());
+	}
+	REQUIRE(Clock::now() - start >= std::chrono::milliseconds(40));
+	REQUIRE(dataList == std::vector<int>{ 1, 2, 3, 4 });
+	REQUIRE(queue.getDelayedEventCount() == 0);
+
+	// A time point in the past is due at once.
+	queue.enqueueAt(start, 1, 5);
+	REQUIRE(queue.waitFor(std::chrono::nanoseconds(0)));
+	REQUIRE(queue.processOne());
+	REQUIRE(dataList.back() == 5);
+}
+
+TEST_CASE("EventQueue, waitFor wakes at the deadline")
+{
+	eventpp::EventQueue<int, void (int), TimerMillisecondPolicies> queue;
+	int value = 0;
+	queue.appendListener(1, [&value](const int n) {
+		value = n;
+	});
+
+	const auto start = Clock::now();
+	queue.enqueueAfter(std::chrono::milliseconds(30), 1, 8);
+
+	REQUIRE(! queue.waitFor(std::chrono::milliseconds(5)));
+	REQUIRE(queue.waitFor(std::chrono::seconds(10)));
+	const auto elapsed = Clock::now() - start;
+	REQUIRE(elapsed >= std::chrono::milliseconds(30));
+	REQUIRE(elapsed < std::chrono::seconds(5));
+	REQUIRE(queue.process());
+	REQUIRE(value == 8);
+}
+
+TEST_CASE("EventQueue, an earlier delayed event wakes the consumer")
+{
+	using EQ = eventpp::EventQueue<int, void (int), TimerPolicies>;
+	EQ queue;
+	std::vector<int> dataList;
+	queue.appendListener(1, [&dataList](const int n) {
+		dataList.push_back(n);
+	});
+
+	queue.enqueueAfter(std::chrono::seconds(30), 1, 2);
+
+	const auto start = Clock::now();
+	std::thread consumer([&queue]() {
+		queue.wait();
+		queue.process();
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	queue.enqueueAfter(std::chrono::milliseconds(10), 1, 1);
+	consumer.join();
+
+	REQUIRE(Clock::now() - start < std::chrono::seconds(10));
+	REQUIRE(dataList == std::vector<int>{ 1 });
+	REQUIRE(queue.getDelayedEventCount() == 1);
+
+	queue.clearDelayedEvents();
+	REQUIRE(queue.getDelayedEventCount() == 0);
+	REQUIRE(! queue.waitFor(std::chrono::milliseconds(1)));
+}
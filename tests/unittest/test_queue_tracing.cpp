@@ -0,0 +1,195 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/utilities/tracers.h"
+
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct RecordingTracer
+{
+	static std::vector<eventpp::TraceRecord> enqueueList;
+	static std::vector<eventpp::TraceRecord> dispatchList;
+	static std::mutex mutex;
+
+	static void onEnqueue(const eventpp::TraceRecord & record) {
+		std::lock_guard<std::mutex> lockGuard(mutex);
+		enqueueList.push_back(record);
+	}
+
+	static void onDispatch(const eventpp::TraceRecord & record) {
+		std::lock_guard<std::mutex> lockGuard(mutex);
+		dispatchList.push_back(record);
+	}
+
+	static void clear() {
+		enqueueList.clear();
+		dispatchList.clear();
+	}
+};
+
+std::vector<eventpp::TraceRecord> RecordingTracer::enqueueList;
+std::vector<eventpp::TraceRecord> RecordingTracer::dispatchList;
+std::mutex RecordingTracer::mutex;
+
+struct RecordingPolicies
+{
+	using Tracer = RecordingTracer;
+};
+
+using TestChromeTracer = eventpp::ChromeTracer<64>;
+
+struct ChromePolicies
+{
+	using Tracer = eventpp::TracerList<TestChromeTracer, RecordingTracer, eventpp::UsdtTracer>;
+};
+
+} //namespace
+
+TEST_CASE("QueueTracing, the trace ID follows the event across the queues")
+{
+	RecordingTracer::clear();
+
+	using EQ = eventpp::EventQueue<int, void (int), RecordingPolicies>;
+	EQ queueA;
+	EQ queueB;
+	queueA.appendListener(1, [&queueB](int) {
+		queueB.enqueue(2);
+	});
+	queueB.appendListener(2, [](int) {
+	});
+
+	queueA.enqueue(1);
+	queueA.enqueue(1);
+	queueA.process();
+	queueB.process();
+	// Not in a dispatch, it's a new trace.
+	queueB.enqueue(3);
+	queueB.process();
+
+	REQUIRE(RecordingTracer::enqueueList.size() == 5);
+	REQUIRE(RecordingTracer::dispatchList.size() == 5);
+
+	const auto & enqueueList = RecordingTracer::enqueueList;
+	REQUIRE(enqueueList[0].traceId != 0);
+	REQUIRE(enqueueList[1].traceId != enqueueList[0].traceId);
+	// Enqueued by the listeners of the two events.
+	REQUIRE(enqueueList[2].traceId == enqueueList[0].traceId);
+	REQUIRE(enqueueList[3].traceId == enqueueList[1].traceId);
+	REQUIRE(enqueueList[2].queue == &queueB);
+	REQUIRE(enqueueList[4].traceId != enqueueList[0].traceId);
+	REQUIRE(enqueueList[4].traceId != enqueueList[1].traceId);
+
+	const auto & dispatchList = RecordingTracer::dispatchList;
+	REQUIRE(dispatchList[0].eventId == 1);
+	REQUIRE(dispatchList[0].queue == &queueA);
+	REQUIRE(dispatchList[2].eventId == 2);
+	REQUIRE(dispatchList[2].traceId == enqueueList[0].traceId);
+	REQUIRE(dispatchList[3].traceId == enqueueList[1].traceId);
+	for(const auto & record : dispatchList) {
+		REQUIRE(record.enqueueTime <= record.beginTime);
+		REQUIRE(record.beginTime <= record.endTime);
+	}
+
+	REQUIRE(eventpp::internal_::TraceContext::getCurrentTraceId() == 0);
+}
+
+TEST_CASE("QueueTracing, processOne, the visitor and takeEvent")
+{
+	RecordingTracer::clear();
+
+	using EQ = eventpp::EventQueue<int, void (int), RecordingPolicies>;
+	EQ queue;
+	queue.appendListener(1, [](int) {
+		REQUIRE(eventpp::internal_::TraceContext::getCurrentTraceId() != 0);
+	});
+
+	queue.enqueue(1);
+	queue.enqueue(1);
+	queue.enqueue(1);
+	REQUIRE(queue.processOne());
+	REQUIRE(queue.processOneWith([](int, int) {
+		REQUIRE(eventpp::internal_::TraceContext::getCurrentTraceId() != 0);
+	}));
+
+	EQ::QueuedEvent queuedEvent;
+	REQUIRE(queue.takeEvent(&queuedEvent));
+	REQUIRE(queuedEvent.getTraceId() == RecordingTracer::enqueueList[2].traceId);
+
+	REQUIRE(RecordingTracer::enqueueList.size() == 3);
+	REQUIRE(RecordingTracer::dispatchList.size() == 2);
+}
+
+TEST_CASE("QueueTracing, no Tracer")
+{
+	using Plain = eventpp::EventQueue<int, void (int)>;
+	struct StampPolicies {
+		using QueueTimestamp = eventpp::QueueTimestampSteady;
+	};
+	using Stamped = eventpp::EventQueue<int, void (int), StampPolicies>;
+	using Traced = eventpp::EventQueue<int, void (int), RecordingPolicies>;
+
+	REQUIRE(sizeof(Plain::QueuedEvent) < sizeof(Stamped::QueuedEvent));
+	REQUIRE(sizeof(Stamped::QueuedEvent) < sizeof(Traced::QueuedEvent));
+}
+
+TEST_CASE("QueueTracing, ChromeTracer")
+{
+	RecordingTracer::clear();
+	TestChromeTracer::clear();
+
+	using EQ = eventpp::EventQueue<int, void (int), ChromePolicies>;
+	EQ queue;
+	queue.appendListener(1, [&queue](int) {
+		queue.enqueue(2);
+	});
+
+	queue.enqueue(1);
+	std::thread thread([&queue]() {
+		queue.enqueue(3);
+	});
+	thread.join();
+	queue.process();
+	queue.process();
+
+	REQUIRE(RecordingTracer::dispatchList.size() == 3);
+	REQUIRE(TestChromeTracer::getRecordCount() == 6);
+
+	std::ostringstream stream;
+	TestChromeTracer::dump(stream);
+	const std::string json = stream.str();
+	REQUIRE(json.find("{\"traceEvents\":[") == 0);
+	REQUIRE(json.find("\"name\":\"event 1\",\"ph\":\"X\"") != std::string::npos);
+	REQUIRE(json.find("\"name\":\"event 2\",\"ph\":\"X\"") != std::string::npos);
+	REQUIRE(json.find("\"name\":\"event 3\",\"ph\":\"X\"") != std::string::npos);
+	REQUIRE(json.find("\"ph\":\"s\"") != std::string::npos);
+	REQUIRE(json.find("\"ph\":\"f\"") != std::string::npos);
+	REQUIRE(json.find("\"tid\":2") != std::string::npos);
+
+	// The ring keeps the latest records.
+	for(int i = 0; i < 100; ++i) {
+		queue.enqueue(3);
+	}
+	REQUIRE(TestChromeTracer::getRecordCount() == 64 + 1);
+
+	TestChromeTracer::clear();
+	REQUIRE(TestChromeTracer::getRecordCount() == 0);
+	queue.clearEvents();
+}
@@ -0,0 +1,143 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+template <typename Strategy>
+struct WaitPolicies
+{
+	using WaitStrategy = Strategy;
+};
+
+struct TimerWaitPolicies
+{
+	using WaitStrategy = eventpp::WaitBusySpin;
+	using Timer = eventpp::TimerWheel;
+};
+
+using Clock = std::chrono::steady_clock;
+
+} //namespace
+
+TEMPLATE_TEST_CASE("EventQueue, WaitStrategy", "",
+	eventpp::WaitSpinThenPark<>,
+	(eventpp::WaitSpinThenPark<0, 0>),
+	(eventpp::WaitSpinThenYield<16, 4>),
+	eventpp::WaitBusySpin,
+	eventpp::WaitBlocking,
+	(eventpp::WaitAdaptive<4, 64, 4>),
+	(eventpp::WaitMonitorThenPark<8>)
+)
+{
+	using EQ = eventpp::EventQueue<int, void (int), WaitPolicies<TestType> >;
+	EQ queue;
+
+	const auto start = Clock::now();
+	REQUIRE(! queue.waitFor(std::chrono::milliseconds(5)));
+	REQUIRE(Clock::now() - start >= std::chrono::milliseconds(5));
+
+	auto stats = queue.getWaitStats();
+	REQUIRE(stats.spinWakeCount == 0);
+	REQUIRE(stats.yieldWakeCount == 0);
+	REQUIRE(stats.parkCount == 1);
+	REQUIRE(stats.timeoutCount == 1);
+
+	queue.enqueue(1, 1);
+	REQUIRE(queue.waitFor(std::chrono::milliseconds(5)));
+	queue.wait();
+	// Found in phase 1, no phase is counted.
+	REQUIRE(queue.getWaitStats().parkCount == 1);
+
+	constexpr int itemCount = 2000;
+	std::atomic<int> processedCount(0);
+	queue.appendListener(1, [&processedCount](int) {
+		++processedCount;
+	});
+	std::thread consumer([&queue, &processedCount]() {
+		while(processedCount.load() < itemCount + 1) {
+			queue.wait();
+			queue.process();
+		}
+	});
+	for(int i = 0; i < itemCount; ++i) {
+		queue.enqueue(1, i);
+		if(i % 100 == 0) {
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+	}
+	consumer.join();
+	REQUIRE(processedCount.load() == itemCount + 1);
+}
+
+TEST_CASE("EventQueue, WaitAdaptive shrinks the spin count when the events are far apart")
+{
+	using EQ = eventpp::EventQueue<int, void (int), WaitPolicies<eventpp::WaitAdaptive<8, 1024, 0> > >;
+	EQ queue;
+	REQUIRE(queue.getWaitStats().spinLimit == 1024);
+
+	REQUIRE(! queue.waitFor(std::chrono::milliseconds(0)));
+	REQUIRE(queue.getWaitStats().spinLimit == 512);
+	for(int i = 0; i < 16; ++i) {
+		REQUIRE(! queue.waitFor(std::chrono::milliseconds(0)));
+	}
+	REQUIRE(queue.getWaitStats().spinLimit == 8);
+	REQUIRE(queue.getWaitStats().timeoutCount == 17);
+}
+
+TEST_CASE("EventQueue, a busy waiting strategy sees the delayed events")
+{
+	eventpp::EventQueue<int, void (int), TimerWaitPolicies> queue;
+	int value = 0;
+	queue.appendListener(1, [&value](const int n) {
+		value = n;
+	});
+
+	queue.enqueueAfter(std::chrono::milliseconds(10), 1, 5);
+	REQUIRE(queue.waitFor(std::chrono::seconds(10)));
+	REQUIRE(queue.process());
+	REQUIRE(value == 5);
+}
+
+// The wait loops are shared by the queue types, each queue is checked by
+// the function of its own type.
+TEST_CASE("EventQueue, queues of different types wait on their own events")
+{
+	using IntQueue = eventpp::EventQueue<int, void (int), WaitPolicies<eventpp::WaitSpinThenPark<16, 4> > >;
+	using StringQueue = eventpp::EventQueue<std::string, void (const std::string &), WaitPolicies<eventpp::WaitSpinThenPark<16, 4> > >;
+	IntQueue intQueue;
+	StringQueue stringQueue;
+
+	stringQueue.enqueue("a", "b");
+	REQUIRE(! intQueue.waitFor(std::chrono::milliseconds(1)));
+	REQUIRE(stringQueue.waitFor(std::chrono::milliseconds(1)));
+	REQUIRE(intQueue.getWaitStats().timeoutCount == 1);
+	REQUIRE(stringQueue.getWaitStats().timeoutCount == 0);
+
+	std::thread producer([&intQueue]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		intQueue.enqueue(1, 2);
+	});
+	intQueue.wait();
+	REQUIRE(intQueue.process());
+	producer.join();
+	REQUIRE(intQueue.getWaitStats().parkCount + intQueue.getWaitStats().spinWakeCount + intQueue.getWaitStats().yieldWakeCount == 2);
+}
@@ -0,0 +1,133 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/utilities/queuegroup.h"
+#include "eventpp/eventqueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct CountedPolicies
+{
+	using QueueCapacity = eventpp::QueueCapacityLimited;
+};
+
+using EQ = eventpp::EventQueue<int, void (int, int), CountedPolicies>;
+
+} //unnamed namespace
+
+TEST_CASE("QueueGroup, keyed events stay in one queue in order")
+{
+	EQ queueList[4];
+	eventpp::QueueGroup<EQ> group;
+	for(EQ & queue : queueList) {
+		group.add(queue);
+	}
+	REQUIRE(group.getQueueCount() == 4);
+
+	std::vector<std::vector<int> > sequenceList(16);
+	for(EQ & queue : queueList) {
+		queue.appendListener(1, [&sequenceList](const int key, const int sequence) {
+			sequenceList[key].push_back(sequence);
+		});
+	}
+
+	std::vector<std::size_t> keyIndexList(16);
+	for(int key = 0; key < 16; ++key) {
+		keyIndexList[key] = group.getKeyedIndex(key);
+	}
+	for(int sequence = 0; sequence < 10; ++sequence) {
+		for(int key = 0; key < 16; ++key) {
+			REQUIRE(group.enqueueKeyed(key, 1, key, sequence) == keyIndexList[key]);
+		}
+	}
+
+	// The close keys are spread.
+	std::vector<std::size_t> usedList(keyIndexList);
+	std::sort(usedList.begin(), usedList.end());
+	REQUIRE(std::unique(usedList.begin(), usedList.end()) - usedList.begin() > 1);
+
+	// Processed in any order of the queues, each key is in order.
+	for(int i = 3; i >= 0; --i) {
+		queueList[i].process();
+	}
+	for(const auto & sequence : sequenceList) {
+		REQUIRE(sequence == std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 });
+	}
+
+	REQUIRE(group.getKeyedIndex(std::string("abc")) == group.getKeyedIndex(std::string("abc")));
+}
+
+TEST_CASE("QueueGroup, power of two choices avoids the deep queue")
+{
+	EQ queueList[4];
+	eventpp::QueueGroup<EQ> group;
+	for(EQ & queue : queueList) {
+		group.add(queue);
+	}
+
+	// A hot queue, such as the queue of a busy key.
+	for(int i = 0; i < 1000; ++i) {
+		queueList[0].enqueue(1, 0, i);
+	}
+	for(int i = 0; i < 2400; ++i) {
+		group.enqueue(1, 0, i);
+	}
+
+	// The others stay shallower, and the two choices are different queues,
+	// so the deepest is never picked.
+	REQUIRE(queueList[0].getQueuedEventCount() == 1000);
+	std::size_t minCount = 2400;
+	std::size_t maxCount = 0;
+	for(int i = 1; i < 4; ++i) {
+		minCount = (std::min)(minCount, queueList[i].getQueuedEventCount());
+		maxCount = (std::max)(maxCount, queueList[i].getQueuedEventCount());
+	}
+	// Random placement would be about 50 apart.
+	REQUIRE(maxCount - minCount <= 20);
+
+	// One queue.
+	EQ single;
+	eventpp::QueueGroup<EQ> singleGroup;
+	singleGroup.add(single);
+	REQUIRE(singleGroup.enqueue(1, 0, 0) == 0);
+	REQUIRE(singleGroup.enqueueKeyed(5, 1, 0, 0) == 0);
+}
+
+TEST_CASE("QueueGroup, waitAny")
+{
+	EQ queueList[3];
+	eventpp::QueueGroup<EQ> group;
+	for(EQ & queue : queueList) {
+		group.add(queue);
+	}
+
+	REQUIRE(group.getReady() == 0);
+	REQUIRE(group.waitAnyFor(std::chrono::milliseconds(5)) == 0);
+
+	std::thread producer([&queueList]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		queueList[2].enqueue(1, 0, 0);
+	});
+	REQUIRE(group.waitAny() == (eventpp::QueueGroup<EQ>::ReadyMask(1) << 2));
+	producer.join();
+
+	const std::size_t index = group.enqueue(1, 0, 0);
+	REQUIRE((group.waitAnyFor(std::chrono::seconds(1)) & (eventpp::QueueGroup<EQ>::ReadyMask(1) << index)) != 0);
+}
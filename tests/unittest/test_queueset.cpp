@@ -0,0 +1,151 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/utilities/queueset.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct TimerPolicies
+{
+	using Timer = eventpp::TimerWheel;
+};
+
+} //unnamed namespace
+
+TEST_CASE("QueueSet, getReady and waitFor")
+{
+	using ControlQueue = eventpp::EventQueue<int, void (int)>;
+	using DataQueue = eventpp::EventQueue<int, void (const std::vector<int> &)>;
+	ControlQueue controlQueue;
+	DataQueue dataQueue;
+
+	eventpp::QueueSet queueSet;
+	REQUIRE(queueSet.add(controlQueue) == 0);
+	REQUIRE(queueSet.add(dataQueue) == 1);
+	REQUIRE(queueSet.getQueueCount() == 2);
+
+	REQUIRE(queueSet.getReady() == 0);
+	REQUIRE(queueSet.waitFor(std::chrono::milliseconds(1)) == 0);
+
+	dataQueue.enqueue(1, std::vector<int> { 1 });
+	REQUIRE(queueSet.waitFor(std::chrono::milliseconds(0)) == 2);
+	controlQueue.enqueue(1, 2);
+	REQUIRE(queueSet.getReady() == 3);
+
+	dataQueue.process();
+	REQUIRE(queueSet.wait() == 1);
+	controlQueue.process();
+	REQUIRE(queueSet.getReady() == 0);
+
+	// A flushed ProducerBuffer signals the set.
+	ControlQueue::ProducerBuffer buffer(&controlQueue);
+	buffer.enqueue(1, 3);
+	REQUIRE(queueSet.getReady() == 0);
+	buffer.flush();
+	REQUIRE(queueSet.getReady() == 1);
+}
+
+TEST_CASE("QueueSet, a producer wakes the waiting consumer")
+{
+	using EQ = eventpp::EventQueue<int, void (int)>;
+	EQ controlQueue;
+	EQ dataQueue;
+	std::atomic<int> controlCount(0);
+	std::atomic<int> dataCount(0);
+	controlQueue.appendListener(1, [&controlCount](int) {
+		++controlCount;
+	});
+	dataQueue.appendListener(1, [&dataCount](int) {
+		++dataCount;
+	});
+
+	constexpr int eventCount = 1000;
+	std::atomic<bool> stopped(false);
+	std::thread consumer([&]() {
+		eventpp::QueueSet queueSet;
+		queueSet.add(controlQueue);
+		queueSet.add(dataQueue);
+		while(! stopped.load() || queueSet.getReady() != 0) {
+			const auto ready = queueSet.waitFor(std::chrono::milliseconds(100));
+			// The control queue is served first.
+			if(ready & 1) {
+				controlQueue.process();
+			}
+			if(ready & 2) {
+				dataQueue.process();
+			}
+		}
+	});
+
+	std::thread controlProducer([&]() {
+		for(int i = 0; i < eventCount; ++i) {
+			controlQueue.enqueue(1, i);
+		}
+	});
+	std::thread dataProducer([&]() {
+		for(int i = 0; i < eventCount; ++i) {
+			EQ::ProducerBuffer buffer(&dataQueue);
+			buffer.enqueue(1, i);
+		}
+	});
+	controlProducer.join();
+	dataProducer.join();
+	stopped = true;
+	consumer.join();
+
+	REQUIRE(controlCount == eventCount);
+	REQUIRE(dataCount == eventCount);
+}
+
+TEST_CASE("QueueSet, delayed events wake the set when they are due")
+{
+	using TimerQueue = eventpp::EventQueue<int, void (), TimerPolicies>;
+	eventpp::EventQueue<int, void ()> queue;
+	TimerQueue timerQueue;
+
+	eventpp::QueueSet queueSet;
+	queueSet.add(queue);
+	queueSet.add(timerQueue);
+
+	const auto start = std::chrono::steady_clock::now();
+	timerQueue.enqueueAfter(std::chrono::milliseconds(20), 1);
+	REQUIRE(queueSet.getReady() == 0);
+	REQUIRE(queueSet.waitFor(std::chrono::seconds(5)) == 2);
+	REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(15));
+}
+
+TEST_CASE("QueueSet, waitAny")
+{
+	eventpp::EventQueue<int, void ()> queueA;
+	eventpp::EventQueue<int, void ()> queueB;
+
+	REQUIRE(eventpp::waitAny(std::chrono::milliseconds(1), queueA, queueB) == 0);
+
+	std::thread producer([&queueB]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		queueB.enqueue(1);
+	});
+	REQUIRE(eventpp::waitAny(std::chrono::seconds(5), queueA, queueB) == 2);
+	producer.join();
+
+	// The queues left the set, so they can join another.
+	eventpp::QueueSet queueSet;
+	queueSet.add(queueA);
+	REQUIRE(queueSet.getReady() == 0);
+}
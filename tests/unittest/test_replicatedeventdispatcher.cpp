@@ -0,0 +1,125 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/replicatedeventdispatcher.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("ReplicatedEventDispatcher, append, dispatch and remove")
+{
+	eventpp::ReplicatedEventDispatcher<int, void (int)> dispatcher;
+	std::vector<int> dataList;
+
+	REQUIRE(dispatcher.getVersion() == 1);
+	dispatcher.dispatch(1, 5);
+	REQUIRE(dataList.empty());
+	REQUIRE(dispatcher.getReplicaCount() == 1);
+
+	auto handle1 = dispatcher.appendListener(1, [&dataList](int n) {
+		dataList.push_back(n);
+	});
+	REQUIRE(dispatcher.getVersion() == 2);
+	// The replica of this thread is stale, the next dispatch copies the master.
+	dispatcher.dispatch(1, 6);
+	REQUIRE(dataList == std::vector<int>{ 6 });
+
+	dispatcher.prependListener(1, [&dataList](int n) {
+		dataList.push_back(n * 10);
+	});
+	// A new event after the replica was sealed.
+	dispatcher.appendListener(2, [&dataList](int n) {
+		dataList.push_back(-n);
+	});
+	REQUIRE(dispatcher.hasAnyListener(2));
+	dispatcher.dispatch(1, 7);
+	dispatcher.dispatch(2, 8);
+	REQUIRE(dataList == std::vector<int>{ 6, 70, 7, -8 });
+
+	REQUIRE(dispatcher.ownsHandle(1, handle1));
+	REQUIRE(dispatcher.removeListener(1, handle1));
+	REQUIRE(! dispatcher.removeListener(1, handle1));
+	const std::uint64_t version = dispatcher.getVersion();
+	dataList.clear();
+	dispatcher.dispatch(1, 9);
+	REQUIRE(dataList == std::vector<int>{ 90 });
+	REQUIRE(dispatcher.getVersion() == version);
+	REQUIRE(dispatcher.getReplicaCount() == 1);
+}
+
+TEST_CASE("ReplicatedEventDispatcher, change the listeners in a listener")
+{
+	eventpp::ReplicatedEventDispatcher<std::string, void (const std::string &, int)> dispatcher;
+	std::vector<int> dataList;
+
+	dispatcher.appendListener("a", [&dataList, &dispatcher](const std::string &, const int n) {
+		dataList.push_back(n);
+		if(n == 1) {
+			dispatcher.appendListener("a", [&dataList](const std::string &, const int n) {
+				dataList.push_back(n * 100);
+			});
+			// The replica is in use, the nested dispatch still sees the old listeners.
+			dispatcher.dispatch("a", 2);
+		}
+	});
+
+	dispatcher.dispatch("a", 1);
+	REQUIRE(dataList == std::vector<int>{ 1, 2 });
+
+	dataList.clear();
+	dispatcher.dispatch("a", 3);
+	REQUIRE(dataList == std::vector<int>{ 3, 300 });
+}
+
+TEST_CASE("ReplicatedEventDispatcher, multi threading")
+{
+	using ED = eventpp::ReplicatedEventDispatcher<int, void (int)>;
+	ED dispatcher;
+	constexpr int threadCount = 8;
+	constexpr int dispatchCount = 20000;
+	std::atomic<int> counter(0);
+	std::atomic<bool> stop(false);
+
+	dispatcher.appendListener(1, [&counter](const int n) {
+		counter += n;
+	});
+
+	// Keeps adding and removing a listener of another event.
+	std::thread writer([&dispatcher, &stop]() {
+		while(! stop.load()) {
+			ED::Handle handle = dispatcher.appendListener(2, [](int) {});
+			dispatcher.removeListener(2, handle);
+		}
+	});
+
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < threadCount; ++i) {
+		threadList.emplace_back([&dispatcher]() {
+			for(int k = 0; k < dispatchCount; ++k) {
+				dispatcher.dispatch(1, 1);
+				dispatcher.dispatch(2, 1);
+			}
+		});
+	}
+	for(std::thread & thread : threadList) {
+		thread.join();
+	}
+	stop = true;
+	writer.join();
+
+	REQUIRE(counter == threadCount * dispatchCount);
+	REQUIRE(dispatcher.getReplicaCount() == threadCount);
+}
@@ -0,0 +1,308 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// OPT-17: Tests for RingEventQueue
+
+#include "test.h"
+#include "eventpp/ringeventqueue.h"
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <numeric>
+#include <algorithm>
+
+namespace {
+
+template <typename Overflow, std::size_t capacity = 8>
+struct RingPolicies
+{
+	using RingOverflow = Overflow;
+	using RingCapacity = std::integral_constant<std::size_t, capacity>;
+};
+
+} //unnamed namespace
+
+TEST_CASE("RingEventQueue, enqueue and process")
+{
+	eventpp::RingEventQueue<int, void (int, int)> queue;
+	REQUIRE(queue.getQueueCapacity() == 1024);
+
+	std::vector<int> dataList(3);
+	queue.appendListener(1, [&dataList](int, int value) { dataList[0] += value; });
+	queue.appendListener(2, [&dataList](int, int value) { dataList[1] += value; });
+
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(! queue.process());
+
+	REQUIRE(queue.enqueue(1, 5));
+	REQUIRE(queue.enqueue(2, 6));
+	REQUIRE(queue.enqueue(3, 7));
+	REQUIRE(! queue.emptyQueue());
+	REQUIRE(dataList == std::vector<int>{ 0, 0, 0 });
+
+	REQUIRE(queue.process());
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(dataList == std::vector<int>{ 5, 6, 0 });
+
+	queue.enqueue(1, 1);
+	queue.enqueue(2, 2);
+	REQUIRE(queue.processOne());
+	REQUIRE(dataList == std::vector<int>{ 6, 6, 0 });
+	REQUIRE(queue.processOne());
+	REQUIRE(dataList == std::vector<int>{ 6, 8, 0 });
+	REQUIRE(! queue.processOne());
+}
+
+TEST_CASE("RingEventQueue, capacity is rounded up to power of two")
+{
+	eventpp::RingEventQueue<int, void (), RingPolicies<eventpp::RingOverflowReturnFalse, 5> > queue;
+	REQUIRE(queue.getQueueCapacity() == 8);
+}
+
+TEST_CASE("RingEventQueue, events enqueued during process are processed next time")
+{
+	using EQ = eventpp::RingEventQueue<int, void (int)>;
+	EQ queue;
+	int count = 0;
+	queue.appendListener(1, [&queue, &count](int) {
+		++count;
+		queue.enqueue(1);
+	});
+
+	queue.enqueue(1);
+	queue.process();
+	REQUIRE(count == 1);
+	queue.process();
+	REQUIRE(count == 2);
+}
+
+TEST_CASE("RingEventQueue, processQueueWith and takeEvent")
+{
+	using EQ = eventpp::RingEventQueue<int, void (int, const std::string &)>;
+	EQ queue;
+
+	queue.enqueue(1, "a");
+	queue.enqueue(2, "b");
+
+	std::vector<int> eventList;
+	std::string text;
+	REQUIRE(queue.processOneWith([&eventList, &text](int, int event, const std::string & s) {
+		eventList.push_back(event);
+		text += s;
+	}));
+	REQUIRE(queue.processQueueWith([&eventList, &text](int, int event, const std::string & s) {
+		eventList.push_back(event);
+		text += s;
+	}));
+	REQUIRE(eventList == std::vector<int>{ 1, 2 });
+	REQUIRE(text == "ab");
+
+	queue.enqueue(3, "c");
+	EQ::QueuedEvent queuedEvent;
+	REQUIRE(queue.takeEvent(&queuedEvent));
+	REQUIRE(queuedEvent.event == 3);
+	REQUIRE(queuedEvent.getArgument<1>() == "c");
+	REQUIRE(! queue.takeEvent(&queuedEvent));
+
+	queue.enqueue(4, "d");
+	queue.clearEvents();
+	REQUIRE(queue.emptyQueue());
+}
+
+TEST_CASE("RingEventQueue, overflow RingOverflowReturnFalse")
+{
+	eventpp::RingEventQueue<int, void (int), RingPolicies<eventpp::RingOverflowReturnFalse> > queue;
+	for(int i = 0; i < 8; ++i) {
+		REQUIRE(queue.enqueue(i));
+	}
+	REQUIRE(! queue.enqueue(8));
+	REQUIRE(queue.getDroppedEventCount() == 0);
+
+	REQUIRE(queue.processOne());
+	REQUIRE(queue.enqueue(8));
+}
+
+TEST_CASE("RingEventQueue, overflow RingOverflowDropNewest")
+{
+	eventpp::RingEventQueue<int, void (int), RingPolicies<eventpp::RingOverflowDropNewest> > queue;
+	std::vector<int> eventList;
+
+	for(int i = 0; i < 10; ++i) {
+		queue.enqueue(i);
+	}
+	REQUIRE(queue.getDroppedEventCount() == 2);
+
+	queue.processQueueWith([&eventList](int, int event) {
+		eventList.push_back(event);
+	});
+	std::vector<int> compareList(8);
+	std::iota(compareList.begin(), compareList.end(), 0);
+	REQUIRE(eventList == compareList);
+}
+
+TEST_CASE("RingEventQueue, overflow RingOverflowDropOldest")
+{
+	eventpp::RingEventQueue<int, void (int), RingPolicies<eventpp::RingOverflowDropOldest> > queue;
+	std::vector<int> eventList;
+
+	for(int i = 0; i < 10; ++i) {
+		REQUIRE(queue.enqueue(i));
+	}
+	REQUIRE(queue.getDroppedEventCount() == 2);
+
+	queue.processQueueWith([&eventList](int, int event) {
+		eventList.push_back(event);
+	});
+	std::vector<int> compareList(8);
+	std::iota(compareList.begin(), compareList.end(), 2);
+	REQUIRE(eventList == compareList);
+}
+
+TEST_CASE("RingEventQueue, overflow RingOverflowBlock")
+{
+	eventpp::RingEventQueue<int, void (int), RingPolicies<eventpp::RingOverflowBlock> > queue;
+
+	constexpr int itemCount = 1000;
+	std::vector<int> eventList;
+
+	std::thread consumer([&queue, &eventList]() {
+		while(eventList.size() < itemCount) {
+			if(queue.waitFor(std::chrono::milliseconds(10))) {
+				queue.processQueueWith([&eventList](int, int event) {
+					eventList.push_back(event);
+				});
+			}
+		}
+	});
+
+	for(int i = 0; i < itemCount; ++i) {
+		REQUIRE(queue.enqueue(i));
+	}
+	consumer.join();
+
+	std::vector<int> compareList(itemCount);
+	std::iota(compareList.begin(), compareList.end(), 0);
+	REQUIRE(eventList == compareList);
+	REQUIRE(queue.getDroppedEventCount() == 0);
+}
+
+TEST_CASE("RingEventQueue, RingOverflowBlock, a listener enqueues to the full queue")
+{
+	eventpp::RingEventQueue<int, void (int, int), RingPolicies<eventpp::RingOverflowBlock, 2> > queue;
+
+	std::vector<int> dataList;
+	queue.appendListener(1, [&queue, &dataList](int, const int value) {
+		dataList.push_back(value);
+		if(value == 1) {
+			// The slot of this event is already free.
+			REQUIRE(queue.enqueue(1, 3));
+		}
+	});
+
+	queue.enqueue(1, 1);
+	queue.enqueue(1, 2);
+	REQUIRE(queue.process());
+	REQUIRE(dataList == std::vector<int>{ 1, 2 });
+	REQUIRE(queue.process());
+	REQUIRE(dataList == std::vector<int>{ 1, 2, 3 });
+	REQUIRE(queue.emptyQueue());
+}
+
+TEST_CASE("RingEventQueue, multi producers, single consumer")
+{
+	struct Policies
+	{
+		using RingCapacity = std::integral_constant<std::size_t, 64>;
+	};
+	eventpp::RingEventQueue<int, void (int, int), Policies> queue;
+
+	constexpr int threadCount = 8;
+	constexpr int itemCountPerThread = 2000;
+	constexpr int itemCount = threadCount * itemCountPerThread;
+	std::vector<int> dataList(itemCount);
+	int processedCount = 0;
+
+	queue.appendListener(0, [&dataList, &processedCount](int, int value) {
+		++dataList[value];
+		++processedCount;
+	});
+
+	std::thread consumer([&queue, &processedCount]() {
+		while(processedCount < itemCount) {
+			if(queue.waitFor(std::chrono::milliseconds(10))) {
+				queue.process();
+			}
+		}
+	});
+
+	std::vector<std::thread> producerList;
+	for(int t = 0; t < threadCount; ++t) {
+		producerList.emplace_back([&queue, t]() {
+			for(int i = 0; i < itemCountPerThread; ++i) {
+				queue.enqueue(0, t * itemCountPerThread + i);
+			}
+		});
+	}
+	for(auto & thread : producerList) {
+		thread.join();
+	}
+	consumer.join();
+
+	REQUIRE(std::all_of(dataList.begin(), dataList.end(), [](int value) { return value == 1; }));
+}
+
+TEST_CASE("RingEventQueue, RingProducerSingle keeps order")
+{
+	struct Policies
+	{
+		using RingProducer = eventpp::RingProducerSingle;
+		using RingCapacity = std::integral_constant<std::size_t, 16>;
+	};
+	eventpp::RingEventQueue<int, void (int), Policies> queue;
+
+	constexpr int itemCount = 5000;
+	std::vector<int> eventList;
+	eventList.reserve(itemCount);
+
+	std::thread producer([&queue]() {
+		for(int i = 0; i < itemCount; ++i) {
+			queue.enqueue(i);
+		}
+	});
+
+	while(eventList.size() < itemCount) {
+		queue.waitFor(std::chrono::milliseconds(10));
+		queue.processQueueWith([&eventList](int, int event) {
+			eventList.push_back(event);
+		});
+	}
+	producer.join();
+
+	std::vector<int> compareList(itemCount);
+	std::iota(compareList.begin(), compareList.end(), 0);
+	REQUIRE(eventList == compareList);
+}
+
+TEST_CASE("RingEventQueue, DisableQueueNotify")
+{
+	using EQ = eventpp::RingEventQueue<int, void ()>;
+	EQ queue;
+
+	{
+		EQ::DisableQueueNotify disableNotify(&queue);
+		queue.enqueue(1);
+		REQUIRE(! queue.waitFor(std::chrono::milliseconds(1)));
+	}
+	REQUIRE(queue.waitFor(std::chrono::milliseconds(1)));
+}
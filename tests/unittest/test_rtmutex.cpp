@@ -0,0 +1,105 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/utilities/rtmutex.h"
+#include "eventpp/eventqueue.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Every thread increments a plain int under the lock, a lost update means
+// the lock doesn't exclude.
+template <typename Mutex>
+int doCountWithThreads(Mutex & mutex)
+{
+	constexpr int threadCount = 4;
+	constexpr int itemCount = 20000;
+	int counter = 0;
+	std::vector<std::thread> threadList;
+	for(int i = 0; i < threadCount; ++i) {
+		threadList.emplace_back([&mutex, &counter]() {
+			for(int k = 0; k < itemCount; ++k) {
+				std::lock_guard<Mutex> lockGuard(mutex);
+				++counter;
+			}
+		});
+	}
+	for(std::thread & thread : threadList) {
+		thread.join();
+	}
+	return counter - threadCount * itemCount;
+}
+
+} //unnamed namespace
+
+TEST_CASE("FutexMutex, lock and try_lock")
+{
+	eventpp::FutexMutex<> mutex;
+	REQUIRE(mutex.try_lock());
+	REQUIRE(! mutex.try_lock());
+	mutex.unlock();
+
+	REQUIRE(doCountWithThreads(mutex) == 0);
+
+	// No spinning, every contended lock sleeps.
+	eventpp::FutexMutex<0> sleepingMutex;
+	REQUIRE(doCountWithThreads(sleepingMutex) == 0);
+}
+
+#if defined(EVENTPP_HAS_PRIO_INHERIT)
+
+TEST_CASE("PIMutex, lock and try_lock")
+{
+	eventpp::PIMutex mutex;
+	REQUIRE(mutex.try_lock());
+	mutex.unlock();
+
+	REQUIRE(doCountWithThreads(mutex) == 0);
+
+	eventpp::ExclusiveSharedMutex<eventpp::PIMutex> sharedMutex;
+	sharedMutex.lock_shared();
+	REQUIRE(! sharedMutex.try_lock());
+	sharedMutex.unlock_shared();
+	REQUIRE(doCountWithThreads(sharedMutex) == 0);
+}
+
+TEST_CASE("RealTimePolicy, EventQueue waits and processes")
+{
+	eventpp::EventQueue<int, void (int), eventpp::RealTimePolicy> queue;
+	std::atomic<int> sum(0);
+	queue.appendListener(1, [&sum](const int value) {
+		sum += value;
+	});
+
+	constexpr int itemCount = 1000;
+	std::thread consumer([&queue, &sum]() {
+		while(sum.load() < itemCount) {
+			queue.wait();
+			queue.process();
+		}
+	});
+	for(int i = 0; i < itemCount; ++i) {
+		queue.enqueue(1);
+	}
+	consumer.join();
+
+	REQUIRE(sum.load() == itemCount);
+	REQUIRE(! queue.waitFor(std::chrono::milliseconds(1)));
+}
+
+#endif
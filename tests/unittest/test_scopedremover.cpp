@@ -524,3 +524,219 @@ TEST_CASE("ScopedRemover, CallbackList, remove")
 	callbackList();
 	REQUIRE(dataList == std::vector<int> { 1, 4, 2 });
 }
+
+TEST_CASE("ScopedRemover, EventDispatcher, reset removes the listeners of all events")
+{
+	using ED = eventpp::EventDispatcher<int, void()>;
+	ED dispatcher;
+	using Remover = eventpp::ScopedRemover<ED>;
+	constexpr int eventCount = 50;
+	constexpr int listenerCountPerEvent = 4;
+
+	int directCount = 0;
+	int removerCount = 0;
+	dispatcher.appendListener(0, [&directCount]() {
+		++directCount;
+	});
+
+	Remover remover(dispatcher);
+	for(int e = 0; e < eventCount; ++e) {
+		for(int i = 0; i < listenerCountPerEvent; ++i) {
+			remover.appendListener(e, [&removerCount]() {
+				++removerCount;
+			});
+		}
+	}
+	for(int e = 0; e < eventCount; ++e) {
+		dispatcher.dispatch(e);
+	}
+	REQUIRE(directCount == 1);
+	REQUIRE(removerCount == eventCount * listenerCountPerEvent);
+
+	remover.reset();
+	for(int e = 0; e < eventCount; ++e) {
+		dispatcher.dispatch(e);
+	}
+	REQUIRE(directCount == 2);
+	REQUIRE(removerCount == eventCount * listenerCountPerEvent);
+	// The listeners are unlinked by the dispatch.
+	REQUIRE(dispatcher.hasAnyListener(0));
+	REQUIRE(! dispatcher.hasAnyListener(1));
+
+	// The remover can be used again after reset.
+	auto handle = remover.appendListener(1, [&removerCount]() {
+		++removerCount;
+	});
+	dispatcher.dispatch(1);
+	REQUIRE(removerCount == eventCount * listenerCountPerEvent + 1);
+	REQUIRE(remover.removeListener(1, handle));
+	REQUIRE(! remover.removeListener(1, handle));
+	dispatcher.dispatch(1);
+	REQUIRE(removerCount == eventCount * listenerCountPerEvent + 1);
+}
+
+TEST_CASE("ScopedRemover, HeterEventDispatcher, removeListener")
+{
+	using ED = eventpp::HeterEventDispatcher<int, eventpp::HeterTuple<void (), void (int)> >;
+	ED dispatcher;
+	using Remover = eventpp::ScopedRemover<ED>;
+	constexpr int event = 3;
+
+	std::vector<int> dataList(3);
+
+	Remover remover(dispatcher);
+	auto ha = remover.appendListener(event, [&dataList]() {
+		++dataList[0];
+	});
+	auto hb = remover.appendListener(event, [&dataList](int) {
+		++dataList[1];
+	});
+	auto hc = dispatcher.appendListener(event, [&dataList](int) {
+		++dataList[2];
+	});
+
+	REQUIRE(! remover.removeListener(event, hc));
+	REQUIRE(remover.removeListener(event, hb));
+	dispatcher.dispatch(event);
+	dispatcher.dispatch(event, 1);
+	REQUIRE(dataList == std::vector<int> { 1, 0, 1 });
+
+	remover.reset();
+	REQUIRE(! remover.removeListener(event, ha));
+	dispatcher.dispatch(event);
+	dispatcher.dispatch(event, 1);
+	REQUIRE(dataList == std::vector<int> { 1, 0, 2 });
+}
+
+namespace {
+
+struct ListenerGroupPolicies
+{
+	using ListenerGroups = eventpp::ListenerGroupsEnabled;
+};
+
+} //unnamed namespace
+
+TEST_CASE("ScopedRemover, EventDispatcher, ListenerGroupsEnabled")
+{
+	using ED = eventpp::EventDispatcher<int, void(), ListenerGroupPolicies>;
+	ED dispatcher;
+	using Remover = eventpp::ScopedRemover<ED>;
+	constexpr int event = 3;
+
+	std::vector<int> dataList(3);
+
+	auto ha = dispatcher.appendListener(event, [&dataList]() {
+		++dataList[0];
+	});
+	{
+		Remover remover(dispatcher);
+		remover.appendListener(event, [&dataList]() {
+			++dataList[1];
+		});
+		auto hc = remover.prependListener(event, [&dataList]() {
+			++dataList[2];
+		});
+		dispatcher.dispatch(event);
+		REQUIRE(dataList == std::vector<int> { 1, 1, 1 });
+
+		REQUIRE(! remover.removeListener(event, ha));
+		REQUIRE(remover.removeListener(event, hc));
+		dispatcher.dispatch(event);
+		REQUIRE(dataList == std::vector<int> { 2, 2, 1 });
+	}
+	dispatcher.dispatch(event);
+	REQUIRE(dataList == std::vector<int> { 3, 2, 1 });
+}
+
+TEST_CASE("ScopedRemover, CallbackList, ListenerGroupsEnabled")
+{
+	using CL = eventpp::CallbackList<void(), ListenerGroupPolicies>;
+	CL callbackList;
+	using Remover = eventpp::ScopedRemover<CL>;
+
+	std::vector<int> dataList(3);
+
+	callbackList.append([&dataList]() {
+		++dataList[0];
+	});
+	Remover remover(callbackList);
+	remover.append([&dataList]() {
+		++dataList[1];
+	});
+	remover.insert([&dataList]() {
+		++dataList[2];
+	}, callbackList.append([]() {}));
+	callbackList();
+	REQUIRE(dataList == std::vector<int> { 1, 1, 1 });
+
+	remover.reset();
+	callbackList();
+	REQUIRE(dataList == std::vector<int> { 2, 1, 1 });
+
+	// The remover gets a new group after reset.
+	remover.append([&dataList]() {
+		++dataList[1];
+	});
+	callbackList();
+	REQUIRE(dataList == std::vector<int> { 3, 2, 1 });
+}
+
+TEST_CASE("ScopedRemover, CallbackList, remove many handles one by one")
+{
+	using CL = eventpp::CallbackList<void(int)>;
+	CL callbackList;
+	using Remover = eventpp::ScopedRemover<CL>;
+	constexpr int count = 100;
+
+	std::vector<int> dataList(count);
+	std::vector<CL::Handle> handleList;
+
+	Remover remover(callbackList);
+	for(int i = 0; i < count / 2; ++i) {
+		handleList.push_back(remover.append([&dataList, i](int) {
+			++dataList[i];
+		}));
+	}
+	const auto otherHandle = callbackList.append([](int) {});
+	// The first remove builds the index, the items added later are indexed when they are added.
+	REQUIRE(remover.remove(handleList[0]));
+	for(int i = count / 2; i < count; ++i) {
+		handleList.push_back(remover.append([&dataList, i](int) {
+			++dataList[i];
+		}));
+	}
+	REQUIRE(! remover.remove(otherHandle));
+	REQUIRE(! remover.remove(CL::Handle()));
+
+	// Remove the odd ones, from both ends, so the items are moved around.
+	for(int i = 1; i < count; i += 4) {
+		REQUIRE(remover.remove(handleList[i]));
+		REQUIRE(remover.remove(handleList[count - i]));
+		REQUIRE(! remover.remove(handleList[i]));
+	}
+	callbackList(0);
+	for(int i = 0; i < count; ++i) {
+		INFO(i);
+		REQUIRE(dataList[i] == ((i == 0 || i % 2 == 1) ? 0 : 1));
+	}
+
+	// A listener removed from the list directly is not in the remover any more.
+	REQUIRE(callbackList.remove(handleList[2]));
+	callbackList(0);
+	REQUIRE(! remover.remove(handleList[2]));
+
+	remover.reset();
+	REQUIRE(! remover.remove(handleList[4]));
+	callbackList(0);
+	REQUIRE(dataList[4] == 2);
+	REQUIRE(dataList[6] == 2);
+
+	// The index is built again after reset.
+	auto handle = remover.append([&dataList](int) {
+		++dataList[0];
+	});
+	REQUIRE(remover.remove(handle));
+	callbackList(0);
+	REQUIRE(dataList[0] == 0);
+}
@@ -0,0 +1,196 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// OPT-63: Tests for ShardedEventDispatcher
+
+#include "test.h"
+#include "eventpp/shardedeventdispatcher.h"
+#include "eventpp/mixins/mixinfilter.h"
+#include "eventpp/mixins/mixinmetrics.h"
+#include "eventpp/utilities/scopedremover.h"
+#include "eventpp/utilities/eventutil.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("ShardedEventDispatcher, append, dispatch and remove")
+{
+	using ED = eventpp::ShardedEventDispatcher<int, void (std::vector<int> &), eventpp::DefaultPolicies, 4>;
+	ED dispatcher;
+
+	std::vector<ED::Handle> handleList;
+	for(int e = 0; e < 20; ++e) {
+		handleList.push_back(dispatcher.appendListener(e, [e](std::vector<int> & v) { v.push_back(e); }));
+	}
+	auto h1 = dispatcher.appendListener(3, [](std::vector<int> & v) { v.push_back(100); });
+	dispatcher.prependListener(3, [](std::vector<int> & v) { v.push_back(101); });
+	dispatcher.insertListener(3, [](std::vector<int> & v) { v.push_back(102); }, h1);
+
+	std::vector<int> dataList;
+	for(int e = 0; e < 21; ++e) {
+		dispatcher.dispatch(e, dataList);
+	}
+	REQUIRE(dataList == std::vector<int>{
+		0, 1, 2, 101, 3, 102, 100, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19
+	});
+
+	REQUIRE(dispatcher.hasAnyListener(7));
+	REQUIRE(! dispatcher.hasAnyListener(20));
+	REQUIRE(dispatcher.ownsHandle(7, handleList[7]));
+	REQUIRE(! dispatcher.ownsHandle(8, handleList[7]));
+	REQUIRE(! dispatcher.removeListener(8, handleList[7]));
+	REQUIRE(dispatcher.removeListener(7, handleList[7]));
+	REQUIRE(! dispatcher.hasAnyListener(7));
+
+	int count = 0;
+	dispatcher.forEach(3, [&count](const ED::Handle &, const ED::Callback &) {
+		++count;
+	});
+	REQUIRE(count == 4);
+	REQUIRE(! dispatcher.forEachIf(3, [](const ED::Callback &) { return false; }));
+}
+
+TEST_CASE("ShardedEventDispatcher, string events, seal and swap")
+{
+	using ED = eventpp::ShardedEventDispatcher<std::string, void (int &)>;
+	ED dispatcher;
+	dispatcher.appendListener("a", [](int & value) { value += 1; });
+	dispatcher.appendListener("b", [](int & value) { value += 10; });
+
+	dispatcher.seal();
+	REQUIRE(dispatcher.isSealed());
+	// A new event can't be added after sealing.
+	REQUIRE(! dispatcher.appendListener("c", [](int & value) { value += 100; }));
+	REQUIRE(dispatcher.appendListener("a", [](int & value) { value += 1000; }));
+
+	int value = 0;
+	dispatcher.dispatch("a", value);
+	dispatcher.dispatch("b", value);
+	dispatcher.dispatch("c", value);
+	REQUIRE(value == 1011);
+
+	ED other;
+	swap(dispatcher, other);
+	value = 0;
+	dispatcher.dispatch("a", value);
+	other.dispatch("a", value);
+	REQUIRE(value == 1001);
+
+	ED copied(other);
+	value = 0;
+	copied.dispatch("b", value);
+	REQUIRE(value == 10);
+}
+
+TEST_CASE("ShardedEventDispatcher, mixins are called once for each dispatch")
+{
+	struct Policies
+	{
+		using Mixins = eventpp::MixinList<eventpp::MixinFilter, eventpp::MixinMetrics>;
+	};
+	using ED = eventpp::ShardedEventDispatcher<int, void (int), Policies, 8>;
+	ED dispatcher;
+
+	int sum = 0;
+	for(int e = 0; e < 16; ++e) {
+		dispatcher.appendListener(e, [&sum](const int e) { sum += e; });
+	}
+	dispatcher.appendFilter([](const int e) {
+		return e != 5;
+	});
+
+	for(int e = 0; e < 16; ++e) {
+		dispatcher.dispatch(e);
+	}
+	REQUIRE(sum == 120 - 5);
+
+	const auto snapshot = dispatcher.getMetricsSnapshot();
+	REQUIRE(snapshot.eventList.size() == 15);
+}
+
+TEST_CASE("ShardedEventDispatcher, ScopedRemover and eventutil")
+{
+	struct Policies
+	{
+		using Callback = void (*)(int &);
+	};
+	using ED = eventpp::ShardedEventDispatcher<int, void (int &), Policies>;
+	ED dispatcher;
+
+	struct Local
+	{
+		static void addOne(int & value) { value += 1; }
+		static void addTen(int & value) { value += 10; }
+	};
+
+	{
+		eventpp::ScopedRemover<ED> remover(dispatcher);
+		remover.appendListener(1, &Local::addOne);
+		remover.appendListener(2, &Local::addOne);
+		int value = 0;
+		dispatcher.dispatch(1, value);
+		dispatcher.dispatch(2, value);
+		REQUIRE(value == 2);
+	}
+
+	dispatcher.appendListener(1, &Local::addTen);
+	int value = 0;
+	dispatcher.dispatch(1, value);
+	dispatcher.dispatch(2, value);
+	REQUIRE(value == 10);
+
+	REQUIRE(eventpp::removeListener(dispatcher, 1, &Local::addTen));
+	REQUIRE(! dispatcher.hasAnyListener(1));
+}
+
+TEST_CASE("ShardedEventDispatcher, multi threading, subscribe while dispatching")
+{
+	using ED = eventpp::ShardedEventDispatcher<int, void (std::atomic<int> &)>;
+	ED dispatcher;
+	constexpr int threadCount = 4;
+	constexpr int iterateCount = 2000;
+
+	std::atomic<bool> stop(false);
+	std::atomic<int> value(0);
+	std::vector<std::thread> writerList;
+	std::thread reader([&dispatcher, &stop, &value]() {
+		int e = 0;
+		while(! stop.load()) {
+			dispatcher.dispatch(e, value);
+			e = (e + 1) % (threadCount * 8);
+		}
+	});
+	for(int i = 0; i < threadCount; ++i) {
+		writerList.emplace_back([&dispatcher, i]() {
+			for(int k = 0; k < iterateCount; ++k) {
+				const int e = i * 8 + k % 8;
+				auto handle = dispatcher.appendListener(e, [](std::atomic<int> & value) { ++value; });
+				dispatcher.removeListener(e, handle);
+			}
+			dispatcher.appendListener(i * 8, [](std::atomic<int> & value) { ++value; });
+		});
+	}
+	for(auto & thread : writerList) {
+		thread.join();
+	}
+	stop = true;
+	reader.join();
+
+	value = 0;
+	for(int e = 0; e < threadCount * 8; ++e) {
+		dispatcher.dispatch(e, value);
+	}
+	REQUIRE(value.load() == threadCount);
+}
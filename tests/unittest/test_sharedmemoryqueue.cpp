@@ -0,0 +1,186 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if defined(__unix__) || defined(__unix) || defined(__APPLE__)
+
+#include "test.h"
+#include "eventpp/sharedmemoryeventqueue.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct Point
+{
+	int x;
+	double y;
+};
+
+std::string makeName(const char * tag)
+{
+	return std::string("/eventpp_test_") + tag + "_" + std::to_string(getpid());
+}
+
+// Removes the shared memory object when the test ends.
+struct NameGuard
+{
+	explicit NameGuard(const std::string & name) : name(name) {
+		eventpp::SharedMemoryEventQueue<int, void (int)>::unlink(name.c_str());
+	}
+
+	~NameGuard() {
+		eventpp::SharedMemoryEventQueue<int, void (int)>::unlink(name.c_str());
+	}
+
+	std::string name;
+};
+
+} //namespace
+
+TEST_CASE("SharedMemoryEventQueue, two queues on the same name")
+{
+	using EQ = eventpp::SharedMemoryEventQueue<int, void (int, const Point &)>;
+	NameGuard nameGuard(makeName("basic"));
+
+	EQ producer(nameGuard.name.c_str(), 5);
+	REQUIRE(producer.isOpen());
+	REQUIRE(producer.getQueueCapacity() == 8);
+
+	// The capacity of the existing memory is used.
+	EQ consumer(nameGuard.name.c_str(), 1000);
+	REQUIRE(consumer.isOpen());
+	REQUIRE(consumer.getQueueCapacity() == 8);
+
+	std::vector<int> dataList;
+	consumer.appendListener(1, [&dataList](const int e, const Point & point) {
+		dataList.push_back(e * 100 + point.x);
+	});
+	consumer.appendListener(2, [&dataList](const int e, const Point & point) {
+		dataList.push_back(e * 100 + static_cast<int>(point.y));
+	});
+
+	REQUIRE(consumer.emptyQueue());
+	for(int i = 0; i < 8; ++i) {
+		REQUIRE(producer.enqueue(i % 2 + 1, Point{ i, i * 2.0 }));
+	}
+	REQUIRE(! producer.enqueue(1, Point{ 8, 0 }));
+	REQUIRE(! consumer.emptyQueue());
+
+	SECTION("process") {
+		REQUIRE(consumer.process());
+		REQUIRE(dataList == std::vector<int>{ 100, 202, 102, 206, 104, 210, 106, 214 });
+		REQUIRE(producer.emptyQueue());
+	}
+
+	SECTION("processQueueWith") {
+		std::vector<int> xList;
+		// The prototype includes the event, so the visitor gets the event twice.
+		REQUIRE(consumer.processQueueWith([&xList](const int /*event*/, const int /*e*/, const Point & point) {
+			xList.push_back(point.x);
+		}));
+		REQUIRE(xList == std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7 });
+	}
+
+	SECTION("processOne and takeEvent") {
+		REQUIRE(consumer.processOne());
+		EQ::QueuedEvent queuedEvent;
+		REQUIRE(consumer.takeEvent(&queuedEvent));
+		REQUIRE(queuedEvent.getEvent() == 2);
+		REQUIRE(queuedEvent.getArgument<0>() == 2);
+		REQUIRE(queuedEvent.getArgument<1>().x == 1);
+		consumer.clearEvents();
+		REQUIRE(consumer.emptyQueue());
+		REQUIRE(dataList == std::vector<int>{ 100 });
+	}
+}
+
+TEST_CASE("SharedMemoryEventQueue, the layout must match")
+{
+	NameGuard nameGuard(makeName("layout"));
+
+	eventpp::SharedMemoryEventQueue<int, void (int)> queue(nameGuard.name.c_str(), 16);
+	REQUIRE(queue.isOpen());
+
+	eventpp::SharedMemoryEventQueue<int, void (int, const Point &)> other(nameGuard.name.c_str(), 16);
+	REQUIRE(! other.isOpen());
+}
+
+TEST_CASE("SharedMemoryEventQueue, across processes")
+{
+	using EQ = eventpp::SharedMemoryEventQueue<int, void (int, int)>;
+	NameGuard nameGuard(makeName("fork"));
+
+	constexpr int producerCount = 3;
+	constexpr int itemCount = 20000;
+
+	EQ queue(nameGuard.name.c_str(), 256);
+	REQUIRE(queue.isOpen());
+
+	std::vector<pid_t> pidList;
+	for(int p = 0; p < producerCount; ++p) {
+		const pid_t pid = fork();
+		REQUIRE(pid >= 0);
+		if(pid == 0) {
+			// The child maps the memory by itself, as an unrelated process.
+			EQ producer(nameGuard.name.c_str(), 256);
+			if(! producer.isOpen()) {
+				_exit(1);
+			}
+			for(int i = 0; i < itemCount; ++i) {
+				while(! producer.enqueue(p, i)) {
+					std::this_thread::yield();
+				}
+			}
+			_exit(0);
+		}
+		pidList.push_back(pid);
+	}
+
+	std::vector<int> nextValues(producerCount, 0);
+	bool inOrder = true;
+	int processedCount = 0;
+	for(int p = 0; p < producerCount; ++p) {
+		queue.appendListener(p, [&nextValues, &inOrder, &processedCount](const int e, const int value) {
+			inOrder = inOrder && (value == nextValues[e]);
+			++nextValues[e];
+			++processedCount;
+		});
+	}
+
+	while(processedCount < producerCount * itemCount) {
+		// A lost wakeup fails here instead of hanging.
+		REQUIRE(queue.waitFor(std::chrono::seconds(10)));
+		queue.process();
+	}
+
+	for(const pid_t pid : pidList) {
+		int status = -1;
+		REQUIRE(waitpid(pid, &status, 0) == pid);
+		REQUIRE(WIFEXITED(status));
+		REQUIRE(WEXITSTATUS(status) == 0);
+	}
+
+	// The events of each producer are in order.
+	REQUIRE(inOrder);
+	REQUIRE(nextValues == std::vector<int>(producerCount, itemCount));
+	REQUIRE(queue.emptyQueue());
+}
+
+#endif
+
@@ -0,0 +1,176 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/staticeventdispatcher.h"
+#include "eventpp/eventqueue.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::string> callList;
+
+void onOne(int, const std::string & s)
+{
+	callList.push_back("one " + s);
+}
+
+void onOneAgain(int, const std::string & s)
+{
+	callList.push_back("oneAgain " + s);
+}
+
+void onTwo(int, const std::string & s)
+{
+	callList.push_back("two " + s);
+}
+
+// A handler with a different but compatible signature, and a return value.
+int onTwoByValue(int e, std::string s)
+{
+	callList.push_back("twoByValue " + s);
+	return e;
+}
+
+void onMessage(const std::string & s)
+{
+	callList.push_back("message " + s);
+}
+
+enum class EventType
+{
+	key,
+	mouse,
+	none
+};
+
+struct Message
+{
+	EventType type;
+	int value;
+};
+
+void onKey(const Message & message)
+{
+	callList.push_back("key " + std::to_string(message.value));
+}
+
+void onMouse(const Message & message)
+{
+	callList.push_back("mouse " + std::to_string(message.value));
+}
+
+struct MessagePolicies
+{
+	static EventType getEvent(const Message & message) {
+		return message.type;
+	}
+};
+
+struct ExcludeEventPolicies
+{
+	using ArgumentPassingMode = eventpp::ArgumentPassingExcludeEvent;
+};
+
+} //unnamed namespace
+
+TEST_CASE("StaticEventDispatcher, dispatch")
+{
+	using Dispatcher = eventpp::StaticEventDispatcher<int, void (int, const std::string &),
+		eventpp::Binding<1, &onOne, &onOneAgain>,
+		eventpp::Binding<2, &onTwo, &onTwoByValue>,
+		eventpp::Binding<1, &onOne>
+	>;
+	callList.clear();
+
+	Dispatcher::dispatch(1, "a");
+	REQUIRE(callList == std::vector<std::string>{ "one a", "oneAgain a", "one a" });
+
+	callList.clear();
+	Dispatcher dispatcher;
+	dispatcher.dispatch(2, "b");
+	dispatcher.dispatch(3, "c");
+	REQUIRE(callList == std::vector<std::string>{ "two b", "twoByValue b" });
+
+	static_assert(Dispatcher::hasAnyListener(1), "");
+	static_assert(! Dispatcher::hasAnyListener(3), "");
+}
+
+TEST_CASE("StaticEventDispatcher, BindingOf")
+{
+	using Handler = void (*)(int, const std::string &);
+	using Dispatcher = eventpp::StaticEventDispatcher<int, void (int, const std::string &),
+		eventpp::BindingOf<int, 1, Handler, &onOne, &onOneAgain>,
+		eventpp::BindingOf<int, 2, Handler, &onTwo>
+	>;
+	callList.clear();
+
+	Dispatcher::dispatch(2, "a");
+	Dispatcher::dispatch(1, "b");
+	REQUIRE(callList == std::vector<std::string>{ "two a", "one b", "oneAgain b" });
+}
+
+TEST_CASE("StaticEventDispatcher, ArgumentPassingExcludeEvent")
+{
+	using Dispatcher = eventpp::StaticEventDispatcher<int, void (const std::string &),
+		eventpp::Binding<3, &onMessage>,
+		ExcludeEventPolicies
+	>;
+	callList.clear();
+
+	Dispatcher::dispatch(3, "a");
+	Dispatcher::dispatch(4, "b");
+	REQUIRE(callList == std::vector<std::string>{ "message a" });
+}
+
+TEST_CASE("StaticEventDispatcher, getEvent policy")
+{
+	using Dispatcher = eventpp::StaticEventDispatcher<EventType, void (const Message &),
+		MessagePolicies,
+		eventpp::Binding<EventType::key, &onKey>,
+		eventpp::Binding<EventType::mouse, &onMouse>
+	>;
+	callList.clear();
+
+	Dispatcher::dispatch(Message { EventType::mouse, 1 });
+	Dispatcher::dispatch(Message { EventType::key, 2 });
+	Dispatcher::dispatch(Message { EventType::none, 3 });
+	REQUIRE(callList == std::vector<std::string>{ "mouse 1", "key 2" });
+}
+
+TEST_CASE("StaticEventDispatcher, as the visitor of EventQueue::processQueueWith")
+{
+	using Dispatcher = eventpp::StaticEventDispatcher<int, void (int, const std::string &),
+		eventpp::Binding<1, &onOne>,
+		eventpp::Binding<2, &onTwo>
+	>;
+	callList.clear();
+
+	eventpp::EventQueue<int, void (int, const std::string &)> queue;
+	queue.enqueue(2, "a");
+	queue.enqueue(1, "b");
+	queue.enqueue(5, "c");
+	REQUIRE(queue.processQueueWith(Dispatcher()));
+	REQUIRE(callList == std::vector<std::string>{ "two a", "one b" });
+
+	eventpp::EventQueue<EventType, void (const Message &), MessagePolicies> messageQueue;
+	messageQueue.enqueue(Message { EventType::key, 7 });
+	callList.clear();
+	messageQueue.processQueueWith(eventpp::StaticEventDispatcher<EventType, void (const Message &),
+		MessagePolicies,
+		eventpp::Binding<EventType::key, &onKey>
+	>());
+	REQUIRE(callList == std::vector<std::string>{ "key 7" });
+}
@@ -0,0 +1,258 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/staticeventqueue.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Counts the allocations of the current thread while counting is on.
+thread_local bool countingAllocation = false;
+thread_local std::size_t allocationCount = 0;
+
+void * doAllocate(std::size_t size)
+{
+	if(countingAllocation) {
+		++allocationCount;
+	}
+	void * p = std::malloc(size == 0 ? 1 : size);
+	if(p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+struct AllocationCounter
+{
+	AllocationCounter() {
+		allocationCount = 0;
+		countingAllocation = true;
+	}
+
+	~AllocationCounter() {
+		countingAllocation = false;
+	}
+
+	std::size_t getCount() const {
+		return allocationCount;
+	}
+};
+
+} //unnamed namespace
+
+void * operator new(std::size_t size)
+{
+	return doAllocate(size);
+}
+
+void * operator new[](std::size_t size)
+{
+	return doAllocate(size);
+}
+
+void operator delete(void * p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void * p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+TEST_CASE("StaticEventQueue, no allocation after construction")
+{
+	using EQ = eventpp::StaticEventQueue<int, void (int, int), 8, 4>;
+	EQ queue;
+
+	int sum = 0;
+	std::size_t count;
+	{
+		AllocationCounter counter;
+
+		auto handle1 = queue.appendListener(1, [&sum](int, const int value) {
+			sum += value;
+		});
+		auto handle2 = queue.appendListener(2, [&sum](int, const int value) {
+			sum += value * 10;
+		});
+		for(int i = 0; i < 100; ++i) {
+			queue.enqueue(1, 1);
+			queue.enqueue(2, 2);
+			queue.process();
+			queue.dispatch(1, 3);
+		}
+		queue.removeListener(1, handle1);
+		queue.removeListener(2, handle2);
+		handle1 = queue.appendListener(1, [&sum](int, const int value) {
+			sum += value;
+		});
+		queue.enqueue(1, 1);
+		queue.processOne();
+		queue.enqueue(1, 1);
+		queue.clearEvents();
+
+		count = counter.getCount();
+	}
+	REQUIRE(count == 0);
+	REQUIRE(sum == 100 * (1 + 20 + 3) + 1);
+}
+
+TEST_CASE("StaticEventQueue, capacity and listener limits")
+{
+	using EQ = eventpp::StaticEventQueue<int, void (int), 3, 2>;
+	EQ queue;
+	REQUIRE(queue.getQueueCapacity() == 3);
+
+	std::vector<int> dataList;
+	REQUIRE(queue.appendListener(1, [&dataList](const int value) {
+		dataList.push_back(value);
+	}));
+	REQUIRE(queue.appendListener(2, [&dataList](const int value) {
+		dataList.push_back(value);
+	}));
+	REQUIRE(! queue.appendListener(3, [](int) {}));
+	REQUIRE(queue.getListenerCount() == 2);
+
+	REQUIRE(queue.enqueue(1));
+	REQUIRE(queue.enqueue(2));
+	REQUIRE(queue.enqueue(1));
+	REQUIRE(! queue.enqueue(2));
+	REQUIRE(queue.getQueuedEventCount() == 3);
+	REQUIRE(queue.getDroppedEventCount() == 1);
+
+	REQUIRE(queue.processOne());
+	// The ring wraps around.
+	REQUIRE(queue.enqueue(2));
+	REQUIRE(queue.process());
+	REQUIRE(dataList == std::vector<int> { 1, 2, 1, 2 });
+	REQUIRE(queue.emptyQueue());
+	REQUIRE(! queue.process());
+}
+
+TEST_CASE("StaticEventQueue, listeners order and removal while dispatching")
+{
+	using EQ = eventpp::StaticEventQueue<int, void (), 4, 8>;
+	EQ queue;
+
+	std::vector<int> dataList;
+	EQ::Handle handle2;
+	EQ::Handle handle3;
+	queue.appendListener(1, [&]() {
+		dataList.push_back(1);
+		// Appended while dispatching, it's not called this time.
+		queue.appendListener(1, [&dataList]() {
+			dataList.push_back(5);
+		});
+	});
+	handle2 = queue.appendListener(1, [&]() {
+		dataList.push_back(2);
+		REQUIRE(queue.removeListener(1, handle2));
+		REQUIRE(queue.removeListener(1, handle3));
+	});
+	handle3 = queue.appendListener(1, [&dataList]() {
+		dataList.push_back(3);
+	});
+	queue.appendListener(1, [&dataList]() {
+		dataList.push_back(4);
+	});
+
+	queue.dispatch(1);
+	REQUIRE(dataList == std::vector<int> { 1, 2, 4 });
+	REQUIRE(! queue.removeListener(1, handle2));
+	REQUIRE(! queue.removeListener(2, EQ::Handle()));
+
+	dataList.clear();
+	queue.enqueue(1);
+	queue.process();
+	REQUIRE(dataList == std::vector<int> { 1, 4, 5 });
+	REQUIRE(queue.hasAnyListener(1));
+	REQUIRE(! queue.hasAnyListener(2));
+}
+
+TEST_CASE("StaticEventQueue, the map entry of an event without listeners is reused")
+{
+	using EQ = eventpp::StaticEventQueue<int, void (int), 4, 1>;
+	EQ queue;
+
+	int total = 0;
+	for(int event = 0; event < 100; ++event) {
+		const EQ::Handle handle = queue.appendListener(event, [&total](const int value) {
+			total += value;
+		});
+		REQUIRE(handle);
+		queue.dispatch(event);
+		REQUIRE(queue.removeListener(event, handle));
+	}
+	REQUIRE(total == 99 * 100 / 2);
+}
+
+TEST_CASE("StaticEventQueue, multiple threads")
+{
+	using EQ = eventpp::StaticEventQueue<int, void (int), 64, 4>;
+	EQ queue;
+
+	constexpr int producerCount = 4;
+	constexpr int itemCount = 10000;
+	std::atomic<int> processedCount(0);
+	std::atomic<long long> sum(0);
+	queue.appendListener(1, [&](const int value) {
+		sum += value;
+		++processedCount;
+	});
+
+	std::atomic<bool> stopped(false);
+	std::thread consumer([&queue, &stopped]() {
+		while(! stopped.load()) {
+			if(queue.waitFor(std::chrono::milliseconds(1))) {
+				queue.process();
+			}
+		}
+		queue.process();
+	});
+
+	std::vector<std::thread> producerList;
+	for(int i = 0; i < producerCount; ++i) {
+		producerList.emplace_back([&queue]() {
+			for(int k = 1; k <= itemCount; ++k) {
+				while(! queue.enqueue(1, k)) {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+	for(std::thread & thread : producerList) {
+		thread.join();
+	}
+	stopped = true;
+	consumer.join();
+
+	REQUIRE(processedCount.load() == producerCount * itemCount);
+	REQUIRE(sum.load() == (long long)producerCount * itemCount * (itemCount + 1) / 2);
+}
@@ -0,0 +1,176 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/utilities/typeid.h"
+#include "eventpp/eventdispatcher.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/hetereventdispatcher.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct KeyEvent {};
+struct MouseEvent {};
+struct CloseEvent {};
+
+template <int N>
+struct ManyEvent {};
+
+struct TypeIdMapPolicies
+{
+	template <typename Key, typename T>
+	using Map = eventpp::TypeIdMap<Key, T>;
+};
+
+template <int ...N>
+void addManyListeners(eventpp::EventDispatcher<eventpp::TypeId, void (int &), TypeIdMapPolicies> & dispatcher)
+{
+	const int dummy[] = { (dispatcher.appendListener(eventpp::getTypeId<ManyEvent<N> >(), [](int & sum) {
+		sum += N;
+	}), 0)... };
+	(void)dummy;
+}
+
+} //unnamed namespace
+
+TEST_CASE("TypeId, dense and stable")
+{
+	const eventpp::TypeId keyId = eventpp::getTypeId<KeyEvent>();
+	const eventpp::TypeId mouseId = eventpp::getTypeId<MouseEvent>();
+
+	REQUIRE(keyId != eventpp::TypeId());
+	REQUIRE(keyId != mouseId);
+	REQUIRE(keyId == eventpp::getTypeId<KeyEvent>());
+	REQUIRE(keyId == eventpp::getTypeId<const KeyEvent &>());
+	REQUIRE(keyId.getIndex() < eventpp::getTypeIdCount());
+	REQUIRE(mouseId.getIndex() < eventpp::getTypeIdCount());
+
+	// The same IDs in all threads.
+	std::vector<eventpp::TypeId> idList(4);
+	std::vector<std::thread> threadList;
+	for(std::size_t i = 0; i < idList.size(); ++i) {
+		threadList.emplace_back([&idList, i]() {
+			idList[i] = eventpp::getTypeId<ManyEvent<100> >();
+		});
+	}
+	for(auto & thread : threadList) {
+		thread.join();
+	}
+	for(const auto & id : idList) {
+		REQUIRE(id == eventpp::getTypeId<ManyEvent<100> >());
+	}
+}
+
+TEST_CASE("TypeId, EventDispatcher with TypeIdMap")
+{
+	using ED = eventpp::EventDispatcher<eventpp::TypeId, void (const std::string &), TypeIdMapPolicies>;
+	ED dispatcher;
+	std::vector<std::string> dataList;
+
+	dispatcher.appendListener(eventpp::getTypeId<KeyEvent>(), [&dataList](const std::string & s) {
+		dataList.push_back("key " + s);
+	});
+	dispatcher.appendListener(eventpp::getTypeId<MouseEvent>(), [&dataList](const std::string & s) {
+		dataList.push_back("mouse " + s);
+	});
+
+	dispatcher.dispatch(eventpp::getTypeId<KeyEvent>(), "a");
+	dispatcher.dispatch<MouseEvent>("b");
+	dispatcher.dispatch<KeyEvent>("c");
+	// No listener, and a type which gets its ID after the map is sized.
+	dispatcher.dispatch<ManyEvent<200> >("d");
+	dispatcher.dispatch(eventpp::TypeId(), "e");
+	REQUIRE(dataList == std::vector<std::string>{ "key a", "mouse b", "key c" });
+
+	REQUIRE(dispatcher.hasAnyListener(eventpp::getTypeId<KeyEvent>()));
+	REQUIRE(! dispatcher.hasAnyListener(eventpp::getTypeId<CloseEvent>()));
+
+	// A copy has its own listeners.
+	ED copied(dispatcher);
+	copied.appendListener(eventpp::getTypeId<CloseEvent>(), [&dataList](const std::string & s) {
+		dataList.push_back("close " + s);
+	});
+	dataList.clear();
+	copied.dispatch<KeyEvent>("f");
+	copied.dispatch<CloseEvent>("g");
+	dispatcher.dispatch<CloseEvent>("h");
+	REQUIRE(dataList == std::vector<std::string>{ "key f", "close g" });
+
+	// The listeners move with the map.
+	ED moved(std::move(copied));
+	dataList.clear();
+	moved.dispatch<CloseEvent>("i");
+	REQUIRE(dataList == std::vector<std::string>{ "close i" });
+}
+
+TEST_CASE("TypeId, TypeIdMap grows")
+{
+	eventpp::EventDispatcher<eventpp::TypeId, void (int &), TypeIdMapPolicies> dispatcher;
+	addManyListeners<1, 2, 3, 4, 5, 6, 7, 8, 9, 10>(dispatcher);
+	auto handle = dispatcher.appendListener(eventpp::getTypeId<ManyEvent<1> >(), [](int & sum) {
+		sum += 1000;
+	});
+	addManyListeners<11, 12, 13, 14, 15, 16, 17, 18, 19, 20>(dispatcher);
+
+	int sum = 0;
+	dispatcher.dispatch<ManyEvent<1> >(sum);
+	REQUIRE(sum == 1001);
+	sum = 0;
+	dispatcher.dispatch<ManyEvent<20> >(sum);
+	REQUIRE(sum == 20);
+
+	dispatcher.removeListener(eventpp::getTypeId<ManyEvent<1> >(), handle);
+	sum = 0;
+	dispatcher.dispatch<ManyEvent<1> >(sum);
+	dispatcher.dispatch<ManyEvent<15> >(sum);
+	REQUIRE(sum == 16);
+}
+
+TEST_CASE("TypeId, EventQueue")
+{
+	eventpp::EventQueue<eventpp::TypeId, void (int), TypeIdMapPolicies> queue;
+	std::vector<int> dataList;
+	queue.appendListener(eventpp::getTypeId<KeyEvent>(), [&dataList](const int n) {
+		dataList.push_back(n);
+	});
+	queue.appendListener(eventpp::getTypeId<MouseEvent>(), [&dataList](const int n) {
+		dataList.push_back(-n);
+	});
+
+	queue.enqueue(eventpp::getTypeId<KeyEvent>(), 1);
+	queue.enqueue(eventpp::getTypeId<MouseEvent>(), 2);
+	queue.enqueue(eventpp::getTypeId<CloseEvent>(), 3);
+	queue.process();
+	REQUIRE(dataList == std::vector<int>{ 1, -2 });
+}
+
+TEST_CASE("TypeId, HeterEventDispatcher")
+{
+	eventpp::HeterEventDispatcher<eventpp::TypeId, eventpp::HeterTuple<void (), void (int)> > dispatcher;
+	int value = 0;
+	dispatcher.appendListener(eventpp::getTypeId<KeyEvent>(), [&value]() {
+		value += 1;
+	});
+	dispatcher.appendListener(eventpp::getTypeId<MouseEvent>(), [&value](const int n) {
+		value += n;
+	});
+
+	dispatcher.dispatch<KeyEvent>();
+	dispatcher.dispatch<MouseEvent>(10);
+	dispatcher.dispatch(eventpp::getTypeId<MouseEvent>(), 100);
+	REQUIRE(value == 111);
+}
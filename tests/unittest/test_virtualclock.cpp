@@ -0,0 +1,167 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/utilities/virtualclock.h"
+#include "eventpp/utilities/deadlinequeuelist.h"
+
+#include <chrono>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+template <typename Tag>
+struct ReplayPolicies
+{
+	using Clock = eventpp::VirtualClock<Tag>;
+	using Threading = eventpp::SingleThreading;
+	using Timer = eventpp::TimerWheel;
+	using TimerResolution = std::chrono::milliseconds;
+};
+
+struct DeadlineTag {};
+
+struct DeadlinePolicies : ReplayPolicies<DeadlineTag>
+{
+	using QueueDeadline = eventpp::QueueDeadlineSteady;
+	template <typename T>
+	using QueueList = eventpp::DeadlineQueueList<T>;
+};
+
+template <typename Clock>
+long long getMilliseconds()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+}
+
+} //namespace
+
+TEST_CASE("VirtualClock, advance")
+{
+	struct Tag {};
+	using Clock = eventpp::VirtualClock<Tag>;
+
+	Clock::reset();
+	REQUIRE(Clock::now() == Clock::time_point());
+	Clock::advance(std::chrono::seconds(3));
+	REQUIRE(getMilliseconds<Clock>() == 3000);
+	// Never goes back.
+	Clock::advanceTo(Clock::time_point(std::chrono::seconds(1)));
+	REQUIRE(getMilliseconds<Clock>() == 3000);
+	Clock::reset(Clock::time_point(std::chrono::seconds(1)));
+	REQUIRE(getMilliseconds<Clock>() == 1000);
+
+	static_assert(std::is_same<eventpp::EventQueue<int, void ()>::Clock, std::chrono::steady_clock>::value,
+		"The default clock is steady_clock.");
+}
+
+TEST_CASE("VirtualClock, replay delayed events")
+{
+	struct Tag {};
+	using Clock = eventpp::VirtualClock<Tag>;
+	Clock::reset();
+
+	using EQ = eventpp::EventQueue<int, void (int), ReplayPolicies<Tag> >;
+	static_assert(std::is_same<EQ::Clock, Clock>::value, "");
+	EQ queue;
+
+	std::vector<long long> timeList;
+	queue.appendListener(1, [&timeList](const int value) {
+		timeList.push_back(getMilliseconds<Clock>() * 10 + value);
+	});
+
+	const auto startTime = std::chrono::steady_clock::now();
+
+	// A day of events.
+	queue.enqueueAt(Clock::time_point(std::chrono::hours(24)), 1, 3);
+	queue.enqueueAt(Clock::time_point(std::chrono::seconds(5)), 1, 2);
+	queue.enqueueAfter(std::chrono::milliseconds(1500), 1, 1);
+	while(queue.waitFor(std::chrono::hours(48))) {
+		queue.process();
+	}
+
+	REQUIRE(timeList == std::vector<long long>{ 1500 * 10 + 1, 5000 * 10 + 2, 24 * 3600 * 1000LL * 10 + 3 });
+	// The last waitFor timed out, at its deadline.
+	REQUIRE(getMilliseconds<Clock>() == 72 * 3600 * 1000LL);
+	REQUIRE(queue.getWaitStats().timeoutCount == 1);
+	REQUIRE(std::chrono::steady_clock::now() - startTime < std::chrono::seconds(10));
+
+	// wait jumps to the next delayed event.
+	queue.enqueueAfter(std::chrono::seconds(10), 1, 4);
+	queue.wait();
+	REQUIRE(getMilliseconds<Clock>() == 72 * 3600 * 1000LL + 10000);
+	queue.process();
+	REQUIRE(timeList.back() == (72 * 3600 * 1000LL + 10000) * 10 + 4);
+
+	// A short timeout stops before the delayed event.
+	queue.enqueueAfter(std::chrono::seconds(10), 1, 5);
+	REQUIRE(! queue.waitFor(std::chrono::seconds(3)));
+	REQUIRE(getMilliseconds<Clock>() == 72 * 3600 * 1000LL + 13000);
+	REQUIRE(queue.getDelayedEventCount() == 1);
+}
+
+TEST_CASE("VirtualClock, deadlines and processFor")
+{
+	using Clock = eventpp::VirtualClock<DeadlineTag>;
+	Clock::reset();
+
+	eventpp::EventQueue<int, void (int), DeadlinePolicies> queue;
+
+	std::vector<int> dataList;
+	queue.appendListener(1, [&dataList](const int value) {
+		dataList.push_back(value);
+		// Each event takes 10 ms of the virtual time.
+		Clock::advance(std::chrono::milliseconds(10));
+	});
+
+	queue.enqueueWithDeadline(Clock::now() + std::chrono::milliseconds(5), 1, 1);
+	queue.enqueueWithDeadline(Clock::now() + std::chrono::milliseconds(100), 1, 2);
+	queue.enqueue(1, 3);
+	Clock::advance(std::chrono::milliseconds(20));
+	queue.process();
+	REQUIRE(dataList == std::vector<int>{ 2, 3 });
+	REQUIRE(queue.getExpiredEventCount() == 1);
+
+	dataList.clear();
+	for(int i = 0; i < 10; ++i) {
+		queue.enqueue(1, i);
+	}
+	// The virtual time of the listeners, not the real time.
+	queue.processFor(std::chrono::milliseconds(25));
+	REQUIRE(dataList == std::vector<int>{ 0, 1, 2 });
+}
+
+TEST_CASE("VirtualClock, tryEnqueueFor")
+{
+	struct Tag {};
+	using Clock = eventpp::VirtualClock<Tag>;
+	Clock::reset();
+
+	struct MyPolicies
+	{
+		using Clock = eventpp::VirtualClock<Tag>;
+		using QueueCapacity = eventpp::QueueCapacityLimited;
+	};
+	using EQ = eventpp::EventQueue<int, void (int), MyPolicies>;
+	EQ queue;
+	EQ::QueueLimits limits;
+	limits.maxEventCount = 1;
+	queue.setQueueLimits(limits);
+
+	REQUIRE(queue.tryEnqueueFor(std::chrono::seconds(1), 1, 1));
+	// Full, the clock jumps to the timeout.
+	REQUIRE(! queue.tryEnqueueFor(std::chrono::seconds(30), 1, 2));
+	REQUIRE(getMilliseconds<Clock>() == 30000);
+}
@@ -0,0 +1,197 @@
+// eventpp library
+// Copyright (C) 2018 Wang Qi (wqking)
+// Github: https://github.com/wqking/eventpp
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "test.h"
+#include "eventpp/eventqueue.h"
+#include "eventpp/utilities/windowaggregator.h"
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+Clock::time_point atMilliseconds(const int milliseconds)
+{
+	return Clock::time_point(std::chrono::milliseconds(milliseconds));
+}
+
+eventpp::WindowOptions makeOptions(const int windowSize, const int slide = 0)
+{
+	eventpp::WindowOptions options;
+	options.windowSize = std::chrono::milliseconds(windowSize);
+	options.slide = std::chrono::milliseconds(slide);
+	options.keyCapacity = 4;
+	return options;
+}
+
+} //unnamed namespace
+
+TEST_CASE("WindowAggregator, tumbling windows")
+{
+	using Aggregator = eventpp::WindowAggregator<std::string, int>;
+	std::vector<Aggregator::Result> resultList;
+	Aggregator aggregator(makeOptions(1000), [&resultList](const Aggregator::Result & result) {
+		resultList.push_back(result);
+	});
+
+	REQUIRE(aggregator.add(atMilliseconds(100), "a", 1));
+	REQUIRE(aggregator.add(atMilliseconds(200), "b", 10));
+	REQUIRE(aggregator.add(atMilliseconds(900), "a", 2));
+	REQUIRE(aggregator.advance(atMilliseconds(999)) == 0);
+	REQUIRE(resultList.empty());
+
+	REQUIRE(aggregator.advance(atMilliseconds(1000)) == 2);
+	REQUIRE(resultList.size() == 2);
+	REQUIRE(resultList[0].key == "a");
+	REQUIRE(resultList[0].value == 3);
+	REQUIRE(resultList[0].count == 2);
+	REQUIRE(resultList[0].windowBegin == atMilliseconds(0));
+	REQUIRE(resultList[0].windowEnd == atMilliseconds(1000));
+	REQUIRE(resultList[1].key == "b");
+	REQUIRE(resultList[1].value == 10);
+	REQUIRE(resultList[1].count == 1);
+
+	// The values without time go to the window open at the last advance.
+	resultList.clear();
+	aggregator.add("c", 5);
+	aggregator.add("c", 6);
+	REQUIRE(aggregator.advance(atMilliseconds(2500)) == 1);
+	REQUIRE(resultList.size() == 1);
+	REQUIRE(resultList[0].key == "c");
+	REQUIRE(resultList[0].value == 11);
+	REQUIRE(resultList[0].windowBegin == atMilliseconds(1000));
+
+	// The empty windows emit nothing.
+	resultList.clear();
+	REQUIRE(aggregator.advance(atMilliseconds(10000)) == 0);
+	REQUIRE(resultList.empty());
+}
+
+TEST_CASE("WindowAggregator, sliding windows")
+{
+	using Aggregator = eventpp::WindowAggregator<int, int>;
+	std::vector<Aggregator::Result> resultList;
+	Aggregator aggregator(makeOptions(300, 100), [&resultList](const Aggregator::Result & result) {
+		resultList.push_back(result);
+	});
+
+	aggregator.add(atMilliseconds(0), 1, 1);
+	aggregator.add(atMilliseconds(150), 1, 10);
+	aggregator.add(atMilliseconds(250), 2, 100);
+	aggregator.advance(atMilliseconds(450));
+
+	// The windows ending at 100, 200, 300 and 400.
+	std::vector<std::pair<int, int> > valueList;
+	for(const auto & result : resultList) {
+		valueList.push_back({ result.key, result.value });
+	}
+	REQUIRE(valueList == std::vector<std::pair<int, int> >{
+		{ 1, 1 },
+		{ 1, 11 },
+		{ 1, 11 }, { 2, 100 },
+		{ 1, 10 }, { 2, 100 },
+	});
+	REQUIRE(resultList[0].windowBegin == atMilliseconds(-200));
+	REQUIRE(resultList[0].windowEnd == atMilliseconds(100));
+	REQUIRE(resultList[4].windowBegin == atMilliseconds(100));
+	REQUIRE(resultList[4].windowEnd == atMilliseconds(400));
+	REQUIRE(resultList[4].count == 1);
+}
+
+TEST_CASE("WindowAggregator, late and early events")
+{
+	using Aggregator = eventpp::WindowAggregator<int, int, eventpp::WindowMax>;
+	std::vector<Aggregator::Result> resultList;
+	Aggregator aggregator(makeOptions(1000), [&resultList](const Aggregator::Result & result) {
+		resultList.push_back(result);
+	});
+
+	REQUIRE(aggregator.add(atMilliseconds(1500), 1, 3));
+	REQUIRE(aggregator.add(atMilliseconds(1600), 1, 7));
+	REQUIRE(aggregator.add(atMilliseconds(1700), 1, 5));
+
+	// A time in a later window closes the windows before it.
+	REQUIRE(aggregator.add(atMilliseconds(2100), 1, 1));
+	REQUIRE(resultList.size() == 1);
+	REQUIRE(resultList[0].value == 7);
+	REQUIRE(resultList[0].count == 3);
+
+	REQUIRE(! aggregator.add(atMilliseconds(1900), 1, 100));
+	REQUIRE(aggregator.getLateEventCount() == 1);
+
+	aggregator.advance(atMilliseconds(3000));
+	REQUIRE(resultList.size() == 2);
+	REQUIRE(resultList[1].value == 1);
+}
+
+TEST_CASE("WindowAggregator, many keys")
+{
+	using Aggregator = eventpp::WindowAggregator<int, std::int64_t, eventpp::WindowSum>;
+	std::map<int, std::int64_t> totalMap;
+	Aggregator aggregator(makeOptions(10), [&totalMap](const Aggregator::Result & result) {
+		REQUIRE(totalMap.find(result.key) == totalMap.end());
+		totalMap[result.key] = result.value;
+	});
+
+	constexpr int keyCount = 5000;
+	for(int window = 0; window < 3; ++window) {
+		totalMap.clear();
+		aggregator.advance(atMilliseconds(window * 10));
+		for(int i = 0; i < keyCount * 3; ++i) {
+			// Multiples of 1024 are the worst case of a masked hash.
+			aggregator.add((i % keyCount) * 1024, i);
+		}
+		REQUIRE(aggregator.advance(atMilliseconds(window * 10 + 10)) == keyCount);
+		REQUIRE(totalMap.size() == keyCount);
+		for(int k = 0; k < keyCount; ++k) {
+			REQUIRE(totalMap[k * 1024] == std::int64_t(k) * 3 + keyCount * 3);
+		}
+	}
+}
+
+TEST_CASE("WindowAggregator, fed by processQueueWith, results to EventQueue")
+{
+	struct Trade
+	{
+		int symbol;
+		int quantity;
+	};
+	using Aggregator = eventpp::WindowAggregator<int, int>;
+
+	eventpp::EventQueue<int, void (const Trade &)> tradeQueue;
+	eventpp::EventQueue<int, void (const Aggregator::Result &)> resultQueue;
+	Aggregator aggregator(makeOptions(1000), resultQueue, 1);
+
+	std::map<int, int> volumeMap;
+	resultQueue.appendListener(1, [&volumeMap](const Aggregator::Result & result) {
+		volumeMap[result.key] += result.value;
+	});
+
+	aggregator.advance(atMilliseconds(0));
+	for(int i = 0; i < 1000; ++i) {
+		tradeQueue.enqueue(0, Trade{ i % 4, 1 });
+	}
+	tradeQueue.processQueueWith([&aggregator](int, const Trade & trade) {
+		aggregator.add(trade.symbol, trade.quantity);
+	});
+	aggregator.advance(atMilliseconds(1000));
+
+	// 1000 events are 4 results.
+	REQUIRE(volumeMap.empty());
+	resultQueue.process();
+	REQUIRE(volumeMap == std::map<int, int>{ { 0, 250 }, { 1, 250 }, { 2, 250 }, { 3, 250 } });
+}